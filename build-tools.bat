@@ -1 +1,34 @@
 cl  /O2 /W4 /Fe:Out\vtxgen.exe code\vtxlang\main.c
+cl  /O2 /W4 /Fe:Out\replay.exe code\replay\main.c
+cl  /O2 /W4 /Fe:Out\meshconv.exe code\meshconv\main.c
+cl  /O2 /W4 /Fe:Out\test_state_cache.exe code\tests\test_state_cache.c
+cl  /O2 /W4 /Fe:Out\test_ring_alloc.exe code\tests\test_ring_alloc.c
+cl  /O2 /W4 /Fe:Out\test_pipeline_cache.exe code\tests\test_pipeline_cache.c
+cl  /O2 /W4 /Fe:Out\test_dxbc.exe code\tests\test_dxbc.c
+cl  /O2 /W4 /Fe:Out\test_shader_cache.exe code\tests\test_shader_cache.c
+cl  /O2 /W4 /Fe:Out\test_shader_jobs.exe code\tests\test_shader_jobs.c
+cl  /O2 /W4 /Fe:Out\test_upload.exe code\tests\test_upload.c
+cl  /O2 /W4 /Fe:Out\test_frame_graph.exe code\tests\test_frame_graph.c
+cl  /O2 /W4 /Fe:Out\test_batch2d.exe code\tests\test_batch2d.c
+cl  /O2 /W4 /Fe:Out\test_release_queue.exe code\tests\test_release_queue.c
+cl  /O2 /W4 /Fe:Out\test_offset_alloc.exe code\tests\test_offset_alloc.c
+cl  /O2 /W4 /Fe:Out\test_precache.exe code\tests\test_precache.c
+cl  /O2 /W4 /Fe:Out\test_frame_pipe.exe code\tests\test_frame_pipe.c
+cl  /O2 /W4 /Fe:Out\test_mesh_optimize.exe code\tests\test_mesh_optimize.c
+cl  /O2 /W4 /Fe:Out\test_obj.exe code\tests\test_obj.c
+cl  /O2 /W4 /Fe:Out\test_replay.exe code\tests\test_replay.c
+cl  /O2 /W4 /Fe:Out\test_mesh_file.exe code\tests\test_mesh_file.c
+cl  /O2 /W4 /Fe:Out\test_mesh_build.exe code\tests\test_mesh_build.c
+cl  /O2 /W4 /Fe:Out\test_mesh_weld.exe code\tests\test_mesh_weld.c
+cl  /O2 /W4 /Fe:Out\test_bundle.exe code\tests\test_bundle.c
+cl  /O2 /W4 /Fe:Out\test_bind_group.exe code\tests\test_bind_group.c
+cl  /O2 /W4 /Fe:Out\test_state_objects.exe code\tests\test_state_objects.c
+cl  /O2 /W4 /Fe:Out\bench_draw_queue.exe code\bench\bench_draw_queue.c
+cl  /O2 /W4 /Fe:Out\bench_pool.exe code\bench\bench_pool.c
+cl  /O2 /W4 /Fe:Out\bench_upload.exe code\bench\bench_upload.c
+cl  /O2 /W4 /Fe:Out\bench_instancing.exe code\bench\bench_instancing.c
+cl  /O2 /W4 /Fe:Out\bench_offset_alloc.exe code\bench\bench_offset_alloc.c
+cl  /O2 /W4 /Fe:Out\bench_bundle.exe code\bench\bench_bundle.c
+cl  /O2 /W4 /Fe:Out\bench_frame_pipe.exe code\bench\bench_frame_pipe.c
+cl  /O2 /W4 /Fe:Out\bench_mesh_optimize.exe code\bench\bench_mesh_optimize.c
+cl  /O2 /W4 /Fe:Out\bench_obj.exe code\bench\bench_obj.c
@@ -0,0 +1,187 @@
+#include "c_file.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+bool io_file_open( IO_File *file, const char *path, bool write )
+{
+	DWORD  access      = GENERIC_READ | ( write ? GENERIC_WRITE : 0 );
+	DWORD  share       = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+	DWORD  disposition = write ? OPEN_ALWAYS : OPEN_EXISTING;
+	HANDLE h           = CreateFileA( path, access, share, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL );
+
+	file->handle = (intptr_t)h;
+	file->valid  = h != INVALID_HANDLE_VALUE;
+	return file->valid;
+}
+
+void io_file_close( IO_File *file )
+{
+	if ( file->valid )
+		CloseHandle( (HANDLE)file->handle );
+	file->valid = false;
+}
+
+uint64_t io_file_size( IO_File *file )
+{
+	LARGE_INTEGER size;
+	if ( !file->valid || !GetFileSizeEx( (HANDLE)file->handle, &size ) )
+		return 0;
+	return (uint64_t)size.QuadPart;
+}
+
+bool io_file_read_at( IO_File *file, uint64_t offset, void *data, size_t size )
+{
+	OVERLAPPED ov = { 0 };
+	ov.Offset     = (DWORD)offset;
+	ov.OffsetHigh = (DWORD)( offset >> 32 );
+
+	DWORD read = 0;
+	return file->valid && ReadFile( (HANDLE)file->handle, data, (DWORD)size, &read, &ov ) && read == size;
+}
+
+bool io_file_write_at( IO_File *file, uint64_t offset, const void *data, size_t size )
+{
+	OVERLAPPED ov = { 0 };
+	ov.Offset     = (DWORD)offset;
+	ov.OffsetHigh = (DWORD)( offset >> 32 );
+
+	DWORD written = 0;
+	return file->valid && WriteFile( (HANDLE)file->handle, data, (DWORD)size, &written, &ov ) && written == size;
+}
+
+bool io_file_lock( IO_File *file, bool exclusive )
+{
+	OVERLAPPED ov = { 0 };
+	return file->valid &&
+	       LockFileEx( (HANDLE)file->handle, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD, MAXDWORD, &ov );
+}
+
+void io_file_unlock( IO_File *file )
+{
+	OVERLAPPED ov = { 0 };
+	if ( file->valid )
+		UnlockFileEx( (HANDLE)file->handle, 0, MAXDWORD, MAXDWORD, &ov );
+}
+
+bool io_file_map( IO_File *file, size_t size, IO_Mapping *outMapping )
+{
+	memset( outMapping, 0, sizeof( *outMapping ) );
+	if ( !file->valid )
+		return false;
+	if ( size == 0 )
+		return true;
+
+	HANDLE mapping = CreateFileMappingA( (HANDLE)file->handle,
+	                                     NULL,
+	                                     PAGE_READONLY,
+	                                     (DWORD)( (uint64_t)size >> 32 ),
+	                                     (DWORD)size,
+	                                     NULL );
+	if ( !mapping )
+		return false;
+
+	const void *view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, size );
+	if ( !view )
+	{
+		CloseHandle( mapping );
+		return false;
+	}
+
+	outMapping->data   = (const uint8_t *)view;
+	outMapping->size   = size;
+	outMapping->handle = (intptr_t)mapping;
+	return true;
+}
+
+void io_file_unmap( IO_Mapping *mapping )
+{
+	if ( mapping->data )
+	{
+		UnmapViewOfFile( mapping->data );
+		CloseHandle( (HANDLE)mapping->handle );
+	}
+	memset( mapping, 0, sizeof( *mapping ) );
+}
+
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// unistd.h claims R_OK for access(), the renderer uses it as its success code.
+#undef R_OK
+
+bool io_file_open( IO_File *file, const char *path, bool write )
+{
+	int fd       = write ? open( path, O_RDWR | O_CREAT, 0644 ) : open( path, O_RDONLY );
+	file->handle = fd;
+	file->valid  = fd >= 0;
+	return file->valid;
+}
+
+void io_file_close( IO_File *file )
+{
+	if ( file->valid )
+		close( (int)file->handle );
+	file->valid = false;
+}
+
+uint64_t io_file_size( IO_File *file )
+{
+	struct stat st;
+	if ( !file->valid || fstat( (int)file->handle, &st ) != 0 )
+		return 0;
+	return (uint64_t)st.st_size;
+}
+
+bool io_file_read_at( IO_File *file, uint64_t offset, void *data, size_t size )
+{
+	return file->valid && pread( (int)file->handle, data, size, (off_t)offset ) == (ssize_t)size;
+}
+
+bool io_file_write_at( IO_File *file, uint64_t offset, const void *data, size_t size )
+{
+	return file->valid && pwrite( (int)file->handle, data, size, (off_t)offset ) == (ssize_t)size;
+}
+
+bool io_file_lock( IO_File *file, bool exclusive )
+{
+	return file->valid && flock( (int)file->handle, exclusive ? LOCK_EX : LOCK_SH ) == 0;
+}
+
+void io_file_unlock( IO_File *file )
+{
+	if ( file->valid )
+		flock( (int)file->handle, LOCK_UN );
+}
+
+bool io_file_map( IO_File *file, size_t size, IO_Mapping *outMapping )
+{
+	memset( outMapping, 0, sizeof( *outMapping ) );
+	if ( !file->valid )
+		return false;
+	if ( size == 0 )
+		return true;
+
+	void *view = mmap( NULL, size, PROT_READ, MAP_SHARED, (int)file->handle, 0 );
+	if ( view == MAP_FAILED )
+		return false;
+
+	outMapping->data = (const uint8_t *)view;
+	outMapping->size = size;
+	return true;
+}
+
+void io_file_unmap( IO_Mapping *mapping )
+{
+	if ( mapping->data )
+		munmap( (void *)mapping->data, mapping->size );
+	memset( mapping, 0, sizeof( *mapping ) );
+}
+
+#endif
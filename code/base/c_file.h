@@ -0,0 +1,42 @@
+#ifndef C_FILE_H
+#define C_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Thin wrapper over the OS file API for the few things stdio can't do:
+// positioned writes, whole-file advisory locks and read-only mappings.
+// Win32 and POSIX implementations live side by side in c_file.c.
+//
+
+typedef struct IO_File
+{
+	intptr_t handle; // HANDLE on Windows, fd elsewhere
+	bool     valid;
+} IO_File;
+
+typedef struct IO_Mapping
+{
+	const uint8_t *data;
+	size_t         size;
+	intptr_t       handle; // file mapping object on Windows, unused elsewhere
+} IO_Mapping;
+
+// Opens for reading, or for reading and writing (creating it if needed). Other processes may share it.
+bool     io_file_open( IO_File *file, const char *path, bool write );
+void     io_file_close( IO_File *file );
+uint64_t io_file_size( IO_File *file );
+bool     io_file_read_at( IO_File *file, uint64_t offset, void *data, size_t size );
+bool     io_file_write_at( IO_File *file, uint64_t offset, const void *data, size_t size );
+
+// Blocking lock on the whole file, shared between processes.
+bool io_file_lock( IO_File *file, bool exclusive );
+void io_file_unlock( IO_File *file );
+
+// Maps the first size bytes read-only; a zero size leaves the mapping empty.
+bool io_file_map( IO_File *file, size_t size, IO_Mapping *outMapping );
+void io_file_unmap( IO_Mapping *mapping );
+
+#endif // C_FILE_H
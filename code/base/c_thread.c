@@ -0,0 +1,239 @@
+#include "c_thread.h"
+
+#ifdef _WIN32
+
+static DWORD WINAPI sys_thread_entry( LPVOID arg )
+{
+	SYS_Thread *thread = (SYS_Thread *)arg;
+	thread->fn( thread->arg );
+	return 0;
+}
+
+bool sys_thread_start( SYS_Thread *thread, SYS_ThreadFn fn, void *arg )
+{
+	thread->fn     = fn;
+	thread->arg    = arg;
+	HANDLE h       = CreateThread( NULL, 0, sys_thread_entry, thread, 0, NULL );
+	thread->handle = (intptr_t)h;
+	return h != NULL;
+}
+
+void sys_thread_join( SYS_Thread *thread )
+{
+	if ( !thread->handle )
+		return;
+	WaitForSingleObject( (HANDLE)thread->handle, INFINITE );
+	CloseHandle( (HANDLE)thread->handle );
+	thread->handle = 0;
+}
+
+uint64_t sys_thread_id( void )
+{
+	return (uint64_t)GetCurrentThreadId();
+}
+
+void sys_thread_yield( void )
+{
+	SwitchToThread();
+}
+
+void sys_mutex_init( SYS_Mutex *mutex )
+{
+	InitializeSRWLock( &mutex->lock );
+}
+
+void sys_mutex_destroy( SYS_Mutex *mutex )
+{
+	(void)mutex;
+}
+
+void sys_mutex_lock( SYS_Mutex *mutex )
+{
+	AcquireSRWLockExclusive( &mutex->lock );
+}
+
+void sys_mutex_unlock( SYS_Mutex *mutex )
+{
+	ReleaseSRWLockExclusive( &mutex->lock );
+}
+
+void sys_cond_init( SYS_Cond *cond )
+{
+	InitializeConditionVariable( &cond->cond );
+}
+
+void sys_cond_destroy( SYS_Cond *cond )
+{
+	(void)cond;
+}
+
+void sys_cond_wait( SYS_Cond *cond, SYS_Mutex *mutex )
+{
+	SleepConditionVariableSRW( &cond->cond, &mutex->lock, INFINITE, 0 );
+}
+
+void sys_cond_signal( SYS_Cond *cond )
+{
+	WakeConditionVariable( &cond->cond );
+}
+
+void sys_cond_broadcast( SYS_Cond *cond )
+{
+	WakeAllConditionVariable( &cond->cond );
+}
+
+int64_t sys_atomic_load( SYS_Atomic64 *atomic )
+{
+	return InterlockedCompareExchange64( &atomic->value, 0, 0 );
+}
+
+void sys_atomic_store( SYS_Atomic64 *atomic, int64_t value )
+{
+	InterlockedExchange64( &atomic->value, value );
+}
+
+int64_t sys_atomic_add( SYS_Atomic64 *atomic, int64_t delta )
+{
+	return InterlockedExchangeAdd64( &atomic->value, delta );
+}
+
+bool sys_atomic_cas( SYS_Atomic64 *atomic, int64_t *expected, int64_t desired )
+{
+	int64_t previous = InterlockedCompareExchange64( &atomic->value, desired, *expected );
+	if ( previous == *expected )
+		return true;
+	*expected = previous;
+	return false;
+}
+
+int sys_cpu_count( void )
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// unistd.h claims R_OK for access(), the renderer uses it as its success code.
+#undef R_OK
+
+static void *sys_thread_entry( void *arg )
+{
+	SYS_Thread *thread = (SYS_Thread *)arg;
+	thread->fn( thread->arg );
+	return NULL;
+}
+
+bool sys_thread_start( SYS_Thread *thread, SYS_ThreadFn fn, void *arg )
+{
+	pthread_t *t = (pthread_t *)malloc( sizeof( pthread_t ) );
+	if ( !t )
+		return false;
+
+	thread->fn  = fn;
+	thread->arg = arg;
+	if ( pthread_create( t, NULL, sys_thread_entry, thread ) != 0 )
+	{
+		free( t );
+		return false;
+	}
+	thread->handle = (intptr_t)t;
+	return true;
+}
+
+void sys_thread_join( SYS_Thread *thread )
+{
+	if ( !thread->handle )
+		return;
+	pthread_t *t = (pthread_t *)thread->handle;
+	pthread_join( *t, NULL );
+	free( t );
+	thread->handle = 0;
+}
+
+uint64_t sys_thread_id( void )
+{
+	return (uint64_t)(uintptr_t)pthread_self();
+}
+
+void sys_thread_yield( void )
+{
+	sched_yield();
+}
+
+void sys_mutex_init( SYS_Mutex *mutex )
+{
+	pthread_mutex_init( &mutex->lock, NULL );
+}
+
+void sys_mutex_destroy( SYS_Mutex *mutex )
+{
+	pthread_mutex_destroy( &mutex->lock );
+}
+
+void sys_mutex_lock( SYS_Mutex *mutex )
+{
+	pthread_mutex_lock( &mutex->lock );
+}
+
+void sys_mutex_unlock( SYS_Mutex *mutex )
+{
+	pthread_mutex_unlock( &mutex->lock );
+}
+
+void sys_cond_init( SYS_Cond *cond )
+{
+	pthread_cond_init( &cond->cond, NULL );
+}
+
+void sys_cond_destroy( SYS_Cond *cond )
+{
+	pthread_cond_destroy( &cond->cond );
+}
+
+void sys_cond_wait( SYS_Cond *cond, SYS_Mutex *mutex )
+{
+	pthread_cond_wait( &cond->cond, &mutex->lock );
+}
+
+void sys_cond_signal( SYS_Cond *cond )
+{
+	pthread_cond_signal( &cond->cond );
+}
+
+void sys_cond_broadcast( SYS_Cond *cond )
+{
+	pthread_cond_broadcast( &cond->cond );
+}
+
+int64_t sys_atomic_load( SYS_Atomic64 *atomic )
+{
+	return __atomic_load_n( &atomic->value, __ATOMIC_SEQ_CST );
+}
+
+void sys_atomic_store( SYS_Atomic64 *atomic, int64_t value )
+{
+	__atomic_store_n( &atomic->value, value, __ATOMIC_SEQ_CST );
+}
+
+int64_t sys_atomic_add( SYS_Atomic64 *atomic, int64_t delta )
+{
+	return __atomic_fetch_add( &atomic->value, delta, __ATOMIC_SEQ_CST );
+}
+
+bool sys_atomic_cas( SYS_Atomic64 *atomic, int64_t *expected, int64_t desired )
+{
+	return __atomic_compare_exchange_n( &atomic->value, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+}
+
+int sys_cpu_count( void )
+{
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? (int)n : 1;
+}
+
+#endif
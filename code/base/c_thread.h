@@ -0,0 +1,82 @@
+#ifndef C_THREAD_H
+#define C_THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Threads, a mutex, a condition variable and 64-bit atomics, mapped onto Win32
+// (SRW locks, condition variables, Interlocked*) or pthreads and the GCC/Clang
+// __atomic builtins. Just enough for the renderer's worker pools and queues.
+//
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef struct SYS_Mutex
+{
+	SRWLOCK lock;
+} SYS_Mutex;
+
+typedef struct SYS_Cond
+{
+	CONDITION_VARIABLE cond;
+} SYS_Cond;
+#else
+#include <pthread.h>
+
+typedef struct SYS_Mutex
+{
+	pthread_mutex_t lock;
+} SYS_Mutex;
+
+typedef struct SYS_Cond
+{
+	pthread_cond_t cond;
+} SYS_Cond;
+#endif
+
+// Sequentially consistent, naturally aligned so plain loads never tear.
+typedef struct SYS_Atomic64
+{
+	volatile int64_t value;
+} SYS_Atomic64;
+
+typedef void ( *SYS_ThreadFn )( void *arg );
+
+typedef struct SYS_Thread
+{
+	intptr_t     handle;
+	SYS_ThreadFn fn;
+	void        *arg;
+} SYS_Thread;
+
+// The SYS_Thread must stay at the same address until sys_thread_join returns.
+bool sys_thread_start( SYS_Thread *thread, SYS_ThreadFn fn, void *arg );
+void sys_thread_join( SYS_Thread *thread );
+// Identifies the calling thread, unique among the threads alive.
+uint64_t sys_thread_id( void );
+// Gives the rest of the time slice to another ready thread, for polling loops.
+void sys_thread_yield( void );
+
+void sys_mutex_init( SYS_Mutex *mutex );
+void sys_mutex_destroy( SYS_Mutex *mutex );
+void sys_mutex_lock( SYS_Mutex *mutex );
+void sys_mutex_unlock( SYS_Mutex *mutex );
+
+void sys_cond_init( SYS_Cond *cond );
+void sys_cond_destroy( SYS_Cond *cond );
+void sys_cond_wait( SYS_Cond *cond, SYS_Mutex *mutex );
+void sys_cond_signal( SYS_Cond *cond );
+void sys_cond_broadcast( SYS_Cond *cond );
+
+int64_t sys_atomic_load( SYS_Atomic64 *atomic );
+void    sys_atomic_store( SYS_Atomic64 *atomic, int64_t value );
+// Returns the value before the addition.
+int64_t sys_atomic_add( SYS_Atomic64 *atomic, int64_t delta );
+// On failure *expected receives the current value.
+bool    sys_atomic_cas( SYS_Atomic64 *atomic, int64_t *expected, int64_t desired );
+
+int sys_cpu_count( void );
+
+#endif // C_THREAD_H
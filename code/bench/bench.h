@@ -0,0 +1,55 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//
+// What the benchmark executables share: a monotonic clock and a seeded random
+// stream, so two runs of a benchmark measure the same work. Benchmarks print
+// their numbers and exit 0, build-tools.bat builds them next to the tools.
+//
+
+static inline uint64_t bench_now( void )
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER        counter;
+	if ( !frequency.QuadPart )
+		QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return (uint64_t)( (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart );
+#else
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline double bench_ms( uint64_t nanoseconds )
+{
+	return (double)nanoseconds / 1e6;
+}
+
+// xorshift64*, never seeded with 0.
+static inline uint64_t bench_random( uint64_t *state )
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1Dull;
+}
+
+static inline uint32_t bench_random_below( uint64_t *state, uint32_t bound )
+{
+	return (uint32_t)( ( bench_random( state ) >> 32 ) % bound );
+}
+
+#endif // BENCH_H
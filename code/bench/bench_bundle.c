@@ -0,0 +1,288 @@
+//
+// bench_bundle: static scenery drawn through the headless backend, once with
+// every sorted packet bound and drawn the way r_submit_draw_queue does it and
+// once from a draw bundle (r_bundle.h), whose commands already leave out the
+// binds that repeat the previous packet's state. Both frames make the same
+// draws with the same state. Reports the CPU time of a frame, the calls that
+// reached the backend and how many of them its state cache had to drop, and
+// what building the bundle costs once.
+//
+// The headless target still looks up every handle, so this measures what the
+// bundle saves on redundant binds, not the resolved objects r_execute_bundle
+// replays on D3D11.
+//
+//   bench_bundle [--draws N] [--pipelines N] [--meshes N] [--materials N] [--repeat N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_draw_queue.c"
+#include "../render/common/r_bundle.c"
+#include "../render/backend/headless/r_headless.c"
+
+typedef struct Result
+{
+	uint64_t        best;
+	uint64_t        calls; // calls made into the backend in one frame
+	R_HeadlessStats stats;
+} Result;
+
+static uint32_t execute( R_ReplayTarget *target, R_CaptureCall *call )
+{
+	return target->execute( target->self, call );
+}
+
+static uint32_t create_buffer( R_ReplayTarget *target, const void *data, uint32_t bytes )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_BUFFER, .data = data, .size = bytes };
+	call.args[2]       = bytes;
+	return execute( target, &call );
+}
+
+// Pipelines sharing a few shaders, a mesh a vertex and an index buffer, a material a constant buffer.
+static bool make_scene( R_Bundle       *bundle,
+                        R_ReplayTarget *target,
+                        uint32_t        draws,
+                        uint32_t        pipelineCount,
+                        uint32_t        meshes,
+                        uint32_t        materials )
+{
+	static const uint8_t vsBytecode[16] = { 'v', 's' };
+	static const uint8_t psBytecode[16] = { 'p', 's' };
+	R_CaptureCall        vs             = { .op = R_CAPTURE_CREATE_VERTEX_SHADER, .data = vsBytecode, .size = 16 };
+	R_CaptureCall        ps             = { .op = R_CAPTURE_CREATE_PIXEL_SHADER, .data = psBytecode, .size = 16 };
+	uint32_t             shaders[2]     = { execute( target, &vs ), execute( target, &ps ) };
+
+	uint32_t *pipelines     = (uint32_t *)malloc( pipelineCount * sizeof( uint32_t ) );
+	uint32_t *vertexBuffers = (uint32_t *)malloc( meshes * sizeof( uint32_t ) );
+	uint32_t *indexBuffers  = (uint32_t *)malloc( meshes * sizeof( uint32_t ) );
+	uint32_t *constants     = (uint32_t *)malloc( materials * sizeof( uint32_t ) );
+	if ( !pipelines || !vertexBuffers || !indexBuffers || !constants || !r_bundle_init( bundle, draws ) )
+		return false;
+
+	for ( uint32_t i = 0; i < pipelineCount; ++i )
+	{
+		// A different rasterizer block each, so the backend doesn't share them.
+		uint32_t blocks[10 + 24 + 13] = { 0 };
+		blocks[0]                     = i;
+
+		R_CaptureCall call = { .op = R_CAPTURE_CREATE_PIPELINE, .refs = { shaders[0], shaders[1], 0, 0 } };
+		call.args[0]       = 10 * sizeof( uint32_t );
+		call.args[1]       = 24 * sizeof( uint32_t );
+		call.args[2]       = 13 * sizeof( uint32_t );
+		call.args[3]       = 0xffffffffu;
+		call.data          = blocks;
+		call.size          = sizeof( blocks );
+		pipelines[i]       = execute( target, &call );
+	}
+
+	uint16_t indices[36];
+	for ( uint32_t i = 0; i < 36; ++i )
+		indices[i] = (uint16_t)( i % 24 );
+	static float vertices[24 * 8];
+	for ( uint32_t i = 0; i < meshes; ++i )
+	{
+		vertexBuffers[i] = create_buffer( target, vertices, sizeof( vertices ) );
+		indexBuffers[i]  = create_buffer( target, indices, sizeof( indices ) );
+	}
+	for ( uint32_t i = 0; i < materials; ++i )
+		constants[i] = create_buffer( target, vertices, 256 );
+
+	uint64_t seed = 12345;
+	for ( uint32_t i = 0; i < draws; ++i )
+	{
+		uint32_t     pipeline = bench_random_below( &seed, pipelineCount );
+		uint32_t     material = bench_random_below( &seed, materials );
+		uint32_t     mesh     = bench_random_below( &seed, meshes );
+		R_DrawPacket p        = { 0 };
+		p.pipeline.id         = pipelines[pipeline];
+		p.vertexBuffer.id     = vertexBuffers[mesh];
+		p.vertexStride        = 32;
+		p.indexBuffer.id      = indexBuffers[mesh];
+		p.indexFormat         = R_HEADLESS_INDEX_R16;
+		p.constants.id        = constants[material];
+		p.constantSlot        = 1;
+		p.indexCount          = 36;
+		r_bundle_push( bundle, r_draw_key_make( 0, pipeline, material * meshes + mesh, 0.5f ), &p );
+	}
+
+	free( pipelines );
+	free( vertexBuffers );
+	free( indexBuffers );
+	free( constants );
+	return true;
+}
+
+// r_submit_draw_queue: every packet binds everything, the state cache drops what repeats.
+static uint64_t draw_packets( R_ReplayTarget *target, const R_DrawQueue *queue )
+{
+	for ( size_t i = 0; i < queue->count; ++i )
+	{
+		const R_DrawPacket *p        = r_draw_queue_get( queue, i );
+		R_CaptureCall       pipeline = { .op = R_CAPTURE_BIND_PIPELINE, .id = p->pipeline.id };
+		R_CaptureCall       vertices = { .op = R_CAPTURE_SET_VERTEX_BUFFER, .id = p->vertexBuffer.id };
+		R_CaptureCall       indices  = { .op = R_CAPTURE_SET_INDEX_BUFFER, .id = p->indexBuffer.id };
+		R_CaptureCall       constant = { .op = R_CAPTURE_BIND_CONSTANT_BUFFER, .id = p->constants.id };
+		R_CaptureCall       draw     = { .op = R_CAPTURE_DRAW_INDEXED };
+		vertices.args[0]             = p->vertexStride;
+		vertices.args[1]             = p->vertexOffset;
+		indices.args[0]              = p->indexFormat;
+		constant.args[0]             = (uint32_t)p->constantSlot;
+		draw.args[0]                 = p->indexCount;
+		draw.args[1]                 = p->startIndex;
+		draw.args[2]                 = (uint32_t)p->baseVertex;
+		execute( target, &pipeline );
+		execute( target, &vertices );
+		execute( target, &indices );
+		execute( target, &constant );
+		execute( target, &draw );
+	}
+	return queue->count * 5;
+}
+
+// The bundle's commands one call each, as r_execute_bundle walks them.
+static uint64_t draw_bundle( R_ReplayTarget *target, const R_Bundle *bundle )
+{
+	static const R_CaptureOp k_ops[] = {
+		[R_BUNDLE_CMD_PIPELINE]        = R_CAPTURE_BIND_PIPELINE,
+		[R_BUNDLE_CMD_VERTEX_BUFFER]   = R_CAPTURE_SET_VERTEX_BUFFER,
+		[R_BUNDLE_CMD_INDEX_BUFFER]    = R_CAPTURE_SET_INDEX_BUFFER,
+		[R_BUNDLE_CMD_CONSTANT_BUFFER] = R_CAPTURE_BIND_CONSTANT_BUFFER,
+		[R_BUNDLE_CMD_DRAW_INDEXED]    = R_CAPTURE_DRAW_INDEXED,
+	};
+	for ( uint32_t n = 0; n < bundle->commandCount; ++n )
+	{
+		const R_BundleCommand *cmd  = &bundle->commands[n];
+		R_CaptureCall          call = { .op = k_ops[cmd->type], .id = cmd->handle };
+		call.args[0]                = cmd->args[0];
+		call.args[1]                = cmd->args[1];
+		call.args[2]                = cmd->args[2];
+		execute( target, &call );
+	}
+	return bundle->commandCount;
+}
+
+static Result run( R_Headless *dev, const R_Bundle *bundle, bool useBundle, uint32_t repeat )
+{
+	R_ReplayTarget target  = r_headless_replay_target( dev );
+	R_CaptureCall  present = { .op = R_CAPTURE_PRESENT };
+	Result         result  = { UINT64_MAX, 0, { 0 } };
+	for ( uint32_t i = 0; i < repeat; ++i )
+	{
+		r_headless_reset_stats( dev );
+		uint64_t start = bench_now();
+		result.calls   = useBundle ? draw_bundle( &target, bundle ) : draw_packets( &target, &bundle->queue );
+		execute( &target, &present );
+		uint64_t time = bench_now() - start;
+		result.best   = time < result.best ? time : result.best;
+	}
+	r_headless_get_stats( dev, &result.stats );
+	return result;
+}
+
+static void state_calls( const R_HeadlessStats *stats, uint64_t *issued, uint64_t *filtered )
+{
+	*issued   = 0;
+	*filtered = 0;
+	for ( int i = 0; i < R_STATE_CALL_COUNT; ++i )
+	{
+		*issued += stats->state.issued[i];
+		*filtered += stats->state.filtered[i];
+	}
+}
+
+static void print_result( const char *name, const Result *r, uint32_t draws )
+{
+	uint64_t issued, filtered;
+	state_calls( &r->stats, &issued, &filtered );
+	printf( "%-8s %10.3f %10.1f %10llu %12llu %12llu %10llu %8llu\n",
+	        name,
+	        bench_ms( r->best ),
+	        (double)r->best / draws,
+	        (unsigned long long)r->calls,
+	        (unsigned long long)issued,
+	        (unsigned long long)filtered,
+	        (unsigned long long)r->stats.draws,
+	        (unsigned long long)r->stats.invalidDraws );
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t draws     = 20000;
+	uint32_t pipelines = 64;
+	uint32_t meshes    = 1000;
+	uint32_t materials = 256;
+	uint32_t repeat    = 50;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		uint32_t value = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		if ( strcmp( argv[i], "--draws" ) == 0 )
+			draws = value;
+		else if ( strcmp( argv[i], "--pipelines" ) == 0 )
+			pipelines = value;
+		else if ( strcmp( argv[i], "--meshes" ) == 0 )
+			meshes = value;
+		else if ( strcmp( argv[i], "--materials" ) == 0 )
+			materials = value;
+		else if ( strcmp( argv[i], "--repeat" ) == 0 )
+			repeat = value;
+	}
+	if ( draws == 0 || pipelines == 0 || meshes == 0 || materials == 0 || repeat == 0 )
+	{
+		fprintf( stderr,
+		         "usage: bench_bundle [--draws N] [--pipelines N] [--meshes N] [--materials N] [--repeat N]\n" );
+		return 1;
+	}
+
+	R_Headless    *dev    = r_headless_create();
+	R_ReplayTarget target = r_headless_replay_target( dev );
+	R_Bundle       bundle;
+	if ( !dev || !make_scene( &bundle, &target, draws, pipelines, meshes, materials ) )
+	{
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+
+	// Building sorts the packets too, which the direct path needs as well.
+	uint64_t start = bench_now();
+	if ( !r_bundle_build( &bundle ) )
+	{
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+	uint64_t build = bench_now() - start;
+
+	Result direct   = run( dev, &bundle, false, repeat );
+	Result replayed = run( dev, &bundle, true, repeat );
+
+	printf( "%u draws, %u pipelines, %u meshes, %u materials, best of %u frames\n\n",
+	        draws,
+	        pipelines,
+	        meshes,
+	        materials,
+	        repeat );
+	printf( "%-8s %10s %10s %10s %12s %12s %10s %8s\n",
+	        "",
+	        "ms",
+	        "ns/draw",
+	        "calls",
+	        "state calls",
+	        "filtered",
+	        "draws",
+	        "invalid" );
+	print_result( "packets", &direct, draws );
+	print_result( "bundle", &replayed, draws );
+	printf( "\nbundle: %u commands, built once in %.3f ms\n", bundle.commandCount, bench_ms( build ) );
+
+	r_bundle_free( &bundle );
+	r_headless_destroy( dev );
+	return 0;
+}
@@ -0,0 +1,161 @@
+//
+// bench_draw_queue: what sorting a frame's draws by key costs and what it
+// saves. Builds a frame of random draws over a few pipelines, materials and
+// meshes, then walks it in submission order and in key order through the state
+// cache, the way r_submit_draw_queue binds them, and counts the state calls
+// that reach the driver.
+//
+//   bench_draw_queue [--draws N] [--pipelines N] [--materials N] [--repeat N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_draw_queue.c"
+#include "../render/common/r_state_cache.c"
+
+typedef struct Frame
+{
+	uint64_t     *keys;
+	R_DrawPacket *packets;
+	uint32_t      count;
+} Frame;
+
+static bool make_frame( Frame *frame, uint32_t draws, uint32_t pipelines, uint32_t materials )
+{
+	frame->keys    = (uint64_t *)malloc( draws * sizeof( uint64_t ) );
+	frame->packets = (R_DrawPacket *)calloc( draws, sizeof( R_DrawPacket ) );
+	frame->count   = draws;
+	if ( !frame->keys || !frame->packets )
+		return false;
+
+	// Every material draws with one pipeline, its own constants and one of 256 meshes.
+	uint64_t seed = 0x9E3779B97F4A7C15ull;
+	for ( uint32_t i = 0; i < draws; ++i )
+	{
+		uint32_t      pass     = bench_random_below( &seed, 2 );
+		uint32_t      material = bench_random_below( &seed, materials );
+		uint32_t      pipeline = material % pipelines;
+		float         depth    = (float)bench_random_below( &seed, 1u << 20 ) / (float)( 1u << 20 );
+		R_DrawPacket *p        = &frame->packets[i];
+
+		p->pipeline.id     = 1 + pipeline;
+		p->vertexBuffer.id = 1 + material % 256;
+		p->vertexStride    = 32;
+		p->indexBuffer.id  = 1000 + material % 256;
+		p->indexFormat     = 42;
+		p->constants.id    = 2000 + material;
+		p->indexCount      = 36;
+		frame->keys[i]     = r_draw_key_make( pass, pipeline, material, depth );
+	}
+	return true;
+}
+
+static const void *object( uint32_t id )
+{
+	return (const void *)(uintptr_t)id;
+}
+
+// r_submit_draw_queue's binds, against the state cache only.
+static void submit( R_StateCache *cache, const R_DrawPacket *p )
+{
+	r_state_cache_set_pipeline( cache, object( p->pipeline.id ) );
+	r_state_cache_set_vertex_buffer( cache, 0, object( p->vertexBuffer.id ), p->vertexStride, p->vertexOffset );
+	r_state_cache_set_index_buffer( cache, object( p->indexBuffer.id ), p->indexFormat, 0 );
+	r_state_cache_set_constant_buffer( cache, R_STAGE_VERTEX, p->constantSlot, object( p->constants.id ) );
+}
+
+static uint64_t state_calls( const R_StateCache *cache )
+{
+	uint64_t issued = 0;
+	for ( int i = 0; i < R_STATE_CALL_COUNT; ++i )
+		issued += cache->stats.issued[i];
+	return issued;
+}
+
+static void print_calls( const char *order, const R_StateCache *cache )
+{
+	printf( "%-10s %10llu %10llu %10llu %10llu %10llu\n",
+	        order,
+	        (unsigned long long)cache->stats.issued[R_STATE_CALL_PIPELINE],
+	        (unsigned long long)cache->stats.issued[R_STATE_CALL_VERTEX_BUFFER],
+	        (unsigned long long)cache->stats.issued[R_STATE_CALL_INDEX_BUFFER],
+	        (unsigned long long)cache->stats.issued[R_STATE_CALL_CONSTANT_BUFFER],
+	        (unsigned long long)state_calls( cache ) );
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t draws     = 100000;
+	uint32_t pipelines = 64;
+	uint32_t materials = 1024;
+	uint32_t repeat    = 20;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		uint32_t value = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		if ( strcmp( argv[i], "--draws" ) == 0 )
+			draws = value;
+		else if ( strcmp( argv[i], "--pipelines" ) == 0 )
+			pipelines = value;
+		else if ( strcmp( argv[i], "--materials" ) == 0 )
+			materials = value;
+		else if ( strcmp( argv[i], "--repeat" ) == 0 )
+			repeat = value;
+	}
+	if ( draws == 0 || pipelines == 0 || materials == 0 || repeat == 0 )
+	{
+		fprintf( stderr, "usage: bench_draw_queue [--draws N] [--pipelines N] [--materials N] [--repeat N]\n" );
+		return 1;
+	}
+
+	Frame       frame = { 0 };
+	R_DrawQueue queue;
+	if ( !make_frame( &frame, draws, pipelines, materials ) || !r_draw_queue_init( &queue, draws ) )
+	{
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+
+	// The fastest of the runs, each one fills the queue and sorts it the way a frame would.
+	uint64_t pushTime = UINT64_MAX, sortTime = UINT64_MAX;
+	for ( uint32_t run = 0; run < repeat; ++run )
+	{
+		uint64_t start = bench_now();
+		r_draw_queue_reset( &queue );
+		for ( uint32_t i = 0; i < frame.count; ++i )
+			r_draw_queue_push( &queue, frame.keys[i], &frame.packets[i] );
+		uint64_t pushed = bench_now();
+		r_draw_queue_sort( &queue );
+		uint64_t sorted = bench_now();
+
+		pushTime = pushed - start < pushTime ? pushed - start : pushTime;
+		sortTime = sorted - pushed < sortTime ? sorted - pushed : sortTime;
+	}
+
+	R_StateCache unsorted, inOrder;
+	r_state_cache_init( &unsorted );
+	r_state_cache_init( &inOrder );
+	for ( uint32_t i = 0; i < frame.count; ++i )
+		submit( &unsorted, &frame.packets[i] );
+	for ( size_t i = 0; i < queue.count; ++i )
+		submit( &inOrder, r_draw_queue_get( &queue, i ) );
+
+	printf( "%u draws, %u pipelines, %u materials, best of %u runs\n", draws, pipelines, materials, repeat );
+	printf( "push %.3f ms, sort %.3f ms (%.1f ns per draw)\n\n",
+	        bench_ms( pushTime ),
+	        bench_ms( sortTime ),
+	        (double)sortTime / draws );
+	printf( "%-10s %10s %10s %10s %10s %10s\n", "order", "pipeline", "vertex", "index", "constants", "total" );
+	print_calls( "submitted", &unsorted );
+	print_calls( "sorted", &inOrder );
+	printf( "\nstate calls issued: %.1f%% of submission order\n",
+	        100.0 * (double)state_calls( &inOrder ) / (double)state_calls( &unsorted ) );
+
+	r_draw_queue_free( &queue );
+	free( frame.keys );
+	free( frame.packets );
+	return 0;
+}
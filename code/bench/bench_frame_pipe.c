@@ -0,0 +1,310 @@
+//
+// bench_frame_pipe: the game and render threads of main.c on the headless
+// backend, once one after the other on a single thread and once pipelined
+// through r_frame_pipe.h. The game side spends its simulation time and fills a
+// packet with draws, the render side sorts them, submits each packet's binds
+// and draw to the backend, spends its own CPU time and then waits for present
+// the way a swap chain blocks on the GPU. Reports ms per frame both ways, the
+// bound the pipelined one should reach (the slower side), and how often each
+// side of the pipe had to wait for the other.
+//
+// Simulation and render time are busy loops, so pipelining them needs a second
+// core; the present wait is a sleep and overlaps the game thread either way.
+//
+//   bench_frame_pipe [--frames N] [--draws N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_draw_queue.c"
+#include "../render/common/r_frame_pipe.c"
+#include "../render/backend/headless/r_headless.c"
+
+#define PIPELINES 16
+#define MESHES 64
+
+typedef struct Workload
+{
+	uint32_t simUs;
+	uint32_t renderUs;
+	uint32_t presentUs; // blocked in present, no CPU
+} Workload;
+
+typedef struct Scene
+{
+	R_Headless    *dev;
+	R_ReplayTarget target;
+	uint32_t       pipelines[PIPELINES];
+	uint32_t       vertexBuffers[MESHES];
+	uint32_t       indexBuffers[MESHES];
+	uint32_t       draws;
+} Scene;
+
+typedef struct RenderThread
+{
+	Scene          *scene;
+	R_FramePipe    *pipe;
+	const Workload *work;
+} RenderThread;
+
+static volatile uint64_t g_sink[2];
+
+static void busy( int thread, uint32_t us )
+{
+	uint64_t end = bench_now() + (uint64_t)us * 1000;
+	uint64_t x   = g_sink[thread];
+	while ( bench_now() < end )
+		for ( int i = 0; i < 64; ++i )
+			x = x * 6364136223846793005ull + 1;
+	g_sink[thread] = x;
+}
+
+static void wait_present( uint32_t us )
+{
+	if ( !us )
+		return;
+#ifdef _WIN32
+	Sleep( ( us + 999 ) / 1000 );
+#else
+	struct timespec ts = { (time_t)( us / 1000000 ), (long)( us % 1000000 ) * 1000 };
+	nanosleep( &ts, NULL );
+#endif
+}
+
+static uint32_t execute( Scene *scene, R_CaptureCall *call )
+{
+	return scene->target.execute( scene->target.self, call );
+}
+
+static bool make_scene( Scene *scene, uint32_t draws )
+{
+	memset( scene, 0, sizeof( *scene ) );
+	scene->dev = r_headless_create();
+	if ( !scene->dev )
+		return false;
+	scene->target = r_headless_replay_target( scene->dev );
+	scene->draws  = draws;
+
+	static const uint8_t vsBytecode[16] = { 'v', 's' };
+	static const uint8_t psBytecode[16] = { 'p', 's' };
+	R_CaptureCall        vs             = { .op = R_CAPTURE_CREATE_VERTEX_SHADER, .data = vsBytecode, .size = 16 };
+	R_CaptureCall        ps             = { .op = R_CAPTURE_CREATE_PIXEL_SHADER, .data = psBytecode, .size = 16 };
+	uint32_t             shaders[2]     = { execute( scene, &vs ), execute( scene, &ps ) };
+	for ( uint32_t i = 0; i < PIPELINES; ++i )
+	{
+		uint32_t blocks[10 + 24 + 13] = { 0 };
+		blocks[0]                     = i;
+
+		R_CaptureCall call  = { .op = R_CAPTURE_CREATE_PIPELINE, .refs = { shaders[0], shaders[1], 0, 0 } };
+		call.args[0]        = 10 * sizeof( uint32_t );
+		call.args[1]        = 24 * sizeof( uint32_t );
+		call.args[2]        = 13 * sizeof( uint32_t );
+		call.args[3]        = 0xffffffffu;
+		call.data           = blocks;
+		call.size           = sizeof( blocks );
+		scene->pipelines[i] = execute( scene, &call );
+	}
+
+	static float    vertices[24 * 8];
+	static uint16_t indices[36];
+	for ( uint32_t i = 0; i < MESHES; ++i )
+	{
+		R_CaptureCall vb        = { .op = R_CAPTURE_CREATE_BUFFER, .data = vertices, .size = sizeof( vertices ) };
+		R_CaptureCall ib        = { .op = R_CAPTURE_CREATE_BUFFER, .data = indices, .size = sizeof( indices ) };
+		vb.args[2]              = sizeof( vertices );
+		ib.args[2]              = sizeof( indices );
+		scene->vertexBuffers[i] = execute( scene, &vb );
+		scene->indexBuffers[i]  = execute( scene, &ib );
+	}
+	return true;
+}
+
+// The game thread's share of a frame.
+static void simulate( Scene *scene, const Workload *work, R_DrawQueue *draws, uint64_t frame )
+{
+	busy( 0, work->simUs );
+	uint64_t seed = frame + 1;
+	for ( uint32_t i = 0; i < scene->draws; ++i )
+	{
+		uint32_t     pipeline = bench_random_below( &seed, PIPELINES );
+		uint32_t     mesh     = bench_random_below( &seed, MESHES );
+		R_DrawPacket p        = { 0 };
+		p.pipeline.id         = scene->pipelines[pipeline];
+		p.vertexBuffer.id     = scene->vertexBuffers[mesh];
+		p.vertexStride        = 32;
+		p.indexBuffer.id      = scene->indexBuffers[mesh];
+		p.indexFormat         = R_HEADLESS_INDEX_R16;
+		p.indexCount          = 36;
+		float depth           = (float)bench_random_below( &seed, 1000 ) / 1000.0f;
+		r_draw_queue_push( draws, r_draw_key_make( 0, pipeline, mesh, depth ), &p );
+	}
+}
+
+// The render thread's share: what r_submit_draw_queue and r_present do, on the headless backend.
+static void render( Scene *scene, const Workload *work, R_DrawQueue *draws )
+{
+	r_draw_queue_sort( draws );
+	for ( size_t i = 0; i < draws->count; ++i )
+	{
+		const R_DrawPacket *p        = r_draw_queue_get( draws, i );
+		R_CaptureCall       pipeline = { .op = R_CAPTURE_BIND_PIPELINE, .id = p->pipeline.id };
+		R_CaptureCall       vertices = { .op = R_CAPTURE_SET_VERTEX_BUFFER, .id = p->vertexBuffer.id };
+		R_CaptureCall       indices  = { .op = R_CAPTURE_SET_INDEX_BUFFER, .id = p->indexBuffer.id };
+		R_CaptureCall       draw     = { .op = R_CAPTURE_DRAW_INDEXED };
+		vertices.args[0]             = p->vertexStride;
+		indices.args[0]              = p->indexFormat;
+		draw.args[0]                 = p->indexCount;
+		execute( scene, &pipeline );
+		execute( scene, &vertices );
+		execute( scene, &indices );
+		execute( scene, &draw );
+	}
+	busy( 1, work->renderUs );
+
+	R_CaptureCall present = { .op = R_CAPTURE_PRESENT };
+	execute( scene, &present );
+	wait_present( work->presentUs );
+}
+
+static uint64_t run_serial( Scene *scene, const Workload *work, uint32_t frames )
+{
+	R_DrawQueue draws;
+	if ( !r_draw_queue_init( &draws, scene->draws ) )
+		return 0;
+	uint64_t start = bench_now();
+	for ( uint32_t frame = 0; frame < frames; ++frame )
+	{
+		r_draw_queue_reset( &draws );
+		simulate( scene, work, &draws, frame );
+		render( scene, work, &draws );
+	}
+	uint64_t time = bench_now() - start;
+	r_draw_queue_free( &draws );
+	return time;
+}
+
+static void render_frames( void *arg )
+{
+	RenderThread  *rt = (RenderThread *)arg;
+	R_FramePacket *packet;
+	while ( ( packet = r_frame_pipe_acquire( rt->pipe ) ) )
+	{
+		render( rt->scene, rt->work, &packet->draws );
+		r_frame_pipe_release( rt->pipe );
+	}
+}
+
+static uint64_t run_pipelined( Scene *scene, const Workload *work, uint32_t frames, R_FramePipeStats *outStats )
+{
+	static R_FramePipe pipe;
+	RenderThread       rt = { scene, &pipe, work };
+	SYS_Thread         thread;
+	if ( !r_frame_pipe_init( &pipe, scene->draws, 256 ) )
+		return 0;
+	if ( !sys_thread_start( &thread, render_frames, &rt ) )
+	{
+		r_frame_pipe_free( &pipe );
+		return 0;
+	}
+
+	uint64_t start = bench_now();
+	for ( uint32_t frame = 0; frame < frames; ++frame )
+	{
+		R_FramePacket *packet = r_frame_pipe_begin( &pipe );
+		simulate( scene, work, &packet->draws, frame );
+		r_frame_pipe_submit( &pipe );
+	}
+	r_frame_pipe_close( &pipe );
+	sys_thread_join( &thread );
+	uint64_t time = bench_now() - start;
+
+	r_frame_pipe_get_stats( &pipe, outStats );
+	r_frame_pipe_free( &pipe );
+	return time;
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t frames = 300;
+	uint32_t draws  = 2000;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		if ( strcmp( argv[i], "--frames" ) == 0 )
+			frames = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--draws" ) == 0 )
+			draws = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+	}
+	if ( frames == 0 )
+	{
+		fprintf( stderr, "usage: bench_frame_pipe [--frames N (> 0)] [--draws N]\n" );
+		return 1;
+	}
+
+	Scene scene;
+	if ( !make_scene( &scene, draws ) )
+	{
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+
+	// Balanced, game bound, render bound, mostly waiting on present, and the hand-off alone.
+	static const Workload k_workloads[] = {
+		{ 4000, 1000, 3000 },
+		{ 6000, 1000, 2000 },
+		{ 2000, 2000, 4000 },
+		{ 1000, 500, 6000 },
+		{ 0, 0, 0 },
+	};
+
+	printf( "%u frames of %u draws, %d cores\n\n", frames, draws, sys_cpu_count() );
+	printf( "%6s %6s %8s %10s %10s %8s %10s %10s %8s\n",
+	        "sim",
+	        "render",
+	        "present",
+	        "serial",
+	        "pipelined",
+	        "bound",
+	        "game wait",
+	        "rend wait",
+	        "parks" );
+	for ( size_t i = 0; i < sizeof( k_workloads ) / sizeof( k_workloads[0] ); ++i )
+	{
+		const Workload  *work = &k_workloads[i];
+		R_FramePipeStats stats;
+		uint64_t         serial    = run_serial( &scene, work, frames );
+		uint64_t         pipelined = run_pipelined( &scene, work, frames, &stats );
+		if ( !serial || !pipelined )
+		{
+			fprintf( stderr, "Out of memory\n" );
+			return 1;
+		}
+
+		// Without the draws' share, which the table can't split between the two sides.
+		uint32_t game  = work->simUs;
+		uint32_t frame = work->renderUs + work->presentUs;
+		printf( "%6.1f %6.1f %8.1f %10.3f %10.3f %8.1f %10llu %10llu %8llu\n",
+		        work->simUs / 1000.0,
+		        work->renderUs / 1000.0,
+		        work->presentUs / 1000.0,
+		        bench_ms( serial ) / frames,
+		        bench_ms( pipelined ) / frames,
+		        ( game > frame ? game : frame ) / 1000.0,
+		        (unsigned long long)stats.producerStalls,
+		        (unsigned long long)stats.consumerStalls,
+		        (unsigned long long)stats.parks );
+	}
+	printf( "\nms per frame; bound: the slower side without the draws; waits: frames that found the other "
+	        "side behind\n" );
+
+	r_headless_destroy( scene.dev );
+	return 0;
+}
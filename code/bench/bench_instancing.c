@@ -0,0 +1,320 @@
+//
+// bench_instancing: a scene of many copies of a few meshes drawn through the
+// headless backend, once an object at a time (push the transform, draw) and
+// once through the instance batcher the way r_submit_instanced does it (one
+// stream write for the transforms, one instanced draw per run). Both walk the
+// draw queue in key order. Reports draws in and out, the CPU time of a frame
+// and what reached the backend. Also shows what the batcher gets out of the
+// same draws left in submission order.
+//
+//   bench_instancing [--objects N] [--meshes N] [--materials N] [--repeat N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_draw_queue.c"
+#include "../render/common/r_instancing.c"
+#include "../render/backend/headless/r_headless.c"
+
+#define BENCH_INSTANCE_SLOT 1                            // R_INSTANCE_SLOT
+#define BENCH_STREAM_BYTES ( 4u * 1024 * 1024 )          // R_INSTANCE_STREAM_SIZE
+#define BENCH_MAX_OBJECTS ( R_HEADLESS_RING_SIZE / 256 ) // one aligned push a draw has to fit the constant ring
+
+typedef struct Transform
+{
+	float m[16];
+} Transform;
+
+typedef struct Scene
+{
+	R_DrawQueue queue;
+	Transform  *transforms;
+	uint32_t    objects;
+} Scene;
+
+typedef struct Result
+{
+	uint64_t        best;
+	uint32_t        draws;
+	R_HeadlessStats stats;
+} Result;
+
+static uint32_t execute( R_ReplayTarget *target, R_CaptureCall *call )
+{
+	return target->execute( target->self, call );
+}
+
+static uint32_t create_buffer( R_ReplayTarget *target, const void *data, uint32_t bytes )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_BUFFER, .data = data, .size = bytes };
+	call.args[2]       = bytes;
+	return execute( target, &call );
+}
+
+// Meshes, constants and pipelines on the device; every packet names them by handle.
+static bool make_scene( Scene *scene, R_ReplayTarget *target, uint32_t objects, uint32_t meshes, uint32_t materials )
+{
+	static const uint8_t vsBytecode[16] = { 'v', 's' };
+	static const uint8_t psBytecode[16] = { 'p', 's' };
+	R_CaptureCall        vs             = { .op = R_CAPTURE_CREATE_VERTEX_SHADER, .data = vsBytecode, .size = 16 };
+	R_CaptureCall        ps             = { .op = R_CAPTURE_CREATE_PIXEL_SHADER, .data = psBytecode, .size = 16 };
+	uint32_t             shaders[2]     = { execute( target, &vs ), execute( target, &ps ) };
+
+	// Two pipelines, opaque and culled differently, so they don't collapse into one.
+	uint32_t pipelines[2];
+	for ( uint32_t i = 0; i < 2; ++i )
+	{
+		// The rasterizer, blend and depth-stencil blocks back to back, see R_CAPTURE_CREATE_PIPELINE.
+		uint32_t blocks[10 + 24 + 13] = { 0 };
+		blocks[1]                     = i;
+
+		R_CaptureCall call = { .op = R_CAPTURE_CREATE_PIPELINE, .refs = { shaders[0], shaders[1], 0, 0 } };
+		call.args[0]       = 10 * sizeof( uint32_t );
+		call.args[1]       = 24 * sizeof( uint32_t );
+		call.args[2]       = 13 * sizeof( uint32_t );
+		call.args[3]       = 0xffffffffu;
+		call.data          = blocks;
+		call.size          = sizeof( blocks );
+		pipelines[i]       = execute( target, &call );
+	}
+
+	uint16_t indices[36];
+	for ( uint32_t i = 0; i < 36; ++i )
+		indices[i] = (uint16_t)( i % 24 );
+	static float vertices[24 * 8];
+
+	uint32_t *vertexBuffers = (uint32_t *)malloc( meshes * sizeof( uint32_t ) );
+	uint32_t *indexBuffers  = (uint32_t *)malloc( meshes * sizeof( uint32_t ) );
+	uint32_t *constants     = (uint32_t *)malloc( materials * sizeof( uint32_t ) );
+	if ( !vertexBuffers || !indexBuffers || !constants || !r_draw_queue_init( &scene->queue, objects ) )
+		return false;
+	for ( uint32_t i = 0; i < meshes; ++i )
+	{
+		vertexBuffers[i] = create_buffer( target, vertices, sizeof( vertices ) );
+		indexBuffers[i]  = create_buffer( target, indices, sizeof( indices ) );
+	}
+	for ( uint32_t i = 0; i < materials; ++i )
+		constants[i] = create_buffer( target, vertices, 256 );
+
+	scene->objects    = objects;
+	scene->transforms = (Transform *)malloc( objects * sizeof( Transform ) );
+	if ( !scene->transforms )
+		return false;
+
+	uint64_t seed = 0x9E3779B97F4A7C15ull;
+	for ( uint32_t i = 0; i < objects; ++i )
+	{
+		uint32_t     mesh     = bench_random_below( &seed, meshes );
+		uint32_t     material = bench_random_below( &seed, materials );
+		uint32_t     pipeline = mesh % 2;
+		R_DrawPacket p        = { 0 };
+		p.pipeline.id         = pipelines[pipeline];
+		p.vertexBuffer.id     = vertexBuffers[mesh];
+		p.vertexStride        = 32;
+		p.indexBuffer.id      = indexBuffers[mesh];
+		p.indexFormat         = R_HEADLESS_INDEX_R16;
+		p.constants.id        = constants[material];
+		p.constantSlot        = 2;
+		p.indexCount          = 36;
+		for ( int k = 0; k < 16; ++k )
+			scene->transforms[i].m[k] = (float)( i + k );
+
+		// The material id groups the copies of a mesh, depth only orders them within the group.
+		float depth = (float)bench_random_below( &seed, 1000 ) / 1000.0f;
+		r_draw_queue_push( &scene->queue, r_draw_key_make( 0, pipeline, mesh * materials + material, depth ), &p );
+	}
+	r_draw_queue_sort( &scene->queue );
+
+	free( vertexBuffers );
+	free( indexBuffers );
+	free( constants );
+	return true;
+}
+
+// r_submit_draw_queue's binds for one packet, in the order the backend makes them.
+static void bind_packet( R_ReplayTarget *target, const R_DrawPacket *p )
+{
+	R_CaptureCall pipeline = { .op = R_CAPTURE_BIND_PIPELINE, .id = p->pipeline.id };
+	R_CaptureCall vertices = { .op = R_CAPTURE_SET_VERTEX_BUFFER, .id = p->vertexBuffer.id };
+	R_CaptureCall indices  = { .op = R_CAPTURE_SET_INDEX_BUFFER, .id = p->indexBuffer.id };
+	R_CaptureCall constant = { .op = R_CAPTURE_BIND_CONSTANT_BUFFER, .id = p->constants.id };
+	vertices.args[0]       = p->vertexStride;
+	indices.args[0]        = p->indexFormat;
+	constant.args[0]       = (uint32_t)p->constantSlot;
+	execute( target, &pipeline );
+	execute( target, &vertices );
+	execute( target, &indices );
+	execute( target, &constant );
+}
+
+static uint32_t draw_objects( R_ReplayTarget *target, const Scene *scene )
+{
+	for ( size_t i = 0; i < scene->queue.count; ++i )
+	{
+		const R_DrawPacket *p         = r_draw_queue_get( &scene->queue, i );
+		R_CaptureCall       transform = { .op = R_CAPTURE_PUSH_CONSTANTS };
+		R_CaptureCall       draw      = { .op = R_CAPTURE_DRAW_INDEXED };
+		bind_packet( target, p );
+		transform.args[0] = 1;
+		transform.data    = &scene->transforms[scene->queue.items[i].packet];
+		transform.size    = sizeof( Transform );
+		draw.args[0]      = p->indexCount;
+		execute( target, &transform );
+		execute( target, &draw );
+	}
+	return (uint32_t)scene->queue.count;
+}
+
+// r_submit_instanced, with the stream standing in for the dynamic instance buffer.
+static uint32_t draw_instanced( R_ReplayTarget *target, const Scene *scene, R_InstanceBatcher *batcher )
+{
+	r_instance_batcher_reset( batcher );
+	for ( size_t i = 0; i < scene->queue.count; ++i )
+	{
+		const R_DrawPacket *p = r_draw_queue_get( &scene->queue, i );
+		r_instance_batcher_push( batcher, p, &scene->transforms[scene->queue.items[i].packet] );
+	}
+
+	uint32_t stride = batcher->instanceStride;
+	uint32_t runs   = r_instance_batcher_build( batcher, BENCH_STREAM_BYTES / stride );
+	for ( uint32_t first = 0; first < runs; )
+	{
+		uint32_t start = batcher->runs[first].first;
+		uint32_t last  = first;
+		while ( last + 1 < runs &&
+		        (size_t)( batcher->runs[last + 1].first + batcher->runs[last + 1].count - start ) * stride <=
+		            BENCH_STREAM_BYTES )
+			last++;
+
+		const R_InstanceRun *end    = &batcher->runs[last];
+		R_CaptureCall        stream = { .op = R_CAPTURE_STREAM_VERTICES };
+		stream.args[0]              = BENCH_INSTANCE_SLOT;
+		stream.args[1]              = stride;
+		stream.args[3]              = 1;
+		stream.data                 = batcher->instances + (size_t)start * stride;
+		stream.size                 = ( end->first + end->count - start ) * stride;
+		execute( target, &stream );
+
+		for ( uint32_t r = first; r <= last; ++r )
+		{
+			const R_InstanceRun *run  = &batcher->runs[r];
+			const R_DrawPacket  *p    = &batcher->draws[run->first];
+			R_CaptureCall        draw = { .op = R_CAPTURE_DRAW_INDEXED_INSTANCED };
+			bind_packet( target, p );
+			draw.args[0] = p->indexCount;
+			draw.args[1] = run->count;
+			draw.args[4] = run->first - start;
+			execute( target, &draw );
+		}
+		first = last + 1;
+	}
+	return runs;
+}
+
+static Result run( R_Headless *dev, const Scene *scene, R_InstanceBatcher *batcher, uint32_t repeat )
+{
+	R_ReplayTarget target  = r_headless_replay_target( dev );
+	R_CaptureCall  present = { .op = R_CAPTURE_PRESENT };
+	Result         result  = { UINT64_MAX, 0, { 0 } };
+	for ( uint32_t i = 0; i < repeat; ++i )
+	{
+		r_headless_reset_stats( dev );
+		uint64_t start = bench_now();
+		result.draws   = batcher ? draw_instanced( &target, scene, batcher ) : draw_objects( &target, scene );
+		execute( &target, &present );
+		uint64_t time = bench_now() - start;
+		result.best   = time < result.best ? time : result.best;
+	}
+	r_headless_get_stats( dev, &result.stats );
+	return result;
+}
+
+static uint64_t state_calls( const R_HeadlessStats *stats )
+{
+	uint64_t issued = 0;
+	for ( int i = 0; i < R_STATE_CALL_COUNT; ++i )
+		issued += stats->state.issued[i];
+	return issued;
+}
+
+static void print_result( const char *name, const Result *r )
+{
+	printf( "%-10s %8u %10.3f %12llu %12llu %10llu\n",
+	        name,
+	        r->draws,
+	        bench_ms( r->best ),
+	        (unsigned long long)state_calls( &r->stats ),
+	        (unsigned long long)r->stats.bytesStreamed / 1024,
+	        (unsigned long long)r->stats.invalidDraws );
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t objects   = 10000;
+	uint32_t meshes    = 50;
+	uint32_t materials = 4;
+	uint32_t repeat    = 50;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		uint32_t value = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		if ( strcmp( argv[i], "--objects" ) == 0 )
+			objects = value;
+		else if ( strcmp( argv[i], "--meshes" ) == 0 )
+			meshes = value;
+		else if ( strcmp( argv[i], "--materials" ) == 0 )
+			materials = value;
+		else if ( strcmp( argv[i], "--repeat" ) == 0 )
+			repeat = value;
+	}
+	if ( objects == 0 || objects > BENCH_MAX_OBJECTS || meshes == 0 || materials == 0 || repeat == 0 )
+	{
+		fprintf( stderr,
+		         "usage: bench_instancing [--objects N (1..%u)] [--meshes N] [--materials N] [--repeat N]\n",
+		         BENCH_MAX_OBJECTS );
+		return 1;
+	}
+
+	R_Headless       *dev    = r_headless_create();
+	R_ReplayTarget    target = r_headless_replay_target( dev );
+	Scene             scene  = { 0 };
+	R_InstanceBatcher batcher;
+	if ( !dev || !make_scene( &scene, &target, objects, meshes, materials ) ||
+	     !r_instance_batcher_init( &batcher, sizeof( Transform ), objects ) )
+	{
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+
+	Result direct    = run( dev, &scene, NULL, repeat );
+	Result instanced = run( dev, &scene, &batcher, repeat );
+
+	// The same draws in the order they were pushed: only neighbours merge, so little does.
+	r_instance_batcher_reset( &batcher );
+	for ( uint32_t i = 0; i < scene.objects; ++i )
+		r_instance_batcher_push( &batcher, &scene.queue.packets[i], &scene.transforms[i] );
+	uint32_t unsortedRuns = r_instance_batcher_build( &batcher, 0 );
+
+	printf( "%u objects, %u meshes, %u materials, best of %u frames\n\n", objects, meshes, materials, repeat );
+	printf( "%-10s %8s %10s %12s %12s %10s\n", "", "draws", "ms", "state calls", "streamed KB", "invalid" );
+	print_result( "objects", &direct );
+	print_result( "instanced", &instanced );
+	printf( "\ndraws in %u, out %u (%.1fx fewer); unsorted the batcher would make %u\n",
+	        objects,
+	        instanced.draws,
+	        (double)objects / (double)instanced.draws,
+	        unsortedRuns );
+
+	r_instance_batcher_free( &batcher );
+	r_draw_queue_free( &scene.queue );
+	free( scene.transforms );
+	r_headless_destroy( dev );
+	return 0;
+}
@@ -0,0 +1,209 @@
+//
+// bench_mesh_optimize: the import-time reordering of r_mesh.h, stage by stage,
+// on meshes the way exporters tend to hand them out: a grid whose triangles
+// come in random order, and a UV sphere and a grid in scan order. After each
+// stage it reports ACMR and ATVR (post-transform cache) and the vertex fetch
+// overfetch, and what the stage took. The stats stand in for the vertex
+// shader and fetch work the GPU saves; meshconv prints the same ones.
+//
+//   bench_mesh_optimize [--size N] [--threshold PERCENT]
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_mesh.c"
+
+// meshconv's vertex: position, normal, UV.
+typedef struct Vertex
+{
+	float position[3];
+	float normal[3];
+	float uv[2];
+} Vertex;
+
+typedef struct Mesh
+{
+	Vertex   *vertices;
+	size_t    vertexCount;
+	uint32_t *indices;
+	size_t    indexCount;
+} Mesh;
+
+static bool mesh_alloc( Mesh *mesh, size_t vertexCount, size_t indexCount )
+{
+	mesh->vertices    = (Vertex *)calloc( vertexCount, sizeof( Vertex ) );
+	mesh->indices     = (uint32_t *)malloc( indexCount * sizeof( uint32_t ) );
+	mesh->vertexCount = vertexCount;
+	mesh->indexCount  = indexCount;
+	return mesh->vertices && mesh->indices;
+}
+
+static void mesh_free( Mesh *mesh )
+{
+	free( mesh->vertices );
+	free( mesh->indices );
+	memset( mesh, 0, sizeof( *mesh ) );
+}
+
+// A (columns + 1) x (rows + 1) lattice of vertices, two triangles per cell in scan order.
+static void lattice_indices( uint32_t *out, uint32_t columns, uint32_t rows )
+{
+	uint32_t row = columns + 1;
+	for ( uint32_t y = 0; y < rows; ++y )
+	{
+		for ( uint32_t x = 0; x < columns; ++x )
+		{
+			uint32_t a = y * row + x, b = a + 1, c = a + row, d = c + 1;
+			*out++     = a;
+			*out++     = c;
+			*out++     = b;
+			*out++     = b;
+			*out++     = c;
+			*out++     = d;
+		}
+	}
+}
+
+static bool make_grid( Mesh *mesh, uint32_t n, bool shuffled )
+{
+	uint32_t row = n + 1;
+	if ( !mesh_alloc( mesh, (size_t)row * row, (size_t)n * n * 6 ) )
+		return false;
+	for ( uint32_t i = 0; i < row * row; ++i )
+	{
+		Vertex *v      = &mesh->vertices[i];
+		v->position[0] = (float)( i % row );
+		v->position[2] = (float)( i / row );
+		v->normal[1]   = 1.0f;
+		v->uv[0]       = v->position[0] / (float)n;
+		v->uv[1]       = v->position[2] / (float)n;
+	}
+	lattice_indices( mesh->indices, n, n );
+	if ( !shuffled )
+		return true;
+
+	uint64_t seed = 42;
+	for ( size_t t = mesh->indexCount / 3 - 1; t > 0; --t )
+	{
+		size_t j = (size_t)( bench_random( &seed ) % ( t + 1 ) );
+		for ( int c = 0; c < 3; ++c )
+		{
+			uint32_t swap            = mesh->indices[t * 3 + c];
+			mesh->indices[t * 3 + c] = mesh->indices[j * 3 + c];
+			mesh->indices[j * 3 + c] = swap;
+		}
+	}
+	return true;
+}
+
+static bool make_sphere( Mesh *mesh, uint32_t segments )
+{
+	uint32_t row = segments + 1;
+	if ( !mesh_alloc( mesh, (size_t)row * row, (size_t)segments * segments * 6 ) )
+		return false;
+	for ( uint32_t i = 0; i < row * row; ++i )
+	{
+		Vertex *v      = &mesh->vertices[i];
+		float   theta  = 3.14159265f * (float)( i / row ) / (float)segments;
+		float   phi    = 6.28318531f * (float)( i % row ) / (float)segments;
+		v->position[0] = sinf( theta ) * cosf( phi );
+		v->position[1] = cosf( theta );
+		v->position[2] = sinf( theta ) * sinf( phi );
+		memcpy( v->normal, v->position, sizeof( v->normal ) );
+		v->uv[0] = (float)( i % row ) / (float)segments;
+		v->uv[1] = (float)( i / row ) / (float)segments;
+	}
+	lattice_indices( mesh->indices, segments, segments );
+	return true;
+}
+
+static void print_stage( const char *stage, const Mesh *mesh, uint64_t ns )
+{
+	const uint32_t  *indices  = mesh->indices;
+	size_t           count    = mesh->indexCount;
+	size_t           vertices = mesh->vertexCount;
+	R_MeshCacheStats cache    = r_mesh_analyze_vertex_cache( indices, count, vertices, R_MESH_ANALYZE_CACHE_SIZE );
+	R_MeshFetchStats fetch    = r_mesh_analyze_vertex_fetch( indices, count, vertices, sizeof( Vertex ) );
+	printf( "  %-14s %8.3f %8.3f %10.3f %10.3f\n", stage, cache.acmr, cache.atvr, fetch.overfetch, bench_ms( ns ) );
+}
+
+static bool run( const char *name, Mesh *mesh, float threshold )
+{
+	printf( "%s: %zu triangles, %zu vertices\n", name, mesh->indexCount / 3, mesh->vertexCount );
+	printf( "  %-14s %8s %8s %10s %10s\n", "", "ACMR", "ATVR", "overfetch", "ms" );
+	print_stage( "as loaded", mesh, 0 );
+
+	uint64_t start = bench_now();
+	if ( !r_mesh_optimize_vertex_cache( mesh->indices, mesh->indexCount, mesh->vertexCount ) )
+		return false;
+	print_stage( "vertex cache", mesh, bench_now() - start );
+
+	start = bench_now();
+	if ( !r_mesh_optimize_overdraw( mesh->indices,
+	                                mesh->indexCount,
+	                                mesh->vertices,
+	                                mesh->vertexCount,
+	                                sizeof( Vertex ),
+	                                threshold ) )
+		return false;
+	print_stage( "overdraw", mesh, bench_now() - start );
+
+	start       = bench_now();
+	size_t used = r_mesh_optimize_vertex_fetch( mesh->vertices,
+	                                            mesh->vertexCount,
+	                                            sizeof( Vertex ),
+	                                            mesh->indices,
+	                                            mesh->indexCount );
+	if ( !used )
+		return false;
+	mesh->vertexCount = used;
+	print_stage( "vertex fetch", mesh, bench_now() - start );
+	printf( "\n" );
+	return true;
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t size    = 512;
+	uint32_t percent = 105;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		if ( strcmp( argv[i], "--size" ) == 0 )
+			size = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--threshold" ) == 0 )
+			percent = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+	}
+	if ( size < 2 || size > 4096 || percent < 100 )
+	{
+		fprintf( stderr, "usage: bench_mesh_optimize [--size N (2..4096)] [--threshold PERCENT (>= 100)]\n" );
+		return 1;
+	}
+
+	// The overdraw pass may give back percent - 100 of the cache order's ACMR.
+	float threshold = (float)percent / 100.0f;
+	printf( "%u post-transform cache entries, %u byte fetch lines, %zu byte vertices, overdraw threshold %.2f\n\n",
+	        R_MESH_ANALYZE_CACHE_SIZE,
+	        R_MESH_FETCH_LINE_BYTES,
+	        sizeof( Vertex ),
+	        threshold );
+
+	Mesh mesh = { 0 };
+	bool ok   = make_grid( &mesh, size, true ) && run( "shuffled grid", &mesh, threshold );
+	mesh_free( &mesh );
+	ok = ok && make_grid( &mesh, size, false ) && run( "grid, scan order", &mesh, threshold );
+	mesh_free( &mesh );
+	ok = ok && make_sphere( &mesh, size / 2 ) && run( "sphere, scan order", &mesh, threshold );
+	mesh_free( &mesh );
+	if ( !ok )
+	{
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,276 @@
+//
+// bench_obj: the parallel OBJ reader (r_obj.h) on 1, 4 and 16 threads against
+// tinyobj_loader_c, the single-threaded loader it replaced. The OBJ is either
+// the given file or a generated one: a height field lattice with positions,
+// texcoords and normals, its faces written as v/vt/vn quads the way exporters
+// write them. Reports the best of --runs parses in ms and MB/s, the speedup
+// over tinyobj, and whether every triangle corner names the same elements with
+// the same values in both.
+//
+// A file gets at most one thread per R_OBJ_MIN_CHUNK_BYTES, so 16 threads need
+// at least 4 MB; the threads column shows how many chunks a run was cut into.
+//
+//   bench_obj [--file PATH] [--size N] [--runs N]
+//
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../base/c_file.c"
+#include "../base/c_thread.c"
+#include "../render/common/r_obj.c"
+
+#define TINYOBJ_LOADER_C_IMPLEMENTATION
+#include "../extern/tinyobj_loader_c.h"
+
+typedef struct Text
+{
+	char  *data;
+	size_t size;
+	size_t capacity;
+} Text;
+
+static bool text_printf( Text *text, const char *format, ... )
+{
+	if ( text->capacity - text->size < 256 )
+	{
+		size_t capacity = text->capacity ? text->capacity * 2 : 1 << 20;
+		char  *data     = (char *)realloc( text->data, capacity );
+		if ( !data )
+			return false;
+		text->data     = data;
+		text->capacity = capacity;
+	}
+	va_list args;
+	va_start( args, format );
+	text->size += (size_t)vsnprintf( text->data + text->size, text->capacity - text->size, format, args );
+	va_end( args );
+	return true;
+}
+
+// (n + 1) x (n + 1) vertices of a rolling height field, one quad per cell.
+static bool make_lattice( Text *text, uint32_t n )
+{
+	uint32_t row = n + 1;
+	bool     ok  = text_printf( text, "# %u x %u lattice\no lattice\n", row, row );
+	for ( uint32_t i = 0; ok && i < row * row; ++i )
+	{
+		float x = (float)( i % row ) / (float)n;
+		float z = (float)( i / row ) / (float)n;
+		float y = 0.1f * sinf( 12.0f * x ) * cosf( 9.0f * z );
+		ok      = text_printf( text, "v %.6f %.6f %.6f\n", x, y, z );
+	}
+	for ( uint32_t i = 0; ok && i < row * row; ++i )
+		ok = text_printf( text, "vt %.6f %.6f\n", (float)( i % row ) / (float)n, (float)( i / row ) / (float)n );
+	for ( uint32_t i = 0; ok && i < row * row; ++i )
+	{
+		// The height field's slope, y = 0.1 sin(12x) cos(9z).
+		float x      = (float)( i % row ) / (float)n;
+		float z      = (float)( i / row ) / (float)n;
+		float dx     = 1.2f * cosf( 12.0f * x ) * cosf( 9.0f * z );
+		float dz     = -0.9f * sinf( 12.0f * x ) * sinf( 9.0f * z );
+		float length = sqrtf( dx * dx + 1.0f + dz * dz );
+		ok           = text_printf( text, "vn %.6f %.6f %.6f\n", -dx / length, 1.0f / length, -dz / length );
+	}
+	for ( uint32_t y = 0; ok && y < n; ++y )
+	{
+		for ( uint32_t x = 0; ok && x < n; ++x )
+		{
+			uint32_t a = y * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+			ok         = text_printf( text, "f %u/%u/%u %u/%u/%u", a, a, a, c, c, c );
+			ok         = ok && text_printf( text, " %u/%u/%u %u/%u/%u\n", d, d, d, b, b, b );
+		}
+	}
+	return ok;
+}
+
+// tinyobj reads the OBJ through a callback; hand it the buffer, and no material libraries.
+typedef struct Source
+{
+	const char *data;
+	size_t      size;
+} Source;
+
+static void read_source( void *ctx, const char *name, int isMtl, const char *objName, char **data, size_t *size )
+{
+	const Source *source = (const Source *)ctx;
+	(void)name;
+	(void)objName;
+	*data = isMtl ? NULL : (char *)source->data;
+	*size = isMtl ? 0 : source->size;
+}
+
+static bool same_floats( const float *a, const float *b, size_t count )
+{
+	for ( size_t i = 0; i < count; ++i )
+	{
+		if ( fabsf( a[i] - b[i] ) > 1e-6f * fabsf( b[i] ) + 1e-30f )
+			return false;
+	}
+	return true;
+}
+
+// tinyobj keeps one index triple per corner of the triangulated faces, in file order, like r_obj.
+static bool same_mesh( const R_ObjMesh *mesh, const tinyobj_attrib_t *attrib )
+{
+	if ( mesh->cornerCount != attrib->num_faces || mesh->positionCount != attrib->num_vertices ||
+	     mesh->texcoordCount != attrib->num_texcoords || mesh->normalCount != attrib->num_normals )
+		return false;
+	for ( size_t i = 0; i < mesh->cornerCount; ++i )
+	{
+		const R_ObjCorner            *c = &mesh->corners[i];
+		const tinyobj_vertex_index_t *f = &attrib->faces[i];
+		if ( c->position != f->v_idx || c->texcoord != ( f->vt_idx < 0 ? -1 : f->vt_idx ) ||
+		     c->normal != ( f->vn_idx < 0 ? -1 : f->vn_idx ) )
+			return false;
+	}
+	return same_floats( mesh->positions, attrib->vertices, 3 * mesh->positionCount ) &&
+	       same_floats( mesh->texcoords, attrib->texcoords, 2 * mesh->texcoordCount ) &&
+	       same_floats( mesh->normals, attrib->normals, 3 * mesh->normalCount );
+}
+
+static void print_row( const char *parser, uint32_t asked, uint32_t threads, uint64_t ns, size_t size, uint64_t base )
+{
+	printf( "%-8s %6u %8u %10.1f %10.1f %10.2f",
+	        parser,
+	        asked,
+	        threads,
+	        bench_ms( ns ),
+	        (double)size / 1e6 / ( (double)ns / 1e9 ),
+	        (double)base / (double)ns );
+}
+
+int main( int argc, char **argv )
+{
+	const char *path = NULL;
+	uint32_t    size = 512;
+	uint32_t    runs = 3;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		if ( strcmp( argv[i], "--file" ) == 0 )
+			path = argv[i + 1];
+		else if ( strcmp( argv[i], "--size" ) == 0 )
+			size = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--runs" ) == 0 )
+			runs = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+	}
+	if ( size < 1 || size > 4096 || runs == 0 )
+	{
+		fprintf( stderr, "usage: bench_obj [--file PATH] [--size N (1..4096)] [--runs N (> 0)]\n" );
+		return 1;
+	}
+
+	Source     source  = { 0 };
+	Text       text    = { 0 };
+	IO_File    file    = { 0 };
+	IO_Mapping mapping = { 0 };
+	if ( path )
+	{
+		if ( !io_file_open( &file, path, false ) || !io_file_map( &file, (size_t)io_file_size( &file ), &mapping ) )
+		{
+			fprintf( stderr, "Can't map %s\n", path );
+			return 1;
+		}
+		source.data = (const char *)mapping.data;
+		source.size = mapping.size;
+	}
+	else
+	{
+		if ( !make_lattice( &text, size ) )
+		{
+			fprintf( stderr, "Out of memory\n" );
+			return 1;
+		}
+		source.data = text.data;
+		source.size = text.size;
+	}
+
+	// tinyobj's result stays around for the comparison.
+	tinyobj_attrib_t    attrib;
+	tinyobj_shape_t    *shapes    = NULL;
+	tinyobj_material_t *materials = NULL;
+	size_t              shapeCount, materialCount;
+	uint64_t            base = UINT64_MAX;
+	for ( uint32_t run = 0; run < runs; ++run )
+	{
+		if ( run )
+		{
+			tinyobj_attrib_free( &attrib );
+			tinyobj_shapes_free( shapes, shapeCount );
+			tinyobj_materials_free( materials, materialCount );
+		}
+		uint64_t start = bench_now();
+		int      error = tinyobj_parse_obj( &attrib,
+		                                    &shapes,
+		                                    &shapeCount,
+		                                    &materials,
+		                                    &materialCount,
+		                                    path ? path : "lattice.obj",
+		                                    read_source,
+		                                    &source,
+		                                    TINYOBJ_FLAG_TRIANGULATE );
+		uint64_t time  = bench_now() - start;
+		if ( error != TINYOBJ_SUCCESS )
+		{
+			fprintf( stderr, "tinyobj can't parse the file (%d)\n", error );
+			return 1;
+		}
+		base = time < base ? time : base;
+	}
+
+	printf( "%s: %.1f MB, %u vertices, %u triangles, %d cores, best of %u\n\n",
+	        path ? path : "generated lattice",
+	        (double)source.size / 1e6,
+	        attrib.num_vertices,
+	        attrib.num_faces / 3,
+	        sys_cpu_count(),
+	        runs );
+	printf( "%-8s %6s %8s %10s %10s %10s %s\n", "parser", "asked", "threads", "ms", "MB/s", "speedup", "  same" );
+	print_row( "tinyobj", 1, 1, base, source.size, base );
+	printf( "\n" );
+
+	int                   status      = 0;
+	static const uint32_t k_threads[] = { 1, 4, 16 };
+	for ( size_t i = 0; i < sizeof( k_threads ) / sizeof( k_threads[0] ); ++i )
+	{
+		R_ObjMesh mesh = { 0 };
+		uint64_t  best = UINT64_MAX;
+		bool      ok   = true;
+		for ( uint32_t run = 0; ok && run < runs; ++run )
+		{
+			r_obj_free( &mesh );
+			uint64_t start = bench_now();
+			ok             = r_obj_parse( source.data, source.size, k_threads[i], &mesh );
+			uint64_t time  = bench_now() - start;
+			best           = time < best ? time : best;
+		}
+		if ( !ok )
+		{
+			fprintf( stderr, "r_obj can't parse the file on %u threads\n", k_threads[i] );
+			status = 1;
+			break;
+		}
+		bool same = same_mesh( &mesh, &attrib );
+		print_row( "r_obj", k_threads[i], mesh.threads, best, source.size, base );
+		printf( "  %s\n", same ? "yes" : "NO" );
+		status |= !same;
+		r_obj_free( &mesh );
+	}
+	printf( "\nspeedup: tinyobj's time over r_obj's; same: every corner has the same indices and values\n" );
+
+	tinyobj_attrib_free( &attrib );
+	tinyobj_shapes_free( shapes, shapeCount );
+	tinyobj_materials_free( materials, materialCount );
+	if ( path )
+	{
+		io_file_unmap( &mapping );
+		io_file_close( &file );
+	}
+	free( text.data );
+	return status;
+}
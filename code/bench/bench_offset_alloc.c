@@ -0,0 +1,200 @@
+//
+// bench_offset_alloc: mesh churn on the TLSF offset allocator (r_offset_alloc.h)
+// the geometry heaps use, with and without the incremental compaction of
+// r_defragment_geometry. Meshes of log-uniform sizes keep the heap near a
+// target fill while rounds of them are destroyed and loaded again. Reports the
+// cost of an alloc and a free, how often an allocation failed although enough
+// units were free in total, and how broken up the free space ends.
+//
+//   bench_offset_alloc [--units N] [--fill PERCENT] [--rounds N] [--budget UNITS]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_offset_alloc.c"
+
+#define MIN_MESH 64
+#define MAX_MESH_LOG2 16 // meshes stay under 64K units
+#define MAX_MESHES 65536
+#define CHURN_PER_ROUND 64
+
+typedef struct Mesh
+{
+	R_OffsetAllocation range;
+	uint32_t           size;
+} Mesh;
+
+typedef struct Result
+{
+	uint64_t           allocNs;
+	uint64_t           freeNs;
+	uint64_t           defragNs;
+	uint64_t           allocs;
+	uint64_t           frees;
+	uint64_t           failures;     // no room at all
+	uint64_t           fragmented;   // failed with freeStorage >= size
+	uint64_t           unitsMoved;
+	uint64_t           regionsTotal; // summed per round for the average
+	R_OffsetAllocStats end;
+} Result;
+
+static Mesh     g_meshes[MAX_MESHES];
+static uint32_t g_meshCount;
+
+static uint32_t mesh_size( uint64_t *seed )
+{
+	uint32_t log2 = 6 + bench_random_below( seed, MAX_MESH_LOG2 - 6 );
+	uint32_t base = 1u << log2;
+	return base + bench_random_below( seed, base );
+}
+
+static bool load_mesh( R_OffsetAllocator *a, uint32_t size, Result *r )
+{
+	uint64_t           start = bench_now();
+	R_OffsetAllocation range = r_offset_alloc( a, size );
+	r->allocNs += bench_now() - start;
+	r->allocs++;
+	if ( range.offset == R_OFFSET_ALLOC_NONE )
+	{
+		r->failures++;
+		r->fragmented += a->freeStorage >= size;
+		return false;
+	}
+	g_meshes[g_meshCount++] = ( Mesh ){ range, size };
+	return true;
+}
+
+// r_move_mesh_range without the copy.
+static uint32_t move_down( R_OffsetAllocator *a, Mesh *mesh )
+{
+	R_OffsetAllocation moved = r_offset_alloc( a, mesh->size );
+	if ( moved.offset == R_OFFSET_ALLOC_NONE )
+		return 0;
+	if ( moved.offset >= mesh->range.offset )
+	{
+		r_offset_free( a, moved );
+		return 0;
+	}
+	r_offset_free( a, mesh->range );
+	mesh->range = moved;
+	return mesh->size;
+}
+
+static Result run( uint32_t units, uint32_t fill, uint32_t rounds, uint32_t budget )
+{
+	Result            r = { 0 };
+	R_OffsetAllocator a;
+	if ( !r_offset_alloc_init( &a, units, MAX_MESHES ) )
+		return r;
+
+	uint64_t seed   = 42;
+	uint64_t target = (uint64_t)units * fill / 100;
+	g_meshCount     = 0;
+	while ( units - a.freeStorage < target && g_meshCount < MAX_MESHES / 2 )
+		if ( !load_mesh( &a, mesh_size( &seed ), &r ) )
+			break;
+
+	uint32_t cursor = 0;
+	for ( uint32_t round = 0; round < rounds; ++round )
+	{
+		// Unload some meshes, then load new ones until the fill is back.
+		for ( uint32_t n = 0; n < CHURN_PER_ROUND && g_meshCount; ++n )
+		{
+			uint32_t i     = bench_random_below( &seed, g_meshCount );
+			uint64_t start = bench_now();
+			r_offset_free( &a, g_meshes[i].range );
+			r.freeNs += bench_now() - start;
+			r.frees++;
+			g_meshes[i] = g_meshes[--g_meshCount];
+		}
+		for ( uint32_t tries = 0; units - a.freeStorage < target && tries < 4 * CHURN_PER_ROUND; ++tries )
+			load_mesh( &a, mesh_size( &seed ), &r );
+
+		// One frame's worth of compaction, resuming where the last one stopped.
+		uint64_t start = bench_now();
+		uint32_t moved = 0;
+		uint32_t n     = 0;
+		for ( ; n < g_meshCount && moved < budget; ++n )
+			moved += move_down( &a, &g_meshes[( cursor + n ) % g_meshCount] );
+		cursor = g_meshCount ? ( cursor + n ) % g_meshCount : 0;
+		r.defragNs += bench_now() - start;
+		r.unitsMoved += moved;
+
+		R_OffsetAllocStats stats;
+		r_offset_alloc_get_stats( &a, &stats );
+		r.regionsTotal += stats.freeRegions;
+	}
+
+	r_offset_alloc_get_stats( &a, &r.end );
+	r_offset_alloc_free( &a );
+	return r;
+}
+
+static void print_result( const char *name, const Result *r, uint32_t rounds )
+{
+	printf( "%-10s %9.1f %9.1f %8.1f%% %8.1f%% %9.0f %9.2f %11.0f %9.3f\n",
+	        name,
+	        r->allocs ? (double)r->allocNs / (double)r->allocs : 0.0,
+	        r->frees ? (double)r->freeNs / (double)r->frees : 0.0,
+	        r->allocs ? 100.0 * (double)r->failures / (double)r->allocs : 0.0,
+	        r->allocs ? 100.0 * (double)r->fragmented / (double)r->allocs : 0.0,
+	        (double)r->regionsTotal / rounds,
+	        r->end.freeStorage ? (double)r->end.largestFree / (double)r->end.freeStorage : 0.0,
+	        (double)r->unitsMoved / rounds,
+	        bench_ms( r->defragNs ) / rounds );
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t units  = 1u << 24;
+	uint32_t fill   = 85;
+	uint32_t rounds = 2000;
+	uint32_t budget = 1u << 16;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		if ( strcmp( argv[i], "--units" ) == 0 )
+			units = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--fill" ) == 0 )
+			fill = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--rounds" ) == 0 )
+			rounds = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--budget" ) == 0 )
+			budget = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+	}
+	if ( units < ( 1u << MAX_MESH_LOG2 ) * 4 || fill == 0 || fill > 99 || rounds == 0 || budget == 0 )
+	{
+		fprintf( stderr,
+		         "usage: bench_offset_alloc [--units N (>= %u)] [--fill PERCENT (1..99)] [--rounds N] "
+		         "[--budget UNITS]\n",
+		         ( 1u << MAX_MESH_LOG2 ) * 4 );
+		return 1;
+	}
+
+	Result plain   = run( units, fill, rounds, 0 );
+	Result compact = run( units, fill, rounds, budget );
+	printf( "%u units filled to %u%%, meshes of %u..%u units, %u rounds of %u unloads\n\n",
+	        units,
+	        fill,
+	        MIN_MESH,
+	        ( 1u << MAX_MESH_LOG2 ) - 1,
+	        rounds,
+	        CHURN_PER_ROUND );
+	printf( "%-10s %9s %9s %9s %9s %9s %9s %11s %9s\n",
+	        "",
+	        "ns/alloc",
+	        "ns/free",
+	        "failed",
+	        "frag",
+	        "regions",
+	        "largest",
+	        "moved/rnd",
+	        "ms/rnd" );
+	print_result( "no defrag", &plain, rounds );
+	print_result( "defrag", &compact, rounds );
+	printf( "\nfrag: failed with enough units free in total; largest: largest free bin / free units at the end\n" );
+	return 0;
+}
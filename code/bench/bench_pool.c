@@ -0,0 +1,180 @@
+//
+// bench_pool: handle pool churn (r_pool.h) against the malloc'd wrappers the
+// pools replaced. Both keep the same number of objects alive, a buffer-sized
+// record each, and go through the same rounds of random destroys and creates,
+// handle lookups and a pass over every live object.
+//
+//   bench_pool [--live N] [--rounds N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_pool.c"
+
+// What a malloc'd R_Buffer wrapper held: the D3D object, its size and its flags.
+typedef struct Object
+{
+	void    *resource;
+	size_t   size;
+	uint32_t flags;
+	uint32_t stride;
+} Object;
+
+typedef struct Timings
+{
+	uint64_t churn;
+	uint64_t lookup;
+	uint64_t iterate;
+	uint64_t checksum; // keeps the work from being optimized out
+} Timings;
+
+static Timings run_pool( uint32_t live, uint32_t rounds )
+{
+	Timings   t       = { 0 };
+	R_Pool    pool;
+	Object   *objects = (Object *)calloc( 2 * live, sizeof( Object ) );
+	uint32_t *handles = (uint32_t *)malloc( live * sizeof( uint32_t ) );
+	if ( !objects || !handles || !r_pool_init( &pool, 2 * live ) )
+	{
+		free( objects );
+		free( handles );
+		return t;
+	}
+
+	uint32_t dense, moved;
+	for ( uint32_t i = 0; i < live; ++i )
+	{
+		handles[i]            = r_pool_alloc( &pool, &dense );
+		objects[dense].size   = i;
+		objects[dense].stride = 16;
+	}
+
+	uint64_t seed = 42;
+	for ( uint32_t round = 0; round < rounds; ++round )
+	{
+		// A tenth of the objects are destroyed and created again.
+		uint64_t start = bench_now();
+		for ( uint32_t n = 0; n < live / 10; ++n )
+		{
+			uint32_t i = bench_random_below( &seed, live );
+			r_pool_release( &pool, handles[i], &dense, &moved );
+			objects[dense] = objects[moved];
+			handles[i]     = r_pool_alloc( &pool, &dense );
+			objects[dense] = ( Object ){ NULL, n, 0, 16 };
+		}
+		uint64_t churned = bench_now();
+
+		for ( uint32_t n = 0; n < live; ++n )
+			t.checksum += objects[r_pool_lookup( &pool, handles[bench_random_below( &seed, live )] )].size;
+		uint64_t looked = bench_now();
+
+		for ( uint32_t i = 0; i < pool.count; ++i )
+			t.checksum += objects[i].size * objects[i].stride;
+		uint64_t iterated = bench_now();
+
+		t.churn += churned - start;
+		t.lookup += looked - churned;
+		t.iterate += iterated - looked;
+	}
+
+	r_pool_free( &pool );
+	free( objects );
+	free( handles );
+	return t;
+}
+
+static Timings run_malloc( uint32_t live, uint32_t rounds )
+{
+	Timings  t       = { 0 };
+	Object **objects = (Object **)malloc( live * sizeof( Object * ) );
+	if ( !objects )
+		return t;
+
+	// Some unrelated allocations in between, the way a real heap interleaves them.
+	void **noise = (void **)malloc( live * sizeof( void * ) );
+	for ( uint32_t i = 0; i < live; ++i )
+	{
+		objects[i]         = (Object *)calloc( 1, sizeof( Object ) );
+		objects[i]->size   = i;
+		objects[i]->stride = 16;
+		noise[i]           = malloc( 16 + i % 200 );
+	}
+
+	uint64_t seed = 42;
+	for ( uint32_t round = 0; round < rounds; ++round )
+	{
+		uint64_t start = bench_now();
+		for ( uint32_t n = 0; n < live / 10; ++n )
+		{
+			uint32_t i = bench_random_below( &seed, live );
+			free( objects[i] );
+			objects[i]  = (Object *)malloc( sizeof( Object ) );
+			*objects[i] = ( Object ){ NULL, n, 0, 16 };
+		}
+		uint64_t churned = bench_now();
+
+		for ( uint32_t n = 0; n < live; ++n )
+			t.checksum += objects[bench_random_below( &seed, live )]->size;
+		uint64_t looked = bench_now();
+
+		// The wrappers have no dense array, iterating them means following every pointer.
+		for ( uint32_t i = 0; i < live; ++i )
+			t.checksum += objects[i]->size * objects[i]->stride;
+		uint64_t iterated = bench_now();
+
+		t.churn += churned - start;
+		t.lookup += looked - churned;
+		t.iterate += iterated - looked;
+	}
+
+	for ( uint32_t i = 0; i < live; ++i )
+	{
+		free( objects[i] );
+		free( noise[i] );
+	}
+	free( objects );
+	free( noise );
+	return t;
+}
+
+static void print_timings( const char *name, const Timings *t, uint32_t live, uint32_t rounds )
+{
+	double churns = (double)( live / 10 ) * rounds;
+	double visits = (double)live * rounds;
+	printf( "%-8s %14.2f %14.2f %14.2f\n",
+	        name,
+	        (double)t->churn / churns,
+	        (double)t->lookup / visits,
+	        (double)t->iterate / visits );
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t live   = 8192;
+	uint32_t rounds = 200;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		if ( strcmp( argv[i], "--live" ) == 0 )
+			live = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--rounds" ) == 0 )
+			rounds = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+	}
+	if ( live < 10 || live > R_POOL_MAX_CAPACITY / 2 || rounds == 0 )
+	{
+		fprintf( stderr, "usage: bench_pool [--live N (10..%u)] [--rounds N]\n", R_POOL_MAX_CAPACITY / 2 );
+		return 1;
+	}
+
+	Timings pool = run_pool( live, rounds );
+	Timings heap = run_malloc( live, rounds );
+	printf( "%u live objects, %u rounds of %u destroy/create pairs\n\n", live, rounds, live / 10 );
+	printf( "%-8s %14s %14s %14s\n", "", "ns/recreate", "ns/lookup", "ns/visit" );
+	print_timings( "pool", &pool, live, rounds );
+	print_timings( "malloc", &heap, live, rounds );
+	printf( "\n(checksums %llu %llu)\n", (unsigned long long)pool.checksum, (unsigned long long)heap.checksum );
+	return 0;
+}
@@ -0,0 +1,231 @@
+//
+// bench_upload: a level load's worth of static buffers against the headless
+// backend, uploaded the old way (one buffer update each, all in the frame
+// that asks for them) and through the upload queue the way r_flush_uploads
+// does it (the pieces of a frame packed into one staging buffer under the
+// frame budget, then one buffer copy each). Reports the total CPU time, the
+// worst frame and how many frames the queue spreads the load over. The queue
+// copies every byte twice more, so it costs more in total; what it buys is a
+// worst frame bounded by the budget instead of by the size of the level.
+//
+//   bench_upload [--buffers N] [--budget KB] [--repeat N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_upload.c"
+#include "../render/backend/headless/r_headless.c"
+
+#define BENCH_RING_BYTES ( 32u * 1024 * 1024 ) // R_UPLOAD_RING_SIZE in the D3D11 backend
+#define BENCH_MAX_PIECES 256                   // R_UPLOAD_MAX_BATCH
+
+typedef struct Result
+{
+	uint64_t total;
+	uint64_t worstFrame;
+	size_t   worstBytes;
+	uint32_t frames;
+	uint64_t calls;
+} Result;
+
+static uint32_t create_buffer( R_ReplayTarget *target, uint32_t bytes )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_BUFFER };
+	call.args[2]       = bytes;
+	return target->execute( target->self, &call );
+}
+
+static void present( R_ReplayTarget *target )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_PRESENT };
+	target->execute( target->self, &call );
+}
+
+static void end_frame( Result *r, uint64_t start, size_t bytes )
+{
+	uint64_t time = bench_now() - start;
+	r->total += time;
+	r->worstFrame = time > r->worstFrame ? time : r->worstFrame;
+	r->worstBytes = bytes > r->worstBytes ? bytes : r->worstBytes;
+	r->frames++;
+}
+
+static Result run_direct( R_ReplayTarget *target,
+                          const uint32_t *buffers,
+                          const uint32_t *sizes,
+                          uint32_t        count,
+                          const uint8_t  *data )
+{
+	Result   r     = { 0 };
+	uint64_t start = bench_now();
+	size_t   bytes = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_UPDATE_BUFFER, .id = buffers[i], .data = data, .size = sizes[i] };
+		target->execute( target->self, &call );
+		bytes += sizes[i];
+		r.calls++;
+	}
+	present( target );
+	end_frame( &r, start, bytes );
+	return r;
+}
+
+static Result run_queued( R_ReplayTarget *target,
+                          R_UploadQueue  *queue,
+                          const uint32_t *buffers,
+                          const uint32_t *sizes,
+                          uint32_t        count,
+                          const uint8_t  *data,
+                          size_t          budget )
+{
+	Result   r       = { 0 };
+	uint8_t *packed  = (uint8_t *)malloc( budget );
+	uint32_t staging = create_buffer( target, (uint32_t)budget );
+	if ( !packed || !staging )
+	{
+		free( packed );
+		return r;
+	}
+	memset( packed, 0, budget );
+
+	R_UploadPiece pieces[BENCH_MAX_PIECES];
+	uint32_t      next = 0;
+	while ( next < count || queue->count )
+	{
+		uint64_t start = bench_now();
+
+		// The frame asks for everything that's left; what doesn't fit in the ring waits for a later frame.
+		while ( next < count && r_upload_queue_push( queue, buffers[next], 0, data, sizes[next], NULL, NULL ) )
+			next++;
+
+		uint32_t n      = r_upload_queue_gather( queue, budget, pieces, BENCH_MAX_PIECES );
+		uint32_t offset = 0;
+		for ( uint32_t i = 0; i < n; ++i )
+		{
+			memcpy( packed + offset, pieces[i].data, pieces[i].size );
+			offset += pieces[i].size;
+		}
+
+		// The Map of the staging buffer, then a CopySubresourceRegion per piece.
+		R_CaptureCall map = { .op = R_CAPTURE_UPDATE_BUFFER, .id = staging, .data = packed, .size = offset };
+		target->execute( target->self, &map );
+		offset = 0;
+		for ( uint32_t i = 0; i < n; ++i )
+		{
+			R_CaptureCall copy = { .op = R_CAPTURE_COPY_BUFFER, .id = pieces[i].target, .refs = { staging } };
+			copy.args[0]       = pieces[i].dstOffset;
+			copy.args[1]       = offset;
+			copy.args[2]       = pieces[i].size;
+			target->execute( target->self, &copy );
+			offset += pieces[i].size;
+		}
+		r_upload_queue_complete( queue );
+		r.calls += 1 + n;
+
+		present( target );
+		end_frame( &r, start, offset );
+	}
+
+	free( packed );
+	return r;
+}
+
+static void print_result( const char *name, const Result *r, uint32_t repeat )
+{
+	printf( "%-8s %10.3f %12.3f %12.1f %8u %10llu\n",
+	        name,
+	        bench_ms( r->total ) / repeat,
+	        bench_ms( r->worstFrame ),
+	        (double)r->worstBytes / 1024.0,
+	        r->frames / repeat,
+	        (unsigned long long)( r->calls / repeat ) );
+}
+
+static void accumulate( Result *sum, const Result *r )
+{
+	sum->total += r->total;
+	sum->worstFrame = r->worstFrame > sum->worstFrame ? r->worstFrame : sum->worstFrame;
+	sum->worstBytes = r->worstBytes > sum->worstBytes ? r->worstBytes : sum->worstBytes;
+	sum->frames += r->frames;
+	sum->calls += r->calls;
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t count  = 4000;
+	uint32_t budget = 4096; // KB, R_UPLOAD_FRAME_BUDGET
+	uint32_t repeat = 5;
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		if ( strcmp( argv[i], "--buffers" ) == 0 )
+			count = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--budget" ) == 0 )
+			budget = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+		else if ( strcmp( argv[i], "--repeat" ) == 0 )
+			repeat = (uint32_t)strtoul( argv[i + 1], NULL, 10 );
+	}
+	if ( count == 0 || budget == 0 || budget > 256 * 1024 || repeat == 0 )
+	{
+		fprintf( stderr, "usage: bench_upload [--buffers N] [--budget KB (1..262144)] [--repeat N]\n" );
+		return 1;
+	}
+
+	// Vertex and index buffers of 4 to 64 KB, the size of most static meshes.
+	uint32_t *sizes   = (uint32_t *)malloc( count * sizeof( uint32_t ) );
+	uint32_t *buffers = (uint32_t *)malloc( count * sizeof( uint32_t ) );
+	uint8_t  *data    = (uint8_t *)malloc( 64 * 1024 );
+
+	// The backend keeps its ring for the whole run, so its pages are already there when a load starts.
+	R_UploadQueue *queue = (R_UploadQueue *)malloc( sizeof( R_UploadQueue ) );
+	if ( !sizes || !buffers || !data || !queue || !r_upload_queue_init( queue, BENCH_RING_BYTES ) )
+		return 1;
+	memset( queue->ring, 0, queue->capacity );
+
+	uint64_t seed  = 0x9E3779B97F4A7C15ull;
+	uint64_t total = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		sizes[i] = 4096 + bench_random_below( &seed, 60 * 1024 );
+		total += sizes[i];
+	}
+	for ( uint32_t i = 0; i < 64 * 1024; ++i )
+		data[i] = (uint8_t)bench_random( &seed );
+
+	Result direct = { 0 }, queued = { 0 };
+	for ( uint32_t round = 0; round < repeat; ++round )
+	{
+		R_Headless    *dev    = r_headless_create();
+		R_ReplayTarget target = r_headless_replay_target( dev );
+		for ( uint32_t i = 0; i < count; ++i )
+			buffers[i] = create_buffer( &target, sizes[i] );
+
+		// An untimed pass first, which faults in the memory of the new buffers for both runs.
+		Result r = run_direct( &target, buffers, sizes, count, data );
+		r        = run_direct( &target, buffers, sizes, count, data );
+		accumulate( &direct, &r );
+		r = run_queued( &target, queue, buffers, sizes, count, data, (size_t)budget * 1024 );
+		accumulate( &queued, &r );
+		r_headless_destroy( dev );
+	}
+
+	printf( "%u buffers, %.1f MB, %u KB budget per frame\n\n", count, (double)total / ( 1024.0 * 1024.0 ), budget );
+	printf( "%-8s %10s %12s %12s %8s %10s\n", "", "total ms", "worst ms", "worst KB", "frames", "calls" );
+	print_result( "direct", &direct, repeat );
+	print_result( "queued", &queued, repeat );
+
+	r_upload_queue_free( queue );
+	free( queue );
+	free( sizes );
+	free( buffers );
+	free( data );
+	return 0;
+}
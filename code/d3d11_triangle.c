@@ -20,7 +20,14 @@
 #define HANDMADE_MATH_NO_SSE
 #include "code/extern/hmmath.h"
 
+#include "code/base/c_file.c"
 #include "code/base/c_string.c"
+#include "code/base/c_thread.c"
+#include "code/render/common/r_draw_queue.c"
+#include "code/render/common/r_frame_pipe.c"
+#include "code/render/common/r_hash.c"
+#include "code/render/common/r_mesh.c"
+#include "code/render/common/r_mesh_file.c"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "code/extern/stb_image.h"
@@ -236,10 +243,9 @@ HRESULT D3D11_Init();
 HRESULT D3D11_SetupPipeline();
 void    D3D11_CleanupDevice();
 
-void R_Frame( HWND hWnd, float deltaTime );
-
-#define TINYOBJ_LOADER_C_IMPLEMENTATION
-#include "code/extern/tinyobj_loader_c.h"
+void G_Frame( HWND hWnd, float deltaTime, R_FramePacket *packet );
+void R_Frame( const R_FramePacket *packet );
+void R_RenderThread( void *arg );
 
 Vertex _vertices[] = {
     // { -0.5f, -0.5f, -0.5f }, // 0: left-bottom-back
@@ -312,78 +318,8 @@ Vertex _vertices[] = {
   };
 // clang-format on
 
-Vertex         *vertices = NULL;
-unsigned short *indices  = NULL;
-
-size_t vertex_count = 0;
-size_t index_count  = 0;
-
-static void *mmap_file_win( size_t *out_len, const char *filename )
-{
-	HANDLE hFile =
-	    CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
-
-	if ( hFile == INVALID_HANDLE_VALUE )
-	{
-		fprintf( stderr, "CreateFileA failed for %s\n", filename );
-		*out_len = 0;
-		return NULL;
-	}
-
-	DWORD fileSize = GetFileSize( hFile, NULL );
-	if ( fileSize == INVALID_FILE_SIZE )
-	{
-		fprintf( stderr, "GetFileSize failed\n" );
-		CloseHandle( hFile );
-		*out_len = 0;
-		return NULL;
-	}
-
-	HANDLE hMap = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
-
-	if ( !hMap )
-	{
-		fprintf( stderr, "CreateFileMappingA failed\n" );
-		CloseHandle( hFile );
-		*out_len = 0;
-		return NULL;
-	}
-
-	void *mappedData = MapViewOfFile( hMap, FILE_MAP_READ, 0, 0, 0 );
-
-	if ( !mappedData )
-	{
-		fprintf( stderr, "MapViewOfFile failed\n" );
-		CloseHandle( hMap );
-		CloseHandle( hFile );
-		*out_len = 0;
-		return NULL;
-	}
-
-	CloseHandle( hMap );
-	CloseHandle( hFile );
-
-	*out_len = (size_t)fileSize;
-	return mappedData;
-}
-
-static void
-get_file_data( void *ctx, const char *filename, const int is_mtl, const char *obj_filename, char **data, size_t *len )
-{
-	(void)ctx;
-	(void)is_mtl;
-	(void)obj_filename;
-
-	if ( !filename )
-	{
-		fprintf( stderr, "null filename\n" );
-		*data = NULL;
-		*len  = 0;
-		return;
-	}
-
-	*data = mmap_file_win( len, filename );
-}
+// The mesh as meshconv wrote it, mapped: the GPU buffers are created straight from it.
+R_MeshFile mesh = { 0 };
 
 int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
@@ -411,85 +347,25 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLin
 	AllocConsole();
 	freopen( "CONOUT$", "w", stdout );
 
-	unsigned int        flags = TINYOBJ_FLAG_TRIANGULATE;
-	size_t              num_materials;
-	tinyobj_material_t *materials;
-	size_t              num_shapes;
-	tinyobj_shape_t    *shapes;
-	tinyobj_attrib_t    attrib;
-
-	int ret = tinyobj_parse_obj( &attrib,
-	                             &shapes,
-	                             &num_shapes,
-	                             &materials,
-	                             &num_materials,
-	                             ".\\DEER\\deer.obj",
-	                             get_file_data,
-	                             NULL,
-	                             flags );
-	if ( ret != TINYOBJ_SUCCESS )
-	{
-		return 0;
-	}
-
-	size_t num_triangles = attrib.num_face_num_verts;
-	size_t face_offset   = 0;
-
-	size_t total_face_verts = 0;
-	for ( size_t i = 0; i < attrib.num_face_num_verts; i++ )
-	{
-		total_face_verts += attrib.face_num_verts[i];
-	}
-
-	printf( "Total Face Vert %zd\n", total_face_verts );
-
-	vertices = (Vertex *)malloc( sizeof( Vertex ) * total_face_verts );
-	indices  = (unsigned short *)malloc( sizeof( unsigned short ) * total_face_verts );
-
-	if ( !vertices || !indices )
+	// Vertex is the layout meshconv writes.
+	uint64_t      layoutHash = r_mesh_file_layout_hash( R_MESH_FILE_LAYOUT_PNT, sizeof( Vertex ) );
+	LARGE_INTEGER loadStart, loadEnd, loadFrequency;
+	QueryPerformanceFrequency( &loadFrequency );
+	QueryPerformanceCounter( &loadStart );
+	if ( !r_mesh_file_open( &mesh, ".\\DEER\\deer.rmesh", layoutHash ) )
 	{
-		printf( "Failed to allocate memory\n" );
+		printf( "Can't open DEER\\deer.rmesh, convert deer.obj with meshconv first\n" );
 		return 1;
 	}
+	QueryPerformanceCounter( &loadEnd );
 
-	for ( size_t f = 0; f < attrib.num_face_num_verts; f++ )
-	{
-		int fv = attrib.face_num_verts[f];
-
-		for ( int v = 0; v < fv; v++ )
-		{
-			if ( ( face_offset + v ) >= total_face_verts )
-			{
-				printf( "Invalid face index access\n" );
-				free( vertices );
-				free( indices );
-				return 1;
-			}
-
-			tinyobj_vertex_index_t idx = attrib.faces[face_offset + v];
-
-			float vx = attrib.vertices[3 * idx.v_idx + 0];
-			float vy = attrib.vertices[3 * idx.v_idx + 1];
-			float vz = attrib.vertices[3 * idx.v_idx + 2];
-
-			float nx = attrib.vertices[3 * idx.vn_idx + 0];
-			float ny = attrib.vertices[3 * idx.vn_idx + 1];
-			float nz = attrib.vertices[3 * idx.vn_idx + 2];
-
-			float tx = 0.0f, ty = 0.0f;
-			if ( idx.vt_idx >= 0 )
-			{
-				tx = attrib.texcoords[2 * idx.vt_idx + 0];
-				ty = attrib.texcoords[2 * idx.vt_idx + 1];
-			}
-
-			vertices[vertex_count] = (Vertex){ vx, vy, vz, nx, ny, nz, tx, ty };
-			indices[index_count++] = (unsigned short)vertex_count;
-			vertex_count++;
-		}
-
-		face_offset += fv;
-	}
+	const R_MeshFileHeader *meshHeader = mesh.view.header;
+	printf( "Mapped %llu vertices, %llu %u-bit indices, %u submeshes in %.3f ms\n",
+	        (unsigned long long)meshHeader->vertexCount,
+	        (unsigned long long)meshHeader->indexCount,
+	        meshHeader->indexSize * 8,
+	        meshHeader->submeshCount,
+	        (double)( loadEnd.QuadPart - loadStart.QuadPart ) * 1000.0 / (double)loadFrequency.QuadPart );
 
 	// memset( vertices, 0, vertex_count * sizeof( Vertex ) );
 	// memset( indices, 0, index_count * sizeof( unsigned short ) );
@@ -501,9 +377,12 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLin
 	QueryPerformanceFrequency( &frequency );
 	QueryPerformanceCounter( &lastCounter );
 
-	if ( SUCCEEDED( D3D11_Init() ) )
+	// The window and the simulation stay on this thread, the immediate context goes to the render thread.
+	static R_FramePipe pipe;
+	SYS_Thread         renderThread;
+	if ( SUCCEEDED( D3D11_Init() ) && r_frame_pipe_init( &pipe, 16, 64 * 1024 ) )
 	{
-		if ( SUCCEEDED( D3D11_SetupPipeline() ) )
+		if ( SUCCEEDED( D3D11_SetupPipeline() ) && sys_thread_start( &renderThread, R_RenderThread, &pipe ) )
 		{
 			ShowWindow( g_hWnd, nCmdShow );
 
@@ -519,14 +398,20 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLin
 					DispatchMessage( &msg );
 				}
 
-				R_Frame( g_hWnd, deltaTime );
+				R_FramePacket *packet = r_frame_pipe_begin( &pipe );
+				G_Frame( g_hWnd, deltaTime, packet );
+				r_frame_pipe_submit( &pipe );
 			}
+
+			r_frame_pipe_close( &pipe );
+			sys_thread_join( &renderThread );
 		}
 	}
 
 	while ( 1 )
 		;
 	D3D11_CleanupDevice();
+	r_mesh_file_close( &mesh );
 
 	UnregisterClass( pClassName, wc.hInstance );
 	return 0;
@@ -557,6 +442,13 @@ typedef struct
 	float padding[3];
 } CLightBuffer;
 
+// Everything R_Frame uploads, built by G_Frame into the frame packet.
+typedef struct
+{
+	CUniformBuffer transforms;
+	CLightBuffer   lights;
+} FrameConstants;
+
 static float time = 0.0f;
 
 void UpdateMouseLook( HWND hWnd )
@@ -589,7 +481,7 @@ void UpdateMouseLook( HWND hWnd )
 	cameraFront   = HMM_NormV3( cameraFront );
 }
 
-void R_Frame( HWND hWnd, float deltaTime )
+void G_Frame( HWND hWnd, float deltaTime, R_FramePacket *packet )
 {
 	time += 0.01f;
 
@@ -640,6 +532,40 @@ void R_Frame( HWND hWnd, float deltaTime )
 	cb.viewPos        = HMM_MulM4V4( view, HMM_V4( cameraPos.X, cameraPos.Y, cameraPos.Z, 1.0f ) ).XYZ;
 	cb.normalMatrix   = HMM_TransposeM4( HMM_InvGeneralM4( model ) );
 
+	Light lights[] = {
+	    { HMM_V3( 0.0f, 2.5f, 0.0f ), 4.0f, HMM_V3( 1.0f, 1.0f, 1.0f ), 0.0f }, // Front
+	    // { HMM_V3( 2.0f, 0.5f, 0.0f ), 1.0f, HMM_V3( 1.0f, 0.0f, 0.0f ), 0.0f },   // Right
+	    // { HMM_V3( -2.0f, 0.5f, 0.0f ), 1.0f, HMM_V3( 0.0f, 1.0f, 0.0f ), 0.0f },  // Left
+	    // { HMM_V3( 0.0f, 2.0f, 0.0f ), 1.0f, HMM_V3( 0.0f, 0.0f, 1.0f ), 0.0f },   // Top
+	    // { HMM_V3( 0.0f, 0.5f, -2.0f ), 1.0f, HMM_V3( 1.0f, 1.0f, 0.5f ), 0.0f }, // Behind/below
+	};
+
+	FrameConstants constants    = { 0 };
+	constants.transforms        = cb;
+	constants.lights.lightCount = ARRAY_COUNT( lights );
+	memcpy( constants.lights.lights, lights, sizeof( lights ) );
+
+	// === Frame Packet ===
+	R_FrameView camera = { 0 };
+	memcpy( camera.view, &view, sizeof( camera.view ) );
+	memcpy( camera.projection, &proj, sizeof( camera.projection ) );
+	camera.position[0] = cameraPos.X;
+	camera.position[1] = cameraPos.Y;
+	camera.position[2] = cameraPos.Z;
+	camera.position[3] = 1.0f;
+
+	packet->time      = time;
+	packet->deltaTime = deltaTime;
+	r_frame_packet_add_view( packet, &camera );
+	r_frame_packet_push_constants( packet, &constants, sizeof( constants ) );
+}
+
+void R_Frame( const R_FramePacket *packet )
+{
+	const FrameConstants *constants = (const FrameConstants *)r_frame_packet_constants( packet, 0 );
+	if ( !constants )
+		return;
+
 	// === Update Constant Buffer ===
 	D3D11_MAPPED_SUBRESOURCE mappedResourceUbo;
 	if ( SUCCEEDED( g_pImmediateContext->lpVtbl->Map( g_pImmediateContext,
@@ -649,23 +575,10 @@ void R_Frame( HWND hWnd, float deltaTime )
 	                                                  0,
 	                                                  &mappedResourceUbo ) ) )
 	{
-		memcpy( mappedResourceUbo.pData, &cb, sizeof( cb ) );
+		memcpy( mappedResourceUbo.pData, &constants->transforms, sizeof( constants->transforms ) );
 		g_pImmediateContext->lpVtbl->Unmap( g_pImmediateContext, (ID3D11Resource *)g_pCBufferTransforms, 0 );
 	}
 
-	Light lights[] = {
-	    { HMM_V3( 0.0f, 2.5f, 0.0f ), 4.0f, HMM_V3( 1.0f, 1.0f, 1.0f ), 0.0f }, // Front
-	    // { HMM_V3( 2.0f, 0.5f, 0.0f ), 1.0f, HMM_V3( 1.0f, 0.0f, 0.0f ), 0.0f },   // Right
-	    // { HMM_V3( -2.0f, 0.5f, 0.0f ), 1.0f, HMM_V3( 0.0f, 1.0f, 0.0f ), 0.0f },  // Left
-	    // { HMM_V3( 0.0f, 2.0f, 0.0f ), 1.0f, HMM_V3( 0.0f, 0.0f, 1.0f ), 0.0f },   // Top
-	    // { HMM_V3( 0.0f, 0.5f, -2.0f ), 1.0f, HMM_V3( 1.0f, 1.0f, 0.5f ), 0.0f }, // Behind/below
-	};
-
-	CLightBuffer lightBuffer = { 0 };
-	lightBuffer.lightCount   = ARRAY_COUNT( lights );
-
-	memcpy( lightBuffer.lights, lights, sizeof( lights ) );
-
 	D3D11_MAPPED_SUBRESOURCE mapped;
 	if ( SUCCEEDED( g_pImmediateContext->lpVtbl->Map( g_pImmediateContext,
 	                                                  (ID3D11Resource *)g_pCBufferLights,
@@ -674,7 +587,7 @@ void R_Frame( HWND hWnd, float deltaTime )
 	                                                  0,
 	                                                  &mapped ) ) )
 	{
-		memcpy( mapped.pData, &lightBuffer, sizeof( lightBuffer ) );
+		memcpy( mapped.pData, &constants->lights, sizeof( constants->lights ) );
 		g_pImmediateContext->lpVtbl->Unmap( g_pImmediateContext, (ID3D11Resource *)g_pCBufferLights, 0 );
 	}
 
@@ -693,10 +606,30 @@ void R_Frame( HWND hWnd, float deltaTime )
 
 	g_pImmediateContext->lpVtbl->VSSetShader( g_pImmediateContext, g_pVertexShader, NULL, 0 );
 	g_pImmediateContext->lpVtbl->PSSetShader( g_pImmediateContext, g_pPixelShader, NULL, 0 );
-	g_pImmediateContext->lpVtbl->DrawIndexed( g_pImmediateContext, index_count, 0, 0 );
+	for ( uint32_t i = 0; i < mesh.view.header->submeshCount; ++i )
+	{
+		const R_Submesh *sub = &mesh.view.submeshes[i].range;
+		g_pImmediateContext->lpVtbl->DrawIndexed( g_pImmediateContext,
+		                                          sub->indexCount,
+		                                          sub->startIndex,
+		                                          sub->baseVertex );
+	}
 	g_pSwapChain->lpVtbl->Present( g_pSwapChain, 0, 0 );
 }
 
+// Sole user of the immediate context and the swap chain while it runs: the game thread only writes frame
+// packets, and D3D11_CleanupDevice waits for the join.
+void R_RenderThread( void *arg )
+{
+	R_FramePipe   *pipe = (R_FramePipe *)arg;
+	R_FramePacket *packet;
+	while ( ( packet = r_frame_pipe_acquire( pipe ) ) )
+	{
+		R_Frame( packet );
+		r_frame_pipe_release( pipe );
+	}
+}
+
 HRESULT D3D11_Init()
 {
 	HRESULT hr = S_OK;
@@ -954,12 +887,12 @@ HRESULT D3D11_SetupPipeline()
 
 	D3D11_BUFFER_DESC vboDesc = { 0 };
 	vboDesc.Usage             = D3D11_USAGE_DEFAULT;
-	vboDesc.ByteWidth         = sizeof( Vertex ) * vertex_count;
+	vboDesc.ByteWidth         = sizeof( Vertex ) * (UINT)mesh.view.header->vertexCount;
 	vboDesc.BindFlags         = D3D11_BIND_VERTEX_BUFFER;
 	vboDesc.CPUAccessFlags    = 0;
 
 	D3D11_SUBRESOURCE_DATA initalVertexData = { 0 };
-	initalVertexData.pSysMem                = vertices;
+	initalVertexData.pSysMem                = mesh.view.vertices;
 
 	hr = g_pd3dDevice->lpVtbl->CreateBuffer( g_pd3dDevice, &vboDesc, &initalVertexData, &g_pVertexBuffer );
 	if ( FAILED( hr ) )
@@ -967,12 +900,12 @@ HRESULT D3D11_SetupPipeline()
 
 	D3D11_BUFFER_DESC iboDesc = { 0 };
 	iboDesc.Usage             = D3D11_USAGE_DEFAULT;
-	iboDesc.ByteWidth         = sizeof( unsigned short ) * index_count;
+	iboDesc.ByteWidth         = mesh.view.header->indexSize * (UINT)mesh.view.header->indexCount;
 	iboDesc.BindFlags         = D3D11_BIND_INDEX_BUFFER;
 	iboDesc.CPUAccessFlags    = 0;
 
 	D3D11_SUBRESOURCE_DATA initalIndexData = { 0 };
-	initalIndexData.pSysMem                = indices;
+	initalIndexData.pSysMem                = mesh.view.indices;
 
 	hr = g_pd3dDevice->lpVtbl->CreateBuffer( g_pd3dDevice, &iboDesc, &initalIndexData, &g_pIndexBuffer );
 	if ( FAILED( hr ) )
@@ -983,7 +916,8 @@ HRESULT D3D11_SetupPipeline()
 	UINT stride = sizeof( Vertex );
 	UINT offset = 0;
 	g_pImmediateContext->lpVtbl->IASetVertexBuffers( g_pImmediateContext, 0, 1, &g_pVertexBuffer, &stride, &offset );
-	g_pImmediateContext->lpVtbl->IASetIndexBuffer( g_pImmediateContext, g_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0 );
+	DXGI_FORMAT indexFormat = mesh.view.header->indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	g_pImmediateContext->lpVtbl->IASetIndexBuffer( g_pImmediateContext, g_pIndexBuffer, indexFormat, 0 );
 	g_pImmediateContext->lpVtbl->IASetPrimitiveTopology( g_pImmediateContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
 	D3D11_RASTERIZER_DESC rastDesc = {
@@ -21,18 +21,67 @@ static LRESULT CALLBACK wnd_proc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 	return DefWindowProc( hWnd, msg, wParam, lParam );
 }
 
+typedef struct TrianglePass
+{
+	R_Pipeline           pipe;
+	R_Buffer             vb;
+	Geometry2D_Transform transform;
+} TrianglePass;
+
+static void draw_triangle( void *user, void *context )
+{
+	TrianglePass *pass = (TrianglePass *)user;
+	R_Context    *ctx  = (R_Context *)context;
+
+	r_bind_pipeline( ctx, pass->pipe );
+	r_push_constants( ctx, &pass->transform, sizeof( pass->transform ), 0 );
+	r_set_vertex_buffer( ctx, pass->vb, sizeof( Geometry2D_Vertex ), 0 );
+	r_set_primitive_topology( ctx, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+	r_draw( ctx, 3, 0 );
+}
+
+static R_FrameGraph frameGraph;
+static R_FramePipe  framePipe;
+
+typedef struct RenderThread
+{
+	SYS_Thread    thread;
+	R_Context    *ctx;
+	TrianglePass *triangle;
+} RenderThread;
+
+// Owns the context from start to join; the game thread only touches frame packets meanwhile. Every
+// resource is created before the thread starts and destroyed after the join, never from the game loop.
+static void render_frames( void *arg )
+{
+	RenderThread  *rt = (RenderThread *)arg;
+	R_FramePacket *packet;
+	r_take_context( rt->ctx );
+	while ( ( packet = r_frame_pipe_acquire( &framePipe ) ) )
+	{
+		// The triangle's transform is the first thing the game thread pushes.
+		const void *transform = r_frame_packet_constants( packet, 0 );
+		if ( transform )
+			memcpy( &rt->triangle->transform, transform, sizeof( rt->triangle->transform ) );
+
+		r_execute_frame_graph( rt->ctx, &frameGraph );
+		r_present( rt->ctx );
+		r_frame_pipe_release( &framePipe );
+	}
+}
+
 int WINAPI WinMain( HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpCmdLine, int nCmdShow )
 {
 	HWND            hwnd       = NULL;
 	R_Context      *ctx        = NULL;
-	R_Buffer       *vb         = NULL;
-	R_Buffer       *cb         = NULL;
+	R_Buffer        vb         = { 0 };
 	void           *vsByteCode = NULL;
 	void           *psByteCode = NULL;
-	R_VertexShader *vs         = NULL;
-	R_PixelShader  *ps         = NULL;
-	R_InputLayout  *il         = NULL;
-	R_Pipeline     *pipe       = NULL;
+	R_VertexShader  vs         = { 0 };
+	R_PixelShader   ps         = { 0 };
+	R_InputLayout   il         = { 0 };
+	R_Pipeline      pipe       = { 0 };
+	RenderThread    render     = { 0 };
 
 	PWindowDescriptor wndDesc = {
 	    .hInst         = hInst,
@@ -66,19 +115,12 @@ int WINAPI WinMain( HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpCmdLine, int nCmdS
 	};
 
 	vb = r_create_buffer( ctx, verts, sizeof( verts ), false, D3D11_BIND_VERTEX_BUFFER, &result );
-	if ( !vb )
+	if ( !vb.id )
 	{
 		MessageBox( hwnd, "Failed to create vertex buffer", "Error", MB_OK );
 		goto cleanup;
 	}
 
-	cb = r_create_constant_buffer( ctx, sizeof( Geometry2D_Transform ), &result );
-	if ( !cb )
-	{
-		MessageBox( hwnd, "Failed to create constant buffer", "Error", MB_OK );
-		goto cleanup;
-	}
-
 	size_t vsByteCodeLength;
 	vsByteCode = io_read_bin_content( "vertex.cso", &vsByteCodeLength );
 	if ( !vsByteCode )
@@ -96,14 +138,14 @@ int WINAPI WinMain( HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpCmdLine, int nCmdS
 	}
 
 	vs = r_create_vertex_shader_from_bytecode( ctx, vsByteCode, vsByteCodeLength, &result );
-	if ( !vs )
+	if ( !vs.id )
 	{
 		MessageBox( hwnd, "Failed to create vertex shader", "Error", MB_OK );
 		goto cleanup;
 	}
 
 	ps = r_create_pixel_shader_from_bytecode( ctx, psByteCode, psByteCodeLength, &result );
-	if ( !ps )
+	if ( !ps.id )
 	{
 		MessageBox( hwnd, "Failed to create pixel shader", "Error", MB_OK );
 		goto cleanup;
@@ -111,19 +153,46 @@ int WINAPI WinMain( HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpCmdLine, int nCmdS
 
 	uint32_t descCount = Geometry2D_Vertex_desc_count;
 	il                 = r_create_input_layout( ctx, Geometry2D_Vertex_desc, descCount, vs, &result );
-	if ( !il )
+	if ( !il.id )
 	{
 		MessageBox( hwnd, "Failed to create input layout", "Error", MB_OK );
 		goto cleanup;
 	}
 
-	pipe = r_create_pipeline( ctx, vs, ps, il, &result );
-	if ( !pipe )
+	R_PipelineDesc pipeDesc;
+	r_pipeline_desc_init( &pipeDesc, vs, ps, il );
+	pipeDesc.depthStencil.DepthEnable = FALSE;
+
+	pipe = r_create_pipeline( ctx, &pipeDesc, &result );
+	if ( !pipe.id )
 	{
 		MessageBox( hwnd, "Failed to create pipeline", "Error", MB_OK );
 		goto cleanup;
 	}
 
+	// The frame's passes never change, so the graph is built and compiled once.
+	TrianglePass triangle     = { pipe, vb };
+	float        clearColor[] = { 0.1f, 0.1f, 0.2f, 1.0f };
+
+	r_fg_reset( &frameGraph );
+	R_FgResource backbuffer   = r_graph_import_backbuffer( ctx, &frameGraph, clearColor );
+	uint32_t     trianglePass = r_fg_add_pass( &frameGraph, "triangle", draw_triangle, &triangle );
+	r_fg_write( &frameGraph, trianglePass, backbuffer );
+	if ( !r_fg_compile( &frameGraph ) )
+	{
+		MessageBox( hwnd, "Failed to compile frame graph", "Error", MB_OK );
+		goto cleanup;
+	}
+
+	// From here on the render thread submits frame N while this one builds frame N+1.
+	render.ctx      = ctx;
+	render.triangle = &triangle;
+	if ( !r_frame_pipe_init( &framePipe, 16, 4096 ) || !sys_thread_start( &render.thread, render_frames, &render ) )
+	{
+		MessageBox( hwnd, "Failed to start render thread", "Error", MB_OK );
+		goto cleanup;
+	}
+
 	DWORD startTime = GetTickCount();
 	MSG   msg       = { 0 };
 
@@ -134,37 +203,37 @@ int WINAPI WinMain( HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpCmdLine, int nCmdS
 			DispatchMessage( &msg );
 		}
 
-		DWORD currentTime = GetTickCount();
-		float time        = ( currentTime - startTime ) / 1000.0f;
+		R_FramePacket *packet      = r_frame_pipe_begin( &framePipe );
+		DWORD          currentTime = GetTickCount();
+		float          time        = ( currentTime - startTime ) / 1000.0f;
 
 		Geometry2D_Transform transform = {
 		    .time    = time,
 		    .scale   = 0.8f + 0.2f * sinf( time * 0.5f ),
 		    .padding = { 0, 0 },
 		};
-		r_update_buffer( ctx, cb, &transform, sizeof( transform ) );
-
-		r_clear_render_target( ctx, 0.1f, 0.1f, 0.2f, 1.0f );
-		r_bind_pipeline( ctx, pipe );
-		r_bind_constant_buffer( ctx, cb, 0 );
-		r_set_vertex_buffer( ctx, vb, sizeof( Geometry2D_Vertex ), 0 );
-		r_set_primitive_topology( ctx, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-		r_draw( ctx, 3, 0 );
-		r_present( ctx );
+
+		packet->time = time;
+		r_frame_packet_push_constants( packet, &transform, sizeof( transform ) );
+		r_frame_pipe_submit( &framePipe );
 	}
 
+	r_frame_pipe_close( &framePipe );
+	sys_thread_join( &render.thread );
+	r_take_context( ctx );
+
 cleanup:
-	r_destroy_pipeline( pipe );
+	r_frame_pipe_free( &framePipe );
+	r_destroy_pipeline( ctx, pipe );
 
-	r_destroy_input_layout( il );
-	r_destroy_vertex_shader( vs );
-	r_destroy_pixel_shader( ps );
+	r_destroy_input_layout( ctx, il );
+	r_destroy_vertex_shader( ctx, vs );
+	r_destroy_pixel_shader( ctx, ps );
 
 	free( vsByteCode );
 	free( psByteCode );
 
-	r_destroy_buffer( cb );
-	r_destroy_buffer( vb );
+	r_destroy_buffer( ctx, vb );
 	r_destroy_context( ctx );
 
 	return 0;
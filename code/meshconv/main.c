@@ -0,0 +1,141 @@
+//
+// meshconv: converts an OBJ to the binary mesh format (r_mesh_file.h) that
+// loads without parsing. Runs the same import stages the OBJ loader did at
+// startup: weld, vertex cache / overdraw / vertex fetch order, then the split
+// into submeshes with 16-bit indices (32-bit ones with --32). Prints what the
+// reordering did to ACMR, ATVR and vertex fetch overfetch (r_mesh.h).
+//
+// The OBJ is parsed on --threads threads, one per CPU by default (r_obj.h).
+//
+//   meshconv <in.obj> <out.rmesh> [--32] [--threads N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../base/c_file.c"
+#include "../base/c_thread.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_mesh.c"
+#include "../render/common/r_mesh_file.c"
+#include "../render/common/r_obj.c"
+
+// One vertex per face corner, in face order.
+static R_MeshFileVertex *read_corners( const R_ObjMesh *obj )
+{
+	size_t            count   = obj->cornerCount ? obj->cornerCount : 1;
+	R_MeshFileVertex *corners = (R_MeshFileVertex *)calloc( count, sizeof( R_MeshFileVertex ) );
+	if ( !corners )
+		return NULL;
+
+	for ( size_t i = 0; i < obj->cornerCount; ++i )
+	{
+		const R_ObjCorner *c      = &obj->corners[i];
+		R_MeshFileVertex  *corner = &corners[i];
+		memcpy( corner->position, &obj->positions[3 * (size_t)c->position], sizeof( corner->position ) );
+		if ( c->normal >= 0 )
+			memcpy( corner->normal, &obj->normals[3 * (size_t)c->normal], sizeof( corner->normal ) );
+		if ( c->texcoord >= 0 )
+			memcpy( corner->uv, &obj->texcoords[2 * (size_t)c->texcoord], sizeof( corner->uv ) );
+	}
+	return corners;
+}
+
+int main( int argc, char **argv )
+{
+	const char     *input   = NULL;
+	const char     *output  = NULL;
+	R_MeshIndexMode mode    = R_MESH_SPLIT_16;
+	uint32_t        threads = 0;
+	bool            usage   = argc < 3;
+
+	for ( int i = 1; i < argc && !usage; ++i )
+	{
+		if ( strcmp( argv[i], "--32" ) == 0 )
+			mode = R_MESH_FALLBACK_32;
+		else if ( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc )
+			threads = (uint32_t)strtoul( argv[++i], NULL, 10 );
+		else if ( !input && argv[i][0] != '-' )
+			input = argv[i];
+		else if ( !output && argv[i][0] != '-' )
+			output = argv[i];
+		else
+			usage = true;
+	}
+	if ( usage || !input || !output )
+	{
+		fprintf( stderr, "usage: meshconv <in.obj> <out.rmesh> [--32] [--threads N]\n" );
+		return 1;
+	}
+
+	IO_File    file;
+	IO_Mapping mapping = { 0 };
+	R_ObjMesh  obj;
+	if ( !io_file_open( &file, input, false ) || !io_file_map( &file, (size_t)io_file_size( &file ), &mapping ) ||
+	     !r_obj_parse( (const char *)mapping.data, mapping.size, threads, &obj ) )
+	{
+		fprintf( stderr, "Can't parse %s\n", input );
+		return 1;
+	}
+	io_file_unmap( &mapping );
+	io_file_close( &file );
+
+	size_t            corners  = obj.cornerCount;
+	R_MeshFileVertex *vertices = read_corners( &obj );
+	uint32_t         *indices  = (uint32_t *)malloc( ( corners ? corners : 1 ) * sizeof( uint32_t ) );
+	r_obj_free( &obj );
+
+	int         status = 1;
+	R_MeshBuild mesh   = { 0 };
+	size_t      stride = sizeof( R_MeshFileVertex );
+	size_t      count  = 0;
+	if ( vertices && indices && corners )
+		count = r_mesh_weld( vertices, corners, stride, vertices, indices, NULL );
+	if ( !count )
+	{
+		fprintf( stderr, "%s has no triangles, or we're out of memory\n", input );
+		goto done;
+	}
+
+	R_MeshCacheStats before      = r_mesh_analyze_vertex_cache( indices, corners, count, R_MESH_ANALYZE_CACHE_SIZE );
+	R_MeshFetchStats fetchBefore = r_mesh_analyze_vertex_fetch( indices, corners, count, stride );
+	if ( r_mesh_optimize_vertex_cache( indices, corners, count ) &&
+	     r_mesh_optimize_overdraw( indices, corners, vertices, count, stride, 1.05f ) )
+	{
+		size_t used = r_mesh_optimize_vertex_fetch( vertices, count, stride, indices, corners );
+		count       = used ? used : count;
+	}
+	R_MeshCacheStats after      = r_mesh_analyze_vertex_cache( indices, corners, count, R_MESH_ANALYZE_CACHE_SIZE );
+	R_MeshFetchStats fetchAfter = r_mesh_analyze_vertex_fetch( indices, corners, count, stride );
+
+	size_t size  = 0;
+	void  *image = NULL;
+	if ( r_mesh_build( vertices, count, stride, indices, corners, mode, &mesh ) )
+		image = r_mesh_file_encode( &mesh, vertices, r_mesh_file_layout_hash( R_MESH_FILE_LAYOUT_PNT, stride ), &size );
+	if ( !image || !r_mesh_file_save( output, image, size ) )
+	{
+		fprintf( stderr, "Can't write %s\n", output );
+		free( image );
+		goto done;
+	}
+	free( image );
+
+	printf( "%s: %zu triangles, %zu corners welded into %zu vertices\n", input, corners / 3, corners, count );
+	printf( "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overfetch %.3f -> %.3f\n",
+	        input,
+	        before.acmr,
+	        after.acmr,
+	        before.atvr,
+	        after.atvr,
+	        fetchBefore.overfetch,
+	        fetchAfter.overfetch );
+	printf( "%s: %u submeshes, %u-bit indices, %zu bytes\n", output, mesh.submeshCount, mesh.indexSize * 8, size );
+	status = 0;
+
+done:
+	r_mesh_build_free( &mesh );
+	free( vertices );
+	free( indices );
+	return status;
+}
@@ -1,12 +1,267 @@
 #include "../api.h"
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#include "../../common/r_state_cache.c"
+#include "../../common/r_draw_queue.c"
+#include "../../common/r_ring_alloc.c"
+#include "../../common/r_pool.c"
+#include "../../common/r_hash.c"
+#include "../../common/r_dxbc.c"
+#include "../../common/r_shader_cache.c"
+#include "../../common/r_shader_jobs.c"
+#include "../../common/r_upload.c"
+#include "../../common/r_frame_graph.c"
+#include "../../common/r_instancing.c"
+#include "../../common/r_batch2d.c"
+#include "../../common/r_release_queue.c"
+#include "../../common/r_capture.c"
+#include "../../common/r_offset_alloc.c"
+#include "../../common/r_bundle.c"
+#include "../../common/r_bind_group.c"
+#include "../../common/r_state_objects.c"
+#include "../../common/r_precache.c"
+#include "../../common/r_frame_pipe.c"
+#include "../../../base/c_file.c"
+#include "../../../base/c_thread.c"
+
 #pragma comment( lib, "d3d11.lib" )
 #pragma comment( lib, "d3dcompiler.lib" )
 #pragma comment( lib, "dxgi.lib" )
+#pragma comment( lib, "dxguid.lib" )
+
+// Backing store for r_push_constants, shared by all frames in flight.
+#define R_CONSTANT_RING_SIZE ( 4 * 1024 * 1024 )
+// D3D11.1 binds constant buffer ranges in multiples of 16 constants.
+#define R_CONSTANT_RING_ALIGNMENT 256
+
+// CPU side staging for r_create_buffer_deferred/r_queue_buffer_upload, allocated on first use.
+#define R_UPLOAD_RING_SIZE ( 32 * 1024 * 1024 )
+// Default bytes copied to the GPU per r_present, and the size of each staging buffer.
+#define R_UPLOAD_FRAME_BUDGET ( 4 * 1024 * 1024 )
+// Copy commands per flush.
+#define R_UPLOAD_MAX_BATCH 256
+
+// Streamed per-instance data for r_submit_instanced, bound to R_INSTANCE_SLOT.
+#define R_INSTANCE_STREAM_SIZE ( 4 * 1024 * 1024 )
+#define R_INSTANCE_SLOT 1
+// Vertices of r_submit_batch2d, about 26k quads.
+#define R_BATCH2D_STREAM_SIZE ( 2 * 1024 * 1024 )
+
+// Textures kept for frame graph transients, and how many r_execute_frame_graph calls one
+// may sit unused before it is released.
+#define R_MAX_GRAPH_TEXTURES 64
+#define R_GRAPH_TEXTURE_KEEP 16
+// Pixel shader slots r_bind_graph_texture may use, unbound again before every pass.
+#define R_GRAPH_SRV_SLOTS 16
+
+// Part of the shader cache key, changing them must not hand out stale bytecode.
+#define R_SHADER_COMPILE_FLAGS D3DCOMPILE_OPTIMIZATION_LEVEL3
+
+// Pool capacities, every store is allocated once when the context is created.
+#define R_MAX_BUFFERS 16384
+#define R_MAX_SHADERS 1024
+#define R_MAX_INPUT_LAYOUTS 256
+#define R_MAX_PIPELINES 1024
+#define R_MAX_MESHES 16384
+#define R_MAX_BIND_GROUPS 4096
+#define R_MAX_TEXTURES 4096
+
+// Geometry heaps behind r_create_mesh: one per vertex stride, and another of the stride once the
+// ones it has are full. Their size is fixed when they're created, r_set_geometry_heap_size changes
+// it for the ones created after.
+#define R_MAX_GEOMETRY_HEAPS 16
+#define R_GEOMETRY_HEAP_VERTEX_BYTES ( 64 * 1024 * 1024 )
+#define R_GEOMETRY_HEAP_INDICES ( 16 * 1024 * 1024 )
+// Copies within one buffer bounce through a scratch buffer of this size, in pieces when larger.
+#define R_COPY_SCRATCH_BYTES ( 1024 * 1024 )
+// D3D11 refuses to create more than 4096 unique objects of each state type.
+#define R_MAX_STATE_OBJECTS 4096
+
+// Per-type stores. Fields live in parallel arrays indexed by the pool's dense
+// index, so every live object of a type is packed at the front of each array.
+
+// A copy of what a shader was created from, so frame captures can recreate it.
+typedef struct R_ShaderBytecode
+{
+	void  *data;
+	size_t size;
+} R_ShaderBytecode;
+
+typedef struct R_BufferStore
+{
+	R_Pool         pool;
+	ID3D11Buffer **buffers;
+	size_t        *sizes;
+} R_BufferStore;
+
+typedef struct R_VertexShaderStore
+{
+	R_Pool               pool;
+	ID3D11VertexShader **shaders; // NULL while compiling or after a failed async compile
+	uint64_t            *signatureHashes;
+	uint32_t            *jobs; // async compile in flight, 0 when none
+	R_ShaderBytecode    *bytecode;
+} R_VertexShaderStore;
+
+// Input signatures, the only part of the VS bytecode CreateInputLayout needs.
+// One blob per distinct signature, shared by every vertex shader that declares it.
+typedef struct R_SignatureStore
+{
+	R_HashMap  lookup; // signature hash -> index
+	ID3DBlob **blobs;
+	uint64_t  *hashes;
+	UINT      *refCounts;
+	uint32_t   count;
+} R_SignatureStore;
+
+typedef struct R_PixelShaderStore
+{
+	R_Pool              pool;
+	ID3D11PixelShader **shaders;
+	uint32_t           *jobs;
+	R_ShaderBytecode   *bytecode;
+} R_PixelShaderStore;
+
+// A layout created against a vertex shader that is still compiling, built from its
+// source's elements once the shader is in.
+typedef struct R_PendingInputLayout
+{
+	D3D11_INPUT_ELEMENT_DESC *elements; // owned by the layout's R_InputLayoutSource
+	UINT                      count;
+	R_VertexShader            vs;
+} R_PendingInputLayout;
+
+// The elements (semantic names included) every layout was created from, kept for frame captures.
+typedef struct R_InputLayoutSource
+{
+	D3D11_INPUT_ELEMENT_DESC *elements;
+	UINT                      count;
+	uint64_t                  signatureHash; // 0 until the shader's compile finished
+} R_InputLayoutSource;
+
+typedef struct R_InputLayoutStore
+{
+	R_Pool                pool;
+	R_HashMap             lookup; // element + signature hash -> layout id
+	ID3D11InputLayout   **layouts;
+	UINT                 *refCounts;
+	uint64_t             *hashes;
+	R_PendingInputLayout *pending;
+	R_InputLayoutSource  *sources;
+} R_InputLayoutStore;
+
+typedef struct R_PipelineStore
+{
+	R_Pool                    pool;
+	R_HashMap                 lookup; // descriptor hash -> pipeline id
+	ID3D11InputLayout       **inputLayouts;
+	ID3D11VertexShader      **vs;
+	ID3D11PixelShader       **ps;
+	ID3D11RasterizerState   **rasterizer;
+	ID3D11BlendState        **blend;
+	ID3D11DepthStencilState **depthStencil;
+	R_InputLayout            *layouts;
+	UINT                     *refCounts;
+	uint64_t                 *hashes;
+	R_PipelineDesc           *descs; // canonical copies, only read to rule out hash collisions
+	bool                     *pending; // waiting on a compile, binds descs[i].fallback meanwhile
+} R_PipelineStore;
+
+#define R_BIND_GROUP_MAX_OBJECTS \
+	( R_STAGE_COUNT * ( R_MAX_CONSTANT_BUFFER_SLOTS + R_BIND_GROUP_TEXTURE_SLOTS + R_BIND_GROUP_SAMPLER_SLOTS ) )
+
+typedef struct R_BindGroupBuffers
+{
+	ID3D11Buffer *buffers[R_STAGE_COUNT][R_MAX_CONSTANT_BUFFER_SLOTS];
+} R_BindGroupBuffers;
+
+// The set's descs keep the textures and samplers, buffers what the desc's buffer handles were at
+// creation. The group holds a reference on all of them.
+typedef struct R_BindGroupStore
+{
+	R_BindGroupSet      set;
+	R_BindGroupBuffers *buffers; // indexed like the set
+} R_BindGroupStore;
+
+typedef struct R_TextureStore
+{
+	R_Pool                     pool;
+	ID3D11Texture2D          **textures;
+	ID3D11ShaderResourceView **views;
+} R_TextureStore;
+
+// One vertex and one 32-bit index buffer shared by every mesh of a vertex stride. The allocators
+// count in vertices and indices, so an allocation's offset is the draw's base vertex or start index.
+typedef struct R_GeometryHeap
+{
+	UINT              stride;
+	R_Buffer          vertices;
+	R_Buffer          indices;
+	R_OffsetAllocator vertexAlloc;
+	R_OffsetAllocator indexAlloc;
+} R_GeometryHeap;
+
+typedef struct R_MeshStore
+{
+	R_Pool              pool;
+	uint8_t            *heaps; // index into R_Context.geometryHeaps
+	R_OffsetAllocation *vertices;
+	R_OffsetAllocation *indices;
+	uint32_t           *vertexCounts;
+	uint32_t           *indexCounts;
+	uint64_t           *uploads; // uploads.pushed once the data was queued, drawn when retired gets there
+} R_MeshStore;
+
+// Objects a pipeline manifest had built ahead of use (r_load_pipeline_manifest). Only the precache
+// thread touches them until it finished; then the state objects move into their caches, and
+// shaders and layouts are looked up here by content before creating one goes to the driver.
+typedef enum
+{
+	R_WARM_VERTEX_SHADER = 0,
+	R_WARM_PIXEL_SHADER,
+	R_WARM_INPUT_LAYOUT,
+	R_WARM_LOOKUPS, // kinds from here on end up in the state object caches
+	R_WARM_RASTERIZER = R_WARM_LOOKUPS,
+	R_WARM_BLEND,
+	R_WARM_DEPTH_STENCIL,
+	R_WARM_SAMPLER,
+} R_WarmKind;
+
+typedef struct R_WarmObjects
+{
+	R_HashMap    lookup[R_WARM_LOOKUPS]; // content hash -> index, filled once the thread is done
+	IUnknown   **objects;
+	uint8_t     *kinds;
+	uint64_t    *hashes; // of the bytecode, r_hash_input_elements or of the descriptor
+	const void **data;   // own copies of the bytecode or elements; descriptors point into the manifest
+	size_t      *sizes;  // element count for layouts
+	uint32_t     count;
+	uint32_t     capacity;
+} R_WarmObjects;
+
+// Dynamic vertex buffer written front to back with NO_OVERWRITE and discarded when full.
+typedef struct R_StreamBuffer
+{
+	ID3D11Buffer *buffer;
+	size_t        head;
+} R_StreamBuffer;
+
+// Physical texture behind one or more frame graph transients, reused by later
+// executions for any transient with the same desc.
+typedef struct R_GraphTexture
+{
+	R_FgTextureDesc           desc;
+	ID3D11Texture2D          *texture;
+	ID3D11RenderTargetView   *rtv; // colour targets
+	ID3D11DepthStencilView   *dsv; // depth targets
+	ID3D11ShaderResourceView *srv; // NULL for depth formats without a readable view
+	uint64_t                  lastUse;
+} R_GraphTexture;
 
 struct R_Context
 {
@@ -14,681 +269,4798 @@ struct R_Context
 	ID3D11DeviceContext    *ctx;
 	IDXGISwapChain         *swap;
 	ID3D11RenderTargetView *rtv;
+	UINT                    width; // back buffer
+	UINT                    height;
 	D3D11_VIEWPORT          vp;
 	bool                    vsync;
-	R_Pipeline             *lastPipeline;
+	R_StateCache            state;
+	uint64_t                owner; // the thread every call has to come from, see r_take_context
+
+	R_BufferStore       buffers;
+	R_VertexShaderStore vertexShaders;
+	R_SignatureStore    signatures;
+	R_PixelShaderStore  pixelShaders;
+	R_InputLayoutStore  inputLayouts;
+	R_PipelineStore     pipelines;
+	R_MeshStore         meshes;
+	R_BindGroupStore    bindGroups;
+	R_TextureStore      textures;
+
+	// Group bound at each r_bind_group index and the slots it filled.
+	R_BoundGroups boundGroups;
+
+	// Bumped whenever a buffer or pipeline is destroyed or a pipeline's objects change; bundles
+	// resolved against an older epoch check their handles again before they execute.
+	uint64_t resourceEpoch;
+
+	R_StateObjectCache rasterizerStates;
+	R_StateObjectCache blendStates;
+	R_StateObjectCache depthStencilStates;
+	R_StateObjectCache samplerStates;
+
+	// Transient constants, only when the device can bind constant buffers by offset.
+	ID3D11DeviceContext1 *ctx1;
+	ID3D11Buffer         *constantRing;
+	R_RingAllocator       constantRingAlloc;
+	bool                  constantRingMapped;
+	uint8_t              *constantRingData; // mapped from the first push after a draw until the next draw
+	R_Buffer              constantFallback;
+
+	// frameIndex is the frame being recorded, every frame before completedFrames has passed its fence.
+	ID3D11Query *frameFences[R_RING_MAX_FRAMES];
+	uint64_t     frameIndex;
+	uint64_t     completedFrames;
+
+	// COM objects destroyed while frames that may use them are still in flight.
+	R_ReleaseQueue releases;
+
+	// Compiled bytecode for the *_from_source paths, only used once r_open_shader_cache succeeded.
+	R_ShaderCache shaderCache;
+
+	// Batched static buffer uploads. Flushes rotate through the staging buffers, so one is only
+	// mapped again R_RING_MAX_FRAMES flushes later, long after the GPU finished copying out of it.
+	R_UploadQueue uploads;
+	ID3D11Buffer *uploadStaging[R_RING_MAX_FRAMES];
+	size_t        uploadStagingSize;
+	size_t        uploadBudget;
+	uint64_t      uploadFlushes;
+
+	// Mesh storage. defragCursor is the dense mesh index r_defragment_geometry resumes from.
+	// copyScratch is created on the first copy within a buffer, which defragmentation makes.
+	R_GeometryHeap geometryHeaps[R_MAX_GEOMETRY_HEAPS];
+	uint32_t       geometryHeapCount;
+	size_t         geometryHeapVertexBytes;
+	uint32_t       geometryHeapIndices;
+	uint32_t       defragCursor;
+	uint64_t       defragBytesMoved;
+	ID3D11Buffer  *copyScratch;
+
+	// Streamed geometry, created on first use: instance data of r_submit_instanced, and the quads of
+	// r_submit_batch2d with the shared index buffer every batch of quads draws with.
+	R_StreamBuffer instanceStream;
+	R_StreamBuffer batchVertices;
+	ID3D11Buffer  *batchIndices;
+
+	// Frame graph transients. graphTextureOf maps the physical slots of the graph being executed
+	// to graphTextures, and is only meaningful while r_execute_frame_graph runs.
+	R_GraphTexture      graphTextures[R_MAX_GRAPH_TEXTURES];
+	uint32_t            graphTextureCount;
+	uint32_t            graphTextureOf[R_FG_MAX_RESOURCES];
+	const R_FrameGraph *graph;
+	uint64_t            graphExecutions;
+	uint32_t            graphSrvSlots; // bitmask of slots r_bind_graph_texture filled
+
+	// Workers for r_compile_shader_async, started on first use.
+	R_ShaderJobQueue shaderJobs;
+	uint32_t         pendingShaders;
+
+	// r_capture_frame arms the capture, the next r_present starts recording and the one after saves it.
+	R_CaptureWriter capture;
+	char           *capturePath;
+	bool            captureArmed;
+	bool            capturing;
+
+	// Shader bytecode and layout elements are only copied for captures and manifests, from
+	// r_keep_capture_sources on or while one is armed or recording (r_wants_sources).
+	bool keepSources;
+
+	// Pipeline manifests: the one being replayed (manifest is freed once warm is adopted), and the one
+	// being recorded, while manifestPath is set.
+	R_Precache         precache;
+	R_WarmObjects      warm;
+	void              *manifest;
+	R_PrecacheRecorder manifestRecorder;
+	char              *manifestPath;
 };
 
-struct R_Buffer
+// The context, its pools and caches have no locks: whatever creates, destroys or submits has to run
+// on the owner (see r_take_context). Other threads only go through the device or r_defer_release.
+#define R_ASSERT_OWNER( ctx ) assert( ( ctx )->owner == sys_thread_id() )
+
+static void safe_release( IUnknown **p )
 {
-	ID3D11Buffer *buf;
-	size_t        size;
-};
+	if ( p && *p )
+	{
+		( *p )->lpVtbl->Release( *p );
+		*p = NULL;
+	}
+}
 
-struct R_VertexShader
+// The cache only holds the objects, their references go here.
+static void r_state_object_cache_release( R_StateObjectCache *cache )
 {
-	ID3D11VertexShader *vs;
-	void               *bytecode;
-	size_t              bytecodeSize;
-};
+	for ( uint32_t i = 0; i < cache->count; ++i )
+		safe_release( (IUnknown **)&cache->objects[i] );
+	r_state_object_cache_free( cache );
+}
 
-struct R_PixelShader
+// Every COM reference bind group i holds, for taking and dropping them.
+static uint32_t r_bind_group_objects( R_BindGroupStore *store, uint32_t i, IUnknown **out[R_BIND_GROUP_MAX_OBJECTS] )
 {
-	ID3D11PixelShader *ps;
-};
+	R_BindGroupDesc *desc  = (R_BindGroupDesc *)r_bind_group_set_desc( &store->set, i );
+	uint32_t         count = 0;
+	for ( int stage = 0; stage < R_STAGE_COUNT; ++stage )
+	{
+		for ( int slot = 0; slot < R_MAX_CONSTANT_BUFFER_SLOTS; ++slot )
+		{
+			if ( store->buffers[i].buffers[stage][slot] )
+				out[count++] = (IUnknown **)&store->buffers[i].buffers[stage][slot];
+		}
+		for ( int slot = 0; slot < R_BIND_GROUP_TEXTURE_SLOTS; ++slot )
+		{
+			if ( desc->textures[stage][slot] )
+				out[count++] = (IUnknown **)&desc->textures[stage][slot];
+		}
+		for ( int slot = 0; slot < R_BIND_GROUP_SAMPLER_SLOTS; ++slot )
+		{
+			if ( desc->samplers[stage][slot] )
+				out[count++] = (IUnknown **)&desc->samplers[stage][slot];
+		}
+	}
+	return count;
+}
 
-struct R_InputLayout
+static bool r_same_input_elements( const D3D11_INPUT_ELEMENT_DESC *a, const D3D11_INPUT_ELEMENT_DESC *b, UINT count )
 {
-	ID3D11InputLayout *layout;
-	UINT               refCount;
-};
+	for ( UINT i = 0; i < count; ++i )
+	{
+		if ( strcmp( a[i].SemanticName, b[i].SemanticName ) != 0 || a[i].SemanticIndex != b[i].SemanticIndex ||
+		     a[i].Format != b[i].Format || a[i].InputSlot != b[i].InputSlot ||
+		     a[i].AlignedByteOffset != b[i].AlignedByteOffset || a[i].InputSlotClass != b[i].InputSlotClass ||
+		     a[i].InstanceDataStepRate != b[i].InstanceDataStepRate )
+			return false;
+	}
+	return true;
+}
 
-struct R_Pipeline
+// A new reference on the precached object with the contents, NULL when there isn't one. data is the
+// bytecode, or the elements of a layout with size their count; a hash match alone isn't enough.
+static IUnknown *r_take_warm_object( R_Context *ctx, R_WarmKind kind, uint64_t hash, const void *data, size_t size )
 {
-	ID3D11VertexShader *vs;
-	ID3D11PixelShader  *ps;
-	R_InputLayout      *layout;
-};
+	R_WarmObjects *warm = &ctx->warm;
+	uint32_t       i    = 0;
+	if ( !r_hash_map_get( &warm->lookup[kind], hash, &i ) || warm->sizes[i] != size )
+		return NULL;
+	if ( kind == R_WARM_INPUT_LAYOUT ? !r_same_input_elements( warm->data[i], data, (UINT)size )
+	                                 : memcmp( warm->data[i], data, size ) != 0 )
+		return NULL;
 
-static void safe_release( IUnknown **p )
+	ctx->precache.stats.hits++;
+	warm->objects[i]->lpVtbl->AddRef( warm->objects[i] );
+	return warm->objects[i];
+}
+
+// Also what a manifest that failed to load leaves behind; the arrays are NULL or calloc'ed.
+static void r_free_warm_objects( R_WarmObjects *warm )
 {
-	if ( p && *p )
+	for ( uint32_t i = 0; i < warm->count; ++i )
 	{
-		( *p )->lpVtbl->Release( *p );
-		*p = NULL;
+		safe_release( &warm->objects[i] );
+		if ( warm->kinds[i] < R_WARM_LOOKUPS )
+			free( (void *)warm->data[i] );
 	}
+	for ( int i = 0; i < R_WARM_LOOKUPS; ++i )
+		r_hash_map_free( &warm->lookup[i] );
+	free( warm->objects );
+	free( warm->kinds );
+	free( warm->hashes );
+	free( (void *)warm->data );
+	free( warm->sizes );
+	memset( warm, 0, sizeof( *warm ) );
 }
 
-const char *r_result_to_string( R_Result result )
+static bool r_init_stores( R_Context *r )
 {
-	switch ( result )
+	if ( !r_pool_init( &r->buffers.pool, R_MAX_BUFFERS ) || !r_pool_init( &r->vertexShaders.pool, R_MAX_SHADERS ) ||
+	     !r_pool_init( &r->pixelShaders.pool, R_MAX_SHADERS ) ||
+	     !r_pool_init( &r->inputLayouts.pool, R_MAX_INPUT_LAYOUTS ) ||
+	     !r_pool_init( &r->pipelines.pool, R_MAX_PIPELINES ) || !r_pool_init( &r->meshes.pool, R_MAX_MESHES ) ||
+	     !r_pool_init( &r->textures.pool, R_MAX_TEXTURES ) ||
+	     !r_bind_group_set_init( &r->bindGroups.set, R_MAX_BIND_GROUPS, sizeof( R_BindGroupDesc ) ) )
+		return false;
+
+	r->buffers.buffers             = (ID3D11Buffer **)calloc( R_MAX_BUFFERS, sizeof( ID3D11Buffer * ) );
+	r->buffers.sizes               = (size_t *)calloc( R_MAX_BUFFERS, sizeof( size_t ) );
+	r->vertexShaders.shaders       = (ID3D11VertexShader **)calloc( R_MAX_SHADERS, sizeof( ID3D11VertexShader * ) );
+	r->vertexShaders.signatureHashes = (uint64_t *)calloc( R_MAX_SHADERS, sizeof( uint64_t ) );
+	r->vertexShaders.jobs            = (uint32_t *)calloc( R_MAX_SHADERS, sizeof( uint32_t ) );
+	r->vertexShaders.bytecode        = (R_ShaderBytecode *)calloc( R_MAX_SHADERS, sizeof( R_ShaderBytecode ) );
+	r->signatures.blobs              = (ID3DBlob **)calloc( R_MAX_SHADERS, sizeof( ID3DBlob * ) );
+	r->signatures.hashes             = (uint64_t *)calloc( R_MAX_SHADERS, sizeof( uint64_t ) );
+	r->signatures.refCounts          = (UINT *)calloc( R_MAX_SHADERS, sizeof( UINT ) );
+	r->pixelShaders.shaders        = (ID3D11PixelShader **)calloc( R_MAX_SHADERS, sizeof( ID3D11PixelShader * ) );
+	r->pixelShaders.jobs           = (uint32_t *)calloc( R_MAX_SHADERS, sizeof( uint32_t ) );
+	r->pixelShaders.bytecode       = (R_ShaderBytecode *)calloc( R_MAX_SHADERS, sizeof( R_ShaderBytecode ) );
+	r->inputLayouts.layouts        = (ID3D11InputLayout **)calloc( R_MAX_INPUT_LAYOUTS, sizeof( ID3D11InputLayout * ) );
+	r->inputLayouts.refCounts      = (UINT *)calloc( R_MAX_INPUT_LAYOUTS, sizeof( UINT ) );
+	r->inputLayouts.hashes         = (uint64_t *)calloc( R_MAX_INPUT_LAYOUTS, sizeof( uint64_t ) );
+	r->inputLayouts.pending = (R_PendingInputLayout *)calloc( R_MAX_INPUT_LAYOUTS, sizeof( R_PendingInputLayout ) );
+	r->inputLayouts.sources = (R_InputLayoutSource *)calloc( R_MAX_INPUT_LAYOUTS, sizeof( R_InputLayoutSource ) );
+	r->pipelines.inputLayouts = (ID3D11InputLayout **)calloc( R_MAX_PIPELINES, sizeof( void * ) );
+	r->pipelines.vs           = (ID3D11VertexShader **)calloc( R_MAX_PIPELINES, sizeof( void * ) );
+	r->pipelines.ps           = (ID3D11PixelShader **)calloc( R_MAX_PIPELINES, sizeof( void * ) );
+	r->pipelines.rasterizer   = (ID3D11RasterizerState **)calloc( R_MAX_PIPELINES, sizeof( void * ) );
+	r->pipelines.blend        = (ID3D11BlendState **)calloc( R_MAX_PIPELINES, sizeof( void * ) );
+	r->pipelines.depthStencil = (ID3D11DepthStencilState **)calloc( R_MAX_PIPELINES, sizeof( void * ) );
+	r->pipelines.layouts      = (R_InputLayout *)calloc( R_MAX_PIPELINES, sizeof( R_InputLayout ) );
+	r->pipelines.refCounts    = (UINT *)calloc( R_MAX_PIPELINES, sizeof( UINT ) );
+	r->pipelines.hashes       = (uint64_t *)calloc( R_MAX_PIPELINES, sizeof( uint64_t ) );
+	r->pipelines.descs        = (R_PipelineDesc *)calloc( R_MAX_PIPELINES, sizeof( R_PipelineDesc ) );
+	r->pipelines.pending      = (bool *)calloc( R_MAX_PIPELINES, sizeof( bool ) );
+	r->meshes.heaps           = (uint8_t *)calloc( R_MAX_MESHES, sizeof( uint8_t ) );
+	r->meshes.vertices        = (R_OffsetAllocation *)calloc( R_MAX_MESHES, sizeof( R_OffsetAllocation ) );
+	r->meshes.indices         = (R_OffsetAllocation *)calloc( R_MAX_MESHES, sizeof( R_OffsetAllocation ) );
+	r->meshes.vertexCounts    = (uint32_t *)calloc( R_MAX_MESHES, sizeof( uint32_t ) );
+	r->meshes.indexCounts     = (uint32_t *)calloc( R_MAX_MESHES, sizeof( uint32_t ) );
+	r->meshes.uploads         = (uint64_t *)calloc( R_MAX_MESHES, sizeof( uint64_t ) );
+	r->bindGroups.buffers     = (R_BindGroupBuffers *)calloc( R_MAX_BIND_GROUPS, sizeof( R_BindGroupBuffers ) );
+	r->textures.textures      = (ID3D11Texture2D **)calloc( R_MAX_TEXTURES, sizeof( ID3D11Texture2D * ) );
+	r->textures.views = (ID3D11ShaderResourceView **)calloc( R_MAX_TEXTURES, sizeof( ID3D11ShaderResourceView * ) );
+
+	if ( !r_hash_map_init( &r->pipelines.lookup, 64 ) || !r_hash_map_init( &r->signatures.lookup, 64 ) ||
+	     !r_hash_map_init( &r->inputLayouts.lookup, 64 ) ||
+	     !r_state_object_cache_init( &r->rasterizerStates, R_MAX_STATE_OBJECTS, sizeof( D3D11_RASTERIZER_DESC ) ) ||
+	     !r_state_object_cache_init( &r->blendStates, R_MAX_STATE_OBJECTS, sizeof( D3D11_BLEND_DESC ) ) ||
+	     !r_state_object_cache_init( &r->depthStencilStates,
+	                                 R_MAX_STATE_OBJECTS,
+	                                 sizeof( D3D11_DEPTH_STENCIL_DESC ) ) ||
+	     !r_state_object_cache_init( &r->samplerStates, R_MAX_STATE_OBJECTS, sizeof( D3D11_SAMPLER_DESC ) ) )
+		return false;
+
+	return r->buffers.buffers && r->buffers.sizes && r->vertexShaders.shaders && r->vertexShaders.signatureHashes &&
+	       r->vertexShaders.jobs && r->vertexShaders.bytecode && r->signatures.blobs && r->signatures.hashes &&
+	       r->signatures.refCounts && r->pixelShaders.shaders && r->pixelShaders.jobs && r->pixelShaders.bytecode &&
+	       r->inputLayouts.layouts && r->inputLayouts.refCounts && r->inputLayouts.hashes && r->inputLayouts.pending &&
+	       r->inputLayouts.sources && r->pipelines.inputLayouts && r->pipelines.vs &&
+	       r->pipelines.ps && r->pipelines.rasterizer && r->pipelines.blend && r->pipelines.depthStencil &&
+	       r->pipelines.layouts && r->pipelines.refCounts && r->pipelines.hashes && r->pipelines.descs &&
+	       r->pipelines.pending && r->meshes.heaps && r->meshes.vertices && r->meshes.indices &&
+	       r->meshes.vertexCounts && r->meshes.indexCounts && r->meshes.uploads && r->bindGroups.buffers &&
+	       r->textures.textures && r->textures.views;
+}
+
+static void r_free_stores( R_Context *r )
+{
+	// Whatever is still alive at this point leaked from the application, release it anyway.
+	for ( uint32_t i = 0; i < r->bindGroups.set.pool.count; ++i )
 	{
-	case R_OK:
-		return "Success";
-	case R_ERROR_DEVICE_CREATION_FAILED:
-		return "Failed to create D3D11 device";
-	case R_ERROR_SWAP_CHAIN_FAILED:
-		return "Failed to create swap chain";
-	case R_ERROR_BUFFER_CREATION_FAILED:
-		return "Failed to create buffer";
-	case R_ERROR_SHADER_COMPILATION_FAILED:
-		return "Shader compilation failed";
-	case R_ERROR_SHADER_CREATION_FAILED:
-		return "Failed to create shader";
-	case R_ERROR_INPUT_LAYOUT_FAILED:
-		return "Failed to create input layout";
-	case R_ERROR_INVALID_PARAMETER:
-		return "Invalid parameter";
-	case R_ERROR_OUT_OF_MEMORY:
-		return "Out of memory";
-	default:
-		return "Unknown error";
+		IUnknown **objects[R_BIND_GROUP_MAX_OBJECTS];
+		uint32_t   count = r_bind_group_objects( &r->bindGroups, i, objects );
+		for ( uint32_t n = 0; n < count; ++n )
+			safe_release( objects[n] );
+	}
+	for ( uint32_t i = 0; i < r->pipelines.pool.count; ++i )
+	{
+		safe_release( (IUnknown **)&r->pipelines.inputLayouts[i] );
+		safe_release( (IUnknown **)&r->pipelines.vs[i] );
+		safe_release( (IUnknown **)&r->pipelines.ps[i] );
+	}
+	r_state_object_cache_release( &r->rasterizerStates );
+	r_state_object_cache_release( &r->blendStates );
+	r_state_object_cache_release( &r->depthStencilStates );
+	r_state_object_cache_release( &r->samplerStates );
+
+	r_precache_free( &r->precache );
+	r_free_warm_objects( &r->warm );
+	free( r->manifest );
+	r_precache_recorder_free( &r->manifestRecorder );
+	free( r->manifestPath );
+	for ( uint32_t i = 0; i < r->textures.pool.count; ++i )
+	{
+		safe_release( (IUnknown **)&r->textures.views[i] );
+		safe_release( (IUnknown **)&r->textures.textures[i] );
+	}
+	for ( uint32_t i = 0; i < r->inputLayouts.pool.count; ++i )
+	{
+		safe_release( (IUnknown **)&r->inputLayouts.layouts[i] );
+		free( r->inputLayouts.sources[i].elements );
+	}
+	for ( uint32_t i = 0; i < r->pixelShaders.pool.count; ++i )
+	{
+		safe_release( (IUnknown **)&r->pixelShaders.shaders[i] );
+		free( r->pixelShaders.bytecode[i].data );
+	}
+	for ( uint32_t i = 0; i < r->vertexShaders.pool.count; ++i )
+	{
+		safe_release( (IUnknown **)&r->vertexShaders.shaders[i] );
+		free( r->vertexShaders.bytecode[i].data );
+	}
+	for ( uint32_t i = 0; i < r->signatures.count; ++i )
+		safe_release( (IUnknown **)&r->signatures.blobs[i] );
+	for ( uint32_t i = 0; i < r->buffers.pool.count; ++i )
+		safe_release( (IUnknown **)&r->buffers.buffers[i] );
+
+	free( r->buffers.buffers );
+	free( r->buffers.sizes );
+	free( r->vertexShaders.shaders );
+	free( r->vertexShaders.signatureHashes );
+	free( r->vertexShaders.jobs );
+	free( r->vertexShaders.bytecode );
+	free( r->signatures.blobs );
+	free( r->signatures.hashes );
+	free( r->signatures.refCounts );
+	r_hash_map_free( &r->signatures.lookup );
+	free( r->pixelShaders.shaders );
+	free( r->pixelShaders.jobs );
+	free( r->pixelShaders.bytecode );
+	free( r->inputLayouts.layouts );
+	free( r->inputLayouts.refCounts );
+	free( r->inputLayouts.hashes );
+	free( r->inputLayouts.pending );
+	free( r->inputLayouts.sources );
+	r_hash_map_free( &r->inputLayouts.lookup );
+	free( r->pipelines.inputLayouts );
+	free( r->pipelines.vs );
+	free( r->pipelines.ps );
+	free( r->pipelines.rasterizer );
+	free( r->pipelines.blend );
+	free( r->pipelines.depthStencil );
+	free( r->pipelines.layouts );
+	free( r->pipelines.refCounts );
+	free( r->pipelines.hashes );
+	free( r->pipelines.descs );
+	free( r->pipelines.pending );
+	r_hash_map_free( &r->pipelines.lookup );
+
+	r_pool_free( &r->buffers.pool );
+	r_pool_free( &r->vertexShaders.pool );
+	r_pool_free( &r->pixelShaders.pool );
+	r_pool_free( &r->inputLayouts.pool );
+	r_pool_free( &r->pipelines.pool );
+
+	// The heaps' buffers are in the buffer store and went with it.
+	for ( uint32_t i = 0; i < r->geometryHeapCount; ++i )
+	{
+		r_offset_alloc_free( &r->geometryHeaps[i].vertexAlloc );
+		r_offset_alloc_free( &r->geometryHeaps[i].indexAlloc );
 	}
+	free( r->meshes.heaps );
+	free( r->meshes.vertices );
+	free( r->meshes.indices );
+	free( r->meshes.vertexCounts );
+	free( r->meshes.indexCounts );
+	free( r->meshes.uploads );
+	r_pool_free( &r->meshes.pool );
+	free( r->bindGroups.buffers );
+	r_bind_group_set_free( &r->bindGroups.set );
+	free( r->textures.textures );
+	free( r->textures.views );
+	r_pool_free( &r->textures.pool );
 }
 
-R_Context *r_create_context( HWND hwnd, int width, int height, bool vsync, R_Result *outResult )
+static ID3D11Buffer *r_buffer_get( R_Context *ctx, R_Buffer buf )
 {
-	R_Result localResult = R_OK;
-	if ( !outResult )
-		outResult = &localResult;
+	uint32_t i = r_pool_lookup( &ctx->buffers.pool, buf.id );
+	return i != R_POOL_INVALID ? ctx->buffers.buffers[i] : NULL;
+}
 
-	UINT createFlags = 0;
-#if defined( _DEBUG )
-	createFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
+static R_Result r_create_constant_ring( R_Context *r )
+{
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory( &options, sizeof( options ) );
 
-	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_1, D3D_FEATURE_LEVEL_10_0 };
-	D3D_FEATURE_LEVEL chosen          = D3D_FEATURE_LEVEL_11_0;
+	ID3D11DeviceContext1 *ctx1 = NULL;
+	if ( FAILED( r->ctx->lpVtbl->QueryInterface( r->ctx, &IID_ID3D11DeviceContext1, (void **)&ctx1 ) ) ||
+	     FAILED( r->device->lpVtbl->CheckFeatureSupport( r->device,
+	                                                     D3D11_FEATURE_D3D11_OPTIONS,
+	                                                     &options,
+	                                                     sizeof( options ) ) ) ||
+	     !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer )
+	{
+		safe_release( (IUnknown **)&ctx1 );
 
-	IDXGISwapChain      *swap   = NULL;
-	ID3D11Device        *device = NULL;
-	ID3D11DeviceContext *ctx    = NULL;
+		// Pre 11.1 runtime, fall back to one discarded buffer per push.
+		R_Result result;
+		r->constantFallback = r_create_constant_buffer( r, R_MAX_PUSH_CONSTANT_BYTES, &result );
+		return result;
+	}
 
-	DXGI_SWAP_CHAIN_DESC sd = { 0 };
-	sd.BufferCount          = 1;
-	sd.BufferDesc.Width     = width;
-	sd.BufferDesc.Height    = height;
-	sd.BufferDesc.Format    = DXGI_FORMAT_R8G8B8A8_UNORM;
-	sd.BufferUsage          = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.OutputWindow         = hwnd;
-	sd.SampleDesc.Count     = 1;
-	sd.Windowed             = TRUE;
-	sd.SwapEffect           = DXGI_SWAP_EFFECT_DISCARD;
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory( &bd, sizeof( bd ) );
+	bd.ByteWidth      = R_CONSTANT_RING_SIZE;
+	bd.BindFlags      = D3D11_BIND_CONSTANT_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.Usage          = D3D11_USAGE_DYNAMIC;
 
-	HRESULT hr = D3D11CreateDeviceAndSwapChain( NULL,
-	                                            D3D_DRIVER_TYPE_HARDWARE,
-	                                            NULL,
-	                                            createFlags,
-	                                            featureLevels,
-	                                            ARRAYSIZE( featureLevels ),
-	                                            D3D11_SDK_VERSION,
-	                                            &sd,
-	                                            &swap,
-	                                            &device,
-	                                            &chosen,
-	                                            &ctx );
+	if ( FAILED( r->device->lpVtbl->CreateBuffer( r->device, &bd, NULL, &r->constantRing ) ) )
+	{
+		safe_release( (IUnknown **)&ctx1 );
+		return R_ERROR_BUFFER_CREATION_FAILED;
+	}
+
+	r_ring_init( &r->constantRingAlloc, R_CONSTANT_RING_SIZE, R_CONSTANT_RING_ALIGNMENT );
+	r->ctx1 = ctx1;
+	return R_OK;
+}
+
+static void r_release_com_object( void *user, void *object )
+{
+	(void)user;
+	IUnknown *unknown = (IUnknown *)object;
+	unknown->lpVtbl->Release( unknown );
+}
+
+// Releases the object once the frame being recorded has passed its fence. Straight away if the queue
+// is full, which D3D11 tolerates since the runtime keeps objects alive while the GPU uses them.
+static void r_defer_release_object( R_Context *ctx, IUnknown **object )
+{
+	if ( !*object )
+		return;
+	if ( !r_release_queue_push( &ctx->releases, *object ) )
+		( *object )->lpVtbl->Release( *object );
+	*object = NULL;
+}
+
+static R_Result r_create_frame_fences( R_Context *r )
+{
+	D3D11_QUERY_DESC qd = { D3D11_QUERY_EVENT, 0 };
+	for ( int i = 0; i < R_RING_MAX_FRAMES; ++i )
+	{
+		if ( FAILED( r->device->lpVtbl->CreateQuery( r->device, &qd, &r->frameFences[i] ) ) )
+			return R_ERROR_DEVICE_CREATION_FAILED;
+	}
+
+	if ( !r_release_queue_init( &r->releases, R_RELEASE_QUEUE_CAPACITY, r_release_com_object, NULL ) )
+		return R_ERROR_OUT_OF_MEMORY;
+	return R_OK;
+}
+
+static bool r_frame_fence_passed( R_Context *ctx, uint64_t frame, bool wait )
+{
+	ID3D11Asynchronous *fence = (ID3D11Asynchronous *)ctx->frameFences[frame % R_RING_MAX_FRAMES];
+	for ( ;; )
+	{
+		HRESULT hr = ctx->ctx->lpVtbl->GetData( ctx->ctx, fence, NULL, 0, wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH );
+		// A lost device won't read the ring anymore either.
+		if ( hr == S_OK || FAILED( hr ) )
+			return true;
+		if ( !wait )
+			return false;
+		// The first GetData flushed, now the GPU just needs time: don't take a core away from it.
+		sys_thread_yield();
+	}
+}
+
+// Moves completedFrames past every frame whose fence has passed, and gives back what those frames held.
+static bool r_retire_frames( R_Context *ctx, bool waitOldest )
+{
+	bool retired = false;
+	while ( ctx->completedFrames < ctx->frameIndex )
+	{
+		if ( !r_frame_fence_passed( ctx, ctx->completedFrames, waitOldest && !retired ) )
+			break;
+		if ( ctx->constantRing )
+			r_ring_retire( &ctx->constantRingAlloc, ctx->completedFrames );
+		ctx->completedFrames++;
+		retired = true;
+	}
+
+	r_release_queue_collect( &ctx->releases, ctx->completedFrames );
+	return retired;
+}
+
+// Draws can't read a mapped buffer: closes the map the pushes since the last draw wrote through.
+static void r_unmap_constant_ring( R_Context *ctx )
+{
+	if ( !ctx->constantRingData )
+		return;
+	ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)ctx->constantRing, 0 );
+	ctx->constantRingData = NULL;
+}
+
+static ID3D11Buffer *r_get_upload_staging( R_Context *ctx, uint32_t slot )
+{
+	if ( ctx->uploadStagingSize < ctx->uploadBudget )
+	{
+		for ( int i = 0; i < R_RING_MAX_FRAMES; ++i )
+			safe_release( (IUnknown **)&ctx->uploadStaging[i] );
+		ctx->uploadStagingSize = ctx->uploadBudget;
+	}
+
+	if ( !ctx->uploadStaging[slot] )
+	{
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof( bd ) );
+		bd.ByteWidth      = (UINT)ctx->uploadStagingSize;
+		bd.Usage          = D3D11_USAGE_STAGING;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, NULL, &ctx->uploadStaging[slot] );
+	}
+	return ctx->uploadStaging[slot];
+}
+
+// One batch: every piece is packed into a staging buffer under a single Map, then copied to its
+// buffer with CopySubresourceRegion. Returns false once the queue has nothing left to hand out.
+static bool r_flush_uploads( R_Context *ctx, size_t budget )
+{
+	if ( !ctx->uploads.count )
+		return false;
+
+	R_UploadPiece pieces[R_UPLOAD_MAX_BATCH];
+	uint32_t      count = r_upload_queue_gather( &ctx->uploads, budget, pieces, R_UPLOAD_MAX_BATCH );
+	if ( !count )
+	{
+		// Only cancelled requests left, completing drops them.
+		r_upload_queue_complete( &ctx->uploads );
+		return false;
+	}
+
+	ID3D11Buffer *staging = r_get_upload_staging( ctx, ctx->uploadFlushes++ % R_RING_MAX_FRAMES );
+
+	D3D11_MAPPED_SUBRESOURCE mapped = { 0 };
+	if ( staging &&
+	     FAILED( ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)staging, 0, D3D11_MAP_WRITE, 0, &mapped ) ) )
+		staging = NULL;
+
+	UINT offset = 0;
+	if ( staging )
+	{
+		for ( uint32_t i = 0; i < count; ++i )
+		{
+			memcpy( (uint8_t *)mapped.pData + offset, pieces[i].data, pieces[i].size );
+			offset += pieces[i].size;
+		}
+		ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)staging, 0 );
+	}
+
+	offset = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		R_Buffer      target = { pieces[i].target };
+		ID3D11Buffer *dst    = r_buffer_get( ctx, target );
+		D3D11_BOX     box    = { pieces[i].dstOffset, 0, 0, pieces[i].dstOffset + pieces[i].size, 1, 1 };
+
+		// Without a staging buffer the pieces still go out, one driver copy each.
+		if ( !staging )
+		{
+			ctx->ctx->lpVtbl->UpdateSubresource( ctx->ctx, (ID3D11Resource *)dst, 0, &box, pieces[i].data, 0, 0 );
+			continue;
+		}
+
+		D3D11_BOX src = { offset, 0, 0, offset + pieces[i].size, 1, 1 };
+		ctx->ctx->lpVtbl->CopySubresourceRegion(
+		    ctx->ctx, (ID3D11Resource *)dst, 0, box.left, 0, 0, (ID3D11Resource *)staging, 0, &src );
+		offset += pieces[i].size;
+	}
+
+	r_upload_queue_complete( &ctx->uploads );
+	return true;
+}
+
+static void r_release_graph_texture( R_Context *ctx, R_GraphTexture *texture )
+{
+	r_defer_release_object( ctx, (IUnknown **)&texture->srv );
+	r_defer_release_object( ctx, (IUnknown **)&texture->dsv );
+	r_defer_release_object( ctx, (IUnknown **)&texture->rtv );
+	r_defer_release_object( ctx, (IUnknown **)&texture->texture );
+}
+
+static void r_release_graph_textures( R_Context *ctx )
+{
+	for ( uint32_t i = 0; i < ctx->graphTextureCount; ++i )
+		r_release_graph_texture( ctx, &ctx->graphTextures[i] );
+	ctx->graphTextureCount = 0;
+}
+
+static bool r_wants_sources( const R_Context *ctx )
+{
+	return ctx->keepSources || ctx->captureArmed || ctx->capturing || ctx->manifestPath;
+}
+
+// Frees the copies once nothing will write them anymore. Pending layouts still need their elements.
+static void r_drop_sources( R_Context *ctx )
+{
+	if ( r_wants_sources( ctx ) )
+		return;
+	for ( uint32_t i = 0; i < ctx->vertexShaders.pool.count; ++i )
+	{
+		free( ctx->vertexShaders.bytecode[i].data );
+		ctx->vertexShaders.bytecode[i] = ( R_ShaderBytecode ){ 0 };
+	}
+	for ( uint32_t i = 0; i < ctx->pixelShaders.pool.count; ++i )
+	{
+		free( ctx->pixelShaders.bytecode[i].data );
+		ctx->pixelShaders.bytecode[i] = ( R_ShaderBytecode ){ 0 };
+	}
+	for ( uint32_t i = 0; i < ctx->inputLayouts.pool.count; ++i )
+	{
+		if ( ctx->inputLayouts.pending[i].elements )
+			continue;
+		free( ctx->inputLayouts.sources[i].elements );
+		ctx->inputLayouts.sources[i].elements = NULL;
+	}
+}
+
+static R_ShaderBytecode r_copy_bytecode( R_Context *ctx, const void *bytecode, size_t size )
+{
+	if ( !r_wants_sources( ctx ) )
+		return ( R_ShaderBytecode ){ 0 };
+
+	R_ShaderBytecode copy = { malloc( size ), size };
+	if ( copy.data )
+		memcpy( copy.data, bytecode, size );
+	else
+		copy.size = 0;
+	return copy;
+}
+
+static void r_capture_shader( R_Context *ctx, R_CaptureOp op, uint32_t id, const R_ShaderBytecode *bytecode )
+{
+	if ( !bytecode->data )
+		return;
+	R_CaptureCall call = { .op = op, .id = id, .data = bytecode->data, .size = (uint32_t)bytecode->size };
+	r_capture_write( &ctx->capture, &call );
+}
+
+// The create call of a layout, for captures and pipeline manifests. elements is room for
+// R_CAPTURE_MAX_ELEMENTS, a layout with more than that can't be written.
+static bool r_input_layout_call( R_CaptureCall                  *call,
+                                 R_CaptureElement               *elements,
+                                 uint32_t                        id,
+                                 uint32_t                        vs,
+                                 const D3D11_INPUT_ELEMENT_DESC *desc,
+                                 UINT                            numDesc )
+{
+	if ( numDesc > R_CAPTURE_MAX_ELEMENTS )
+		return false;
+
+	for ( UINT i = 0; i < numDesc; ++i )
+	{
+		elements[i].semantic      = desc[i].SemanticName;
+		elements[i].semanticIndex = desc[i].SemanticIndex;
+		elements[i].format        = (uint32_t)desc[i].Format;
+		elements[i].slot          = desc[i].InputSlot;
+		elements[i].offset        = desc[i].AlignedByteOffset;
+		elements[i].perInstance   = (uint32_t)desc[i].InputSlotClass;
+		elements[i].stepRate      = desc[i].InstanceDataStepRate;
+	}
+
+	*call = ( R_CaptureCall ){ .op           = R_CAPTURE_CREATE_INPUT_LAYOUT,
+	                           .id           = id,
+	                           .refs         = { vs },
+	                           .elements     = elements,
+	                           .elementCount = numDesc };
+	return true;
+}
+
+static void r_input_elements_from_call( D3D11_INPUT_ELEMENT_DESC *desc, const R_CaptureCall *call )
+{
+	for ( uint32_t i = 0; i < call->elementCount; ++i )
+	{
+		const R_CaptureElement *e    = &call->elements[i];
+		desc[i].SemanticName         = e->semantic;
+		desc[i].SemanticIndex        = e->semanticIndex;
+		desc[i].Format               = (DXGI_FORMAT)e->format;
+		desc[i].InputSlot            = e->slot;
+		desc[i].AlignedByteOffset    = e->offset;
+		desc[i].InputSlotClass       = (D3D11_INPUT_CLASSIFICATION)e->perInstance;
+		desc[i].InstanceDataStepRate = e->stepRate;
+	}
+}
+
+static void r_capture_input_layout( R_Context                      *ctx,
+                                    uint32_t                        id,
+                                    R_VertexShader                  vs,
+                                    const D3D11_INPUT_ELEMENT_DESC *desc,
+                                    UINT                            numDesc )
+{
+	R_CaptureElement elements[R_CAPTURE_MAX_ELEMENTS];
+	R_CaptureCall    call;
+	if ( r_input_layout_call( &call, elements, id, vs.id, desc, numDesc ) )
+		r_capture_write( &ctx->capture, &call );
+}
+
+#define R_PIPELINE_BLOCK_BYTES \
+	( sizeof( D3D11_RASTERIZER_DESC ) + sizeof( D3D11_BLEND_DESC ) + sizeof( D3D11_DEPTH_STENCIL_DESC ) )
+
+// The fixed-function blocks go into the call as the D3D11 structs they are, one after the other in
+// blocks (R_PIPELINE_BLOCK_BYTES).
+static void r_pipeline_call( R_CaptureCall *call, uint8_t *blocks, uint32_t id, const R_PipelineDesc *desc )
+{
+	size_t blend        = sizeof( desc->rasterizer );
+	size_t depthStencil = blend + sizeof( desc->blend );
+	memcpy( blocks, &desc->rasterizer, sizeof( desc->rasterizer ) );
+	memcpy( blocks + blend, &desc->blend, sizeof( desc->blend ) );
+	memcpy( blocks + depthStencil, &desc->depthStencil, sizeof( desc->depthStencil ) );
+
+	*call = ( R_CaptureCall ){
+	    .op     = R_CAPTURE_CREATE_PIPELINE,
+	    .id     = id,
+	    .refs   = { desc->vs.id, desc->ps.id, desc->layout.id, desc->fallback.id },
+	    .args   = { sizeof( desc->rasterizer ),
+	                sizeof( desc->blend ),
+	                sizeof( desc->depthStencil ),
+	                desc->sampleMask,
+	                desc->stencilRef },
+	    .floats = { desc->blendFactor[0], desc->blendFactor[1], desc->blendFactor[2], desc->blendFactor[3] },
+	    .data   = blocks,
+	    .size   = R_PIPELINE_BLOCK_BYTES,
+	};
+}
+
+// The blocks of a pipeline call, NULL when they aren't this build's D3D11 structs.
+static const uint8_t *r_pipeline_call_blocks( const R_CaptureCall *call )
+{
+	if ( call->args[0] != sizeof( D3D11_RASTERIZER_DESC ) || call->args[1] != sizeof( D3D11_BLEND_DESC ) ||
+	     call->args[2] != sizeof( D3D11_DEPTH_STENCIL_DESC ) || call->size != R_PIPELINE_BLOCK_BYTES )
+		return NULL;
+	return (const uint8_t *)call->data;
+}
+
+static void r_capture_pipeline( R_Context *ctx, uint32_t id, const R_PipelineDesc *desc )
+{
+	uint8_t       blocks[R_PIPELINE_BLOCK_BYTES];
+	R_CaptureCall call;
+	r_pipeline_call( &call, blocks, id, desc );
+	r_capture_write( &ctx->capture, &call );
+}
+
+// Pipeline manifests get the objects' contents, with ids of other entries in place of handles.
+static uint32_t r_record_shader( R_Context *ctx, R_CaptureOp op, const R_ShaderBytecode *bytecode )
+{
+	R_CaptureCall call = { .op = op, .data = bytecode->data, .size = (uint32_t)bytecode->size };
+	return bytecode->data ? r_precache_record( &ctx->manifestRecorder, &call ) : 0;
+}
+
+static uint32_t r_record_input_layout( R_Context                      *ctx,
+                                       uint32_t                        vsIndex,
+                                       const D3D11_INPUT_ELEMENT_DESC *desc,
+                                       UINT                            numDesc )
+{
+	R_CaptureElement elements[R_CAPTURE_MAX_ELEMENTS];
+	R_CaptureCall    call;
+	uint32_t         vs = r_record_shader( ctx, R_CAPTURE_CREATE_VERTEX_SHADER, &ctx->vertexShaders.bytecode[vsIndex] );
+	if ( !desc || !vs || !r_input_layout_call( &call, elements, 0, vs, desc, numDesc ) )
+		return 0;
+	return r_precache_record( &ctx->manifestRecorder, &call );
+}
+
+// Once its shaders are in; the layout goes in against the pipeline's vertex shader.
+static void r_record_pipeline( R_Context *ctx, uint32_t dense )
+{
+	R_PipelineDesc entry = ctx->pipelines.descs[dense];
+	if ( !r_pool_is_valid( &ctx->vertexShaders.pool, entry.vs.id ) ||
+	     !r_pool_is_valid( &ctx->pixelShaders.pool, entry.ps.id ) )
+		return;
+
+	uint32_t vsIndex  = r_pool_lookup( &ctx->vertexShaders.pool, entry.vs.id );
+	uint32_t psIndex  = r_pool_lookup( &ctx->pixelShaders.pool, entry.ps.id );
+
+	entry.vs.id       = r_record_shader( ctx, R_CAPTURE_CREATE_VERTEX_SHADER, &ctx->vertexShaders.bytecode[vsIndex] );
+	entry.ps.id       = r_record_shader( ctx, R_CAPTURE_CREATE_PIXEL_SHADER, &ctx->pixelShaders.bytecode[psIndex] );
+	entry.fallback.id = 0;
+	if ( r_pool_is_valid( &ctx->inputLayouts.pool, entry.layout.id ) )
+	{
+		const R_InputLayoutSource *source =
+		    &ctx->inputLayouts.sources[r_pool_lookup( &ctx->inputLayouts.pool, entry.layout.id )];
+		entry.layout.id = r_record_input_layout( ctx, vsIndex, source->elements, source->count );
+		if ( !entry.layout.id )
+			return;
+	}
+	if ( !entry.vs.id || !entry.ps.id )
+		return;
+
+	uint8_t       blocks[R_PIPELINE_BLOCK_BYTES];
+	R_CaptureCall call;
+	r_pipeline_call( &call, blocks, 0, &entry );
+	r_precache_record( &ctx->manifestRecorder, &call );
+}
+
+static void r_record_sampler( R_Context *ctx, const D3D11_SAMPLER_DESC *desc )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_SAMPLER, .data = desc, .size = sizeof( *desc ) };
+	r_precache_record( &ctx->manifestRecorder, &call );
+}
+
+// Copies a buffer back through a staging buffer. Waits for the GPU, so captures only.
+static void *r_read_buffer( R_Context *ctx, ID3D11Buffer *buffer, size_t bytes )
+{
+	D3D11_BUFFER_DESC bd;
+	buffer->lpVtbl->GetDesc( buffer, &bd );
+	bd.Usage          = D3D11_USAGE_STAGING;
+	bd.BindFlags      = 0;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	bd.MiscFlags      = 0;
+
+	ID3D11Buffer *staging = NULL;
+	void         *data    = malloc( bytes );
+	if ( !data || FAILED( ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, NULL, &staging ) ) )
+	{
+		free( data );
+		return NULL;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	ctx->ctx->lpVtbl->CopyResource( ctx->ctx, (ID3D11Resource *)staging, (ID3D11Resource *)buffer );
+	if ( SUCCEEDED( ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)staging, 0, D3D11_MAP_READ, 0, &mapped ) ) )
+	{
+		memcpy( data, mapped.pData, bytes );
+		ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)staging, 0 );
+	}
+	else
+	{
+		free( data );
+		data = NULL;
+	}
+	safe_release( (IUnknown **)&staging );
+	return data;
+}
+
+// Any live vertex shader with the signature will do, layouts only need that part of it.
+static R_VertexShader r_capture_signature_shader( R_Context *ctx, uint64_t signatureHash )
+{
+	R_VertexShaderStore *store = &ctx->vertexShaders;
+	for ( uint32_t i = 0; signatureHash && i < store->pool.count; ++i )
+	{
+		if ( store->signatureHashes[i] == signatureHash && store->bytecode[i].data )
+			return ( R_VertexShader ){ r_pool_handle_at( &store->pool, i ) };
+	}
+	return ( R_VertexShader ){ 0 };
+}
+
+// Pipelines are created once per reference, after the fallback they point at.
+static void r_capture_live_pipeline( R_Context *ctx, uint32_t i, bool *captured )
+{
+	R_PipelineStore *store = &ctx->pipelines;
+	if ( captured[i] )
+		return;
+	captured[i] = true;
+
+	R_Pipeline fallback = store->descs[i].fallback;
+	if ( r_pool_is_valid( &store->pool, fallback.id ) )
+		r_capture_live_pipeline( ctx, r_pool_lookup( &store->pool, fallback.id ), captured );
+
+	for ( UINT r = 0; r < store->refCounts[i]; ++r )
+		r_capture_pipeline( ctx, r_pool_handle_at( &store->pool, i ), &store->descs[i] );
+}
+
+// The setup part of a capture: everything alive right now, with the reference counts it has.
+static void r_capture_live_objects( R_Context *ctx )
+{
+	R_CaptureWriter *w = &ctx->capture;
+
+	// Queued uploads would otherwise land in the middle of the frame without being part of it.
+	r_finish_uploads( ctx );
+
+	for ( uint32_t i = 0; i < ctx->buffers.pool.count; ++i )
+	{
+		ID3D11Buffer     *buffer = ctx->buffers.buffers[i];
+		D3D11_BUFFER_DESC bd;
+		buffer->lpVtbl->GetDesc( buffer, &bd );
+
+		void         *contents = r_read_buffer( ctx, buffer, ctx->buffers.sizes[i] );
+		uint32_t      bytes    = (uint32_t)ctx->buffers.sizes[i];
+		R_CaptureCall call     = { .op   = R_CAPTURE_CREATE_BUFFER,
+		                           .id   = r_pool_handle_at( &ctx->buffers.pool, i ),
+		                           .args = { bd.Usage == D3D11_USAGE_DYNAMIC, bd.BindFlags, bytes },
+		                           .data = contents,
+		                           .size = contents ? bytes : 0 };
+		r_capture_write( w, &call );
+		free( contents );
+	}
+
+	// Shaders still compiling have no bytecode yet and are left out, along with what's built on them.
+	for ( uint32_t i = 0; i < ctx->vertexShaders.pool.count; ++i )
+	{
+		uint32_t id = r_pool_handle_at( &ctx->vertexShaders.pool, i );
+		r_capture_shader( ctx, R_CAPTURE_CREATE_VERTEX_SHADER, id, &ctx->vertexShaders.bytecode[i] );
+	}
+	for ( uint32_t i = 0; i < ctx->pixelShaders.pool.count; ++i )
+	{
+		uint32_t id = r_pool_handle_at( &ctx->pixelShaders.pool, i );
+		r_capture_shader( ctx, R_CAPTURE_CREATE_PIXEL_SHADER, id, &ctx->pixelShaders.bytecode[i] );
+	}
+
+	// Every pipeline holds a reference on its layout, which replaying the pipeline takes again.
+	R_InputLayoutStore *layouts = &ctx->inputLayouts;
+	R_PipelineStore    *pipes   = &ctx->pipelines;
+	for ( uint32_t i = 0; i < layouts->pool.count; ++i )
+	{
+		R_InputLayoutSource *source = &layouts->sources[i];
+		R_VertexShader       vs     = r_capture_signature_shader( ctx, source->signatureHash );
+		if ( !source->elements || !vs.id )
+			continue;
+
+		uint32_t id    = r_pool_handle_at( &layouts->pool, i );
+		UINT     owned = layouts->refCounts[i];
+		for ( uint32_t p = 0; p < pipes->pool.count; ++p )
+			owned -= pipes->layouts[p].id == id ? 1 : 0;
+		for ( UINT r = 0; r < owned || r == 0; ++r )
+			r_capture_input_layout( ctx, id, vs, source->elements, source->count );
+	}
+
+	bool *captured = (bool *)calloc( pipes->pool.count + 1, sizeof( bool ) );
+	for ( uint32_t i = 0; captured && i < pipes->pool.count; ++i )
+		r_capture_live_pipeline( ctx, i, captured );
+	free( captured );
+
+	// Layouts only the pipelines hold on to were created once more than they are owned.
+	for ( uint32_t i = 0; i < layouts->pool.count; ++i )
+	{
+		uint32_t id    = r_pool_handle_at( &layouts->pool, i );
+		UINT     users = 0;
+		for ( uint32_t p = 0; p < pipes->pool.count; ++p )
+			users += pipes->layouts[p].id == id ? 1 : 0;
+		if ( layouts->sources[i].elements && users == layouts->refCounts[i] )
+		{
+			R_CaptureCall call = { .op = R_CAPTURE_DESTROY_INPUT_LAYOUT, .id = id };
+			r_capture_write( w, &call );
+		}
+	}
+
+	R_CaptureCall viewport = { .op     = R_CAPTURE_SET_VIEWPORT,
+	                           .floats = { ctx->vp.TopLeftX, ctx->vp.TopLeftY, ctx->vp.Width, ctx->vp.Height } };
+	R_CaptureCall frame    = { .op = R_CAPTURE_FRAME };
+	r_capture_write( w, &viewport );
+	r_capture_write( w, &frame );
+}
+
+static void r_start_capture( R_Context *ctx )
+{
+	ctx->captureArmed = false;
+	r_capture_writer_init( &ctx->capture );
+	r_capture_live_objects( ctx );
+	ctx->capturing = true;
+}
+
+static void r_end_capture( R_Context *ctx )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_PRESENT };
+	r_capture_write( &ctx->capture, &call );
+	r_capture_writer_save( &ctx->capture, ctx->capturePath );
+
+	r_capture_writer_free( &ctx->capture );
+	free( ctx->capturePath );
+	ctx->capturePath = NULL;
+	ctx->capturing   = false;
+	r_drop_sources( ctx );
+}
+
+const char *r_result_to_string( R_Result result )
+{
+	switch ( result )
+	{
+	case R_OK:
+		return "Success";
+	case R_ERROR_DEVICE_CREATION_FAILED:
+		return "Failed to create D3D11 device";
+	case R_ERROR_SWAP_CHAIN_FAILED:
+		return "Failed to create swap chain";
+	case R_ERROR_BUFFER_CREATION_FAILED:
+		return "Failed to create buffer";
+	case R_ERROR_SHADER_COMPILATION_FAILED:
+		return "Shader compilation failed";
+	case R_ERROR_SHADER_CREATION_FAILED:
+		return "Failed to create shader";
+	case R_ERROR_INPUT_LAYOUT_FAILED:
+		return "Failed to create input layout";
+	case R_ERROR_INVALID_PARAMETER:
+		return "Invalid parameter";
+	case R_ERROR_OUT_OF_MEMORY:
+		return "Out of memory";
+	case R_ERROR_STATE_CREATION_FAILED:
+		return "Failed to create pipeline state object";
+	case R_ERROR_TEXTURE_CREATION_FAILED:
+		return "Failed to create texture";
+	default:
+		return "Unknown error";
+	}
+}
+
+R_Context *r_create_context( HWND hwnd, int width, int height, bool vsync, R_Result *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	UINT createFlags = 0;
+#if defined( _DEBUG )
+	createFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_1, D3D_FEATURE_LEVEL_10_0 };
+	D3D_FEATURE_LEVEL chosen          = D3D_FEATURE_LEVEL_11_0;
+
+	IDXGISwapChain      *swap   = NULL;
+	ID3D11Device        *device = NULL;
+	ID3D11DeviceContext *ctx    = NULL;
+
+	DXGI_SWAP_CHAIN_DESC sd = { 0 };
+	sd.BufferCount          = 1;
+	sd.BufferDesc.Width     = width;
+	sd.BufferDesc.Height    = height;
+	sd.BufferDesc.Format    = DXGI_FORMAT_R8G8B8A8_UNORM;
+	sd.BufferUsage          = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	sd.OutputWindow         = hwnd;
+	sd.SampleDesc.Count     = 1;
+	sd.Windowed             = TRUE;
+	sd.SwapEffect           = DXGI_SWAP_EFFECT_DISCARD;
+
+	HRESULT hr = D3D11CreateDeviceAndSwapChain( NULL,
+	                                            D3D_DRIVER_TYPE_HARDWARE,
+	                                            NULL,
+	                                            createFlags,
+	                                            featureLevels,
+	                                            ARRAYSIZE( featureLevels ),
+	                                            D3D11_SDK_VERSION,
+	                                            &sd,
+	                                            &swap,
+	                                            &device,
+	                                            &chosen,
+	                                            &ctx );
+
+	if ( FAILED( hr ) )
+	{
+		*outResult = R_ERROR_DEVICE_CREATION_FAILED;
+		return NULL;
+	}
+
+	ID3D11Texture2D *backbuf = NULL;
+	hr                       = swap->lpVtbl->GetBuffer( swap, 0, &IID_ID3D11Texture2D, (void **)&backbuf );
+	if ( FAILED( hr ) )
+	{
+		safe_release( (IUnknown **)&swap );
+		safe_release( (IUnknown **)&device );
+		safe_release( (IUnknown **)&ctx );
+		*outResult = R_ERROR_SWAP_CHAIN_FAILED;
+		return NULL;
+	}
+
+	ID3D11RenderTargetView *rtv = NULL;
+	hr = device->lpVtbl->CreateRenderTargetView( device, (ID3D11Resource *)backbuf, NULL, &rtv );
+	backbuf->lpVtbl->Release( backbuf );
+	if ( FAILED( hr ) )
+	{
+		safe_release( (IUnknown **)&swap );
+		safe_release( (IUnknown **)&device );
+		safe_release( (IUnknown **)&ctx );
+		*outResult = R_ERROR_SWAP_CHAIN_FAILED;
+		return NULL;
+	}
+
+	R_Context *r = (R_Context *)malloc( sizeof( R_Context ) );
+	if ( !r )
+	{
+		safe_release( (IUnknown **)&rtv );
+		safe_release( (IUnknown **)&swap );
+		safe_release( (IUnknown **)&device );
+		safe_release( (IUnknown **)&ctx );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return NULL;
+	}
+
+	memset( r, 0, sizeof( *r ) );
+	r->device = device;
+	r->ctx    = ctx;
+	r->swap   = swap;
+	r->rtv    = rtv;
+	r->width  = (UINT)width;
+	r->height = (UINT)height;
+	r->vsync  = vsync;
+	r->owner  = sys_thread_id();
+
+	r->uploadBudget            = R_UPLOAD_FRAME_BUDGET;
+	r->geometryHeapVertexBytes = R_GEOMETRY_HEAP_VERTEX_BYTES;
+	r->geometryHeapIndices     = R_GEOMETRY_HEAP_INDICES;
+	r->resourceEpoch           = 1;
+	r_state_cache_init( &r->state );
+
+	if ( !r_init_stores( r ) )
+	{
+		r_destroy_context( r );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return NULL;
+	}
+
+	R_Result fenceResult = r_create_frame_fences( r );
+	if ( fenceResult != R_OK )
+	{
+		r_destroy_context( r );
+		*outResult = fenceResult;
+		return NULL;
+	}
+
+	R_Result ringResult = r_create_constant_ring( r );
+	if ( ringResult != R_OK )
+	{
+		r_destroy_context( r );
+		*outResult = ringResult;
+		return NULL;
+	}
+
+	ctx->lpVtbl->OMSetRenderTargets( ctx, 1, &r->rtv, NULL );
+	r_set_viewport( r, 0.0f, 0.0f, (float)width, (float)height );
+
+	*outResult = R_OK;
+	return r;
+}
+
+void r_destroy_context( R_Context *ctx )
+{
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+	// The precache thread creates through the device, it has to be done before anything goes.
+	r_wait_pipeline_manifest( ctx );
+	r_save_pipeline_manifest( ctx );
+	r_finish_releases( ctx );
+	r_release_queue_free( &ctx->releases );
+	r_capture_writer_free( &ctx->capture );
+	free( ctx->capturePath );
+	for ( int i = 0; i < R_RING_MAX_FRAMES; ++i )
+		safe_release( (IUnknown **)&ctx->frameFences[i] );
+	safe_release( (IUnknown **)&ctx->constantRing );
+	safe_release( (IUnknown **)&ctx->ctx1 );
+	for ( int i = 0; i < R_RING_MAX_FRAMES; ++i )
+		safe_release( (IUnknown **)&ctx->uploadStaging[i] );
+	r_upload_queue_free( &ctx->uploads );
+	r_release_graph_textures( ctx );
+	safe_release( (IUnknown **)&ctx->instanceStream.buffer );
+	safe_release( (IUnknown **)&ctx->batchVertices.buffer );
+	safe_release( (IUnknown **)&ctx->batchIndices );
+	safe_release( (IUnknown **)&ctx->copyScratch );
+	r_shader_jobs_shutdown( &ctx->shaderJobs );
+	r_free_stores( ctx );
+	r_shader_cache_close( &ctx->shaderCache );
+	safe_release( (IUnknown **)&ctx->rtv );
+	safe_release( (IUnknown **)&ctx->swap );
+	safe_release( (IUnknown **)&ctx->ctx );
+	safe_release( (IUnknown **)&ctx->device );
+	free( ctx );
+}
+
+void r_take_context( R_Context *ctx )
+{
+	if ( ctx )
+		ctx->owner = sys_thread_id();
+}
+
+void r_present( R_Context *ctx )
+{
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+
+	if ( ctx->capturing )
+		r_end_capture( ctx );
+
+	r_flush_uploads( ctx, ctx->uploadBudget );
+
+	// The fence slot about to be reused still belongs to the oldest frame in flight.
+	if ( ctx->frameIndex - ctx->completedFrames == R_RING_MAX_FRAMES )
+		r_retire_frames( ctx, true );
+
+	r_unmap_constant_ring( ctx );
+	ctx->ctx->lpVtbl->End( ctx->ctx, (ID3D11Asynchronous *)ctx->frameFences[ctx->frameIndex % R_RING_MAX_FRAMES] );
+	if ( ctx->constantRing )
+		r_ring_end_frame( &ctx->constantRingAlloc, ctx->frameIndex );
+	ctx->frameIndex++;
+	r_release_queue_set_frame( &ctx->releases, ctx->frameIndex );
+
+	ctx->swap->lpVtbl->Present( ctx->swap, ctx->vsync ? 1 : 0, 0 );
+
+	r_retire_frames( ctx, false );
+
+	if ( ctx->captureArmed )
+		r_start_capture( ctx );
+
+	r_poll_shader_jobs( ctx );
+	r_poll_pipeline_manifest( ctx );
+}
+
+void r_defer_release( R_Context *ctx, IUnknown *object )
+{
+	if ( ctx && object )
+		r_defer_release_object( ctx, &object );
+}
+
+void r_finish_releases( R_Context *ctx )
+{
+	if ( !ctx || !ctx->frameFences[0] )
+		return;
+
+	// Fences only cover presented frames, close the one being recorded so its work is waited on too.
+	if ( ctx->frameIndex - ctx->completedFrames == R_RING_MAX_FRAMES )
+		r_retire_frames( ctx, true );
+	r_unmap_constant_ring( ctx );
+	ctx->ctx->lpVtbl->End( ctx->ctx, (ID3D11Asynchronous *)ctx->frameFences[ctx->frameIndex % R_RING_MAX_FRAMES] );
+	if ( ctx->constantRing )
+		r_ring_end_frame( &ctx->constantRingAlloc, ctx->frameIndex );
+	ctx->frameIndex++;
+	r_release_queue_set_frame( &ctx->releases, ctx->frameIndex );
+
+	while ( ctx->completedFrames < ctx->frameIndex )
+		r_retire_frames( ctx, true );
+	r_release_queue_drain( &ctx->releases );
+}
+
+void r_get_release_stats( R_Context *ctx, R_ReleaseStats *outStats )
+{
+	if ( !ctx || !outStats )
+		return;
+	r_release_queue_get_stats( &ctx->releases, outStats );
+}
+
+bool r_capture_frame( R_Context *ctx, const char *path )
+{
+	if ( !ctx || !path || ctx->captureArmed || ctx->capturing )
+		return false;
+
+	size_t length    = strlen( path ) + 1;
+	ctx->capturePath = (char *)malloc( length );
+	if ( !ctx->capturePath )
+		return false;
+	memcpy( ctx->capturePath, path, length );
+	ctx->captureArmed = true;
+	return true;
+}
+
+void r_keep_capture_sources( R_Context *ctx )
+{
+	if ( ctx )
+		ctx->keepSources = true;
+}
+
+void r_clear_render_target( R_Context *ctx, float r, float g, float b, float a )
+{
+	if ( !ctx )
+		return;
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_CLEAR, .floats = { r, g, b, a } };
+		r_capture_write( &ctx->capture, &call );
+	}
+	float clearColor[4] = { r, g, b, a };
+	ctx->ctx->lpVtbl->ClearRenderTargetView( ctx->ctx, ctx->rtv, clearColor );
+}
+
+void r_set_viewport( R_Context *ctx, float x, float y, float w, float h )
+{
+	if ( !ctx )
+		return;
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_SET_VIEWPORT, .floats = { x, y, w, h } };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	R_Viewport vp = { x, y, w, h, 0.0f, 1.0f };
+	if ( !r_state_cache_set_viewport( &ctx->state, &vp ) )
+		return;
+
+	ctx->vp.TopLeftX = x;
+	ctx->vp.TopLeftY = y;
+	ctx->vp.Width    = w;
+	ctx->vp.Height   = h;
+	ctx->vp.MinDepth = 0.0f;
+	ctx->vp.MaxDepth = 1.0f;
+
+	ctx->ctx->lpVtbl->RSSetViewports( ctx->ctx, 1, &ctx->vp );
+}
+
+R_Buffer
+r_create_buffer( R_Context *ctx, const void *data, size_t bytes, bool dynamic, UINT bindFlags, R_Result *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	R_Buffer handle = { 0 };
+	if ( !ctx )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory( &bd, sizeof( bd ) );
+	bd.ByteWidth           = (UINT)bytes;
+	bd.BindFlags           = bindFlags;
+	bd.CPUAccessFlags      = dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	bd.Usage               = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	bd.MiscFlags           = 0;
+	bd.StructureByteStride = 0;
+
+	D3D11_SUBRESOURCE_DATA initData;
+	ZeroMemory( &initData, sizeof( initData ) );
+	initData.pSysMem = data;
+
+	ID3D11Buffer *buf = NULL;
+	HRESULT       hr  = ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, data ? &initData : NULL, &buf );
+	if ( FAILED( hr ) )
+	{
+		*outResult = R_ERROR_BUFFER_CREATION_FAILED;
+		return handle;
+	}
+
+	uint32_t dense = 0;
+	handle.id      = r_pool_alloc( &ctx->buffers.pool, &dense );
+	if ( !handle.id )
+	{
+		safe_release( (IUnknown **)&buf );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return handle;
+	}
+
+	ctx->buffers.buffers[dense] = buf;
+	ctx->buffers.sizes[dense]   = bytes;
+	*outResult                  = R_OK;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op   = R_CAPTURE_CREATE_BUFFER,
+		                       .id   = handle.id,
+		                       .args = { dynamic, bindFlags, (uint32_t)bytes },
+		                       .data = data,
+		                       .size = data ? (uint32_t)bytes : 0 };
+		r_capture_write( &ctx->capture, &call );
+	}
+	return handle;
+}
+
+R_Buffer r_create_constant_buffer( R_Context *ctx, size_t size, R_Result *outResult )
+{
+	if ( !ctx )
+	{
+		if ( outResult )
+			*outResult = R_ERROR_INVALID_PARAMETER;
+		return ( R_Buffer ){ 0 };
+	}
+
+	// 16 byte alignment for constant buffers
+	size_t alignedSize = ( size + 15 ) & ~15;
+	return r_create_buffer( ctx, NULL, alignedSize, true, D3D11_BIND_CONSTANT_BUFFER, outResult );
+}
+
+void r_update_buffer( R_Context *ctx, R_Buffer buf, const void *data, size_t bytes )
+{
+	if ( !ctx || !data )
+		return;
+	R_ASSERT_OWNER( ctx );
+
+	ID3D11Buffer *b = r_buffer_get( ctx, buf );
+	if ( !b )
+		return;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_UPDATE_BUFFER, .id = buf.id, .data = data, .size = (uint32_t)bytes };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HRESULT hr = ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)b, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped );
+	if ( SUCCEEDED( hr ) )
+	{
+		memcpy( mapped.pData, data, bytes );
+		ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)b, 0 );
+	}
+}
+
+void r_bind_constant_buffer( R_Context *ctx, R_Buffer cb, int slot )
+{
+	if ( !ctx )
+		return;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_CONSTANT_BUFFER, .id = cb.id, .args = { (uint32_t)slot } };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	if ( slot >= 0 && slot < R_MAX_CONSTANT_BUFFER_SLOTS )
+	{
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_CONSTANTS, R_STAGE_VERTEX, 1u << slot );
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_CONSTANTS, R_STAGE_PIXEL, 1u << slot );
+	}
+
+	ID3D11Buffer *buf = r_buffer_get( ctx, cb );
+	if ( r_state_cache_set_constant_buffer( &ctx->state, R_STAGE_VERTEX, slot, buf ) )
+		ctx->ctx->lpVtbl->VSSetConstantBuffers( ctx->ctx, slot, 1, &buf );
+	if ( r_state_cache_set_constant_buffer( &ctx->state, R_STAGE_PIXEL, slot, buf ) )
+		ctx->ctx->lpVtbl->PSSetConstantBuffers( ctx->ctx, slot, 1, &buf );
+}
+
+bool r_push_constants( R_Context *ctx, const void *data, size_t bytes, int slot )
+{
+	if ( !ctx || !data || bytes == 0 || bytes > R_MAX_PUSH_CONSTANT_BYTES )
+		return false;
+
+	if ( !ctx->constantRing )
+	{
+		r_update_buffer( ctx, ctx->constantFallback, data, bytes );
+		r_bind_constant_buffer( ctx, ctx->constantFallback, slot );
+		return true;
+	}
+
+	// The fallback above is captured as the buffer calls it makes.
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = {
+		    .op = R_CAPTURE_PUSH_CONSTANTS, .args = { (uint32_t)slot }, .data = data, .size = (uint32_t)bytes
+		};
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	size_t offset = 0;
+	while ( !r_ring_alloc( &ctx->constantRingAlloc, bytes, &offset ) )
+	{
+		// Ring is full of frames the GPU hasn't finished, block on the oldest one.
+		if ( !r_retire_frames( ctx, true ) )
+			return false;
+	}
+
+	// Pushes between two draws share one map, the draw unmaps (r_unmap_constant_ring).
+	if ( !ctx->constantRingData )
+	{
+		// The very first map of a dynamic buffer has to discard, after that the fences guard reuse.
+		D3D11_MAP mapType = ctx->constantRingMapped ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD;
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)ctx->constantRing, 0, mapType, 0, &mapped );
+		if ( FAILED( hr ) )
+			return false;
+		ctx->constantRingData   = (uint8_t *)mapped.pData;
+		ctx->constantRingMapped = true;
+	}
+	memcpy( ctx->constantRingData + offset, data, bytes );
+
+	UINT firstConstant = (UINT)( offset / 16 );
+	UINT numConstants  = (UINT)( ( ( bytes + R_CONSTANT_RING_ALIGNMENT - 1 ) & ~( R_CONSTANT_RING_ALIGNMENT - 1 ) ) / 16 );
+
+	if ( slot >= 0 && slot < R_MAX_CONSTANT_BUFFER_SLOTS )
+	{
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_CONSTANTS, R_STAGE_VERTEX, 1u << slot );
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_CONSTANTS, R_STAGE_PIXEL, 1u << slot );
+	}
+
+	ID3D11Buffer *buf = ctx->constantRing;
+	if ( r_state_cache_set_constant_buffer_range( &ctx->state, R_STAGE_VERTEX, slot, buf, firstConstant, numConstants ) )
+		ctx->ctx1->lpVtbl->VSSetConstantBuffers1( ctx->ctx1, slot, 1, &buf, &firstConstant, &numConstants );
+	if ( r_state_cache_set_constant_buffer_range( &ctx->state, R_STAGE_PIXEL, slot, buf, firstConstant, numConstants ) )
+		ctx->ctx1->lpVtbl->PSSetConstantBuffers1( ctx->ctx1, slot, 1, &buf, &firstConstant, &numConstants );
+	return true;
+}
+
+void r_destroy_buffer( R_Context *ctx, R_Buffer buf )
+{
+	uint32_t dense, moved;
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+	if ( !r_pool_release( &ctx->buffers.pool, buf.id, &dense, &moved ) )
+		return;
+
+	if ( ctx->uploads.count )
+		r_upload_queue_cancel( &ctx->uploads, buf.id );
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DESTROY_BUFFER, .id = buf.id };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	r_defer_release_object( ctx, (IUnknown **)&ctx->buffers.buffers[dense] );
+	ctx->resourceEpoch++;
+	ctx->buffers.buffers[dense] = ctx->buffers.buffers[moved];
+	ctx->buffers.sizes[dense]   = ctx->buffers.sizes[moved];
+	ctx->buffers.buffers[moved] = NULL;
+}
+
+void r_finish_uploads( R_Context *ctx )
+{
+	if ( !ctx )
+		return;
+	while ( r_flush_uploads( ctx, ctx->uploadBudget ) )
+		;
+}
+
+static bool r_queue_upload( R_Context       *ctx,
+                            R_Buffer         buf,
+                            size_t           offset,
+                            const void      *data,
+                            size_t           bytes,
+                            R_UploadCallback callback,
+                            void            *user )
+{
+	if ( !ctx->uploads.ring && !r_upload_queue_init( &ctx->uploads, R_UPLOAD_RING_SIZE ) )
+		return false;
+
+	if ( r_upload_queue_push( &ctx->uploads, buf.id, (uint32_t)offset, data, bytes, callback, user ) )
+		return true;
+
+	// Out of ring space: drain it, so the direct write below can't be overtaken by older queued data.
+	r_finish_uploads( ctx );
+	return r_upload_queue_push( &ctx->uploads, buf.id, (uint32_t)offset, data, bytes, callback, user );
+}
+
+bool r_queue_buffer_upload( R_Context       *ctx,
+                            R_Buffer         buf,
+                            size_t           offset,
+                            const void      *data,
+                            size_t           bytes,
+                            R_UploadCallback callback,
+                            void            *user )
+{
+	if ( !ctx || !data || bytes == 0 )
+		return false;
+	R_ASSERT_OWNER( ctx );
+
+	uint32_t i = r_pool_lookup( &ctx->buffers.pool, buf.id );
+	if ( i == R_POOL_INVALID || offset + bytes > ctx->buffers.sizes[i] || offset + bytes > UINT32_MAX )
+		return false;
+
+	// A dynamic buffer can't be a copy destination, and a queued copy would land after the maps that follow.
+	D3D11_BUFFER_DESC bd;
+	ctx->buffers.buffers[i]->lpVtbl->GetDesc( ctx->buffers.buffers[i], &bd );
+	if ( bd.Usage == D3D11_USAGE_DYNAMIC )
+		return false;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op   = R_CAPTURE_UPLOAD_BUFFER,
+		                       .id   = buf.id,
+		                       .args = { (uint32_t)offset },
+		                       .data = data,
+		                       .size = (uint32_t)bytes };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	if ( r_queue_upload( ctx, buf, offset, data, bytes, callback, user ) )
+		return true;
+
+	// Bigger than the whole ring (or no ring at all), straight to the driver.
+	D3D11_BOX box = { (UINT)offset, 0, 0, (UINT)( offset + bytes ), 1, 1 };
+	ctx->ctx->lpVtbl->UpdateSubresource( ctx->ctx, (ID3D11Resource *)ctx->buffers.buffers[i], 0, &box, data, 0, 0 );
+	if ( callback )
+		callback( user, buf.id );
+	return true;
+}
+
+R_Buffer r_create_buffer_deferred( R_Context       *ctx,
+                                   const void      *data,
+                                   size_t           bytes,
+                                   UINT             bindFlags,
+                                   R_UploadCallback callback,
+                                   void            *user,
+                                   R_Result        *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	if ( !ctx || !data || bytes == 0 )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return ( R_Buffer ){ 0 };
+	}
+
+	R_Buffer buf = r_create_buffer( ctx, NULL, bytes, false, bindFlags, outResult );
+	if ( buf.id && !r_queue_buffer_upload( ctx, buf, 0, data, bytes, callback, user ) )
+	{
+		r_destroy_buffer( ctx, buf );
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return ( R_Buffer ){ 0 };
+	}
+	return buf;
+}
+
+void r_set_upload_budget( R_Context *ctx, size_t bytesPerFrame )
+{
+	if ( !ctx || bytesPerFrame == 0 || bytesPerFrame > UINT32_MAX )
+		return;
+	// Staging buffers grow on the next flush, a smaller budget just leaves part of them unused.
+	ctx->uploadBudget = bytesPerFrame;
+}
+
+void r_get_upload_stats( R_Context *ctx, R_UploadStats *outStats )
+{
+	if ( !ctx || !outStats )
+		return;
+	*outStats = ctx->uploads.stats;
+}
+
+static void r_copy_buffer_bytes(
+    R_Context *ctx, ID3D11Buffer *dst, UINT dstOffset, ID3D11Buffer *src, UINT srcOffset, UINT bytes )
+{
+	D3D11_BOX box = { srcOffset, 0, 0, srcOffset + bytes, 1, 1 };
+	ctx->ctx->lpVtbl->CopySubresourceRegion(
+	    ctx->ctx, (ID3D11Resource *)dst, 0, dstOffset, 0, 0, (ID3D11Resource *)src, 0, &box );
+}
+
+// Copies between (or within) buffers; regions of the same buffer must not overlap. D3D11 doesn't
+// copy a subresource onto itself, so a copy within one buffer goes through copyScratch.
+static void r_copy_buffer_region( R_Context *ctx,
+                                  R_Buffer   dst,
+                                  UINT       dstOffset,
+                                  R_Buffer   src,
+                                  UINT       srcOffset,
+                                  UINT       bytes )
+{
+	ID3D11Buffer *d = r_buffer_get( ctx, dst );
+	ID3D11Buffer *s = r_buffer_get( ctx, src );
+	if ( !d || !s || bytes == 0 )
+		return;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = {
+		    .op = R_CAPTURE_COPY_BUFFER, .id = dst.id, .refs = { src.id }, .args = { dstOffset, srcOffset, bytes }
+		};
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	if ( d != s )
+	{
+		r_copy_buffer_bytes( ctx, d, dstOffset, s, srcOffset, bytes );
+		return;
+	}
+
+	if ( !ctx->copyScratch )
+	{
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof( bd ) );
+		bd.ByteWidth = R_COPY_SCRATCH_BYTES;
+		bd.Usage     = D3D11_USAGE_DEFAULT;
+		if ( FAILED( ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, NULL, &ctx->copyScratch ) ) )
+			return;
+	}
+	for ( UINT done = 0; done < bytes; done += R_COPY_SCRATCH_BYTES )
+	{
+		UINT piece = bytes - done < R_COPY_SCRATCH_BYTES ? bytes - done : R_COPY_SCRATCH_BYTES;
+		r_copy_buffer_bytes( ctx, ctx->copyScratch, 0, s, srcOffset + done, piece );
+		r_copy_buffer_bytes( ctx, d, dstOffset + done, ctx->copyScratch, 0, piece );
+	}
+}
+
+static R_GeometryHeap *r_create_geometry_heap( R_Context *ctx, UINT stride, R_Result *outResult )
+{
+	*outResult = R_ERROR_OUT_OF_MEMORY;
+	if ( ctx->geometryHeapCount == R_MAX_GEOMETRY_HEAPS )
+		return NULL;
+
+	R_GeometryHeap *heap     = &ctx->geometryHeaps[ctx->geometryHeapCount];
+	uint32_t        vertices = (uint32_t)( ctx->geometryHeapVertexBytes / stride );
+	uint32_t        indices  = ctx->geometryHeapIndices;
+	memset( heap, 0, sizeof( *heap ) );
+	heap->stride = stride;
+
+	if ( !r_offset_alloc_init( &heap->vertexAlloc, vertices, R_MAX_MESHES ) ||
+	     !r_offset_alloc_init( &heap->indexAlloc, indices, R_MAX_MESHES ) )
+	{
+		r_offset_alloc_free( &heap->vertexAlloc );
+		return NULL;
+	}
+
+	heap->vertices = r_create_buffer( ctx, NULL, (size_t)vertices * stride, false, D3D11_BIND_VERTEX_BUFFER, NULL );
+	heap->indices =
+	    r_create_buffer( ctx, NULL, (size_t)indices * sizeof( uint32_t ), false, D3D11_BIND_INDEX_BUFFER, NULL );
+	if ( !heap->vertices.id || !heap->indices.id )
+	{
+		*outResult = R_ERROR_BUFFER_CREATION_FAILED;
+		r_destroy_buffer( ctx, heap->vertices );
+		r_destroy_buffer( ctx, heap->indices );
+		r_offset_alloc_free( &heap->vertexAlloc );
+		r_offset_alloc_free( &heap->indexAlloc );
+		return NULL;
+	}
+
+	ctx->geometryHeapCount++;
+	*outResult = R_OK;
+	return heap;
+}
+
+// Both ranges come from the first heap of the stride with room for them, or from a new heap.
+static R_GeometryHeap *r_geometry_heap_alloc( R_Context          *ctx,
+                                              UINT                stride,
+                                              uint32_t            vertexCount,
+                                              uint32_t            indexCount,
+                                              R_OffsetAllocation *outVertices,
+                                              R_OffsetAllocation *outIndices,
+                                              R_Result           *outResult )
+{
+	uint32_t existing = ctx->geometryHeapCount;
+	for ( uint32_t i = 0; i <= existing; ++i )
+	{
+		R_GeometryHeap *heap = &ctx->geometryHeaps[i];
+		if ( i == existing )
+			heap = r_create_geometry_heap( ctx, stride, outResult );
+		else if ( heap->stride != stride )
+			continue;
+		if ( !heap )
+			return NULL;
+
+		*outVertices = r_offset_alloc( &heap->vertexAlloc, vertexCount );
+		*outIndices  = r_offset_alloc( &heap->indexAlloc, indexCount );
+		if ( outVertices->offset != R_OFFSET_ALLOC_NONE && outIndices->offset != R_OFFSET_ALLOC_NONE )
+			return heap;
+		r_offset_free( &heap->vertexAlloc, *outVertices );
+		r_offset_free( &heap->indexAlloc, *outIndices );
+	}
+
+	*outResult = R_ERROR_OUT_OF_MEMORY;
+	return NULL;
+}
+
+R_Mesh r_create_mesh( R_Context      *ctx,
+                      const void     *vertices,
+                      uint32_t        vertexCount,
+                      UINT            stride,
+                      const uint32_t *indices,
+                      uint32_t        indexCount,
+                      R_Result       *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	// A mesh larger than a whole heap would never find room.
+	R_Mesh mesh = { 0 };
+	if ( !ctx || !vertices || !indices || vertexCount == 0 || indexCount == 0 || stride == 0 ||
+	     (uint64_t)vertexCount * stride > ctx->geometryHeapVertexBytes || indexCount > ctx->geometryHeapIndices )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return mesh;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	R_OffsetAllocation vertexRange, indexRange;
+	R_GeometryHeap    *heap =
+	    r_geometry_heap_alloc( ctx, stride, vertexCount, indexCount, &vertexRange, &indexRange, outResult );
+	if ( !heap )
+		return mesh;
+
+	// Both go through the batched upload path, the mesh draws once the copies are recorded.
+	uint32_t dense       = 0;
+	size_t   vertexBytes = (size_t)vertexCount * stride;
+	size_t   indexBytes  = (size_t)indexCount * sizeof( uint32_t );
+	mesh.id              = r_pool_alloc( &ctx->meshes.pool, &dense );
+	if ( !mesh.id ||
+	     !r_queue_buffer_upload(
+	         ctx, heap->vertices, (size_t)vertexRange.offset * stride, vertices, vertexBytes, NULL, NULL ) ||
+	     !r_queue_buffer_upload(
+	         ctx, heap->indices, (size_t)indexRange.offset * sizeof( uint32_t ), indices, indexBytes, NULL, NULL ) )
+	{
+		// The mesh took the last dense entry, nothing moves. Vertices already queued land in the freed
+		// range before anything queued for its next owner.
+		uint32_t moved;
+		if ( mesh.id )
+			r_pool_release( &ctx->meshes.pool, mesh.id, &dense, &moved );
+		r_offset_free( &heap->vertexAlloc, vertexRange );
+		r_offset_free( &heap->indexAlloc, indexRange );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return ( R_Mesh ){ 0 };
+	}
+
+	ctx->meshes.heaps[dense]        = (uint8_t)( heap - ctx->geometryHeaps );
+	ctx->meshes.vertices[dense]     = vertexRange;
+	ctx->meshes.indices[dense]      = indexRange;
+	ctx->meshes.vertexCounts[dense] = vertexCount;
+	ctx->meshes.indexCounts[dense]  = indexCount;
+	ctx->meshes.uploads[dense]      = ctx->uploads.pushed;
+	*outResult                      = R_OK;
+	return mesh;
+}
+
+void r_destroy_mesh( R_Context *ctx, R_Mesh mesh )
+{
+	uint32_t dense, moved;
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+	if ( !r_pool_release( &ctx->meshes.pool, mesh.id, &dense, &moved ) )
+		return;
+
+	// Draws already recorded still read the old ranges, but nothing can be copied into them before
+	// those draws in the immediate context's order.
+	R_GeometryHeap *heap = &ctx->geometryHeaps[ctx->meshes.heaps[dense]];
+	r_offset_free( &heap->vertexAlloc, ctx->meshes.vertices[dense] );
+	r_offset_free( &heap->indexAlloc, ctx->meshes.indices[dense] );
+
+	ctx->meshes.heaps[dense]        = ctx->meshes.heaps[moved];
+	ctx->meshes.vertices[dense]     = ctx->meshes.vertices[moved];
+	ctx->meshes.indices[dense]      = ctx->meshes.indices[moved];
+	ctx->meshes.vertexCounts[dense] = ctx->meshes.vertexCounts[moved];
+	ctx->meshes.indexCounts[dense]  = ctx->meshes.indexCounts[moved];
+	ctx->meshes.uploads[dense]      = ctx->meshes.uploads[moved];
+}
+
+static R_GeometryHeap *r_bind_mesh( R_Context *ctx, R_Mesh mesh, uint32_t *outDense )
+{
+	uint32_t i = ctx ? r_pool_lookup( &ctx->meshes.pool, mesh.id ) : R_POOL_INVALID;
+	if ( i == R_POOL_INVALID )
+		return NULL;
+
+	// Until its data has gone out, its ranges hold whatever was there before.
+	if ( ctx->uploads.retired < ctx->meshes.uploads[i] )
+		return NULL;
+
+	// Every mesh of the heap shares these, the state cache drops the calls between them.
+	R_GeometryHeap *heap = &ctx->geometryHeaps[ctx->meshes.heaps[i]];
+	r_set_vertex_buffer( ctx, heap->vertices, heap->stride, 0 );
+	r_set_index_buffer( ctx, heap->indices, DXGI_FORMAT_R32_UINT, 0 );
+	*outDense = i;
+	return heap;
+}
+
+void r_draw_mesh( R_Context *ctx, R_Mesh mesh )
+{
+	uint32_t i = 0;
+	if ( !r_bind_mesh( ctx, mesh, &i ) )
+		return;
+	r_draw_indexed(
+	    ctx, ctx->meshes.indexCounts[i], ctx->meshes.indices[i].offset, (INT)ctx->meshes.vertices[i].offset );
+}
+
+void r_draw_mesh_instanced( R_Context *ctx, R_Mesh mesh, UINT instanceCount, UINT startInstance )
+{
+	uint32_t i = 0;
+	if ( !r_bind_mesh( ctx, mesh, &i ) )
+		return;
+	r_draw_indexed_instanced( ctx,
+	                          ctx->meshes.indexCounts[i],
+	                          instanceCount,
+	                          ctx->meshes.indices[i].offset,
+	                          (INT)ctx->meshes.vertices[i].offset,
+	                          startInstance );
+}
+
+// Moves one range of a mesh to a lower offset if the allocator has a hole there for it. Returns
+// the bytes copied, 0 when the range stays where it is.
+static size_t r_move_mesh_range( R_Context          *ctx,
+                                 R_OffsetAllocator  *allocator,
+                                 R_Buffer            buffer,
+                                 UINT                unit,
+                                 R_OffsetAllocation *range,
+                                 uint32_t            count )
+{
+	R_OffsetAllocation moved = r_offset_alloc( allocator, count );
+	if ( moved.offset == R_OFFSET_ALLOC_NONE )
+		return 0;
+	if ( moved.offset >= range->offset )
+	{
+		r_offset_free( allocator, moved );
+		return 0;
+	}
+
+	// Both ranges are allocated at this point, so they can't overlap; the copy still goes through
+	// the scratch buffer since they're in the same buffer.
+	r_copy_buffer_region( ctx, buffer, moved.offset * unit, buffer, range->offset * unit, count * unit );
+	r_offset_free( allocator, *range );
+	*range = moved;
+	return (size_t)count * unit;
+}
+
+size_t r_defragment_geometry( R_Context *ctx, size_t maxBytes )
+{
+	if ( !ctx || ctx->meshes.pool.count == 0 || maxBytes == 0 )
+		return 0;
+	R_ASSERT_OWNER( ctx );
+
+	// A queued upload would land at the old offset after the copy, so they all go first.
+	if ( ctx->uploads.count )
+		r_finish_uploads( ctx );
+
+	R_MeshStore *meshes = &ctx->meshes;
+	size_t       moved  = 0;
+	uint32_t     n      = 0;
+	for ( ; n < meshes->pool.count && moved < maxBytes; ++n )
+	{
+		uint32_t        i    = ( ctx->defragCursor + n ) % meshes->pool.count;
+		R_GeometryHeap *heap = &ctx->geometryHeaps[meshes->heaps[i]];
+		moved += r_move_mesh_range(
+		    ctx, &heap->vertexAlloc, heap->vertices, heap->stride, &meshes->vertices[i], meshes->vertexCounts[i] );
+		moved += r_move_mesh_range( ctx,
+		                            &heap->indexAlloc,
+		                            heap->indices,
+		                            sizeof( uint32_t ),
+		                            &meshes->indices[i],
+		                            meshes->indexCounts[i] );
+	}
+	// The next call starts with the first mesh this one didn't get to.
+	ctx->defragCursor = ( ctx->defragCursor + n ) % meshes->pool.count;
+
+	ctx->defragBytesMoved += moved;
+	return moved;
+}
+
+void r_set_geometry_heap_size( R_Context *ctx, size_t vertexBytes, uint32_t indexCount )
+{
+	if ( !ctx || vertexBytes == 0 || vertexBytes > UINT32_MAX || indexCount == 0 ||
+	     indexCount > UINT32_MAX / sizeof( uint32_t ) )
+		return;
+	// Heaps that exist keep their size.
+	ctx->geometryHeapVertexBytes = vertexBytes;
+	ctx->geometryHeapIndices     = indexCount;
+}
+
+void r_get_geometry_stats( R_Context *ctx, R_GeometryStats *outStats )
+{
+	if ( !ctx || !outStats )
+		return;
+
+	memset( outStats, 0, sizeof( *outStats ) );
+	outStats->heaps      = ctx->geometryHeapCount;
+	outStats->meshes     = ctx->meshes.pool.count;
+	outStats->bytesMoved = ctx->defragBytesMoved;
+	for ( uint32_t i = 0; i < ctx->geometryHeapCount; ++i )
+	{
+		const R_GeometryHeap *heap = &ctx->geometryHeaps[i];
+		R_OffsetAllocStats    vertices, indices;
+		r_offset_alloc_get_stats( &heap->vertexAlloc, &vertices );
+		r_offset_alloc_get_stats( &heap->indexAlloc, &indices );
+
+		outStats->vertexBytes += (size_t)heap->vertexAlloc.size * heap->stride;
+		outStats->freeVertexBytes += (size_t)vertices.freeStorage * heap->stride;
+		outStats->indexBytes += (size_t)heap->indexAlloc.size * sizeof( uint32_t );
+		outStats->freeIndexBytes += (size_t)indices.freeStorage * sizeof( uint32_t );
+		outStats->freeRegions += vertices.freeRegions + indices.freeRegions;
+	}
+}
+
+static uint32_t r_format_bytes_per_pixel( DXGI_FORMAT format )
+{
+	switch ( format )
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+		return 16;
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+		return 12;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R8G8_UNORM:
+		return 2;
+	case DXGI_FORMAT_R8_UNORM:
+		return 1;
+	default:
+		return 4;
+	}
+}
+
+// Depth targets are created typeless so later passes can sample them through the matching colour format.
+static bool r_depth_formats( DXGI_FORMAT format, DXGI_FORMAT *outTexture, DXGI_FORMAT *outSrv )
+{
+	*outTexture = format;
+	*outSrv     = format;
+	switch ( format )
+	{
+	case DXGI_FORMAT_D32_FLOAT:
+		*outTexture = DXGI_FORMAT_R32_TYPELESS;
+		*outSrv     = DXGI_FORMAT_R32_FLOAT;
+		return true;
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+		*outTexture = DXGI_FORMAT_R24G8_TYPELESS;
+		*outSrv     = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+		return true;
+	case DXGI_FORMAT_D16_UNORM:
+		*outTexture = DXGI_FORMAT_R16_TYPELESS;
+		*outSrv     = DXGI_FORMAT_R16_UNORM;
+		return true;
+	default:
+		return false;
+	}
+}
+
+R_FgTextureDesc r_graph_texture_desc( UINT width, UINT height, DXGI_FORMAT format )
+{
+	DXGI_FORMAT textureFormat, srvFormat;
+
+	R_FgTextureDesc desc = { 0 };
+	desc.width           = width;
+	desc.height          = height;
+	desc.format          = (uint32_t)format;
+	desc.bytesPerPixel   = r_format_bytes_per_pixel( format );
+	desc.depth           = r_depth_formats( format, &textureFormat, &srvFormat );
+	return desc;
+}
+
+R_FgResource r_graph_import_backbuffer( R_Context *ctx, R_FrameGraph *graph, const float clearColor[4] )
+{
+	R_FgResource none = { 0 };
+	if ( !ctx || !graph )
+		return none;
+
+	R_FgTextureDesc desc = r_graph_texture_desc( ctx->width, ctx->height, DXGI_FORMAT_R8G8B8A8_UNORM );
+	if ( clearColor )
+	{
+		desc.clear = true;
+		memcpy( desc.clearColor, clearColor, sizeof( desc.clearColor ) );
+	}
+	return r_fg_import_texture( graph, "backbuffer", &desc, ctx->rtv );
+}
+
+static bool r_create_graph_texture( R_Context *ctx, const R_FgTextureDesc *desc, R_GraphTexture *out )
+{
+	DXGI_FORMAT textureFormat, srvFormat;
+	bool        depth = r_depth_formats( (DXGI_FORMAT)desc->format, &textureFormat, &srvFormat );
+
+	memset( out, 0, sizeof( *out ) );
+	out->desc = *desc;
+
+	D3D11_TEXTURE2D_DESC td = { 0 };
+	td.Width                = desc->width;
+	td.Height               = desc->height;
+	td.MipLevels            = 1;
+	td.ArraySize            = 1;
+	td.Format               = textureFormat;
+	td.SampleDesc.Count     = 1;
+	td.Usage                = D3D11_USAGE_DEFAULT;
+	td.BindFlags            = D3D11_BIND_SHADER_RESOURCE;
+	td.BindFlags |= depth ? D3D11_BIND_DEPTH_STENCIL : D3D11_BIND_RENDER_TARGET;
+
+	ID3D11Device *device = ctx->device;
+	HRESULT       hr     = device->lpVtbl->CreateTexture2D( device, &td, NULL, &out->texture );
+	if ( FAILED( hr ) )
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srv = { 0 };
+	srv.Format                          = srvFormat;
+	srv.ViewDimension                   = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srv.Texture2D.MipLevels             = 1;
+	hr = device->lpVtbl->CreateShaderResourceView( device, (ID3D11Resource *)out->texture, &srv, &out->srv );
+
+	if ( SUCCEEDED( hr ) && depth )
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsv = { 0 };
+		dsv.Format                        = (DXGI_FORMAT)desc->format;
+		dsv.ViewDimension                 = D3D11_DSV_DIMENSION_TEXTURE2D;
+		hr = device->lpVtbl->CreateDepthStencilView( device, (ID3D11Resource *)out->texture, &dsv, &out->dsv );
+	}
+	else if ( SUCCEEDED( hr ) )
+	{
+		hr = device->lpVtbl->CreateRenderTargetView( device, (ID3D11Resource *)out->texture, NULL, &out->rtv );
+	}
+
+	if ( FAILED( hr ) )
+	{
+		r_release_graph_texture( ctx, out );
+		return false;
+	}
+	return true;
+}
+
+static void r_unbind_graph_textures( R_Context *ctx )
+{
+	ID3D11ShaderResourceView *none = NULL;
+	for ( UINT slot = 0; ctx->graphSrvSlots; ++slot )
+	{
+		if ( !( ctx->graphSrvSlots & ( 1u << slot ) ) )
+			continue;
+		if ( r_state_cache_set_texture( &ctx->state, R_STAGE_PIXEL, (int)slot, none ) )
+			ctx->ctx->lpVtbl->PSSetShaderResources( ctx->ctx, slot, 1, &none );
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_TEXTURES, R_STAGE_PIXEL, 1u << slot );
+		ctx->graphSrvSlots &= ~( 1u << slot );
+	}
+}
+
+// Binds what the pass writes as its targets, clearing resources on their first write.
+static void r_begin_graph_pass( void *context, const R_FrameGraph *graph, uint32_t passIndex )
+{
+	R_Context      *ctx  = (R_Context *)context;
+	const R_FgPass *pass = &graph->passes[passIndex];
+
+	// Replays draw every pass into the back buffer, the marker keeps them apart in the timings.
+	if ( ctx->capturing && pass->name )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_MARKER, .data = pass->name, .size = (uint32_t)strlen( pass->name ) };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	// Whatever the last pass sampled may be a target now.
+	r_unbind_graph_textures( ctx );
+
+	ID3D11RenderTargetView *rtvs[R_FG_MAX_PASS_IO] = { 0 };
+	UINT                    rtvCount               = 0;
+	ID3D11DepthStencilView *dsv                    = NULL;
+	const R_FgTextureDesc  *extent                 = NULL;
+
+	for ( uint32_t w = 0; w < pass->writeCount; ++w )
+	{
+		const R_FgNode         *node     = &graph->nodes[pass->writes[w]];
+		const R_FgResourceInfo *resource = &graph->resources[node->resource];
+		bool                    clear    = resource->desc.clear && node->version == 1;
+
+		ID3D11RenderTargetView *rtv   = NULL;
+		ID3D11DepthStencilView *depth = NULL;
+		if ( resource->imported )
+		{
+			if ( resource->desc.depth )
+				depth = (ID3D11DepthStencilView *)resource->external;
+			else
+				rtv = (ID3D11RenderTargetView *)resource->external;
+		}
+		else
+		{
+			const R_GraphTexture *texture = &ctx->graphTextures[ctx->graphTextureOf[resource->physical]];
+			rtv                           = texture->rtv;
+			depth                         = texture->dsv;
+		}
+
+		if ( depth )
+		{
+			dsv = depth;
+			if ( clear )
+			{
+				UINT flags = D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL;
+				ctx->ctx->lpVtbl->ClearDepthStencilView( ctx->ctx, depth, flags, resource->desc.clearColor[0], 0 );
+			}
+		}
+		else if ( rtv )
+		{
+			rtvs[rtvCount++] = rtv;
+			if ( clear )
+				ctx->ctx->lpVtbl->ClearRenderTargetView( ctx->ctx, rtv, resource->desc.clearColor );
+		}
+		else
+		{
+			continue;
+		}
+
+		if ( !extent )
+			extent = &resource->desc;
+	}
+
+	ctx->ctx->lpVtbl->OMSetRenderTargets( ctx->ctx, rtvCount, rtvs, dsv );
+	if ( extent )
+		r_set_viewport( ctx, 0.0f, 0.0f, (float)extent->width, (float)extent->height );
+}
+
+bool r_execute_frame_graph( R_Context *ctx, R_FrameGraph *graph )
+{
+	if ( !ctx || !graph || ctx->graph )
+		return false;
+	R_ASSERT_OWNER( ctx );
+	if ( !graph->compiled && !r_fg_compile( graph ) )
+		return false;
+
+	ctx->graphExecutions++;
+
+	// Textures no graph asked for in a while go first, so their slots can be taken below.
+	for ( uint32_t i = 0; i < ctx->graphTextureCount; )
+	{
+		R_GraphTexture *texture = &ctx->graphTextures[i];
+		if ( texture->lastUse + R_GRAPH_TEXTURE_KEEP >= ctx->graphExecutions )
+		{
+			++i;
+			continue;
+		}
+		r_release_graph_texture( ctx, texture );
+		*texture = ctx->graphTextures[--ctx->graphTextureCount];
+	}
+
+	uint64_t claimed = 0;
+	for ( uint32_t slot = 0; slot < graph->physicalCount; ++slot )
+	{
+		const R_FgTextureDesc *desc  = &graph->physicalDescs[slot];
+		uint32_t               found = R_FG_EXTERNAL;
+		for ( uint32_t i = 0; i < ctx->graphTextureCount && found == R_FG_EXTERNAL; ++i )
+			if ( !( claimed & ( 1ull << i ) ) && r_fg_descs_compatible( &ctx->graphTextures[i].desc, desc ) )
+				found = i;
+
+		if ( found == R_FG_EXTERNAL )
+		{
+			if ( ctx->graphTextureCount == R_MAX_GRAPH_TEXTURES ||
+			     !r_create_graph_texture( ctx, desc, &ctx->graphTextures[ctx->graphTextureCount] ) )
+				return false;
+			found = ctx->graphTextureCount++;
+		}
+
+		claimed |= 1ull << found;
+		ctx->graphTextures[found].lastUse = ctx->graphExecutions;
+		ctx->graphTextureOf[slot]         = found;
+	}
+
+	D3D11_VIEWPORT viewport = ctx->vp;
+
+	ctx->graph = graph;
+	r_fg_execute( graph, r_begin_graph_pass, ctx );
+	r_unbind_graph_textures( ctx );
+	ctx->graph = NULL;
+
+	ctx->ctx->lpVtbl->OMSetRenderTargets( ctx->ctx, 1, &ctx->rtv, NULL );
+	r_set_viewport( ctx, viewport.TopLeftX, viewport.TopLeftY, viewport.Width, viewport.Height );
+	return true;
+}
+
+bool r_bind_graph_texture( R_Context *ctx, R_FgResource resource, UINT slot )
+{
+	if ( !ctx || !ctx->graph || slot >= R_GRAPH_SRV_SLOTS )
+		return false;
+
+	uint32_t index = r_fg_resource_index( ctx->graph, resource );
+	if ( index == R_FG_EXTERNAL )
+		return false;
+
+	const R_FgResourceInfo *info = &ctx->graph->resources[index];
+	if ( info->imported || info->physical == R_FG_EXTERNAL )
+		return false;
+
+	ID3D11ShaderResourceView *srv = ctx->graphTextures[ctx->graphTextureOf[info->physical]].srv;
+	if ( r_state_cache_set_texture( &ctx->state, R_STAGE_PIXEL, (int)slot, srv ) )
+		ctx->ctx->lpVtbl->PSSetShaderResources( ctx->ctx, slot, 1, &srv );
+	r_bound_groups_forget( &ctx->boundGroups, R_BIND_TEXTURES, R_STAGE_PIXEL, 1u << slot );
+	ctx->graphSrvSlots |= 1u << slot;
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_TEXTURE, .args = { slot, srv != NULL } };
+		r_capture_write( &ctx->capture, &call );
+	}
+	return true;
+}
+
+static R_ShaderSource r_shader_source( const char *src, const char *entry, const char *profile )
+{
+	R_ShaderSource source = { src, strlen( src ), entry, profile, NULL, R_SHADER_COMPILE_FLAGS, D3D_COMPILER_VERSION };
+	return source;
+}
+
+// Also runs on the async workers, D3DCompile is safe to call from any thread.
+static ID3DBlob *compile_hlsl( const R_ShaderSource *source )
+{
+	ID3DBlob *blob = NULL;
+	ID3DBlob *err  = NULL;
+	HRESULT   hr   = D3DCompile( source->source,
+                             source->sourceSize,
+                             NULL,
+                             (const D3D_SHADER_MACRO *)source->defines,
+                             NULL,
+                             source->entry,
+                             source->profile,
+                             source->flags,
+                             0,
+                             &blob,
+                             &err );
+	if ( FAILED( hr ) )
+	{
+		if ( err )
+		{
+			OutputDebugStringA( (const char *)err->lpVtbl->GetBufferPointer( err ) );
+			err->lpVtbl->Release( err );
+		}
+		safe_release( (IUnknown **)&blob );
+		return NULL;
+	}
+	safe_release( (IUnknown **)&err );
+	return blob;
+}
+
+bool r_open_shader_cache( R_Context *ctx, const char *path )
+{
+	if ( !ctx || !path )
+		return false;
+
+	r_shader_cache_close( &ctx->shaderCache );
+	return r_shader_cache_open( &ctx->shaderCache, path );
+}
+
+// Bytecode for the source, straight from the cache mapping on a hit. On a miss the shader is
+// compiled and stored, and *outBlob must be released once the shader object has been created.
+static const void *r_get_shader_bytecode( R_Context  *ctx,
+                                          const char *src,
+                                          const char *entry,
+                                          const char *profile,
+                                          size_t     *outSize,
+                                          ID3DBlob  **outBlob )
+{
+	R_ShaderSource source = r_shader_source( src, entry, profile );
+	uint64_t       key    = r_shader_cache_key( &source );
+
+	*outBlob = NULL;
+
+	const void *bytecode = NULL;
+	if ( r_shader_cache_find( &ctx->shaderCache, key, &bytecode, outSize ) )
+		return bytecode;
+
+	ID3DBlob *blob = compile_hlsl( &source );
+	if ( !blob )
+		return NULL;
+
+	bytecode = blob->lpVtbl->GetBufferPointer( blob );
+	*outSize = blob->lpVtbl->GetBufferSize( blob );
+	r_shader_cache_insert( &ctx->shaderCache, key, bytecode, *outSize );
+
+	*outBlob = blob;
+	return bytecode;
+}
+
+static bool r_retain_signature( R_Context *ctx, uint64_t hash, const void *bytecode, size_t bytecodeSize )
+{
+	R_SignatureStore *store = &ctx->signatures;
+
+	uint32_t i;
+	if ( r_hash_map_get( &store->lookup, hash, &i ) )
+	{
+		store->refCounts[i]++;
+		return true;
+	}
+
+	ID3DBlob *blob = NULL;
+	if ( store->count == R_MAX_SHADERS || FAILED( D3DGetInputSignatureBlob( bytecode, bytecodeSize, &blob ) ) )
+		return false;
+
+	i                   = store->count++;
+	store->blobs[i]     = blob;
+	store->hashes[i]    = hash;
+	store->refCounts[i] = 1;
+	r_hash_map_put( &store->lookup, hash, i );
+	return true;
+}
+
+static void r_release_signature( R_Context *ctx, uint64_t hash )
+{
+	R_SignatureStore *store = &ctx->signatures;
+
+	uint32_t i;
+	if ( !r_hash_map_get( &store->lookup, hash, &i ) || --store->refCounts[i] > 0 )
+		return;
+
+	safe_release( (IUnknown **)&store->blobs[i] );
+	r_hash_map_remove( &store->lookup, hash );
+
+	uint32_t last = --store->count;
+	if ( i != last )
+	{
+		store->blobs[i]     = store->blobs[last];
+		store->hashes[i]    = store->hashes[last];
+		store->refCounts[i] = store->refCounts[last];
+		store->blobs[last]  = NULL;
+		r_hash_map_put( &store->lookup, store->hashes[i], i );
+	}
+}
+
+// Shared by the synchronous path and r_poll_shader_jobs, which fills a slot allocated at submit time.
+static bool r_build_vertex_shader( R_Context           *ctx,
+                                   const void          *bytecode,
+                                   size_t               bytecodeSize,
+                                   ID3D11VertexShader **outShader,
+                                   uint64_t            *outSignatureHash )
+{
+	// Input layouts only care about the signature, that's all that is kept of the bytecode for them.
+	uint64_t signatureHash = 0;
+	if ( !r_dxbc_input_signature_hash( bytecode, bytecodeSize, &signatureHash ) )
+		return false;
+
+	ID3D11VertexShader *vs = NULL;
+	if ( ctx->warm.lookup[R_WARM_VERTEX_SHADER].count )
+	{
+		uint64_t hash = r_hash_bytes( bytecode, bytecodeSize, R_HASH_SEED );
+		vs = (ID3D11VertexShader *)r_take_warm_object( ctx, R_WARM_VERTEX_SHADER, hash, bytecode, bytecodeSize );
+	}
+	if ( !vs && FAILED( ctx->device->lpVtbl->CreateVertexShader( ctx->device, bytecode, bytecodeSize, NULL, &vs ) ) )
+		return false;
+
+	if ( !r_retain_signature( ctx, signatureHash, bytecode, bytecodeSize ) )
+	{
+		safe_release( (IUnknown **)&vs );
+		return false;
+	}
+
+	*outShader        = vs;
+	*outSignatureHash = signatureHash;
+	return true;
+}
+
+static bool
+r_build_pixel_shader( R_Context *ctx, const void *bytecode, size_t bytecodeSize, ID3D11PixelShader **outShader )
+{
+	if ( ctx->warm.lookup[R_WARM_PIXEL_SHADER].count )
+	{
+		uint64_t hash = r_hash_bytes( bytecode, bytecodeSize, R_HASH_SEED );
+		*outShader    = (ID3D11PixelShader *)r_take_warm_object(
+		    ctx, R_WARM_PIXEL_SHADER, hash, bytecode, bytecodeSize );
+		if ( *outShader )
+			return true;
+	}
+	return SUCCEEDED( ctx->device->lpVtbl->CreatePixelShader( ctx->device, bytecode, bytecodeSize, NULL, outShader ) );
+}
+
+R_VertexShader
+r_create_vertex_shader_from_bytecode( R_Context *ctx, const void *bytecode, size_t bytecodeSize, R_Result *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	R_VertexShader handle = { 0 };
+	if ( !ctx || !bytecode || bytecodeSize == 0 )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	ID3D11VertexShader *vs            = NULL;
+	uint64_t            signatureHash = 0;
+	if ( !r_build_vertex_shader( ctx, bytecode, bytecodeSize, &vs, &signatureHash ) )
+	{
+		*outResult = R_ERROR_SHADER_CREATION_FAILED;
+		return handle;
+	}
+
+	uint32_t dense = 0;
+	handle.id      = r_pool_alloc( &ctx->vertexShaders.pool, &dense );
+	if ( !handle.id )
+	{
+		r_release_signature( ctx, signatureHash );
+		safe_release( (IUnknown **)&vs );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return handle;
+	}
+
+	ctx->vertexShaders.shaders[dense]         = vs;
+	ctx->vertexShaders.signatureHashes[dense] = signatureHash;
+	ctx->vertexShaders.jobs[dense]            = 0;
+	ctx->vertexShaders.bytecode[dense]        = r_copy_bytecode( ctx, bytecode, bytecodeSize );
+	*outResult                                = R_OK;
+
+	if ( ctx->capturing )
+		r_capture_shader( ctx, R_CAPTURE_CREATE_VERTEX_SHADER, handle.id, &ctx->vertexShaders.bytecode[dense] );
+	return handle;
+}
+
+R_PixelShader
+r_create_pixel_shader_from_bytecode( R_Context *ctx, const void *bytecode, size_t bytecodeSize, R_Result *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	R_PixelShader handle = { 0 };
+	if ( !ctx || !bytecode || bytecodeSize == 0 )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	ID3D11PixelShader *ps = NULL;
+	if ( !r_build_pixel_shader( ctx, bytecode, bytecodeSize, &ps ) )
+	{
+		*outResult = R_ERROR_SHADER_CREATION_FAILED;
+		return handle;
+	}
+
+	uint32_t dense = 0;
+	handle.id      = r_pool_alloc( &ctx->pixelShaders.pool, &dense );
+	if ( !handle.id )
+	{
+		safe_release( (IUnknown **)&ps );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return handle;
+	}
+
+	ctx->pixelShaders.shaders[dense]  = ps;
+	ctx->pixelShaders.jobs[dense]     = 0;
+	ctx->pixelShaders.bytecode[dense] = r_copy_bytecode( ctx, bytecode, bytecodeSize );
+	*outResult                        = R_OK;
+
+	if ( ctx->capturing )
+		r_capture_shader( ctx, R_CAPTURE_CREATE_PIXEL_SHADER, handle.id, &ctx->pixelShaders.bytecode[dense] );
+	return handle;
+}
+
+R_VertexShader r_create_vertex_shader_from_source( R_Context  *ctx,
+                                                   const char *src,
+                                                   const char *entry,
+                                                   const char *profile,
+                                                   R_Result   *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	if ( !ctx || !src )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return ( R_VertexShader ){ 0 };
+	}
+
+	ID3DBlob   *blob           = NULL;
+	size_t      byteCodeLength = 0;
+	const void *bytecode       = r_get_shader_bytecode( ctx, src, entry, profile, &byteCodeLength, &blob );
+	if ( !bytecode )
+	{
+		*outResult = R_ERROR_SHADER_COMPILATION_FAILED;
+		return ( R_VertexShader ){ 0 };
+	}
+
+	R_VertexShader shader = r_create_vertex_shader_from_bytecode( ctx, bytecode, byteCodeLength, outResult );
+	safe_release( (IUnknown **)&blob );
+
+	return shader;
+}
+
+R_PixelShader r_create_pixel_shader_from_source( R_Context  *ctx,
+                                                 const char *src,
+                                                 const char *entry,
+                                                 const char *profile,
+                                                 R_Result   *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	if ( !ctx || !src )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return ( R_PixelShader ){ 0 };
+	}
+
+	ID3DBlob   *blob           = NULL;
+	size_t      byteCodeLength = 0;
+	const void *bytecode       = r_get_shader_bytecode( ctx, src, entry, profile, &byteCodeLength, &blob );
+	if ( !bytecode )
+	{
+		*outResult = R_ERROR_SHADER_COMPILATION_FAILED;
+		return ( R_PixelShader ){ 0 };
+	}
+
+	R_PixelShader shader = r_create_pixel_shader_from_bytecode( ctx, bytecode, byteCodeLength, outResult );
+	safe_release( (IUnknown **)&blob );
+
+	return shader;
+}
+
+// Worker side of r_compile_shader_async. The bytecode leaves the blob so the queue can own it with plain malloc/free.
+static bool r_compile_shader_job( void *user, const R_ShaderSource *source, void **outBytecode, size_t *outSize )
+{
+	(void)user;
+
+	ID3DBlob *blob = compile_hlsl( source );
+	if ( !blob )
+		return false;
+
+	size_t size     = blob->lpVtbl->GetBufferSize( blob );
+	void  *bytecode = malloc( size );
+	if ( bytecode )
+		memcpy( bytecode, blob->lpVtbl->GetBufferPointer( blob ), size );
+	safe_release( (IUnknown **)&blob );
+
+	*outBytecode = bytecode;
+	*outSize     = size;
+	return bytecode != NULL;
+}
+
+static bool r_start_shader_jobs( R_Context *ctx )
+{
+	if ( ctx->shaderJobs.compile )
+		return true;
+
+	// Leave a core to the main thread, it's the one waiting on the results.
+	int workers = sys_cpu_count() - 1;
+	if ( workers < 1 )
+		workers = 1;
+	return r_shader_jobs_init( &ctx->shaderJobs, workers, r_compile_shader_job, NULL );
+}
+
+static void r_discard_shader_job( R_Context *ctx, uint32_t job )
+{
+	if ( !job )
+		return;
+	r_shader_jobs_discard( &ctx->shaderJobs, job );
+	ctx->pendingShaders--;
+}
+
+R_ShaderFuture r_compile_shader_async( R_Context    *ctx,
+                                       R_ShaderStage stage,
+                                       const char   *src,
+                                       const char   *entry,
+                                       const char   *profile,
+                                       R_Result     *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	R_ShaderFuture future = { stage, 0 };
+	if ( !ctx || !src || !entry || !profile || ( stage != R_STAGE_VERTEX && stage != R_STAGE_PIXEL ) )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return future;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	R_ShaderSource source = r_shader_source( src, entry, profile );
+	uint64_t       key    = r_shader_cache_key( &source );
+
+	// Cached bytecode only costs the shader object, and a full queue shouldn't fail the request:
+	// both take the synchronous path and hand back a future that is already resolved.
+	const void *cached     = NULL;
+	size_t      cachedSize = 0;
+	uint32_t    job        = 0;
+	if ( !r_shader_cache_find( &ctx->shaderCache, key, &cached, &cachedSize ) && r_start_shader_jobs( ctx ) )
+		job = r_shader_jobs_submit( &ctx->shaderJobs, &source, key );
+
+	if ( !job )
+	{
+		if ( stage == R_STAGE_VERTEX )
+			future.id = r_create_vertex_shader_from_source( ctx, src, entry, profile, outResult ).id;
+		else
+			future.id = r_create_pixel_shader_from_source( ctx, src, entry, profile, outResult ).id;
+		return future;
+	}
+
+	uint32_t dense = 0;
+	if ( stage == R_STAGE_VERTEX )
+	{
+		future.id = r_pool_alloc( &ctx->vertexShaders.pool, &dense );
+		if ( future.id )
+		{
+			ctx->vertexShaders.shaders[dense]         = NULL;
+			ctx->vertexShaders.signatureHashes[dense] = 0;
+			ctx->vertexShaders.jobs[dense]            = job;
+			ctx->vertexShaders.bytecode[dense]        = ( R_ShaderBytecode ){ 0 };
+		}
+	}
+	else
+	{
+		future.id = r_pool_alloc( &ctx->pixelShaders.pool, &dense );
+		if ( future.id )
+		{
+			ctx->pixelShaders.shaders[dense]  = NULL;
+			ctx->pixelShaders.jobs[dense]     = job;
+			ctx->pixelShaders.bytecode[dense] = ( R_ShaderBytecode ){ 0 };
+		}
+	}
+
+	if ( !future.id )
+	{
+		r_shader_jobs_discard( &ctx->shaderJobs, job );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return future;
+	}
+
+	ctx->pendingShaders++;
+	*outResult = R_OK;
+	return future;
+}
+
+R_ShaderStatus r_shader_future_status( R_Context *ctx, R_ShaderFuture future )
+{
+	if ( !ctx )
+		return R_SHADER_FAILED;
+
+	r_poll_shader_jobs( ctx );
+
+	uint32_t i;
+	if ( future.stage == R_STAGE_VERTEX && r_pool_is_valid( &ctx->vertexShaders.pool, future.id ) )
+	{
+		i = r_pool_lookup( &ctx->vertexShaders.pool, future.id );
+		if ( ctx->vertexShaders.jobs[i] )
+			return R_SHADER_PENDING;
+		return ctx->vertexShaders.shaders[i] ? R_SHADER_READY : R_SHADER_FAILED;
+	}
+	if ( future.stage == R_STAGE_PIXEL && r_pool_is_valid( &ctx->pixelShaders.pool, future.id ) )
+	{
+		i = r_pool_lookup( &ctx->pixelShaders.pool, future.id );
+		if ( ctx->pixelShaders.jobs[i] )
+			return R_SHADER_PENDING;
+		return ctx->pixelShaders.shaders[i] ? R_SHADER_READY : R_SHADER_FAILED;
+	}
+	return R_SHADER_FAILED;
+}
+
+R_VertexShader r_shader_future_vertex( R_ShaderFuture future )
+{
+	R_VertexShader shader = { future.stage == R_STAGE_VERTEX ? future.id : 0 };
+	return shader;
+}
+
+R_PixelShader r_shader_future_pixel( R_ShaderFuture future )
+{
+	R_PixelShader shader = { future.stage == R_STAGE_PIXEL ? future.id : 0 };
+	return shader;
+}
+
+const void *r_vertex_shader_get_input_signature( R_Context *ctx, R_VertexShader shader, size_t *outSize )
+{
+	if ( !ctx )
+		return NULL;
+
+	uint32_t i = r_pool_lookup( &ctx->vertexShaders.pool, shader.id );
+	uint32_t s;
+	if ( i == R_POOL_INVALID || !r_hash_map_get( &ctx->signatures.lookup, ctx->vertexShaders.signatureHashes[i], &s ) )
+		return NULL;
+
+	ID3DBlob *blob = ctx->signatures.blobs[s];
+	if ( outSize )
+		*outSize = blob->lpVtbl->GetBufferSize( blob );
+	return blob->lpVtbl->GetBufferPointer( blob );
+}
+
+void r_destroy_vertex_shader( R_Context *ctx, R_VertexShader sh )
+{
+	uint32_t dense, moved;
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+	if ( !r_pool_release( &ctx->vertexShaders.pool, sh.id, &dense, &moved ) )
+		return;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DESTROY_VERTEX_SHADER, .id = sh.id };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	R_VertexShaderStore *store = &ctx->vertexShaders;
+	if ( store->shaders[dense] )
+		r_release_signature( ctx, store->signatureHashes[dense] );
+	r_defer_release_object( ctx, (IUnknown **)&store->shaders[dense] );
+	r_discard_shader_job( ctx, store->jobs[dense] );
+	free( store->bytecode[dense].data );
+
+	store->shaders[dense]         = store->shaders[moved];
+	store->signatureHashes[dense] = store->signatureHashes[moved];
+	store->jobs[dense]            = store->jobs[moved];
+	store->bytecode[dense]        = store->bytecode[moved];
+	store->shaders[moved]         = NULL;
+	store->jobs[moved]            = 0;
+	store->bytecode[moved]        = ( R_ShaderBytecode ){ 0 };
+}
+
+void r_destroy_pixel_shader( R_Context *ctx, R_PixelShader sh )
+{
+	uint32_t dense, moved;
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+	if ( !r_pool_release( &ctx->pixelShaders.pool, sh.id, &dense, &moved ) )
+		return;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DESTROY_PIXEL_SHADER, .id = sh.id };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	R_PixelShaderStore *store = &ctx->pixelShaders;
+	r_defer_release_object( ctx, (IUnknown **)&store->shaders[dense] );
+	r_discard_shader_job( ctx, store->jobs[dense] );
+	free( store->bytecode[dense].data );
+
+	store->shaders[dense]  = store->shaders[moved];
+	store->jobs[dense]     = store->jobs[moved];
+	store->bytecode[dense] = store->bytecode[moved];
+	store->shaders[moved]  = NULL;
+	store->jobs[moved]     = 0;
+	store->bytecode[moved] = ( R_ShaderBytecode ){ 0 };
+}
+
+static uint64_t r_hash_input_elements( const D3D11_INPUT_ELEMENT_DESC *desc, UINT numDesc, uint64_t signatureHash )
+{
+	uint64_t hash = r_hash_bytes( &signatureHash, sizeof( signatureHash ), R_HASH_SEED );
+	hash          = r_hash_bytes( &numDesc, sizeof( numDesc ), hash );
+	for ( UINT i = 0; i < numDesc; ++i )
+	{
+		const D3D11_INPUT_ELEMENT_DESC *e = &desc[i];
+
+		hash = r_hash_string( e->SemanticName, hash );
+		hash = r_hash_bytes( &e->SemanticIndex, sizeof( e->SemanticIndex ), hash );
+		hash = r_hash_bytes( &e->Format, sizeof( e->Format ), hash );
+		hash = r_hash_bytes( &e->InputSlot, sizeof( e->InputSlot ), hash );
+		hash = r_hash_bytes( &e->AlignedByteOffset, sizeof( e->AlignedByteOffset ), hash );
+		hash = r_hash_bytes( &e->InputSlotClass, sizeof( e->InputSlotClass ), hash );
+		hash = r_hash_bytes( &e->InstanceDataStepRate, sizeof( e->InstanceDataStepRate ), hash );
+	}
+	return hash;
+}
+
+// hash is r_hash_input_elements of the layout, what precached layouts are found by.
+static HRESULT r_create_d3d_input_layout( R_Context                      *ctx,
+                                          const D3D11_INPUT_ELEMENT_DESC *desc,
+                                          UINT                            numDesc,
+                                          uint32_t                        vsIndex,
+                                          uint64_t                        hash,
+                                          ID3D11InputLayout             **outLayout )
+{
+	if ( ctx->manifestPath )
+		r_record_input_layout( ctx, vsIndex, desc, numDesc );
+
+	*outLayout = (ID3D11InputLayout *)r_take_warm_object( ctx, R_WARM_INPUT_LAYOUT, hash, desc, numDesc );
+	if ( *outLayout )
+		return S_OK;
+
+	R_VertexShader vs            = { r_pool_handle_at( &ctx->vertexShaders.pool, vsIndex ) };
+	size_t         signatureSize = 0;
+	const void    *signature     = r_vertex_shader_get_input_signature( ctx, vs, &signatureSize );
+	if ( !signature )
+		return E_FAIL;
+	return ctx->device->lpVtbl->CreateInputLayout( ctx->device, desc, numDesc, signature, signatureSize, outLayout );
+}
+
+// One allocation for the element array and the semantic names it points to.
+static D3D11_INPUT_ELEMENT_DESC *r_copy_input_elements( const D3D11_INPUT_ELEMENT_DESC *desc, UINT numDesc )
+{
+	size_t size = numDesc * sizeof( D3D11_INPUT_ELEMENT_DESC );
+	for ( UINT i = 0; i < numDesc; ++i )
+		size += strlen( desc[i].SemanticName ) + 1;
+
+	D3D11_INPUT_ELEMENT_DESC *copy = (D3D11_INPUT_ELEMENT_DESC *)malloc( size );
+	if ( !copy )
+		return NULL;
+
+	char *names = (char *)( copy + numDesc );
+	for ( UINT i = 0; i < numDesc; ++i )
+	{
+		copy[i]              = desc[i];
+		copy[i].SemanticName = strcpy( names, desc[i].SemanticName );
+		names += strlen( names ) + 1;
+	}
+	return copy;
+}
+
+R_InputLayout r_create_input_layout( R_Context                      *ctx,
+                                     const D3D11_INPUT_ELEMENT_DESC *desc,
+                                     UINT                            numDesc,
+                                     R_VertexShader                  vs,
+                                     R_Result                       *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	R_InputLayout handle = { 0 };
+	if ( !ctx || !desc )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	uint32_t vsIndex = r_pool_lookup( &ctx->vertexShaders.pool, vs.id );
+	if ( vsIndex == R_POOL_INVALID )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+
+	R_InputLayoutStore *store = &ctx->inputLayouts;
+
+	// The signature isn't known until the shader compiled, so the layout is built by r_poll_shader_jobs.
+	// It's not shared with other layouts in the meantime, only once it's real.
+	if ( ctx->vertexShaders.jobs[vsIndex] )
+	{
+		D3D11_INPUT_ELEMENT_DESC *elements = r_copy_input_elements( desc, numDesc );
+		uint32_t                  dense    = 0;
+		handle.id                          = elements ? r_pool_alloc( &store->pool, &dense ) : 0;
+		if ( !handle.id )
+		{
+			free( elements );
+			*outResult = R_ERROR_OUT_OF_MEMORY;
+			return handle;
+		}
+
+		store->layouts[dense]               = NULL;
+		store->refCounts[dense]             = 1;
+		store->hashes[dense]                = 0;
+		store->pending[dense].elements      = elements;
+		store->pending[dense].count         = numDesc;
+		store->pending[dense].vs            = vs;
+		store->sources[dense].elements      = elements;
+		store->sources[dense].count         = numDesc;
+		store->sources[dense].signatureHash = 0;
+
+		*outResult = R_OK;
+		if ( ctx->capturing )
+			r_capture_input_layout( ctx, handle.id, vs, desc, numDesc );
+		return handle;
+	}
+
+	// An async compile that failed leaves a shader without a signature.
+	if ( !ctx->vertexShaders.shaders[vsIndex] )
+	{
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+
+	// Layouts are shared between every shader with the same input signature. The key is
+	// hash-only; at a few hundred layouts a 64-bit collision isn't a practical concern.
+	uint64_t hash = r_hash_input_elements( desc, numDesc, ctx->vertexShaders.signatureHashes[vsIndex] );
+
+	uint32_t cachedId = 0;
+	if ( r_hash_map_get( &store->lookup, hash, &cachedId ) )
+	{
+		uint32_t i = r_pool_lookup( &store->pool, cachedId );
+		store->refCounts[i]++;
+		handle.id  = cachedId;
+		*outResult = R_OK;
+		if ( ctx->capturing )
+			r_capture_input_layout( ctx, handle.id, vs, desc, numDesc );
+		return handle;
+	}
+
+	ID3D11InputLayout *layout = NULL;
+	HRESULT            hr     = r_create_d3d_input_layout( ctx, desc, numDesc, vsIndex, hash, &layout );
+	if ( FAILED( hr ) )
+	{
+		*outResult = R_ERROR_INPUT_LAYOUT_FAILED;
+		return handle;
+	}
+
+	uint32_t dense = 0;
+	handle.id      = r_pool_alloc( &store->pool, &dense );
+	if ( !handle.id )
+	{
+		safe_release( (IUnknown **)&layout );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return handle;
+	}
+
+	// Only captures and manifests read the sources, a layout without its elements is left out of them.
+	store->layouts[dense]               = layout;
+	store->refCounts[dense]             = 1;
+	store->hashes[dense]                = hash;
+	store->pending[dense].elements      = NULL;
+	store->sources[dense].elements      = r_wants_sources( ctx ) ? r_copy_input_elements( desc, numDesc ) : NULL;
+	store->sources[dense].count         = numDesc;
+	store->sources[dense].signatureHash = ctx->vertexShaders.signatureHashes[vsIndex];
+	r_hash_map_put( &store->lookup, hash, handle.id );
+
+	*outResult = R_OK;
+	if ( ctx->capturing )
+		r_capture_input_layout( ctx, handle.id, vs, desc, numDesc );
+	return handle;
+}
+
+static void r_retain_input_layout( R_Context *ctx, R_InputLayout layout )
+{
+	uint32_t i = r_pool_lookup( &ctx->inputLayouts.pool, layout.id );
+	if ( i != R_POOL_INVALID )
+		ctx->inputLayouts.refCounts[i]++;
+}
+
+void r_destroy_input_layout( R_Context *ctx, R_InputLayout layout )
+{
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+
+	uint32_t i = r_pool_lookup( &ctx->inputLayouts.pool, layout.id );
+	if ( i == R_POOL_INVALID )
+		return;
+
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DESTROY_INPUT_LAYOUT, .id = layout.id };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	ctx->inputLayouts.refCounts[i]--;
+	if ( ctx->inputLayouts.refCounts[i] == 0 )
+	{
+		// Layouts resolved after a compile may lose the lookup slot to an identical one created earlier.
+		R_InputLayoutStore *store    = &ctx->inputLayouts;
+		uint32_t            cachedId = 0;
+		if ( r_hash_map_get( &store->lookup, store->hashes[i], &cachedId ) && cachedId == layout.id )
+			r_hash_map_remove( &store->lookup, store->hashes[i] );
+
+		uint32_t dense, moved;
+		r_pool_release( &store->pool, layout.id, &dense, &moved );
+
+		r_defer_release_object( ctx, (IUnknown **)&store->layouts[dense] );
+		free( store->sources[dense].elements );
+		store->layouts[dense]          = store->layouts[moved];
+		store->refCounts[dense]        = store->refCounts[moved];
+		store->hashes[dense]           = store->hashes[moved];
+		store->pending[dense]          = store->pending[moved];
+		store->sources[dense]          = store->sources[moved];
+		store->layouts[moved]          = NULL;
+		store->pending[moved].elements = NULL;
+		store->sources[moved].elements = NULL;
+	}
+}
+
+void r_pipeline_desc_init( R_PipelineDesc *desc, R_VertexShader vs, R_PixelShader ps, R_InputLayout layout )
+{
+	if ( !desc )
+		return;
+
+	ZeroMemory( desc, sizeof( *desc ) );
+	desc->vs     = vs;
+	desc->ps     = ps;
+	desc->layout = layout;
+
+	desc->rasterizer.FillMode        = D3D11_FILL_SOLID;
+	desc->rasterizer.CullMode        = D3D11_CULL_BACK;
+	desc->rasterizer.DepthClipEnable = TRUE;
+
+	for ( int i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i )
+	{
+		D3D11_RENDER_TARGET_BLEND_DESC *rt = &desc->blend.RenderTarget[i];
+		rt->SrcBlend                       = D3D11_BLEND_ONE;
+		rt->DestBlend                      = D3D11_BLEND_ZERO;
+		rt->BlendOp                        = D3D11_BLEND_OP_ADD;
+		rt->SrcBlendAlpha                  = D3D11_BLEND_ONE;
+		rt->DestBlendAlpha                 = D3D11_BLEND_ZERO;
+		rt->BlendOpAlpha                   = D3D11_BLEND_OP_ADD;
+		rt->RenderTargetWriteMask          = D3D11_COLOR_WRITE_ENABLE_ALL;
+	}
+	desc->blendFactor[0] = desc->blendFactor[1] = desc->blendFactor[2] = desc->blendFactor[3] = 1.0f;
+	desc->sampleMask     = 0xffffffff;
+
+	D3D11_DEPTH_STENCILOP_DESC stencilOp = { D3D11_STENCIL_OP_KEEP,
+	                                         D3D11_STENCIL_OP_KEEP,
+	                                         D3D11_STENCIL_OP_KEEP,
+	                                         D3D11_COMPARISON_ALWAYS };
+	desc->depthStencil.DepthEnable      = TRUE;
+	desc->depthStencil.DepthWriteMask   = D3D11_DEPTH_WRITE_MASK_ALL;
+	desc->depthStencil.DepthFunc        = D3D11_COMPARISON_LESS;
+	desc->depthStencil.StencilReadMask  = D3D11_DEFAULT_STENCIL_READ_MASK;
+	desc->depthStencil.StencilWriteMask = D3D11_DEFAULT_STENCIL_WRITE_MASK;
+	desc->depthStencil.FrontFace        = stencilOp;
+	desc->depthStencil.BackFace         = stencilOp;
+}
+
+// Hashing and memcmp look at raw bytes, so the padding inside the D3D descs has to be
+// zeroed and fields the runtime ignores must not make two equivalent descriptors differ.
+static void r_canonicalize_pipeline_desc( R_PipelineDesc *out, const R_PipelineDesc *in )
+{
+	memset( out, 0, sizeof( *out ) );
+	out->vs         = in->vs;
+	out->ps         = in->ps;
+	out->layout     = in->layout;
+	out->rasterizer = in->rasterizer;
+
+	out->blend.AlphaToCoverageEnable  = in->blend.AlphaToCoverageEnable;
+	out->blend.IndependentBlendEnable = in->blend.IndependentBlendEnable;
+
+	int targets = in->blend.IndependentBlendEnable ? D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT : 1;
+	for ( int i = 0; i < targets; ++i )
+	{
+		const D3D11_RENDER_TARGET_BLEND_DESC *src = &in->blend.RenderTarget[i];
+		D3D11_RENDER_TARGET_BLEND_DESC       *dst = &out->blend.RenderTarget[i];
+
+		dst->BlendEnable           = src->BlendEnable;
+		dst->SrcBlend              = src->SrcBlend;
+		dst->DestBlend             = src->DestBlend;
+		dst->BlendOp               = src->BlendOp;
+		dst->SrcBlendAlpha         = src->SrcBlendAlpha;
+		dst->DestBlendAlpha        = src->DestBlendAlpha;
+		dst->BlendOpAlpha          = src->BlendOpAlpha;
+		dst->RenderTargetWriteMask = src->RenderTargetWriteMask;
+	}
+	memcpy( out->blendFactor, in->blendFactor, sizeof( out->blendFactor ) );
+	out->sampleMask = in->sampleMask;
+
+	out->depthStencil.DepthEnable      = in->depthStencil.DepthEnable;
+	out->depthStencil.DepthWriteMask   = in->depthStencil.DepthWriteMask;
+	out->depthStencil.DepthFunc        = in->depthStencil.DepthFunc;
+	out->depthStencil.StencilEnable    = in->depthStencil.StencilEnable;
+	out->depthStencil.StencilReadMask  = in->depthStencil.StencilReadMask;
+	out->depthStencil.StencilWriteMask = in->depthStencil.StencilWriteMask;
+	out->depthStencil.FrontFace        = in->depthStencil.FrontFace;
+	out->depthStencil.BackFace         = in->depthStencil.BackFace;
+	out->stencilRef                    = in->stencilRef;
+	out->fallback                      = in->fallback;
+}
+
+static ID3D11RasterizerState *r_get_rasterizer_state( R_Context *ctx, const D3D11_RASTERIZER_DESC *desc )
+{
+	uint64_t  hash   = r_hash_bytes( desc, sizeof( *desc ), R_HASH_SEED );
+	void     *cached = r_state_object_find( &ctx->rasterizerStates, desc, hash );
+	if ( cached )
+		return (ID3D11RasterizerState *)cached;
+
+	ID3D11RasterizerState *state = NULL;
+	if ( FAILED( ctx->device->lpVtbl->CreateRasterizerState( ctx->device, desc, &state ) ) )
+		return NULL;
+	if ( !r_state_object_insert( &ctx->rasterizerStates, desc, hash, (IUnknown *)state ) )
+		safe_release( (IUnknown **)&state );
+	return state;
+}
+
+static ID3D11BlendState *r_get_blend_state( R_Context *ctx, const D3D11_BLEND_DESC *desc )
+{
+	uint64_t  hash   = r_hash_bytes( desc, sizeof( *desc ), R_HASH_SEED );
+	void     *cached = r_state_object_find( &ctx->blendStates, desc, hash );
+	if ( cached )
+		return (ID3D11BlendState *)cached;
+
+	ID3D11BlendState *state = NULL;
+	if ( FAILED( ctx->device->lpVtbl->CreateBlendState( ctx->device, desc, &state ) ) )
+		return NULL;
+	if ( !r_state_object_insert( &ctx->blendStates, desc, hash, (IUnknown *)state ) )
+		safe_release( (IUnknown **)&state );
+	return state;
+}
+
+static ID3D11DepthStencilState *r_get_depth_stencil_state( R_Context *ctx, const D3D11_DEPTH_STENCIL_DESC *desc )
+{
+	uint64_t  hash   = r_hash_bytes( desc, sizeof( *desc ), R_HASH_SEED );
+	void     *cached = r_state_object_find( &ctx->depthStencilStates, desc, hash );
+	if ( cached )
+		return (ID3D11DepthStencilState *)cached;
+
+	ID3D11DepthStencilState *state = NULL;
+	if ( FAILED( ctx->device->lpVtbl->CreateDepthStencilState( ctx->device, desc, &state ) ) )
+		return NULL;
+	if ( !r_state_object_insert( &ctx->depthStencilStates, desc, hash, (IUnknown *)state ) )
+		safe_release( (IUnknown **)&state );
+	return state;
+}
+
+// Takes references on the shaders and layout behind the descriptor's handles. Fails, leaving the
+// pipeline on its fallback, while any of them is still compiling or after its compile failed.
+static bool r_pipeline_acquire_objects( R_Context *ctx, uint32_t dense )
+{
+	R_PipelineStore      *store = &ctx->pipelines;
+	const R_PipelineDesc *desc  = &store->descs[dense];
+
+	if ( !r_pool_is_valid( &ctx->vertexShaders.pool, desc->vs.id ) ||
+	     !r_pool_is_valid( &ctx->pixelShaders.pool, desc->ps.id ) )
+		return false;
+
+	ID3D11VertexShader *vs     = ctx->vertexShaders.shaders[r_pool_lookup( &ctx->vertexShaders.pool, desc->vs.id )];
+	ID3D11PixelShader  *ps     = ctx->pixelShaders.shaders[r_pool_lookup( &ctx->pixelShaders.pool, desc->ps.id )];
+	ID3D11InputLayout  *layout = NULL;
+	if ( r_pool_is_valid( &ctx->inputLayouts.pool, desc->layout.id ) )
+	{
+		layout = ctx->inputLayouts.layouts[r_pool_lookup( &ctx->inputLayouts.pool, desc->layout.id )];
+		if ( !layout )
+			return false;
+	}
+	if ( !vs || !ps )
+		return false;
+
+	store->inputLayouts[dense] = layout;
+	store->vs[dense]           = vs;
+	store->ps[dense]           = ps;
+
+	if ( layout )
+		layout->lpVtbl->AddRef( layout );
+	vs->lpVtbl->AddRef( vs );
+	ps->lpVtbl->AddRef( ps );
+
+	if ( ctx->manifestPath )
+		r_record_pipeline( ctx, dense );
+	return true;
+}
+
+R_Pipeline r_create_pipeline( R_Context *ctx, const R_PipelineDesc *desc, R_Result *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
 
-	if ( FAILED( hr ) )
+	R_Pipeline handle = { 0 };
+	if ( !ctx || !desc )
 	{
-		*outResult = R_ERROR_DEVICE_CREATION_FAILED;
-		return NULL;
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
 	}
+	R_ASSERT_OWNER( ctx );
 
-	ID3D11Texture2D *backbuf = NULL;
-	hr                       = swap->lpVtbl->GetBuffer( swap, 0, &IID_ID3D11Texture2D, (void **)&backbuf );
-	if ( FAILED( hr ) )
+	R_PipelineStore *store = &ctx->pipelines;
+
+	R_PipelineDesc key;
+	r_canonicalize_pipeline_desc( &key, desc );
+	uint64_t hash = r_hash_bytes( &key, sizeof( key ), R_HASH_SEED );
+
+	uint32_t cachedId = 0;
+	if ( r_hash_map_get( &store->lookup, hash, &cachedId ) )
 	{
-		safe_release( (IUnknown **)&swap );
-		safe_release( (IUnknown **)&device );
-		safe_release( (IUnknown **)&ctx );
-		*outResult = R_ERROR_SWAP_CHAIN_FAILED;
-		return NULL;
+		uint32_t i = r_pool_lookup( &store->pool, cachedId );
+		if ( i != R_POOL_INVALID && memcmp( &store->descs[i], &key, sizeof( key ) ) == 0 )
+		{
+			store->refCounts[i]++;
+			handle.id  = cachedId;
+			*outResult = R_OK;
+			if ( ctx->capturing )
+				r_capture_pipeline( ctx, handle.id, &key );
+			return handle;
+		}
 	}
 
-	ID3D11RenderTargetView *rtv = NULL;
-	hr = device->lpVtbl->CreateRenderTargetView( device, (ID3D11Resource *)backbuf, NULL, &rtv );
-	backbuf->lpVtbl->Release( backbuf );
-	if ( FAILED( hr ) )
+	// Shaders may still be compiling, but not have failed already.
+	uint32_t vsIndex = r_pool_lookup( &ctx->vertexShaders.pool, key.vs.id );
+	uint32_t psIndex = r_pool_lookup( &ctx->pixelShaders.pool, key.ps.id );
+	if ( vsIndex == R_POOL_INVALID || psIndex == R_POOL_INVALID ||
+	     ( !ctx->vertexShaders.shaders[vsIndex] && !ctx->vertexShaders.jobs[vsIndex] ) ||
+	     ( !ctx->pixelShaders.shaders[psIndex] && !ctx->pixelShaders.jobs[psIndex] ) )
 	{
-		safe_release( (IUnknown **)&swap );
-		safe_release( (IUnknown **)&device );
-		safe_release( (IUnknown **)&ctx );
-		*outResult = R_ERROR_SWAP_CHAIN_FAILED;
-		return NULL;
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
 	}
 
-	R_Context *r = (R_Context *)malloc( sizeof( R_Context ) );
-	if ( !r )
+	ID3D11RasterizerState   *rs = r_get_rasterizer_state( ctx, &key.rasterizer );
+	ID3D11BlendState        *bs = r_get_blend_state( ctx, &key.blend );
+	ID3D11DepthStencilState *ds = r_get_depth_stencil_state( ctx, &key.depthStencil );
+	if ( !rs || !bs || !ds )
+	{
+		*outResult = R_ERROR_STATE_CREATION_FAILED;
+		return handle;
+	}
+
+	uint32_t dense = 0;
+	handle.id      = r_pool_alloc( &store->pool, &dense );
+	if ( !handle.id )
 	{
-		safe_release( (IUnknown **)&rtv );
-		safe_release( (IUnknown **)&swap );
-		safe_release( (IUnknown **)&device );
-		safe_release( (IUnknown **)&ctx );
 		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		return handle;
 	}
 
-	memset( r, 0, sizeof( *r ) );
-	r->device = device;
-	r->ctx    = ctx;
-	r->swap   = swap;
-	r->rtv    = rtv;
-	r->vsync  = vsync;
+	store->inputLayouts[dense] = NULL;
+	store->vs[dense]           = NULL;
+	store->ps[dense]           = NULL;
+	store->rasterizer[dense]   = rs;
+	store->blend[dense]        = bs;
+	store->depthStencil[dense] = ds;
+	store->layouts[dense]      = key.layout;
+	store->refCounts[dense]    = 1;
+	store->hashes[dense]       = hash;
+	store->descs[dense]        = key;
+	store->pending[dense]      = !r_pipeline_acquire_objects( ctx, dense );
 
-	r->vp.TopLeftX = 0.0f;
-	r->vp.TopLeftY = 0.0f;
-	r->vp.Width    = (FLOAT)width;
-	r->vp.Height   = (FLOAT)height;
-	r->vp.MinDepth = 0.0f;
-	r->vp.MaxDepth = 1.0f;
+	r_retain_input_layout( ctx, key.layout );
 
-	ctx->lpVtbl->OMSetRenderTargets( ctx, 1, &r->rtv, NULL );
-	ctx->lpVtbl->RSSetViewports( ctx, 1, &r->vp );
+	// A colliding descriptor gets its own pipeline but never replaces the cached one.
+	if ( !r_hash_map_get( &store->lookup, hash, NULL ) )
+		r_hash_map_put( &store->lookup, hash, handle.id );
 
 	*outResult = R_OK;
-	return r;
+	if ( ctx->capturing )
+		r_capture_pipeline( ctx, handle.id, &key );
+	return handle;
 }
 
-void r_destroy_context( R_Context *ctx )
+// What binding a pipeline puts on each stage, null objects put the stages back to the D3D11 defaults.
+typedef struct R_PipelineObjects
 {
-	if ( !ctx )
+	ID3D11InputLayout       *layout;
+	ID3D11VertexShader      *vs;
+	ID3D11PixelShader       *ps;
+	ID3D11RasterizerState   *rasterizer;
+	ID3D11BlendState        *blend;
+	ID3D11DepthStencilState *depthStencil;
+	const float             *blendFactor;
+	UINT                     sampleMask;
+	UINT                     stencilRef;
+} R_PipelineObjects;
+
+// A pipeline waiting on a compile stands in for its fallback. Returns the dense index of the pipeline
+// that actually gets bound (R_POOL_INVALID for none) and updates pipe to its id.
+static uint32_t r_pipeline_bound_index( R_Context *ctx, R_Pipeline *pipe )
+{
+	R_PipelineStore *store = &ctx->pipelines;
+	uint32_t         i     = r_pool_lookup( &store->pool, pipe->id );
+	if ( i != R_POOL_INVALID && store->pending[i] )
+	{
+		*pipe = store->descs[i].fallback;
+		i     = r_pool_is_valid( &store->pool, pipe->id ) ? r_pool_lookup( &store->pool, pipe->id ) : R_POOL_INVALID;
+		if ( i == R_POOL_INVALID || store->pending[i] )
+		{
+			pipe->id = 0;
+			i        = R_POOL_INVALID;
+		}
+	}
+	return i;
+}
+
+static void r_get_pipeline_objects( R_Context *ctx, uint32_t i, R_PipelineObjects *out )
+{
+	static const float defaultBlendFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	R_PipelineStore *store = &ctx->pipelines;
+	memset( out, 0, sizeof( *out ) );
+	out->blendFactor = defaultBlendFactor;
+	out->sampleMask  = 0xffffffff;
+	if ( i == R_POOL_INVALID )
 		return;
-	safe_release( (IUnknown **)&ctx->rtv );
-	safe_release( (IUnknown **)&ctx->swap );
-	safe_release( (IUnknown **)&ctx->ctx );
-	safe_release( (IUnknown **)&ctx->device );
-	free( ctx );
+
+	out->layout       = store->inputLayouts[i];
+	out->vs           = store->vs[i];
+	out->ps           = store->ps[i];
+	out->rasterizer   = store->rasterizer[i];
+	out->blend        = store->blend[i];
+	out->depthStencil = store->depthStencil[i];
+	out->blendFactor  = store->descs[i].blendFactor;
+	out->sampleMask   = store->descs[i].sampleMask;
+	out->stencilRef   = store->descs[i].stencilRef;
 }
 
-void r_present( R_Context *ctx )
+void r_bind_pipeline( R_Context *ctx, R_Pipeline pipe )
 {
 	if ( !ctx )
 		return;
-	ctx->swap->lpVtbl->Present( ctx->swap, ctx->vsync ? 1 : 0, 0 );
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_PIPELINE, .id = pipe.id };
+		r_capture_write( &ctx->capture, &call );
+	}
+
+	// The fallback's id is what the state cache sees, so the real pipeline gets bound the first time
+	// it's asked for once it's ready.
+	uint32_t i = r_pipeline_bound_index( ctx, &pipe );
+	if ( !r_state_cache_set_pipeline( &ctx->state, (const void *)(uintptr_t)pipe.id ) )
+		return;
+
+	R_PipelineObjects o;
+	r_get_pipeline_objects( ctx, i, &o );
+
+	// Pipelines sharing shaders or state blocks only pay for the parts that actually change.
+	if ( r_state_cache_set_object( &ctx->state, R_STATE_OBJECT_INPUT_LAYOUT, o.layout ) )
+		ctx->ctx->lpVtbl->IASetInputLayout( ctx->ctx, o.layout );
+	if ( r_state_cache_set_object( &ctx->state, R_STATE_OBJECT_VERTEX_SHADER, o.vs ) )
+		ctx->ctx->lpVtbl->VSSetShader( ctx->ctx, o.vs, NULL, 0 );
+	if ( r_state_cache_set_object( &ctx->state, R_STATE_OBJECT_PIXEL_SHADER, o.ps ) )
+		ctx->ctx->lpVtbl->PSSetShader( ctx->ctx, o.ps, NULL, 0 );
+	if ( r_state_cache_set_object( &ctx->state, R_STATE_OBJECT_RASTERIZER, o.rasterizer ) )
+		ctx->ctx->lpVtbl->RSSetState( ctx->ctx, o.rasterizer );
+	if ( r_state_cache_set_blend( &ctx->state, o.blend, o.blendFactor, o.sampleMask ) )
+		ctx->ctx->lpVtbl->OMSetBlendState( ctx->ctx, o.blend, o.blendFactor, o.sampleMask );
+	if ( r_state_cache_set_depth_stencil( &ctx->state, o.depthStencil, o.stencilRef ) )
+		ctx->ctx->lpVtbl->OMSetDepthStencilState( ctx->ctx, o.depthStencil, o.stencilRef );
 }
 
-void r_clear_render_target( R_Context *ctx, float r, float g, float b, float a )
+void r_destroy_pipeline( R_Context *ctx, R_Pipeline pipe )
 {
 	if ( !ctx )
 		return;
-	float clearColor[4] = { r, g, b, a };
-	ctx->ctx->lpVtbl->ClearRenderTargetView( ctx->ctx, ctx->rtv, clearColor );
+	R_ASSERT_OWNER( ctx );
+
+	R_PipelineStore *store = &ctx->pipelines;
+	uint32_t         i     = r_pool_lookup( &store->pool, pipe.id );
+	if ( i != R_POOL_INVALID && ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DESTROY_PIPELINE, .id = pipe.id };
+		r_capture_write( &ctx->capture, &call );
+	}
+	if ( i == R_POOL_INVALID || --store->refCounts[i] > 0 )
+		return;
+
+	uint32_t cachedId = 0;
+	if ( r_hash_map_get( &store->lookup, store->hashes[i], &cachedId ) && cachedId == pipe.id )
+		r_hash_map_remove( &store->lookup, store->hashes[i] );
+
+	uint32_t dense, moved;
+	r_pool_release( &store->pool, pipe.id, &dense, &moved );
+	ctx->resourceEpoch++;
+
+	R_InputLayout layout = store->layouts[dense];
+
+	r_defer_release_object( ctx, (IUnknown **)&store->inputLayouts[dense] );
+	r_defer_release_object( ctx, (IUnknown **)&store->vs[dense] );
+	r_defer_release_object( ctx, (IUnknown **)&store->ps[dense] );
+
+	store->inputLayouts[dense] = store->inputLayouts[moved];
+	store->vs[dense]           = store->vs[moved];
+	store->ps[dense]           = store->ps[moved];
+	store->rasterizer[dense]   = store->rasterizer[moved];
+	store->blend[dense]        = store->blend[moved];
+	store->depthStencil[dense] = store->depthStencil[moved];
+	store->layouts[dense]      = store->layouts[moved];
+	store->refCounts[dense]    = store->refCounts[moved];
+	store->hashes[dense]       = store->hashes[moved];
+	store->descs[dense]        = store->descs[moved];
+	store->pending[dense]      = store->pending[moved];
+	store->inputLayouts[moved] = NULL;
+	store->vs[moved]           = NULL;
+	store->ps[moved]           = NULL;
+
+	r_destroy_input_layout( ctx, layout );
 }
 
-void r_set_viewport( R_Context *ctx, float x, float y, float w, float h )
+// True once the job is over, with the bytecode (NULL when the compile failed) handed to the caller.
+// Fresh bytecode goes into the shader cache under the key it was submitted with.
+static bool r_take_shader_job( R_Context *ctx, uint32_t *job, void **outBytecode, size_t *outSize )
 {
-	if ( !ctx )
+	uint64_t         key   = 0;
+	R_ShaderJobState state = r_shader_jobs_take( &ctx->shaderJobs, *job, outBytecode, outSize, &key );
+	if ( state == R_SHADER_JOB_QUEUED || state == R_SHADER_JOB_RUNNING )
+		return false;
+
+	*job = 0;
+	ctx->pendingShaders--;
+	if ( *outBytecode )
+		r_shader_cache_insert( &ctx->shaderCache, key, *outBytecode, *outSize );
+	return true;
+}
+
+static void r_resolve_pending_layouts( R_Context *ctx )
+{
+	R_InputLayoutStore *store = &ctx->inputLayouts;
+	for ( uint32_t i = 0; i < store->pool.count; ++i )
+	{
+		R_PendingInputLayout *pending = &store->pending[i];
+		if ( !pending->elements )
+			continue;
+
+		uint32_t vsIndex = r_pool_is_valid( &ctx->vertexShaders.pool, pending->vs.id )
+		                       ? r_pool_lookup( &ctx->vertexShaders.pool, pending->vs.id )
+		                       : R_POOL_INVALID;
+		if ( vsIndex != R_POOL_INVALID && ctx->vertexShaders.jobs[vsIndex] )
+			continue;
+
+		// A shader that failed or went away leaves the layout empty for good, its pipelines stay on the fallback.
+		ID3D11InputLayout *layout        = NULL;
+		uint64_t           signatureHash = vsIndex != R_POOL_INVALID ? ctx->vertexShaders.signatureHashes[vsIndex] : 0;
+		uint64_t           hash          = r_hash_input_elements( pending->elements, pending->count, signatureHash );
+		if ( vsIndex != R_POOL_INVALID && ctx->vertexShaders.shaders[vsIndex] &&
+		     SUCCEEDED( r_create_d3d_input_layout( ctx, pending->elements, pending->count, vsIndex, hash, &layout ) ) )
+		{
+			store->layouts[i]               = layout;
+			store->hashes[i]                = hash;
+			store->sources[i].signatureHash = signatureHash;
+			if ( !r_hash_map_get( &store->lookup, store->hashes[i], NULL ) )
+				r_hash_map_put( &store->lookup, store->hashes[i], r_pool_handle_at( &store->pool, i ) );
+		}
+
+		memset( pending, 0, sizeof( *pending ) );
+		if ( !r_wants_sources( ctx ) )
+		{
+			free( store->sources[i].elements );
+			store->sources[i].elements = NULL;
+		}
+	}
+}
+
+void r_poll_shader_jobs( R_Context *ctx )
+{
+	if ( !ctx || ctx->pendingShaders == 0 )
 		return;
 
-	ctx->vp.TopLeftX = x;
-	ctx->vp.TopLeftY = y;
-	ctx->vp.Width    = w;
-	ctx->vp.Height   = h;
-	ctx->vp.MinDepth = 0.0f;
-	ctx->vp.MaxDepth = 1.0f;
+	uint32_t finished = 0;
+	void    *bytecode = NULL;
+	size_t   size     = 0;
 
-	ctx->ctx->lpVtbl->RSSetViewports( ctx->ctx, 1, &ctx->vp );
+	R_VertexShaderStore *vertex = &ctx->vertexShaders;
+	for ( uint32_t i = 0; i < vertex->pool.count; ++i )
+	{
+		if ( !vertex->jobs[i] || !r_take_shader_job( ctx, &vertex->jobs[i], &bytecode, &size ) )
+			continue;
+		// The shader keeps the bytecode if captures or manifests want it.
+		uint64_t *signatureHash = &vertex->signatureHashes[i];
+		if ( bytecode && r_build_vertex_shader( ctx, bytecode, size, &vertex->shaders[i], signatureHash ) &&
+		     r_wants_sources( ctx ) )
+		{
+			vertex->bytecode[i] = ( R_ShaderBytecode ){ bytecode, size };
+			bytecode            = NULL;
+			if ( ctx->capturing )
+			{
+				uint32_t id = r_pool_handle_at( &vertex->pool, i );
+				r_capture_shader( ctx, R_CAPTURE_CREATE_VERTEX_SHADER, id, &vertex->bytecode[i] );
+			}
+		}
+		free( bytecode );
+		finished++;
+	}
+
+	R_PixelShaderStore *pixel = &ctx->pixelShaders;
+	for ( uint32_t i = 0; i < pixel->pool.count; ++i )
+	{
+		if ( !pixel->jobs[i] || !r_take_shader_job( ctx, &pixel->jobs[i], &bytecode, &size ) )
+			continue;
+		if ( bytecode && r_build_pixel_shader( ctx, bytecode, size, &pixel->shaders[i] ) && r_wants_sources( ctx ) )
+		{
+			pixel->bytecode[i] = ( R_ShaderBytecode ){ bytecode, size };
+			bytecode           = NULL;
+			if ( ctx->capturing )
+			{
+				uint32_t id = r_pool_handle_at( &pixel->pool, i );
+				r_capture_shader( ctx, R_CAPTURE_CREATE_PIXEL_SHADER, id, &pixel->bytecode[i] );
+			}
+		}
+		free( bytecode );
+		finished++;
+	}
+
+	// Layouts and pipelines can only become complete when one of their shaders just did.
+	if ( finished == 0 )
+		return;
+
+	r_resolve_pending_layouts( ctx );
+
+	R_PipelineStore *pipelines = &ctx->pipelines;
+	for ( uint32_t i = 0; i < pipelines->pool.count; ++i )
+	{
+		if ( pipelines->pending[i] && r_pipeline_acquire_objects( ctx, i ) )
+		{
+			pipelines->pending[i] = false;
+			ctx->resourceEpoch++;
+		}
+	}
 }
 
-R_Buffer *
-r_create_buffer( R_Context *ctx, const void *data, size_t bytes, bool dynamic, UINT bindFlags, R_Result *outResult )
+static uint32_t r_add_warm_object( R_WarmObjects *warm,
+                                   R_WarmKind     kind,
+                                   IUnknown      *object,
+                                   const void    *data,
+                                   size_t         size,
+                                   uint64_t       hash )
 {
-	R_Result localResult = R_OK;
-	if ( !outResult )
-		outResult = &localResult;
+	// Shaders and layouts keep a copy for r_take_warm_object to compare, the manifest goes at adoption.
+	void *copy = NULL;
+	if ( kind == R_WARM_INPUT_LAYOUT )
+		copy = r_copy_input_elements( (const D3D11_INPUT_ELEMENT_DESC *)data, (UINT)size );
+	else if ( kind < R_WARM_LOOKUPS && ( copy = malloc( size ) ) != NULL )
+		memcpy( copy, data, size );
+	if ( warm->count == warm->capacity || ( kind < R_WARM_LOOKUPS && !copy ) )
+	{
+		free( copy );
+		safe_release( &object );
+		return 0;
+	}
 
-	if ( !ctx )
+	uint32_t i       = warm->count++;
+	warm->objects[i] = object;
+	warm->kinds[i]   = (uint8_t)kind;
+	warm->hashes[i]  = hash;
+	warm->data[i]    = kind < R_WARM_LOOKUPS ? copy : data;
+	warm->sizes[i]   = size;
+	return i + 1;
+}
+
+// The blocks of a pipeline entry become three state objects; the pipeline itself is only handles.
+static uint32_t r_warm_pipeline( R_Context *ctx, const R_CaptureCall *call )
+{
+	const uint8_t *blocks = r_pipeline_call_blocks( call );
+	if ( !blocks )
+		return 0;
+
+	D3D11_RASTERIZER_DESC    rasterizer;
+	D3D11_BLEND_DESC         blend;
+	D3D11_DEPTH_STENCIL_DESC depthStencil;
+	const uint8_t           *blendBlock        = blocks + sizeof( rasterizer );
+	const uint8_t           *depthStencilBlock = blendBlock + sizeof( blend );
+	memcpy( &rasterizer, blocks, sizeof( rasterizer ) );
+	memcpy( &blend, blendBlock, sizeof( blend ) );
+	memcpy( &depthStencil, depthStencilBlock, sizeof( depthStencil ) );
+
+	ID3D11Device            *dev = ctx->device;
+	ID3D11RasterizerState   *rs  = NULL;
+	ID3D11BlendState        *bs  = NULL;
+	ID3D11DepthStencilState *ds  = NULL;
+	dev->lpVtbl->CreateRasterizerState( dev, &rasterizer, &rs );
+	dev->lpVtbl->CreateBlendState( dev, &blend, &bs );
+	dev->lpVtbl->CreateDepthStencilState( dev, &depthStencil, &ds );
+	if ( !rs || !bs || !ds )
 	{
-		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		safe_release( (IUnknown **)&rs );
+		safe_release( (IUnknown **)&bs );
+		safe_release( (IUnknown **)&ds );
+		return 0;
 	}
 
-	D3D11_BUFFER_DESC bd;
-	ZeroMemory( &bd, sizeof( bd ) );
-	bd.ByteWidth           = (UINT)bytes;
-	bd.BindFlags           = bindFlags;
-	bd.CPUAccessFlags      = dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
-	bd.Usage               = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
-	bd.MiscFlags           = 0;
-	bd.StructureByteStride = 0;
+	R_WarmObjects *warm = &ctx->warm;
+	uint64_t       rh   = r_hash_bytes( &rasterizer, sizeof( rasterizer ), R_HASH_SEED );
+	uint64_t       bh   = r_hash_bytes( &blend, sizeof( blend ), R_HASH_SEED );
+	uint64_t       dh   = r_hash_bytes( &depthStencil, sizeof( depthStencil ), R_HASH_SEED );
+	uint32_t       rsId =
+	    r_add_warm_object( warm, R_WARM_RASTERIZER, (IUnknown *)rs, blocks, sizeof( rasterizer ), rh );
+	uint32_t       bsId = r_add_warm_object( warm, R_WARM_BLEND, (IUnknown *)bs, blendBlock, sizeof( blend ), bh );
+	uint32_t       dsId = r_add_warm_object(
+	    warm, R_WARM_DEPTH_STENCIL, (IUnknown *)ds, depthStencilBlock, sizeof( depthStencil ), dh );
+	return rsId && bsId && dsId ? dsId : 0;
+}
 
-	D3D11_SUBRESOURCE_DATA initData;
-	ZeroMemory( &initData, sizeof( initData ) );
-	initData.pSysMem = data;
+// The precache thread's target. It creates through the device, which is free-threaded, and writes
+// nothing but ctx->warm: everything else in the context stays the main thread's. Created objects
+// are identified by their index in warm, plus one.
+static uint32_t r_warm_execute( void *self, const R_CaptureCall *call )
+{
+	R_Context     *ctx    = (R_Context *)self;
+	ID3D11Device  *dev    = ctx->device;
+	R_WarmObjects *warm   = &ctx->warm;
+	IUnknown      *object = NULL;
+	HRESULT        hr     = E_FAIL;
 
-	ID3D11Buffer *buf = NULL;
-	HRESULT       hr  = ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, data ? &initData : NULL, &buf );
-	if ( FAILED( hr ) )
+	switch ( call->op )
 	{
-		*outResult = R_ERROR_BUFFER_CREATION_FAILED;
-		return NULL;
+	case R_CAPTURE_CREATE_VERTEX_SHADER:
+	case R_CAPTURE_CREATE_PIXEL_SHADER:
+	{
+		bool       pixel = call->op == R_CAPTURE_CREATE_PIXEL_SHADER;
+		R_WarmKind kind  = pixel ? R_WARM_PIXEL_SHADER : R_WARM_VERTEX_SHADER;
+		if ( pixel )
+			hr = dev->lpVtbl->CreatePixelShader( dev, call->data, call->size, NULL, (ID3D11PixelShader **)&object );
+		else
+			hr = dev->lpVtbl->CreateVertexShader( dev, call->data, call->size, NULL, (ID3D11VertexShader **)&object );
+		if ( FAILED( hr ) )
+			return 0;
+		uint64_t hash = r_hash_bytes( call->data, call->size, R_HASH_SEED );
+		return r_add_warm_object( warm, kind, object, call->data, call->size, hash );
 	}
+	case R_CAPTURE_CREATE_INPUT_LAYOUT:
+	{
+		// The vertex shader entry is earlier in the manifest, with its bytecode copied.
+		uint32_t vs            = call->refs[0] - 1;
+		uint64_t signatureHash = 0;
+		if ( !call->refs[0] || warm->kinds[vs] != R_WARM_VERTEX_SHADER ||
+		     !r_dxbc_input_signature_hash( warm->data[vs], warm->sizes[vs], &signatureHash ) )
+			return 0;
 
-	R_Buffer *b = (R_Buffer *)malloc( sizeof( R_Buffer ) );
-	if ( !b )
+		D3D11_INPUT_ELEMENT_DESC desc[R_CAPTURE_MAX_ELEMENTS];
+		UINT                     count = call->elementCount;
+		r_input_elements_from_call( desc, call );
+		hr = dev->lpVtbl->CreateInputLayout(
+		    dev, desc, count, warm->data[vs], warm->sizes[vs], (ID3D11InputLayout **)&object );
+		if ( FAILED( hr ) )
+			return 0;
+		uint64_t hash = r_hash_input_elements( desc, count, signatureHash );
+		return r_add_warm_object( warm, R_WARM_INPUT_LAYOUT, object, desc, count, hash );
+	}
+	case R_CAPTURE_CREATE_PIPELINE:
+		return r_warm_pipeline( ctx, call );
+	case R_CAPTURE_CREATE_SAMPLER:
 	{
-		safe_release( (IUnknown **)&buf );
-		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		D3D11_SAMPLER_DESC desc;
+		if ( call->size != sizeof( desc ) )
+			return 0;
+		memcpy( &desc, call->data, sizeof( desc ) );
+		if ( FAILED( dev->lpVtbl->CreateSamplerState( dev, &desc, (ID3D11SamplerState **)&object ) ) )
+			return 0;
+		uint64_t hash = r_hash_bytes( &desc, sizeof( desc ), R_HASH_SEED );
+		return r_add_warm_object( warm, R_WARM_SAMPLER, object, call->data, sizeof( desc ), hash );
+	}
+	default:
+		return 0;
 	}
+}
 
-	b->buf     = buf;
-	b->size    = bytes;
-	*outResult = R_OK;
-	return b;
+static R_StateObjectCache *r_warm_state_cache( R_Context *ctx, R_WarmKind kind )
+{
+	switch ( kind )
+	{
+	case R_WARM_RASTERIZER:
+		return &ctx->rasterizerStates;
+	case R_WARM_BLEND:
+		return &ctx->blendStates;
+	case R_WARM_DEPTH_STENCIL:
+		return &ctx->depthStencilStates;
+	default:
+		return &ctx->samplerStates;
+	}
 }
 
-R_Buffer *r_create_constant_buffer( R_Context *ctx, size_t size, R_Result *outResult )
+// After the thread is done: state objects go to their caches, shaders and layouts into the lookups.
+static void r_adopt_warm_objects( R_Context *ctx )
 {
-	if ( !ctx )
+	R_WarmObjects *warm = &ctx->warm;
+	for ( int kind = 0; kind < R_WARM_LOOKUPS; ++kind )
+		r_hash_map_init( &warm->lookup[kind], warm->count );
+
+	for ( uint32_t i = 0; i < warm->count; ++i )
 	{
-		if ( outResult )
-			*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		R_WarmKind kind = (R_WarmKind)warm->kinds[i];
+		if ( kind < R_WARM_LOOKUPS )
+		{
+			if ( !r_hash_map_get( &warm->lookup[kind], warm->hashes[i], NULL ) )
+				r_hash_map_put( &warm->lookup[kind], warm->hashes[i], i );
+		}
+		else
+		{
+			// Whatever the main thread created in the meantime wins, the cache holds one object per desc.
+			R_StateObjectCache *cache = r_warm_state_cache( ctx, kind );
+			if ( !r_state_object_find_id( cache, warm->data[i], warm->hashes[i] ) &&
+			     r_state_object_insert( cache, warm->data[i], warm->hashes[i], warm->objects[i] ) )
+				warm->objects[i] = NULL;
+			else
+				safe_release( &warm->objects[i] );
+			warm->data[i] = NULL;
+		}
 	}
 
-	// 16 byte alignment for constant buffers
-	size_t alignedSize = ( size + 15 ) & ~15;
-	return r_create_buffer( ctx, NULL, alignedSize, true, D3D11_BIND_CONSTANT_BUFFER, outResult );
+	free( ctx->manifest );
+	ctx->manifest = NULL;
 }
 
-void r_update_buffer( R_Context *ctx, R_Buffer *buf, const void *data, size_t bytes )
+bool r_load_pipeline_manifest( R_Context *ctx, const char *path )
 {
-	if ( !ctx || !buf || !data )
-		return;
+	if ( !ctx || !path || ctx->manifest || ctx->warm.objects )
+		return false;
 
-	D3D11_MAPPED_SUBRESOURCE mapped;
-	HRESULT hr = ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)buf->buf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped );
-	if ( SUCCEEDED( hr ) )
+	IO_File file;
+	if ( !io_file_open( &file, path, false ) )
+		return false;
+	size_t size = (size_t)io_file_size( &file );
+	void  *data = size ? malloc( size ) : NULL;
+	bool   read = data && io_file_read_at( &file, 0, data, size );
+	io_file_close( &file );
+
+	// A pipeline entry makes three objects, nothing else more than one.
+	R_CaptureReader probe;
+	R_WarmObjects  *warm = &ctx->warm;
+	if ( !read || !r_capture_reader_init( &probe, data, size ) )
 	{
-		memcpy( mapped.pData, data, bytes );
-		ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)buf->buf, 0 );
+		free( data );
+		return false;
+	}
+	warm->capacity = probe.calls * 3;
+	warm->objects  = (IUnknown **)calloc( warm->capacity + 1, sizeof( IUnknown * ) );
+	warm->kinds    = (uint8_t *)calloc( warm->capacity + 1, sizeof( uint8_t ) );
+	warm->hashes   = (uint64_t *)calloc( warm->capacity + 1, sizeof( uint64_t ) );
+	warm->data     = (const void **)calloc( warm->capacity + 1, sizeof( const void * ) );
+	warm->sizes    = (size_t *)calloc( warm->capacity + 1, sizeof( size_t ) );
+	ctx->manifest  = data;
+
+	R_ReplayTarget target = { "precache", ctx, r_warm_execute };
+	if ( !warm->objects || !warm->kinds || !warm->hashes || !warm->data || !warm->sizes ||
+	     !r_precache_start( &ctx->precache, data, size, &target ) )
+	{
+		r_free_warm_objects( warm );
+		free( data );
+		ctx->manifest = NULL;
+		return false;
 	}
+	return true;
 }
 
-void r_bind_constant_buffer( R_Context *ctx, R_Buffer *cb, int slot )
+void r_poll_pipeline_manifest( R_Context *ctx )
 {
-	if ( !ctx )
+	if ( ctx && ctx->manifest && r_precache_finished( &ctx->precache ) )
+		r_adopt_warm_objects( ctx );
+}
+
+void r_wait_pipeline_manifest( R_Context *ctx )
+{
+	if ( !ctx || !ctx->manifest )
 		return;
+	r_precache_wait( &ctx->precache );
+	r_adopt_warm_objects( ctx );
+}
 
-	ID3D11Buffer *buf = cb ? cb->buf : NULL;
-	ctx->ctx->lpVtbl->VSSetConstantBuffers( ctx->ctx, slot, 1, &buf );
-	ctx->ctx->lpVtbl->PSSetConstantBuffers( ctx->ctx, slot, 1, &buf );
+bool r_get_pipeline_manifest_stats( R_Context *ctx, R_PrecacheStats *outStats )
+{
+	if ( !ctx || !outStats || ctx->manifest )
+		return false;
+	*outStats = ctx->precache.stats;
+	return true;
 }
 
-void r_destroy_buffer( R_Buffer *buf )
+bool r_record_pipeline_manifest( R_Context *ctx, const char *path )
 {
-	if ( !buf )
-		return;
-	safe_release( (IUnknown **)&buf->buf );
-	free( buf );
+	if ( !ctx || !path || ctx->manifestPath || !r_precache_recorder_init( &ctx->manifestRecorder ) )
+		return false;
+
+	size_t length     = strlen( path ) + 1;
+	ctx->manifestPath = (char *)malloc( length );
+	if ( !ctx->manifestPath )
+	{
+		r_precache_recorder_free( &ctx->manifestRecorder );
+		return false;
+	}
+	memcpy( ctx->manifestPath, path, length );
+
+	// Everything created so far, like a capture's setup calls.
+	for ( uint32_t i = 0; i < ctx->pipelines.pool.count; ++i )
+	{
+		if ( !ctx->pipelines.pending[i] )
+			r_record_pipeline( ctx, i );
+	}
+	R_InputLayoutStore *layouts = &ctx->inputLayouts;
+	for ( uint32_t i = 0; i < layouts->pool.count; ++i )
+	{
+		R_VertexShader vs = r_capture_signature_shader( ctx, layouts->sources[i].signatureHash );
+		if ( vs.id && layouts->layouts[i] )
+		{
+			uint32_t vsIndex = r_pool_lookup( &ctx->vertexShaders.pool, vs.id );
+			r_record_input_layout( ctx, vsIndex, layouts->sources[i].elements, layouts->sources[i].count );
+		}
+	}
+	R_StateObjectCache *samplers = &ctx->samplerStates;
+	for ( uint32_t id = 1; id <= samplers->count; ++id )
+		r_record_sampler( ctx, (const D3D11_SAMPLER_DESC *)r_state_object_desc( samplers, id ) );
+	return true;
 }
 
-static ID3DBlob *compile_hlsl( const char *src, const char *entry, const char *profile )
+bool r_save_pipeline_manifest( R_Context *ctx )
 {
-	ID3DBlob *blob = NULL;
-	ID3DBlob *err  = NULL;
-	HRESULT   hr   = D3DCompile( src,
-                             strlen( src ),
-                             NULL,
-                             NULL,
-                             NULL,
-                             entry,
-                             profile,
-                             D3DCOMPILE_OPTIMIZATION_LEVEL3,
-                             0,
-                             &blob,
-                             &err );
-	if ( FAILED( hr ) )
+	return ctx && ctx->manifestPath && r_precache_save( &ctx->manifestRecorder, ctx->manifestPath );
+}
+
+static UINT r_full_mip_count( UINT width, UINT height )
+{
+	UINT levels = 1;
+	for ( UINT size = width > height ? width : height; size > 1; size >>= 1 )
+		levels++;
+	return levels;
+}
+
+R_Texture r_create_texture( R_Context           *ctx,
+                            const R_TextureDesc *desc,
+                            const R_TextureData *data,
+                            R_Result            *outResult )
+{
+	R_Result localResult = R_OK;
+	if ( !outResult )
+		outResult = &localResult;
+
+	R_Texture handle = { 0 };
+	if ( !ctx || !desc || desc->width == 0 || desc->height == 0 || ( desc->generateMips && !data ) )
 	{
-		if ( err )
+		*outResult = R_ERROR_INVALID_PARAMETER;
+		return handle;
+	}
+	R_ASSERT_OWNER( ctx );
+
+	UINT fullChain = r_full_mip_count( desc->width, desc->height );
+	UINT levels    = desc->mipLevels && desc->mipLevels < fullChain ? desc->mipLevels : fullChain;
+	UINT slices    = desc->arraySize ? desc->arraySize : 1;
+
+	D3D11_TEXTURE2D_DESC td;
+	ZeroMemory( &td, sizeof( td ) );
+	td.Width            = desc->width;
+	td.Height           = desc->height;
+	td.MipLevels        = levels;
+	td.ArraySize        = slices;
+	td.Format           = desc->format;
+	td.SampleDesc.Count = 1;
+	td.Usage            = D3D11_USAGE_DEFAULT;
+	td.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
+	if ( desc->generateMips )
+	{
+		td.BindFlags |= D3D11_BIND_RENDER_TARGET;
+		td.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	}
+
+	// Every subresource goes in with the create call, unless the GPU renders the mips below the top.
+	D3D11_SUBRESOURCE_DATA *initial = NULL;
+	if ( data && !desc->generateMips )
+	{
+		initial = (D3D11_SUBRESOURCE_DATA *)calloc( (size_t)levels * slices, sizeof( D3D11_SUBRESOURCE_DATA ) );
+		if ( !initial )
 		{
-			OutputDebugStringA( (const char *)err->lpVtbl->GetBufferPointer( err ) );
-			err->lpVtbl->Release( err );
+			*outResult = R_ERROR_OUT_OF_MEMORY;
+			return handle;
+		}
+		for ( UINT i = 0; i < levels * slices; ++i )
+		{
+			initial[i].pSysMem     = data[i].pixels;
+			initial[i].SysMemPitch = data[i].rowPitch;
+		}
+	}
+
+	ID3D11Texture2D          *texture = NULL;
+	ID3D11ShaderResourceView *view    = NULL;
+	HRESULT                   hr      = ctx->device->lpVtbl->CreateTexture2D( ctx->device, &td, initial, &texture );
+	free( initial );
+	if ( SUCCEEDED( hr ) )
+		hr = ctx->device->lpVtbl->CreateShaderResourceView( ctx->device, (ID3D11Resource *)texture, NULL, &view );
+	if ( FAILED( hr ) )
+	{
+		safe_release( (IUnknown **)&texture );
+		*outResult = R_ERROR_TEXTURE_CREATION_FAILED;
+		return handle;
+	}
+
+	uint32_t dense = 0;
+	handle.id      = r_pool_alloc( &ctx->textures.pool, &dense );
+	if ( !handle.id )
+	{
+		safe_release( (IUnknown **)&view );
+		safe_release( (IUnknown **)&texture );
+		*outResult = R_ERROR_OUT_OF_MEMORY;
+		return handle;
+	}
+
+	if ( desc->generateMips )
+	{
+		for ( UINT slice = 0; slice < slices; ++slice )
+		{
+			const R_TextureData *top = &data[slice];
+			ctx->ctx->lpVtbl->UpdateSubresource(
+			    ctx->ctx, (ID3D11Resource *)texture, slice * levels, NULL, top->pixels, top->rowPitch, 0 );
 		}
-		safe_release( (IUnknown **)&blob );
-		return NULL;
+		ctx->ctx->lpVtbl->GenerateMips( ctx->ctx, view );
 	}
-	safe_release( (IUnknown **)&err );
-	return blob;
+
+	ctx->textures.textures[dense] = texture;
+	ctx->textures.views[dense]    = view;
+	*outResult                    = R_OK;
+	return handle;
 }
 
-R_VertexShader *
-r_create_vertex_shader_from_bytecode( R_Context *ctx, const void *bytecode, size_t bytecodeSize, R_Result *outResult )
+void r_destroy_texture( R_Context *ctx, R_Texture texture )
+{
+	uint32_t dense, moved;
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
+	if ( !r_pool_release( &ctx->textures.pool, texture.id, &dense, &moved ) )
+		return;
+
+	r_defer_release_object( ctx, (IUnknown **)&ctx->textures.views[dense] );
+	r_defer_release_object( ctx, (IUnknown **)&ctx->textures.textures[dense] );
+	ctx->textures.textures[dense] = ctx->textures.textures[moved];
+	ctx->textures.views[dense]    = ctx->textures.views[moved];
+	ctx->textures.textures[moved] = NULL;
+	ctx->textures.views[moved]    = NULL;
+}
+
+ID3D11ShaderResourceView *r_get_texture_view( R_Context *ctx, R_Texture texture )
+{
+	uint32_t i = ctx ? r_pool_lookup( &ctx->textures.pool, texture.id ) : R_POOL_INVALID;
+	return i != R_POOL_INVALID ? ctx->textures.views[i] : NULL;
+}
+
+R_Sampler r_create_sampler( R_Context *ctx, const D3D11_SAMPLER_DESC *desc, R_Result *outResult )
 {
 	R_Result localResult = R_OK;
 	if ( !outResult )
 		outResult = &localResult;
 
-	if ( !ctx || !bytecode || bytecodeSize == 0 )
+	R_Sampler handle = { 0 };
+	if ( !ctx || !desc )
 	{
 		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		return handle;
 	}
+	R_ASSERT_OWNER( ctx );
 
-	ID3D11VertexShader *vs = NULL;
-	HRESULT             hr = ctx->device->lpVtbl->CreateVertexShader( ctx->device, bytecode, bytecodeSize, NULL, &vs );
-	if ( FAILED( hr ) )
+	// The handle is the shared state object's id in the cache.
+	R_StateObjectCache *cache = &ctx->samplerStates;
+	uint64_t            hash  = r_hash_bytes( desc, sizeof( *desc ), R_HASH_SEED );
+	handle.id                 = r_state_object_find_id( cache, desc, hash );
+	if ( handle.id )
 	{
-		*outResult = R_ERROR_SHADER_CREATION_FAILED;
-		return NULL;
+		*outResult = R_OK;
+		return handle;
 	}
 
-	// Copy bytecode for input layout creation later
-	void *bytecodeCopy = malloc( bytecodeSize );
-	if ( !bytecodeCopy )
+	if ( ctx->manifestPath )
+		r_record_sampler( ctx, desc );
+
+	ID3D11SamplerState *sampler = NULL;
+	if ( FAILED( ctx->device->lpVtbl->CreateSamplerState( ctx->device, desc, &sampler ) ) )
 	{
-		safe_release( (IUnknown **)&vs );
+		*outResult = R_ERROR_STATE_CREATION_FAILED;
+		return handle;
+	}
+	handle.id = r_state_object_insert( cache, desc, hash, sampler );
+	if ( !handle.id )
+	{
+		safe_release( (IUnknown **)&sampler );
 		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		return handle;
 	}
-	memcpy( bytecodeCopy, bytecode, bytecodeSize );
 
-	R_VertexShader *s = (R_VertexShader *)malloc( sizeof( R_VertexShader ) );
-	if ( !s )
+	*outResult = R_OK;
+	return handle;
+}
+
+ID3D11SamplerState *r_get_sampler_state( R_Context *ctx, R_Sampler sampler )
+{
+	return ctx ? (ID3D11SamplerState *)r_state_object_get( &ctx->samplerStates, sampler.id ) : NULL;
+}
+
+void r_bind_texture( R_Context *ctx, R_Texture texture, R_ShaderStage stage, UINT slot )
+{
+	if ( !ctx || stage < 0 || stage >= R_STAGE_COUNT || slot >= R_MAX_TEXTURE_SLOTS )
+		return;
+
+	ID3D11ShaderResourceView *view = r_get_texture_view( ctx, texture );
+	if ( ctx->capturing && stage == R_STAGE_PIXEL )
 	{
-		free( bytecodeCopy );
-		safe_release( (IUnknown **)&vs );
-		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_TEXTURE, .args = { slot, view != NULL } };
+		r_capture_write( &ctx->capture, &call );
 	}
 
-	s->vs           = vs;
-	s->bytecode     = bytecodeCopy;
-	s->bytecodeSize = bytecodeSize;
-	*outResult      = R_OK;
-	return s;
+	r_bound_groups_forget( &ctx->boundGroups, R_BIND_TEXTURES, stage, 1u << slot );
+	if ( !r_state_cache_set_texture( &ctx->state, stage, (int)slot, view ) )
+		return;
+	if ( stage == R_STAGE_VERTEX )
+		ctx->ctx->lpVtbl->VSSetShaderResources( ctx->ctx, slot, 1, &view );
+	else
+		ctx->ctx->lpVtbl->PSSetShaderResources( ctx->ctx, slot, 1, &view );
 }
 
-R_PixelShader *
-r_create_pixel_shader_from_bytecode( R_Context *ctx, const void *bytecode, size_t bytecodeSize, R_Result *outResult )
+void r_bind_sampler( R_Context *ctx, R_Sampler sampler, R_ShaderStage stage, UINT slot )
+{
+	if ( !ctx || stage < 0 || stage >= R_STAGE_COUNT || slot >= R_MAX_SAMPLER_SLOTS )
+		return;
+
+	ID3D11SamplerState *state = r_get_sampler_state( ctx, sampler );
+	r_bound_groups_forget( &ctx->boundGroups, R_BIND_SAMPLERS, stage, 1u << slot );
+	if ( !r_state_cache_set_sampler( &ctx->state, stage, (int)slot, state ) )
+		return;
+	if ( stage == R_STAGE_VERTEX )
+		ctx->ctx->lpVtbl->VSSetSamplers( ctx->ctx, slot, 1, &state );
+	else
+		ctx->ctx->lpVtbl->PSSetSamplers( ctx->ctx, slot, 1, &state );
+}
+
+R_BindGroup r_create_bind_group( R_Context *ctx, const R_BindGroupDesc *desc, R_Result *outResult )
 {
 	R_Result localResult = R_OK;
 	if ( !outResult )
 		outResult = &localResult;
 
-	if ( !ctx || !bytecode || bytecodeSize == 0 )
+	R_BindGroup handle = { 0 };
+	if ( !ctx || !desc )
 	{
 		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		return handle;
 	}
+	R_ASSERT_OWNER( ctx );
 
-	ID3D11PixelShader *ps = NULL;
-	HRESULT            hr = ctx->device->lpVtbl->CreatePixelShader( ctx->device, bytecode, bytecodeSize, NULL, &ps );
+	R_BindGroupStore *store = &ctx->bindGroups;
+	uint64_t          hash  = r_hash_bytes( desc, sizeof( *desc ), R_HASH_SEED );
+	handle.id               = r_bind_group_set_acquire( &store->set, desc, hash );
+	if ( handle.id )
+	{
+		*outResult = R_OK;
+		return handle;
+	}
 
-	if ( FAILED( hr ) )
+	R_BindGroupBuffers buffers;
+	R_BindGroupSlots   slots;
+	memset( &buffers, 0, sizeof( buffers ) );
+	memset( &slots, 0, sizeof( slots ) );
+	for ( int stage = 0; stage < R_STAGE_COUNT; ++stage )
 	{
-		*outResult = R_ERROR_SHADER_CREATION_FAILED;
-		return NULL;
+		for ( int slot = 0; slot < R_MAX_CONSTANT_BUFFER_SLOTS; ++slot )
+		{
+			R_Buffer buf = desc->constants[stage][slot];
+			if ( !buf.id )
+				continue;
+			if ( !r_pool_is_valid( &ctx->buffers.pool, buf.id ) )
+			{
+				*outResult = R_ERROR_INVALID_PARAMETER;
+				return handle;
+			}
+			buffers.buffers[stage][slot] = r_buffer_get( ctx, buf );
+			slots.masks[R_BIND_CONSTANTS][stage] |= 1u << slot;
+		}
+		for ( int slot = 0; slot < R_BIND_GROUP_TEXTURE_SLOTS; ++slot )
+		{
+			if ( desc->textures[stage][slot] )
+				slots.masks[R_BIND_TEXTURES][stage] |= 1u << slot;
+		}
+		for ( int slot = 0; slot < R_BIND_GROUP_SAMPLER_SLOTS; ++slot )
+		{
+			if ( desc->samplers[stage][slot] )
+				slots.masks[R_BIND_SAMPLERS][stage] |= 1u << slot;
+		}
 	}
 
-	R_PixelShader *s = (R_PixelShader *)malloc( sizeof( R_PixelShader ) );
-	if ( !s )
+	uint32_t dense = 0;
+	handle.id      = r_bind_group_set_add( &store->set, desc, hash, &slots, &dense );
+	if ( !handle.id )
 	{
-		safe_release( (IUnknown **)&ps );
 		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		return handle;
 	}
+	store->buffers[dense] = buffers;
+
+	IUnknown **objects[R_BIND_GROUP_MAX_OBJECTS];
+	uint32_t   count = r_bind_group_objects( store, dense, objects );
+	for ( uint32_t n = 0; n < count; ++n )
+		( *objects[n] )->lpVtbl->AddRef( *objects[n] );
 
-	s->ps      = ps;
 	*outResult = R_OK;
-	return s;
+	return handle;
 }
 
-R_VertexShader *r_create_vertex_shader_from_source( R_Context  *ctx,
-                                                    const char *src,
-                                                    const char *entry,
-                                                    const char *profile,
-                                                    R_Result   *outResult )
+void r_destroy_bind_group( R_Context *ctx, R_BindGroup group )
 {
-	R_Result localResult = R_OK;
-	if ( !outResult )
-		outResult = &localResult;
+	if ( !ctx )
+		return;
+	R_ASSERT_OWNER( ctx );
 
-	if ( !ctx || !src )
-	{
-		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
-	}
+	R_BindGroupStore *store = &ctx->bindGroups;
+	if ( !r_bind_group_set_release( &store->set, group.id ) )
+		return;
 
-	ID3DBlob *blob = compile_hlsl( src, entry, profile );
-	if ( !blob )
+	// Draws already recorded may still read through the group's objects.
+	IUnknown **objects[R_BIND_GROUP_MAX_OBJECTS];
+	uint32_t   count = r_bind_group_objects( store, r_pool_lookup( &store->set.pool, group.id ), objects );
+	for ( uint32_t n = 0; n < count; ++n )
+		r_defer_release_object( ctx, objects[n] );
+
+	uint32_t dense, moved;
+	r_bind_group_set_remove( &store->set, group.id, &dense, &moved );
+	store->buffers[dense] = store->buffers[moved];
+}
+
+// One call per run of adjacent slots in mask, objects indexed by slot.
+static void r_bind_slot_runs( ID3D11DeviceContext *c,
+                              R_BindKind           kind,
+                              R_ShaderStage        stage,
+                              uint32_t             mask,
+                              void               **objects )
+{
+	for ( UINT slot = 0; mask >> slot; )
 	{
-		*outResult = R_ERROR_SHADER_COMPILATION_FAILED;
-		return NULL;
-	}
+		if ( !( mask & ( 1u << slot ) ) )
+		{
+			++slot;
+			continue;
+		}
 
-	void  *pShaderBytecode = blob->lpVtbl->GetBufferPointer( blob );
-	size_t byteCodeLength  = blob->lpVtbl->GetBufferSize( blob );
+		UINT first = slot;
+		while ( mask & ( 1u << slot ) )
+			++slot;
 
-	R_VertexShader *shader = r_create_vertex_shader_from_bytecode( ctx, pShaderBytecode, byteCodeLength, outResult );
-	blob->lpVtbl->Release( blob );
+		UINT  count = slot - first;
+		void *run   = &objects[first];
+		switch ( kind * R_STAGE_COUNT + stage )
+		{
+		case R_BIND_CONSTANTS * R_STAGE_COUNT + R_STAGE_VERTEX:
+			c->lpVtbl->VSSetConstantBuffers( c, first, count, (ID3D11Buffer *const *)run );
+			break;
+		case R_BIND_CONSTANTS * R_STAGE_COUNT + R_STAGE_PIXEL:
+			c->lpVtbl->PSSetConstantBuffers( c, first, count, (ID3D11Buffer *const *)run );
+			break;
+		case R_BIND_TEXTURES * R_STAGE_COUNT + R_STAGE_VERTEX:
+			c->lpVtbl->VSSetShaderResources( c, first, count, (ID3D11ShaderResourceView *const *)run );
+			break;
+		case R_BIND_TEXTURES * R_STAGE_COUNT + R_STAGE_PIXEL:
+			c->lpVtbl->PSSetShaderResources( c, first, count, (ID3D11ShaderResourceView *const *)run );
+			break;
+		case R_BIND_SAMPLERS * R_STAGE_COUNT + R_STAGE_VERTEX:
+			c->lpVtbl->VSSetSamplers( c, first, count, (ID3D11SamplerState *const *)run );
+			break;
+		case R_BIND_SAMPLERS * R_STAGE_COUNT + R_STAGE_PIXEL:
+			c->lpVtbl->PSSetSamplers( c, first, count, (ID3D11SamplerState *const *)run );
+			break;
+		default:
+			break;
+		}
+	}
+}
 
-	return shader;
+// Captures only know constant buffers bound to both stages and texture slots of the pixel shader,
+// a group is recorded as the closest sequence of those.
+static void r_capture_bind_group( R_Context *ctx, uint32_t i )
+{
+	const R_BindGroupSlots *slots     = &ctx->bindGroups.set.slots[i];
+	const R_BindGroupDesc  *desc      = (const R_BindGroupDesc *)r_bind_group_set_desc( &ctx->bindGroups.set, i );
+	uint32_t                constants = slots->masks[R_BIND_CONSTANTS][R_STAGE_VERTEX] |
+	                     slots->masks[R_BIND_CONSTANTS][R_STAGE_PIXEL];
+	for ( uint32_t slot = 0; slot < R_MAX_CONSTANT_BUFFER_SLOTS; ++slot )
+	{
+		if ( !( constants & ( 1u << slot ) ) )
+			continue;
+		R_Buffer      buf  = desc->constants[R_STAGE_VERTEX][slot];
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_CONSTANT_BUFFER, .args = { slot } };
+		call.id            = buf.id ? buf.id : desc->constants[R_STAGE_PIXEL][slot].id;
+		r_capture_write( &ctx->capture, &call );
+	}
+	for ( uint32_t slot = 0; slot < R_BIND_GROUP_TEXTURE_SLOTS; ++slot )
+	{
+		if ( !( slots->masks[R_BIND_TEXTURES][R_STAGE_PIXEL] & ( 1u << slot ) ) )
+			continue;
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_TEXTURE, .args = { slot, 1 } };
+		r_capture_write( &ctx->capture, &call );
+	}
 }
 
-R_PixelShader *r_create_pixel_shader_from_source( R_Context  *ctx,
-                                                  const char *src,
-                                                  const char *entry,
-                                                  const char *profile,
-                                                  R_Result   *outResult )
+void r_bind_group( R_Context *ctx, R_BindGroup group, uint32_t index )
 {
-	R_Result localResult = R_OK;
-	if ( !outResult )
-		outResult = &localResult;
+	if ( !ctx || index >= R_BIND_GROUP_INDICES )
+		return;
 
-	if ( !ctx || !src )
+	R_BindGroupStore *store = &ctx->bindGroups;
+	uint32_t          i     = r_pool_lookup( &store->set.pool, group.id );
+	if ( i != R_POOL_INVALID && ctx->capturing )
+		r_capture_bind_group( ctx, i );
+	if ( i == R_POOL_INVALID || !r_bound_groups_bind( &ctx->boundGroups, index, group.id, &store->set.slots[i] ) )
+		return;
+
+	const R_BindGroupSlots *slots = &store->set.slots[i];
+	R_BindGroupDesc        *desc  = (R_BindGroupDesc *)r_bind_group_set_desc( &store->set, i );
+	for ( int kind = 0; kind < R_BIND_KIND_COUNT; ++kind )
 	{
-		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		for ( int stage = 0; stage < R_STAGE_COUNT; ++stage )
+		{
+			uint32_t mask = slots->masks[kind][stage];
+			if ( !mask )
+				continue;
+
+			void **objects = kind == R_BIND_CONSTANTS  ? (void **)store->buffers[i].buffers[stage]
+			                 : kind == R_BIND_TEXTURES ? (void **)desc->textures[stage]
+			                                           : (void **)desc->samplers[stage];
+			r_bind_slot_runs( ctx->ctx, (R_BindKind)kind, (R_ShaderStage)stage, mask, objects );
+		}
 	}
 
-	ID3DBlob *blob = compile_hlsl( src, entry, profile );
-	if ( !blob )
+	// The runs went around the state cache, which no longer knows what those slots hold.
+	for ( int stage = 0; stage < R_STAGE_COUNT; ++stage )
 	{
-		*outResult = R_ERROR_SHADER_COMPILATION_FAILED;
-		return NULL;
+		R_ShaderStage s = (R_ShaderStage)stage;
+		r_state_cache_forget_constant_buffers( &ctx->state, s, slots->masks[R_BIND_CONSTANTS][stage] );
+		r_state_cache_forget_textures( &ctx->state, s, slots->masks[R_BIND_TEXTURES][stage] );
+		r_state_cache_forget_samplers( &ctx->state, s, slots->masks[R_BIND_SAMPLERS][stage] );
 	}
+}
 
-	const void *pShaderBytecode = blob->lpVtbl->GetBufferPointer( blob );
-	size_t      byteCodeLength  = blob->lpVtbl->GetBufferSize( blob );
-
-	R_PixelShader *shader = r_create_pixel_shader_from_bytecode( ctx, pShaderBytecode, byteCodeLength, outResult );
-	blob->lpVtbl->Release( blob );
+void r_set_vertex_buffer( R_Context *ctx, R_Buffer vb, UINT stride, UINT offset )
+{
+	if ( !ctx )
+		return;
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_SET_VERTEX_BUFFER, .id = vb.id, .args = { stride, offset } };
+		r_capture_write( &ctx->capture, &call );
+	}
 
-	return shader;
+	ID3D11Buffer *b = r_buffer_get( ctx, vb );
+	if ( !r_state_cache_set_vertex_buffer( &ctx->state, 0, b, stride, offset ) )
+		return;
+	ctx->ctx->lpVtbl->IASetVertexBuffers( ctx->ctx, 0, 1, &b, &stride, &offset );
 }
 
-const void *r_vertex_shader_get_bytecode( const R_VertexShader *shader, size_t *outSize )
+void r_set_index_buffer( R_Context *ctx, R_Buffer ib, DXGI_FORMAT fmt, UINT offset )
 {
-	if ( !shader )
-		return NULL;
+	if ( !ctx )
+		return;
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_SET_INDEX_BUFFER, .id = ib.id, .args = { (uint32_t)fmt, offset } };
+		r_capture_write( &ctx->capture, &call );
+	}
 
-	if ( outSize )
-		*outSize = shader->bytecodeSize;
-	return shader->bytecode;
+	ID3D11Buffer *b = r_buffer_get( ctx, ib );
+	if ( !r_state_cache_set_index_buffer( &ctx->state, b, (uint32_t)fmt, offset ) )
+		return;
+	ctx->ctx->lpVtbl->IASetIndexBuffer( ctx->ctx, b, fmt, offset );
 }
 
-void r_destroy_vertex_shader( R_VertexShader *sh )
+void r_set_primitive_topology( R_Context *ctx, D3D11_PRIMITIVE_TOPOLOGY prim )
 {
-	if ( !sh )
+	if ( !ctx )
 		return;
-	safe_release( (IUnknown **)&sh->vs );
-	if ( sh->bytecode )
-		free( sh->bytecode );
-	free( sh );
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_SET_TOPOLOGY, .args = { (uint32_t)prim } };
+		r_capture_write( &ctx->capture, &call );
+	}
+	if ( !r_state_cache_set_topology( &ctx->state, (uint32_t)prim ) )
+		return;
+	ctx->ctx->lpVtbl->IASetPrimitiveTopology( ctx->ctx, prim );
 }
 
-void r_destroy_pixel_shader( R_PixelShader *sh )
+void r_draw( R_Context *ctx, UINT vertexCount, UINT startVertex )
 {
-	if ( !sh )
+	if ( !ctx )
 		return;
-	safe_release( (IUnknown **)&sh->ps );
-	free( sh );
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DRAW, .args = { vertexCount, startVertex } };
+		r_capture_write( &ctx->capture, &call );
+	}
+	r_unmap_constant_ring( ctx );
+	ctx->ctx->lpVtbl->Draw( ctx->ctx, vertexCount, startVertex );
 }
 
-R_InputLayout *r_create_input_layout( R_Context                      *ctx,
-                                      const D3D11_INPUT_ELEMENT_DESC *desc,
-                                      UINT                            numDesc,
-                                      const R_VertexShader           *vs,
-                                      R_Result                       *outResult )
+void r_draw_indexed( R_Context *ctx, UINT indexCount, UINT startIndex, INT baseVertex )
 {
-	R_Result localResult = R_OK;
-	if ( !outResult )
-		outResult = &localResult;
+	if ( !ctx )
+		return;
+	if ( ctx->capturing )
+	{
+		R_CaptureCall call = { .op = R_CAPTURE_DRAW_INDEXED, .args = { indexCount, startIndex, (uint32_t)baseVertex } };
+		r_capture_write( &ctx->capture, &call );
+	}
+	r_unmap_constant_ring( ctx );
+	ctx->ctx->lpVtbl->DrawIndexed( ctx->ctx, indexCount, startIndex, baseVertex );
+}
 
-	if ( !ctx || !desc || !vs )
+void r_draw_indexed_instanced( R_Context *ctx,
+                               UINT       indexCount,
+                               UINT       instanceCount,
+                               UINT       startIndex,
+                               INT        baseVertex,
+                               UINT       startInstance )
+{
+	if ( !ctx )
+		return;
+	if ( ctx->capturing )
 	{
-		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		R_CaptureCall call = { .op   = R_CAPTURE_DRAW_INDEXED_INSTANCED,
+		                       .args = { indexCount, instanceCount, startIndex, (uint32_t)baseVertex, startInstance } };
+		r_capture_write( &ctx->capture, &call );
 	}
+	r_unmap_constant_ring( ctx );
+	ID3D11DeviceContext *c = ctx->ctx;
+	c->lpVtbl->DrawIndexedInstanced( c, indexCount, instanceCount, startIndex, baseVertex, startInstance );
+}
 
-	size_t      blobSize = 0;
-	const void *vsBlob   = r_vertex_shader_get_bytecode( vs, &blobSize );
+// Appends with NO_OVERWRITE and discards the buffer when the data doesn't fit behind the head anymore,
+// so the driver renames it instead of stalling on draws still reading the old contents.
+static bool r_stream_write( R_Context      *ctx,
+                            R_StreamBuffer *stream,
+                            UINT            size,
+                            const void     *data,
+                            size_t          bytes,
+                            size_t          alignment,
+                            UINT           *outOffset )
+{
+	if ( bytes > size )
+		return false;
 
-	ID3D11InputLayout *layout = NULL;
-	HRESULT hr = ctx->device->lpVtbl->CreateInputLayout( ctx->device, desc, numDesc, vsBlob, blobSize, &layout );
-	if ( FAILED( hr ) )
+	if ( !stream->buffer )
 	{
-		*outResult = R_ERROR_INPUT_LAYOUT_FAILED;
-		return NULL;
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof( bd ) );
+		bd.ByteWidth      = size;
+		bd.Usage          = D3D11_USAGE_DYNAMIC;
+		bd.BindFlags      = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		if ( FAILED( ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, NULL, &stream->buffer ) ) )
+			return false;
+		stream->head = size;
 	}
 
-	R_InputLayout *l = (R_InputLayout *)malloc( sizeof( R_InputLayout ) );
-	if ( !l )
+	size_t    offset  = ( stream->head + alignment - 1 ) / alignment * alignment;
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if ( offset + bytes > size )
 	{
-		safe_release( (IUnknown **)&layout );
-		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		offset  = 0;
+		mapType = D3D11_MAP_WRITE_DISCARD;
 	}
 
-	l->layout   = layout;
-	l->refCount = 1;
-	*outResult  = R_OK;
-	return l;
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if ( FAILED( ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)stream->buffer, 0, mapType, 0, &mapped ) ) )
+		return false;
+	memcpy( (uint8_t *)mapped.pData + offset, data, bytes );
+	ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)stream->buffer, 0 );
+
+	stream->head = offset + bytes;
+	*outOffset   = (UINT)offset;
+	return true;
 }
 
-void r_destroy_input_layout( R_InputLayout *layout )
+// Stream writes are captured with the offset they landed at, the draws that follow depend on it.
+static void r_capture_stream( R_Context  *ctx,
+                              UINT        slot,
+                              UINT        stride,
+                              UINT        offset,
+                              bool        boundAtOffset,
+                              const void *data,
+                              size_t      bytes )
 {
-	if ( !layout )
-		return;
+	R_CaptureCall call = { .op   = R_CAPTURE_STREAM_VERTICES,
+	                       .args = { slot, stride, offset, boundAtOffset },
+	                       .data = data,
+	                       .size = (uint32_t)bytes };
+	r_capture_write( &ctx->capture, &call );
+}
+
+uint32_t r_submit_instanced( R_Context *ctx, R_InstanceBatcher *batcher )
+{
+	if ( !ctx || !batcher || batcher->count == 0 )
+		return 0;
+
+	uint32_t stride = batcher->instanceStride;
+	uint32_t runs   = r_instance_batcher_build( batcher, R_INSTANCE_STREAM_SIZE / stride );
 
-	layout->refCount--;
-	if ( layout->refCount == 0 )
+	// Runs are contiguous in the instance data, every span of them that fits the stream is one write.
+	for ( uint32_t first = 0; first < runs; )
 	{
-		safe_release( (IUnknown **)&layout->layout );
-		free( layout );
+		uint32_t start = batcher->runs[first].first;
+		uint32_t last  = first;
+		while ( last + 1 < runs &&
+		        (size_t)( batcher->runs[last + 1].first + batcher->runs[last + 1].count - start ) * stride <=
+		            R_INSTANCE_STREAM_SIZE )
+			last++;
+
+		const R_InstanceRun *end   = &batcher->runs[last];
+		size_t               bytes = (size_t)( end->first + end->count - start ) * stride;
+
+		UINT           offset;
+		const uint8_t *data = batcher->instances + (size_t)start * stride;
+		if ( !r_stream_write( ctx, &ctx->instanceStream, R_INSTANCE_STREAM_SIZE, data, bytes, 16, &offset ) )
+			return first;
+		if ( ctx->capturing )
+			r_capture_stream( ctx, R_INSTANCE_SLOT, stride, offset, true, data, bytes );
+
+		ID3D11Buffer *stream = ctx->instanceStream.buffer;
+		if ( r_state_cache_set_vertex_buffer( &ctx->state, R_INSTANCE_SLOT, stream, stride, offset ) )
+			ctx->ctx->lpVtbl->IASetVertexBuffers( ctx->ctx, R_INSTANCE_SLOT, 1, &stream, &stride, &offset );
+
+		for ( uint32_t r = first; r <= last; ++r )
+		{
+			const R_InstanceRun *run  = &batcher->runs[r];
+			const R_DrawPacket  *p    = &batcher->draws[run->first];
+			UINT                 base = run->first - start; // instance offset into this write
+
+			r_bind_pipeline( ctx, p->pipeline );
+			r_set_vertex_buffer( ctx, p->vertexBuffer, p->vertexStride, p->vertexOffset );
+			r_set_index_buffer( ctx, p->indexBuffer, (DXGI_FORMAT)p->indexFormat, 0 );
+			if ( p->constants.id )
+				r_bind_constant_buffer( ctx, p->constants, p->constantSlot );
+			r_draw_indexed_instanced( ctx, p->indexCount, run->count, p->startIndex, p->baseVertex, base );
+		}
+		first = last + 1;
 	}
+	return runs;
 }
 
-R_Pipeline *
-r_create_pipeline( R_Context *ctx, R_VertexShader *vs, R_PixelShader *ps, R_InputLayout *layout, R_Result *outResult )
+static bool r_create_batch_indices( R_Context *ctx )
 {
-	R_Result localResult = R_OK;
-	if ( !outResult )
-		outResult = &localResult;
+	uint16_t *indices = (uint16_t *)malloc( R_BATCH2D_MAX_QUADS_PER_DRAW * 6 * sizeof( uint16_t ) );
+	if ( !indices )
+		return false;
 
-	if ( !ctx || !vs || !ps )
+	for ( uint32_t q = 0; q < R_BATCH2D_MAX_QUADS_PER_DRAW; ++q )
 	{
-		*outResult = R_ERROR_INVALID_PARAMETER;
-		return NULL;
+		uint16_t  v = (uint16_t)( q * 4 );
+		uint16_t *i = &indices[q * 6];
+		i[0]        = v;
+		i[1]        = v + 1;
+		i[2]        = v + 2;
+		i[3]        = v;
+		i[4]        = v + 2;
+		i[5]        = v + 3;
 	}
 
-	R_Pipeline *p = (R_Pipeline *)malloc( sizeof( R_Pipeline ) );
-	if ( !p )
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory( &bd, sizeof( bd ) );
+	bd.ByteWidth = R_BATCH2D_MAX_QUADS_PER_DRAW * 6 * sizeof( uint16_t );
+	bd.Usage     = D3D11_USAGE_IMMUTABLE;
+	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA init = { indices, 0, 0 };
+	HRESULT                hr   = ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, &init, &ctx->batchIndices );
+	free( indices );
+	return SUCCEEDED( hr );
+}
+
+uint32_t r_submit_batch2d( R_Context *ctx, R_Batch2D *batch )
+{
+	if ( !ctx || !batch || batch->quadCount == 0 )
+		return 0;
+	if ( !ctx->batchIndices && !r_create_batch_indices( ctx ) )
+		return 0;
+
+	ID3D11DeviceContext *c      = ctx->ctx;
+	const UINT           stride = sizeof( R_Batch2DVertex );
+	const size_t         quad   = 4 * sizeof( R_Batch2DVertex );
+
+	// Matches UiBatch_Transform: pixels to clip space for the current viewport.
+	float transform[4] = { 1.0f / ctx->vp.Width, 1.0f / ctx->vp.Height, 0.0f, 0.0f };
+	r_push_constants( ctx, transform, sizeof( transform ), 0 );
+	r_set_primitive_topology( ctx, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+	if ( r_state_cache_set_index_buffer( &ctx->state, ctx->batchIndices, DXGI_FORMAT_R16_UINT, 0 ) )
+		c->lpVtbl->IASetIndexBuffer( c, ctx->batchIndices, DXGI_FORMAT_R16_UINT, 0 );
+	if ( ctx->capturing )
 	{
-		*outResult = R_ERROR_OUT_OF_MEMORY;
-		return NULL;
+		R_CaptureCall call = { .op = R_CAPTURE_BIND_QUAD_INDICES };
+		r_capture_write( &ctx->capture, &call );
 	}
 
-	p->vs     = vs->vs;
-	p->ps     = ps->ps;
-	p->layout = layout;
+	D3D11_RECT full = { (LONG)ctx->vp.TopLeftX,
+	                    (LONG)ctx->vp.TopLeftY,
+	                    (LONG)( ctx->vp.TopLeftX + ctx->vp.Width ),
+	                    (LONG)( ctx->vp.TopLeftY + ctx->vp.Height ) };
+
+	uint32_t    draws      = 0;
+	bool        first      = true;
+	const void *texture    = NULL;
+	D3D11_RECT  scissor    = full;
+	bool        scissorSet = false;
+
+	for ( uint32_t begin = 0; begin < batch->commandCount; )
+	{
+		// Every span of commands whose quads fit the stream goes up with one write.
+		uint32_t firstQuad = batch->commands[begin].firstQuad;
+		uint32_t end       = begin + 1;
+		while ( end < batch->commandCount )
+		{
+			const R_Batch2DCommand *next = &batch->commands[end];
+			if ( (size_t)( next->firstQuad + next->quadCount - firstQuad ) * quad > R_BATCH2D_STREAM_SIZE )
+				break;
+			end++;
+		}
 
-	if ( p->vs )
-		p->vs->lpVtbl->AddRef( p->vs );
+		const R_Batch2DCommand *last  = &batch->commands[end - 1];
+		size_t                  bytes = (size_t)( last->firstQuad + last->quadCount - firstQuad ) * quad;
 
-	if ( p->ps )
-		p->ps->lpVtbl->AddRef( p->ps );
+		UINT offset;
+		if ( !r_stream_write( ctx,
+		                      &ctx->batchVertices,
+		                      R_BATCH2D_STREAM_SIZE,
+		                      &batch->vertices[(size_t)firstQuad * 4],
+		                      bytes,
+		                      stride,
+		                      &offset ) )
+			return draws;
+		if ( ctx->capturing )
+			r_capture_stream( ctx, 0, stride, offset, false, &batch->vertices[(size_t)firstQuad * 4], bytes );
 
-	if ( p->layout )
-		p->layout->refCount++;
+		// Bound at offset 0, the draws reach their quads through the base vertex.
+		ID3D11Buffer *vb   = ctx->batchVertices.buffer;
+		UINT          zero = 0;
+		if ( r_state_cache_set_vertex_buffer( &ctx->state, 0, vb, stride, 0 ) )
+			c->lpVtbl->IASetVertexBuffers( c, 0, 1, &vb, &stride, &zero );
 
-	*outResult = R_OK;
-	return p;
+		for ( uint32_t i = begin; i < end; ++i )
+		{
+			const R_Batch2DCommand *command = &batch->commands[i];
+			if ( command->quadCount == 0 )
+				continue;
+
+			r_bind_pipeline( ctx, command->pipeline );
+
+			if ( first || command->texture != texture )
+			{
+				ID3D11ShaderResourceView *srv = (ID3D11ShaderResourceView *)command->texture;
+				if ( r_state_cache_set_texture( &ctx->state, R_STAGE_PIXEL, 0, srv ) )
+					c->lpVtbl->PSSetShaderResources( c, 0, 1, &srv );
+				r_bound_groups_forget( &ctx->boundGroups, R_BIND_TEXTURES, R_STAGE_PIXEL, 1u );
+				texture = command->texture;
+				if ( ctx->capturing )
+				{
+					R_CaptureCall call = { .op = R_CAPTURE_BIND_TEXTURE, .args = { 0, srv != NULL } };
+					r_capture_write( &ctx->capture, &call );
+				}
+			}
+
+			D3D11_RECT rect = full;
+			if ( command->scissorEnabled )
+			{
+				rect.left   = command->scissor.x;
+				rect.top    = command->scissor.y;
+				rect.right  = command->scissor.x + command->scissor.width;
+				rect.bottom = command->scissor.y + command->scissor.height;
+			}
+			if ( !scissorSet || memcmp( &rect, &scissor, sizeof( rect ) ) != 0 )
+			{
+				c->lpVtbl->RSSetScissorRects( c, 1, &rect );
+				scissor    = rect;
+				scissorSet = true;
+				if ( ctx->capturing )
+				{
+					R_CaptureCall call = { .op   = R_CAPTURE_SET_SCISSOR,
+					                       .args = { (uint32_t)rect.left,
+					                                 (uint32_t)rect.top,
+					                                 (uint32_t)rect.right,
+					                                 (uint32_t)rect.bottom } };
+					r_capture_write( &ctx->capture, &call );
+				}
+			}
+
+			INT baseVertex = (INT)( offset / stride + ( command->firstQuad - firstQuad ) * 4 );
+			r_draw_indexed( ctx, command->quadCount * 6, 0, baseVertex );
+			first = false;
+			draws++;
+		}
+		begin = end;
+	}
+	return draws;
 }
 
-void r_bind_pipeline( R_Context *ctx, R_Pipeline *pipe )
+void r_submit_draw_queue( R_Context *ctx, R_DrawQueue *queue )
 {
-	if ( !ctx )
+	if ( !ctx || !queue )
 		return;
+	R_ASSERT_OWNER( ctx );
 
-	if ( ctx->lastPipeline == pipe )
-		return;
+	r_draw_queue_sort( queue );
 
-	if ( pipe )
-	{
-		ctx->ctx->lpVtbl->IASetInputLayout( ctx->ctx, pipe->layout ? pipe->layout->layout : NULL );
-		ctx->ctx->lpVtbl->VSSetShader( ctx->ctx, pipe->vs, NULL, 0 );
-		ctx->ctx->lpVtbl->PSSetShader( ctx->ctx, pipe->ps, NULL, 0 );
-	}
-	else
+	// Redundant binds between neighbouring packets are dropped by the state cache.
+	for ( size_t i = 0; i < queue->count; ++i )
 	{
-		ctx->ctx->lpVtbl->IASetInputLayout( ctx->ctx, NULL );
-		ctx->ctx->lpVtbl->VSSetShader( ctx->ctx, NULL, NULL, 0 );
-		ctx->ctx->lpVtbl->PSSetShader( ctx->ctx, NULL, NULL, 0 );
+		const R_DrawPacket *p = r_draw_queue_get( queue, i );
+
+		r_bind_pipeline( ctx, p->pipeline );
+		r_set_vertex_buffer( ctx, p->vertexBuffer, p->vertexStride, p->vertexOffset );
+		r_set_index_buffer( ctx, p->indexBuffer, (DXGI_FORMAT)p->indexFormat, 0 );
+		if ( p->constants.id )
+			r_bind_constant_buffer( ctx, p->constants, p->constantSlot );
+		r_draw_indexed( ctx, p->indexCount, p->startIndex, p->baseVertex );
 	}
-	ctx->lastPipeline = pipe;
 }
 
-void r_destroy_pipeline( R_Pipeline *pipe )
+// Bit per R_StateObject a bundle's pipeline command changes relative to the one before it.
+static uint32_t r_pipeline_objects_diff( const R_PipelineObjects *a, const R_PipelineObjects *b )
 {
-	if ( !pipe )
-		return;
+	uint32_t mask = 0;
+	if ( a->layout != b->layout )
+		mask |= 1u << R_STATE_OBJECT_INPUT_LAYOUT;
+	if ( a->vs != b->vs )
+		mask |= 1u << R_STATE_OBJECT_VERTEX_SHADER;
+	if ( a->ps != b->ps )
+		mask |= 1u << R_STATE_OBJECT_PIXEL_SHADER;
+	if ( a->rasterizer != b->rasterizer )
+		mask |= 1u << R_STATE_OBJECT_RASTERIZER;
+	if ( a->blend != b->blend || a->sampleMask != b->sampleMask ||
+	     memcmp( a->blendFactor, b->blendFactor, 4 * sizeof( float ) ) != 0 )
+		mask |= 1u << R_STATE_OBJECT_BLEND;
+	if ( a->depthStencil != b->depthStencil || a->stencilRef != b->stencilRef )
+		mask |= 1u << R_STATE_OBJECT_DEPTH_STENCIL;
+	return mask;
+}
+
+// Turns the bundle's handles into the objects they stand for, false when one of them is gone.
+static bool r_resolve_bundle( R_Context *ctx, R_Bundle *bundle )
+{
+	R_PipelineObjects prev, cur;
+	bool              first = true;
+
+	bundle->valid = false;
+	for ( uint32_t n = 0; n < bundle->commandCount; ++n )
+	{
+		R_BundleCommand *cmd = &bundle->commands[n];
+		if ( cmd->type == R_BUNDLE_CMD_DRAW_INDEXED )
+			continue;
+
+		if ( cmd->type == R_BUNDLE_CMD_PIPELINE )
+		{
+			if ( cmd->handle && !r_pool_is_valid( &ctx->pipelines.pool, cmd->handle ) )
+				return false;
 
-	safe_release( (IUnknown **)&pipe->vs );
-	safe_release( (IUnknown **)&pipe->ps );
+			// object is the pipeline identity the state cache sees, resolved the index to read it from.
+			R_Pipeline pipe = { cmd->handle };
+			cmd->resolved   = r_pipeline_bound_index( ctx, &pipe );
+			cmd->object     = (const void *)(uintptr_t)pipe.id;
+			r_get_pipeline_objects( ctx, cmd->resolved, &cur );
+			cmd->flags = first ? ( 1u << R_STATE_OBJECT_COUNT ) - 1 : r_pipeline_objects_diff( &prev, &cur );
+			prev       = cur;
+			first      = false;
+			continue;
+		}
 
-	if ( pipe->layout )
-		r_destroy_input_layout( pipe->layout );
+		if ( cmd->handle && !r_pool_is_valid( &ctx->buffers.pool, cmd->handle ) )
+			return false;
+		cmd->object = r_buffer_get( ctx, ( R_Buffer ){ cmd->handle } );
+	}
 
-	free( pipe );
+	bundle->epoch = ctx->resourceEpoch;
+	bundle->valid = true;
+	return true;
 }
 
-void r_set_vertex_buffer( R_Context *ctx, R_Buffer *vb, UINT stride, UINT offset )
+// Leaves the state cache with what the bundle bound last, so the calls after it are filtered as usual.
+static void r_sync_bundle_state( R_Context             *ctx,
+                                 const R_BundleCommand *pipeline,
+                                 const R_BundleCommand *vertices,
+                                 const R_BundleCommand *indices,
+                                 const R_BundleCommand *constants[R_MAX_CONSTANT_BUFFER_SLOTS] )
 {
-	if ( !ctx )
-		return;
-	ID3D11Buffer *b = vb ? vb->buf : NULL;
-	ctx->ctx->lpVtbl->IASetVertexBuffers( ctx->ctx, 0, 1, &b, &stride, &offset );
+	R_StateCache *cache = &ctx->state;
+	if ( pipeline )
+	{
+		R_PipelineObjects o;
+		r_get_pipeline_objects( ctx, pipeline->resolved, &o );
+		r_state_cache_set_pipeline( cache, pipeline->object );
+		r_state_cache_set_object( cache, R_STATE_OBJECT_INPUT_LAYOUT, o.layout );
+		r_state_cache_set_object( cache, R_STATE_OBJECT_VERTEX_SHADER, o.vs );
+		r_state_cache_set_object( cache, R_STATE_OBJECT_PIXEL_SHADER, o.ps );
+		r_state_cache_set_object( cache, R_STATE_OBJECT_RASTERIZER, o.rasterizer );
+		r_state_cache_set_blend( cache, o.blend, o.blendFactor, o.sampleMask );
+		r_state_cache_set_depth_stencil( cache, o.depthStencil, o.stencilRef );
+	}
+	if ( vertices )
+		r_state_cache_set_vertex_buffer( cache, 0, vertices->object, vertices->args[0], vertices->args[1] );
+	if ( indices )
+		r_state_cache_set_index_buffer( cache, indices->object, indices->args[0], 0 );
+	for ( int slot = 0; slot < R_MAX_CONSTANT_BUFFER_SLOTS; ++slot )
+	{
+		if ( !constants[slot] )
+			continue;
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_CONSTANTS, R_STAGE_VERTEX, 1u << slot );
+		r_bound_groups_forget( &ctx->boundGroups, R_BIND_CONSTANTS, R_STAGE_PIXEL, 1u << slot );
+		r_state_cache_set_constant_buffer( cache, R_STAGE_VERTEX, slot, constants[slot]->object );
+		r_state_cache_set_constant_buffer( cache, R_STAGE_PIXEL, slot, constants[slot]->object );
+	}
 }
 
-void r_set_index_buffer( R_Context *ctx, R_Buffer *ib, DXGI_FORMAT fmt, UINT offset )
+bool r_execute_bundle( R_Context *ctx, R_Bundle *bundle )
 {
-	if ( !ctx )
-		return;
-	ctx->ctx->lpVtbl->IASetIndexBuffer( ctx->ctx, ib ? ib->buf : NULL, fmt, offset );
+	if ( !ctx || !bundle || ( !bundle->built && !r_bundle_build( bundle ) ) )
+		return false;
+	R_ASSERT_OWNER( ctx );
+	if ( bundle->epoch != ctx->resourceEpoch && !r_resolve_bundle( ctx, bundle ) )
+		return false;
+
+	// Captures need every call, the packets go through the regular path in the same order.
+	if ( ctx->capturing )
+	{
+		r_submit_draw_queue( ctx, &bundle->queue );
+		return true;
+	}
+
+	r_unmap_constant_ring( ctx );
+
+	// The last command of each kind, what the state cache is told about afterwards.
+	ID3D11DeviceContext   *c        = ctx->ctx;
+	const R_BundleCommand *pipeline = NULL;
+	const R_BundleCommand *vertices = NULL;
+	const R_BundleCommand *indices  = NULL;
+	const R_BundleCommand *constants[R_MAX_CONSTANT_BUFFER_SLOTS] = { 0 };
+
+	for ( uint32_t n = 0; n < bundle->commandCount; ++n )
+	{
+		const R_BundleCommand *cmd = &bundle->commands[n];
+		switch ( cmd->type )
+		{
+		case R_BUNDLE_CMD_DRAW_INDEXED:
+			c->lpVtbl->DrawIndexed( c, cmd->args[0], cmd->args[1], (INT)cmd->args[2] );
+			break;
+		case R_BUNDLE_CMD_PIPELINE:
+		{
+			R_PipelineObjects o;
+			r_get_pipeline_objects( ctx, cmd->resolved, &o );
+			if ( cmd->flags & ( 1u << R_STATE_OBJECT_INPUT_LAYOUT ) )
+				c->lpVtbl->IASetInputLayout( c, o.layout );
+			if ( cmd->flags & ( 1u << R_STATE_OBJECT_VERTEX_SHADER ) )
+				c->lpVtbl->VSSetShader( c, o.vs, NULL, 0 );
+			if ( cmd->flags & ( 1u << R_STATE_OBJECT_PIXEL_SHADER ) )
+				c->lpVtbl->PSSetShader( c, o.ps, NULL, 0 );
+			if ( cmd->flags & ( 1u << R_STATE_OBJECT_RASTERIZER ) )
+				c->lpVtbl->RSSetState( c, o.rasterizer );
+			if ( cmd->flags & ( 1u << R_STATE_OBJECT_BLEND ) )
+				c->lpVtbl->OMSetBlendState( c, o.blend, o.blendFactor, o.sampleMask );
+			if ( cmd->flags & ( 1u << R_STATE_OBJECT_DEPTH_STENCIL ) )
+				c->lpVtbl->OMSetDepthStencilState( c, o.depthStencil, o.stencilRef );
+			pipeline = cmd;
+			break;
+		}
+		case R_BUNDLE_CMD_VERTEX_BUFFER:
+		{
+			ID3D11Buffer *b = (ID3D11Buffer *)cmd->object;
+			c->lpVtbl->IASetVertexBuffers( c, 0, 1, &b, &cmd->args[0], &cmd->args[1] );
+			vertices = cmd;
+			break;
+		}
+		case R_BUNDLE_CMD_INDEX_BUFFER:
+			c->lpVtbl->IASetIndexBuffer( c, (ID3D11Buffer *)cmd->object, (DXGI_FORMAT)cmd->args[0], 0 );
+			indices = cmd;
+			break;
+		case R_BUNDLE_CMD_CONSTANT_BUFFER:
+		{
+			ID3D11Buffer *b = (ID3D11Buffer *)cmd->object;
+			c->lpVtbl->VSSetConstantBuffers( c, cmd->args[0], 1, &b );
+			c->lpVtbl->PSSetConstantBuffers( c, cmd->args[0], 1, &b );
+			constants[cmd->args[0]] = cmd;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	r_sync_bundle_state( ctx, pipeline, vertices, indices, constants );
+	return true;
 }
 
-void r_set_primitive_topology( R_Context *ctx, D3D11_PRIMITIVE_TOPOLOGY prim )
+void r_get_state_stats( R_Context *ctx, R_StateStats *outStats )
 {
-	if ( !ctx )
+	if ( !ctx || !outStats )
 		return;
-	ctx->ctx->lpVtbl->IASetPrimitiveTopology( ctx->ctx, prim );
+	*outStats = ctx->state.stats;
 }
 
-void r_draw( R_Context *ctx, UINT vertexCount, UINT startVertex )
+void r_reset_state_stats( R_Context *ctx )
 {
 	if ( !ctx )
 		return;
-	ctx->ctx->lpVtbl->Draw( ctx->ctx, vertexCount, startVertex );
+	r_state_cache_reset_stats( &ctx->state );
 }
 
-void r_draw_indexed( R_Context *ctx, UINT indexCount, UINT startIndex, INT baseVertex )
+void r_invalidate_state_cache( R_Context *ctx )
 {
 	if ( !ctx )
 		return;
-	ctx->ctx->lpVtbl->DrawIndexed( ctx->ctx, indexCount, startIndex, baseVertex );
+	r_state_cache_invalidate( &ctx->state );
+	r_bound_groups_reset( &ctx->boundGroups );
 }
 
 ID3D11Device *r_get_device( R_Context *ctx )
@@ -0,0 +1,202 @@
+//
+// Replay target for the D3D11 backend, so captures can be timed against the
+// driver too. Unity-built after r_d3d11.c, it reaches into R_Context for the
+// state the public API doesn't expose (vertex streams, quad indices, scissor).
+// Textures aren't in captures: texture binds bind nothing.
+//
+
+#include "../../common/r_replay.h"
+
+// Writes where the capture says the data landed; the draws that follow were recorded against that offset.
+static void r_replay_stream( R_Context *ctx, const R_CaptureCall *call )
+{
+	UINT            slot   = call->args[0];
+	UINT            stride = call->args[1];
+	UINT            offset = call->args[2];
+	R_StreamBuffer *stream = slot == R_INSTANCE_SLOT ? &ctx->instanceStream : &ctx->batchVertices;
+	UINT            size   = slot == R_INSTANCE_SLOT ? R_INSTANCE_STREAM_SIZE : R_BATCH2D_STREAM_SIZE;
+	if ( slot >= R_MAX_VERTEX_BUFFER_SLOTS || offset > size || call->size > size - offset )
+		return;
+
+	if ( !stream->buffer )
+	{
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof( bd ) );
+		bd.ByteWidth      = size;
+		bd.Usage          = D3D11_USAGE_DYNAMIC;
+		bd.BindFlags      = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		if ( FAILED( ctx->device->lpVtbl->CreateBuffer( ctx->device, &bd, NULL, &stream->buffer ) ) )
+			return;
+		stream->head = size;
+	}
+
+	// Behind the head means the original stream wrapped around, and discarded.
+	D3D11_MAP                mapType = offset < stream->head ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if ( FAILED( ctx->ctx->lpVtbl->Map( ctx->ctx, (ID3D11Resource *)stream->buffer, 0, mapType, 0, &mapped ) ) )
+		return;
+	memcpy( (uint8_t *)mapped.pData + offset, call->data, call->size );
+	ctx->ctx->lpVtbl->Unmap( ctx->ctx, (ID3D11Resource *)stream->buffer, 0 );
+	stream->head = offset + call->size;
+
+	ID3D11Buffer *vb    = stream->buffer;
+	UINT          bound = call->args[3] ? offset : 0;
+	if ( r_state_cache_set_vertex_buffer( &ctx->state, (int)slot, vb, stride, bound ) )
+		ctx->ctx->lpVtbl->IASetVertexBuffers( ctx->ctx, slot, 1, &vb, &stride, &bound );
+}
+
+static uint32_t r_replay_input_layout( R_Context *ctx, const R_CaptureCall *call )
+{
+	D3D11_INPUT_ELEMENT_DESC desc[R_CAPTURE_MAX_ELEMENTS];
+	r_input_elements_from_call( desc, call );
+
+	R_VertexShader vs = { call->refs[0] };
+	return r_create_input_layout( ctx, desc, call->elementCount, vs, NULL ).id;
+}
+
+static uint32_t r_replay_pipeline( R_Context *ctx, const R_CaptureCall *call )
+{
+	R_PipelineDesc desc;
+	R_VertexShader vs     = { call->refs[0] };
+	R_PixelShader  ps     = { call->refs[1] };
+	R_InputLayout  layout = { call->refs[2] };
+	r_pipeline_desc_init( &desc, vs, ps, layout );
+
+	// The blocks are this backend's own structs, a capture from another build layout is refused.
+	size_t         blend        = sizeof( desc.rasterizer );
+	size_t         depthStencil = blend + sizeof( desc.blend );
+	const uint8_t *blocks       = r_pipeline_call_blocks( call );
+	if ( !blocks )
+		return 0;
+
+	memcpy( &desc.rasterizer, blocks, sizeof( desc.rasterizer ) );
+	memcpy( &desc.blend, blocks + blend, sizeof( desc.blend ) );
+	memcpy( &desc.depthStencil, blocks + depthStencil, sizeof( desc.depthStencil ) );
+	memcpy( desc.blendFactor, call->floats, sizeof( desc.blendFactor ) );
+	desc.sampleMask  = call->args[3];
+	desc.stencilRef  = call->args[4];
+	desc.fallback.id = call->refs[3];
+	return r_create_pipeline( ctx, &desc, NULL ).id;
+}
+
+static uint32_t r_d3d11_replay_execute( void *self, const R_CaptureCall *call )
+{
+	R_Context           *ctx    = (R_Context *)self;
+	ID3D11DeviceContext *c      = ctx->ctx;
+	const uint32_t      *a      = call->args;
+	R_Buffer             buffer = { call->id };
+
+	switch ( call->op )
+	{
+	case R_CAPTURE_PRESENT:
+		r_present( ctx );
+		break;
+	case R_CAPTURE_CREATE_BUFFER:
+		return r_create_buffer( ctx, call->size ? call->data : NULL, a[2], a[0] != 0, a[1], NULL ).id;
+	case R_CAPTURE_UPDATE_BUFFER:
+		r_update_buffer( ctx, buffer, call->data, call->size );
+		break;
+	case R_CAPTURE_UPLOAD_BUFFER:
+		r_queue_buffer_upload( ctx, buffer, a[0], call->data, call->size, NULL, NULL );
+		break;
+	case R_CAPTURE_DESTROY_BUFFER:
+		r_destroy_buffer( ctx, buffer );
+		break;
+	case R_CAPTURE_BIND_CONSTANT_BUFFER:
+		r_bind_constant_buffer( ctx, buffer, (int)a[0] );
+		break;
+	case R_CAPTURE_PUSH_CONSTANTS:
+		r_push_constants( ctx, call->data, call->size, (int)a[0] );
+		break;
+	case R_CAPTURE_CREATE_VERTEX_SHADER:
+		return r_create_vertex_shader_from_bytecode( ctx, call->data, call->size, NULL ).id;
+	case R_CAPTURE_CREATE_PIXEL_SHADER:
+		return r_create_pixel_shader_from_bytecode( ctx, call->data, call->size, NULL ).id;
+	case R_CAPTURE_DESTROY_VERTEX_SHADER:
+		r_destroy_vertex_shader( ctx, ( R_VertexShader ){ call->id } );
+		break;
+	case R_CAPTURE_DESTROY_PIXEL_SHADER:
+		r_destroy_pixel_shader( ctx, ( R_PixelShader ){ call->id } );
+		break;
+	case R_CAPTURE_CREATE_INPUT_LAYOUT:
+		return r_replay_input_layout( ctx, call );
+	case R_CAPTURE_DESTROY_INPUT_LAYOUT:
+		r_destroy_input_layout( ctx, ( R_InputLayout ){ call->id } );
+		break;
+	case R_CAPTURE_CREATE_PIPELINE:
+		return r_replay_pipeline( ctx, call );
+	case R_CAPTURE_DESTROY_PIPELINE:
+		r_destroy_pipeline( ctx, ( R_Pipeline ){ call->id } );
+		break;
+	case R_CAPTURE_BIND_PIPELINE:
+		r_bind_pipeline( ctx, ( R_Pipeline ){ call->id } );
+		break;
+	case R_CAPTURE_SET_VERTEX_BUFFER:
+		r_set_vertex_buffer( ctx, buffer, a[0], a[1] );
+		break;
+	case R_CAPTURE_SET_INDEX_BUFFER:
+		r_set_index_buffer( ctx, buffer, (DXGI_FORMAT)a[0], a[1] );
+		break;
+	case R_CAPTURE_SET_TOPOLOGY:
+		r_set_primitive_topology( ctx, (D3D11_PRIMITIVE_TOPOLOGY)a[0] );
+		break;
+	case R_CAPTURE_SET_VIEWPORT:
+		r_set_viewport( ctx, call->floats[0], call->floats[1], call->floats[2], call->floats[3] );
+		break;
+	case R_CAPTURE_SET_SCISSOR:
+	{
+		D3D11_RECT rect = { (LONG)a[0], (LONG)a[1], (LONG)a[2], (LONG)a[3] };
+		c->lpVtbl->RSSetScissorRects( c, 1, &rect );
+		break;
+	}
+	case R_CAPTURE_BIND_TEXTURE:
+	{
+		ID3D11ShaderResourceView *srv = NULL;
+		c->lpVtbl->PSSetShaderResources( c, a[0], 1, &srv );
+		break;
+	}
+	case R_CAPTURE_STREAM_VERTICES:
+		r_replay_stream( ctx, call );
+		break;
+	case R_CAPTURE_BIND_QUAD_INDICES:
+		if ( !ctx->batchIndices && !r_create_batch_indices( ctx ) )
+			break;
+		if ( r_state_cache_set_index_buffer( &ctx->state, ctx->batchIndices, DXGI_FORMAT_R16_UINT, 0 ) )
+			c->lpVtbl->IASetIndexBuffer( c, ctx->batchIndices, DXGI_FORMAT_R16_UINT, 0 );
+		break;
+	case R_CAPTURE_DRAW:
+		r_draw( ctx, a[0], a[1] );
+		break;
+	case R_CAPTURE_DRAW_INDEXED:
+		r_draw_indexed( ctx, a[0], a[1], (INT)a[2] );
+		break;
+	case R_CAPTURE_DRAW_INDEXED_INSTANCED:
+		r_draw_indexed_instanced( ctx, a[0], a[1], a[2], (INT)a[3], a[4] );
+		break;
+	case R_CAPTURE_COPY_BUFFER:
+		r_copy_buffer_region( ctx, buffer, a[0], ( R_Buffer ){ call->refs[0] }, a[1], a[2] );
+		break;
+	case R_CAPTURE_CLEAR:
+		r_clear_render_target( ctx, call->floats[0], call->floats[1], call->floats[2], call->floats[3] );
+		break;
+	case R_CAPTURE_CREATE_SAMPLER:
+	{
+		D3D11_SAMPLER_DESC desc;
+		if ( call->size != sizeof( desc ) )
+			return 0;
+		memcpy( &desc, call->data, sizeof( desc ) );
+		return r_create_sampler( ctx, &desc, NULL ).id;
+	}
+	default:
+		break;
+	}
+	return 0;
+}
+
+// Replays against ctx: the frame draws into its back buffer and presents like any other.
+R_ReplayTarget r_d3d11_replay_target( R_Context *ctx )
+{
+	R_ReplayTarget target = { "d3d11", ctx, r_d3d11_replay_execute };
+	return target;
+}
@@ -6,17 +6,33 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "../common/r_handles.h"
+#include "../common/r_state_cache.h"
+#include "../common/r_draw_queue.h"
+#include "../common/r_upload.h"
+#include "../common/r_frame_graph.h"
+#include "../common/r_instancing.h"
+#include "../common/r_batch2d.h"
+#include "../common/r_release_queue.h"
+#include "../common/r_capture.h"
+#include "../common/r_bundle.h"
+#include "../common/r_bind_group.h"
+#include "../common/r_precache.h"
+#include "../common/r_frame_pipe.h"
+
+// Largest constant block a single r_push_constants call can bind (4096 float4 constants).
+#define R_MAX_PUSH_CONSTANT_BYTES 65536
+
+// Texture and sampler slots a bind group covers (R_BIND_GROUP_INDICES in r_bind_group.h).
+#define R_BIND_GROUP_TEXTURE_SLOTS R_MAX_TEXTURE_SLOTS
+#define R_BIND_GROUP_SAMPLER_SLOTS R_MAX_SAMPLER_SLOTS
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-	typedef struct R_Context      R_Context;
-	typedef struct R_Buffer       R_Buffer;
-	typedef struct R_VertexShader R_VertexShader;
-	typedef struct R_PixelShader  R_PixelShader;
-	typedef struct R_InputLayout  R_InputLayout;
-	typedef struct R_Pipeline     R_Pipeline;
+	typedef struct R_Context R_Context;
 
 	typedef enum
 	{
@@ -29,6 +45,8 @@ extern "C"
 		R_ERROR_INPUT_LAYOUT_FAILED,
 		R_ERROR_INVALID_PARAMETER,
 		R_ERROR_OUT_OF_MEMORY,
+		R_ERROR_STATE_CREATION_FAILED,
+		R_ERROR_TEXTURE_CREATION_FAILED,
 	} R_Result;
 
 	const char *r_result_to_string( R_Result result );
@@ -39,60 +57,322 @@ extern "C"
 	void       r_clear_render_target( R_Context *ctx, float r, float g, float b, float a );
 	void       r_set_viewport( R_Context *ctx, float x, float y, float w, float h );
 
-	R_Buffer *r_create_buffer( R_Context  *ctx,
-	                           const void *data,
-	                           size_t      bytes,
-	                           bool        dynamic,
-	                           UINT        bindFlags,
-	                           R_Result   *outResult );
-	R_Buffer *r_create_constant_buffer( R_Context *ctx, size_t size, R_Result *outResult );
-	void      r_update_buffer( R_Context *ctx, R_Buffer *buf, const void *data, size_t bytes );
-	void      r_bind_constant_buffer( R_Context *ctx, R_Buffer *cb, int slot );
-	void      r_destroy_buffer( R_Buffer *buf );
-
-	R_VertexShader *r_create_vertex_shader_from_bytecode( R_Context  *ctx,
-	                                                      const void *bytecode,
-	                                                      size_t      bytecodeSize,
-	                                                      R_Result   *outResult );
-	R_PixelShader  *r_create_pixel_shader_from_bytecode( R_Context  *ctx,
+	// The context has no locks. It belongs to one thread, the one that created it, and every call
+	// on it has to come from that thread; creates, destroys, uploads and submits assert it. A render
+	// thread calls r_take_context when it starts, and the thread that joins it takes the context back
+	// before destroying anything. Meanwhile the game thread only hands over frame packets
+	// (see r_frame_pipe.h).
+	void r_take_context( R_Context *ctx );
+
+	// The r_destroy_* functions don't release D3D objects right away: they are queued with the frame
+	// being recorded and released by r_present once that frame's fence has passed.
+	// r_defer_release queues any other COM object the same way and may be called from any thread.
+	void r_defer_release( R_Context *ctx, IUnknown *object );
+	// Waits for the GPU and releases everything queued, e.g. after destroying a level's resources.
+	void r_finish_releases( R_Context *ctx );
+	void r_get_release_stats( R_Context *ctx, R_ReleaseStats *outStats );
+
+	// Records the next frame, from the end of the following r_present to the end of the one after,
+	// into a capture file (see r_capture.h) the replay tool re-issues against any backend. Objects
+	// alive when the frame starts go into the capture too, buffers read back from the GPU. Render
+	// targets and texture contents are left out, replays draw into the back buffer. False while a
+	// capture is already pending; the file isn't written if recording runs out of memory.
+	bool r_capture_frame( R_Context *ctx, const char *path );
+	// Shaders and input layouts only go into captures and pipeline manifests with their bytecode and
+	// elements, which the context copies only while a capture is pending or a manifest recording, and
+	// from this call on. Builds that capture frames or record manifests call it right after
+	// r_create_context; otherwise what was created before is left out, with the pipelines using it.
+	void r_keep_capture_sources( R_Context *ctx );
+
+	// Resources are returned as generational handles (see r_handles.h); a zero id means failure.
+	R_Buffer r_create_buffer( R_Context  *ctx,
+	                          const void *data,
+	                          size_t      bytes,
+	                          bool        dynamic,
+	                          UINT        bindFlags,
+	                          R_Result   *outResult );
+	R_Buffer r_create_constant_buffer( R_Context *ctx, size_t size, R_Result *outResult );
+	void     r_update_buffer( R_Context *ctx, R_Buffer buf, const void *data, size_t bytes );
+	void     r_bind_constant_buffer( R_Context *ctx, R_Buffer cb, int slot );
+	// Copies per-draw constants into the frame's transient ring and binds them to both stages at slot.
+	bool     r_push_constants( R_Context *ctx, const void *data, size_t bytes, int slot );
+	void     r_destroy_buffer( R_Context *ctx, R_Buffer buf );
+
+	// Batched uploads for static (D3D11_USAGE_DEFAULT) buffers. The data is copied on the call and
+	// reaches the buffer through a shared staging buffer, a budget's worth per r_present. Callbacks
+	// get the buffer's id once its copy has been recorded, draws issued after that see the data.
+	// They run inside r_present/r_finish_uploads and must not queue uploads of their own. Dynamic
+	// buffers are refused (false), they take their data through r_update_buffer.
+	R_Buffer r_create_buffer_deferred( R_Context       *ctx,
+	                                   const void      *data,
+	                                   size_t           bytes,
+	                                   UINT             bindFlags,
+	                                   R_UploadCallback callback,
+	                                   void            *user,
+	                                   R_Result        *outResult );
+	bool     r_queue_buffer_upload( R_Context       *ctx,
+	                                R_Buffer         buf,
+	                                size_t           offset,
+	                                const void      *data,
+	                                size_t           bytes,
+	                                R_UploadCallback callback,
+	                                void            *user );
+	void     r_set_upload_budget( R_Context *ctx, size_t bytesPerFrame );
+	// Pushes everything still queued regardless of the budget, e.g. at the end of a loading screen.
+	void     r_finish_uploads( R_Context *ctx );
+	void     r_get_upload_stats( R_Context *ctx, R_UploadStats *outStats );
+
+	// Frame graphs (see r_frame_graph.h). Transients are backed by textures the context keeps across
+	// executions and hands to any transient with the same desc. Imported colour targets pass their
+	// ID3D11RenderTargetView as external, imported depth targets their ID3D11DepthStencilView.
+	R_FgTextureDesc r_graph_texture_desc( UINT width, UINT height, DXGI_FORMAT format );
+	// The swap chain's target; its first writer clears it to clearColor unless that is NULL.
+	R_FgResource    r_graph_import_backbuffer( R_Context *ctx, R_FrameGraph *graph, const float clearColor[4] );
+	// Compiles the graph if needed and runs its live passes, each with the resources it writes bound
+	// as render targets and the viewport covering them. The back buffer is bound again afterwards.
+	bool            r_execute_frame_graph( R_Context *ctx, R_FrameGraph *graph );
+	// Binds a transient to a pixel shader slot. Only valid inside a pass, unbound when it ends.
+	bool            r_bind_graph_texture( R_Context *ctx, R_FgResource resource, UINT slot );
+
+	R_VertexShader r_create_vertex_shader_from_bytecode( R_Context  *ctx,
 	                                                     const void *bytecode,
 	                                                     size_t      bytecodeSize,
 	                                                     R_Result   *outResult );
-	R_VertexShader *r_create_vertex_shader_from_source( R_Context  *ctx,
-	                                                    const char *src,
-	                                                    const char *entry,
-	                                                    const char *profile,
+	R_PixelShader  r_create_pixel_shader_from_bytecode( R_Context  *ctx,
+	                                                    const void *bytecode,
+	                                                    size_t      bytecodeSize,
 	                                                    R_Result   *outResult );
-	R_PixelShader  *r_create_pixel_shader_from_source( R_Context  *ctx,
+	// Opens (or creates) an on-disk cache for the *_from_source paths; safe to share between processes.
+	bool           r_open_shader_cache( R_Context *ctx, const char *path );
+	R_VertexShader r_create_vertex_shader_from_source( R_Context  *ctx,
 	                                                   const char *src,
 	                                                   const char *entry,
 	                                                   const char *profile,
 	                                                   R_Result   *outResult );
+	R_PixelShader  r_create_pixel_shader_from_source( R_Context  *ctx,
+	                                                  const char *src,
+	                                                  const char *entry,
+	                                                  const char *profile,
+	                                                  R_Result   *outResult );
+
+	typedef enum
+	{
+		R_SHADER_PENDING = 0,
+		R_SHADER_READY,
+		R_SHADER_FAILED,
+	} R_ShaderStatus;
+
+	// The shader handle behind a future is live from the start: it can go into input layouts and
+	// pipelines while the compile is still running, and is destroyed like any other shader.
+	typedef struct R_ShaderFuture
+	{
+		R_ShaderStage stage;
+		uint32_t      id;
+	} R_ShaderFuture;
+
+	// Compiles on a worker thread unless the shader cache already has the bytecode. Pipelines that
+	// reference a pending shader draw with their fallback (R_PipelineDesc.fallback) until it's in.
+	R_ShaderFuture r_compile_shader_async( R_Context    *ctx,
+	                                       R_ShaderStage stage,
+	                                       const char   *src,
+	                                       const char   *entry,
+	                                       const char   *profile,
+	                                       R_Result     *outResult );
+	R_ShaderStatus r_shader_future_status( R_Context *ctx, R_ShaderFuture future );
+	R_VertexShader r_shader_future_vertex( R_ShaderFuture future );
+	R_PixelShader  r_shader_future_pixel( R_ShaderFuture future );
+	// Creates the shaders whose compiles finished and switches waiting pipelines over; r_present
+	// calls it once per frame. Like every other call on the context, from its owner (see
+	// r_take_context).
+	void           r_poll_shader_jobs( R_Context *ctx );
+
+	// Input signature blob of the shader (shared with every shader declaring the same inputs).
+	const void *r_vertex_shader_get_input_signature( R_Context *ctx, R_VertexShader shader, size_t *outSize );
+	void        r_destroy_vertex_shader( R_Context *ctx, R_VertexShader sh );
+	void        r_destroy_pixel_shader( R_Context *ctx, R_PixelShader sh );
+
+	R_InputLayout r_create_input_layout( R_Context                      *ctx,
+	                                     const D3D11_INPUT_ELEMENT_DESC *desc,
+	                                     UINT                            numDesc,
+	                                     R_VertexShader                  vs,
+	                                     R_Result                       *outResult );
+	void          r_destroy_input_layout( R_Context *ctx, R_InputLayout layout );
+
+	// Everything a draw needs besides buffers and topology. Descriptors are hashed on creation:
+	// identical descriptors return the same (reference counted) pipeline, and identical
+	// rasterizer/blend/depth-stencil blocks share one D3D state object across pipelines.
+	typedef struct R_PipelineDesc
+	{
+		R_VertexShader           vs;
+		R_PixelShader            ps;
+		R_InputLayout            layout;
+		D3D11_RASTERIZER_DESC    rasterizer;
+		D3D11_BLEND_DESC         blend;
+		FLOAT                    blendFactor[4];
+		UINT                     sampleMask;
+		D3D11_DEPTH_STENCIL_DESC depthStencil;
+		UINT                     stencilRef;
+		R_Pipeline               fallback; // bound instead while vs, ps or layout are still compiling
+	} R_PipelineDesc;
+
+	// Fills in the D3D11 default fixed-function state for the given shaders.
+	void r_pipeline_desc_init( R_PipelineDesc *desc, R_VertexShader vs, R_PixelShader ps, R_InputLayout layout );
+
+	R_Pipeline r_create_pipeline( R_Context *ctx, const R_PipelineDesc *desc, R_Result *outResult );
+	// Binding the current pipeline again is free; a switch only re-issues the components that differ.
+	// A pipeline waiting on a compile binds its fallback instead, or no shaders at all without one.
+	void       r_bind_pipeline( R_Context *ctx, R_Pipeline pipe );
+	// Every r_create_pipeline needs a matching destroy, cached pipelines go away with the last reference.
+	void       r_destroy_pipeline( R_Context *ctx, R_Pipeline pipe );
 
-	const void *r_vertex_shader_get_bytecode( const R_VertexShader *shader, size_t *outSize );
-	void        r_destroy_vertex_shader( R_VertexShader *sh );
-	void        r_destroy_pixel_shader( R_PixelShader *sh );
-
-	R_InputLayout *r_create_input_layout( R_Context                      *ctx,
-	                                      const D3D11_INPUT_ELEMENT_DESC *desc,
-	                                      UINT                            numDesc,
-	                                      const R_VertexShader           *vs,
-	                                      R_Result                       *outResult );
-	void           r_destroy_input_layout( R_InputLayout *layout );
-
-	R_Pipeline *r_create_pipeline( R_Context      *ctx,
-	                               R_VertexShader *vs,
-	                               R_PixelShader  *ps,
-	                               R_InputLayout  *layout,
-	                               R_Result       *outResult );
-	void        r_bind_pipeline( R_Context *ctx, R_Pipeline *pipe );
-	void        r_destroy_pipeline( R_Pipeline *pipe );
-
-	void r_set_vertex_buffer( R_Context *ctx, R_Buffer *vb, UINT stride, UINT offset );
-	void r_set_index_buffer( R_Context *ctx, R_Buffer *ib, DXGI_FORMAT fmt, UINT offset );
+	// Pipeline manifests (see r_precache.h) against first-use hitches. Recording writes every pipeline,
+	// input layout and sampler the context creates from then on, and those alive already, with their
+	// shaders to path when the context is destroyed or at r_save_pipeline_manifest. Pipelines and
+	// layouts created earlier need r_keep_capture_sources for that.
+	bool r_record_pipeline_manifest( R_Context *ctx, const char *path );
+	bool r_save_pipeline_manifest( R_Context *ctx );
+	// Once per context, at startup: builds everything in the manifest on a background thread. When
+	// it's done, creating any of those shaders, layouts, pipelines or samplers takes the prebuilt
+	// object instead of going to the driver. r_present polls for that; r_wait_pipeline_manifest
+	// blocks until then, e.g. at the end of a loading screen.
+	bool r_load_pipeline_manifest( R_Context *ctx, const char *path );
+	void r_poll_pipeline_manifest( R_Context *ctx );
+	void r_wait_pipeline_manifest( R_Context *ctx );
+	// False while the manifest is still being built.
+	bool r_get_pipeline_manifest_stats( R_Context *ctx, R_PrecacheStats *outStats );
+
+	typedef struct R_TextureDesc
+	{
+		UINT        width;
+		UINT        height;
+		UINT        mipLevels; // 0 for the full chain down to 1x1
+		UINT        arraySize; // 0 is taken as 1
+		DXGI_FORMAT format;
+		bool        generateMips; // data only has the top mip of each slice, the GPU renders the rest
+	} R_TextureDesc;
+
+	typedef struct R_TextureData
+	{
+		const void *pixels;
+		UINT        rowPitch;
+	} R_TextureData;
+
+	// Uploads the whole texture in the create call: data has one entry per subresource, every mip of
+	// slice 0 first, then slice 1 and so on (D3D11CalcSubresource order), or one per slice with
+	// generateMips. NULL data leaves the contents undefined.
+	R_Texture r_create_texture( R_Context           *ctx,
+	                            const R_TextureDesc *desc,
+	                            const R_TextureData *data,
+	                            R_Result            *outResult );
+	void      r_destroy_texture( R_Context *ctx, R_Texture texture );
+	// The view covers every mip and slice; e.g. for bind groups and r_submit_batch2d.
+	ID3D11ShaderResourceView *r_get_texture_view( R_Context *ctx, R_Texture texture );
+
+	// Identical descs return the same sampler, created once and kept until the context is destroyed.
+	R_Sampler           r_create_sampler( R_Context *ctx, const D3D11_SAMPLER_DESC *desc, R_Result *outResult );
+	ID3D11SamplerState *r_get_sampler_state( R_Context *ctx, R_Sampler sampler );
+
+	// Rebinding what a slot already holds is filtered like every other state call.
+	void r_bind_texture( R_Context *ctx, R_Texture texture, R_ShaderStage stage, UINT slot );
+	void r_bind_sampler( R_Context *ctx, R_Sampler sampler, R_ShaderStage stage, UINT slot );
+
+	// Immutable set of constant buffers, textures and samplers per stage, indexed by slot. Empty
+	// entries leave their slot alone. Zero the desc before filling it in, it is hashed as raw bytes:
+	// identical descs return the same (reference counted) group.
+	typedef struct R_BindGroupDesc
+	{
+		R_Buffer                  constants[R_STAGE_COUNT][R_MAX_CONSTANT_BUFFER_SLOTS];
+		ID3D11ShaderResourceView *textures[R_STAGE_COUNT][R_BIND_GROUP_TEXTURE_SLOTS];
+		ID3D11SamplerState       *samplers[R_STAGE_COUNT][R_BIND_GROUP_SAMPLER_SLOTS];
+	} R_BindGroupDesc;
+
+	// The group holds its own references to everything in the desc.
+	R_BindGroup r_create_bind_group( R_Context *ctx, const R_BindGroupDesc *desc, R_Result *outResult );
+	void        r_destroy_bind_group( R_Context *ctx, R_BindGroup group );
+	// Binding the group already bound at index is a single compare. Otherwise every run of adjacent
+	// slots goes to the driver in one call per stage. Groups at other indices sharing slots with it,
+	// and slots bound by any other call, stop counting as bound.
+	void        r_bind_group( R_Context *ctx, R_BindGroup group, uint32_t index );
+
+	void r_set_vertex_buffer( R_Context *ctx, R_Buffer vb, UINT stride, UINT offset );
+	void r_set_index_buffer( R_Context *ctx, R_Buffer ib, DXGI_FORMAT fmt, UINT offset );
 	void r_set_primitive_topology( R_Context *ctx, D3D11_PRIMITIVE_TOPOLOGY prim );
 	void r_draw( R_Context *ctx, UINT vertexCount, UINT startVertex );
 	void r_draw_indexed( R_Context *ctx, UINT indexCount, UINT startIndex, INT baseVertex );
+	void r_draw_indexed_instanced( R_Context *ctx,
+	                               UINT       indexCount,
+	                               UINT       instanceCount,
+	                               UINT       startIndex,
+	                               INT        baseVertex,
+	                               UINT       startInstance );
+
+	// Meshes share one vertex and one index buffer per vertex stride (geometry heaps), sub-allocated
+	// with an offset allocator (see r_offset_alloc.h). Indices are 32-bit and relative to the mesh's
+	// first vertex. The data goes through the batched upload path, like r_queue_buffer_upload, and
+	// the mesh draws nothing until it has gone out (r_finish_uploads sends it right away).
+	//
+	// A heap holds 64 MB of vertices and 16M indices unless r_set_geometry_heap_size said otherwise,
+	// and doesn't grow; when the heaps of a stride are full, the next mesh opens another one. There
+	// are at most 16 heaps, after that creating a mesh that doesn't fit fails with
+	// R_ERROR_OUT_OF_MEMORY. A mesh larger than a heap is an R_ERROR_INVALID_PARAMETER.
+	R_Mesh r_create_mesh( R_Context      *ctx,
+	                      const void     *vertices,
+	                      uint32_t        vertexCount,
+	                      UINT            stride,
+	                      const uint32_t *indices,
+	                      uint32_t        indexCount,
+	                      R_Result       *outResult );
+	void   r_destroy_mesh( R_Context *ctx, R_Mesh mesh );
+	// Binds the mesh's heap (a no-op between meshes of the same stride) and draws with its offsets.
+	// Topology and pipeline are the caller's.
+	void   r_draw_mesh( R_Context *ctx, R_Mesh mesh );
+	void   r_draw_mesh_instanced( R_Context *ctx, R_Mesh mesh, UINT instanceCount, UINT startInstance );
+
+	typedef struct R_GeometryStats
+	{
+		uint32_t heaps;
+		uint32_t meshes;
+		size_t   vertexBytes; // capacity of all heaps
+		size_t   freeVertexBytes;
+		size_t   indexBytes;
+		size_t   freeIndexBytes;
+		uint32_t freeRegions; // holes left by destroyed meshes, 1 per heap buffer when compact
+		uint64_t bytesMoved;  // by r_defragment_geometry, since the context was created
+	} R_GeometryStats;
+
+	// Moves meshes down into the holes below them, with GPU copies inside each heap buffer, until
+	// maxBytes have been copied; the next call carries on from where this one stopped. Pending
+	// uploads are finished first. Returns the bytes copied.
+	size_t r_defragment_geometry( R_Context *ctx, size_t maxBytes );
+	void   r_get_geometry_stats( R_Context *ctx, R_GeometryStats *outStats );
+	// Size of the heaps created from now on; vertexBytes up to 4 GB, indexCount up to 1G.
+	void   r_set_geometry_heap_size( R_Context *ctx, size_t vertexBytes, uint32_t indexCount );
+
+	// Sorts the queue by key and replays it through r_bind_pipeline/r_draw_indexed.
+	void r_submit_draw_queue( R_Context *ctx, R_DrawQueue *queue );
+
+	// Executes a bundle (see r_bundle.h), building it first if packets were pushed since. The commands
+	// go straight to the immediate context, redundant binds were dropped when it was built; a bundle is
+	// only checked again after a buffer or pipeline was destroyed or a pipeline finished compiling.
+	// False when one of its buffers or pipelines is gone, the bundle then has to be recorded again.
+	bool r_execute_bundle( R_Context *ctx, R_Bundle *bundle );
+
+	// Builds the batcher's runs and issues one r_draw_indexed_instanced per run. The instance data is
+	// streamed into a shared dynamic buffer bound at vertex slot 1, so the pipelines need an input layout
+	// with per-instance elements there (e.g. Geometry3D_InstancedLayout). Returns the draws issued.
+	uint32_t r_submit_instanced( R_Context *ctx, R_InstanceBatcher *batcher );
+
+	// Streams the batch's quads into a shared NO_OVERWRITE vertex ring and issues one draw per command,
+	// with the constants of ui_batch_pass.vtx pushed to slot 0 for the current viewport. Textures are
+	// ID3D11ShaderResourceView pointers, bound to pixel shader slot 0. Returns the draws issued.
+	uint32_t r_submit_batch2d( R_Context *ctx, R_Batch2D *batch );
+
+	// Counters of state calls that reached the driver vs. the ones dropped as redundant.
+	void r_get_state_stats( R_Context *ctx, R_StateStats *outStats );
+	void r_reset_state_stats( R_Context *ctx );
+
+	// Must be called after touching the immediate context directly, so the shadow state is re-synced.
+	void r_invalidate_state_cache( R_Context *ctx );
 
 	ID3D11Device        *r_get_device( R_Context *ctx );
 	ID3D11DeviceContext *r_get_imm_context( R_Context *ctx );
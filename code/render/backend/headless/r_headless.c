@@ -0,0 +1,867 @@
+#include "r_headless.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../common/r_pool.h"
+#include "../../common/r_hash.h"
+#include "../../common/r_ring_alloc.h"
+#include "../../common/r_batch2d.h"
+
+#define R_HEADLESS_POOL_CAPACITY 4096
+// Mirrors the D3D11 backend's constant ring, retired at every present since nothing is in flight.
+#define R_HEADLESS_RING_SIZE ( 4 * 1024 * 1024 )
+#define R_HEADLESS_RING_ALIGNMENT 256
+
+// DXGI_FORMAT_R16_UINT and DXGI_FORMAT_R32_UINT, capture enums are D3D11's (see r_capture.h).
+#define R_HEADLESS_INDEX_R16 57
+#define R_HEADLESS_INDEX_R32 42
+
+typedef struct R_HeadlessBuffer
+{
+	uint8_t *data;
+	uint32_t bytes;
+	uint32_t bindFlags;
+} R_HeadlessBuffer;
+
+typedef struct R_HeadlessShader
+{
+	void    *bytecode;
+	uint32_t size;
+	uint64_t hash;
+} R_HeadlessShader;
+
+typedef struct R_HeadlessLayout
+{
+	R_CaptureElement elements[R_CAPTURE_MAX_ELEMENTS];
+	uint32_t         elementCount;
+	uint32_t         slotMask;     // vertex slots read by the layout
+	uint32_t         instanceMask; // of those, the per-instance ones
+	uint64_t         hash;
+	uint32_t         refCount;
+} R_HeadlessLayout;
+
+typedef struct R_HeadlessPipeline
+{
+	uint32_t vs;
+	uint32_t ps;
+	uint32_t layout;
+	uint32_t fallback;
+	uint64_t hash;
+	uint32_t refCount;
+} R_HeadlessPipeline;
+
+// Samplers live as long as the device and identical descs share one, like in the D3D11 backend.
+typedef struct R_HeadlessSampler
+{
+	uint64_t hash;
+} R_HeadlessSampler;
+
+// Pool plus one array of items indexed by dense index, and a hash -> handle map for the deduplicated types.
+typedef struct R_HeadlessStore
+{
+	R_Pool    pool;
+	uint8_t  *items;
+	size_t    itemSize;
+	R_HashMap cache;
+} R_HeadlessStore;
+
+typedef struct R_HeadlessStream
+{
+	uint8_t *data;
+	size_t   capacity;
+} R_HeadlessStream;
+
+typedef struct R_HeadlessVertexBinding
+{
+	uint32_t buffer; // 0 with stream set: the slot's vertex stream
+	bool     stream;
+	uint32_t stride;
+	uint32_t offset;
+} R_HeadlessVertexBinding;
+
+struct R_Headless
+{
+	R_HeadlessStore buffers;
+	R_HeadlessStore vertexShaders;
+	R_HeadlessStore pixelShaders;
+	R_HeadlessStore layouts;
+	R_HeadlessStore pipelines;
+	R_HeadlessStore samplers;
+
+	R_StateCache    state;
+	R_RingAllocator constantRing;
+	uint8_t        *constantMemory;
+	uint64_t        frame;
+
+	R_HeadlessStream        streams[R_MAX_VERTEX_BUFFER_SLOTS];
+	R_HeadlessVertexBinding vertexBindings[R_MAX_VERTEX_BUFFER_SLOTS];
+	uint32_t                indexBuffer;
+	bool                    quadIndices;
+	uint32_t                indexFormat;
+	uint32_t                indexOffset;
+	uint32_t                pipeline;
+
+	// Bumped whenever a buffer or pipeline is destroyed or a shader goes, which can change what a
+	// pipeline binds; bundles resolve their handles again when it moved, as in the D3D11 backend.
+	uint64_t resourceEpoch;
+
+	R_HeadlessStats stats;
+};
+
+static bool r_headless_store_init( R_HeadlessStore *store, size_t itemSize )
+{
+	store->itemSize = itemSize;
+	store->items    = (uint8_t *)calloc( R_HEADLESS_POOL_CAPACITY, itemSize );
+	return store->items && r_pool_init( &store->pool, R_HEADLESS_POOL_CAPACITY ) &&
+	       r_hash_map_init( &store->cache, 64 );
+}
+
+static void r_headless_store_free( R_HeadlessStore *store )
+{
+	free( store->items );
+	r_pool_free( &store->pool );
+	r_hash_map_free( &store->cache );
+}
+
+// Stale handles are expected here (a replayed frame can outlive what it destroys), so no lookup assert.
+static void *r_headless_get( R_HeadlessStore *store, uint32_t handle )
+{
+	if ( !r_pool_is_valid( &store->pool, handle ) )
+		return NULL;
+	return store->items + r_pool_lookup( &store->pool, handle ) * store->itemSize;
+}
+
+static uint32_t r_headless_alloc( R_HeadlessStore *store, void **outItem )
+{
+	uint32_t dense  = 0;
+	uint32_t handle = r_pool_alloc( &store->pool, &dense );
+	if ( !handle )
+		return 0;
+	*outItem = store->items + dense * store->itemSize;
+	memset( *outItem, 0, store->itemSize );
+	return handle;
+}
+
+static void r_headless_release( R_HeadlessStore *store, uint32_t handle )
+{
+	uint32_t dense, moved;
+	if ( !r_pool_release( &store->pool, handle, &dense, &moved ) || dense == moved )
+		return;
+	memcpy( store->items + dense * store->itemSize, store->items + moved * store->itemSize, store->itemSize );
+}
+
+static R_HeadlessShader *r_headless_shader_get( R_Headless *dev, bool pixel, uint32_t handle )
+{
+	return (R_HeadlessShader *)r_headless_get( pixel ? &dev->pixelShaders : &dev->vertexShaders, handle );
+}
+
+static uint32_t r_headless_create_buffer( R_Headless *dev, const R_CaptureCall *call )
+{
+	uint32_t bytes = call->args[2];
+	uint8_t *data  = (uint8_t *)calloc( bytes ? bytes : 1, 1 );
+	if ( !data )
+		return 0;
+
+	R_HeadlessBuffer *buffer = NULL;
+	uint32_t          handle = r_headless_alloc( &dev->buffers, (void **)&buffer );
+	if ( !handle )
+	{
+		free( data );
+		return 0;
+	}
+
+	if ( call->size )
+		memcpy( data, call->data, call->size < bytes ? call->size : bytes );
+	buffer->data      = data;
+	buffer->bytes     = bytes;
+	buffer->bindFlags = call->args[1];
+	dev->stats.bytesUploaded += call->size;
+	return handle;
+}
+
+static void r_headless_write_buffer( R_Headless *dev,
+                                     uint32_t    handle,
+                                     uint32_t    offset,
+                                     const void *data,
+                                     uint32_t    size )
+{
+	R_HeadlessBuffer *buffer = (R_HeadlessBuffer *)r_headless_get( &dev->buffers, handle );
+	if ( !buffer || offset > buffer->bytes || size > buffer->bytes - offset )
+		return;
+	memcpy( buffer->data + offset, data, size );
+	dev->stats.bytesUploaded += size;
+}
+
+static void r_headless_copy_buffer( R_Headless *dev, const R_CaptureCall *call )
+{
+	R_HeadlessBuffer *dst   = (R_HeadlessBuffer *)r_headless_get( &dev->buffers, call->id );
+	R_HeadlessBuffer *src   = (R_HeadlessBuffer *)r_headless_get( &dev->buffers, call->refs[0] );
+	uint32_t          bytes = call->args[2];
+	if ( !dst || !src || call->args[0] > dst->bytes || bytes > dst->bytes - call->args[0] ||
+	     call->args[1] > src->bytes || bytes > src->bytes - call->args[1] )
+		return;
+	memmove( dst->data + call->args[0], src->data + call->args[1], bytes );
+}
+
+static void r_headless_destroy_buffer( R_Headless *dev, uint32_t handle )
+{
+	R_HeadlessBuffer *buffer = (R_HeadlessBuffer *)r_headless_get( &dev->buffers, handle );
+	if ( !buffer )
+		return;
+	free( buffer->data );
+	r_headless_release( &dev->buffers, handle );
+	dev->resourceEpoch++;
+}
+
+static uint32_t r_headless_create_shader( R_Headless *dev, bool pixel, const R_CaptureCall *call )
+{
+	void *bytecode = malloc( call->size ? call->size : 1 );
+	if ( !bytecode )
+		return 0;
+
+	R_HeadlessShader *shader = NULL;
+	uint32_t          handle = r_headless_alloc( pixel ? &dev->pixelShaders : &dev->vertexShaders, (void **)&shader );
+	if ( !handle )
+	{
+		free( bytecode );
+		return 0;
+	}
+
+	memcpy( bytecode, call->data, call->size );
+	shader->bytecode = bytecode;
+	shader->size     = call->size;
+	shader->hash     = r_hash_bytes( call->data, call->size, 0 );
+	return handle;
+}
+
+static void r_headless_destroy_shader( R_Headless *dev, bool pixel, uint32_t handle )
+{
+	R_HeadlessShader *shader = r_headless_shader_get( dev, pixel, handle );
+	if ( !shader )
+		return;
+	free( shader->bytecode );
+	r_headless_release( pixel ? &dev->pixelShaders : &dev->vertexShaders, handle );
+	dev->resourceEpoch++;
+}
+
+static uint32_t r_headless_create_layout( R_Headless *dev, const R_CaptureCall *call )
+{
+	R_HeadlessShader *vs = r_headless_shader_get( dev, false, call->refs[0] );
+	if ( !vs || call->elementCount == 0 || call->elementCount > R_CAPTURE_MAX_ELEMENTS )
+		return 0;
+
+	// Keyed on the elements and the shader's input signature, approximated here by its bytecode.
+	uint64_t hash = vs->hash;
+	for ( uint32_t i = 0; i < call->elementCount; ++i )
+	{
+		const R_CaptureElement *e = &call->elements[i];
+		hash                      = r_hash_string( e->semantic, hash );
+		hash                      = r_hash_bytes( &e->semanticIndex, 6 * sizeof( uint32_t ), hash );
+	}
+
+	uint32_t          handle = 0;
+	R_HeadlessLayout *layout = NULL;
+	if ( r_hash_map_get( &dev->layouts.cache, hash, &handle ) &&
+	     ( layout = (R_HeadlessLayout *)r_headless_get( &dev->layouts, handle ) ) )
+	{
+		layout->refCount++;
+		return handle;
+	}
+
+	handle = r_headless_alloc( &dev->layouts, (void **)&layout );
+	if ( !handle )
+		return 0;
+
+	// Semantic names point into the reader's scratch storage, only the slots are needed later.
+	memcpy( layout->elements, call->elements, call->elementCount * sizeof( R_CaptureElement ) );
+	for ( uint32_t i = 0; i < call->elementCount; ++i )
+	{
+		layout->elements[i].semantic = NULL;
+		if ( call->elements[i].slot >= R_MAX_VERTEX_BUFFER_SLOTS )
+			continue;
+		layout->slotMask |= 1u << call->elements[i].slot;
+		if ( call->elements[i].perInstance )
+			layout->instanceMask |= 1u << call->elements[i].slot;
+	}
+	layout->elementCount = call->elementCount;
+	layout->hash         = hash;
+	layout->refCount     = 1;
+	r_hash_map_put( &dev->layouts.cache, hash, handle );
+	return handle;
+}
+
+static void r_headless_destroy_layout( R_Headless *dev, uint32_t handle )
+{
+	R_HeadlessLayout *layout = (R_HeadlessLayout *)r_headless_get( &dev->layouts, handle );
+	if ( !layout || --layout->refCount )
+		return;
+
+	uint32_t cached = 0;
+	if ( r_hash_map_get( &dev->layouts.cache, layout->hash, &cached ) && cached == handle )
+		r_hash_map_remove( &dev->layouts.cache, layout->hash );
+	r_headless_release( &dev->layouts, handle );
+}
+
+static uint32_t r_headless_create_pipeline( R_Headless *dev, const R_CaptureCall *call )
+{
+	// A missing vertex shader means the captured one was still compiling: only usable with a fallback.
+	if ( !r_headless_get( &dev->vertexShaders, call->refs[0] ) && !call->refs[3] )
+		return 0;
+
+	uint64_t hash = r_hash_bytes( call->refs, sizeof( call->refs ), 0 );
+	hash          = r_hash_bytes( call->args, sizeof( call->args ), hash );
+	hash          = r_hash_bytes( call->floats, sizeof( call->floats ), hash );
+	hash          = r_hash_bytes( call->data, call->size, hash );
+
+	uint32_t            handle   = 0;
+	R_HeadlessPipeline *pipeline = NULL;
+	if ( r_hash_map_get( &dev->pipelines.cache, hash, &handle ) &&
+	     ( pipeline = (R_HeadlessPipeline *)r_headless_get( &dev->pipelines, handle ) ) )
+	{
+		pipeline->refCount++;
+		return handle;
+	}
+
+	handle = r_headless_alloc( &dev->pipelines, (void **)&pipeline );
+	if ( !handle )
+		return 0;
+
+	// Like in the D3D11 backend the pipeline holds a reference on its layout.
+	R_HeadlessLayout *layout = (R_HeadlessLayout *)r_headless_get( &dev->layouts, call->refs[2] );
+	if ( layout )
+		layout->refCount++;
+
+	pipeline->vs       = call->refs[0];
+	pipeline->ps       = call->refs[1];
+	pipeline->layout   = call->refs[2];
+	pipeline->fallback = call->refs[3];
+	pipeline->hash     = hash;
+	pipeline->refCount = 1;
+	r_hash_map_put( &dev->pipelines.cache, hash, handle );
+	return handle;
+}
+
+static void r_headless_destroy_pipeline( R_Headless *dev, uint32_t handle )
+{
+	R_HeadlessPipeline *pipeline = (R_HeadlessPipeline *)r_headless_get( &dev->pipelines, handle );
+	if ( !pipeline || --pipeline->refCount )
+		return;
+
+	uint32_t cached = 0;
+	if ( r_hash_map_get( &dev->pipelines.cache, pipeline->hash, &cached ) && cached == handle )
+		r_hash_map_remove( &dev->pipelines.cache, pipeline->hash );
+	r_headless_destroy_layout( dev, pipeline->layout );
+	r_headless_release( &dev->pipelines, handle );
+	dev->resourceEpoch++;
+}
+
+static uint32_t r_headless_create_sampler( R_Headless *dev, const R_CaptureCall *call )
+{
+	uint64_t hash   = r_hash_bytes( call->data, call->size, 0 );
+	uint32_t handle = 0;
+	if ( r_hash_map_get( &dev->samplers.cache, hash, &handle ) )
+		return handle;
+
+	R_HeadlessSampler *sampler = NULL;
+	handle                     = call->size ? r_headless_alloc( &dev->samplers, (void **)&sampler ) : 0;
+	if ( !handle )
+		return 0;
+	sampler->hash = hash;
+	r_hash_map_put( &dev->samplers.cache, hash, handle );
+	return handle;
+}
+
+// Pipelines whose shaders are gone bind their fallback, like a compile still in flight would. 0 for none.
+static uint32_t r_headless_bound_pipeline( R_Headless *dev, uint32_t handle )
+{
+	uint32_t            bound    = handle;
+	R_HeadlessPipeline *pipeline = (R_HeadlessPipeline *)r_headless_get( &dev->pipelines, bound );
+	if ( pipeline && !r_headless_get( &dev->vertexShaders, pipeline->vs ) && pipeline->fallback )
+	{
+		bound    = pipeline->fallback;
+		pipeline = (R_HeadlessPipeline *)r_headless_get( &dev->pipelines, bound );
+	}
+	return pipeline ? bound : 0;
+}
+
+static void r_headless_pipeline_objects( R_Headless *dev, uint32_t bound, const void **outObjects )
+{
+	R_HeadlessPipeline *pipeline = (R_HeadlessPipeline *)r_headless_get( &dev->pipelines, bound );
+	memset( outObjects, 0, R_STATE_OBJECT_COUNT * sizeof( *outObjects ) );
+	if ( pipeline )
+	{
+		outObjects[R_STATE_OBJECT_INPUT_LAYOUT]  = (const void *)(uintptr_t)pipeline->layout;
+		outObjects[R_STATE_OBJECT_VERTEX_SHADER] = (const void *)(uintptr_t)pipeline->vs;
+		outObjects[R_STATE_OBJECT_PIXEL_SHADER]  = (const void *)(uintptr_t)pipeline->ps;
+	}
+}
+
+static void r_headless_set_pipeline_objects( R_Headless *dev, uint32_t bound )
+{
+	const void *objects[R_STATE_OBJECT_COUNT];
+	r_headless_pipeline_objects( dev, bound, objects );
+	for ( int i = 0; i < R_STATE_OBJECT_COUNT; ++i )
+		r_state_cache_set_object( &dev->state, (R_StateObject)i, objects[i] );
+}
+
+static void r_headless_bind_pipeline( R_Headless *dev, uint32_t handle )
+{
+	if ( !r_state_cache_set_pipeline( &dev->state, (const void *)(uintptr_t)handle ) )
+		return;
+	dev->pipeline = r_headless_bound_pipeline( dev, handle );
+	r_headless_set_pipeline_objects( dev, dev->pipeline );
+}
+
+static void r_headless_push_constants( R_Headless *dev, const R_CaptureCall *call )
+{
+	size_t offset = 0;
+	if ( !r_ring_alloc( &dev->constantRing, call->size, &offset ) )
+		return;
+	memcpy( dev->constantMemory + offset, call->data, call->size );
+	dev->stats.bytesStreamed += call->size;
+
+	int      slot          = (int)call->args[0];
+	uint32_t firstConstant = (uint32_t)( offset / 16 );
+	uint32_t alignedSize   = ( call->size + R_HEADLESS_RING_ALIGNMENT - 1 ) & ~( R_HEADLESS_RING_ALIGNMENT - 1 );
+	uint32_t numConstants  = alignedSize / 16;
+	r_state_cache_set_constant_buffer_range(
+	    &dev->state, R_STAGE_VERTEX, slot, dev->constantMemory, firstConstant, numConstants );
+	r_state_cache_set_constant_buffer_range(
+	    &dev->state, R_STAGE_PIXEL, slot, dev->constantMemory, firstConstant, numConstants );
+}
+
+static void r_headless_stream( R_Headless *dev, const R_CaptureCall *call )
+{
+	uint32_t slot   = call->args[0];
+	uint32_t offset = call->args[2];
+	if ( slot >= R_MAX_VERTEX_BUFFER_SLOTS || call->size > UINT32_MAX - offset )
+		return;
+
+	R_HeadlessStream *stream = &dev->streams[slot];
+	size_t            needed = (size_t)offset + call->size;
+	if ( needed > stream->capacity )
+	{
+		size_t capacity = stream->capacity ? stream->capacity : 64 * 1024;
+		while ( capacity < needed )
+			capacity *= 2;
+
+		uint8_t *data = (uint8_t *)realloc( stream->data, capacity );
+		if ( !data )
+			return;
+		stream->data     = data;
+		stream->capacity = capacity;
+	}
+	memcpy( stream->data + offset, call->data, call->size );
+	dev->stats.bytesStreamed += call->size;
+
+	R_HeadlessVertexBinding *binding = &dev->vertexBindings[slot];
+	binding->buffer                  = 0;
+	binding->stream                  = true;
+	binding->stride                  = call->args[1];
+	binding->offset                  = call->args[3] ? offset : 0;
+	r_state_cache_set_vertex_buffer( &dev->state, (int)slot, stream, binding->stride, binding->offset );
+}
+
+// Bytes readable through a vertex slot, 0 when nothing usable is bound.
+static size_t r_headless_vertex_bytes( R_Headless *dev, uint32_t slot )
+{
+	const R_HeadlessVertexBinding *binding = &dev->vertexBindings[slot];
+
+	size_t bytes = 0;
+	if ( binding->stream )
+		bytes = dev->streams[slot].capacity;
+	else
+	{
+		R_HeadlessBuffer *buffer = (R_HeadlessBuffer *)r_headless_get( &dev->buffers, binding->buffer );
+		bytes                    = buffer ? buffer->bytes : 0;
+	}
+	return bytes > binding->offset ? bytes - binding->offset : 0;
+}
+
+// Highest index read by an indexed draw, false when the indices are out of the index buffer.
+static bool r_headless_max_index( R_Headless *dev, uint32_t indexCount, uint32_t startIndex, uint32_t *outMax )
+{
+	uint64_t end = (uint64_t)startIndex + indexCount;
+	if ( dev->quadIndices )
+	{
+		if ( end > R_BATCH2D_MAX_QUADS_PER_DRAW * 6 )
+			return false;
+		*outMax = (uint32_t)( ( end - 1 ) / 6 * 4 + 3 );
+		return true;
+	}
+
+	R_HeadlessBuffer *buffer = (R_HeadlessBuffer *)r_headless_get( &dev->buffers, dev->indexBuffer );
+	uint32_t          size   = dev->indexFormat == R_HEADLESS_INDEX_R32 ? 4 : 2;
+	if ( !buffer || dev->indexOffset + end * size > buffer->bytes )
+		return false;
+
+	const uint8_t *indices = buffer->data + dev->indexOffset;
+	uint32_t       max     = 0;
+	for ( uint64_t i = startIndex; i < end; ++i )
+	{
+		uint32_t index;
+		if ( size == 4 )
+			memcpy( &index, indices + i * 4, 4 );
+		else
+		{
+			uint16_t index16;
+			memcpy( &index16, indices + i * 2, 2 );
+			index = index16;
+		}
+		max = index > max ? index : max;
+	}
+	*outMax = max;
+	return true;
+}
+
+// Every slot the bound layout reads has to hold the vertices and instances the draw touches.
+static void r_headless_draw( R_Headless *dev,
+                             uint64_t    lastVertex,
+                             uint32_t    instanceCount,
+                             uint32_t    startInstance,
+                             bool        indicesValid )
+{
+	dev->stats.draws++;
+
+	R_HeadlessPipeline *pipeline = (R_HeadlessPipeline *)r_headless_get( &dev->pipelines, dev->pipeline );
+	R_HeadlessLayout   *layout   = pipeline ? (R_HeadlessLayout *)r_headless_get( &dev->layouts, pipeline->layout )
+	                                        : NULL;
+	bool valid = indicesValid && pipeline && r_headless_get( &dev->vertexShaders, pipeline->vs );
+
+	for ( uint32_t slot = 0; valid && layout && slot < R_MAX_VERTEX_BUFFER_SLOTS; ++slot )
+	{
+		if ( !( layout->slotMask & ( 1u << slot ) ) )
+			continue;
+
+		uint64_t last   = layout->instanceMask & ( 1u << slot ) ? (uint64_t)startInstance + instanceCount - 1
+		                                                        : lastVertex;
+		uint64_t stride = dev->vertexBindings[slot].stride;
+		valid           = ( last + 1 ) * stride <= r_headless_vertex_bytes( dev, slot );
+	}
+
+	if ( !valid )
+		dev->stats.invalidDraws++;
+}
+
+static void r_headless_draw_indexed( R_Headless *dev,
+                                     uint32_t    indexCount,
+                                     uint32_t    instanceCount,
+                                     uint32_t    startIndex,
+                                     int32_t     baseVertex,
+                                     uint32_t    startInstance )
+{
+	if ( indexCount == 0 || instanceCount == 0 )
+		return;
+
+	uint32_t maxIndex = 0;
+	bool     valid    = r_headless_max_index( dev, indexCount, startIndex, &maxIndex );
+	int64_t  last     = (int64_t)maxIndex + baseVertex;
+	dev->stats.indices += (uint64_t)indexCount * instanceCount;
+	dev->stats.instances += instanceCount;
+	r_headless_draw( dev, last < 0 ? 0 : (uint64_t)last, instanceCount, startInstance, valid && last >= 0 );
+}
+
+static uint32_t r_headless_execute( void *self, const R_CaptureCall *call )
+{
+	R_Headless *dev = (R_Headless *)self;
+	switch ( call->op )
+	{
+	case R_CAPTURE_PRESENT:
+		r_ring_end_frame( &dev->constantRing, ++dev->frame );
+		r_ring_retire( &dev->constantRing, dev->frame );
+		break;
+	case R_CAPTURE_CREATE_BUFFER:
+		return r_headless_create_buffer( dev, call );
+	case R_CAPTURE_UPDATE_BUFFER:
+		r_headless_write_buffer( dev, call->id, 0, call->data, call->size );
+		break;
+	case R_CAPTURE_UPLOAD_BUFFER:
+		r_headless_write_buffer( dev, call->id, call->args[0], call->data, call->size );
+		break;
+	case R_CAPTURE_DESTROY_BUFFER:
+		r_headless_destroy_buffer( dev, call->id );
+		break;
+	case R_CAPTURE_COPY_BUFFER:
+		r_headless_copy_buffer( dev, call );
+		break;
+	case R_CAPTURE_BIND_CONSTANT_BUFFER:
+	{
+		const void *buffer = r_headless_get( &dev->buffers, call->id );
+		r_state_cache_set_constant_buffer( &dev->state, R_STAGE_VERTEX, (int)call->args[0], buffer );
+		r_state_cache_set_constant_buffer( &dev->state, R_STAGE_PIXEL, (int)call->args[0], buffer );
+		break;
+	}
+	case R_CAPTURE_PUSH_CONSTANTS:
+		r_headless_push_constants( dev, call );
+		break;
+	case R_CAPTURE_CREATE_VERTEX_SHADER:
+	case R_CAPTURE_CREATE_PIXEL_SHADER:
+		return r_headless_create_shader( dev, call->op == R_CAPTURE_CREATE_PIXEL_SHADER, call );
+	case R_CAPTURE_DESTROY_VERTEX_SHADER:
+	case R_CAPTURE_DESTROY_PIXEL_SHADER:
+		r_headless_destroy_shader( dev, call->op == R_CAPTURE_DESTROY_PIXEL_SHADER, call->id );
+		break;
+	case R_CAPTURE_CREATE_INPUT_LAYOUT:
+		return r_headless_create_layout( dev, call );
+	case R_CAPTURE_DESTROY_INPUT_LAYOUT:
+		r_headless_destroy_layout( dev, call->id );
+		break;
+	case R_CAPTURE_CREATE_PIPELINE:
+		return r_headless_create_pipeline( dev, call );
+	case R_CAPTURE_DESTROY_PIPELINE:
+		r_headless_destroy_pipeline( dev, call->id );
+		break;
+	case R_CAPTURE_BIND_PIPELINE:
+		r_headless_bind_pipeline( dev, call->id );
+		break;
+	case R_CAPTURE_CREATE_SAMPLER:
+		return r_headless_create_sampler( dev, call );
+	case R_CAPTURE_SET_VERTEX_BUFFER:
+	{
+		R_HeadlessVertexBinding *binding = &dev->vertexBindings[0];
+		binding->buffer                  = call->id;
+		binding->stream                  = false;
+		binding->stride                  = call->args[0];
+		binding->offset                  = call->args[1];
+		r_state_cache_set_vertex_buffer(
+		    &dev->state, 0, (const void *)(uintptr_t)call->id, binding->stride, binding->offset );
+		break;
+	}
+	case R_CAPTURE_SET_INDEX_BUFFER:
+		dev->indexBuffer = call->id;
+		dev->quadIndices = false;
+		dev->indexFormat = call->args[0];
+		dev->indexOffset = call->args[1];
+		r_state_cache_set_index_buffer( &dev->state, (const void *)(uintptr_t)call->id, call->args[0], call->args[1] );
+		break;
+	case R_CAPTURE_SET_TOPOLOGY:
+		r_state_cache_set_topology( &dev->state, call->args[0] );
+		break;
+	case R_CAPTURE_SET_VIEWPORT:
+	{
+		R_Viewport viewport = { call->floats[0], call->floats[1], call->floats[2], call->floats[3], 0.0f, 1.0f };
+		r_state_cache_set_viewport( &dev->state, &viewport );
+		break;
+	}
+	case R_CAPTURE_STREAM_VERTICES:
+		r_headless_stream( dev, call );
+		break;
+	case R_CAPTURE_BIND_QUAD_INDICES:
+		dev->indexBuffer = 0;
+		dev->quadIndices = true;
+		dev->indexFormat = R_HEADLESS_INDEX_R16;
+		dev->indexOffset = 0;
+		r_state_cache_set_index_buffer( &dev->state, &dev->quadIndices, R_HEADLESS_INDEX_R16, 0 );
+		break;
+	case R_CAPTURE_DRAW:
+		dev->stats.vertices += call->args[0];
+		if ( call->args[0] )
+			r_headless_draw( dev, (uint64_t)call->args[1] + call->args[0] - 1, 1, 0, true );
+		break;
+	case R_CAPTURE_DRAW_INDEXED:
+	case R_CAPTURE_DRAW_INDEXED_INSTANCED:
+	{
+		bool     instanced     = call->op == R_CAPTURE_DRAW_INDEXED_INSTANCED;
+		uint32_t indexCount    = call->args[0];
+		uint32_t instanceCount = instanced ? call->args[1] : 1;
+		uint32_t startIndex    = call->args[instanced ? 2 : 1];
+		int32_t  baseVertex    = (int32_t)call->args[instanced ? 3 : 2];
+		uint32_t startInstance = instanced ? call->args[4] : 0;
+		r_headless_draw_indexed( dev, indexCount, instanceCount, startIndex, baseVertex, startInstance );
+		break;
+	}
+	default:
+		// Frame boundaries, markers, clears, scissors and textures: nothing to keep without a GPU.
+		break;
+	}
+	return 0;
+}
+
+R_Headless *r_headless_create( void )
+{
+	R_Headless *dev = (R_Headless *)calloc( 1, sizeof( R_Headless ) );
+	if ( !dev )
+		return NULL;
+
+	bool ok = r_headless_store_init( &dev->buffers, sizeof( R_HeadlessBuffer ) ) &&
+	          r_headless_store_init( &dev->vertexShaders, sizeof( R_HeadlessShader ) ) &&
+	          r_headless_store_init( &dev->pixelShaders, sizeof( R_HeadlessShader ) ) &&
+	          r_headless_store_init( &dev->layouts, sizeof( R_HeadlessLayout ) ) &&
+	          r_headless_store_init( &dev->pipelines, sizeof( R_HeadlessPipeline ) ) &&
+	          r_headless_store_init( &dev->samplers, sizeof( R_HeadlessSampler ) ) &&
+	          r_ring_init( &dev->constantRing, R_HEADLESS_RING_SIZE, R_HEADLESS_RING_ALIGNMENT ) &&
+	          ( dev->constantMemory = (uint8_t *)malloc( R_HEADLESS_RING_SIZE ) ) != NULL;
+	if ( !ok )
+	{
+		r_headless_destroy( dev );
+		return NULL;
+	}
+
+	r_state_cache_init( &dev->state );
+	dev->resourceEpoch = 1;
+	return dev;
+}
+
+void r_headless_destroy( R_Headless *dev )
+{
+	if ( !dev )
+		return;
+
+	for ( uint32_t i = 0; i < dev->buffers.pool.count; ++i )
+		free( ( (R_HeadlessBuffer *)dev->buffers.items )[i].data );
+	for ( uint32_t i = 0; i < dev->vertexShaders.pool.count; ++i )
+		free( ( (R_HeadlessShader *)dev->vertexShaders.items )[i].bytecode );
+	for ( uint32_t i = 0; i < dev->pixelShaders.pool.count; ++i )
+		free( ( (R_HeadlessShader *)dev->pixelShaders.items )[i].bytecode );
+	for ( int i = 0; i < R_MAX_VERTEX_BUFFER_SLOTS; ++i )
+		free( dev->streams[i].data );
+
+	r_headless_store_free( &dev->buffers );
+	r_headless_store_free( &dev->vertexShaders );
+	r_headless_store_free( &dev->pixelShaders );
+	r_headless_store_free( &dev->layouts );
+	r_headless_store_free( &dev->pipelines );
+	r_headless_store_free( &dev->samplers );
+	free( dev->constantMemory );
+	free( dev );
+}
+
+R_ReplayTarget r_headless_replay_target( R_Headless *dev )
+{
+	R_ReplayTarget target = { "headless", dev, r_headless_execute };
+	return target;
+}
+
+void r_headless_reset_stats( R_Headless *dev )
+{
+	memset( &dev->stats, 0, sizeof( dev->stats ) );
+	r_state_cache_reset_stats( &dev->state );
+}
+
+void r_headless_get_stats( const R_Headless *dev, R_HeadlessStats *outStats )
+{
+	*outStats               = dev->stats;
+	outStats->buffers       = dev->buffers.pool.count;
+	outStats->vertexShaders = dev->vertexShaders.pool.count;
+	outStats->pixelShaders  = dev->pixelShaders.pool.count;
+	outStats->inputLayouts  = dev->layouts.pool.count;
+	outStats->pipelines     = dev->pipelines.pool.count;
+	outStats->samplers      = dev->samplers.pool.count;
+	outStats->state         = dev->state.stats;
+}
+
+// r_resolve_bundle of the D3D11 backend: object is what the state cache sees for the command, resolved
+// the pipeline actually bound, flags the pipeline's objects that differ from the previous one's.
+static bool r_headless_resolve_bundle( R_Headless *dev, R_Bundle *bundle )
+{
+	const void *prev[R_STATE_OBJECT_COUNT];
+	const void *cur[R_STATE_OBJECT_COUNT];
+	bool        first = true;
+
+	bundle->valid = false;
+	for ( uint32_t n = 0; n < bundle->commandCount; ++n )
+	{
+		R_BundleCommand *cmd = &bundle->commands[n];
+		if ( cmd->type == R_BUNDLE_CMD_DRAW_INDEXED )
+			continue;
+
+		if ( cmd->type == R_BUNDLE_CMD_PIPELINE )
+		{
+			if ( cmd->handle && !r_pool_is_valid( &dev->pipelines.pool, cmd->handle ) )
+				return false;
+			cmd->resolved = r_headless_bound_pipeline( dev, cmd->handle );
+			cmd->object   = (const void *)(uintptr_t)cmd->handle;
+			r_headless_pipeline_objects( dev, cmd->resolved, cur );
+			cmd->flags = 0;
+			for ( int i = 0; i < R_STATE_OBJECT_COUNT; ++i )
+				cmd->flags |= first || cur[i] != prev[i] ? 1u << i : 0;
+			memcpy( prev, cur, sizeof( prev ) );
+			first = false;
+			continue;
+		}
+
+		if ( cmd->handle && !r_pool_is_valid( &dev->buffers.pool, cmd->handle ) )
+			return false;
+		cmd->resolved = cmd->handle;
+		cmd->object   = cmd->type == R_BUNDLE_CMD_CONSTANT_BUFFER ? r_headless_get( &dev->buffers, cmd->handle )
+		                                                          : (const void *)(uintptr_t)cmd->handle;
+	}
+
+	bundle->epoch = dev->resourceEpoch;
+	bundle->valid = true;
+	dev->stats.bundleResolves++;
+	return true;
+}
+
+bool r_headless_execute_bundle( R_Headless *dev, R_Bundle *bundle )
+{
+	if ( !dev || !bundle || !bundle->built )
+		return false;
+	if ( bundle->epoch != dev->resourceEpoch && !r_headless_resolve_bundle( dev, bundle ) )
+		return false;
+
+	// The last command of each kind, what the state cache is told about afterwards.
+	const R_BundleCommand *pipeline = NULL;
+	const R_BundleCommand *vertices = NULL;
+	const R_BundleCommand *indices  = NULL;
+	const R_BundleCommand *constants[R_MAX_CONSTANT_BUFFER_SLOTS] = { 0 };
+
+	for ( uint32_t n = 0; n < bundle->commandCount; ++n )
+	{
+		const R_BundleCommand *cmd = &bundle->commands[n];
+		switch ( cmd->type )
+		{
+		case R_BUNDLE_CMD_DRAW_INDEXED:
+			r_headless_draw_indexed( dev, cmd->args[0], 1, cmd->args[1], (int32_t)cmd->args[2], 0 );
+			break;
+		case R_BUNDLE_CMD_PIPELINE:
+			dev->pipeline = cmd->resolved;
+			pipeline      = cmd;
+			break;
+		case R_BUNDLE_CMD_VERTEX_BUFFER:
+		{
+			R_HeadlessVertexBinding *binding = &dev->vertexBindings[0];
+			binding->buffer                  = cmd->resolved;
+			binding->stream                  = false;
+			binding->stride                  = cmd->args[0];
+			binding->offset                  = cmd->args[1];
+			vertices                         = cmd;
+			break;
+		}
+		case R_BUNDLE_CMD_INDEX_BUFFER:
+			dev->indexBuffer = cmd->resolved;
+			dev->quadIndices = false;
+			dev->indexFormat = cmd->args[0];
+			dev->indexOffset = 0;
+			indices          = cmd;
+			break;
+		case R_BUNDLE_CMD_CONSTANT_BUFFER:
+			if ( cmd->args[0] < R_MAX_CONSTANT_BUFFER_SLOTS )
+				constants[cmd->args[0]] = cmd;
+			break;
+		default:
+			break;
+		}
+	}
+
+	// r_sync_bundle_state: the calls after the bundle are filtered against what it bound last.
+	R_StateCache *cache = &dev->state;
+	if ( pipeline )
+	{
+		r_state_cache_set_pipeline( cache, pipeline->object );
+		r_headless_set_pipeline_objects( dev, pipeline->resolved );
+	}
+	if ( vertices )
+		r_state_cache_set_vertex_buffer( cache, 0, vertices->object, vertices->args[0], vertices->args[1] );
+	if ( indices )
+		r_state_cache_set_index_buffer( cache, indices->object, indices->args[0], 0 );
+	for ( int slot = 0; slot < R_MAX_CONSTANT_BUFFER_SLOTS; ++slot )
+	{
+		if ( !constants[slot] )
+			continue;
+		r_state_cache_set_constant_buffer( cache, R_STAGE_VERTEX, slot, constants[slot]->object );
+		r_state_cache_set_constant_buffer( cache, R_STAGE_PIXEL, slot, constants[slot]->object );
+	}
+	return true;
+}
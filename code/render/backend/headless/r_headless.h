@@ -0,0 +1,53 @@
+#ifndef R_HEADLESS_H
+#define R_HEADLESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../../common/r_bundle.h"
+#include "../../common/r_replay.h"
+#include "../../common/r_state_cache.h"
+
+//
+// Headless backend: keeps the objects and the bound state of the R_* API in
+// plain memory and checks every draw against them, no GPU involved. Captures
+// replay against it where there is no D3D11 (Linux, build machines), which
+// times the CPU side of a frame and catches draws that would read out of range.
+//
+// Layouts and pipelines are shared and reference counted the way the D3D11
+// backend does it, keyed on their elements and shader or their whole state.
+//
+
+typedef struct R_HeadlessStats
+{
+	uint64_t     draws;
+	uint64_t     invalidDraws; // no pipeline, missing buffers or reads past their end
+	uint64_t     vertices;
+	uint64_t     indices;
+	uint64_t     instances;
+	uint64_t     bytesUploaded; // buffer creates, updates and uploads
+	uint64_t     bytesStreamed; // push constants and vertex streams
+	uint32_t     buffers;       // live objects
+	uint32_t     vertexShaders;
+	uint32_t     pixelShaders;
+	uint32_t     inputLayouts;
+	uint32_t     pipelines;
+	uint32_t     samplers;
+	uint32_t     bundleResolves; // times r_headless_execute_bundle looked up a bundle's handles
+	R_StateStats state;
+} R_HeadlessStats;
+
+typedef struct R_Headless R_Headless;
+
+R_Headless    *r_headless_create( void );
+void           r_headless_destroy( R_Headless *dev );
+R_ReplayTarget r_headless_replay_target( R_Headless *dev );
+void           r_headless_reset_stats( R_Headless *dev );
+void           r_headless_get_stats( const R_Headless *dev, R_HeadlessStats *outStats );
+
+// r_execute_bundle on the headless objects, with the same handle resolution: on first use and again
+// once a buffer, shader or pipeline went away since. The bundle has to be built (r_bundle_build); false
+// when it isn't or when one of its buffers or pipelines is gone.
+bool r_headless_execute_bundle( R_Headless *dev, R_Bundle *bundle );
+
+#endif // R_HEADLESS_H
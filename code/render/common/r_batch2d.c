@@ -0,0 +1,209 @@
+#include "r_batch2d.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool r_batch2d_init( R_Batch2D *batch, uint32_t initialQuads )
+{
+	memset( batch, 0, sizeof( *batch ) );
+	if ( initialQuads == 0 )
+		initialQuads = 1024;
+
+	batch->vertices        = (R_Batch2DVertex *)malloc( (size_t)initialQuads * 4 * sizeof( R_Batch2DVertex ) );
+	batch->commands        = (R_Batch2DCommand *)malloc( 64 * sizeof( R_Batch2DCommand ) );
+	batch->quadCapacity    = initialQuads;
+	batch->commandCapacity = 64;
+	if ( !batch->vertices || !batch->commands )
+	{
+		r_batch2d_free( batch );
+		return false;
+	}
+	return true;
+}
+
+void r_batch2d_free( R_Batch2D *batch )
+{
+	free( batch->vertices );
+	free( batch->commands );
+	memset( batch, 0, sizeof( *batch ) );
+}
+
+void r_batch2d_begin( R_Batch2D *batch )
+{
+	batch->quadCount      = 0;
+	batch->commandCount   = 0;
+	batch->pipeline.id    = 0;
+	batch->texture        = NULL;
+	batch->scissorEnabled = false;
+}
+
+void r_batch2d_set_pipeline( R_Batch2D *batch, R_Pipeline pipeline )
+{
+	batch->pipeline = pipeline;
+}
+
+void r_batch2d_set_texture( R_Batch2D *batch, const void *texture )
+{
+	batch->texture = texture;
+}
+
+void r_batch2d_set_scissor( R_Batch2D *batch, const R_Batch2DRect *rect )
+{
+	batch->scissorEnabled = rect != NULL;
+	if ( rect )
+		batch->scissor = *rect;
+}
+
+static bool r_batch2d_same_scissor( const R_Batch2DCommand *command, const R_Batch2D *batch )
+{
+	if ( command->scissorEnabled != batch->scissorEnabled )
+		return false;
+	if ( !batch->scissorEnabled )
+		return true;
+
+	const R_Batch2DRect *a = &command->scissor;
+	const R_Batch2DRect *b = &batch->scissor;
+	return a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height;
+}
+
+// The command the next quad goes into, a new one if the state doesn't match the current one.
+static R_Batch2DCommand *r_batch2d_command( R_Batch2D *batch, bool textured )
+{
+	const void *texture = textured ? batch->texture : NULL;
+
+	if ( batch->commandCount > 0 )
+	{
+		R_Batch2DCommand *current = &batch->commands[batch->commandCount - 1];
+		if ( current->pipeline.id != batch->pipeline.id )
+			batch->stats.pipelineSplits++;
+		else if ( !r_batch2d_same_scissor( current, batch ) )
+			batch->stats.scissorSplits++;
+		else if ( texture && current->texture && current->texture != texture )
+			batch->stats.textureSplits++;
+		else if ( current->quadCount == R_BATCH2D_MAX_QUADS_PER_DRAW )
+			batch->stats.sizeSplits++;
+		else
+		{
+			if ( texture )
+				current->texture = texture;
+			return current;
+		}
+	}
+
+	if ( batch->commandCount == batch->commandCapacity )
+	{
+		uint32_t          capacity = batch->commandCapacity * 2;
+		R_Batch2DCommand *commands =
+		    (R_Batch2DCommand *)realloc( batch->commands, capacity * sizeof( R_Batch2DCommand ) );
+		if ( !commands )
+			return NULL;
+		batch->commands        = commands;
+		batch->commandCapacity = capacity;
+	}
+
+	R_Batch2DCommand *command = &batch->commands[batch->commandCount++];
+	command->pipeline         = batch->pipeline;
+	command->texture          = texture;
+	command->scissor          = batch->scissor;
+	command->scissorEnabled   = batch->scissorEnabled;
+	command->firstQuad        = batch->quadCount;
+	command->quadCount        = 0;
+	batch->stats.commands++;
+	return command;
+}
+
+bool r_batch2d_quad( R_Batch2D *batch, const R_Batch2DVertex corners[4], bool textured )
+{
+	if ( batch->quadCount == batch->quadCapacity )
+	{
+		uint32_t         capacity = batch->quadCapacity * 2;
+		R_Batch2DVertex *vertices =
+		    (R_Batch2DVertex *)realloc( batch->vertices, (size_t)capacity * 4 * sizeof( R_Batch2DVertex ) );
+		if ( !vertices )
+			return false;
+		batch->vertices     = vertices;
+		batch->quadCapacity = capacity;
+	}
+
+	R_Batch2DCommand *command = r_batch2d_command( batch, textured );
+	if ( !command )
+		return false;
+
+	memcpy( &batch->vertices[(size_t)batch->quadCount * 4], corners, 4 * sizeof( R_Batch2DVertex ) );
+	batch->quadCount++;
+	command->quadCount++;
+	batch->stats.quads++;
+	return true;
+}
+
+static void r_batch2d_vertex( R_Batch2DVertex *v, float x, float y, float u, float vv, uint32_t color )
+{
+	v->pos[0] = x;
+	v->pos[1] = y;
+	v->uv[0]  = u;
+	v->uv[1]  = vv;
+	v->color  = color;
+}
+
+bool r_batch2d_rect( R_Batch2D *batch, float x, float y, float w, float h, uint32_t color )
+{
+	R_Batch2DVertex q[4];
+	r_batch2d_vertex( &q[0], x, y, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	r_batch2d_vertex( &q[1], x + w, y, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	r_batch2d_vertex( &q[2], x + w, y + h, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	r_batch2d_vertex( &q[3], x, y + h, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	return r_batch2d_quad( batch, q, false );
+}
+
+bool r_batch2d_rect_outline( R_Batch2D *batch, float x, float y, float w, float h, float thickness, uint32_t color )
+{
+	if ( thickness * 2.0f >= w || thickness * 2.0f >= h )
+		return r_batch2d_rect( batch, x, y, w, h, color );
+
+	return r_batch2d_rect( batch, x, y, w, thickness, color ) &&
+	       r_batch2d_rect( batch, x, y + h - thickness, w, thickness, color ) &&
+	       r_batch2d_rect( batch, x, y + thickness, thickness, h - thickness * 2.0f, color ) &&
+	       r_batch2d_rect( batch, x + w - thickness, y + thickness, thickness, h - thickness * 2.0f, color );
+}
+
+bool r_batch2d_line( R_Batch2D *batch, float x0, float y0, float x1, float y1, float thickness, uint32_t color )
+{
+	float dx     = x1 - x0;
+	float dy     = y1 - y0;
+	float length = sqrtf( dx * dx + dy * dy );
+	if ( length <= 0.0f )
+		return true;
+
+	// Half the thickness to either side of the line.
+	float nx = -dy / length * thickness * 0.5f;
+	float ny = dx / length * thickness * 0.5f;
+
+	R_Batch2DVertex q[4];
+	r_batch2d_vertex( &q[0], x0 + nx, y0 + ny, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	r_batch2d_vertex( &q[1], x1 + nx, y1 + ny, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	r_batch2d_vertex( &q[2], x1 - nx, y1 - ny, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	r_batch2d_vertex( &q[3], x0 - nx, y0 - ny, R_BATCH2D_NO_UV, R_BATCH2D_NO_UV, color );
+	return r_batch2d_quad( batch, q, false );
+}
+
+bool r_batch2d_textured_quad( R_Batch2D  *batch,
+                              float       x,
+                              float       y,
+                              float       w,
+                              float       h,
+                              const float uv[4],
+                              uint32_t    color )
+{
+	R_Batch2DVertex q[4];
+	r_batch2d_vertex( &q[0], x, y, uv[0], uv[1], color );
+	r_batch2d_vertex( &q[1], x + w, y, uv[2], uv[1], color );
+	r_batch2d_vertex( &q[2], x + w, y + h, uv[2], uv[3], color );
+	r_batch2d_vertex( &q[3], x, y + h, uv[0], uv[3], color );
+	return r_batch2d_quad( batch, q, true );
+}
+
+uint32_t r_batch2d_rgba( uint8_t r, uint8_t g, uint8_t b, uint8_t a )
+{
+	return (uint32_t)r | ( (uint32_t)g << 8 ) | ( (uint32_t)b << 16 ) | ( (uint32_t)a << 24 );
+}
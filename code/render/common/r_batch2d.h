@@ -0,0 +1,109 @@
+#ifndef R_BATCH2D_H
+#define R_BATCH2D_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "r_handles.h"
+
+//
+// Immediate-mode 2D batching. Every primitive is a quad of four vertices in
+// pixel coordinates, so the index buffer is the same 0 1 2 0 2 3 pattern for
+// all of them and the backend generates it once. Quads are appended to the
+// current command until the pipeline, the scissor or the texture changes;
+// setting the state again without changing it is free.
+//
+// Untextured primitives don't care about the texture: they mark their uvs
+// with R_BATCH2D_NO_UV and join whatever command is current, and a textured
+// quad joins a command that so far only holds untextured ones. Interleaving
+// panels with text from one atlas therefore stays a single command.
+//
+// Vertices match UiBatch_Vertex from ui_batch_pass.vtx.
+//
+
+// Four vertices per quad and 16-bit indices.
+#define R_BATCH2D_MAX_QUADS_PER_DRAW 16384
+#define R_BATCH2D_NO_UV -1.0f
+
+typedef struct R_Batch2DVertex
+{
+	float    pos[2];
+	float    uv[2];
+	uint32_t color; // RGBA8, red in the low byte
+} R_Batch2DVertex;
+
+typedef struct R_Batch2DRect
+{
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+} R_Batch2DRect;
+
+typedef struct R_Batch2DCommand
+{
+	R_Pipeline    pipeline;
+	const void   *texture; // backend texture, NULL for untextured commands
+	R_Batch2DRect scissor;
+	bool          scissorEnabled;
+	uint32_t      firstQuad;
+	uint32_t      quadCount;
+} R_Batch2DCommand;
+
+typedef struct R_Batch2DStats
+{
+	uint64_t quads;
+	uint64_t commands;
+	uint64_t pipelineSplits; // commands started because of each kind of state change
+	uint64_t textureSplits;
+	uint64_t scissorSplits;
+	uint64_t sizeSplits; // a command reached R_BATCH2D_MAX_QUADS_PER_DRAW
+} R_Batch2DStats;
+
+typedef struct R_Batch2D
+{
+	R_Batch2DVertex  *vertices;
+	uint32_t          quadCount;
+	uint32_t          quadCapacity;
+	R_Batch2DCommand *commands;
+	uint32_t          commandCount;
+	uint32_t          commandCapacity;
+
+	// State for the next primitive.
+	R_Pipeline    pipeline;
+	const void   *texture;
+	R_Batch2DRect scissor;
+	bool          scissorEnabled;
+
+	R_Batch2DStats stats;
+} R_Batch2D;
+
+bool r_batch2d_init( R_Batch2D *batch, uint32_t initialQuads );
+void r_batch2d_free( R_Batch2D *batch );
+// Drops the recorded geometry and resets the state, the stats keep accumulating.
+void r_batch2d_begin( R_Batch2D *batch );
+
+void r_batch2d_set_pipeline( R_Batch2D *batch, R_Pipeline pipeline );
+// The texture used by the following textured quads.
+void r_batch2d_set_texture( R_Batch2D *batch, const void *texture );
+// NULL disables scissoring. The pipeline needs ScissorEnable for the rect to clip anything.
+void r_batch2d_set_scissor( R_Batch2D *batch, const R_Batch2DRect *rect );
+
+// Corners in order top left, top right, bottom right, bottom left.
+bool r_batch2d_quad( R_Batch2D *batch, const R_Batch2DVertex corners[4], bool textured );
+bool r_batch2d_rect( R_Batch2D *batch, float x, float y, float w, float h, uint32_t color );
+// Four quads along the inside of the rect.
+bool r_batch2d_rect_outline( R_Batch2D *batch, float x, float y, float w, float h, float thickness, uint32_t color );
+bool r_batch2d_line( R_Batch2D *batch, float x0, float y0, float x1, float y1, float thickness, uint32_t color );
+bool r_batch2d_textured_quad( R_Batch2D  *batch,
+                              float       x,
+                              float       y,
+                              float       w,
+                              float       h,
+                              const float uv[4], // u0 v0 u1 v1
+                              uint32_t    color );
+
+uint32_t r_batch2d_rgba( uint8_t r, uint8_t g, uint8_t b, uint8_t a );
+
+#endif // R_BATCH2D_H
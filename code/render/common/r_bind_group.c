@@ -0,0 +1,132 @@
+#include "r_bind_group.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool r_bind_group_set_init( R_BindGroupSet *set, uint32_t capacity, size_t descSize )
+{
+	memset( set, 0, sizeof( *set ) );
+	if ( !r_pool_init( &set->pool, capacity ) || !r_hash_map_init( &set->lookup, 64 ) )
+		return false;
+
+	set->descs     = (uint8_t *)calloc( capacity, descSize );
+	set->descSize  = descSize;
+	set->slots     = (R_BindGroupSlots *)calloc( capacity, sizeof( R_BindGroupSlots ) );
+	set->refCounts = (uint32_t *)calloc( capacity, sizeof( uint32_t ) );
+	set->hashes    = (uint64_t *)calloc( capacity, sizeof( uint64_t ) );
+	return set->descs && set->slots && set->refCounts && set->hashes;
+}
+
+void r_bind_group_set_free( R_BindGroupSet *set )
+{
+	free( set->descs );
+	free( set->slots );
+	free( set->refCounts );
+	free( set->hashes );
+	r_hash_map_free( &set->lookup );
+	r_pool_free( &set->pool );
+	memset( set, 0, sizeof( *set ) );
+}
+
+uint32_t r_bind_group_set_acquire( R_BindGroupSet *set, const void *desc, uint64_t hash )
+{
+	uint32_t id = 0;
+	if ( !r_hash_map_get( &set->lookup, hash, &id ) )
+		return 0;
+
+	uint32_t i = r_pool_lookup( &set->pool, id );
+	if ( i == R_POOL_INVALID || memcmp( set->descs + i * set->descSize, desc, set->descSize ) != 0 )
+		return 0;
+	set->refCounts[i]++;
+	return id;
+}
+
+uint32_t r_bind_group_set_add( R_BindGroupSet         *set,
+                               const void             *desc,
+                               uint64_t                hash,
+                               const R_BindGroupSlots *slots,
+                               uint32_t               *outDense )
+{
+	uint32_t dense = 0;
+	uint32_t id    = r_pool_alloc( &set->pool, &dense );
+	if ( !id )
+		return 0;
+
+	memcpy( set->descs + dense * set->descSize, desc, set->descSize );
+	set->slots[dense]     = *slots;
+	set->refCounts[dense] = 1;
+	set->hashes[dense]    = hash;
+
+	// On a hash collision the first desc keeps the entry, the newcomer is simply never found again.
+	if ( !r_hash_map_get( &set->lookup, hash, NULL ) )
+		r_hash_map_put( &set->lookup, hash, id );
+	if ( outDense )
+		*outDense = dense;
+	return id;
+}
+
+bool r_bind_group_set_release( R_BindGroupSet *set, uint32_t id )
+{
+	uint32_t i = r_pool_lookup( &set->pool, id );
+	return i != R_POOL_INVALID && set->refCounts[i] > 0 && --set->refCounts[i] == 0;
+}
+
+void r_bind_group_set_remove( R_BindGroupSet *set, uint32_t id, uint32_t *outDense, uint32_t *outMovedFrom )
+{
+	uint32_t i      = r_pool_lookup( &set->pool, id );
+	uint32_t cached = 0;
+	if ( i != R_POOL_INVALID && r_hash_map_get( &set->lookup, set->hashes[i], &cached ) && cached == id )
+		r_hash_map_remove( &set->lookup, set->hashes[i] );
+
+	uint32_t dense = 0, moved = 0;
+	if ( r_pool_release( &set->pool, id, &dense, &moved ) && dense != moved )
+	{
+		memcpy( set->descs + dense * set->descSize, set->descs + moved * set->descSize, set->descSize );
+		set->slots[dense]     = set->slots[moved];
+		set->refCounts[dense] = set->refCounts[moved];
+		set->hashes[dense]    = set->hashes[moved];
+	}
+	if ( outDense )
+		*outDense = dense;
+	if ( outMovedFrom )
+		*outMovedFrom = moved;
+}
+
+void *r_bind_group_set_desc( R_BindGroupSet *set, uint32_t dense )
+{
+	return set->descs + dense * set->descSize;
+}
+
+void r_bound_groups_reset( R_BoundGroups *bound )
+{
+	memset( bound, 0, sizeof( *bound ) );
+}
+
+void r_bound_groups_forget( R_BoundGroups *bound, R_BindKind kind, R_ShaderStage stage, uint32_t slotMask )
+{
+	if ( kind < 0 || kind >= R_BIND_KIND_COUNT || stage < 0 || stage >= R_STAGE_COUNT )
+		return;
+	for ( uint32_t i = 0; i < R_BIND_GROUP_INDICES; ++i )
+	{
+		if ( bound->slots[i].masks[kind][stage] & slotMask )
+		{
+			bound->ids[i] = 0;
+			memset( &bound->slots[i], 0, sizeof( bound->slots[i] ) );
+		}
+	}
+}
+
+bool r_bound_groups_bind( R_BoundGroups *bound, uint32_t index, uint32_t id, const R_BindGroupSlots *slots )
+{
+	if ( index >= R_BIND_GROUP_INDICES || bound->ids[index] == id )
+		return false;
+
+	for ( int kind = 0; kind < R_BIND_KIND_COUNT; ++kind )
+	{
+		for ( int stage = 0; stage < R_STAGE_COUNT; ++stage )
+			r_bound_groups_forget( bound, (R_BindKind)kind, (R_ShaderStage)stage, slots->masks[kind][stage] );
+	}
+	bound->ids[index]   = id;
+	bound->slots[index] = *slots;
+	return true;
+}
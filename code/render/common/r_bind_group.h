@@ -0,0 +1,88 @@
+#ifndef R_BIND_GROUP_H
+#define R_BIND_GROUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "r_hash.h"
+#include "r_pool.h"
+#include "r_state_cache.h"
+
+//
+// The bookkeeping behind bind groups, none of which touches the API.
+//
+// A set hands out one reference-counted id per distinct desc: descs are found
+// by hash and compared byte for byte, so a collision makes a second group
+// rather than handing out the wrong one. The backend keeps what it resolved
+// for each group (buffers, the references it took) in arrays indexed like the
+// set's and mirrors the moves r_bind_group_set_remove makes, as with R_Pool.
+//
+// R_BoundGroups knows which group each bind index holds and the slots it
+// filled. Binding a group or any other bind call forgets the groups that
+// filled the slots it touches, so binding them again goes to the driver.
+//
+
+// Bind group indices that can be bound at once.
+#define R_BIND_GROUP_INDICES 4
+
+typedef enum
+{
+	R_BIND_CONSTANTS = 0,
+	R_BIND_TEXTURES,
+	R_BIND_SAMPLERS,
+	R_BIND_KIND_COUNT,
+} R_BindKind;
+
+// Bit per slot a bind group fills, by kind and stage.
+typedef struct R_BindGroupSlots
+{
+	uint32_t masks[R_BIND_KIND_COUNT][R_STAGE_COUNT];
+} R_BindGroupSlots;
+
+typedef struct R_BindGroupSet
+{
+	R_Pool            pool;
+	R_HashMap         lookup; // desc hash -> group id
+	uint8_t          *descs;  // descSize bytes per group, by dense index
+	size_t            descSize;
+	R_BindGroupSlots *slots;
+	uint32_t         *refCounts;
+	uint64_t         *hashes;
+} R_BindGroupSet;
+
+typedef struct R_BoundGroups
+{
+	uint32_t         ids[R_BIND_GROUP_INDICES]; // 0 once something else took one of the group's slots
+	R_BindGroupSlots slots[R_BIND_GROUP_INDICES];
+} R_BoundGroups;
+
+bool r_bind_group_set_init( R_BindGroupSet *set, uint32_t capacity, size_t descSize );
+void r_bind_group_set_free( R_BindGroupSet *set );
+
+// The group made from the same desc, with one more reference. 0 when there is none.
+uint32_t r_bind_group_set_acquire( R_BindGroupSet *set, const void *desc, uint64_t hash );
+// A new group with one reference, 0 when the set is full. outDense is where the caller keeps its own fields.
+uint32_t r_bind_group_set_add( R_BindGroupSet         *set,
+                               const void             *desc,
+                               uint64_t                hash,
+                               const R_BindGroupSlots *slots,
+                               uint32_t               *outDense );
+// Drops a reference. True when it was the last: the group stays until r_bind_group_set_remove, so the
+// caller can still release what it holds.
+bool r_bind_group_set_release( R_BindGroupSet *set, uint32_t id );
+// Takes out a group whose last reference was released. The entries at outMovedFrom move to outDense,
+// the caller moves its own the same way.
+void r_bind_group_set_remove( R_BindGroupSet *set, uint32_t id, uint32_t *outDense, uint32_t *outMovedFrom );
+
+// The copy of the desc the group at a dense index was added with.
+void *r_bind_group_set_desc( R_BindGroupSet *set, uint32_t dense );
+
+void r_bound_groups_reset( R_BoundGroups *bound );
+// Something else bound these slots: the groups that filled any of them are no longer bound.
+void r_bound_groups_forget( R_BoundGroups *bound, R_BindKind kind, R_ShaderStage stage, uint32_t slotMask );
+// False when the group is already bound at index. Otherwise forgets the groups it shares slots with
+// and records it, and the caller binds its slots.
+bool r_bound_groups_bind( R_BoundGroups *bound, uint32_t index, uint32_t id, const R_BindGroupSlots *slots );
+
+#endif // R_BIND_GROUP_H
@@ -0,0 +1,119 @@
+#include "r_bundle.h"
+#include "r_state_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool r_bundle_init( R_Bundle *bundle, size_t initialCapacity )
+{
+	memset( bundle, 0, sizeof( *bundle ) );
+	return r_draw_queue_init( &bundle->queue, initialCapacity );
+}
+
+void r_bundle_free( R_Bundle *bundle )
+{
+	r_draw_queue_free( &bundle->queue );
+	free( bundle->commands );
+	memset( bundle, 0, sizeof( *bundle ) );
+}
+
+void r_bundle_reset( R_Bundle *bundle )
+{
+	r_draw_queue_reset( &bundle->queue );
+	bundle->commandCount = 0;
+	bundle->draws        = 0;
+	bundle->epoch        = 0;
+	bundle->built        = false;
+	bundle->valid        = false;
+}
+
+bool r_bundle_push( R_Bundle *bundle, uint64_t key, const R_DrawPacket *packet )
+{
+	if ( !r_draw_queue_push( &bundle->queue, key, packet ) )
+		return false;
+	bundle->epoch = 0;
+	bundle->built = false;
+	return true;
+}
+
+static bool r_bundle_emit( R_Bundle *bundle, uint32_t type, uint32_t handle, uint32_t a, uint32_t b, uint32_t c )
+{
+	if ( bundle->commandCount == bundle->commandCapacity )
+	{
+		uint32_t         capacity = bundle->commandCapacity ? bundle->commandCapacity * 2 : 256;
+		R_BundleCommand *commands =
+		    (R_BundleCommand *)realloc( bundle->commands, capacity * sizeof( R_BundleCommand ) );
+		if ( !commands )
+			return false;
+		bundle->commands        = commands;
+		bundle->commandCapacity = capacity;
+	}
+
+	R_BundleCommand *cmd = &bundle->commands[bundle->commandCount++];
+	memset( cmd, 0, sizeof( *cmd ) );
+	cmd->type    = type;
+	cmd->handle  = handle;
+	cmd->args[0] = a;
+	cmd->args[1] = b;
+	cmd->args[2] = c;
+	return true;
+}
+
+bool r_bundle_build( R_Bundle *bundle )
+{
+	r_draw_queue_sort( &bundle->queue );
+	bundle->commandCount = 0;
+	bundle->draws        = 0;
+	bundle->epoch        = 0;
+	bundle->built        = false;
+
+	// The state left behind by the commands so far; nothing is known before the first packet.
+	const R_DrawPacket *prev = NULL;
+	uint32_t            constants[R_MAX_CONSTANT_BUFFER_SLOTS];
+	uint32_t            constantsKnown = 0;
+	bool                ok             = true;
+
+	for ( size_t i = 0; i < bundle->queue.count && ok; ++i )
+	{
+		const R_DrawPacket *p = r_draw_queue_get( &bundle->queue, i );
+
+		if ( !prev || p->pipeline.id != prev->pipeline.id )
+			ok = ok && r_bundle_emit( bundle, R_BUNDLE_CMD_PIPELINE, p->pipeline.id, 0, 0, 0 );
+		if ( !prev || p->vertexBuffer.id != prev->vertexBuffer.id || p->vertexStride != prev->vertexStride ||
+		     p->vertexOffset != prev->vertexOffset )
+			ok = ok && r_bundle_emit( bundle,
+			                          R_BUNDLE_CMD_VERTEX_BUFFER,
+			                          p->vertexBuffer.id,
+			                          p->vertexStride,
+			                          p->vertexOffset,
+			                          0 );
+		if ( !prev || p->indexBuffer.id != prev->indexBuffer.id || p->indexFormat != prev->indexFormat )
+			ok = ok && r_bundle_emit( bundle, R_BUNDLE_CMD_INDEX_BUFFER, p->indexBuffer.id, p->indexFormat, 0, 0 );
+
+		int slot = p->constantSlot;
+		if ( p->constants.id && slot >= 0 && slot < R_MAX_CONSTANT_BUFFER_SLOTS &&
+		     ( !( constantsKnown & ( 1u << slot ) ) || constants[slot] != p->constants.id ) )
+		{
+			ok = ok && r_bundle_emit( bundle, R_BUNDLE_CMD_CONSTANT_BUFFER, p->constants.id, (uint32_t)slot, 0, 0 );
+			constants[slot] = p->constants.id;
+			constantsKnown |= 1u << slot;
+		}
+
+		ok = ok && r_bundle_emit( bundle,
+		                          R_BUNDLE_CMD_DRAW_INDEXED,
+		                          0,
+		                          p->indexCount,
+		                          p->startIndex,
+		                          (uint32_t)p->baseVertex );
+		prev = p;
+	}
+
+	if ( !ok )
+	{
+		bundle->commandCount = 0;
+		return false;
+	}
+	bundle->draws = (uint32_t)bundle->queue.count;
+	bundle->built = true;
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef R_BUNDLE_H
+#define R_BUNDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "r_draw_queue.h"
+
+//
+// Retained draw bundles for static scenery. Packets are pushed once, like into
+// a draw queue, and r_bundle_build sorts them by key and turns them into a flat
+// list of commands, dropping every bind that repeats the state the previous
+// packet left behind.
+//
+// The backend resolves the commands' handles to its own objects when a bundle
+// is first executed and again only after one of its resources could have
+// changed (see r_execute_bundle), so executing is a loop over the commands
+// with no lookups or redundancy checks in it.
+//
+
+typedef enum
+{
+	R_BUNDLE_CMD_PIPELINE = 0,
+	R_BUNDLE_CMD_VERTEX_BUFFER,   // args: stride, offset
+	R_BUNDLE_CMD_INDEX_BUFFER,    // args: format
+	R_BUNDLE_CMD_CONSTANT_BUFFER, // args: slot
+	R_BUNDLE_CMD_DRAW_INDEXED,    // args: indexCount, startIndex, baseVertex
+} R_BundleCommandType;
+
+typedef struct R_BundleCommand
+{
+	uint32_t    type;
+	uint32_t    handle; // pipeline or buffer id, 0 for draws
+	uint32_t    args[3];
+	uint32_t    resolved; // filled in by the backend
+	uint32_t    flags;
+	const void *object;
+} R_BundleCommand;
+
+typedef struct R_Bundle
+{
+	R_DrawQueue      queue; // the recorded packets
+	R_BundleCommand *commands;
+	uint32_t         commandCount;
+	uint32_t         commandCapacity;
+	uint32_t         draws;
+	uint64_t         epoch; // backend epoch the commands were resolved against, 0 for never
+	bool             built;
+	bool             valid; // false when a resource the bundle references is gone
+} R_Bundle;
+
+bool r_bundle_init( R_Bundle *bundle, size_t initialCapacity );
+void r_bundle_free( R_Bundle *bundle );
+// Drops the recorded packets, for recording the bundle again.
+void r_bundle_reset( R_Bundle *bundle );
+bool r_bundle_push( R_Bundle *bundle, uint64_t key, const R_DrawPacket *packet );
+
+// Sorts the packets and builds the commands; r_execute_bundle does it on first use if needed.
+bool r_bundle_build( R_Bundle *bundle );
+
+#endif // R_BUNDLE_H
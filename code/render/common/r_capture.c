@@ -0,0 +1,311 @@
+#include "r_capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define R_CAPTURE_HEADER_SIZE 16
+#define R_CAPTURE_FIELD_ID 0
+#define R_CAPTURE_FIELD_REFS 1
+#define R_CAPTURE_FIELD_ARGS 5
+#define R_CAPTURE_FIELD_FLOATS 11
+#define R_CAPTURE_FIELD_DATA 15
+
+static const char r_capture_magic[4] = { 'R', 'C', 'A', 'P' };
+
+static const char *r_capture_op_names[R_CAPTURE_OP_COUNT] = {
+    "frame",
+    "present",
+    "create_buffer",
+    "update_buffer",
+    "upload_buffer",
+    "destroy_buffer",
+    "bind_constant_buffer",
+    "push_constants",
+    "create_vertex_shader",
+    "create_pixel_shader",
+    "destroy_vertex_shader",
+    "destroy_pixel_shader",
+    "create_input_layout",
+    "destroy_input_layout",
+    "create_pipeline",
+    "destroy_pipeline",
+    "bind_pipeline",
+    "set_vertex_buffer",
+    "set_index_buffer",
+    "set_topology",
+    "set_viewport",
+    "set_scissor",
+    "bind_texture",
+    "stream_vertices",
+    "bind_quad_indices",
+    "draw",
+    "draw_indexed",
+    "draw_indexed_instanced",
+    "clear",
+    "marker",
+    "copy_buffer",
+    "create_sampler",
+};
+
+const char *r_capture_op_name( R_CaptureOp op )
+{
+	return (unsigned)op < R_CAPTURE_OP_COUNT ? r_capture_op_names[op] : "unknown";
+}
+
+void r_capture_writer_init( R_CaptureWriter *writer )
+{
+	memset( writer, 0, sizeof( *writer ) );
+	r_capture_writer_reset( writer );
+}
+
+void r_capture_writer_free( R_CaptureWriter *writer )
+{
+	free( writer->data );
+	memset( writer, 0, sizeof( *writer ) );
+}
+
+static bool r_capture_reserve( R_CaptureWriter *writer, size_t bytes )
+{
+	if ( writer->failed )
+		return false;
+	if ( writer->size + bytes <= writer->capacity )
+		return true;
+
+	size_t capacity = writer->capacity ? writer->capacity : 64 * 1024;
+	while ( capacity < writer->size + bytes )
+		capacity *= 2;
+
+	uint8_t *data = (uint8_t *)realloc( writer->data, capacity );
+	if ( !data )
+	{
+		writer->failed = true;
+		return false;
+	}
+	writer->data     = data;
+	writer->capacity = capacity;
+	return true;
+}
+
+static void r_capture_put( R_CaptureWriter *writer, const void *data, size_t bytes )
+{
+	if ( !r_capture_reserve( writer, bytes ) )
+		return;
+	memcpy( writer->data + writer->size, data, bytes );
+	writer->size += bytes;
+}
+
+static void r_capture_put_u32( R_CaptureWriter *writer, uint32_t value )
+{
+	r_capture_put( writer, &value, sizeof( value ) );
+}
+
+void r_capture_writer_reset( R_CaptureWriter *writer )
+{
+	writer->size   = 0;
+	writer->calls  = 0;
+	writer->failed = false;
+
+	// The call count is patched in by r_capture_writer_save.
+	uint32_t header[3] = { R_CAPTURE_VERSION, 0, 0 };
+	r_capture_put( writer, r_capture_magic, sizeof( r_capture_magic ) );
+	r_capture_put( writer, header, sizeof( header ) );
+}
+
+// The 32-bit fields in file order: id, refs, args, floats.
+static const void *r_capture_field( const R_CaptureCall *call, int i )
+{
+	if ( i == R_CAPTURE_FIELD_ID )
+		return &call->id;
+	if ( i < R_CAPTURE_FIELD_ARGS )
+		return &call->refs[i - R_CAPTURE_FIELD_REFS];
+	if ( i < R_CAPTURE_FIELD_FLOATS )
+		return &call->args[i - R_CAPTURE_FIELD_ARGS];
+	return &call->floats[i - R_CAPTURE_FIELD_FLOATS];
+}
+
+static size_t r_capture_elements_size( const R_CaptureElement *elements, uint32_t count )
+{
+	size_t size = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+		size += 6 * sizeof( uint32_t ) + sizeof( uint16_t ) + strlen( elements[i].semantic );
+	return size;
+}
+
+void r_capture_write( R_CaptureWriter *writer, const R_CaptureCall *call )
+{
+	uint16_t mask = 0;
+	if ( call->id )
+		mask |= 1u << R_CAPTURE_FIELD_ID;
+	for ( int i = 0; i < 4; ++i )
+		mask |= call->refs[i] ? 1u << ( R_CAPTURE_FIELD_REFS + i ) : 0;
+	for ( int i = 0; i < 6; ++i )
+		mask |= call->args[i] ? 1u << ( R_CAPTURE_FIELD_ARGS + i ) : 0;
+	for ( int i = 0; i < 4; ++i )
+		mask |= call->floats[i] != 0.0f ? 1u << ( R_CAPTURE_FIELD_FLOATS + i ) : 0;
+	if ( call->size || call->elementCount )
+		mask |= 1u << R_CAPTURE_FIELD_DATA;
+
+	uint16_t op = (uint16_t)call->op;
+	r_capture_put( writer, &op, sizeof( op ) );
+	r_capture_put( writer, &mask, sizeof( mask ) );
+
+	for ( int i = 0; i < R_CAPTURE_FIELD_DATA; ++i )
+	{
+		if ( mask & ( 1u << i ) )
+			r_capture_put( writer, r_capture_field( call, i ), sizeof( uint32_t ) );
+	}
+
+	if ( call->elementCount )
+	{
+		r_capture_put_u32( writer, (uint32_t)r_capture_elements_size( call->elements, call->elementCount ) );
+		for ( uint32_t i = 0; i < call->elementCount; ++i )
+		{
+			const R_CaptureElement *e      = &call->elements[i];
+			uint16_t                length = (uint16_t)strlen( e->semantic );
+			uint32_t u[6] = { e->semanticIndex, e->format, e->slot, e->offset, e->perInstance, e->stepRate };
+			r_capture_put( writer, u, sizeof( u ) );
+			r_capture_put( writer, &length, sizeof( length ) );
+			r_capture_put( writer, e->semantic, length );
+		}
+	}
+	else if ( call->size )
+	{
+		r_capture_put_u32( writer, call->size );
+		r_capture_put( writer, call->data, call->size );
+	}
+
+	writer->calls++;
+}
+
+bool r_capture_writer_save( R_CaptureWriter *writer, const char *path )
+{
+	if ( writer->failed || writer->size < R_CAPTURE_HEADER_SIZE )
+		return false;
+
+	memcpy( writer->data + 8, &writer->calls, sizeof( writer->calls ) );
+
+	FILE *f = fopen( path, "wb" );
+	if ( !f )
+		return false;
+	bool ok = fwrite( writer->data, 1, writer->size, f ) == writer->size;
+	ok      = fclose( f ) == 0 && ok;
+	if ( !ok )
+		remove( path );
+	return ok;
+}
+
+bool r_capture_reader_init( R_CaptureReader *reader, const void *data, size_t size )
+{
+	memset( reader, 0, sizeof( *reader ) );
+
+	uint32_t version = 0;
+	if ( !data || size < R_CAPTURE_HEADER_SIZE || memcmp( data, r_capture_magic, sizeof( r_capture_magic ) ) != 0 )
+		return false;
+	memcpy( &version, (const uint8_t *)data + 4, sizeof( version ) );
+	if ( version != R_CAPTURE_VERSION )
+		return false;
+
+	reader->data = (const uint8_t *)data;
+	reader->size = size;
+	memcpy( &reader->calls, reader->data + 8, sizeof( reader->calls ) );
+	r_capture_reader_rewind( reader );
+	return true;
+}
+
+void r_capture_reader_rewind( R_CaptureReader *reader )
+{
+	reader->cursor    = R_CAPTURE_HEADER_SIZE;
+	reader->callsRead = 0;
+	reader->corrupt   = false;
+}
+
+static bool r_capture_get( R_CaptureReader *reader, void *out, size_t bytes )
+{
+	if ( bytes > reader->size - reader->cursor )
+		return false;
+	memcpy( out, reader->data + reader->cursor, bytes );
+	reader->cursor += bytes;
+	return true;
+}
+
+static bool r_capture_decode_elements( R_CaptureReader *reader, R_CaptureCall *call )
+{
+	const uint8_t *p   = (const uint8_t *)call->data;
+	const uint8_t *end = p + call->size;
+
+	uint32_t count = 0;
+	while ( p < end )
+	{
+		uint32_t u[6];
+		uint16_t length;
+		if ( count == R_CAPTURE_MAX_ELEMENTS || (size_t)( end - p ) < sizeof( u ) + sizeof( length ) )
+			return false;
+		memcpy( u, p, sizeof( u ) );
+		memcpy( &length, p + sizeof( u ), sizeof( length ) );
+		p += sizeof( u ) + sizeof( length );
+		if ( length >= sizeof( reader->names[0] ) || (size_t)( end - p ) < length )
+			return false;
+
+		char *name = reader->names[count];
+		memcpy( name, p, length );
+		name[length] = '\0';
+		p += length;
+
+		R_CaptureElement *e = &reader->elements[count++];
+		e->semantic         = name;
+		e->semanticIndex    = u[0];
+		e->format           = u[1];
+		e->slot             = u[2];
+		e->offset           = u[3];
+		e->perInstance      = u[4];
+		e->stepRate         = u[5];
+	}
+
+	call->elements     = reader->elements;
+	call->elementCount = count;
+	return true;
+}
+
+bool r_capture_reader_next( R_CaptureReader *reader, R_CaptureCall *outCall )
+{
+	if ( reader->corrupt || reader->callsRead == reader->calls )
+		return false;
+
+	memset( outCall, 0, sizeof( *outCall ) );
+
+	uint16_t op = 0, mask = 0;
+	bool     ok = r_capture_get( reader, &op, sizeof( op ) ) && r_capture_get( reader, &mask, sizeof( mask ) ) &&
+	          op < R_CAPTURE_OP_COUNT;
+	outCall->op = (R_CaptureOp)op;
+
+	for ( int i = 0; ok && i < R_CAPTURE_FIELD_DATA; ++i )
+	{
+		if ( !( mask & ( 1u << i ) ) )
+			continue;
+
+		ok = r_capture_get( reader, (void *)r_capture_field( outCall, i ), sizeof( uint32_t ) );
+	}
+
+	if ( ok && ( mask & ( 1u << R_CAPTURE_FIELD_DATA ) ) )
+	{
+		ok = r_capture_get( reader, &outCall->size, sizeof( outCall->size ) ) &&
+		     outCall->size <= reader->size - reader->cursor;
+		if ( ok )
+		{
+			outCall->data = reader->data + reader->cursor;
+			reader->cursor += outCall->size;
+		}
+	}
+
+	if ( ok && outCall->op == R_CAPTURE_CREATE_INPUT_LAYOUT )
+		ok = r_capture_decode_elements( reader, outCall );
+
+	if ( !ok )
+	{
+		reader->corrupt = true;
+		return false;
+	}
+	reader->callsRead++;
+	return true;
+}
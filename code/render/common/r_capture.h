@@ -0,0 +1,127 @@
+#ifndef R_CAPTURE_H
+#define R_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Frame captures. A capture is the stream of R_* calls of one frame, preceded by
+// setup calls that recreate every object alive when the frame began (buffer
+// contents, shader bytecode, layouts and pipelines included), so it replays on
+// its own. Calls are stored in one generic shape, R_CaptureCall, whose fields
+// each op documents below; fields left at zero cost nothing in the file.
+//
+// Handles are the ids the captured context handed out. Enum values (formats,
+// topologies, bind flags) and fixed-function state blocks are the backend's
+// own, D3D11 today, and are passed through untouched.
+//
+// The file is a 16-byte header followed by the calls, little endian:
+//   header: "RCAP", version, call count, reserved
+//   call:   u16 op, u16 field mask, one u32 per present field, then
+//           u32 size + bytes when the data bit is set
+//
+
+#define R_CAPTURE_VERSION 1
+#define R_CAPTURE_MAX_ELEMENTS 32
+
+typedef enum
+{
+	R_CAPTURE_FRAME = 0,             // end of the setup calls, the frame starts here
+	R_CAPTURE_PRESENT,               // end of the frame
+	R_CAPTURE_CREATE_BUFFER,         // id; args: dynamic, bindFlags, bytes; data: initial contents (optional)
+	R_CAPTURE_UPDATE_BUFFER,         // id; data
+	R_CAPTURE_UPLOAD_BUFFER,         // id; args: offset; data (r_queue_buffer_upload, callbacks aren't kept)
+	R_CAPTURE_DESTROY_BUFFER,        // id
+	R_CAPTURE_BIND_CONSTANT_BUFFER,  // id; args: slot
+	R_CAPTURE_PUSH_CONSTANTS,        // args: slot; data
+	R_CAPTURE_CREATE_VERTEX_SHADER,  // id; data: bytecode
+	R_CAPTURE_CREATE_PIXEL_SHADER,   // id; data: bytecode
+	R_CAPTURE_DESTROY_VERTEX_SHADER, // id
+	R_CAPTURE_DESTROY_PIXEL_SHADER,  // id
+	R_CAPTURE_CREATE_INPUT_LAYOUT,   // id; refs: vs; elements
+	R_CAPTURE_DESTROY_INPUT_LAYOUT,  // id
+	R_CAPTURE_CREATE_PIPELINE,       // id; refs: vs, ps, layout, fallback; args: rasterizer, blend and depth-stencil
+	                                 // block sizes, sampleMask, stencilRef; floats: blendFactor; data: the blocks
+	R_CAPTURE_DESTROY_PIPELINE,      // id
+	R_CAPTURE_BIND_PIPELINE,         // id
+	R_CAPTURE_SET_VERTEX_BUFFER,     // id; args: stride, offset
+	R_CAPTURE_SET_INDEX_BUFFER,      // id; args: format, offset
+	R_CAPTURE_SET_TOPOLOGY,          // args: topology
+	R_CAPTURE_SET_VIEWPORT,          // floats: x, y, w, h
+	R_CAPTURE_SET_SCISSOR,           // args: left, top, right, bottom
+	R_CAPTURE_BIND_TEXTURE,          // args: slot, bound; the texture's contents aren't captured
+	R_CAPTURE_STREAM_VERTICES,       // args: slot, stride, offset, bound at offset; data (backend vertex streams)
+	R_CAPTURE_BIND_QUAD_INDICES,     // the backend's shared 16-bit quad index buffer
+	R_CAPTURE_DRAW,                  // args: vertexCount, startVertex
+	R_CAPTURE_DRAW_INDEXED,          // args: indexCount, startIndex, baseVertex
+	R_CAPTURE_DRAW_INDEXED_INSTANCED, // args: indexCount, instanceCount, startIndex, baseVertex, startInstance
+	R_CAPTURE_CLEAR,                 // floats: colour
+	R_CAPTURE_MARKER,                // data: name (frame graph passes), not NUL terminated
+	R_CAPTURE_COPY_BUFFER,           // id: destination; refs: source; args: dstOffset, srcOffset, bytes
+	R_CAPTURE_CREATE_SAMPLER,        // id; data: the sampler desc (pipeline manifests, see r_precache.h)
+	R_CAPTURE_OP_COUNT,
+} R_CaptureOp;
+
+typedef struct R_CaptureElement
+{
+	const char *semantic;
+	uint32_t    semanticIndex;
+	uint32_t    format;
+	uint32_t    slot;
+	uint32_t    offset;
+	uint32_t    perInstance;
+	uint32_t    stepRate;
+} R_CaptureElement;
+
+typedef struct R_CaptureCall
+{
+	R_CaptureOp op;
+	uint32_t    id;
+	uint32_t    refs[4];
+	uint32_t    args[6]; // signed values (baseVertex) are stored as their two's complement
+	float       floats[4];
+	const void *data;
+	uint32_t    size;
+
+	// Input layouts only. Written from here, read back into storage the reader owns.
+	const R_CaptureElement *elements;
+	uint32_t                elementCount;
+} R_CaptureCall;
+
+typedef struct R_CaptureWriter
+{
+	uint8_t *data;
+	size_t   size;
+	size_t   capacity;
+	uint32_t calls;
+	bool     failed; // ran out of memory, the capture is incomplete
+} R_CaptureWriter;
+
+void r_capture_writer_init( R_CaptureWriter *writer );
+void r_capture_writer_free( R_CaptureWriter *writer );
+void r_capture_writer_reset( R_CaptureWriter *writer );
+void r_capture_write( R_CaptureWriter *writer, const R_CaptureCall *call );
+bool r_capture_writer_save( R_CaptureWriter *writer, const char *path );
+
+typedef struct R_CaptureReader
+{
+	const uint8_t   *data;
+	size_t           size;
+	size_t           cursor;
+	uint32_t         calls;
+	uint32_t         callsRead;
+	bool             corrupt; // stopped at a call that doesn't decode
+	R_CaptureElement elements[R_CAPTURE_MAX_ELEMENTS];
+	char             names[R_CAPTURE_MAX_ELEMENTS][64];
+} R_CaptureReader;
+
+// The reader doesn't copy: data has to outlive it (a file mapping, usually).
+bool r_capture_reader_init( R_CaptureReader *reader, const void *data, size_t size );
+void r_capture_reader_rewind( R_CaptureReader *reader );
+// Pointers in the call stay valid until the next call to r_capture_reader_next.
+bool r_capture_reader_next( R_CaptureReader *reader, R_CaptureCall *outCall );
+
+const char *r_capture_op_name( R_CaptureOp op );
+
+#endif // R_CAPTURE_H
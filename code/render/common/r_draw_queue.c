@@ -0,0 +1,160 @@
+#include "r_draw_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t r_draw_key_make( uint32_t pass, uint32_t pipelineId, uint32_t materialId, float depth )
+{
+	if ( !( depth > 0.0f ) ) // also catches NaN
+		depth = 0.0f;
+	if ( depth > 1.0f )
+		depth = 1.0f;
+
+	uint64_t depthMax = R_DRAW_KEY_MASK( R_DRAW_KEY_DEPTH_BITS );
+	uint64_t qdepth   = (uint64_t)( (double)depth * (double)depthMax );
+
+	return ( ( (uint64_t)pass & R_DRAW_KEY_MASK( R_DRAW_KEY_PASS_BITS ) ) << R_DRAW_KEY_PASS_SHIFT ) |
+	       ( ( (uint64_t)pipelineId & R_DRAW_KEY_MASK( R_DRAW_KEY_PIPELINE_BITS ) ) << R_DRAW_KEY_PIPELINE_SHIFT ) |
+	       ( ( (uint64_t)materialId & R_DRAW_KEY_MASK( R_DRAW_KEY_MATERIAL_BITS ) ) << R_DRAW_KEY_MATERIAL_SHIFT ) |
+	       ( qdepth << R_DRAW_KEY_DEPTH_SHIFT );
+}
+
+uint32_t r_draw_key_pass( uint64_t key )
+{
+	return (uint32_t)( ( key >> R_DRAW_KEY_PASS_SHIFT ) & R_DRAW_KEY_MASK( R_DRAW_KEY_PASS_BITS ) );
+}
+
+uint32_t r_draw_key_pipeline( uint64_t key )
+{
+	return (uint32_t)( ( key >> R_DRAW_KEY_PIPELINE_SHIFT ) & R_DRAW_KEY_MASK( R_DRAW_KEY_PIPELINE_BITS ) );
+}
+
+uint32_t r_draw_key_material( uint64_t key )
+{
+	return (uint32_t)( ( key >> R_DRAW_KEY_MATERIAL_SHIFT ) & R_DRAW_KEY_MASK( R_DRAW_KEY_MATERIAL_BITS ) );
+}
+
+static bool r_draw_queue_grow( R_DrawQueue *queue, size_t capacity )
+{
+	R_DrawPacket *packets = (R_DrawPacket *)realloc( queue->packets, capacity * sizeof( R_DrawPacket ) );
+	if ( !packets )
+		return false;
+	queue->packets = packets;
+
+	R_DrawSortItem *items = (R_DrawSortItem *)realloc( queue->items, capacity * sizeof( R_DrawSortItem ) );
+	if ( !items )
+		return false;
+	queue->items = items;
+
+	R_DrawSortItem *scratch = (R_DrawSortItem *)realloc( queue->scratch, capacity * sizeof( R_DrawSortItem ) );
+	if ( !scratch )
+		return false;
+	queue->scratch = scratch;
+
+	queue->capacity = capacity;
+	return true;
+}
+
+bool r_draw_queue_init( R_DrawQueue *queue, size_t initialCapacity )
+{
+	memset( queue, 0, sizeof( *queue ) );
+	if ( initialCapacity == 0 )
+		initialCapacity = 256;
+	if ( !r_draw_queue_grow( queue, initialCapacity ) )
+	{
+		r_draw_queue_free( queue );
+		return false;
+	}
+	return true;
+}
+
+void r_draw_queue_free( R_DrawQueue *queue )
+{
+	free( queue->packets );
+	free( queue->items );
+	free( queue->scratch );
+	memset( queue, 0, sizeof( *queue ) );
+}
+
+void r_draw_queue_reset( R_DrawQueue *queue )
+{
+	queue->count  = 0;
+	queue->sorted = false;
+}
+
+bool r_draw_queue_push( R_DrawQueue *queue, uint64_t key, const R_DrawPacket *packet )
+{
+	if ( queue->count == queue->capacity && !r_draw_queue_grow( queue, queue->capacity ? queue->capacity * 2 : 256 ) )
+		return false;
+
+	size_t index                = queue->count++;
+	queue->packets[index]       = *packet;
+	queue->items[index].key     = key;
+	queue->items[index].packet  = (uint32_t)index;
+	queue->items[index].padding = 0;
+	queue->sorted               = false;
+	return true;
+}
+
+void r_draw_queue_sort( R_DrawQueue *queue )
+{
+	size_t count = queue->count;
+	if ( queue->sorted || count < 2 )
+	{
+		queue->sorted = true;
+		return;
+	}
+
+	// All eight histograms in a single sweep over the keys.
+	uint32_t histogram[8][256];
+	memset( histogram, 0, sizeof( histogram ) );
+	for ( size_t i = 0; i < count; ++i )
+	{
+		uint64_t key = queue->items[i].key;
+		for ( int b = 0; b < 8; ++b )
+			histogram[b][( key >> ( b * 8 ) ) & 0xff]++;
+	}
+
+	R_DrawSortItem *src = queue->items;
+	R_DrawSortItem *dst = queue->scratch;
+
+	for ( int b = 0; b < 8; ++b )
+	{
+		uint32_t *h = histogram[b];
+
+		// Every key shares this byte, the pass would be an identity permutation.
+		uint64_t firstByte = ( src[0].key >> ( b * 8 ) ) & 0xff;
+		if ( h[firstByte] == count )
+			continue;
+
+		uint32_t offsets[256];
+		uint32_t sum = 0;
+		for ( int i = 0; i < 256; ++i )
+		{
+			offsets[i] = sum;
+			sum += h[i];
+		}
+
+		for ( size_t i = 0; i < count; ++i )
+		{
+			uint32_t digit        = (uint32_t)( ( src[i].key >> ( b * 8 ) ) & 0xff );
+			dst[offsets[digit]++] = src[i];
+		}
+
+		R_DrawSortItem *tmp = src;
+		src                 = dst;
+		dst                 = tmp;
+	}
+
+	// Keep the sorted run in items and the spare buffer in scratch.
+	queue->items   = src;
+	queue->scratch = dst;
+	queue->sorted  = true;
+}
+
+const R_DrawPacket *r_draw_queue_get( const R_DrawQueue *queue, size_t i )
+{
+	if ( i >= queue->count )
+		return NULL;
+	return &queue->packets[queue->items[i].packet];
+}
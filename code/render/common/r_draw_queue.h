@@ -0,0 +1,82 @@
+#ifndef R_DRAW_QUEUE_H
+#define R_DRAW_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "r_handles.h"
+
+//
+// 64-bit draw sort key, most significant field first:
+//
+//   [63..60] pass        (4 bits)
+//   [59..44] pipeline id (16 bits)
+//   [43..24] material id (20 bits)
+//   [23.. 0] depth       (24 bits, quantized from [0, 1])
+//
+// Sorting by the raw key groups draws by pass, then pipeline, then material,
+// and finally front to back inside a material.
+//
+
+#define R_DRAW_KEY_PASS_BITS 4
+#define R_DRAW_KEY_PIPELINE_BITS 16
+#define R_DRAW_KEY_MATERIAL_BITS 20
+#define R_DRAW_KEY_DEPTH_BITS 24
+
+#define R_DRAW_KEY_DEPTH_SHIFT 0
+#define R_DRAW_KEY_MATERIAL_SHIFT ( R_DRAW_KEY_DEPTH_SHIFT + R_DRAW_KEY_DEPTH_BITS )
+#define R_DRAW_KEY_PIPELINE_SHIFT ( R_DRAW_KEY_MATERIAL_SHIFT + R_DRAW_KEY_MATERIAL_BITS )
+#define R_DRAW_KEY_PASS_SHIFT ( R_DRAW_KEY_PIPELINE_SHIFT + R_DRAW_KEY_PIPELINE_BITS )
+
+#define R_DRAW_KEY_MASK( bits ) ( ( (uint64_t)1 << ( bits ) ) - 1 )
+
+typedef struct R_DrawPacket
+{
+	R_Pipeline pipeline;
+	R_Buffer   vertexBuffer;
+	uint32_t   vertexStride;
+	uint32_t   vertexOffset;
+	R_Buffer   indexBuffer;
+	uint32_t   indexFormat;
+	R_Buffer   constants;
+	int        constantSlot;
+	uint32_t   indexCount;
+	uint32_t   startIndex;
+	int32_t    baseVertex;
+} R_DrawPacket;
+
+typedef struct R_DrawSortItem
+{
+	uint64_t key;
+	uint32_t packet;
+	uint32_t padding;
+} R_DrawSortItem;
+
+typedef struct R_DrawQueue
+{
+	R_DrawPacket   *packets;
+	R_DrawSortItem *items;
+	R_DrawSortItem *scratch;
+	size_t          count;
+	size_t          capacity;
+	bool            sorted;
+} R_DrawQueue;
+
+uint64_t r_draw_key_make( uint32_t pass, uint32_t pipelineId, uint32_t materialId, float depth );
+uint32_t r_draw_key_pass( uint64_t key );
+uint32_t r_draw_key_pipeline( uint64_t key );
+uint32_t r_draw_key_material( uint64_t key );
+
+bool r_draw_queue_init( R_DrawQueue *queue, size_t initialCapacity );
+void r_draw_queue_free( R_DrawQueue *queue );
+void r_draw_queue_reset( R_DrawQueue *queue );
+bool r_draw_queue_push( R_DrawQueue *queue, uint64_t key, const R_DrawPacket *packet );
+
+// Stable LSD radix sort on the key; byte passes that can't change the order are skipped.
+void r_draw_queue_sort( R_DrawQueue *queue );
+
+// Packet at position i in key order, valid after r_draw_queue_sort.
+const R_DrawPacket *r_draw_queue_get( const R_DrawQueue *queue, size_t i );
+
+#endif // R_DRAW_QUEUE_H
@@ -0,0 +1,112 @@
+#include "r_dxbc.h"
+#include "r_hash.h"
+
+#include <string.h>
+
+// Container header: "DXBC", 16 byte checksum, version (1), total size, chunk count, chunk offsets.
+#define R_DXBC_HEADER_SIZE 32
+// ISGN element: name offset, semantic index, system value, component type, register, mask, rw mask, padding.
+#define R_DXBC_SIGNATURE_ELEMENT_SIZE 24
+
+static uint32_t r_dxbc_read_u32( const uint8_t *p )
+{
+	return (uint32_t)p[0] | ( (uint32_t)p[1] << 8 ) | ( (uint32_t)p[2] << 16 ) | ( (uint32_t)p[3] << 24 );
+}
+
+bool r_dxbc_find_chunk( const void *bytecode, size_t size, uint32_t fourcc, const uint8_t **outData, uint32_t *outSize )
+{
+	const uint8_t *blob = (const uint8_t *)bytecode;
+	if ( !blob || size < R_DXBC_HEADER_SIZE || r_dxbc_read_u32( blob ) != R_DXBC_FOURCC( 'D', 'X', 'B', 'C' ) )
+		return false;
+
+	uint32_t totalSize  = r_dxbc_read_u32( blob + 24 );
+	uint32_t chunkCount = r_dxbc_read_u32( blob + 28 );
+	if ( totalSize > size || totalSize < R_DXBC_HEADER_SIZE || chunkCount > ( totalSize - R_DXBC_HEADER_SIZE ) / 4 )
+		return false;
+
+	for ( uint32_t i = 0; i < chunkCount; ++i )
+	{
+		uint32_t offset = r_dxbc_read_u32( blob + R_DXBC_HEADER_SIZE + i * 4 );
+		if ( offset > totalSize - 8 )
+			return false;
+
+		uint32_t chunkSize = r_dxbc_read_u32( blob + offset + 4 );
+		if ( chunkSize > totalSize - offset - 8 )
+			return false;
+
+		if ( r_dxbc_read_u32( blob + offset ) == fourcc )
+		{
+			*outData = blob + offset + 8;
+			*outSize = chunkSize;
+			return true;
+		}
+	}
+	return false;
+}
+
+int r_dxbc_parse_signature( const uint8_t          *chunk,
+                            uint32_t                chunkSize,
+                            R_DxbcSignatureElement *outElements,
+                            int                     maxElements )
+{
+	if ( !chunk || chunkSize < 8 )
+		return -1;
+
+	uint32_t count = r_dxbc_read_u32( chunk );
+	uint32_t first = r_dxbc_read_u32( chunk + 4 );
+	if ( first > chunkSize || count > ( chunkSize - first ) / R_DXBC_SIGNATURE_ELEMENT_SIZE )
+		return -1;
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		const uint8_t *e          = chunk + first + i * R_DXBC_SIGNATURE_ELEMENT_SIZE;
+		uint32_t       nameOffset = r_dxbc_read_u32( e );
+
+		// Names are NUL terminated strings stored after the element table.
+		if ( nameOffset >= chunkSize || !memchr( chunk + nameOffset, 0, chunkSize - nameOffset ) )
+			return -1;
+
+		if ( outElements && (int)i < maxElements )
+		{
+			R_DxbcSignatureElement *out = &outElements[i];
+			out->semanticName           = (const char *)( chunk + nameOffset );
+			out->semanticIndex          = r_dxbc_read_u32( e + 4 );
+			out->systemValue            = r_dxbc_read_u32( e + 8 );
+			out->componentType          = r_dxbc_read_u32( e + 12 );
+			out->registerIndex          = r_dxbc_read_u32( e + 16 );
+			out->mask                   = e[20];
+			out->readWriteMask          = e[21];
+		}
+	}
+	return (int)count;
+}
+
+bool r_dxbc_input_signature_hash( const void *bytecode, size_t size, uint64_t *outHash )
+{
+	const uint8_t *chunk;
+	uint32_t       chunkSize;
+	if ( !r_dxbc_find_chunk( bytecode, size, R_DXBC_CHUNK_ISGN, &chunk, &chunkSize ) )
+		return false;
+
+	R_DxbcSignatureElement elements[R_DXBC_MAX_INPUT_ELEMENTS];
+	int                    count = r_dxbc_parse_signature( chunk, chunkSize, elements, R_DXBC_MAX_INPUT_ELEMENTS );
+	if ( count < 0 || count > R_DXBC_MAX_INPUT_ELEMENTS )
+		return false;
+
+	// Hash the decoded fields rather than the chunk, so name placement and padding don't matter.
+	uint64_t hash = r_hash_bytes( &count, sizeof( count ), R_HASH_SEED );
+	for ( int i = 0; i < count; ++i )
+	{
+		const R_DxbcSignatureElement *e = &elements[i];
+
+		hash = r_hash_string( e->semanticName, hash );
+		hash = r_hash_bytes( &e->semanticIndex, sizeof( e->semanticIndex ), hash );
+		hash = r_hash_bytes( &e->systemValue, sizeof( e->systemValue ), hash );
+		hash = r_hash_bytes( &e->componentType, sizeof( e->componentType ), hash );
+		hash = r_hash_bytes( &e->registerIndex, sizeof( e->registerIndex ), hash );
+		hash = r_hash_bytes( &e->mask, sizeof( e->mask ), hash );
+		hash = r_hash_bytes( &e->readWriteMask, sizeof( e->readWriteMask ), hash );
+	}
+	*outHash = hash;
+	return true;
+}
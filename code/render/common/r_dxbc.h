@@ -0,0 +1,46 @@
+#ifndef R_DXBC_H
+#define R_DXBC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Minimal reader for compiled shader containers (DXBC), enough to pull the
+// input signature out of a vertex shader without going through the runtime.
+// Everything is bounds checked against the blob size, malformed input just
+// makes the calls return false.
+//
+
+#define R_DXBC_FOURCC( a, b, c, d ) \
+	( (uint32_t)(a) | ( (uint32_t)(b) << 8 ) | ( (uint32_t)(c) << 16 ) | ( (uint32_t)(d) << 24 ) )
+
+#define R_DXBC_CHUNK_ISGN R_DXBC_FOURCC( 'I', 'S', 'G', 'N' )
+
+// D3D11_VS_INPUT_REGISTER_COUNT, a vertex shader can't declare more inputs than this.
+#define R_DXBC_MAX_INPUT_ELEMENTS 32
+
+typedef struct R_DxbcSignatureElement
+{
+	const char *semanticName; // points into the blob
+	uint32_t    semanticIndex;
+	uint32_t    systemValue;
+	uint32_t    componentType;
+	uint32_t    registerIndex;
+	uint8_t     mask;
+	uint8_t     readWriteMask;
+} R_DxbcSignatureElement;
+
+bool r_dxbc_find_chunk( const void *bytecode, size_t size, uint32_t fourcc, const uint8_t **outData, uint32_t *outSize );
+
+// Parses an ISGN chunk. Returns the element count (which may exceed maxElements,
+// only the first maxElements are written) or -1 if the chunk is malformed.
+int r_dxbc_parse_signature( const uint8_t          *chunk,
+                            uint32_t                chunkSize,
+                            R_DxbcSignatureElement *outElements,
+                            int                     maxElements );
+
+// Hash of the parsed input signature; two shaders with the same hash accept the same input layouts.
+bool r_dxbc_input_signature_hash( const void *bytecode, size_t size, uint64_t *outHash );
+
+#endif // R_DXBC_H
@@ -0,0 +1,414 @@
+#include "r_frame_graph.h"
+
+#include <string.h>
+
+void r_fg_reset( R_FrameGraph *graph )
+{
+	memset( graph, 0, sizeof( *graph ) );
+}
+
+static R_FgResource r_fg_add_resource( R_FrameGraph          *graph,
+                                       const char            *name,
+                                       const R_FgTextureDesc *desc,
+                                       void                  *external,
+                                       bool                   imported )
+{
+	R_FgResource handle = { 0 };
+	if ( !desc || graph->resourceCount == R_FG_MAX_RESOURCES || graph->nodeCount == R_FG_MAX_VERSIONS )
+	{
+		graph->invalid = true;
+		return handle;
+	}
+
+	uint32_t          index    = graph->resourceCount++;
+	R_FgResourceInfo *resource = &graph->resources[index];
+	memset( resource, 0, sizeof( *resource ) );
+	resource->name     = name;
+	resource->desc     = *desc;
+	resource->external = external;
+	resource->imported = imported;
+	resource->physical = R_FG_EXTERNAL;
+	resource->size     = (uint64_t)desc->width * desc->height * desc->bytesPerPixel;
+
+	R_FgNode *node = &graph->nodes[graph->nodeCount];
+	node->resource = index;
+	node->version  = 0;
+	node->producer = R_FG_EXTERNAL;
+	node->previous = R_FG_EXTERNAL;
+	node->written  = false;
+
+	handle.id = ++graph->nodeCount;
+	return handle;
+}
+
+R_FgResource r_fg_create_texture( R_FrameGraph *graph, const char *name, const R_FgTextureDesc *desc )
+{
+	return r_fg_add_resource( graph, name, desc, NULL, false );
+}
+
+R_FgResource r_fg_import_texture( R_FrameGraph *graph, const char *name, const R_FgTextureDesc *desc, void *external )
+{
+	return r_fg_add_resource( graph, name, desc, external, true );
+}
+
+uint32_t r_fg_add_pass( R_FrameGraph *graph, const char *name, R_FgExecuteFn execute, void *user )
+{
+	if ( graph->passCount == R_FG_MAX_PASSES )
+	{
+		graph->invalid = true;
+		return 0;
+	}
+
+	R_FgPass *pass = &graph->passes[graph->passCount++];
+	memset( pass, 0, sizeof( *pass ) );
+	pass->name    = name;
+	pass->execute = execute;
+	pass->user    = user;
+	return graph->passCount;
+}
+
+static R_FgPass *r_fg_pass( R_FrameGraph *graph, uint32_t pass )
+{
+	if ( pass == 0 || pass > graph->passCount )
+	{
+		graph->invalid = true;
+		return NULL;
+	}
+	return &graph->passes[pass - 1];
+}
+
+static bool r_fg_node_valid( const R_FrameGraph *graph, R_FgResource resource )
+{
+	return resource.id != 0 && resource.id <= graph->nodeCount;
+}
+
+void r_fg_read( R_FrameGraph *graph, uint32_t pass, R_FgResource resource )
+{
+	R_FgPass *p = r_fg_pass( graph, pass );
+	if ( !p || !r_fg_node_valid( graph, resource ) || p->readCount == R_FG_MAX_PASS_IO )
+	{
+		graph->invalid = true;
+		return;
+	}
+	p->reads[p->readCount++] = resource.id - 1;
+}
+
+R_FgResource r_fg_write( R_FrameGraph *graph, uint32_t pass, R_FgResource resource )
+{
+	R_FgResource handle = { 0 };
+	R_FgPass    *p      = r_fg_pass( graph, pass );
+	if ( !p || !r_fg_node_valid( graph, resource ) || p->writeCount == R_FG_MAX_PASS_IO ||
+	     graph->nodeCount == R_FG_MAX_VERSIONS || graph->nodes[resource.id - 1].written )
+	{
+		graph->invalid = true;
+		return handle;
+	}
+
+	R_FgNode *previous = &graph->nodes[resource.id - 1];
+	R_FgNode *node     = &graph->nodes[graph->nodeCount];
+	previous->written  = true;
+	node->resource     = previous->resource;
+	node->version      = previous->version + 1;
+	node->producer     = pass - 1;
+	node->previous     = resource.id - 1;
+	node->written      = false;
+
+	p->writes[p->writeCount++] = graph->nodeCount;
+	handle.id                  = ++graph->nodeCount;
+	return handle;
+}
+
+void r_fg_side_effect( R_FrameGraph *graph, uint32_t pass )
+{
+	R_FgPass *p = r_fg_pass( graph, pass );
+	if ( p )
+		p->sideEffect = true;
+}
+
+uint32_t r_fg_resource_index( const R_FrameGraph *graph, R_FgResource resource )
+{
+	return r_fg_node_valid( graph, resource ) ? graph->nodes[resource.id - 1].resource : R_FG_EXTERNAL;
+}
+
+// Marks everything the roots depend on, walking from readers back to producers.
+static void r_fg_cull( R_FrameGraph *graph )
+{
+	uint32_t stack[R_FG_MAX_PASSES];
+	uint32_t top = 0;
+
+	for ( uint32_t i = 0; i < graph->passCount; ++i )
+	{
+		R_FgPass *pass = &graph->passes[i];
+		pass->live     = pass->sideEffect;
+		for ( uint32_t w = 0; w < pass->writeCount && !pass->live; ++w )
+			pass->live = graph->resources[graph->nodes[pass->writes[w]].resource].imported;
+		if ( pass->live )
+			stack[top++] = i;
+	}
+
+	while ( top > 0 )
+	{
+		R_FgPass *pass = &graph->passes[stack[--top]];
+
+		uint32_t inputs[R_FG_MAX_PASS_IO * 2];
+		uint32_t inputCount = 0;
+		for ( uint32_t r = 0; r < pass->readCount; ++r )
+			inputs[inputCount++] = pass->reads[r];
+		for ( uint32_t w = 0; w < pass->writeCount; ++w )
+			inputs[inputCount++] = graph->nodes[pass->writes[w]].previous;
+
+		for ( uint32_t n = 0; n < inputCount; ++n )
+		{
+			uint32_t producer = graph->nodes[inputs[n]].producer;
+			if ( producer != R_FG_EXTERNAL && !graph->passes[producer].live )
+			{
+				graph->passes[producer].live = true;
+				stack[top++]                 = producer;
+			}
+		}
+	}
+}
+
+static bool r_fg_reads_node( const R_FgPass *pass, uint32_t node )
+{
+	for ( uint32_t r = 0; r < pass->readCount; ++r )
+		if ( pass->reads[r] == node )
+			return true;
+	return false;
+}
+
+// Topological order of the live passes. Among passes that are ready, declaration order wins,
+// so a graph without constraints runs exactly as it was written.
+static bool r_fg_sort( R_FrameGraph *graph )
+{
+	uint64_t deps[R_FG_MAX_PASSES] = { 0 };
+	uint64_t liveMask              = 0;
+
+	for ( uint32_t i = 0; i < graph->passCount; ++i )
+	{
+		const R_FgPass *pass = &graph->passes[i];
+		if ( !pass->live )
+			continue;
+		liveMask |= 1ull << i;
+
+		for ( uint32_t r = 0; r < pass->readCount; ++r )
+		{
+			uint32_t producer = graph->nodes[pass->reads[r]].producer;
+			if ( producer != R_FG_EXTERNAL )
+				deps[i] |= 1ull << producer;
+		}
+
+		for ( uint32_t w = 0; w < pass->writeCount; ++w )
+		{
+			// After whoever produced the version being written over, and after everyone reading it.
+			uint32_t previous = graph->nodes[pass->writes[w]].previous;
+			uint32_t producer = graph->nodes[previous].producer;
+			if ( producer != R_FG_EXTERNAL )
+				deps[i] |= 1ull << producer;
+
+			for ( uint32_t j = 0; j < graph->passCount; ++j )
+				if ( j != i && r_fg_reads_node( &graph->passes[j], previous ) )
+					deps[i] |= 1ull << j;
+		}
+		deps[i] &= ~( 1ull << i );
+	}
+
+	uint64_t scheduled  = 0;
+	graph->orderCount   = 0;
+	uint32_t liveCount  = 0;
+	for ( uint32_t i = 0; i < graph->passCount; ++i )
+		liveCount += graph->passes[i].live ? 1 : 0;
+
+	while ( graph->orderCount < liveCount )
+	{
+		uint32_t next = R_FG_EXTERNAL;
+		for ( uint32_t i = 0; i < graph->passCount && next == R_FG_EXTERNAL; ++i )
+		{
+			uint64_t bit = 1ull << i;
+			// Culled passes can't be depended on by live ones, so they never block.
+			if ( ( liveMask & bit ) && !( scheduled & bit ) && ( deps[i] & liveMask & ~scheduled ) == 0 )
+				next = i;
+		}
+		if ( next == R_FG_EXTERNAL )
+			return false; // cycle
+
+		scheduled |= 1ull << next;
+		graph->order[graph->orderCount++] = next;
+	}
+	return true;
+}
+
+static bool r_fg_descs_compatible( const R_FgTextureDesc *a, const R_FgTextureDesc *b )
+{
+	return a->width == b->width && a->height == b->height && a->format == b->format && a->depth == b->depth &&
+	       a->bytesPerPixel == b->bytesPerPixel;
+}
+
+static bool r_fg_lifetimes_overlap( const R_FgResourceInfo *a, const R_FgResourceInfo *b )
+{
+	return a->firstUse <= b->lastUse && b->firstUse <= a->lastUse;
+}
+
+static uint64_t r_fg_align( uint64_t value )
+{
+	return ( value + R_FG_HEAP_ALIGNMENT - 1 ) & ~(uint64_t)( R_FG_HEAP_ALIGNMENT - 1 );
+}
+
+// Two plans from the same lifetimes. Physical reuse hands a texture to a later resource with an
+// identical desc, the only aliasing D3D11 can express. The heap plan places every transient at an
+// offset no other resource alive at the same time overlaps, for APIs with placed resources.
+static void r_fg_plan_memory( R_FrameGraph *graph )
+{
+	uint32_t transients[R_FG_MAX_RESOURCES];
+	uint32_t count = 0;
+
+	for ( uint32_t i = 0; i < graph->resourceCount; ++i )
+	{
+		R_FgResourceInfo *resource = &graph->resources[i];
+		resource->firstUse         = R_FG_EXTERNAL;
+		resource->lastUse          = 0;
+		resource->physical         = R_FG_EXTERNAL;
+		resource->offset           = 0;
+	}
+
+	for ( uint32_t position = 0; position < graph->orderCount; ++position )
+	{
+		const R_FgPass *pass = &graph->passes[graph->order[position]];
+		for ( uint32_t n = 0; n < pass->readCount + pass->writeCount; ++n )
+		{
+			uint32_t          node     = n < pass->readCount ? pass->reads[n] : pass->writes[n - pass->readCount];
+			R_FgResourceInfo *resource = &graph->resources[graph->nodes[node].resource];
+			if ( resource->firstUse == R_FG_EXTERNAL )
+				resource->firstUse = position;
+			resource->lastUse = position;
+		}
+	}
+
+	// Transients in order of first use, the physical pass below depends on it.
+	for ( uint32_t i = 0; i < graph->resourceCount; ++i )
+	{
+		const R_FgResourceInfo *resource = &graph->resources[i];
+		if ( resource->imported || resource->firstUse == R_FG_EXTERNAL )
+			continue;
+
+		uint32_t at = count++;
+		while ( at > 0 && graph->resources[transients[at - 1]].firstUse > resource->firstUse )
+		{
+			transients[at] = transients[at - 1];
+			at--;
+		}
+		transients[at] = i;
+	}
+
+	uint32_t physicalLastUse[R_FG_MAX_RESOURCES];
+	graph->physicalCount = 0;
+	for ( uint32_t t = 0; t < count; ++t )
+	{
+		R_FgResourceInfo *resource = &graph->resources[transients[t]];
+
+		uint32_t slot = R_FG_EXTERNAL;
+		for ( uint32_t s = 0; s < graph->physicalCount && slot == R_FG_EXTERNAL; ++s )
+			if ( physicalLastUse[s] < resource->firstUse &&
+			     r_fg_descs_compatible( &graph->physicalDescs[s], &resource->desc ) )
+				slot = s;
+
+		if ( slot == R_FG_EXTERNAL )
+		{
+			slot                       = graph->physicalCount++;
+			graph->physicalDescs[slot] = resource->desc;
+			graph->stats.physicalBytes += resource->size;
+		}
+		physicalLastUse[slot] = resource->lastUse;
+		resource->physical    = slot;
+		graph->stats.totalBytes += resource->size;
+	}
+
+	// Largest first, each at the lowest offset clear of everything placed that overlaps it in time.
+	uint32_t bySize[R_FG_MAX_RESOURCES];
+	memcpy( bySize, transients, count * sizeof( uint32_t ) );
+	for ( uint32_t i = 1; i < count; ++i )
+	{
+		uint32_t value = bySize[i];
+		uint32_t at    = i;
+		while ( at > 0 && graph->resources[bySize[at - 1]].size < graph->resources[value].size )
+		{
+			bySize[at] = bySize[at - 1];
+			at--;
+		}
+		bySize[at] = value;
+	}
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		R_FgResourceInfo *resource = &graph->resources[bySize[i]];
+
+		uint32_t overlapping[R_FG_MAX_RESOURCES];
+		uint32_t overlapCount = 0;
+		for ( uint32_t j = 0; j < i; ++j )
+		{
+			uint32_t placed = bySize[j];
+			if ( !r_fg_lifetimes_overlap( resource, &graph->resources[placed] ) )
+				continue;
+
+			uint32_t at = overlapCount++;
+			while ( at > 0 && graph->resources[overlapping[at - 1]].offset > graph->resources[placed].offset )
+			{
+				overlapping[at] = overlapping[at - 1];
+				at--;
+			}
+			overlapping[at] = placed;
+		}
+
+		uint64_t offset = 0;
+		for ( uint32_t j = 0; j < overlapCount; ++j )
+		{
+			const R_FgResourceInfo *other = &graph->resources[overlapping[j]];
+			if ( offset + resource->size <= other->offset )
+				break;
+			uint64_t end = r_fg_align( other->offset + other->size );
+			if ( end > offset )
+				offset = end;
+		}
+
+		resource->offset = offset;
+		if ( offset + resource->size > graph->stats.heapBytes )
+			graph->stats.heapBytes = offset + resource->size;
+	}
+
+	graph->stats.transients    = count;
+	graph->stats.physicalCount = graph->physicalCount;
+}
+
+bool r_fg_compile( R_FrameGraph *graph )
+{
+	graph->compiled = false;
+	memset( &graph->stats, 0, sizeof( graph->stats ) );
+	if ( graph->invalid )
+		return false;
+
+	r_fg_cull( graph );
+	if ( !r_fg_sort( graph ) )
+		return false;
+
+	r_fg_plan_memory( graph );
+
+	graph->stats.passes       = graph->passCount;
+	graph->stats.culledPasses = graph->passCount - graph->orderCount;
+	graph->compiled           = true;
+	return true;
+}
+
+void r_fg_execute( const R_FrameGraph *graph, R_FgBeginPassFn beginPass, void *context )
+{
+	if ( !graph->compiled )
+		return;
+
+	for ( uint32_t i = 0; i < graph->orderCount; ++i )
+	{
+		const R_FgPass *pass = &graph->passes[graph->order[i]];
+		if ( beginPass )
+			beginPass( context, graph, graph->order[i] );
+		if ( pass->execute )
+			pass->execute( pass->user, context );
+	}
+}
@@ -0,0 +1,138 @@
+#ifndef R_FRAME_GRAPH_H
+#define R_FRAME_GRAPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Frame graph. Passes declare the resources they read and write; r_fg_compile
+// culls every pass whose output nobody consumes, orders the rest by their
+// dependencies and plans memory for the transient textures from their
+// lifetimes. Nothing in here touches a graphics API: the backend realizes the
+// plan and binds targets around each pass (see r_fg_execute).
+//
+// Writing a resource returns a new version of its handle. Readers name the
+// version they want, which is what defines the edges, so passes can be added
+// in any order. Passes that write imported resources (the back buffer) or are
+// flagged with r_fg_side_effect are the roots that keep the rest alive.
+//
+
+#define R_FG_MAX_PASSES 64
+#define R_FG_MAX_RESOURCES 64
+#define R_FG_MAX_VERSIONS 256
+#define R_FG_MAX_PASS_IO 8
+// Placement alignment for the heap plan, what D3D12/Vulkan ask of render targets.
+#define R_FG_HEAP_ALIGNMENT ( 64 * 1024 )
+#define R_FG_EXTERNAL 0xffffffffu
+
+typedef struct R_FgResource
+{
+	uint32_t id; // version node + 1, 0 is "no resource"
+} R_FgResource;
+
+typedef struct R_FgTextureDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;        // backend format, a DXGI_FORMAT on D3D11
+	uint32_t bytesPerPixel; // only feeds the memory planner
+	bool     depth;
+	bool     clear;         // cleared when its first writer starts
+	float    clearColor[4]; // depth clears to clearColor[0]
+} R_FgTextureDesc;
+
+typedef void ( *R_FgExecuteFn )( void *user, void *context );
+
+typedef struct R_FgPass
+{
+	const char   *name;
+	R_FgExecuteFn execute;
+	void         *user;
+	uint32_t      reads[R_FG_MAX_PASS_IO]; // version nodes
+	uint32_t      writes[R_FG_MAX_PASS_IO];
+	uint32_t      readCount;
+	uint32_t      writeCount;
+	bool          sideEffect;
+	bool          live; // survived culling
+} R_FgPass;
+
+typedef struct R_FgNode
+{
+	uint32_t resource;
+	uint32_t version;
+	uint32_t producer; // pass index, R_FG_EXTERNAL for the initial version
+	uint32_t previous; // node this version was written over, R_FG_EXTERNAL for the initial version
+	bool     written;  // a newer version exists already
+} R_FgNode;
+
+typedef struct R_FgResourceInfo
+{
+	const char     *name;
+	R_FgTextureDesc desc;
+	void           *external; // imported resources only
+	bool            imported;
+
+	// Filled in by r_fg_compile; transients no live pass touches get no memory.
+	uint32_t firstUse; // position in the execution order
+	uint32_t lastUse;
+	uint32_t physical; // index into physicalDescs, R_FG_EXTERNAL if imported or unused
+	uint64_t offset;   // placement in the aliased heap
+	uint64_t size;
+} R_FgResourceInfo;
+
+typedef struct R_FgStats
+{
+	uint32_t passes;
+	uint32_t culledPasses;
+	uint32_t transients;    // transient textures in use after culling
+	uint32_t physicalCount; // textures actually created when equal descs are reused
+	uint64_t totalBytes;    // every transient with its own memory
+	uint64_t physicalBytes; // with desc-compatible reuse (what D3D11 can do)
+	uint64_t heapBytes;     // with placed aliasing in one heap
+} R_FgStats;
+
+typedef struct R_FrameGraph
+{
+	R_FgPass         passes[R_FG_MAX_PASSES];
+	R_FgResourceInfo resources[R_FG_MAX_RESOURCES];
+	R_FgNode         nodes[R_FG_MAX_VERSIONS];
+	uint32_t         passCount;
+	uint32_t         resourceCount;
+	uint32_t         nodeCount;
+	bool             invalid; // a declaration failed, compile refuses the graph
+
+	// Compiled state.
+	uint32_t        order[R_FG_MAX_PASSES];
+	uint32_t        orderCount;
+	R_FgTextureDesc physicalDescs[R_FG_MAX_RESOURCES];
+	uint32_t        physicalCount;
+	bool            compiled;
+	R_FgStats       stats;
+} R_FrameGraph;
+
+void r_fg_reset( R_FrameGraph *graph );
+
+R_FgResource r_fg_create_texture( R_FrameGraph *graph, const char *name, const R_FgTextureDesc *desc );
+R_FgResource r_fg_import_texture( R_FrameGraph *graph, const char *name, const R_FgTextureDesc *desc, void *external );
+
+// Pass ids are 1-based, 0 when the graph is full.
+uint32_t     r_fg_add_pass( R_FrameGraph *graph, const char *name, R_FgExecuteFn execute, void *user );
+void         r_fg_read( R_FrameGraph *graph, uint32_t pass, R_FgResource resource );
+// Returns the version later readers have to name. A write continues from the version it's given, so
+// its producer stays alive and runs first; every version can be written only once.
+R_FgResource r_fg_write( R_FrameGraph *graph, uint32_t pass, R_FgResource resource );
+// Keeps a pass alive even though nothing reads what it writes (readbacks, queries, ...).
+void         r_fg_side_effect( R_FrameGraph *graph, uint32_t pass );
+
+// False for invalid graphs and dependency cycles.
+bool r_fg_compile( R_FrameGraph *graph );
+
+// Called before each live pass, so the backend can bind the pass's targets.
+typedef void ( *R_FgBeginPassFn )( void *context, const R_FrameGraph *graph, uint32_t passIndex );
+void r_fg_execute( const R_FrameGraph *graph, R_FgBeginPassFn beginPass, void *context );
+
+// Resource index behind a handle of any version, R_FG_EXTERNAL for invalid handles.
+uint32_t r_fg_resource_index( const R_FrameGraph *graph, R_FgResource resource );
+
+#endif // R_FRAME_GRAPH_H
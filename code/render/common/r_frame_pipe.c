@@ -0,0 +1,177 @@
+#include "r_frame_pipe.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define R_FRAME_CONSTANT_ALIGNMENT 16
+
+bool r_frame_pipe_init( R_FramePipe *pipe, size_t drawCapacity, size_t constantCapacity )
+{
+	memset( pipe, 0, sizeof( *pipe ) );
+	sys_mutex_init( &pipe->mutex );
+	sys_cond_init( &pipe->wake );
+	for ( int i = 0; i < R_FRAME_PIPE_DEPTH; ++i )
+	{
+		R_FramePacket *packet    = &pipe->packets[i];
+		packet->constants        = (uint8_t *)malloc( constantCapacity ? constantCapacity : 1 );
+		packet->constantCapacity = constantCapacity;
+		if ( !packet->constants || !r_draw_queue_init( &packet->draws, drawCapacity ) )
+		{
+			r_frame_pipe_free( pipe );
+			return false;
+		}
+	}
+	return true;
+}
+
+void r_frame_pipe_free( R_FramePipe *pipe )
+{
+	for ( int i = 0; i < R_FRAME_PIPE_DEPTH; ++i )
+	{
+		r_draw_queue_free( &pipe->packets[i].draws );
+		free( pipe->packets[i].constants );
+	}
+	sys_cond_destroy( &pipe->wake );
+	sys_mutex_destroy( &pipe->mutex );
+	memset( pipe, 0, sizeof( *pipe ) );
+}
+
+static bool r_frame_slot_free( R_FramePipe *pipe )
+{
+	return sys_atomic_load( &pipe->submitted ) - sys_atomic_load( &pipe->released ) < R_FRAME_PIPE_DEPTH;
+}
+
+static bool r_frame_ready( R_FramePipe *pipe )
+{
+	return sys_atomic_load( &pipe->submitted ) > sys_atomic_load( &pipe->released ) ||
+	       sys_atomic_load( &pipe->closed );
+}
+
+// Whoever waits announces it in sleepers before its last look at the counters, and the other side
+// publishes before it looks at sleepers, so one of the two always sees the other.
+static void r_frame_pipe_wait( R_FramePipe *pipe, bool ( *ready )( R_FramePipe * ) )
+{
+	for ( int i = 0; i < R_FRAME_PIPE_SPINS; ++i )
+	{
+		if ( ready( pipe ) )
+			return;
+	}
+
+	sys_atomic_add( &pipe->parks, 1 );
+	sys_atomic_add( &pipe->sleepers, 1 );
+	sys_mutex_lock( &pipe->mutex );
+	while ( !ready( pipe ) )
+		sys_cond_wait( &pipe->wake, &pipe->mutex );
+	sys_mutex_unlock( &pipe->mutex );
+	sys_atomic_add( &pipe->sleepers, -1 );
+}
+
+static void r_frame_pipe_wake( R_FramePipe *pipe )
+{
+	if ( !sys_atomic_load( &pipe->sleepers ) )
+		return;
+	sys_mutex_lock( &pipe->mutex );
+	sys_cond_broadcast( &pipe->wake );
+	sys_mutex_unlock( &pipe->mutex );
+}
+
+R_FramePacket *r_frame_pipe_begin( R_FramePipe *pipe )
+{
+	if ( pipe->building || sys_atomic_load( &pipe->closed ) )
+		return NULL;
+
+	if ( !r_frame_slot_free( pipe ) )
+	{
+		pipe->producerStalls++;
+		r_frame_pipe_wait( pipe, r_frame_slot_free );
+	}
+
+	uint64_t       frame  = (uint64_t)sys_atomic_load( &pipe->submitted );
+	R_FramePacket *packet = &pipe->packets[frame % R_FRAME_PIPE_DEPTH];
+	r_draw_queue_reset( &packet->draws );
+	packet->frame         = frame;
+	packet->time          = 0.0f;
+	packet->deltaTime     = 0.0f;
+	packet->viewCount     = 0;
+	packet->constantBytes = 0;
+	pipe->building        = true;
+	return packet;
+}
+
+void r_frame_pipe_submit( R_FramePipe *pipe )
+{
+	if ( !pipe->building )
+		return;
+	pipe->building = false;
+	sys_atomic_add( &pipe->submitted, 1 );
+	r_frame_pipe_wake( pipe );
+}
+
+void r_frame_pipe_close( R_FramePipe *pipe )
+{
+	pipe->building = false;
+	sys_atomic_store( &pipe->closed, 1 );
+	r_frame_pipe_wake( pipe );
+}
+
+R_FramePacket *r_frame_pipe_acquire( R_FramePipe *pipe )
+{
+	if ( pipe->acquired )
+		return NULL;
+
+	if ( !r_frame_ready( pipe ) )
+	{
+		pipe->consumerStalls++;
+		r_frame_pipe_wait( pipe, r_frame_ready );
+	}
+
+	// Closing doesn't drop what was submitted before it.
+	uint64_t frame = (uint64_t)sys_atomic_load( &pipe->released );
+	if ( (uint64_t)sys_atomic_load( &pipe->submitted ) == frame )
+		return NULL;
+
+	pipe->acquired = true;
+	return &pipe->packets[frame % R_FRAME_PIPE_DEPTH];
+}
+
+void r_frame_pipe_release( R_FramePipe *pipe )
+{
+	if ( !pipe->acquired )
+		return;
+	pipe->acquired = false;
+	sys_atomic_add( &pipe->released, 1 );
+	r_frame_pipe_wake( pipe );
+}
+
+uint32_t r_frame_packet_push_constants( R_FramePacket *packet, const void *data, size_t size )
+{
+	size_t align  = R_FRAME_CONSTANT_ALIGNMENT;
+	size_t offset = ( packet->constantBytes + align - 1 ) & ~( align - 1 );
+	if ( offset > packet->constantCapacity || size > packet->constantCapacity - offset || offset >= UINT32_MAX )
+		return UINT32_MAX;
+
+	memcpy( packet->constants + offset, data, size );
+	packet->constantBytes = offset + size;
+	return (uint32_t)offset;
+}
+
+const void *r_frame_packet_constants( const R_FramePacket *packet, uint32_t offset )
+{
+	return offset < packet->constantBytes ? packet->constants + offset : NULL;
+}
+
+bool r_frame_packet_add_view( R_FramePacket *packet, const R_FrameView *view )
+{
+	if ( packet->viewCount == R_FRAME_MAX_VIEWS )
+		return false;
+	packet->views[packet->viewCount++] = *view;
+	return true;
+}
+
+void r_frame_pipe_get_stats( R_FramePipe *pipe, R_FramePipeStats *outStats )
+{
+	outStats->frames         = (uint64_t)sys_atomic_load( &pipe->released );
+	outStats->producerStalls = pipe->producerStalls;
+	outStats->consumerStalls = pipe->consumerStalls;
+	outStats->parks          = (uint64_t)sys_atomic_load( &pipe->parks );
+}
@@ -0,0 +1,98 @@
+#ifndef R_FRAME_PIPE_H
+#define R_FRAME_PIPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_thread.h"
+#include "r_draw_queue.h"
+
+//
+// Frame pipelining between a game thread and a render thread. The game thread
+// fills frame N+1's packet (views, draw list, constant data) while the render
+// thread submits frame N from the other one, so a frame costs about the slower
+// of the two instead of their sum.
+//
+// One producer, one consumer. The hand-off is two counters only ever written
+// by one side each, frames submitted and frames released; a side that can't go
+// on spins a while and then parks, and the other one only takes the lock to
+// wake it when it's actually parked. The game thread is never more than
+// R_FRAME_PIPE_DEPTH - 1 frames ahead of what is on screen.
+//
+
+#define R_FRAME_PIPE_DEPTH 2
+#define R_FRAME_MAX_VIEWS 4
+// Spins before a waiting side parks; a frame's worth of work on the other side is well beyond it.
+#define R_FRAME_PIPE_SPINS 4096
+
+typedef struct R_FrameView
+{
+	float    view[16];
+	float    projection[16];
+	float    position[4];
+	uint32_t pass; // draw key pass the view renders
+} R_FrameView;
+
+typedef struct R_FramePacket
+{
+	uint64_t    frame;
+	float       time;
+	float       deltaTime;
+	R_FrameView views[R_FRAME_MAX_VIEWS];
+	uint32_t    viewCount;
+	R_DrawQueue draws;
+	uint8_t    *constants; // cbuffer data, copied to the GPU on the render thread
+	size_t      constantBytes;
+	size_t      constantCapacity;
+} R_FramePacket;
+
+typedef struct R_FramePipeStats
+{
+	uint64_t frames;
+	uint64_t producerStalls; // begins that found the render thread still on the packet
+	uint64_t consumerStalls; // acquires that found no frame ready
+	uint64_t parks;          // waits that went to sleep instead of just spinning
+} R_FramePipeStats;
+
+typedef struct R_FramePipe
+{
+	R_FramePacket packets[R_FRAME_PIPE_DEPTH];
+	SYS_Atomic64  submitted;
+	SYS_Atomic64  released;
+	SYS_Atomic64  closed;
+	SYS_Atomic64  sleepers;
+	SYS_Mutex     mutex;
+	SYS_Cond      wake;
+	uint64_t      producerStalls;
+	uint64_t      consumerStalls;
+	SYS_Atomic64  parks;
+	bool          building; // between begin and submit, game thread only
+	bool          acquired; // between acquire and release, render thread only
+} R_FramePipe;
+
+bool r_frame_pipe_init( R_FramePipe *pipe, size_t drawCapacity, size_t constantCapacity );
+// Both threads have to be done with the pipe.
+void r_frame_pipe_free( R_FramePipe *pipe );
+
+// Game thread. Waits until the render thread is done with the packet the next frame goes into,
+// and hands it over reset.
+R_FramePacket *r_frame_pipe_begin( R_FramePipe *pipe );
+void           r_frame_pipe_submit( R_FramePipe *pipe );
+// No more frames after the last submit; the render thread gets the ones still pending, then NULL.
+void           r_frame_pipe_close( R_FramePipe *pipe );
+
+// Render thread. The oldest submitted frame, waiting for one if needed; NULL once the pipe is
+// closed and drained.
+R_FramePacket *r_frame_pipe_acquire( R_FramePipe *pipe );
+void           r_frame_pipe_release( R_FramePipe *pipe );
+
+// Copies size bytes in at a 16 byte boundary. Returns the offset, or UINT32_MAX when they don't fit.
+uint32_t    r_frame_packet_push_constants( R_FramePacket *packet, const void *data, size_t size );
+const void *r_frame_packet_constants( const R_FramePacket *packet, uint32_t offset );
+bool        r_frame_packet_add_view( R_FramePacket *packet, const R_FrameView *view );
+
+// Counts are exact once both threads are done, approximate while they run.
+void r_frame_pipe_get_stats( R_FramePipe *pipe, R_FramePipeStats *outStats );
+
+#endif // R_FRAME_PIPE_H
@@ -0,0 +1,58 @@
+#ifndef R_HANDLES_H
+#define R_HANDLES_H
+
+#include <stdint.h>
+
+//
+// Resource handles are 32-bit generational ids into per-type pools owned by
+// the context (see r_pool.h). They are passed by value; id 0 is "no object".
+// Each type gets its own struct so handles can't be mixed up at compile time.
+//
+
+typedef struct R_Buffer
+{
+	uint32_t id;
+} R_Buffer;
+
+typedef struct R_VertexShader
+{
+	uint32_t id;
+} R_VertexShader;
+
+typedef struct R_PixelShader
+{
+	uint32_t id;
+} R_PixelShader;
+
+typedef struct R_InputLayout
+{
+	uint32_t id;
+} R_InputLayout;
+
+typedef struct R_Pipeline
+{
+	uint32_t id;
+} R_Pipeline;
+
+typedef struct R_Mesh
+{
+	uint32_t id;
+} R_Mesh;
+
+typedef struct R_BindGroup
+{
+	uint32_t id;
+} R_BindGroup;
+
+typedef struct R_Texture
+{
+	uint32_t id;
+} R_Texture;
+
+// Samplers are shared and live as long as the context, the id is never reused.
+typedef struct R_Sampler
+{
+	uint32_t id;
+} R_Sampler;
+
+#endif // R_HANDLES_H
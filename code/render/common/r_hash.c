@@ -0,0 +1,163 @@
+#include "r_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t r_hash_bytes( const void *data, size_t size, uint64_t seed )
+{
+	const unsigned char *p    = (const unsigned char *)data;
+	uint64_t             hash = seed;
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t r_hash_string( const char *str, uint64_t seed )
+{
+	uint64_t hash = seed;
+	while ( str && *str )
+	{
+		hash ^= (unsigned char)*str++;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static size_t r_hash_map_slot( uint64_t key, size_t capacity )
+{
+	// FNV leaves the low bits poorly mixed for similar inputs, fold the top half in.
+	return (size_t)( key ^ ( key >> 32 ) ) & ( capacity - 1 );
+}
+
+bool r_hash_map_init( R_HashMap *map, size_t initialCapacity )
+{
+	memset( map, 0, sizeof( *map ) );
+
+	size_t capacity = 16;
+	while ( capacity < initialCapacity )
+		capacity <<= 1;
+
+	map->keys   = (uint64_t *)calloc( capacity, sizeof( uint64_t ) );
+	map->values = (uint32_t *)calloc( capacity, sizeof( uint32_t ) );
+	map->flags  = (uint8_t *)calloc( capacity, sizeof( uint8_t ) );
+	if ( !map->keys || !map->values || !map->flags )
+	{
+		r_hash_map_free( map );
+		return false;
+	}
+	map->capacity = capacity;
+	return true;
+}
+
+void r_hash_map_free( R_HashMap *map )
+{
+	free( map->keys );
+	free( map->values );
+	free( map->flags );
+	memset( map, 0, sizeof( *map ) );
+}
+
+bool r_hash_map_get( const R_HashMap *map, uint64_t key, uint32_t *outValue )
+{
+	if ( map->capacity == 0 )
+		return false;
+
+	size_t mask  = map->capacity - 1;
+	size_t index = r_hash_map_slot( key, map->capacity );
+	for ( size_t i = 0; i < map->capacity; ++i )
+	{
+		size_t probe = ( index + i ) & mask;
+		if ( map->flags[probe] == R_HASH_MAP_EMPTY )
+			return false;
+
+		if ( map->flags[probe] == R_HASH_MAP_OCCUPIED && map->keys[probe] == key )
+		{
+			if ( outValue )
+				*outValue = map->values[probe];
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool r_hash_map_rehash( R_HashMap *map, size_t capacity )
+{
+	R_HashMap grown;
+	if ( !r_hash_map_init( &grown, capacity ) )
+		return false;
+
+	for ( size_t i = 0; i < map->capacity; ++i )
+	{
+		if ( map->flags[i] == R_HASH_MAP_OCCUPIED )
+			r_hash_map_put( &grown, map->keys[i], map->values[i] );
+	}
+
+	r_hash_map_free( map );
+	*map = grown;
+	return true;
+}
+
+bool r_hash_map_put( R_HashMap *map, uint64_t key, uint32_t value )
+{
+	// Rehashing also drops the tombstones, so size it by live entries only.
+	if ( ( map->used + 1 ) * 2 > map->capacity && !r_hash_map_rehash( map, ( map->count + 1 ) * 3 ) )
+		return false;
+
+	size_t mask      = map->capacity - 1;
+	size_t index     = r_hash_map_slot( key, map->capacity );
+	size_t tombstone = (size_t)-1;
+	for ( size_t i = 0; i < map->capacity; ++i )
+	{
+		size_t probe = ( index + i ) & mask;
+
+		if ( map->flags[probe] == R_HASH_MAP_OCCUPIED && map->keys[probe] == key )
+		{
+			map->values[probe] = value;
+			return true;
+		}
+
+		if ( map->flags[probe] == R_HASH_MAP_TOMBSTONE && tombstone == (size_t)-1 )
+			tombstone = probe;
+
+		if ( map->flags[probe] == R_HASH_MAP_EMPTY )
+		{
+			if ( tombstone != (size_t)-1 )
+				probe = tombstone;
+			else
+				map->used++;
+
+			map->keys[probe]   = key;
+			map->values[probe] = value;
+			map->flags[probe]  = R_HASH_MAP_OCCUPIED;
+			map->count++;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool r_hash_map_remove( R_HashMap *map, uint64_t key )
+{
+	if ( map->capacity == 0 )
+		return false;
+
+	size_t mask  = map->capacity - 1;
+	size_t index = r_hash_map_slot( key, map->capacity );
+	for ( size_t i = 0; i < map->capacity; ++i )
+	{
+		size_t probe = ( index + i ) & mask;
+		if ( map->flags[probe] == R_HASH_MAP_EMPTY )
+			return false;
+
+		if ( map->flags[probe] == R_HASH_MAP_OCCUPIED && map->keys[probe] == key )
+		{
+			map->flags[probe] = R_HASH_MAP_TOMBSTONE;
+			map->count--;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,39 @@
+#ifndef R_HASH_H
+#define R_HASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define R_HASH_SEED 14695981039346656037ULL
+
+// FNV-1a over raw bytes; chain calls by passing the previous result as seed.
+uint64_t r_hash_bytes( const void *data, size_t size, uint64_t seed );
+uint64_t r_hash_string( const char *str, uint64_t seed );
+
+//
+// Open addressing map from 64-bit hashes to 32-bit values, linear probing
+// with tombstones, same layout as DK_HashMap but keyed by hash and growable.
+//
+
+#define R_HASH_MAP_EMPTY 0
+#define R_HASH_MAP_OCCUPIED 1
+#define R_HASH_MAP_TOMBSTONE 2
+
+typedef struct R_HashMap
+{
+	uint64_t *keys;
+	uint32_t *values;
+	uint8_t  *flags;
+	size_t    count;
+	size_t    used; // occupied + tombstones, drives growth
+	size_t    capacity;
+} R_HashMap;
+
+bool r_hash_map_init( R_HashMap *map, size_t initialCapacity );
+void r_hash_map_free( R_HashMap *map );
+bool r_hash_map_get( const R_HashMap *map, uint64_t key, uint32_t *outValue );
+bool r_hash_map_put( R_HashMap *map, uint64_t key, uint32_t value );
+bool r_hash_map_remove( R_HashMap *map, uint64_t key );
+
+#endif // R_HASH_H
@@ -0,0 +1,106 @@
+#include "r_instancing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool r_instance_batcher_grow( R_InstanceBatcher *batcher, uint32_t capacity )
+{
+	R_DrawPacket *draws = (R_DrawPacket *)realloc( batcher->draws, capacity * sizeof( R_DrawPacket ) );
+	if ( !draws )
+		return false;
+	batcher->draws = draws;
+
+	uint8_t *instances = (uint8_t *)realloc( batcher->instances, (size_t)capacity * batcher->instanceStride );
+	if ( !instances )
+		return false;
+	batcher->instances = instances;
+
+	R_InstanceRun *runs = (R_InstanceRun *)realloc( batcher->runs, capacity * sizeof( R_InstanceRun ) );
+	if ( !runs )
+		return false;
+	batcher->runs = runs;
+
+	batcher->capacity = capacity;
+	return true;
+}
+
+bool r_instance_batcher_init( R_InstanceBatcher *batcher, uint32_t instanceStride, uint32_t initialCapacity )
+{
+	memset( batcher, 0, sizeof( *batcher ) );
+	if ( instanceStride == 0 )
+		return false;
+	batcher->instanceStride = instanceStride;
+
+	if ( initialCapacity == 0 )
+		initialCapacity = 256;
+	if ( !r_instance_batcher_grow( batcher, initialCapacity ) )
+	{
+		r_instance_batcher_free( batcher );
+		return false;
+	}
+	return true;
+}
+
+void r_instance_batcher_free( R_InstanceBatcher *batcher )
+{
+	free( batcher->draws );
+	free( batcher->instances );
+	free( batcher->runs );
+	memset( batcher, 0, sizeof( *batcher ) );
+}
+
+void r_instance_batcher_reset( R_InstanceBatcher *batcher )
+{
+	batcher->count    = 0;
+	batcher->runCount = 0;
+}
+
+bool r_instance_batcher_push( R_InstanceBatcher *batcher, const R_DrawPacket *draw, const void *instance )
+{
+	if ( batcher->count == batcher->capacity &&
+	     ( batcher->capacity > UINT32_MAX / 2 || !r_instance_batcher_grow( batcher, batcher->capacity * 2 ) ) )
+		return false;
+
+	uint32_t index        = batcher->count++;
+	batcher->draws[index] = *draw;
+	memcpy( batcher->instances + (size_t)index * batcher->instanceStride, instance, batcher->instanceStride );
+	batcher->stats.drawsIn++;
+	return true;
+}
+
+bool r_draw_packets_match( const R_DrawPacket *a, const R_DrawPacket *b )
+{
+	return a->pipeline.id == b->pipeline.id && a->vertexBuffer.id == b->vertexBuffer.id &&
+	       a->vertexStride == b->vertexStride && a->vertexOffset == b->vertexOffset &&
+	       a->indexBuffer.id == b->indexBuffer.id && a->indexFormat == b->indexFormat &&
+	       a->constants.id == b->constants.id && ( !a->constants.id || a->constantSlot == b->constantSlot ) &&
+	       a->indexCount == b->indexCount && a->startIndex == b->startIndex && a->baseVertex == b->baseVertex;
+}
+
+uint32_t r_instance_batcher_build( R_InstanceBatcher *batcher, uint32_t maxRun )
+{
+	batcher->runCount = 0;
+	if ( maxRun == 0 )
+		maxRun = UINT32_MAX;
+
+	for ( uint32_t i = 0; i < batcher->count; )
+	{
+		uint32_t end = i + 1;
+		while ( end < batcher->count && end - i < maxRun &&
+		        r_draw_packets_match( &batcher->draws[i], &batcher->draws[end] ) )
+			end++;
+
+		if ( end < batcher->count && end - i == maxRun &&
+		     r_draw_packets_match( &batcher->draws[i], &batcher->draws[end] ) )
+			batcher->stats.runsSplit++;
+
+		R_InstanceRun *run = &batcher->runs[batcher->runCount++];
+		run->first         = i;
+		run->count         = end - i;
+		i                  = end;
+	}
+
+	batcher->stats.drawsOut += batcher->runCount;
+	batcher->stats.bytes += (uint64_t)batcher->count * batcher->instanceStride;
+	return batcher->runCount;
+}
@@ -0,0 +1,61 @@
+#ifndef R_INSTANCING_H
+#define R_INSTANCING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "r_draw_queue.h"
+
+//
+// Automatic instancing. Draws are pushed as packets plus a fixed-size block of
+// per-instance data (usually a transform). r_instance_batcher_build finds runs
+// of consecutive packets that are identical, i.e. same mesh, pipeline and
+// material constants, and each run becomes one instanced draw. The instance
+// data is kept contiguous in push order, so any span of runs can be streamed
+// to the GPU with a single copy.
+//
+// Only consecutive draws merge: push in draw key order (see r_draw_queue.h)
+// to get the longest runs.
+//
+
+typedef struct R_InstanceRun
+{
+	uint32_t first; // index of the first draw, also its first instance
+	uint32_t count;
+} R_InstanceRun;
+
+typedef struct R_InstanceStats
+{
+	uint64_t drawsIn;   // packets pushed
+	uint64_t drawsOut;  // instanced draws the runs turned into
+	uint64_t runsSplit; // runs cut short by the maximum run length
+	uint64_t bytes;     // instance data handed out
+} R_InstanceStats;
+
+typedef struct R_InstanceBatcher
+{
+	R_DrawPacket   *draws;
+	uint8_t        *instances;
+	R_InstanceRun  *runs;
+	uint32_t        count;
+	uint32_t        capacity;
+	uint32_t        runCount;
+	uint32_t        instanceStride;
+	R_InstanceStats stats;
+} R_InstanceBatcher;
+
+bool r_instance_batcher_init( R_InstanceBatcher *batcher, uint32_t instanceStride, uint32_t initialCapacity );
+void r_instance_batcher_free( R_InstanceBatcher *batcher );
+// Drops the pushed draws, the stats keep accumulating.
+void r_instance_batcher_reset( R_InstanceBatcher *batcher );
+
+// Copies instanceStride bytes of instance data along with the packet.
+bool r_instance_batcher_push( R_InstanceBatcher *batcher, const R_DrawPacket *draw, const void *instance );
+
+// Splits the pushed draws into runs of at most maxRun instances (0 for no limit).
+uint32_t r_instance_batcher_build( R_InstanceBatcher *batcher, uint32_t maxRun );
+
+bool r_draw_packets_match( const R_DrawPacket *a, const R_DrawPacket *b );
+
+#endif // R_INSTANCING_H
@@ -0,0 +1,695 @@
+#include "r_mesh.h"
+#include "r_hash.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define R_MESH_EMPTY_SLOT UINT32_MAX
+
+static uint64_t r_mesh_hash_vertex( const uint8_t *v, size_t stride )
+{
+	if ( stride % 4 )
+		return r_hash_bytes( v, stride, R_HASH_SEED );
+
+	// A word at a time: FNV's byte loop is most of the weld's cost on large meshes.
+	uint64_t hash = R_HASH_SEED;
+	for ( size_t i = 0; i < stride; i += 4 )
+	{
+		uint32_t word;
+		memcpy( &word, v + i, sizeof( word ) );
+		hash = ( hash ^ word ) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+size_t r_mesh_weld( const void      *vertices,
+                    size_t           count,
+                    size_t           stride,
+                    void            *outVertices,
+                    uint32_t        *outIndices,
+                    R_MeshWeldStats *outStats )
+{
+	if ( !vertices || !outVertices || !outIndices || count == 0 || stride == 0 || count > UINT32_MAX )
+		return 0;
+
+	// Sized for every vertex being distinct, at most two thirds full.
+	size_t capacity = 16;
+	while ( capacity < count + count / 2 )
+		capacity <<= 1;
+	uint32_t *slots = (uint32_t *)malloc( capacity * sizeof( uint32_t ) );
+	if ( !slots )
+		return 0;
+	memset( slots, 0xFF, capacity * sizeof( uint32_t ) );
+
+	// Distinct vertex n is written to out[n] with n <= i, after in[i] was read: working in place is fine.
+	const uint8_t *in     = (const uint8_t *)vertices;
+	uint8_t       *out    = (uint8_t *)outVertices;
+	size_t         unique = 0;
+	size_t         mask   = capacity - 1;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const uint8_t *v    = in + i * stride;
+		uint64_t       hash = r_mesh_hash_vertex( v, stride );
+		size_t         slot = (size_t)( hash ^ ( hash >> 32 ) ) & mask;
+		while ( slots[slot] != R_MESH_EMPTY_SLOT && memcmp( out + (size_t)slots[slot] * stride, v, stride ) != 0 )
+			slot = ( slot + 1 ) & mask;
+
+		if ( slots[slot] == R_MESH_EMPTY_SLOT )
+		{
+			if ( out + unique * stride != v )
+				memcpy( out + unique * stride, v, stride );
+			slots[slot] = (uint32_t)unique++;
+		}
+		outIndices[i] = slots[slot];
+	}
+	free( slots );
+
+	if ( outStats )
+	{
+		outStats->inputVertices  = count;
+		outStats->outputVertices = unique;
+		outStats->inputBytes     = count * stride;
+		outStats->outputBytes    = unique * stride + count * sizeof( uint32_t );
+	}
+	return unique;
+}
+
+double r_mesh_weld_ratio( const R_MeshWeldStats *stats )
+{
+	return stats->outputBytes ? (double)stats->inputBytes / (double)stats->outputBytes : 1.0;
+}
+
+static bool r_mesh_add_submesh( R_MeshBuild *mesh, uint32_t *capacity, uint32_t startIndex, size_t baseVertex )
+{
+	if ( mesh->submeshCount == *capacity )
+	{
+		uint32_t   grown     = *capacity ? *capacity * 2 : 4;
+		R_Submesh *submeshes = (R_Submesh *)realloc( mesh->submeshes, grown * sizeof( R_Submesh ) );
+		if ( !submeshes )
+			return false;
+		mesh->submeshes = submeshes;
+		*capacity       = grown;
+	}
+
+	R_Submesh *sub   = &mesh->submeshes[mesh->submeshCount++];
+	sub->indexCount  = 0;
+	sub->startIndex  = startIndex;
+	sub->baseVertex  = (int32_t)baseVertex;
+	sub->vertexCount = 0;
+	return true;
+}
+
+static bool r_mesh_split( const uint8_t *vertices, size_t vertexCount, const uint32_t *indices, R_MeshBuild *mesh )
+{
+	// local[v] is vertex v's index in the submesh numbered owner[v], 0 for none yet.
+	size_t    stride          = mesh->stride;
+	size_t    vertexCapacity  = vertexCount + vertexCount / 8;
+	uint32_t  submeshCapacity = 0;
+	uint16_t *out             = (uint16_t *)mesh->indices;
+	uint32_t *local           = (uint32_t *)malloc( vertexCount * sizeof( uint32_t ) );
+	uint32_t *owner           = (uint32_t *)calloc( vertexCount, sizeof( uint32_t ) );
+	mesh->vertices            = malloc( vertexCapacity * stride );
+	bool ok = local && owner && mesh->vertices && r_mesh_add_submesh( mesh, &submeshCapacity, 0, 0 );
+
+	size_t t = 0;
+	while ( ok && t < mesh->indexCount )
+	{
+		const uint32_t *tri   = indices + t;
+		R_Submesh      *sub   = &mesh->submeshes[mesh->submeshCount - 1];
+		uint32_t        stamp = mesh->submeshCount;
+
+		uint32_t added = 0;
+		for ( int c = 0; c < 3; ++c )
+		{
+			bool repeated = ( c > 0 && tri[c] == tri[0] ) || ( c > 1 && tri[c] == tri[1] );
+			added += owner[tri[c]] != stamp && !repeated;
+		}
+		if ( sub->vertexCount + added > R_MESH_MAX_16BIT_VERTICES )
+		{
+			ok = r_mesh_add_submesh( mesh, &submeshCapacity, (uint32_t)t, mesh->vertexCount );
+			continue;
+		}
+
+		// Worst case for the triangle, so the copies below can't run out.
+		if ( mesh->vertexCount + 3 > vertexCapacity )
+		{
+			void *grown = realloc( mesh->vertices, vertexCapacity * 2 * stride );
+			if ( !grown )
+			{
+				ok = false;
+				break;
+			}
+			mesh->vertices = grown;
+			vertexCapacity *= 2;
+		}
+
+		uint8_t *outVertices = (uint8_t *)mesh->vertices;
+		for ( int c = 0; c < 3; ++c )
+		{
+			uint32_t v = tri[c];
+			if ( owner[v] != stamp )
+			{
+				memcpy( outVertices + mesh->vertexCount * stride, vertices + (size_t)v * stride, stride );
+				owner[v] = stamp;
+				local[v] = sub->vertexCount++;
+				mesh->vertexCount++;
+			}
+			out[t + c] = (uint16_t)local[v];
+		}
+		sub->indexCount += 3;
+		t += 3;
+	}
+
+	free( local );
+	free( owner );
+	return ok;
+}
+
+bool r_mesh_build( const void      *vertices,
+                   size_t           vertexCount,
+                   size_t           stride,
+                   const uint32_t  *indices,
+                   size_t           indexCount,
+                   R_MeshIndexMode  mode,
+                   R_MeshBuild     *outMesh )
+{
+	R_MeshBuild *mesh = outMesh;
+	memset( mesh, 0, sizeof( *mesh ) );
+	if ( !vertices || !indices || vertexCount == 0 || stride == 0 || indexCount % 3 || indexCount > UINT32_MAX ||
+	     vertexCount > UINT32_MAX )
+		return false;
+	for ( size_t i = 0; i < indexCount; ++i )
+	{
+		if ( indices[i] >= vertexCount )
+			return false;
+	}
+
+	bool wide        = vertexCount > R_MESH_MAX_16BIT_VERTICES && mode == R_MESH_FALLBACK_32;
+	mesh->stride     = stride;
+	mesh->indexCount = indexCount;
+	mesh->indexSize  = wide ? 4 : 2;
+	mesh->indices    = malloc( indexCount ? indexCount * mesh->indexSize : 1 );
+	if ( !mesh->indices )
+		return false;
+
+	if ( vertexCount > R_MESH_MAX_16BIT_VERTICES && !wide )
+	{
+		if ( !r_mesh_split( (const uint8_t *)vertices, vertexCount, indices, mesh ) )
+		{
+			r_mesh_build_free( mesh );
+			return false;
+		}
+		return true;
+	}
+
+	// Everything fits one draw: the vertices stay where they are.
+	mesh->submeshes = (R_Submesh *)malloc( sizeof( R_Submesh ) );
+	if ( !mesh->submeshes )
+	{
+		r_mesh_build_free( mesh );
+		return false;
+	}
+	if ( wide )
+		memcpy( mesh->indices, indices, indexCount * sizeof( uint32_t ) );
+	else
+	{
+		uint16_t *narrow = (uint16_t *)mesh->indices;
+		for ( size_t i = 0; i < indexCount; ++i )
+			narrow[i] = (uint16_t)indices[i];
+	}
+	mesh->vertexCount  = vertexCount;
+	mesh->submeshes[0] = ( R_Submesh ){ (uint32_t)indexCount, 0, 0, (uint32_t)vertexCount };
+	mesh->submeshCount = 1;
+	return true;
+}
+
+void r_mesh_build_free( R_MeshBuild *mesh )
+{
+	free( mesh->vertices );
+	free( mesh->indices );
+	free( mesh->submeshes );
+	memset( mesh, 0, sizeof( *mesh ) );
+}
+
+// FIFO post-transform cache: a vertex is in it when it was loaded less than size misses ago.
+typedef struct R_MeshCacheSim
+{
+	uint32_t *loadedAt; // miss number + 1, 0 for never
+	size_t    misses;
+	uint32_t  size;
+} R_MeshCacheSim;
+
+static bool r_mesh_cache_hit( R_MeshCacheSim *sim, uint32_t v )
+{
+	if ( sim->loadedAt[v] && sim->misses - ( sim->loadedAt[v] - 1 ) < sim->size )
+		return true;
+	sim->loadedAt[v] = (uint32_t)++sim->misses;
+	return false;
+}
+
+R_MeshCacheStats
+r_mesh_analyze_vertex_cache( const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize )
+{
+	R_MeshCacheStats stats = { 0 };
+	R_MeshCacheSim   sim   = { (uint32_t *)calloc( vertexCount ? vertexCount : 1, sizeof( uint32_t ) ), 0, cacheSize };
+	uint8_t         *used  = (uint8_t *)calloc( vertexCount ? vertexCount : 1, 1 );
+	if ( sim.loadedAt && used )
+	{
+		for ( size_t i = 0; i < indexCount; ++i )
+		{
+			r_mesh_cache_hit( &sim, indices[i] );
+			stats.vertices += !used[indices[i]];
+			used[indices[i]] = 1;
+		}
+		stats.triangles = indexCount / 3;
+		stats.misses    = sim.misses;
+		stats.acmr      = stats.triangles ? (float)sim.misses / (float)stats.triangles : 0.0f;
+		stats.atvr      = stats.vertices ? (float)sim.misses / (float)stats.vertices : 0.0f;
+	}
+	free( sim.loadedAt );
+	free( used );
+	return stats;
+}
+
+#define R_MESH_FETCH_CACHE_LINES 64
+
+R_MeshFetchStats
+r_mesh_analyze_vertex_fetch( const uint32_t *indices, size_t indexCount, size_t vertexCount, size_t stride )
+{
+	R_MeshFetchStats stats = { 0 };
+	R_MeshCacheSim   sim   = { NULL, 0, R_MESH_ANALYZE_CACHE_SIZE };
+	uint8_t         *used  = (uint8_t *)calloc( vertexCount ? vertexCount : 1, 1 );
+	sim.loadedAt           = (uint32_t *)calloc( vertexCount ? vertexCount : 1, sizeof( uint32_t ) );
+	if ( !sim.loadedAt || !used )
+	{
+		free( sim.loadedAt );
+		free( used );
+		return stats;
+	}
+
+	// Lines in FIFO order, like the vertex cache.
+	size_t   lines[R_MESH_FETCH_CACHE_LINES];
+	uint32_t lineCount = 0, lineHead = 0;
+	size_t   referenced = 0;
+	for ( size_t i = 0; i < indexCount; ++i )
+	{
+		uint32_t v = indices[i];
+		referenced += !used[v];
+		used[v] = 1;
+		if ( r_mesh_cache_hit( &sim, v ) )
+			continue;
+
+		size_t first = (size_t)v * stride / R_MESH_FETCH_LINE_BYTES;
+		size_t last  = ( (size_t)v * stride + stride - 1 ) / R_MESH_FETCH_LINE_BYTES;
+		for ( size_t line = first; line <= last; ++line )
+		{
+			bool cached = false;
+			for ( uint32_t j = 0; j < lineCount && !cached; ++j )
+				cached = lines[j] == line;
+			if ( cached )
+				continue;
+
+			stats.bytesFetched += R_MESH_FETCH_LINE_BYTES;
+			if ( lineCount < R_MESH_FETCH_CACHE_LINES )
+				lines[lineCount++] = line;
+			else
+			{
+				lines[lineHead] = line;
+				lineHead        = ( lineHead + 1 ) % R_MESH_FETCH_CACHE_LINES;
+			}
+		}
+	}
+	stats.overfetch = referenced ? (float)stats.bytesFetched / (float)( referenced * stride ) : 0.0f;
+
+	free( sim.loadedAt );
+	free( used );
+	return stats;
+}
+
+//
+// Forsyth, "Linear-Speed Vertex Cache Optimisation". Vertices score by their
+// position in a simulated LRU cache and by how few triangles still need them;
+// the next triangle is the best scoring one among those touching the cache.
+//
+
+#define R_FORSYTH_CACHE_SIZE 32
+#define R_FORSYTH_VALENCE_TABLE 64
+#define R_FORSYTH_CACHE_DECAY_POWER 1.5f
+#define R_FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define R_FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define R_FORSYTH_VALENCE_BOOST_POWER 0.5f
+#define R_FORSYTH_NONE UINT32_MAX
+
+typedef struct R_ForsythTables
+{
+	float cache[R_FORSYTH_CACHE_SIZE];
+	float valence[R_FORSYTH_VALENCE_TABLE];
+} R_ForsythTables;
+
+static void r_forsyth_tables( R_ForsythTables *tables )
+{
+	for ( int i = 0; i < R_FORSYTH_CACHE_SIZE; ++i )
+	{
+		// The last triangle's three vertices score the same whatever their order.
+		float scale       = 1.0f / ( R_FORSYTH_CACHE_SIZE - 3 );
+		tables->cache[i]  = i < 3 ? R_FORSYTH_LAST_TRIANGLE_SCORE
+		                          : powf( 1.0f - ( i - 3 ) * scale, R_FORSYTH_CACHE_DECAY_POWER );
+	}
+	tables->valence[0] = 0.0f;
+	for ( int i = 1; i < R_FORSYTH_VALENCE_TABLE; ++i )
+		tables->valence[i] = R_FORSYTH_VALENCE_BOOST_SCALE * powf( (float)i, -R_FORSYTH_VALENCE_BOOST_POWER );
+}
+
+static float r_forsyth_score( const R_ForsythTables *tables, int32_t cachePosition, uint32_t valence )
+{
+	// Nothing left to draw with it.
+	if ( valence == 0 )
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? tables->cache[cachePosition] : 0.0f;
+	if ( valence < R_FORSYTH_VALENCE_TABLE )
+		return score + tables->valence[valence];
+	return score + R_FORSYTH_VALENCE_BOOST_SCALE * powf( (float)valence, -R_FORSYTH_VALENCE_BOOST_POWER );
+}
+
+bool r_mesh_optimize_vertex_cache( uint32_t *indices, size_t indexCount, size_t vertexCount )
+{
+	size_t triangleCount = indexCount / 3;
+	if ( indexCount % 3 || indexCount > UINT32_MAX || vertexCount > UINT32_MAX )
+		return false;
+	if ( triangleCount == 0 )
+		return true;
+
+	// Triangles using each vertex: the live ones first, offsets[v]..offsets[v] + live[v].
+	uint32_t *live          = (uint32_t *)calloc( vertexCount, sizeof( uint32_t ) );
+	uint32_t *offsets       = (uint32_t *)malloc( ( vertexCount + 1 ) * sizeof( uint32_t ) );
+	uint32_t *adjacency     = (uint32_t *)malloc( indexCount * sizeof( uint32_t ) );
+	int32_t  *cachePosition = (int32_t *)malloc( vertexCount * sizeof( int32_t ) );
+	float    *vertexScore   = (float *)malloc( vertexCount * sizeof( float ) );
+	float    *triangleScore = (float *)malloc( triangleCount * sizeof( float ) );
+	uint8_t  *emitted       = (uint8_t *)calloc( triangleCount, 1 );
+	uint32_t *out           = (uint32_t *)malloc( indexCount * sizeof( uint32_t ) );
+	bool      ok = live && offsets && adjacency && cachePosition && vertexScore && triangleScore && emitted && out;
+
+	for ( size_t i = 0; ok && i < indexCount; ++i )
+	{
+		ok = indices[i] < vertexCount;
+		if ( ok )
+			live[indices[i]]++;
+	}
+
+	if ( ok )
+	{
+		R_ForsythTables tables;
+		r_forsyth_tables( &tables );
+
+		offsets[0] = 0;
+		for ( size_t v = 0; v < vertexCount; ++v )
+		{
+			offsets[v + 1]   = offsets[v] + live[v];
+			live[v]          = 0;
+			cachePosition[v] = -1;
+		}
+		for ( size_t t = 0; t < triangleCount; ++t )
+		{
+			for ( int c = 0; c < 3; ++c )
+			{
+				uint32_t v                      = indices[t * 3 + c];
+				adjacency[offsets[v] + live[v]] = (uint32_t)t;
+				live[v]++;
+			}
+		}
+		for ( size_t v = 0; v < vertexCount; ++v )
+			vertexScore[v] = r_forsyth_score( &tables, -1, live[v] );
+
+		uint32_t best = 0;
+		for ( size_t t = 0; t < triangleCount; ++t )
+		{
+			const uint32_t *tri = indices + t * 3;
+			triangleScore[t]    = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+			if ( triangleScore[t] > triangleScore[best] )
+				best = (uint32_t)t;
+		}
+
+		uint32_t cache[R_FORSYTH_CACHE_SIZE + 3];
+		uint32_t next[R_FORSYTH_CACHE_SIZE + 3];
+		uint32_t cacheCount = 0;
+		size_t   cursor     = 0;
+		for ( size_t n = 0; n < triangleCount; ++n )
+		{
+			// Nothing in the cache has triangles left: carry on in the input order.
+			if ( best == R_FORSYTH_NONE )
+			{
+				while ( emitted[cursor] )
+					cursor++;
+				best = (uint32_t)cursor;
+			}
+
+			const uint32_t *tri = indices + (size_t)best * 3;
+			memcpy( out + n * 3, tri, 3 * sizeof( uint32_t ) );
+			emitted[best] = 1;
+
+			// The triangle's vertices go to the front of the cache, the rest move back behind them.
+			uint32_t nextCount = 0;
+			for ( int c = 0; c < 3; ++c )
+			{
+				uint32_t v = tri[c];
+				for ( uint32_t i = offsets[v]; i < offsets[v] + live[v]; ++i )
+				{
+					if ( adjacency[i] == best )
+					{
+						adjacency[i] = adjacency[offsets[v] + live[v] - 1];
+						live[v]--;
+						break;
+					}
+				}
+				if ( cachePosition[v] != -2 )
+				{
+					next[nextCount++] = v;
+					cachePosition[v]  = -2; // placed
+				}
+			}
+			for ( uint32_t i = 0; i < cacheCount; ++i )
+			{
+				if ( cachePosition[cache[i]] != -2 )
+				{
+					next[nextCount++]       = cache[i];
+					cachePosition[cache[i]] = -2;
+				}
+			}
+
+			for ( uint32_t i = 0; i < nextCount; ++i )
+			{
+				uint32_t v       = next[i];
+				cachePosition[v] = i < R_FORSYTH_CACHE_SIZE ? (int32_t)i : -1;
+				vertexScore[v]   = r_forsyth_score( &tables, cachePosition[v], live[v] );
+			}
+
+			best            = R_FORSYTH_NONE;
+			float bestScore = -1.0f;
+			for ( uint32_t i = 0; i < nextCount; ++i )
+			{
+				uint32_t v = next[i];
+				for ( uint32_t j = offsets[v]; j < offsets[v] + live[v]; ++j )
+				{
+					uint32_t        t     = adjacency[j];
+					const uint32_t *other = indices + (size_t)t * 3;
+					triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+					if ( triangleScore[t] > bestScore )
+					{
+						bestScore = triangleScore[t];
+						best      = t;
+					}
+				}
+			}
+
+			cacheCount = nextCount < R_FORSYTH_CACHE_SIZE ? nextCount : R_FORSYTH_CACHE_SIZE;
+			memcpy( cache, next, cacheCount * sizeof( uint32_t ) );
+		}
+		memcpy( indices, out, indexCount * sizeof( uint32_t ) );
+	}
+
+	free( live );
+	free( offsets );
+	free( adjacency );
+	free( cachePosition );
+	free( vertexScore );
+	free( triangleScore );
+	free( emitted );
+	free( out );
+	return ok;
+}
+
+typedef struct R_MeshCluster
+{
+	uint32_t start; // first triangle
+	uint32_t count;
+	float    centre[3];
+	float    normal[3]; // unit length
+	float    sortKey;
+} R_MeshCluster;
+
+static int r_mesh_compare_clusters( const void *a, const void *b )
+{
+	const R_MeshCluster *x = (const R_MeshCluster *)a;
+	const R_MeshCluster *y = (const R_MeshCluster *)b;
+	if ( x->sortKey != y->sortKey )
+		return x->sortKey > y->sortKey ? -1 : 1;
+	return x->start < y->start ? -1 : 1;
+}
+
+static const float *r_mesh_position( const void *vertices, size_t stride, uint32_t v )
+{
+	return (const float *)( (const uint8_t *)vertices + (size_t)v * stride );
+}
+
+bool r_mesh_optimize_overdraw( uint32_t   *indices,
+                               size_t      indexCount,
+                               const void *vertices,
+                               size_t      vertexCount,
+                               size_t      stride,
+                               float       threshold )
+{
+	size_t triangleCount = indexCount / 3;
+	if ( !vertices || stride < 3 * sizeof( float ) || indexCount % 3 || indexCount > UINT32_MAX )
+		return false;
+	for ( size_t i = 0; i < indexCount; ++i )
+	{
+		if ( indices[i] >= vertexCount )
+			return false;
+	}
+	if ( triangleCount < 2 )
+		return true;
+
+	// A cluster starts wherever a triangle misses the cache on all three vertices: reordering there
+	// costs almost nothing.
+	R_MeshCacheSim sim      = { (uint32_t *)calloc( vertexCount, sizeof( uint32_t ) ), 0, R_MESH_ANALYZE_CACHE_SIZE };
+	R_MeshCluster *clusters = (R_MeshCluster *)malloc( triangleCount * sizeof( R_MeshCluster ) );
+	uint32_t      *out      = (uint32_t *)malloc( indexCount * sizeof( uint32_t ) );
+	if ( !sim.loadedAt || !clusters || !out )
+	{
+		free( sim.loadedAt );
+		free( clusters );
+		free( out );
+		return false;
+	}
+
+	uint32_t clusterCount = 0;
+	for ( size_t t = 0; t < triangleCount; ++t )
+	{
+		int misses = 0;
+		for ( int c = 0; c < 3; ++c )
+			misses += !r_mesh_cache_hit( &sim, indices[t * 3 + c] );
+		if ( t == 0 || misses == 3 )
+			clusters[clusterCount++] = ( R_MeshCluster ){ .start = (uint32_t)t };
+		clusters[clusterCount - 1].count++;
+	}
+
+	// Area weighted centroids and normals; the key is how far a cluster faces away from the centre.
+	float meshCentre[3] = { 0.0f, 0.0f, 0.0f }, meshArea = 0.0f;
+	for ( uint32_t k = 0; k < clusterCount; ++k )
+	{
+		R_MeshCluster *cluster = &clusters[k];
+		float          centre[3] = { 0.0f, 0.0f, 0.0f }, normal[3] = { 0.0f, 0.0f, 0.0f }, area = 0.0f;
+		for ( uint32_t t = cluster->start; t < cluster->start + cluster->count; ++t )
+		{
+			const float *a = r_mesh_position( vertices, stride, indices[t * 3 + 0] );
+			const float *b = r_mesh_position( vertices, stride, indices[t * 3 + 1] );
+			const float *c = r_mesh_position( vertices, stride, indices[t * 3 + 2] );
+			float        e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float        e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float        n[3]  = { e1[1] * e2[2] - e1[2] * e2[1],
+			                       e1[2] * e2[0] - e1[0] * e2[2],
+			                       e1[0] * e2[1] - e1[1] * e2[0] };
+			float        w     = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+			for ( int i = 0; i < 3; ++i )
+			{
+				centre[i] += ( a[i] + b[i] + c[i] ) * w;
+				normal[i] += n[i];
+			}
+			area += w;
+		}
+		for ( int i = 0; i < 3; ++i )
+			meshCentre[i] += centre[i];
+		meshArea += area;
+
+		float length = sqrtf( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+		for ( int i = 0; i < 3; ++i )
+		{
+			cluster->centre[i] = area > 0.0f ? centre[i] / ( area * 3.0f ) : 0.0f;
+			cluster->normal[i] = length > 0.0f ? normal[i] / length : 0.0f;
+		}
+	}
+	for ( int i = 0; i < 3; ++i )
+		meshCentre[i] = meshArea > 0.0f ? meshCentre[i] / ( meshArea * 3.0f ) : 0.0f;
+
+	for ( uint32_t k = 0; k < clusterCount; ++k )
+	{
+		R_MeshCluster *cluster = &clusters[k];
+		for ( int i = 0; i < 3; ++i )
+			cluster->sortKey += ( cluster->centre[i] - meshCentre[i] ) * cluster->normal[i];
+	}
+	qsort( clusters, clusterCount, sizeof( R_MeshCluster ), r_mesh_compare_clusters );
+
+	size_t n = 0;
+	for ( uint32_t k = 0; k < clusterCount; ++k )
+	{
+		memcpy( out + n, indices + (size_t)clusters[k].start * 3, (size_t)clusters[k].count * 3 * sizeof( uint32_t ) );
+		n += (size_t)clusters[k].count * 3;
+	}
+
+	float before = r_mesh_analyze_vertex_cache( indices, indexCount, vertexCount, R_MESH_ANALYZE_CACHE_SIZE ).acmr;
+	float after  = r_mesh_analyze_vertex_cache( out, indexCount, vertexCount, R_MESH_ANALYZE_CACHE_SIZE ).acmr;
+	if ( after <= before * threshold )
+		memcpy( indices, out, indexCount * sizeof( uint32_t ) );
+
+	free( sim.loadedAt );
+	free( clusters );
+	free( out );
+	return true;
+}
+
+size_t r_mesh_optimize_vertex_fetch( void     *vertices,
+                                     size_t    vertexCount,
+                                     size_t    stride,
+                                     uint32_t *indices,
+                                     size_t    indexCount )
+{
+	if ( !vertices || vertexCount > UINT32_MAX )
+		return 0;
+	for ( size_t i = 0; i < indexCount; ++i )
+	{
+		if ( indices[i] >= vertexCount )
+			return 0;
+	}
+
+	uint32_t *remap = (uint32_t *)malloc( vertexCount * sizeof( uint32_t ) );
+	uint8_t  *copy  = (uint8_t *)malloc( vertexCount * stride );
+	if ( !remap || !copy )
+	{
+		free( remap );
+		free( copy );
+		return 0;
+	}
+	memcpy( copy, vertices, vertexCount * stride );
+	memset( remap, 0xFF, vertexCount * sizeof( uint32_t ) );
+
+	uint8_t *out   = (uint8_t *)vertices;
+	size_t   count = 0;
+	for ( size_t i = 0; i < indexCount; ++i )
+	{
+		uint32_t v = indices[i];
+		if ( remap[v] == UINT32_MAX )
+		{
+			memcpy( out + count * stride, copy + (size_t)v * stride, stride );
+			remap[v] = (uint32_t)count++;
+		}
+		indices[i] = remap[v];
+	}
+
+	free( remap );
+	free( copy );
+	return count;
+}
@@ -0,0 +1,152 @@
+#ifndef R_MESH_H
+#define R_MESH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Mesh import stages, independent of the backend and of the file format the
+// mesh came from. They work on plain vertex arrays of any layout (a stride in
+// bytes) and 32-bit index lists.
+//
+// Welding turns a triangle soup with one vertex per face corner, the way OBJ
+// and most exporters hand it out, into an indexed mesh: every distinct vertex
+// is kept once and the indices point at it. Vertices are compared as bytes,
+// so -0.0 and 0.0 are different values; importers that care write them the
+// same way.
+//
+
+typedef struct R_MeshWeldStats
+{
+	size_t inputVertices;
+	size_t outputVertices;
+	size_t inputBytes;
+	size_t outputBytes; // vertices and indices
+} R_MeshWeldStats;
+
+// Writes the distinct vertices to outVertices in order of first use, which may be vertices itself,
+// and outIndices[i] for every input vertex. Returns the number of distinct vertices, 0 on failure
+// (out of memory, or more than UINT32_MAX vertices).
+size_t r_mesh_weld( const void      *vertices,
+                    size_t           count,
+                    size_t           stride,
+                    void            *outVertices,
+                    uint32_t        *outIndices,
+                    R_MeshWeldStats *outStats );
+
+// Bytes of the soup over bytes of the indexed mesh.
+double r_mesh_weld_ratio( const R_MeshWeldStats *stats );
+
+//
+// Index width. 16-bit indices halve index fetch bandwidth and memory, but only
+// address 65535 vertices. A mesh with more either gets 32-bit indices or is
+// split into submeshes that stay below the limit: each one has its own run of
+// vertices, drawn with that run's start as baseVertex, in one vertex and one
+// index buffer for the whole mesh. Splitting walks the triangles in order and
+// starts a submesh when the next triangle wouldn't fit, so a submesh is a run
+// of neighbouring triangles and its vertices are in order of first use; a
+// vertex on a boundary between two submeshes is stored in both.
+//
+
+// 0xFFFF is left out, it's the strip cut value.
+#define R_MESH_MAX_16BIT_VERTICES 65535
+
+typedef enum
+{
+	R_MESH_SPLIT_16 = 0, // over the limit: submeshes with 16-bit indices
+	R_MESH_FALLBACK_32,  // over the limit: one mesh with 32-bit indices
+} R_MeshIndexMode;
+
+// Feeds r_draw_indexed( ctx, indexCount, startIndex, baseVertex ).
+typedef struct R_Submesh
+{
+	uint32_t indexCount;
+	uint32_t startIndex;
+	int32_t  baseVertex;
+	uint32_t vertexCount;
+} R_Submesh;
+
+typedef struct R_MeshBuild
+{
+	void      *vertices; // NULL when the input vertices are used unchanged
+	size_t     vertexCount;
+	size_t     stride;
+	void      *indices;   // uint16_t or uint32_t, see indexSize
+	size_t     indexCount;
+	uint32_t   indexSize; // 2 or 4
+	R_Submesh *submeshes;
+	uint32_t   submeshCount;
+} R_MeshBuild;
+
+// Triangle lists only. Picks 16-bit indices whenever vertexCount allows and mode decides what
+// happens otherwise. False on bad input (an index out of range, a partial triangle) or out of memory.
+bool r_mesh_build( const void      *vertices,
+                   size_t           vertexCount,
+                   size_t           stride,
+                   const uint32_t  *indices,
+                   size_t           indexCount,
+                   R_MeshIndexMode  mode,
+                   R_MeshBuild     *outMesh );
+void r_mesh_build_free( R_MeshBuild *mesh );
+
+//
+// Optimization, on a 32-bit index list before r_mesh_build. In order:
+//
+//   1. r_mesh_optimize_vertex_cache reorders triangles so their vertices are
+//      still in the post-transform cache (Forsyth's linear-speed algorithm,
+//      scored for a 32 entry LRU cache; it does well on FIFO hardware too).
+//   2. r_mesh_optimize_overdraw, optionally, cuts that order into clusters
+//      where the cache goes cold anyway and sorts the clusters to draw those
+//      facing away from the mesh's centre, which usually occlude the rest,
+//      first. threshold caps what it may cost in cache misses (1.05 = 5%).
+//   3. r_mesh_optimize_vertex_fetch puts the vertices in the order the
+//      indices first use them, so fetches walk the vertex buffer forwards.
+//
+// ACMR is vertex shader runs per triangle (0.5 is the best a regular grid
+// can do, 3 means no reuse), ATVR per vertex referenced (1 is perfect).
+//
+
+#define R_MESH_ANALYZE_CACHE_SIZE 16
+#define R_MESH_FETCH_LINE_BYTES 64
+
+typedef struct R_MeshCacheStats
+{
+	size_t triangles;
+	size_t vertices; // referenced by the indices
+	size_t misses;   // vertex shader invocations
+	float  acmr;
+	float  atvr;
+} R_MeshCacheStats;
+
+typedef struct R_MeshFetchStats
+{
+	size_t bytesFetched; // cache lines read by the vertex fetches that miss the post-transform cache
+	float  overfetch;    // over the size of the vertices referenced, 1 is perfect
+} R_MeshFetchStats;
+
+// Simulates a FIFO post-transform cache of cacheSize entries.
+R_MeshCacheStats
+r_mesh_analyze_vertex_cache( const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize );
+// Same cache, and a small fully associative cache of R_MESH_FETCH_LINE_BYTES lines for the fetches.
+R_MeshFetchStats
+r_mesh_analyze_vertex_fetch( const uint32_t *indices, size_t indexCount, size_t vertexCount, size_t stride );
+
+bool   r_mesh_optimize_vertex_cache( uint32_t *indices, size_t indexCount, size_t vertexCount );
+// The position is the first three floats of each vertex. Leaves the order alone when the sorted one
+// would have an ACMR above threshold times the current one.
+bool   r_mesh_optimize_overdraw( uint32_t   *indices,
+                                 size_t      indexCount,
+                                 const void *vertices,
+                                 size_t      vertexCount,
+                                 size_t      stride,
+                                 float       threshold );
+// Renumbers the indices in order of first use and moves the vertices to match; vertices nothing
+// references are dropped. Returns the new vertex count, 0 on failure.
+size_t r_mesh_optimize_vertex_fetch( void     *vertices,
+                                     size_t    vertexCount,
+                                     size_t    stride,
+                                     uint32_t *indices,
+                                     size_t    indexCount );
+
+#endif // R_MESH_H
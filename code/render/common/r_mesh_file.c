@@ -0,0 +1,156 @@
+#include "r_mesh_file.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define R_MESH_FILE_MAGIC 0x48534D52u // "RMSH"
+
+static uint64_t r_mesh_file_align( uint64_t size )
+{
+	return ( size + R_MESH_FILE_ALIGNMENT - 1 ) & ~(uint64_t)( R_MESH_FILE_ALIGNMENT - 1 );
+}
+
+uint64_t r_mesh_file_layout_hash( const char *layout, uint32_t stride )
+{
+	return r_hash_bytes( &stride, sizeof( stride ), r_hash_string( layout, R_HASH_SEED ) );
+}
+
+static void r_mesh_file_bounds( const uint8_t *vertices, size_t stride, size_t count, float *outMin, float *outMax )
+{
+	for ( int i = 0; i < 3; ++i )
+	{
+		outMin[i] = count ? FLT_MAX : 0.0f;
+		outMax[i] = count ? -FLT_MAX : 0.0f;
+	}
+	for ( size_t v = 0; v < count; ++v )
+	{
+		float position[3];
+		memcpy( position, vertices + v * stride, sizeof( position ) );
+		for ( int i = 0; i < 3; ++i )
+		{
+			outMin[i] = position[i] < outMin[i] ? position[i] : outMin[i];
+			outMax[i] = position[i] > outMax[i] ? position[i] : outMax[i];
+		}
+	}
+}
+
+void *r_mesh_file_encode( const R_MeshBuild *mesh, const void *vertices, uint64_t layoutHash, size_t *outSize )
+{
+	const uint8_t *source = (const uint8_t *)( mesh->vertices ? mesh->vertices : vertices );
+	if ( !source || mesh->stride < 3 * sizeof( float ) || mesh->stride > UINT32_MAX )
+		return NULL;
+
+	size_t           submeshBytes = mesh->submeshCount * sizeof( R_MeshFileSubmesh );
+	R_MeshFileHeader header       = { 0 };
+	header.magic            = R_MESH_FILE_MAGIC;
+	header.version          = R_MESH_FILE_VERSION;
+	header.layoutHash       = layoutHash;
+	header.stride           = (uint32_t)mesh->stride;
+	header.indexSize        = mesh->indexSize;
+	header.vertexCount      = mesh->vertexCount;
+	header.indexCount       = mesh->indexCount;
+	header.submeshCount     = mesh->submeshCount;
+	header.submeshOffset    = r_mesh_file_align( sizeof( header ) );
+	header.vertexOffset     = r_mesh_file_align( header.submeshOffset + submeshBytes );
+	header.indexOffset      = r_mesh_file_align( header.vertexOffset + mesh->vertexCount * mesh->stride );
+	header.fileSize         = r_mesh_file_align( header.indexOffset + mesh->indexCount * mesh->indexSize );
+	r_mesh_file_bounds( source, mesh->stride, mesh->vertexCount, header.boundsMin, header.boundsMax );
+
+	if ( header.fileSize > SIZE_MAX )
+		return NULL;
+	uint8_t *image = (uint8_t *)calloc( 1, (size_t)header.fileSize );
+	if ( !image )
+		return NULL;
+
+	memcpy( image, &header, sizeof( header ) );
+	R_MeshFileSubmesh *submeshes = (R_MeshFileSubmesh *)( image + header.submeshOffset );
+	for ( uint32_t i = 0; i < mesh->submeshCount; ++i )
+	{
+		const R_Submesh *range = &mesh->submeshes[i];
+		const uint8_t   *first = source + ( (size_t)range->baseVertex ) * mesh->stride;
+		submeshes[i].range     = *range;
+		r_mesh_file_bounds( first, mesh->stride, range->vertexCount, submeshes[i].boundsMin, submeshes[i].boundsMax );
+	}
+	memcpy( image + header.vertexOffset, source, mesh->vertexCount * mesh->stride );
+	memcpy( image + header.indexOffset, mesh->indices, mesh->indexCount * mesh->indexSize );
+
+	*outSize = (size_t)header.fileSize;
+	return image;
+}
+
+bool r_mesh_file_save( const char *path, const void *image, size_t size )
+{
+	FILE *f = fopen( path, "wb" );
+	if ( !f )
+		return false;
+	bool ok = fwrite( image, 1, size, f ) == size;
+	ok      = fclose( f ) == 0 && ok;
+	if ( !ok )
+		remove( path );
+	return ok;
+}
+
+// offset + count * size stays within fileSize, without overflowing on the way.
+static bool r_mesh_file_section( const R_MeshFileHeader *header, uint64_t offset, uint64_t count, uint64_t size )
+{
+	if ( offset % R_MESH_FILE_ALIGNMENT || offset > header->fileSize )
+		return false;
+	return size == 0 || count <= ( header->fileSize - offset ) / size;
+}
+
+bool r_mesh_file_view( const void *data, size_t size, uint64_t layoutHash, R_MeshFileView *outView )
+{
+	const R_MeshFileHeader *header = (const R_MeshFileHeader *)data;
+	if ( !data || size < sizeof( *header ) || (uintptr_t)data % sizeof( uint64_t ) )
+		return false;
+	if ( header->magic != R_MESH_FILE_MAGIC || header->version != R_MESH_FILE_VERSION ||
+	     header->layoutHash != layoutHash || header->fileSize != size )
+		return false;
+	if ( header->stride == 0 || ( header->indexSize != 2 && header->indexSize != 4 ) || header->indexCount % 3 )
+		return false;
+	if ( !r_mesh_file_section( header, header->submeshOffset, header->submeshCount, sizeof( R_MeshFileSubmesh ) ) ||
+	     !r_mesh_file_section( header, header->vertexOffset, header->vertexCount, header->stride ) ||
+	     !r_mesh_file_section( header, header->indexOffset, header->indexCount, header->indexSize ) )
+		return false;
+
+	const uint8_t           *base      = (const uint8_t *)data;
+	const R_MeshFileSubmesh *submeshes = (const R_MeshFileSubmesh *)( base + header->submeshOffset );
+	for ( uint32_t i = 0; i < header->submeshCount; ++i )
+	{
+		const R_Submesh *range = &submeshes[i].range;
+		if ( range->baseVertex < 0 || (uint64_t)range->startIndex + range->indexCount > header->indexCount ||
+		     (uint64_t)range->baseVertex + range->vertexCount > header->vertexCount )
+			return false;
+	}
+
+	outView->header    = header;
+	outView->submeshes = submeshes;
+	outView->vertices  = base + header->vertexOffset;
+	outView->indices   = base + header->indexOffset;
+	return true;
+}
+
+bool r_mesh_file_open( R_MeshFile *file, const char *path, uint64_t layoutHash )
+{
+	memset( file, 0, sizeof( *file ) );
+	if ( !io_file_open( &file->file, path, false ) )
+		return false;
+
+	uint64_t size = io_file_size( &file->file );
+	if ( size > SIZE_MAX || !io_file_map( &file->file, (size_t)size, &file->mapping ) ||
+	     !r_mesh_file_view( file->mapping.data, file->mapping.size, layoutHash, &file->view ) )
+	{
+		r_mesh_file_close( file );
+		return false;
+	}
+	return true;
+}
+
+void r_mesh_file_close( R_MeshFile *file )
+{
+	io_file_unmap( &file->mapping );
+	io_file_close( &file->file );
+	memset( file, 0, sizeof( *file ) );
+}
@@ -0,0 +1,96 @@
+#ifndef R_MESH_FILE_H
+#define R_MESH_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_file.h"
+#include "r_hash.h"
+#include "r_mesh.h"
+
+//
+// Binary mesh files, laid out the way the GPU buffers want them so loading is
+// a mapping and a few range checks:
+//
+//   [header] [submesh table] [vertices] [indices]
+//
+// Every section starts at an R_MESH_FILE_ALIGNMENT boundary, so with the file
+// mapped (page aligned) the vertex and index blobs can go straight to buffer
+// creation. Files are little-endian and only read on the kind of machine that
+// wrote them.
+//
+// The header names its vertex layout by hash; a file written for a different
+// layout, or by another version of this code, doesn't open and is converted
+// again from its source.
+//
+
+#define R_MESH_FILE_VERSION 1
+#define R_MESH_FILE_ALIGNMENT 64
+
+// The layout meshconv writes.
+#define R_MESH_FILE_LAYOUT_PNT "float3 POSITION; float3 NORMAL; float2 TEXCOORD0"
+
+typedef struct R_MeshFileVertex
+{
+	float position[3];
+	float normal[3];
+	float uv[2];
+} R_MeshFileVertex;
+
+typedef struct R_MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t layoutHash;
+	uint32_t stride;
+	uint32_t indexSize; // 2 or 4
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint32_t submeshCount;
+	uint32_t reserved;
+	float    boundsMin[3];
+	float    boundsMax[3];
+	uint64_t submeshOffset;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t fileSize;
+} R_MeshFileHeader;
+
+typedef struct R_MeshFileSubmesh
+{
+	R_Submesh range;
+	float     boundsMin[3];
+	float     boundsMax[3];
+} R_MeshFileSubmesh;
+
+// Everything points into the file's bytes.
+typedef struct R_MeshFileView
+{
+	const R_MeshFileHeader  *header;
+	const R_MeshFileSubmesh *submeshes;
+	const void              *vertices;
+	const void              *indices;
+} R_MeshFileView;
+
+typedef struct R_MeshFile
+{
+	IO_File        file;
+	IO_Mapping     mapping;
+	R_MeshFileView view;
+} R_MeshFile;
+
+// layout describes the vertex the way the vtx layout declares it; see R_MESH_FILE_LAYOUT_PNT.
+uint64_t r_mesh_file_layout_hash( const char *layout, uint32_t stride );
+
+// A file image of a built mesh, in one allocation for free(). vertices is what was passed to
+// r_mesh_build; positions are the first three floats of each vertex, for the bounds.
+void *r_mesh_file_encode( const R_MeshBuild *mesh, const void *vertices, uint64_t layoutHash, size_t *outSize );
+bool  r_mesh_file_save( const char *path, const void *image, size_t size );
+
+// Checks the header, the section bounds and the submesh ranges; index values aren't looked at.
+bool r_mesh_file_view( const void *data, size_t size, uint64_t layoutHash, R_MeshFileView *outView );
+bool r_mesh_file_open( R_MeshFile *file, const char *path, uint64_t layoutHash );
+void r_mesh_file_close( R_MeshFile *file );
+
+#endif // R_MESH_FILE_H
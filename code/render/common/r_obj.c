@@ -0,0 +1,457 @@
+#include "r_obj.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct R_ObjArray
+{
+	uint8_t *data;
+	size_t   count;
+	size_t   capacity;
+} R_ObjArray;
+
+typedef struct R_ObjChunk
+{
+	const char *begin;
+	const char *end;
+	R_ObjArray  positions; // float[3]
+	R_ObjArray  texcoords; // float[2]
+	R_ObjArray  normals;   // float[3]
+	R_ObjArray  corners;   // R_ObjCorner
+	R_ObjArray  relative;  // uint64_t: corner * 3 + field of each index still relative to the chunk
+	size_t      bases[4];  // elements before the chunk: positions, texcoords, normals, corners
+	R_ObjMesh  *mesh;
+	bool        failed;
+	SYS_Thread  thread;
+} R_ObjChunk;
+
+static void *r_obj_push( R_ObjArray *array, size_t elementSize )
+{
+	if ( array->count == array->capacity )
+	{
+		size_t   capacity = array->capacity ? array->capacity * 2 : 4096;
+		uint8_t *data     = (uint8_t *)realloc( array->data, capacity * elementSize );
+		if ( !data )
+			return NULL;
+		array->data     = data;
+		array->capacity = capacity;
+	}
+	return array->data + elementSize * array->count++;
+}
+
+static bool r_obj_space( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *r_obj_skip_space( const char *p, const char *end )
+{
+	while ( p < end && r_obj_space( *p ) )
+		p++;
+	return p;
+}
+
+static bool r_obj_digit( char c )
+{
+	return c >= '0' && c <= '9';
+}
+
+// Eight ASCII digits at once, as one little-endian 64-bit load.
+static bool r_obj_eight_digits( uint64_t v )
+{
+	return !( ( ( v + 0x4646464646464646ULL ) | ( v - 0x3030303030303030ULL ) ) & 0x8080808080808080ULL );
+}
+
+static uint32_t r_obj_parse_eight_digits( uint64_t v )
+{
+	v -= 0x3030303030303030ULL;
+	v = v * 10 + ( v >> 8 );
+	v = ( ( ( v & 0x000000FF000000FFULL ) * ( 100 + ( 1000000ULL << 32 ) ) ) +
+	      ( ( ( v >> 16 ) & 0x000000FF000000FFULL ) * ( 1 + ( 10000ULL << 32 ) ) ) ) >>
+	    32;
+	return (uint32_t)v;
+}
+
+// Digits go into mantissa while it has room, the ones that don't fit are only counted.
+static const char *r_obj_parse_digits( const char *p, const char *end, uint64_t *mantissa, int *taken, int *dropped )
+{
+	while ( end - p >= 8 && *mantissa < 100000000000ULL )
+	{
+		uint64_t v;
+		memcpy( &v, p, sizeof( v ) );
+		if ( !r_obj_eight_digits( v ) )
+			break;
+		*mantissa = *mantissa * 100000000ULL + r_obj_parse_eight_digits( v );
+		*taken += 8;
+		p += 8;
+	}
+	for ( ; p < end && r_obj_digit( *p ); ++p )
+	{
+		if ( *mantissa < 1000000000000000000ULL )
+		{
+			*mantissa = *mantissa * 10 + (uint64_t)( *p - '0' );
+			*taken += 1;
+		}
+		else
+			*dropped += 1;
+	}
+	return p;
+}
+
+static const double r_obj_powers[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// Handles what exporters write: [sign] digits [. digits] [e [sign] digits]. Words (nan, inf) go
+// through strtod.
+static bool r_obj_parse_float( const char **cursor, const char *end, float *out )
+{
+	const char *p        = r_obj_skip_space( *cursor, end );
+	const char *start    = p;
+	bool        negative = p < end && *p == '-';
+	if ( p < end && ( *p == '-' || *p == '+' ) )
+		p++;
+
+	uint64_t mantissa = 0;
+	int      exponent = 0, taken = 0, dropped = 0;
+	p                 = r_obj_parse_digits( p, end, &mantissa, &taken, &dropped );
+	exponent += dropped;
+	if ( p < end && *p == '.' )
+	{
+		int fraction = 0;
+		p            = r_obj_parse_digits( p + 1, end, &mantissa, &fraction, &dropped );
+		exponent -= fraction;
+		taken += fraction;
+	}
+	if ( taken == 0 && dropped == 0 )
+	{
+		if ( p == end || r_obj_space( *p ) || *p == '\n' )
+			return false;
+
+		char   token[64];
+		size_t length = 0;
+		while ( start + length < end && length < sizeof( token ) - 1 && !r_obj_space( start[length] ) &&
+		        start[length] != '\n' )
+			length++;
+		memcpy( token, start, length );
+		token[length] = 0;
+
+		char *parsed;
+		*out    = (float)strtod( token, &parsed );
+		*cursor = start + length;
+		return parsed != token;
+	}
+
+	if ( p < end && ( *p == 'e' || *p == 'E' ) )
+	{
+		const char *e           = p + 1;
+		bool        negativeExp = e < end && *e == '-';
+		if ( e < end && ( *e == '-' || *e == '+' ) )
+			e++;
+		int value = 0;
+		for ( ; e < end && r_obj_digit( *e ); ++e )
+			value = value < 10000 ? value * 10 + ( *e - '0' ) : value;
+		if ( e > p + 1 && r_obj_digit( e[-1] ) )
+		{
+			exponent += negativeExp ? -value : value;
+			p = e;
+		}
+	}
+
+	double value = (double)mantissa;
+	if ( exponent >= 0 && exponent <= 22 )
+		value *= r_obj_powers[exponent];
+	else if ( exponent < 0 && exponent >= -22 )
+		value /= r_obj_powers[-exponent];
+	else
+		value *= pow( 10.0, exponent );
+
+	*out    = (float)( negative ? -value : value );
+	*cursor = p;
+	return true;
+}
+
+static bool r_obj_parse_floats( const char *p, const char *end, R_ObjArray *array, int count )
+{
+	float *out = (float *)r_obj_push( array, count * sizeof( float ) );
+	if ( !out )
+		return false;
+	for ( int i = 0; i < count; ++i )
+	{
+		if ( !r_obj_parse_float( &p, end, &out[i] ) )
+			out[i] = 0.0f;
+	}
+	return true;
+}
+
+// One index of a face corner: 1-based from the start of the file, or negative from the last element
+// declared so far. Comes out 0-based, relative to the chunk when it was negative.
+static bool r_obj_parse_index( const char **cursor, const char *end, size_t declared, int32_t *out, bool *relative )
+{
+	const char *p        = *cursor;
+	bool        negative = p < end && *p == '-';
+	if ( negative )
+		p++;
+
+	uint64_t value = 0;
+	for ( ; p < end && r_obj_digit( *p ) && value <= INT32_MAX; ++p )
+		value = value * 10 + (uint64_t)( *p - '0' );
+	if ( p == *cursor + negative || value == 0 || value > INT32_MAX )
+		return false;
+
+	int64_t index = negative ? (int64_t)declared - (int64_t)value : (int64_t)value - 1;
+	if ( index < INT32_MIN || index > INT32_MAX )
+		return false;
+	*out      = (int32_t)index;
+	*relative = negative;
+	*cursor   = p;
+	return true;
+}
+
+// v, v/vt, v//vn or v/vt/vn.
+static bool
+r_obj_parse_corner( const char **cursor, const char *end, const R_ObjChunk *chunk, R_ObjCorner *out, int *relative )
+{
+	const char *p           = *cursor;
+	int32_t    *fields[3]   = { &out->position, &out->texcoord, &out->normal };
+	size_t      declared[3] = { chunk->positions.count, chunk->texcoords.count, chunk->normals.count };
+
+	out->texcoord = -1;
+	out->normal   = -1;
+	*relative     = 0;
+	for ( int i = 0; i < 3; ++i )
+	{
+		if ( i > 0 )
+		{
+			if ( p == end || *p != '/' )
+				break;
+			p++;
+			if ( i == 1 && p < end && *p == '/' )
+				continue;
+		}
+
+		bool isRelative;
+		if ( !r_obj_parse_index( &p, end, declared[i], fields[i], &isRelative ) )
+			return false;
+		*relative |= isRelative << i;
+	}
+	*cursor = p;
+	return true;
+}
+
+static bool r_obj_emit_corner( R_ObjChunk *chunk, const R_ObjCorner *corner, int relative )
+{
+	R_ObjCorner *out = (R_ObjCorner *)r_obj_push( &chunk->corners, sizeof( R_ObjCorner ) );
+	if ( !out )
+		return false;
+	*out = *corner;
+	for ( int i = 0; i < 3; ++i )
+	{
+		if ( !( relative & ( 1 << i ) ) )
+			continue;
+		uint64_t *fixup = (uint64_t *)r_obj_push( &chunk->relative, sizeof( uint64_t ) );
+		if ( !fixup )
+			return false;
+		*fixup = ( chunk->corners.count - 1 ) * 3 + (uint64_t)i;
+	}
+	return true;
+}
+
+static bool r_obj_parse_face( const char *p, const char *end, R_ObjChunk *chunk )
+{
+	R_ObjCorner first, previous, corner;
+	int         firstRelative = 0, previousRelative = 0, relative;
+	for ( int n = 0;; ++n )
+	{
+		p = r_obj_skip_space( p, end );
+		if ( p == end )
+			return true;
+		if ( !r_obj_parse_corner( &p, end, chunk, &corner, &relative ) )
+			return false;
+
+		if ( n >= 2 && ( !r_obj_emit_corner( chunk, &first, firstRelative ) ||
+		                 !r_obj_emit_corner( chunk, &previous, previousRelative ) ||
+		                 !r_obj_emit_corner( chunk, &corner, relative ) ) )
+			return false;
+		if ( n == 0 )
+		{
+			first         = corner;
+			firstRelative = relative;
+		}
+		previous         = corner;
+		previousRelative = relative;
+	}
+}
+
+static void r_obj_parse_chunk( void *arg )
+{
+	R_ObjChunk *chunk = (R_ObjChunk *)arg;
+	const char *p     = chunk->begin;
+	while ( p < chunk->end && !chunk->failed )
+	{
+		const char *line = p;
+		const char *end  = (const char *)memchr( p, '\n', (size_t)( chunk->end - p ) );
+		end              = end ? end : chunk->end;
+		p                = end + 1;
+
+		line = r_obj_skip_space( line, end );
+		if ( end - line < 2 )
+			continue;
+
+		bool ok = true;
+		if ( line[0] == 'v' && r_obj_space( line[1] ) )
+			ok = r_obj_parse_floats( line + 2, end, &chunk->positions, 3 );
+		else if ( line[0] == 'v' && line[1] == 't' && end - line > 2 && r_obj_space( line[2] ) )
+			ok = r_obj_parse_floats( line + 3, end, &chunk->texcoords, 2 );
+		else if ( line[0] == 'v' && line[1] == 'n' && end - line > 2 && r_obj_space( line[2] ) )
+			ok = r_obj_parse_floats( line + 3, end, &chunk->normals, 3 );
+		else if ( line[0] == 'f' && r_obj_space( line[1] ) )
+			ok = r_obj_parse_face( line + 2, end, chunk );
+		chunk->failed = !ok;
+	}
+}
+
+static void r_obj_copy( void *destination, const R_ObjArray *array, size_t elementSize )
+{
+	if ( array->count )
+		memcpy( destination, array->data, array->count * elementSize );
+}
+
+// Copies the chunk into the mesh, makes its relative indices absolute and checks them all.
+static void r_obj_merge_chunk( void *arg )
+{
+	R_ObjChunk *chunk = (R_ObjChunk *)arg;
+	R_ObjMesh  *mesh  = chunk->mesh;
+	r_obj_copy( mesh->positions + chunk->bases[0] * 3, &chunk->positions, 3 * sizeof( float ) );
+	r_obj_copy( mesh->texcoords + chunk->bases[1] * 2, &chunk->texcoords, 2 * sizeof( float ) );
+	r_obj_copy( mesh->normals + chunk->bases[2] * 3, &chunk->normals, 3 * sizeof( float ) );
+
+	R_ObjCorner *corners = mesh->corners + chunk->bases[3];
+	r_obj_copy( corners, &chunk->corners, sizeof( R_ObjCorner ) );
+	const uint64_t *relative = (const uint64_t *)chunk->relative.data;
+	for ( size_t i = 0; i < chunk->relative.count; ++i )
+	{
+		R_ObjCorner *c         = &corners[relative[i] / 3];
+		int32_t     *fields[3] = { &c->position, &c->texcoord, &c->normal };
+		int32_t     *field     = fields[relative[i] % 3];
+		*field                 = (int32_t)( *field + (int64_t)chunk->bases[relative[i] % 3] );
+	}
+
+	// Texcoords and normals are optional: -1 is fine, and the +1 takes it to 0.
+	for ( size_t i = 0; i < chunk->corners.count && !chunk->failed; ++i )
+	{
+		const R_ObjCorner *c = &corners[i];
+		chunk->failed        = c->position < 0 || (size_t)c->position >= mesh->positionCount || c->texcoord < -1 ||
+		                (size_t)c->texcoord + 1 > mesh->texcoordCount || c->normal < -1 ||
+		                (size_t)c->normal + 1 > mesh->normalCount;
+	}
+}
+
+static void r_obj_chunk_free( R_ObjChunk *chunk )
+{
+	free( chunk->positions.data );
+	free( chunk->texcoords.data );
+	free( chunk->normals.data );
+	free( chunk->corners.data );
+	free( chunk->relative.data );
+}
+
+// Runs fn on every chunk, the first one on this thread.
+static void r_obj_run( R_ObjChunk *chunks, uint32_t count, SYS_ThreadFn fn )
+{
+	bool started[R_OBJ_MAX_THREADS] = { false };
+	for ( uint32_t i = 1; i < count; ++i )
+		started[i] = sys_thread_start( &chunks[i].thread, fn, &chunks[i] );
+	fn( &chunks[0] );
+	for ( uint32_t i = 1; i < count; ++i )
+	{
+		if ( started[i] )
+			sys_thread_join( &chunks[i].thread );
+		else
+			fn( &chunks[i] );
+	}
+}
+
+bool r_obj_parse( const char *data, size_t size, uint32_t threadCount, R_ObjMesh *outMesh )
+{
+	memset( outMesh, 0, sizeof( *outMesh ) );
+	if ( threadCount == 0 )
+		threadCount = (uint32_t)sys_cpu_count();
+	if ( threadCount > size / R_OBJ_MIN_CHUNK_BYTES + 1 )
+		threadCount = (uint32_t)( size / R_OBJ_MIN_CHUNK_BYTES + 1 );
+	threadCount = threadCount < 1 ? 1 : threadCount > R_OBJ_MAX_THREADS ? R_OBJ_MAX_THREADS : threadCount;
+
+	R_ObjChunk *chunks = (R_ObjChunk *)calloc( threadCount, sizeof( R_ObjChunk ) );
+	if ( !chunks )
+		return false;
+
+	// Every chunk but the first starts after a line break, every one but the last ends after one.
+	const char *begin = data;
+	for ( uint32_t i = 0; i < threadCount; ++i )
+	{
+		const char *end = data + size;
+		if ( i + 1 < threadCount )
+		{
+			const char *cut   = data + size / threadCount * ( i + 1 );
+			const char *found = cut < begin ? NULL : (const char *)memchr( cut, '\n', (size_t)( data + size - cut ) );
+			end               = found ? found + 1 : cut < begin ? begin : data + size;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end   = end;
+		chunks[i].mesh  = outMesh;
+		begin           = end;
+	}
+	r_obj_run( chunks, threadCount, r_obj_parse_chunk );
+
+	bool ok = true;
+	for ( uint32_t i = 0; i < threadCount; ++i )
+	{
+		R_ObjChunk *chunk = &chunks[i];
+		ok                = ok && !chunk->failed;
+		chunk->bases[0]   = outMesh->positionCount;
+		chunk->bases[1]   = outMesh->texcoordCount;
+		chunk->bases[2]   = outMesh->normalCount;
+		chunk->bases[3]   = outMesh->cornerCount;
+		outMesh->positionCount += chunk->positions.count;
+		outMesh->texcoordCount += chunk->texcoords.count;
+		outMesh->normalCount += chunk->normals.count;
+		outMesh->cornerCount += chunk->corners.count;
+	}
+
+	if ( ok && outMesh->positionCount <= INT32_MAX && outMesh->texcoordCount <= INT32_MAX &&
+	     outMesh->normalCount <= INT32_MAX )
+	{
+		outMesh->positions = (float *)malloc( outMesh->positionCount * 3 * sizeof( float ) + 1 );
+		outMesh->texcoords = (float *)malloc( outMesh->texcoordCount * 2 * sizeof( float ) + 1 );
+		outMesh->normals   = (float *)malloc( outMesh->normalCount * 3 * sizeof( float ) + 1 );
+		outMesh->corners   = (R_ObjCorner *)malloc( outMesh->cornerCount * sizeof( R_ObjCorner ) + 1 );
+		ok                 = outMesh->positions && outMesh->texcoords && outMesh->normals && outMesh->corners;
+		if ( ok )
+			r_obj_run( chunks, threadCount, r_obj_merge_chunk );
+		for ( uint32_t i = 0; i < threadCount; ++i )
+			ok = ok && !chunks[i].failed;
+	}
+	else
+		ok = false;
+
+	for ( uint32_t i = 0; i < threadCount; ++i )
+		r_obj_chunk_free( &chunks[i] );
+	free( chunks );
+
+	if ( !ok )
+	{
+		r_obj_free( outMesh );
+		return false;
+	}
+	outMesh->threads = threadCount;
+	return true;
+}
+
+void r_obj_free( R_ObjMesh *mesh )
+{
+	free( mesh->positions );
+	free( mesh->texcoords );
+	free( mesh->normals );
+	free( mesh->corners );
+	memset( mesh, 0, sizeof( *mesh ) );
+}
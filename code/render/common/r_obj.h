@@ -0,0 +1,51 @@
+#ifndef R_OBJ_H
+#define R_OBJ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_thread.h"
+
+//
+// Parallel OBJ reader for the geometry part of the format: v, vt, vn and f.
+// The file, usually a mapping, is cut into one chunk per thread at line
+// boundaries. Every thread parses its chunk into arrays of its own, then once
+// all of them know how much came before them, copies them into the shared
+// output at that offset and turns the chunk's relative (negative) indices
+// into absolute ones.
+//
+// Polygons are fanned into triangles. Materials, groups, smoothing groups and
+// line continuations are ignored.
+//
+
+#define R_OBJ_MAX_THREADS 64
+// Smaller chunks aren't worth a thread.
+#define R_OBJ_MIN_CHUNK_BYTES ( 256 * 1024 )
+
+typedef struct R_ObjCorner
+{
+	int32_t position; // 0-based
+	int32_t texcoord; // -1 when the corner has none
+	int32_t normal;   // -1 when the corner has none
+} R_ObjCorner;
+
+typedef struct R_ObjMesh
+{
+	float       *positions; // xyz
+	size_t       positionCount;
+	float       *texcoords; // uv
+	size_t       texcoordCount;
+	float       *normals; // xyz
+	size_t       normalCount;
+	R_ObjCorner *corners; // three per triangle
+	size_t       cornerCount;
+	uint32_t     threads; // chunks the file was parsed in
+} R_ObjMesh;
+
+// threadCount 0 is one thread per CPU. False when out of memory, or when an index points outside
+// the elements the file declares; outMesh is empty then.
+bool r_obj_parse( const char *data, size_t size, uint32_t threadCount, R_ObjMesh *outMesh );
+void r_obj_free( R_ObjMesh *mesh );
+
+#endif // R_OBJ_H
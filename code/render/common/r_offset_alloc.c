@@ -0,0 +1,308 @@
+#include "r_offset_alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define R_OFFSET_MANTISSA_BITS 3
+#define R_OFFSET_MANTISSA_VALUE ( 1u << R_OFFSET_MANTISSA_BITS )
+#define R_OFFSET_MANTISSA_MASK ( R_OFFSET_MANTISSA_VALUE - 1 )
+
+// v must not be 0.
+static uint32_t r_offset_lowest_bit( uint32_t v )
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward( &index, v );
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctz( v );
+#endif
+}
+
+static uint32_t r_offset_highest_bit( uint32_t v )
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse( &index, v );
+	return (uint32_t)index;
+#else
+	return 31u - (uint32_t)__builtin_clz( v );
+#endif
+}
+
+// Lowest set bit at or above start, R_OFFSET_ALLOC_NONE if there is none.
+static uint32_t r_offset_lowest_bit_from( uint32_t mask, uint32_t start )
+{
+	if ( start >= 32 )
+		return R_OFFSET_ALLOC_NONE;
+	mask &= ~( ( 1u << start ) - 1 );
+	return mask ? r_offset_lowest_bit( mask ) : R_OFFSET_ALLOC_NONE;
+}
+
+// Bin whose sizes are all >= size: where an allocation of size can be taken from any region.
+static uint32_t r_offset_bin_round_up( uint32_t size )
+{
+	if ( size < R_OFFSET_MANTISSA_VALUE )
+		return size;
+
+	uint32_t mantissaStart = r_offset_highest_bit( size ) - R_OFFSET_MANTISSA_BITS;
+	uint32_t exponent      = mantissaStart + 1;
+	uint32_t mantissa      = ( size >> mantissaStart ) & R_OFFSET_MANTISSA_MASK;
+	if ( size & ( ( 1u << mantissaStart ) - 1 ) )
+		mantissa++;
+
+	// A mantissa rounded up to 8 carries into the exponent.
+	return ( exponent << R_OFFSET_MANTISSA_BITS ) + mantissa;
+}
+
+// Bin whose sizes are all <= size: where a free region of size is kept.
+static uint32_t r_offset_bin_round_down( uint32_t size )
+{
+	if ( size < R_OFFSET_MANTISSA_VALUE )
+		return size;
+
+	uint32_t mantissaStart = r_offset_highest_bit( size ) - R_OFFSET_MANTISSA_BITS;
+	uint32_t exponent      = mantissaStart + 1;
+	uint32_t mantissa      = ( size >> mantissaStart ) & R_OFFSET_MANTISSA_MASK;
+	return ( exponent << R_OFFSET_MANTISSA_BITS ) | mantissa;
+}
+
+static uint32_t r_offset_bin_size( uint32_t bin )
+{
+	uint32_t exponent = bin >> R_OFFSET_MANTISSA_BITS;
+	uint32_t mantissa = bin & R_OFFSET_MANTISSA_MASK;
+	if ( exponent == 0 )
+		return mantissa;
+	return ( mantissa | R_OFFSET_MANTISSA_VALUE ) << ( exponent - 1 );
+}
+
+// Takes a node off the free stack and puts it at the head of the bin for size.
+static uint32_t r_offset_insert_free( R_OffsetAllocator *a, uint32_t offset, uint32_t size )
+{
+	uint32_t bin  = r_offset_bin_round_down( size );
+	uint32_t top  = bin / R_OFFSET_ALLOC_LEAF_BINS;
+	uint32_t leaf = bin % R_OFFSET_ALLOC_LEAF_BINS;
+
+	if ( a->binHeads[bin] == R_OFFSET_ALLOC_NONE )
+	{
+		a->usedBins[top] |= (uint8_t)( 1u << leaf );
+		a->usedBinsTop |= 1u << top;
+	}
+
+	uint32_t      index = a->freeNodes[--a->freeNodeCount];
+	R_OffsetNode *node  = &a->nodes[index];
+	node->offset        = offset;
+	node->size          = size;
+	node->binPrev       = R_OFFSET_ALLOC_NONE;
+	node->binNext       = a->binHeads[bin];
+	node->neighborPrev  = R_OFFSET_ALLOC_NONE;
+	node->neighborNext  = R_OFFSET_ALLOC_NONE;
+	node->used          = false;
+	if ( node->binNext != R_OFFSET_ALLOC_NONE )
+		a->nodes[node->binNext].binPrev = index;
+
+	a->binHeads[bin] = index;
+	a->freeStorage += size;
+	return index;
+}
+
+// Unlinks a free node from its bin, the caller decides what becomes of it.
+static void r_offset_unlink_free( R_OffsetAllocator *a, uint32_t index )
+{
+	R_OffsetNode *node = &a->nodes[index];
+	if ( node->binPrev != R_OFFSET_ALLOC_NONE )
+	{
+		a->nodes[node->binPrev].binNext = node->binNext;
+		if ( node->binNext != R_OFFSET_ALLOC_NONE )
+			a->nodes[node->binNext].binPrev = node->binPrev;
+	}
+	else
+	{
+		uint32_t bin  = r_offset_bin_round_down( node->size );
+		uint32_t top  = bin / R_OFFSET_ALLOC_LEAF_BINS;
+		uint32_t leaf = bin % R_OFFSET_ALLOC_LEAF_BINS;
+
+		a->binHeads[bin] = node->binNext;
+		if ( node->binNext != R_OFFSET_ALLOC_NONE )
+			a->nodes[node->binNext].binPrev = R_OFFSET_ALLOC_NONE;
+		else
+		{
+			a->usedBins[top] &= (uint8_t)~( 1u << leaf );
+			if ( !a->usedBins[top] )
+				a->usedBinsTop &= ~( 1u << top );
+		}
+	}
+
+	a->freeStorage -= node->size;
+}
+
+// Unlinks a free node that was merged into a neighbour and returns it to the free stack.
+static void r_offset_remove_free( R_OffsetAllocator *a, uint32_t index )
+{
+	r_offset_unlink_free( a, index );
+	a->freeNodes[a->freeNodeCount++] = index;
+}
+
+bool r_offset_alloc_init( R_OffsetAllocator *allocator, uint32_t size, uint32_t maxAllocs )
+{
+	memset( allocator, 0, sizeof( *allocator ) );
+	if ( size == 0 || maxAllocs == 0 || maxAllocs > ( UINT32_MAX - 1 ) / 2 )
+		return false;
+
+	// Free regions never outnumber the allocations between them by more than one.
+	allocator->size      = size;
+	allocator->maxAllocs = maxAllocs;
+	allocator->nodeCount = maxAllocs * 2 + 1;
+	allocator->nodes     = (R_OffsetNode *)malloc( allocator->nodeCount * sizeof( R_OffsetNode ) );
+	allocator->freeNodes = (uint32_t *)malloc( allocator->nodeCount * sizeof( uint32_t ) );
+	if ( !allocator->nodes || !allocator->freeNodes )
+	{
+		r_offset_alloc_free( allocator );
+		return false;
+	}
+
+	r_offset_alloc_reset( allocator );
+	return true;
+}
+
+void r_offset_alloc_free( R_OffsetAllocator *allocator )
+{
+	free( allocator->nodes );
+	free( allocator->freeNodes );
+	memset( allocator, 0, sizeof( *allocator ) );
+}
+
+void r_offset_alloc_reset( R_OffsetAllocator *allocator )
+{
+	allocator->allocCount  = 0;
+	allocator->freeStorage = 0;
+	allocator->usedBinsTop = 0;
+	memset( allocator->usedBins, 0, sizeof( allocator->usedBins ) );
+	for ( uint32_t i = 0; i < R_OFFSET_ALLOC_BINS; ++i )
+		allocator->binHeads[i] = R_OFFSET_ALLOC_NONE;
+
+	// Popped from the back, so node 0 goes first.
+	allocator->freeNodeCount = allocator->nodeCount;
+	for ( uint32_t i = 0; i < allocator->nodeCount; ++i )
+		allocator->freeNodes[i] = allocator->nodeCount - i - 1;
+
+	r_offset_insert_free( allocator, 0, allocator->size );
+}
+
+R_OffsetAllocation r_offset_alloc( R_OffsetAllocator *allocator, uint32_t size )
+{
+	R_OffsetAllocation none = { R_OFFSET_ALLOC_NONE, R_OFFSET_ALLOC_NONE };
+	R_OffsetAllocator *a    = allocator;
+	if ( size == 0 || size > a->size || a->allocCount == a->maxAllocs )
+		return none;
+
+	// Smallest bin where every region fits: the rest of its top bin first, then any larger top bin.
+	uint32_t minBin  = r_offset_bin_round_up( size );
+	uint32_t minTop  = minBin / R_OFFSET_ALLOC_LEAF_BINS;
+	uint32_t minLeaf = minBin % R_OFFSET_ALLOC_LEAF_BINS;
+
+	uint32_t top  = minTop;
+	uint32_t leaf = R_OFFSET_ALLOC_NONE;
+	if ( top < R_OFFSET_ALLOC_TOP_BINS && ( a->usedBinsTop & ( 1u << top ) ) )
+		leaf = r_offset_lowest_bit_from( a->usedBins[top], minLeaf );
+	if ( leaf == R_OFFSET_ALLOC_NONE )
+	{
+		top = r_offset_lowest_bit_from( a->usedBinsTop, minTop + 1 );
+		if ( top == R_OFFSET_ALLOC_NONE )
+			return none;
+		leaf = r_offset_lowest_bit( a->usedBins[top] );
+	}
+
+	uint32_t index = a->binHeads[top * R_OFFSET_ALLOC_LEAF_BINS + leaf];
+	uint32_t total = a->nodes[index].size;
+	r_offset_unlink_free( a, index );
+
+	R_OffsetNode *node = &a->nodes[index];
+	node->size         = size;
+	node->used         = true;
+	node->binPrev      = R_OFFSET_ALLOC_NONE;
+	node->binNext      = R_OFFSET_ALLOC_NONE;
+	a->allocCount++;
+
+	// The remainder goes back as a free region right behind the allocation.
+	if ( total > size )
+	{
+		uint32_t      rest     = r_offset_insert_free( a, node->offset + size, total - size );
+		R_OffsetNode *restNode = &a->nodes[rest];
+		restNode->neighborPrev = index;
+		restNode->neighborNext = node->neighborNext;
+		if ( node->neighborNext != R_OFFSET_ALLOC_NONE )
+			a->nodes[node->neighborNext].neighborPrev = rest;
+		node->neighborNext = rest;
+	}
+
+	R_OffsetAllocation allocation = { node->offset, index };
+	return allocation;
+}
+
+void r_offset_free( R_OffsetAllocator *allocator, R_OffsetAllocation allocation )
+{
+	R_OffsetAllocator *a = allocator;
+	if ( allocation.node >= a->nodeCount || !a->nodes[allocation.node].used )
+		return;
+
+	R_OffsetNode *node   = &a->nodes[allocation.node];
+	uint32_t      offset = node->offset;
+	uint32_t      size   = node->size;
+	uint32_t      prev   = node->neighborPrev;
+	uint32_t      next   = node->neighborNext;
+
+	if ( prev != R_OFFSET_ALLOC_NONE && !a->nodes[prev].used )
+	{
+		offset = a->nodes[prev].offset;
+		size += a->nodes[prev].size;
+		uint32_t merged = prev;
+		prev            = a->nodes[merged].neighborPrev;
+		r_offset_remove_free( a, merged );
+	}
+	if ( next != R_OFFSET_ALLOC_NONE && !a->nodes[next].used )
+	{
+		size += a->nodes[next].size;
+		uint32_t merged = next;
+		next            = a->nodes[merged].neighborNext;
+		r_offset_remove_free( a, merged );
+	}
+
+	node->used = false;
+	a->freeNodes[a->freeNodeCount++] = allocation.node;
+	a->allocCount--;
+
+	uint32_t      index  = r_offset_insert_free( a, offset, size );
+	R_OffsetNode *region = &a->nodes[index];
+	region->neighborPrev = prev;
+	region->neighborNext = next;
+	if ( prev != R_OFFSET_ALLOC_NONE )
+		a->nodes[prev].neighborNext = index;
+	if ( next != R_OFFSET_ALLOC_NONE )
+		a->nodes[next].neighborPrev = index;
+}
+
+uint32_t r_offset_alloc_size( const R_OffsetAllocator *allocator, R_OffsetAllocation allocation )
+{
+	if ( allocation.node >= allocator->nodeCount || !allocator->nodes[allocation.node].used )
+		return 0;
+	return allocator->nodes[allocation.node].size;
+}
+
+void r_offset_alloc_get_stats( const R_OffsetAllocator *allocator, R_OffsetAllocStats *outStats )
+{
+	memset( outStats, 0, sizeof( *outStats ) );
+	outStats->freeStorage = allocator->freeStorage;
+	outStats->allocCount  = allocator->allocCount;
+	outStats->freeRegions = allocator->nodeCount - allocator->freeNodeCount - allocator->allocCount;
+	if ( allocator->usedBinsTop )
+	{
+		uint32_t top          = r_offset_highest_bit( allocator->usedBinsTop );
+		uint32_t leaf         = r_offset_highest_bit( allocator->usedBins[top] );
+		outStats->largestFree = r_offset_bin_size( top * R_OFFSET_ALLOC_LEAF_BINS + leaf );
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef R_OFFSET_ALLOC_H
+#define R_OFFSET_ALLOC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Two-level segregated-fit (TLSF) offset allocator. It manages a range of
+// [0, size) units and never touches the memory they stand for, so the units
+// can be bytes, vertices or indices of a GPU buffer.
+//
+// Free regions are kept in 256 bins, sized like a tiny float (5-bit exponent,
+// 3-bit mantissa), with one bit per bin in a two-level mask. Allocating is a
+// couple of bit scans for the first bin whose regions are all big enough,
+// freeing merges with the free neighbours: both O(1), at most 1/8 wasted on
+// rounding the request up to a bin. The remainder of a split region goes back
+// in a bin, so nothing is wasted after that.
+//
+
+#define R_OFFSET_ALLOC_NONE 0xffffffffu
+#define R_OFFSET_ALLOC_TOP_BINS 32
+#define R_OFFSET_ALLOC_LEAF_BINS 8
+#define R_OFFSET_ALLOC_BINS ( R_OFFSET_ALLOC_TOP_BINS * R_OFFSET_ALLOC_LEAF_BINS )
+
+typedef struct R_OffsetAllocation
+{
+	uint32_t offset; // R_OFFSET_ALLOC_NONE when the allocation failed
+	uint32_t node;   // internal, identifies the allocation to r_offset_free
+} R_OffsetAllocation;
+
+// One region, free or in use, linked to its neighbours in address order.
+typedef struct R_OffsetNode
+{
+	uint32_t offset;
+	uint32_t size;
+	uint32_t binPrev; // free regions only
+	uint32_t binNext;
+	uint32_t neighborPrev;
+	uint32_t neighborNext;
+	bool     used;
+} R_OffsetNode;
+
+typedef struct R_OffsetAllocator
+{
+	uint32_t      size;
+	uint32_t      maxAllocs;
+	uint32_t      allocCount;
+	uint32_t      freeStorage;
+	uint32_t      usedBinsTop; // bit per top bin with any leaf bin in use
+	uint8_t       usedBins[R_OFFSET_ALLOC_TOP_BINS];
+	uint32_t      binHeads[R_OFFSET_ALLOC_BINS];
+	R_OffsetNode *nodes;
+	uint32_t     *freeNodes; // stack of unused node indices
+	uint32_t      freeNodeCount;
+	uint32_t      nodeCount;
+} R_OffsetAllocator;
+
+typedef struct R_OffsetAllocStats
+{
+	uint32_t freeStorage;
+	uint32_t largestFree; // lower bound, the size of the largest non-empty bin
+	uint32_t allocCount;
+	uint32_t freeRegions;
+} R_OffsetAllocStats;
+
+bool r_offset_alloc_init( R_OffsetAllocator *allocator, uint32_t size, uint32_t maxAllocs );
+void r_offset_alloc_free( R_OffsetAllocator *allocator );
+// Frees every allocation at once.
+void r_offset_alloc_reset( R_OffsetAllocator *allocator );
+
+R_OffsetAllocation r_offset_alloc( R_OffsetAllocator *allocator, uint32_t size );
+void               r_offset_free( R_OffsetAllocator *allocator, R_OffsetAllocation allocation );
+uint32_t           r_offset_alloc_size( const R_OffsetAllocator *allocator, R_OffsetAllocation allocation );
+
+void r_offset_alloc_get_stats( const R_OffsetAllocator *allocator, R_OffsetAllocStats *outStats );
+
+#endif // R_OFFSET_ALLOC_H
@@ -0,0 +1,115 @@
+#include "r_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t r_pool_make_handle( uint32_t generation, uint32_t slot )
+{
+	return ( generation << R_POOL_SLOT_BITS ) | slot;
+}
+
+bool r_pool_init( R_Pool *pool, uint32_t capacity )
+{
+	memset( pool, 0, sizeof( *pool ) );
+	if ( capacity == 0 || capacity > R_POOL_MAX_CAPACITY )
+		return false;
+
+	pool->generations = (uint16_t *)malloc( capacity * sizeof( uint16_t ) );
+	pool->slotToDense = (uint32_t *)malloc( capacity * sizeof( uint32_t ) );
+	pool->denseToSlot = (uint32_t *)malloc( capacity * sizeof( uint32_t ) );
+	if ( !pool->generations || !pool->slotToDense || !pool->denseToSlot )
+	{
+		r_pool_free( pool );
+		return false;
+	}
+
+	pool->capacity = capacity;
+	for ( uint32_t i = 0; i < capacity; ++i )
+	{
+		pool->generations[i] = 1;
+		pool->slotToDense[i] = i + 1 < capacity ? i + 1 : R_POOL_INVALID;
+	}
+	pool->freeHead = 0;
+	return true;
+}
+
+void r_pool_free( R_Pool *pool )
+{
+	free( pool->generations );
+	free( pool->slotToDense );
+	free( pool->denseToSlot );
+	memset( pool, 0, sizeof( *pool ) );
+}
+
+uint32_t r_pool_alloc( R_Pool *pool, uint32_t *outDense )
+{
+	if ( pool->freeHead == R_POOL_INVALID || pool->count == pool->capacity )
+		return 0;
+
+	uint32_t slot  = pool->freeHead;
+	uint32_t dense = pool->count++;
+
+	pool->freeHead           = pool->slotToDense[slot];
+	pool->slotToDense[slot]  = dense;
+	pool->denseToSlot[dense] = slot;
+
+	*outDense = dense;
+	return r_pool_make_handle( pool->generations[slot], slot );
+}
+
+bool r_pool_release( R_Pool *pool, uint32_t handle, uint32_t *outDense, uint32_t *outMovedFrom )
+{
+	uint32_t dense = r_pool_lookup( pool, handle );
+	if ( dense == R_POOL_INVALID )
+		return false;
+
+	uint32_t slot = handle & R_POOL_SLOT_MASK;
+	uint32_t last = --pool->count;
+
+	// Swap-remove keeps the live range packed.
+	if ( dense != last )
+	{
+		uint32_t movedSlot           = pool->denseToSlot[last];
+		pool->denseToSlot[dense]     = movedSlot;
+		pool->slotToDense[movedSlot] = dense;
+	}
+
+	uint16_t generation     = (uint16_t)( ( pool->generations[slot] + 1 ) & R_POOL_GENERATION_MASK );
+	pool->generations[slot] = generation ? generation : 1;
+	pool->slotToDense[slot] = pool->freeHead;
+	pool->freeHead          = slot;
+
+	*outDense     = dense;
+	*outMovedFrom = last;
+	return true;
+}
+
+bool r_pool_is_valid( const R_Pool *pool, uint32_t handle )
+{
+	uint32_t slot       = handle & R_POOL_SLOT_MASK;
+	uint32_t generation = handle >> R_POOL_SLOT_BITS;
+	return handle != 0 && slot < pool->capacity && pool->generations[slot] == generation &&
+	       pool->slotToDense[slot] < pool->count && pool->denseToSlot[pool->slotToDense[slot]] == slot;
+}
+
+uint32_t r_pool_lookup( const R_Pool *pool, uint32_t handle )
+{
+	if ( handle == 0 )
+		return R_POOL_INVALID;
+
+	if ( !r_pool_is_valid( pool, handle ) )
+	{
+		assert( 0 && "r_pool: stale or foreign handle" );
+		return R_POOL_INVALID;
+	}
+	return pool->slotToDense[handle & R_POOL_SLOT_MASK];
+}
+
+uint32_t r_pool_handle_at( const R_Pool *pool, uint32_t dense )
+{
+	if ( dense >= pool->count )
+		return 0;
+	uint32_t slot = pool->denseToSlot[dense];
+	return r_pool_make_handle( pool->generations[slot], slot );
+}
@@ -0,0 +1,53 @@
+#ifndef R_POOL_H
+#define R_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Generational handle pool with dense storage.
+//
+// A handle is 32 bits: [31..20] generation, [19..0] slot. The pool only
+// manages the slot <-> dense index mapping; the owner keeps its per-object
+// fields in plain arrays indexed by the dense index, so live objects are
+// always packed in [0, count). Releasing moves the last dense element into
+// the hole, the owner mirrors that move on its own arrays.
+//
+// Generations start at 1, so a zeroed handle is never valid.
+//
+
+#define R_POOL_SLOT_BITS 20
+#define R_POOL_SLOT_MASK ( ( 1u << R_POOL_SLOT_BITS ) - 1 )
+#define R_POOL_GENERATION_BITS 12
+#define R_POOL_GENERATION_MASK ( ( 1u << R_POOL_GENERATION_BITS ) - 1 )
+#define R_POOL_MAX_CAPACITY ( 1u << R_POOL_SLOT_BITS )
+#define R_POOL_INVALID 0xffffffffu
+
+typedef struct R_Pool
+{
+	uint32_t  capacity;
+	uint32_t  count;
+	uint32_t  freeHead;
+	uint16_t *generations; // per slot
+	uint32_t *slotToDense; // per slot, free-list link while the slot is unused
+	uint32_t *denseToSlot; // per dense index
+} R_Pool;
+
+bool r_pool_init( R_Pool *pool, uint32_t capacity );
+void r_pool_free( R_Pool *pool );
+
+// Returns 0 when the pool is full. *outDense is where the new object's fields go.
+uint32_t r_pool_alloc( R_Pool *pool, uint32_t *outDense );
+
+// *outDense is the freed dense index; if *outMovedFrom differs from it, the
+// element at *outMovedFrom has to be moved into *outDense by the owner.
+bool r_pool_release( R_Pool *pool, uint32_t handle, uint32_t *outDense, uint32_t *outMovedFrom );
+
+// Dense index for a handle, R_POOL_INVALID for 0 or stale handles.
+// Debug builds assert on stale handles; 0 is always accepted as "no object".
+uint32_t r_pool_lookup( const R_Pool *pool, uint32_t handle );
+
+bool     r_pool_is_valid( const R_Pool *pool, uint32_t handle );
+uint32_t r_pool_handle_at( const R_Pool *pool, uint32_t dense );
+
+#endif // R_POOL_H
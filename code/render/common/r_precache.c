@@ -0,0 +1,143 @@
+#include "r_precache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool r_precache_creates( R_CaptureOp op )
+{
+	return op == R_CAPTURE_CREATE_VERTEX_SHADER || op == R_CAPTURE_CREATE_PIXEL_SHADER ||
+	       op == R_CAPTURE_CREATE_INPUT_LAYOUT || op == R_CAPTURE_CREATE_PIPELINE || op == R_CAPTURE_CREATE_SAMPLER;
+}
+
+// Everything the call would write to a capture, except its id.
+static uint64_t r_precache_hash_call( const R_CaptureCall *call )
+{
+	uint32_t op   = (uint32_t)call->op;
+	uint64_t hash = r_hash_bytes( &op, sizeof( op ), R_HASH_SEED );
+	hash          = r_hash_bytes( call->refs, sizeof( call->refs ), hash );
+	hash          = r_hash_bytes( call->args, sizeof( call->args ), hash );
+	hash          = r_hash_bytes( call->floats, sizeof( call->floats ), hash );
+	hash          = r_hash_bytes( &call->size, sizeof( call->size ), hash );
+	hash          = call->size ? r_hash_bytes( call->data, call->size, hash ) : hash;
+	hash          = r_hash_bytes( &call->elementCount, sizeof( call->elementCount ), hash );
+	for ( uint32_t i = 0; i < call->elementCount; ++i )
+	{
+		const R_CaptureElement *e = &call->elements[i];
+		uint32_t u[6] = { e->semanticIndex, e->format, e->slot, e->offset, e->perInstance, e->stepRate };
+		hash          = r_hash_string( e->semantic, hash );
+		hash          = r_hash_bytes( u, sizeof( u ), hash );
+	}
+	return hash;
+}
+
+bool r_precache_recorder_init( R_PrecacheRecorder *recorder )
+{
+	memset( recorder, 0, sizeof( *recorder ) );
+	r_capture_writer_init( &recorder->writer );
+	return r_hash_map_init( &recorder->entries, 256 );
+}
+
+void r_precache_recorder_free( R_PrecacheRecorder *recorder )
+{
+	r_capture_writer_free( &recorder->writer );
+	r_hash_map_free( &recorder->entries );
+	memset( recorder, 0, sizeof( *recorder ) );
+}
+
+uint32_t r_precache_record( R_PrecacheRecorder *recorder, const R_CaptureCall *call )
+{
+	if ( !r_precache_creates( call->op ) || recorder->writer.failed )
+		return 0;
+
+	uint64_t hash = r_precache_hash_call( call );
+	uint32_t id   = 0;
+	if ( r_hash_map_get( &recorder->entries, hash, &id ) )
+		return id;
+
+	R_CaptureCall entry = *call;
+	entry.id            = recorder->count + 1;
+	r_capture_write( &recorder->writer, &entry );
+	if ( recorder->writer.failed || !r_hash_map_put( &recorder->entries, hash, entry.id ) )
+		return 0;
+
+	recorder->count++;
+	return entry.id;
+}
+
+bool r_precache_save( R_PrecacheRecorder *recorder, const char *path )
+{
+	return r_capture_writer_save( &recorder->writer, path );
+}
+
+static void r_precache_run( void *arg )
+{
+	R_Precache   *precache = (R_Precache *)arg;
+	R_CaptureCall call;
+	while ( r_capture_reader_next( &precache->reader, &call ) )
+	{
+		if ( !r_precache_creates( call.op ) )
+			continue;
+		precache->stats.entries++;
+
+		// Entries that failed take everything built on them down too.
+		bool resolved = true;
+		for ( int i = 0; i < 4; ++i )
+		{
+			if ( call.refs[i] )
+				resolved = resolved && r_hash_map_get( &precache->objects, call.refs[i], &call.refs[i] );
+		}
+
+		uint32_t created = resolved ? precache->target.execute( precache->target.self, &call ) : 0;
+		if ( created && r_hash_map_put( &precache->objects, call.id, created ) )
+			precache->stats.created++;
+		else
+			precache->stats.failed++;
+	}
+
+	sys_atomic_store( &precache->finished, 1 );
+}
+
+bool r_precache_start( R_Precache *precache, const void *data, size_t size, const R_ReplayTarget *target )
+{
+	memset( precache, 0, sizeof( *precache ) );
+	if ( !target || !target->execute || !r_capture_reader_init( &precache->reader, data, size ) ||
+	     !r_hash_map_init( &precache->objects, precache->reader.calls ? precache->reader.calls : 16 ) )
+	{
+		r_hash_map_free( &precache->objects );
+		return false;
+	}
+
+	precache->target = *target;
+	if ( !sys_thread_start( &precache->thread, r_precache_run, precache ) )
+	{
+		r_hash_map_free( &precache->objects );
+		return false;
+	}
+	precache->running = true;
+	return true;
+}
+
+bool r_precache_finished( R_Precache *precache )
+{
+	if ( precache->running && sys_atomic_load( &precache->finished ) )
+	{
+		sys_thread_join( &precache->thread );
+		precache->running = false;
+	}
+	return !precache->running;
+}
+
+void r_precache_wait( R_Precache *precache )
+{
+	if ( !precache->running )
+		return;
+	sys_thread_join( &precache->thread );
+	precache->running = false;
+}
+
+void r_precache_free( R_Precache *precache )
+{
+	r_precache_wait( precache );
+	r_hash_map_free( &precache->objects );
+	memset( precache, 0, sizeof( *precache ) );
+}
@@ -0,0 +1,67 @@
+#ifndef R_PRECACHE_H
+#define R_PRECACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_thread.h"
+#include "r_capture.h"
+#include "r_hash.h"
+#include "r_replay.h"
+
+//
+// Pipeline precache manifests. A session records the shaders, input layouts,
+// pipelines and samplers it creates; the next one replays the manifest on a
+// background thread at startup, so the driver has built all of them before the
+// first frame that draws with them instead of in the middle of it.
+//
+// A manifest is a capture (r_capture.h) of create calls only, each one after
+// the entries it names. Ids are local to the manifest, and an entry is in it
+// once however often the session created it: calls are deduplicated on their
+// contents, by hash only, so a (64-bit) collision just leaves an entry out.
+//
+
+typedef struct R_PrecacheRecorder
+{
+	R_CaptureWriter writer;
+	R_HashMap       entries; // content hash -> manifest id
+	uint32_t        count;
+} R_PrecacheRecorder;
+
+bool r_precache_recorder_init( R_PrecacheRecorder *recorder );
+void r_precache_recorder_free( R_PrecacheRecorder *recorder );
+// Adds a create call whose refs are ids this recorder returned; the call's own id is ignored.
+// Returns the entry's id (the earlier one for a repeated call), 0 when out of memory.
+uint32_t r_precache_record( R_PrecacheRecorder *recorder, const R_CaptureCall *call );
+bool     r_precache_save( R_PrecacheRecorder *recorder, const char *path );
+
+typedef struct R_PrecacheStats
+{
+	uint32_t entries;
+	uint32_t created;
+	uint32_t failed; // refused by the target, or naming an entry that was
+	uint32_t hits;   // left to the backend: creates that found a precached object
+} R_PrecacheStats;
+
+typedef struct R_Precache
+{
+	R_CaptureReader reader;
+	R_ReplayTarget  target;
+	R_HashMap       objects; // manifest id -> target id
+	SYS_Thread      thread;
+	SYS_Atomic64    finished;
+	bool            running;
+	R_PrecacheStats stats; // only read once finished
+} R_Precache;
+
+// Replays the manifest's create calls through target.execute, on a thread of its own: the target is
+// that thread's until r_precache_finished returns true. data has to outlive the replay. False when
+// it isn't a manifest or the thread didn't start.
+bool r_precache_start( R_Precache *precache, const void *data, size_t size, const R_ReplayTarget *target );
+bool r_precache_finished( R_Precache *precache );
+void r_precache_wait( R_Precache *precache );
+// Waits for the replay first.
+void r_precache_free( R_Precache *precache );
+
+#endif // R_PRECACHE_H
@@ -0,0 +1,123 @@
+#include "r_release_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool r_release_queue_init( R_ReleaseQueue *queue, uint32_t capacity, R_ReleaseFn release, void *user )
+{
+	memset( queue, 0, sizeof( *queue ) );
+	if ( !release )
+		return false;
+	if ( capacity == 0 )
+		capacity = R_RELEASE_QUEUE_CAPACITY;
+
+	uint64_t size = 1;
+	while ( size < capacity )
+		size <<= 1;
+
+	queue->slots = (R_ReleaseSlot *)malloc( size * sizeof( R_ReleaseSlot ) );
+	if ( !queue->slots )
+		return false;
+
+	for ( uint64_t i = 0; i < size; ++i )
+	{
+		sys_atomic_store( &queue->slots[i].sequence, (int64_t)i );
+		queue->slots[i].object = NULL;
+		queue->slots[i].frame  = 0;
+	}
+
+	queue->capacity = size;
+	queue->release  = release;
+	queue->user     = user;
+	return true;
+}
+
+void r_release_queue_free( R_ReleaseQueue *queue )
+{
+	if ( queue->slots )
+		r_release_queue_drain( queue );
+	free( queue->slots );
+	memset( queue, 0, sizeof( *queue ) );
+}
+
+bool r_release_queue_push( R_ReleaseQueue *queue, void *object )
+{
+	if ( !queue->slots || !object )
+		return false;
+
+	uint64_t frame    = (uint64_t)sys_atomic_load( &queue->frame );
+	int64_t  position = sys_atomic_load( &queue->tail );
+	for ( ;; )
+	{
+		R_ReleaseSlot *slot     = &queue->slots[(uint64_t)position & ( queue->capacity - 1 )];
+		int64_t        sequence = sys_atomic_load( &slot->sequence );
+
+		if ( sequence == position )
+		{
+			// Free for this position; claim it, a failed CAS leaves the current tail in position.
+			if ( sys_atomic_cas( &queue->tail, &position, position + 1 ) )
+			{
+				slot->object = object;
+				slot->frame  = frame;
+				sys_atomic_store( &slot->sequence, position + 1 );
+				return true;
+			}
+		}
+		else if ( sequence < position )
+		{
+			// Still holding the object from one lap ago.
+			sys_atomic_add( &queue->rejected, 1 );
+			return false;
+		}
+		else
+		{
+			// Another producer took this position.
+			position = sys_atomic_load( &queue->tail );
+		}
+	}
+}
+
+void r_release_queue_set_frame( R_ReleaseQueue *queue, uint64_t frame )
+{
+	sys_atomic_store( &queue->frame, (int64_t)frame );
+}
+
+uint32_t r_release_queue_collect( R_ReleaseQueue *queue, uint64_t completedFrame )
+{
+	uint32_t released = 0;
+	while ( queue->slots )
+	{
+		R_ReleaseSlot *slot = &queue->slots[queue->head & ( queue->capacity - 1 )];
+
+		// Empty, or claimed by a producer that hasn't published it yet.
+		if ( sys_atomic_load( &slot->sequence ) != (int64_t)( queue->head + 1 ) )
+			break;
+		if ( slot->frame >= completedFrame )
+			break;
+
+		void *object = slot->object;
+		slot->object = NULL;
+		sys_atomic_store( &slot->sequence, (int64_t)( queue->head + queue->capacity ) );
+		queue->head++;
+
+		queue->release( queue->user, object );
+		released++;
+	}
+
+	queue->released += released;
+	return released;
+}
+
+uint32_t r_release_queue_drain( R_ReleaseQueue *queue )
+{
+	return r_release_queue_collect( queue, UINT64_MAX );
+}
+
+void r_release_queue_get_stats( R_ReleaseQueue *queue, R_ReleaseStats *outStats )
+{
+	uint64_t tail      = (uint64_t)sys_atomic_load( &queue->tail );
+	outStats->queued   = tail;
+	outStats->released = queue->released;
+	outStats->rejected = (uint64_t)sys_atomic_load( &queue->rejected );
+	outStats->pending  = tail - queue->head;
+}
@@ -0,0 +1,70 @@
+#ifndef R_RELEASE_QUEUE_H
+#define R_RELEASE_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_thread.h"
+
+//
+// Deferred destruction. Objects the GPU may still be reading are pushed here
+// instead of being released, tagged with the frame being recorded, and the
+// owner hands them back once that frame's fence has passed.
+//
+// Pushing is lock-free and safe from any thread (a bounded MPSC ring: each
+// producer claims a position with a CAS and publishes its slot through the
+// slot's sequence number). Collecting is single-consumer, the thread that
+// advances the frames.
+//
+
+#define R_RELEASE_QUEUE_CAPACITY 16384
+
+typedef void ( *R_ReleaseFn )( void *user, void *object );
+
+typedef struct R_ReleaseSlot
+{
+	SYS_Atomic64 sequence; // position when free for its next producer, position + 1 once filled
+	void        *object;
+	uint64_t     frame;
+} R_ReleaseSlot;
+
+typedef struct R_ReleaseStats
+{
+	uint64_t queued;
+	uint64_t released;
+	uint64_t rejected; // pushes refused because the queue was full
+	uint64_t pending;
+} R_ReleaseStats;
+
+typedef struct R_ReleaseQueue
+{
+	R_ReleaseSlot *slots;
+	uint64_t       capacity; // power of two
+	SYS_Atomic64   tail;     // next position producers claim
+	uint64_t       head;     // next position to release, consumer only
+	SYS_Atomic64   frame;    // tag for new objects
+	SYS_Atomic64   rejected;
+	uint64_t       released;
+	R_ReleaseFn    release;
+	void          *user;
+} R_ReleaseQueue;
+
+// capacity is rounded up to a power of two, 0 picks R_RELEASE_QUEUE_CAPACITY.
+bool r_release_queue_init( R_ReleaseQueue *queue, uint32_t capacity, R_ReleaseFn release, void *user );
+// Releases everything still queued, the caller makes sure the GPU is done with it.
+void r_release_queue_free( R_ReleaseQueue *queue );
+
+// Any thread. False when the queue is full; the caller has to release the object itself.
+bool r_release_queue_push( R_ReleaseQueue *queue, void *object );
+
+// Consumer only. Objects pushed from now on belong to frame.
+void     r_release_queue_set_frame( R_ReleaseQueue *queue, uint64_t frame );
+// Consumer only. Releases, in push order, the objects of every frame before completedFrame.
+uint32_t r_release_queue_collect( R_ReleaseQueue *queue, uint64_t completedFrame );
+// Consumer only. Releases everything that's queued, e.g. after a wait for the GPU at level unload.
+uint32_t r_release_queue_drain( R_ReleaseQueue *queue );
+
+void r_release_queue_get_stats( R_ReleaseQueue *queue, R_ReleaseStats *outStats );
+
+#endif // R_RELEASE_QUEUE_H
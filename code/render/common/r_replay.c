@@ -0,0 +1,234 @@
+#include "r_replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+uint64_t r_replay_now( void )
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER        counter;
+	if ( !frequency.QuadPart )
+		QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return (uint64_t)( (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart );
+#else
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Type of the object in the call's id, R_REPLAY_OBJECT_TYPES when it has none.
+static R_ReplayObjectType r_replay_object_type( R_CaptureOp op )
+{
+	switch ( op )
+	{
+	case R_CAPTURE_CREATE_BUFFER:
+	case R_CAPTURE_UPDATE_BUFFER:
+	case R_CAPTURE_UPLOAD_BUFFER:
+	case R_CAPTURE_DESTROY_BUFFER:
+	case R_CAPTURE_BIND_CONSTANT_BUFFER:
+	case R_CAPTURE_SET_VERTEX_BUFFER:
+	case R_CAPTURE_SET_INDEX_BUFFER:
+	case R_CAPTURE_COPY_BUFFER:
+		return R_REPLAY_BUFFER;
+	case R_CAPTURE_CREATE_VERTEX_SHADER:
+	case R_CAPTURE_DESTROY_VERTEX_SHADER:
+		return R_REPLAY_VERTEX_SHADER;
+	case R_CAPTURE_CREATE_PIXEL_SHADER:
+	case R_CAPTURE_DESTROY_PIXEL_SHADER:
+		return R_REPLAY_PIXEL_SHADER;
+	case R_CAPTURE_CREATE_INPUT_LAYOUT:
+	case R_CAPTURE_DESTROY_INPUT_LAYOUT:
+		return R_REPLAY_INPUT_LAYOUT;
+	case R_CAPTURE_CREATE_PIPELINE:
+	case R_CAPTURE_DESTROY_PIPELINE:
+	case R_CAPTURE_BIND_PIPELINE:
+		return R_REPLAY_PIPELINE;
+	default:
+		return R_REPLAY_OBJECT_TYPES;
+	}
+}
+
+static bool r_replay_creates( R_CaptureOp op )
+{
+	return op == R_CAPTURE_CREATE_BUFFER || op == R_CAPTURE_CREATE_VERTEX_SHADER ||
+	       op == R_CAPTURE_CREATE_PIXEL_SHADER || op == R_CAPTURE_CREATE_INPUT_LAYOUT ||
+	       op == R_CAPTURE_CREATE_PIPELINE;
+}
+
+static bool r_replay_destroys( R_CaptureOp op )
+{
+	return op == R_CAPTURE_DESTROY_BUFFER || op == R_CAPTURE_DESTROY_VERTEX_SHADER ||
+	       op == R_CAPTURE_DESTROY_PIXEL_SHADER || op == R_CAPTURE_DESTROY_INPUT_LAYOUT ||
+	       op == R_CAPTURE_DESTROY_PIPELINE;
+}
+
+static uint32_t r_replay_lookup( R_Replay *replay, R_ReplayObjectType type, uint32_t id )
+{
+	uint32_t mapped = 0;
+	if ( id && !r_hash_map_get( &replay->objects[type], id, &mapped ) )
+		replay->stats.missingObjects++;
+	return mapped;
+}
+
+static void r_replay_issue( R_Replay *replay, const R_CaptureCall *captured )
+{
+	R_CaptureCall      call    = *captured;
+	R_ReplayObjectType type    = r_replay_object_type( call.op );
+	bool               creates = r_replay_creates( call.op );
+
+	if ( call.op == R_CAPTURE_CREATE_INPUT_LAYOUT )
+		call.refs[0] = r_replay_lookup( replay, R_REPLAY_VERTEX_SHADER, call.refs[0] );
+	if ( call.op == R_CAPTURE_COPY_BUFFER )
+		call.refs[0] = r_replay_lookup( replay, R_REPLAY_BUFFER, call.refs[0] );
+	if ( call.op == R_CAPTURE_CREATE_PIPELINE )
+	{
+		call.refs[0] = r_replay_lookup( replay, R_REPLAY_VERTEX_SHADER, call.refs[0] );
+		call.refs[1] = r_replay_lookup( replay, R_REPLAY_PIXEL_SHADER, call.refs[1] );
+		call.refs[2] = r_replay_lookup( replay, R_REPLAY_INPUT_LAYOUT, call.refs[2] );
+		call.refs[3] = r_replay_lookup( replay, R_REPLAY_PIPELINE, call.refs[3] );
+	}
+
+	if ( creates )
+		call.id = 0;
+	else if ( type != R_REPLAY_OBJECT_TYPES )
+		call.id = r_replay_lookup( replay, type, call.id );
+
+	uint32_t created = replay->target.execute( replay->target.self, &call );
+	if ( type == R_REPLAY_OBJECT_TYPES )
+		return;
+
+	// Shared objects (layouts, pipelines) come back with the same id from several creates, the
+	// mapping lives until the last matching destroy so a stale target id is never passed on.
+	uint32_t references = 0;
+	r_hash_map_get( &replay->references[type], captured->id, &references );
+	if ( creates && created )
+	{
+		r_hash_map_put( &replay->objects[type], captured->id, created );
+		r_hash_map_put( &replay->references[type], captured->id, references + 1 );
+	}
+	else if ( creates )
+		replay->stats.failedCreates++;
+	else if ( r_replay_destroys( call.op ) && references > 1 )
+		r_hash_map_put( &replay->references[type], captured->id, references - 1 );
+	else if ( r_replay_destroys( call.op ) && references )
+	{
+		r_hash_map_remove( &replay->objects[type], captured->id );
+		r_hash_map_remove( &replay->references[type], captured->id );
+	}
+}
+
+bool r_replay_init( R_Replay *replay, const void *data, size_t size, const R_ReplayTarget *target )
+{
+	memset( replay, 0, sizeof( *replay ) );
+	if ( !target || !target->execute || !r_capture_reader_init( &replay->reader, data, size ) )
+		return false;
+	replay->target = *target;
+
+	// Counts the calls on each side of the FRAME call, the frame ends with PRESENT.
+	R_CaptureCall call;
+	bool          inFrame = false;
+	while ( r_capture_reader_next( &replay->reader, &call ) )
+	{
+		if ( !inFrame )
+		{
+			replay->stats.setupCalls++;
+			inFrame = call.op == R_CAPTURE_FRAME;
+			continue;
+		}
+		replay->stats.frameCalls++;
+		if ( call.op == R_CAPTURE_PRESENT )
+			break;
+	}
+	if ( !inFrame || replay->reader.corrupt || replay->stats.frameCalls == 0 )
+		return false;
+
+	replay->callNanoseconds = (uint64_t *)calloc( replay->stats.frameCalls, sizeof( uint64_t ) );
+	replay->callOps         = (uint8_t *)calloc( replay->stats.frameCalls, sizeof( uint8_t ) );
+	for ( int i = 0; i < R_REPLAY_OBJECT_TYPES; ++i )
+	{
+		if ( !r_hash_map_init( &replay->objects[i], 64 ) || !r_hash_map_init( &replay->references[i], 64 ) )
+			return false;
+	}
+	replay->stats.fastestFrame = UINT64_MAX;
+	return replay->callNanoseconds && replay->callOps;
+}
+
+void r_replay_free( R_Replay *replay )
+{
+	for ( int i = 0; i < R_REPLAY_OBJECT_TYPES; ++i )
+	{
+		r_hash_map_free( &replay->objects[i] );
+		r_hash_map_free( &replay->references[i] );
+	}
+	free( replay->callNanoseconds );
+	free( replay->callOps );
+	memset( replay, 0, sizeof( *replay ) );
+}
+
+bool r_replay_setup( R_Replay *replay )
+{
+	if ( replay->frameStart )
+		return true;
+
+	r_capture_reader_rewind( &replay->reader );
+
+	uint64_t      start = r_replay_now();
+	R_CaptureCall call;
+	for ( uint32_t i = 0; i < replay->stats.setupCalls; ++i )
+	{
+		if ( !r_capture_reader_next( &replay->reader, &call ) )
+			return false;
+		r_replay_issue( replay, &call );
+	}
+	replay->stats.setupNanoseconds = r_replay_now() - start;
+	replay->frameStart             = replay->reader.cursor;
+	return true;
+}
+
+bool r_replay_frame( R_Replay *replay )
+{
+	if ( !r_replay_setup( replay ) )
+		return false;
+
+	R_CaptureReader *reader = &replay->reader;
+	reader->cursor          = replay->frameStart;
+	reader->callsRead       = replay->stats.setupCalls;
+
+	uint64_t      start = r_replay_now();
+	R_CaptureCall call;
+	for ( uint32_t i = 0; i < replay->stats.frameCalls; ++i )
+	{
+		if ( !r_capture_reader_next( reader, &call ) )
+			return false;
+
+		uint64_t before = r_replay_now();
+		r_replay_issue( replay, &call );
+		uint64_t elapsed = r_replay_now() - before;
+
+		R_ReplayOpStats *op = &replay->stats.ops[call.op];
+		op->calls++;
+		op->nanoseconds += elapsed;
+		if ( elapsed > op->maxNanoseconds )
+			op->maxNanoseconds = elapsed;
+		replay->callNanoseconds[i] += elapsed;
+		replay->callOps[i] = (uint8_t)call.op;
+	}
+
+	uint64_t frame = r_replay_now() - start;
+	replay->stats.frameNanoseconds += frame;
+	replay->stats.frames++;
+	if ( frame < replay->stats.fastestFrame )
+		replay->stats.fastestFrame = frame;
+	if ( frame > replay->stats.slowestFrame )
+		replay->stats.slowestFrame = frame;
+	return true;
+}
@@ -0,0 +1,81 @@
+#ifndef R_REPLAY_H
+#define R_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "r_capture.h"
+#include "r_hash.h"
+
+//
+// Replays a capture (see r_capture.h) against a target backend. Handles in the
+// calls are translated from the captured ids to the ones the target handed out,
+// so any backend that implements execute can take a capture of any other. The
+// setup calls run once, the frame as often as asked, and every frame call is
+// timed on its own: captured frames become repeatable CPU benchmarks.
+//
+
+typedef struct R_ReplayTarget
+{
+	const char *name;
+	void       *self;
+	// Issues one call. Creates return the new object's id, 0 on failure; the return value of
+	// everything else is ignored. Calls naming an object that wasn't created see id 0.
+	uint32_t ( *execute )( void *self, const R_CaptureCall *call );
+} R_ReplayTarget;
+
+typedef struct R_ReplayOpStats
+{
+	uint64_t calls;
+	uint64_t nanoseconds;
+	uint64_t maxNanoseconds;
+} R_ReplayOpStats;
+
+typedef struct R_ReplayStats
+{
+	R_ReplayOpStats ops[R_CAPTURE_OP_COUNT]; // frame calls only
+	uint64_t        setupNanoseconds;
+	uint64_t        frameNanoseconds; // every replayed frame, wall clock
+	uint64_t        fastestFrame;
+	uint64_t        slowestFrame;
+	uint32_t        frames;
+	uint32_t        setupCalls;
+	uint32_t        frameCalls;     // per frame
+	uint32_t        failedCreates;  // refused by the target
+	uint32_t        missingObjects; // calls naming an object that wasn't created
+} R_ReplayStats;
+
+typedef enum
+{
+	R_REPLAY_BUFFER = 0,
+	R_REPLAY_VERTEX_SHADER,
+	R_REPLAY_PIXEL_SHADER,
+	R_REPLAY_INPUT_LAYOUT,
+	R_REPLAY_PIPELINE,
+	R_REPLAY_OBJECT_TYPES,
+} R_ReplayObjectType;
+
+typedef struct R_Replay
+{
+	R_CaptureReader reader;
+	R_ReplayTarget  target;
+	R_HashMap       objects[R_REPLAY_OBJECT_TYPES];    // captured id -> target id
+	R_HashMap       references[R_REPLAY_OBJECT_TYPES]; // captured id -> creates not destroyed yet
+	size_t          frameStart;                        // reader cursor right after the FRAME call
+	uint64_t       *callNanoseconds;                   // per frame call, summed over every frame
+	uint8_t        *callOps;
+	R_ReplayStats   stats;
+} R_Replay;
+
+// data has to outlive the replay. False when it isn't a capture or has no frame in it.
+bool r_replay_init( R_Replay *replay, const void *data, size_t size, const R_ReplayTarget *target );
+void r_replay_free( R_Replay *replay );
+// Runs the setup calls; r_replay_frame runs it on first use.
+bool r_replay_setup( R_Replay *replay );
+// One pass over the frame's calls, PRESENT included. Objects the frame destroys are gone for the
+// passes after it, calls naming them then show up in missingObjects.
+bool r_replay_frame( R_Replay *replay );
+
+uint64_t r_replay_now( void );
+
+#endif // R_REPLAY_H
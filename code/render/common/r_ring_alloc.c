@@ -0,0 +1,100 @@
+#include "r_ring_alloc.h"
+
+#include <string.h>
+
+bool r_ring_init( R_RingAllocator *ring, size_t size, size_t alignment )
+{
+	memset( ring, 0, sizeof( *ring ) );
+	if ( size == 0 || alignment == 0 || ( alignment & ( alignment - 1 ) ) != 0 )
+		return false;
+
+	ring->size      = size;
+	ring->alignment = alignment;
+	return true;
+}
+
+bool r_ring_alloc( R_RingAllocator *ring, size_t bytes, size_t *outOffset )
+{
+	size_t aligned = ( bytes + ring->alignment - 1 ) & ~( ring->alignment - 1 );
+	if ( aligned == 0 || aligned > ring->size || ring->used + aligned > ring->size )
+		return false;
+
+	// Nothing is live, restart at the front so the whole ring is contiguous again.
+	if ( ring->used == 0 )
+	{
+		ring->head = 0;
+		ring->tail = 0;
+	}
+
+	size_t offset = 0;
+	size_t waste  = 0;
+	if ( ring->head >= ring->tail )
+	{
+		// Free space is [head, size) followed by [0, tail).
+		if ( ring->head + aligned <= ring->size )
+		{
+			offset = ring->head;
+		}
+		else if ( aligned <= ring->tail )
+		{
+			waste  = ring->size - ring->head;
+			offset = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if ( ring->head + aligned > ring->tail )
+			return false;
+		offset = ring->head;
+	}
+
+	ring->head = offset + aligned;
+	ring->used += aligned + waste;
+	ring->frameBytes += aligned + waste;
+
+	*outOffset = offset;
+	return true;
+}
+
+bool r_ring_end_frame( R_RingAllocator *ring, uint64_t frame )
+{
+	if ( ring->frameCount == R_RING_MAX_FRAMES )
+		return false;
+
+	uint32_t     index = ( ring->firstFrame + ring->frameCount ) % R_RING_MAX_FRAMES;
+	R_RingFrame *f     = &ring->frames[index];
+	f->frame           = frame;
+	f->end             = ring->head;
+	f->bytes           = ring->frameBytes;
+
+	ring->frameCount++;
+	ring->frameBytes = 0;
+	return true;
+}
+
+void r_ring_retire( R_RingAllocator *ring, uint64_t completedFrame )
+{
+	while ( ring->frameCount > 0 )
+	{
+		R_RingFrame *f = &ring->frames[ring->firstFrame];
+		if ( f->frame > completedFrame )
+			break;
+
+		ring->tail = f->end;
+		ring->used -= f->bytes;
+		ring->firstFrame = ( ring->firstFrame + 1 ) % R_RING_MAX_FRAMES;
+		ring->frameCount--;
+	}
+}
+
+bool r_ring_oldest_frame( const R_RingAllocator *ring, uint64_t *outFrame )
+{
+	if ( ring->frameCount == 0 )
+		return false;
+	*outFrame = ring->frames[ring->firstFrame].frame;
+	return true;
+}
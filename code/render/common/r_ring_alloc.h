@@ -0,0 +1,54 @@
+#ifndef R_RING_ALLOC_H
+#define R_RING_ALLOC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Offset allocator for a per-frame ring buffer. It only hands out offsets,
+// the backing memory (a dynamic GPU buffer) is owned by the caller.
+//
+// Allocations made between two r_ring_end_frame calls belong to that frame.
+// They are given back in bulk by r_ring_retire once the caller's fence says
+// the GPU is done with the frame, so live data is never overwritten.
+//
+
+#define R_RING_MAX_FRAMES 4
+
+typedef struct R_RingFrame
+{
+	uint64_t frame;
+	size_t   end;   // head at the time the frame was closed
+	size_t   bytes; // allocated + wasted bytes owned by the frame
+} R_RingFrame;
+
+typedef struct R_RingAllocator
+{
+	size_t      size;
+	size_t      alignment;
+	size_t      head;
+	size_t      tail;
+	size_t      used;
+	size_t      frameBytes;
+	R_RingFrame frames[R_RING_MAX_FRAMES];
+	uint32_t    firstFrame;
+	uint32_t    frameCount;
+} R_RingAllocator;
+
+// alignment must be a power of two.
+bool r_ring_init( R_RingAllocator *ring, size_t size, size_t alignment );
+
+// Returns false when the ring has no room until older frames are retired.
+bool r_ring_alloc( R_RingAllocator *ring, size_t bytes, size_t *outOffset );
+
+// Closes the current frame; false when R_RING_MAX_FRAMES are already in flight.
+bool r_ring_end_frame( R_RingAllocator *ring, uint64_t frame );
+
+// Frees every closed frame whose id is <= completedFrame.
+void r_ring_retire( R_RingAllocator *ring, uint64_t completedFrame );
+
+// Oldest frame still holding memory, false if none is in flight.
+bool r_ring_oldest_frame( const R_RingAllocator *ring, uint64_t *outFrame );
+
+#endif // R_RING_ALLOC_H
@@ -0,0 +1,199 @@
+#include "r_shader_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define R_SHADER_CACHE_MAGIC 0x43485352u  // "RSHC"
+#define R_SHADER_RECORD_MAGIC 0x52444853u // "SHDR"
+#define R_SHADER_CACHE_VERSION 1
+#define R_SHADER_CACHE_ALIGNMENT 16
+
+typedef struct R_ShaderCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t reserved;
+} R_ShaderCacheHeader;
+
+typedef struct R_ShaderCacheRecord
+{
+	uint32_t magic;
+	uint32_t size;
+	uint64_t key;
+	uint64_t hash; // payload hash seeded with the key, catches torn writes and stale bytes
+	uint64_t reserved;
+} R_ShaderCacheRecord;
+
+static size_t r_shader_cache_align( size_t size )
+{
+	return ( size + R_SHADER_CACHE_ALIGNMENT - 1 ) & ~(size_t)( R_SHADER_CACHE_ALIGNMENT - 1 );
+}
+
+static uint64_t r_shader_cache_hash_field( const char *str, uint64_t hash )
+{
+	// The terminator goes into the hash too, so ("ab", "c") and ("a", "bc") don't collide.
+	static const char separator = 0;
+	hash                        = r_hash_string( str, hash );
+	return r_hash_bytes( &separator, 1, hash );
+}
+
+uint64_t r_shader_cache_key( const R_ShaderSource *source )
+{
+	uint64_t hash = r_hash_bytes( &source->sourceSize, sizeof( source->sourceSize ), R_HASH_SEED );
+	hash          = r_hash_bytes( source->source, source->sourceSize, hash );
+	hash          = r_shader_cache_hash_field( source->entry, hash );
+	hash          = r_shader_cache_hash_field( source->profile, hash );
+
+	for ( const R_ShaderDefine *d = source->defines; d && d->name; ++d )
+	{
+		hash = r_shader_cache_hash_field( d->name, hash );
+		hash = r_shader_cache_hash_field( d->value, hash );
+	}
+
+	hash = r_hash_bytes( &source->flags, sizeof( source->flags ), hash );
+	hash = r_hash_bytes( &source->compilerVersion, sizeof( source->compilerVersion ), hash );
+	return hash;
+}
+
+// Picks up whatever other processes appended since the last look.
+static void r_shader_cache_refresh( R_ShaderCache *cache )
+{
+	uint64_t fileSize = io_file_size( &cache->file );
+	if ( fileSize > UINT32_MAX )
+		fileSize = UINT32_MAX;
+
+	if ( fileSize != cache->mapping.size )
+	{
+		io_file_unmap( &cache->mapping );
+		if ( !io_file_map( &cache->file, (size_t)fileSize, &cache->mapping ) )
+			return;
+	}
+
+	const uint8_t *base = cache->mapping.data;
+	size_t         size = cache->mapping.size;
+
+	if ( cache->scanned == 0 )
+	{
+		R_ShaderCacheHeader header;
+		if ( size < sizeof( header ) )
+			return;
+
+		memcpy( &header, base, sizeof( header ) );
+		if ( header.magic != R_SHADER_CACHE_MAGIC || header.version != R_SHADER_CACHE_VERSION )
+			return;
+		cache->scanned = sizeof( header );
+	}
+
+	while ( cache->scanned + sizeof( R_ShaderCacheRecord ) <= size )
+	{
+		R_ShaderCacheRecord record;
+		memcpy( &record, base + cache->scanned, sizeof( record ) );
+
+		uint64_t payload = cache->scanned + sizeof( record );
+		uint64_t end     = payload + r_shader_cache_align( record.size );
+		if ( record.magic != R_SHADER_RECORD_MAGIC || end > size ||
+		     r_hash_bytes( base + payload, record.size, record.key ) != record.hash )
+			break;
+
+		// First record for a key wins, a racing duplicate is just dead space.
+		if ( !r_hash_map_get( &cache->index, record.key, NULL ) )
+			r_hash_map_put( &cache->index, record.key, (uint32_t)payload );
+		cache->scanned = end;
+	}
+}
+
+bool r_shader_cache_open( R_ShaderCache *cache, const char *path )
+{
+	memset( cache, 0, sizeof( *cache ) );
+	if ( !io_file_open( &cache->file, path, true ) )
+		return false;
+
+	if ( !r_hash_map_init( &cache->index, 64 ) )
+	{
+		io_file_close( &cache->file );
+		return false;
+	}
+
+	r_shader_cache_refresh( cache );
+	return true;
+}
+
+void r_shader_cache_close( R_ShaderCache *cache )
+{
+	io_file_unmap( &cache->mapping );
+	io_file_close( &cache->file );
+	r_hash_map_free( &cache->index );
+	memset( cache, 0, sizeof( *cache ) );
+}
+
+static bool r_shader_cache_lookup( R_ShaderCache *cache, uint64_t key, const void **outData, size_t *outSize )
+{
+	uint32_t payload;
+	if ( !r_hash_map_get( &cache->index, key, &payload ) )
+		return false;
+
+	R_ShaderCacheRecord record;
+	memcpy( &record, cache->mapping.data + payload - sizeof( record ), sizeof( record ) );
+
+	*outData = cache->mapping.data + payload;
+	*outSize = record.size;
+	return true;
+}
+
+bool r_shader_cache_find( R_ShaderCache *cache, uint64_t key, const void **outData, size_t *outSize )
+{
+	if ( !cache->file.valid )
+		return false;
+
+	if ( r_shader_cache_lookup( cache, key, outData, outSize ) )
+		return true;
+
+	r_shader_cache_refresh( cache );
+	return r_shader_cache_lookup( cache, key, outData, outSize );
+}
+
+bool r_shader_cache_insert( R_ShaderCache *cache, uint64_t key, const void *data, size_t size )
+{
+	if ( !cache->file.valid || !data || size == 0 || size > UINT32_MAX / 2 )
+		return false;
+
+	if ( !io_file_lock( &cache->file, true ) )
+		return false;
+
+	bool ok = true;
+	r_shader_cache_refresh( cache );
+
+	// Empty file or one written by an incompatible version: start over behind a fresh header.
+	if ( cache->scanned == 0 )
+	{
+		R_ShaderCacheHeader header = { R_SHADER_CACHE_MAGIC, R_SHADER_CACHE_VERSION, 0 };
+		ok                         = io_file_write_at( &cache->file, 0, &header, sizeof( header ) );
+		cache->scanned             = ok ? sizeof( header ) : 0;
+	}
+
+	if ( ok && !r_hash_map_get( &cache->index, key, NULL ) )
+	{
+		size_t   total  = sizeof( R_ShaderCacheRecord ) + r_shader_cache_align( size );
+		uint8_t *buffer = (uint8_t *)calloc( 1, total );
+		if ( buffer )
+		{
+			R_ShaderCacheRecord record = { R_SHADER_RECORD_MAGIC, (uint32_t)size, key, 0, 0 };
+			record.hash                = r_hash_bytes( data, size, key );
+			memcpy( buffer, &record, sizeof( record ) );
+			memcpy( buffer + sizeof( record ), data, size );
+
+			// Appending at the end of the valid records also overwrites any tail a crashed writer left behind.
+			ok = cache->scanned + total <= UINT32_MAX &&
+			     io_file_write_at( &cache->file, cache->scanned, buffer, total );
+			free( buffer );
+		}
+		else
+		{
+			ok = false;
+		}
+	}
+
+	io_file_unlock( &cache->file );
+	r_shader_cache_refresh( cache );
+	return ok;
+}
@@ -0,0 +1,59 @@
+#ifndef R_SHADER_CACHE_H
+#define R_SHADER_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_file.h"
+#include "r_hash.h"
+
+//
+// Content addressed store for compiled shader bytecode. Every blob lives in a
+// single append-only file:
+//
+//   [header 16 bytes] [record] [record] ...
+//   record = [magic, size, key, payload hash] [payload, padded to 16 bytes]
+//
+// The file is mapped read-only and indexed by key on open, so a hit hands out
+// a pointer straight into the mapping. Several processes can share the file:
+// writers append under an exclusive file lock, and readers only accept records
+// whose payload hash checks out, so a torn or in-progress append is never seen.
+//
+
+// Same layout as D3D_SHADER_MACRO; a list ends at the first entry with a NULL name.
+typedef struct R_ShaderDefine
+{
+	const char *name;
+	const char *value;
+} R_ShaderDefine;
+
+typedef struct R_ShaderSource
+{
+	const char           *source;
+	size_t                sourceSize;
+	const char           *entry;
+	const char           *profile;
+	const R_ShaderDefine *defines;
+	uint32_t              flags;
+	uint32_t              compilerVersion;
+} R_ShaderSource;
+
+typedef struct R_ShaderCache
+{
+	IO_File    file;
+	IO_Mapping mapping;
+	R_HashMap  index;   // key -> payload offset
+	uint64_t   scanned; // end of the last valid record indexed
+} R_ShaderCache;
+
+uint64_t r_shader_cache_key( const R_ShaderSource *source );
+
+bool r_shader_cache_open( R_ShaderCache *cache, const char *path );
+void r_shader_cache_close( R_ShaderCache *cache );
+
+// On a hit outData points into the mapping and stays valid until the next find or insert.
+bool r_shader_cache_find( R_ShaderCache *cache, uint64_t key, const void **outData, size_t *outSize );
+bool r_shader_cache_insert( R_ShaderCache *cache, uint64_t key, const void *data, size_t size );
+
+#endif // R_SHADER_CACHE_H
@@ -0,0 +1,292 @@
+#include "r_shader_jobs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define R_SHADER_JOB_SLOT_BITS 16
+#define R_SHADER_JOB_SLOT_MASK ( ( 1u << R_SHADER_JOB_SLOT_BITS ) - 1 )
+
+static uint32_t r_shader_job_handle( const R_ShaderJobQueue *queue, uint32_t slot )
+{
+	return ( (uint32_t)queue->jobs[slot].generation << R_SHADER_JOB_SLOT_BITS ) | slot;
+}
+
+// Slot for a live handle, or R_SHADER_JOB_CAPACITY when it's stale. Called with the mutex held.
+static uint32_t r_shader_job_slot( const R_ShaderJobQueue *queue, uint32_t handle )
+{
+	uint32_t slot = handle & R_SHADER_JOB_SLOT_MASK;
+	if ( handle == 0 || slot >= R_SHADER_JOB_CAPACITY ||
+	     queue->jobs[slot].generation != ( handle >> R_SHADER_JOB_SLOT_BITS ) ||
+	     queue->jobs[slot].state == R_SHADER_JOB_FREE )
+		return R_SHADER_JOB_CAPACITY;
+	return slot;
+}
+
+static void r_shader_job_release( R_ShaderJob *job )
+{
+	free( job->storage );
+	free( job->bytecode );
+
+	uint16_t generation = (uint16_t)( job->generation + 1 );
+	memset( job, 0, sizeof( *job ) );
+	job->generation = generation ? generation : 1;
+}
+
+// One allocation holds the define table followed by every string the compiler will read.
+static bool r_shader_job_copy_source( R_ShaderJob *job, const R_ShaderSource *source )
+{
+	size_t defineCount = 0;
+	size_t stringBytes = source->sourceSize + 1 + strlen( source->entry ) + 1 + strlen( source->profile ) + 1;
+	for ( const R_ShaderDefine *d = source->defines; d && d->name; ++d, ++defineCount )
+		stringBytes += strlen( d->name ) + 1 + ( d->value ? strlen( d->value ) : 0 ) + 1;
+
+	size_t tableBytes = defineCount ? ( defineCount + 1 ) * sizeof( R_ShaderDefine ) : 0;
+	char  *storage    = (char *)malloc( tableBytes + stringBytes );
+	if ( !storage )
+		return false;
+
+	R_ShaderDefine *defines = (R_ShaderDefine *)storage;
+	char           *cursor  = storage + tableBytes;
+
+	job->source        = *source;
+	job->source.source = cursor;
+	memcpy( cursor, source->source, source->sourceSize );
+	cursor[source->sourceSize] = 0;
+	cursor += source->sourceSize + 1;
+
+	job->source.entry = strcpy( cursor, source->entry );
+	cursor += strlen( cursor ) + 1;
+	job->source.profile = strcpy( cursor, source->profile );
+	cursor += strlen( cursor ) + 1;
+
+	for ( size_t i = 0; i < defineCount; ++i )
+	{
+		defines[i].name = strcpy( cursor, source->defines[i].name );
+		cursor += strlen( cursor ) + 1;
+		defines[i].value = strcpy( cursor, source->defines[i].value ? source->defines[i].value : "" );
+		cursor += strlen( cursor ) + 1;
+	}
+	if ( defineCount )
+	{
+		defines[defineCount].name  = NULL;
+		defines[defineCount].value = NULL;
+	}
+
+	job->source.defines = defineCount ? defines : NULL;
+	job->storage        = storage;
+	return true;
+}
+
+static void r_shader_job_finish( R_ShaderJob *job, bool ok, void *bytecode, size_t size )
+{
+	if ( job->discarded )
+	{
+		free( bytecode );
+		r_shader_job_release( job );
+		return;
+	}
+
+	ok                = ok && bytecode && size > 0;
+	job->bytecode     = ok ? bytecode : NULL;
+	job->bytecodeSize = ok ? size : 0;
+	job->state        = ok ? R_SHADER_JOB_DONE : R_SHADER_JOB_FAILED;
+	if ( !ok )
+		free( bytecode );
+}
+
+static void r_shader_worker( void *arg )
+{
+	R_ShaderJobQueue *queue = (R_ShaderJobQueue *)arg;
+
+	sys_mutex_lock( &queue->mutex );
+	for ( ;; )
+	{
+		while ( queue->pendingCount == 0 && !queue->shutdown )
+			sys_cond_wait( &queue->wake, &queue->mutex );
+		if ( queue->shutdown )
+			break;
+
+		uint32_t slot      = queue->pending[queue->pendingHead];
+		queue->pendingHead = ( queue->pendingHead + 1 ) % R_SHADER_JOB_CAPACITY;
+		queue->pendingCount--;
+
+		R_ShaderJob *job = &queue->jobs[slot];
+		if ( job->discarded )
+		{
+			r_shader_job_release( job );
+			continue;
+		}
+
+		// The source copy can't go away while RUNNING, discard only flags the job.
+		job->state            = R_SHADER_JOB_RUNNING;
+		R_ShaderSource source = job->source;
+		sys_mutex_unlock( &queue->mutex );
+
+		void  *bytecode = NULL;
+		size_t size     = 0;
+		bool   ok       = queue->compile( queue->user, &source, &bytecode, &size );
+
+		sys_mutex_lock( &queue->mutex );
+		r_shader_job_finish( job, ok, bytecode, size );
+	}
+	sys_mutex_unlock( &queue->mutex );
+}
+
+bool r_shader_jobs_init( R_ShaderJobQueue *queue, int workerCount, R_ShaderCompileFn compile, void *user )
+{
+	memset( queue, 0, sizeof( *queue ) );
+	if ( !compile )
+		return false;
+
+	queue->compile = compile;
+	queue->user    = user;
+	for ( uint32_t i = 0; i < R_SHADER_JOB_CAPACITY; ++i )
+		queue->jobs[i].generation = 1;
+
+	sys_mutex_init( &queue->mutex );
+	sys_cond_init( &queue->wake );
+
+	if ( workerCount > R_SHADER_MAX_WORKERS )
+		workerCount = R_SHADER_MAX_WORKERS;
+	for ( int i = 0; i < workerCount; ++i )
+	{
+		if ( !sys_thread_start( &queue->workers[queue->workerCount], r_shader_worker, queue ) )
+			break;
+		queue->workerCount++;
+	}
+	return true;
+}
+
+void r_shader_jobs_shutdown( R_ShaderJobQueue *queue )
+{
+	if ( !queue->compile )
+		return;
+
+	sys_mutex_lock( &queue->mutex );
+	queue->shutdown = true;
+	sys_cond_broadcast( &queue->wake );
+	sys_mutex_unlock( &queue->mutex );
+
+	for ( int i = 0; i < queue->workerCount; ++i )
+		sys_thread_join( &queue->workers[i] );
+
+	for ( uint32_t i = 0; i < R_SHADER_JOB_CAPACITY; ++i )
+		r_shader_job_release( &queue->jobs[i] );
+
+	sys_cond_destroy( &queue->wake );
+	sys_mutex_destroy( &queue->mutex );
+	memset( queue, 0, sizeof( *queue ) );
+}
+
+uint32_t r_shader_jobs_submit( R_ShaderJobQueue *queue, const R_ShaderSource *source, uint64_t tag )
+{
+	if ( !queue->compile || !source || !source->source || !source->entry || !source->profile )
+		return 0;
+
+	sys_mutex_lock( &queue->mutex );
+
+	uint32_t slot = 0;
+	while ( slot < R_SHADER_JOB_CAPACITY && queue->jobs[slot].state != R_SHADER_JOB_FREE )
+		slot++;
+
+	R_ShaderJob *job = slot < R_SHADER_JOB_CAPACITY ? &queue->jobs[slot] : NULL;
+	if ( !job || !r_shader_job_copy_source( job, source ) )
+	{
+		sys_mutex_unlock( &queue->mutex );
+		return 0;
+	}
+
+	job->tag        = tag;
+	job->state      = R_SHADER_JOB_QUEUED;
+	uint32_t handle = r_shader_job_handle( queue, slot );
+
+	if ( queue->workerCount == 0 )
+	{
+		// No workers to hand it to, compile right here.
+		job->state = R_SHADER_JOB_RUNNING;
+		sys_mutex_unlock( &queue->mutex );
+
+		void  *bytecode = NULL;
+		size_t size     = 0;
+		bool   ok       = queue->compile( queue->user, &job->source, &bytecode, &size );
+
+		sys_mutex_lock( &queue->mutex );
+		r_shader_job_finish( job, ok, bytecode, size );
+		sys_mutex_unlock( &queue->mutex );
+		return handle;
+	}
+
+	queue->pending[( queue->pendingHead + queue->pendingCount ) % R_SHADER_JOB_CAPACITY] = slot;
+	queue->pendingCount++;
+	sys_cond_signal( &queue->wake );
+	sys_mutex_unlock( &queue->mutex );
+	return handle;
+}
+
+R_ShaderJobState r_shader_jobs_state( R_ShaderJobQueue *queue, uint32_t handle )
+{
+	if ( !queue->compile )
+		return R_SHADER_JOB_FREE;
+
+	sys_mutex_lock( &queue->mutex );
+	uint32_t         slot  = r_shader_job_slot( queue, handle );
+	R_ShaderJobState state = R_SHADER_JOB_FREE;
+	if ( slot < R_SHADER_JOB_CAPACITY )
+		state = (R_ShaderJobState)queue->jobs[slot].state;
+	sys_mutex_unlock( &queue->mutex );
+	return state;
+}
+
+R_ShaderJobState
+r_shader_jobs_take( R_ShaderJobQueue *queue, uint32_t handle, void **outBytecode, size_t *outSize, uint64_t *outTag )
+{
+	*outBytecode = NULL;
+	*outSize     = 0;
+	if ( !queue->compile )
+		return R_SHADER_JOB_FREE;
+
+	sys_mutex_lock( &queue->mutex );
+
+	uint32_t slot = r_shader_job_slot( queue, handle );
+	if ( slot == R_SHADER_JOB_CAPACITY )
+	{
+		sys_mutex_unlock( &queue->mutex );
+		return R_SHADER_JOB_FREE;
+	}
+
+	R_ShaderJob     *job   = &queue->jobs[slot];
+	R_ShaderJobState state = (R_ShaderJobState)job->state;
+	if ( state == R_SHADER_JOB_DONE || state == R_SHADER_JOB_FAILED )
+	{
+		*outBytecode = job->bytecode;
+		*outSize     = job->bytecodeSize;
+		if ( outTag )
+			*outTag = job->tag;
+
+		job->bytecode = NULL;
+		r_shader_job_release( job );
+	}
+
+	sys_mutex_unlock( &queue->mutex );
+	return state;
+}
+
+void r_shader_jobs_discard( R_ShaderJobQueue *queue, uint32_t handle )
+{
+	if ( !queue->compile )
+		return;
+
+	sys_mutex_lock( &queue->mutex );
+
+	uint32_t slot = r_shader_job_slot( queue, handle );
+	if ( slot < R_SHADER_JOB_CAPACITY )
+	{
+		R_ShaderJob *job = &queue->jobs[slot];
+		if ( job->state == R_SHADER_JOB_DONE || job->state == R_SHADER_JOB_FAILED )
+			r_shader_job_release( job );
+		else
+			job->discarded = true;
+	}
+
+	sys_mutex_unlock( &queue->mutex );
+}
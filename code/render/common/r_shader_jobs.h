@@ -0,0 +1,75 @@
+#ifndef R_SHADER_JOBS_H
+#define R_SHADER_JOBS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../base/c_thread.h"
+#include "r_shader_cache.h"
+
+//
+// Background shader compilation. Sources are copied into a job slot and picked
+// up by a small worker pool; the owner polls the job through a generational
+// handle and takes the bytecode once it's done. The compiler itself is a
+// callback, so the queue has no idea which API (or stub) produces the bytecode.
+//
+
+#define R_SHADER_JOB_CAPACITY 256
+#define R_SHADER_MAX_WORKERS 4
+
+typedef enum
+{
+	R_SHADER_JOB_FREE = 0,
+	R_SHADER_JOB_QUEUED,
+	R_SHADER_JOB_RUNNING,
+	R_SHADER_JOB_DONE,
+	R_SHADER_JOB_FAILED,
+} R_ShaderJobState;
+
+// Runs on a worker thread. On success *outBytecode must come from malloc, ownership moves to the queue.
+typedef bool ( *R_ShaderCompileFn )( void *user, const R_ShaderSource *source, void **outBytecode, size_t *outSize );
+
+typedef struct R_ShaderJob
+{
+	R_ShaderSource source; // every string points into storage
+	void          *storage;
+	uint64_t       tag;
+	void          *bytecode;
+	size_t         bytecodeSize;
+	uint16_t       generation;
+	uint8_t        state;
+	bool           discarded; // dropped by the owner while queued or running
+} R_ShaderJob;
+
+typedef struct R_ShaderJobQueue
+{
+	SYS_Mutex         mutex;
+	SYS_Cond          wake;
+	SYS_Thread        workers[R_SHADER_MAX_WORKERS];
+	int               workerCount;
+	bool              shutdown;
+	R_ShaderCompileFn compile;
+	void             *user;
+
+	R_ShaderJob jobs[R_SHADER_JOB_CAPACITY];
+	uint32_t    pending[R_SHADER_JOB_CAPACITY]; // FIFO of slots waiting for a worker
+	uint32_t    pendingHead;
+	uint32_t    pendingCount;
+} R_ShaderJobQueue;
+
+// With zero workers every submit compiles inline on the calling thread.
+bool r_shader_jobs_init( R_ShaderJobQueue *queue, int workerCount, R_ShaderCompileFn compile, void *user );
+void r_shader_jobs_shutdown( R_ShaderJobQueue *queue );
+
+// Returns 0 when every slot is busy. The tag is handed back by r_shader_jobs_take.
+uint32_t         r_shader_jobs_submit( R_ShaderJobQueue *queue, const R_ShaderSource *source, uint64_t tag );
+R_ShaderJobState r_shader_jobs_state( R_ShaderJobQueue *queue, uint32_t handle );
+
+// Finished jobs (done or failed) give up their result and free the slot; anything else is left alone.
+// The caller owns *outBytecode afterwards and releases it with free().
+R_ShaderJobState
+r_shader_jobs_take( R_ShaderJobQueue *queue, uint32_t handle, void **outBytecode, size_t *outSize, uint64_t *outTag );
+void r_shader_jobs_discard( R_ShaderJobQueue *queue, uint32_t handle );
+
+#endif // R_SHADER_JOBS_H
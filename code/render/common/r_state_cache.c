@@ -0,0 +1,197 @@
+#include "r_state_cache.h"
+
+#include <string.h>
+
+static bool r_state_cache_count( R_StateCache *cache, R_StateCall call, bool issue )
+{
+	if ( issue )
+		cache->stats.issued[call]++;
+	else
+		cache->stats.filtered[call]++;
+	return issue;
+}
+
+void r_state_cache_init( R_StateCache *cache )
+{
+	memset( cache, 0, sizeof( *cache ) );
+}
+
+void r_state_cache_invalidate( R_StateCache *cache )
+{
+	R_StateStats stats = cache->stats;
+	memset( cache, 0, sizeof( *cache ) );
+	cache->stats = stats;
+}
+
+void r_state_cache_reset_stats( R_StateCache *cache )
+{
+	memset( &cache->stats, 0, sizeof( cache->stats ) );
+}
+
+bool r_state_cache_set_pipeline( R_StateCache *cache, const void *pipeline )
+{
+	bool issue = !cache->pipelineValid || cache->pipeline != pipeline;
+
+	cache->pipeline      = pipeline;
+	cache->pipelineValid = true;
+	return r_state_cache_count( cache, R_STATE_CALL_PIPELINE, issue );
+}
+
+bool r_state_cache_set_object( R_StateCache *cache, R_StateObject object, const void *value )
+{
+	static const R_StateCall calls[R_STATE_OBJECT_COUNT] = {
+	    R_STATE_CALL_INPUT_LAYOUT, R_STATE_CALL_SHADER, R_STATE_CALL_SHADER,
+	    R_STATE_CALL_RASTERIZER,   R_STATE_CALL_BLEND,  R_STATE_CALL_DEPTH_STENCIL,
+	};
+
+	uint32_t bit   = 1u << object;
+	bool     issue = !( cache->objectValid & bit ) || cache->objects[object] != value;
+
+	cache->objects[object] = value;
+	cache->objectValid |= bit;
+	return r_state_cache_count( cache, calls[object], issue );
+}
+
+bool r_state_cache_set_blend( R_StateCache *cache, const void *blend, const float factor[4], uint32_t sampleMask )
+{
+	uint32_t bit   = 1u << R_STATE_OBJECT_BLEND;
+	bool     issue = !( cache->objectValid & bit ) || cache->objects[R_STATE_OBJECT_BLEND] != blend ||
+	             memcmp( cache->blendFactor, factor, sizeof( cache->blendFactor ) ) != 0 ||
+	             cache->sampleMask != sampleMask;
+
+	cache->objects[R_STATE_OBJECT_BLEND] = blend;
+	memcpy( cache->blendFactor, factor, sizeof( cache->blendFactor ) );
+	cache->sampleMask = sampleMask;
+	cache->objectValid |= bit;
+	return r_state_cache_count( cache, R_STATE_CALL_BLEND, issue );
+}
+
+bool r_state_cache_set_depth_stencil( R_StateCache *cache, const void *depthStencil, uint32_t stencilRef )
+{
+	uint32_t bit   = 1u << R_STATE_OBJECT_DEPTH_STENCIL;
+	bool     issue = !( cache->objectValid & bit ) || cache->objects[R_STATE_OBJECT_DEPTH_STENCIL] != depthStencil ||
+	             cache->stencilRef != stencilRef;
+
+	cache->objects[R_STATE_OBJECT_DEPTH_STENCIL] = depthStencil;
+	cache->stencilRef                            = stencilRef;
+	cache->objectValid |= bit;
+	return r_state_cache_count( cache, R_STATE_CALL_DEPTH_STENCIL, issue );
+}
+
+bool r_state_cache_set_constant_buffer( R_StateCache *cache, R_ShaderStage stage, int slot, const void *buffer )
+{
+	return r_state_cache_set_constant_buffer_range( cache, stage, slot, buffer, 0, 0 );
+}
+
+bool r_state_cache_set_constant_buffer_range( R_StateCache *cache,
+                                              R_ShaderStage stage,
+                                              int           slot,
+                                              const void   *buffer,
+                                              uint32_t      firstConstant,
+                                              uint32_t      numConstants )
+{
+	// Out of range slots are never cached, let the driver deal with them.
+	if ( stage < 0 || stage >= R_STAGE_COUNT || slot < 0 || slot >= R_MAX_CONSTANT_BUFFER_SLOTS )
+		return r_state_cache_count( cache, R_STATE_CALL_CONSTANT_BUFFER, true );
+
+	uint32_t bit   = 1u << slot;
+	bool     issue = !( cache->constantBufferValid[stage] & bit ) || cache->constantBuffers[stage][slot] != buffer ||
+	             cache->constantOffsets[stage][slot] != firstConstant ||
+	             cache->constantSizes[stage][slot] != numConstants;
+
+	cache->constantBuffers[stage][slot] = buffer;
+	cache->constantOffsets[stage][slot] = firstConstant;
+	cache->constantSizes[stage][slot]   = numConstants;
+	cache->constantBufferValid[stage] |= bit;
+	return r_state_cache_count( cache, R_STATE_CALL_CONSTANT_BUFFER, issue );
+}
+
+void r_state_cache_forget_constant_buffers( R_StateCache *cache, R_ShaderStage stage, uint32_t slotMask )
+{
+	if ( stage >= 0 && stage < R_STAGE_COUNT )
+		cache->constantBufferValid[stage] &= ~slotMask;
+}
+
+bool r_state_cache_set_texture( R_StateCache *cache, R_ShaderStage stage, int slot, const void *view )
+{
+	if ( stage < 0 || stage >= R_STAGE_COUNT || slot < 0 || slot >= R_MAX_TEXTURE_SLOTS )
+		return r_state_cache_count( cache, R_STATE_CALL_TEXTURE, true );
+
+	uint32_t bit   = 1u << slot;
+	bool     issue = !( cache->textureValid[stage] & bit ) || cache->textures[stage][slot] != view;
+
+	cache->textures[stage][slot] = view;
+	cache->textureValid[stage] |= bit;
+	return r_state_cache_count( cache, R_STATE_CALL_TEXTURE, issue );
+}
+
+bool r_state_cache_set_sampler( R_StateCache *cache, R_ShaderStage stage, int slot, const void *sampler )
+{
+	if ( stage < 0 || stage >= R_STAGE_COUNT || slot < 0 || slot >= R_MAX_SAMPLER_SLOTS )
+		return r_state_cache_count( cache, R_STATE_CALL_SAMPLER, true );
+
+	uint32_t bit   = 1u << slot;
+	bool     issue = !( cache->samplerValid[stage] & bit ) || cache->samplers[stage][slot] != sampler;
+
+	cache->samplers[stage][slot] = sampler;
+	cache->samplerValid[stage] |= bit;
+	return r_state_cache_count( cache, R_STATE_CALL_SAMPLER, issue );
+}
+
+void r_state_cache_forget_textures( R_StateCache *cache, R_ShaderStage stage, uint32_t slotMask )
+{
+	if ( stage >= 0 && stage < R_STAGE_COUNT )
+		cache->textureValid[stage] &= ~slotMask;
+}
+
+void r_state_cache_forget_samplers( R_StateCache *cache, R_ShaderStage stage, uint32_t slotMask )
+{
+	if ( stage >= 0 && stage < R_STAGE_COUNT )
+		cache->samplerValid[stage] &= ~slotMask;
+}
+
+bool r_state_cache_set_vertex_buffer( R_StateCache *cache, int slot, const void *buffer, uint32_t stride, uint32_t offset )
+{
+	if ( slot < 0 || slot >= R_MAX_VERTEX_BUFFER_SLOTS )
+		return r_state_cache_count( cache, R_STATE_CALL_VERTEX_BUFFER, true );
+
+	uint32_t bit   = 1u << slot;
+	bool     issue = !( cache->vertexBufferValid & bit ) || cache->vertexBuffers[slot] != buffer ||
+	             cache->vertexStrides[slot] != stride || cache->vertexOffsets[slot] != offset;
+
+	cache->vertexBuffers[slot] = buffer;
+	cache->vertexStrides[slot] = stride;
+	cache->vertexOffsets[slot] = offset;
+	cache->vertexBufferValid |= bit;
+	return r_state_cache_count( cache, R_STATE_CALL_VERTEX_BUFFER, issue );
+}
+
+bool r_state_cache_set_index_buffer( R_StateCache *cache, const void *buffer, uint32_t format, uint32_t offset )
+{
+	bool issue = !cache->indexBufferValid || cache->indexBuffer != buffer || cache->indexFormat != format ||
+	             cache->indexOffset != offset;
+
+	cache->indexBuffer      = buffer;
+	cache->indexFormat      = format;
+	cache->indexOffset      = offset;
+	cache->indexBufferValid = true;
+	return r_state_cache_count( cache, R_STATE_CALL_INDEX_BUFFER, issue );
+}
+
+bool r_state_cache_set_topology( R_StateCache *cache, uint32_t topology )
+{
+	bool issue = !cache->topologyValid || cache->topology != topology;
+
+	cache->topology      = topology;
+	cache->topologyValid = true;
+	return r_state_cache_count( cache, R_STATE_CALL_TOPOLOGY, issue );
+}
+
+bool r_state_cache_set_viewport( R_StateCache *cache, const R_Viewport *viewport )
+{
+	bool issue = !cache->viewportValid || memcmp( &cache->viewport, viewport, sizeof( R_Viewport ) ) != 0;
+
+	cache->viewport      = *viewport;
+	cache->viewportValid = true;
+	return r_state_cache_count( cache, R_STATE_CALL_VIEWPORT, issue );
+}
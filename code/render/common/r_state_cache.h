@@ -0,0 +1,131 @@
+#ifndef R_STATE_CACHE_H
+#define R_STATE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Shadow copy of the pipeline state last handed to the driver.
+// Every r_state_cache_set_* returns true when the call has to be issued and
+// false when it would be redundant. Objects are compared by identity only, so
+// the cache does not know (or care) which backend the pointers belong to.
+//
+
+#define R_MAX_VERTEX_BUFFER_SLOTS 16
+#define R_MAX_CONSTANT_BUFFER_SLOTS 14
+#define R_MAX_TEXTURE_SLOTS 16
+#define R_MAX_SAMPLER_SLOTS 16
+
+typedef enum
+{
+	R_STAGE_VERTEX = 0,
+	R_STAGE_PIXEL,
+	R_STAGE_COUNT,
+} R_ShaderStage;
+
+typedef enum
+{
+	R_STATE_CALL_PIPELINE = 0,
+	R_STATE_CALL_CONSTANT_BUFFER,
+	R_STATE_CALL_VERTEX_BUFFER,
+	R_STATE_CALL_INDEX_BUFFER,
+	R_STATE_CALL_TOPOLOGY,
+	R_STATE_CALL_VIEWPORT,
+	R_STATE_CALL_INPUT_LAYOUT,
+	R_STATE_CALL_SHADER,
+	R_STATE_CALL_RASTERIZER,
+	R_STATE_CALL_BLEND,
+	R_STATE_CALL_DEPTH_STENCIL,
+	R_STATE_CALL_TEXTURE,
+	R_STATE_CALL_SAMPLER,
+	R_STATE_CALL_COUNT,
+} R_StateCall;
+
+// Pipeline components, diffed one by one when the bound pipeline changes.
+typedef enum
+{
+	R_STATE_OBJECT_INPUT_LAYOUT = 0,
+	R_STATE_OBJECT_VERTEX_SHADER,
+	R_STATE_OBJECT_PIXEL_SHADER,
+	R_STATE_OBJECT_RASTERIZER,
+	R_STATE_OBJECT_BLEND,
+	R_STATE_OBJECT_DEPTH_STENCIL,
+	R_STATE_OBJECT_COUNT,
+} R_StateObject;
+
+typedef struct R_StateStats
+{
+	uint64_t issued[R_STATE_CALL_COUNT];
+	uint64_t filtered[R_STATE_CALL_COUNT];
+} R_StateStats;
+
+typedef struct R_Viewport
+{
+	float x, y, w, h;
+	float minDepth, maxDepth;
+} R_Viewport;
+
+typedef struct R_StateCache
+{
+	const void *pipeline;
+	const void *objects[R_STATE_OBJECT_COUNT];
+	float       blendFactor[4];
+	uint32_t    sampleMask;
+	uint32_t    stencilRef;
+	const void *constantBuffers[R_STAGE_COUNT][R_MAX_CONSTANT_BUFFER_SLOTS];
+	uint32_t    constantOffsets[R_STAGE_COUNT][R_MAX_CONSTANT_BUFFER_SLOTS];
+	uint32_t    constantSizes[R_STAGE_COUNT][R_MAX_CONSTANT_BUFFER_SLOTS];
+	const void *vertexBuffers[R_MAX_VERTEX_BUFFER_SLOTS];
+	uint32_t    vertexStrides[R_MAX_VERTEX_BUFFER_SLOTS];
+	uint32_t    vertexOffsets[R_MAX_VERTEX_BUFFER_SLOTS];
+	const void *textures[R_STAGE_COUNT][R_MAX_TEXTURE_SLOTS];
+	const void *samplers[R_STAGE_COUNT][R_MAX_SAMPLER_SLOTS];
+	const void *indexBuffer;
+	uint32_t    indexFormat;
+	uint32_t    indexOffset;
+	uint32_t    topology;
+	R_Viewport  viewport;
+
+	// A cleared bit means "unknown", the next set always goes through.
+	uint32_t objectValid;
+	uint32_t constantBufferValid[R_STAGE_COUNT];
+	uint32_t textureValid[R_STAGE_COUNT];
+	uint32_t samplerValid[R_STAGE_COUNT];
+	uint32_t vertexBufferValid;
+	bool     pipelineValid;
+	bool     indexBufferValid;
+	bool     topologyValid;
+	bool     viewportValid;
+
+	R_StateStats stats;
+} R_StateCache;
+
+void r_state_cache_init( R_StateCache *cache );
+void r_state_cache_invalidate( R_StateCache *cache );
+void r_state_cache_reset_stats( R_StateCache *cache );
+
+bool r_state_cache_set_pipeline( R_StateCache *cache, const void *pipeline );
+bool r_state_cache_set_object( R_StateCache *cache, R_StateObject object, const void *value );
+bool r_state_cache_set_blend( R_StateCache *cache, const void *blend, const float factor[4], uint32_t sampleMask );
+bool r_state_cache_set_depth_stencil( R_StateCache *cache, const void *depthStencil, uint32_t stencilRef );
+bool r_state_cache_set_constant_buffer( R_StateCache *cache, R_ShaderStage stage, int slot, const void *buffer );
+// Sub-range binds (offset and size in 16-byte constants), a whole-buffer bind is offset 0, size 0.
+bool r_state_cache_set_constant_buffer_range( R_StateCache *cache,
+                                              R_ShaderStage stage,
+                                              int           slot,
+                                              const void   *buffer,
+                                              uint32_t      firstConstant,
+                                              uint32_t      numConstants );
+// Marks the slots unknown after something bound them behind the cache's back.
+void r_state_cache_forget_constant_buffers( R_StateCache *cache, R_ShaderStage stage, uint32_t slotMask );
+// Shader resource views and sampler states, by stage and slot.
+bool r_state_cache_set_texture( R_StateCache *cache, R_ShaderStage stage, int slot, const void *view );
+bool r_state_cache_set_sampler( R_StateCache *cache, R_ShaderStage stage, int slot, const void *sampler );
+void r_state_cache_forget_textures( R_StateCache *cache, R_ShaderStage stage, uint32_t slotMask );
+void r_state_cache_forget_samplers( R_StateCache *cache, R_ShaderStage stage, uint32_t slotMask );
+bool r_state_cache_set_vertex_buffer( R_StateCache *cache, int slot, const void *buffer, uint32_t stride, uint32_t offset );
+bool r_state_cache_set_index_buffer( R_StateCache *cache, const void *buffer, uint32_t format, uint32_t offset );
+bool r_state_cache_set_topology( R_StateCache *cache, uint32_t topology );
+bool r_state_cache_set_viewport( R_StateCache *cache, const R_Viewport *viewport );
+
+#endif // R_STATE_CACHE_H
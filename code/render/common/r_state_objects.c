@@ -0,0 +1,61 @@
+#include "r_state_objects.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool r_state_object_cache_init( R_StateObjectCache *cache, uint32_t capacity, size_t descSize )
+{
+	memset( cache, 0, sizeof( *cache ) );
+	cache->objects  = (void **)calloc( capacity, sizeof( void * ) );
+	cache->descs    = (uint8_t *)calloc( capacity, descSize );
+	cache->descSize = descSize;
+	cache->capacity = capacity;
+	return r_hash_map_init( &cache->lookup, 64 ) && cache->objects && cache->descs;
+}
+
+void r_state_object_cache_free( R_StateObjectCache *cache )
+{
+	free( cache->objects );
+	free( cache->descs );
+	r_hash_map_free( &cache->lookup );
+	memset( cache, 0, sizeof( *cache ) );
+}
+
+uint32_t r_state_object_find_id( const R_StateObjectCache *cache, const void *desc, uint64_t hash )
+{
+	uint32_t i;
+	if ( !r_hash_map_get( &cache->lookup, hash, &i ) ||
+	     memcmp( cache->descs + i * cache->descSize, desc, cache->descSize ) != 0 )
+		return 0;
+	return i + 1;
+}
+
+void *r_state_object_find( const R_StateObjectCache *cache, const void *desc, uint64_t hash )
+{
+	return r_state_object_get( cache, r_state_object_find_id( cache, desc, hash ) );
+}
+
+uint32_t r_state_object_insert( R_StateObjectCache *cache, const void *desc, uint64_t hash, void *object )
+{
+	if ( cache->count == cache->capacity )
+		return 0;
+
+	uint32_t i = cache->count++;
+	memcpy( cache->descs + i * cache->descSize, desc, cache->descSize );
+	cache->objects[i] = object;
+
+	// On a hash collision the first descriptor keeps the slot, the newcomer is simply never found again.
+	if ( !r_hash_map_get( &cache->lookup, hash, NULL ) )
+		r_hash_map_put( &cache->lookup, hash, i );
+	return i + 1;
+}
+
+void *r_state_object_get( const R_StateObjectCache *cache, uint32_t id )
+{
+	return id && id <= cache->count ? cache->objects[id - 1] : NULL;
+}
+
+const void *r_state_object_desc( const R_StateObjectCache *cache, uint32_t id )
+{
+	return id && id <= cache->count ? cache->descs + ( id - 1 ) * cache->descSize : NULL;
+}
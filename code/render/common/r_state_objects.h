@@ -0,0 +1,45 @@
+#ifndef R_STATE_OBJECTS_H
+#define R_STATE_OBJECTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "r_hash.h"
+
+//
+// Fixed-function state objects (rasterizer, blend, depth-stencil, samplers),
+// deduplicated by descriptor. Descs are found by hash and compared byte for
+// byte, so a collision makes a second object rather than handing out the wrong
+// one. They are tiny and capped by the runtime anyway, so once inserted they
+// live as long as the cache: an object's id, its index plus one, never changes.
+//
+// The cache doesn't own the objects, the backend releases them before
+// r_state_object_cache_free.
+//
+
+typedef struct R_StateObjectCache
+{
+	R_HashMap lookup; // descriptor hash -> index
+	void    **objects;
+	uint8_t  *descs;
+	size_t    descSize;
+	uint32_t  count;
+	uint32_t  capacity;
+} R_StateObjectCache;
+
+bool r_state_object_cache_init( R_StateObjectCache *cache, uint32_t capacity, size_t descSize );
+void r_state_object_cache_free( R_StateObjectCache *cache );
+
+// The id of the object made from the same desc, 0 when there is none.
+uint32_t r_state_object_find_id( const R_StateObjectCache *cache, const void *desc, uint64_t hash );
+// The object made from the same desc, NULL when there is none.
+void *r_state_object_find( const R_StateObjectCache *cache, const void *desc, uint64_t hash );
+// Adds an object the caller checked isn't there yet. Its id, 0 when the cache is full.
+uint32_t r_state_object_insert( R_StateObjectCache *cache, const void *desc, uint64_t hash, void *object );
+
+// The object behind an id, NULL for 0 or an id the cache never handed out.
+void *r_state_object_get( const R_StateObjectCache *cache, uint32_t id );
+const void *r_state_object_desc( const R_StateObjectCache *cache, uint32_t id );
+
+#endif // R_STATE_OBJECTS_H
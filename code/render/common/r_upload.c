@@ -0,0 +1,147 @@
+#include "r_upload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool r_upload_queue_init( R_UploadQueue *queue, size_t ringCapacity )
+{
+	memset( queue, 0, sizeof( *queue ) );
+	queue->ring = (uint8_t *)malloc( ringCapacity );
+	if ( !queue->ring )
+		return false;
+
+	queue->capacity = ringCapacity;
+	return true;
+}
+
+void r_upload_queue_free( R_UploadQueue *queue )
+{
+	free( queue->ring );
+	memset( queue, 0, sizeof( *queue ) );
+}
+
+static R_UploadRequest *r_upload_request_at( R_UploadQueue *queue, uint32_t i )
+{
+	return &queue->requests[( queue->first + i ) % R_UPLOAD_MAX_REQUESTS];
+}
+
+bool r_upload_queue_push( R_UploadQueue   *queue,
+                          uint32_t         target,
+                          uint32_t         dstOffset,
+                          const void      *data,
+                          size_t           size,
+                          R_UploadCallback callback,
+                          void            *user )
+{
+	if ( !queue->ring || !data || size == 0 || size > queue->capacity || size > UINT32_MAX ||
+	     queue->count == R_UPLOAD_MAX_REQUESTS )
+	{
+		queue->stats.rejected++;
+		return false;
+	}
+
+	// Every request is contiguous, one that would straddle the end starts over at the beginning.
+	uint64_t start    = queue->head;
+	size_t   physical = (size_t)( start % queue->capacity );
+	if ( physical + size > queue->capacity )
+		start += queue->capacity - physical;
+
+	if ( start + size - queue->tail > queue->capacity )
+	{
+		queue->stats.rejected++;
+		return false;
+	}
+
+	memcpy( queue->ring + start % queue->capacity, data, size );
+	queue->head = start + size;
+
+	R_UploadRequest *request = r_upload_request_at( queue, queue->count++ );
+	request->ringOffset      = start;
+	request->size            = (uint32_t)size;
+	request->sent            = 0;
+	request->target          = target;
+	request->dstOffset       = dstOffset;
+	request->callback        = callback;
+	request->user            = user;
+
+	queue->pushed++;
+	queue->stats.requests++;
+	queue->stats.bytesQueued += size;
+	return true;
+}
+
+uint32_t r_upload_queue_gather( R_UploadQueue *queue, size_t budget, R_UploadPiece *outPieces, uint32_t maxPieces )
+{
+	uint32_t pieces = 0;
+	for ( uint32_t i = 0; i < queue->count && pieces < maxPieces && budget > 0; ++i )
+	{
+		R_UploadRequest *request   = r_upload_request_at( queue, i );
+		uint32_t         remaining = request->size - request->sent;
+		if ( remaining == 0 )
+			continue;
+
+		uint32_t size = remaining < budget ? remaining : (uint32_t)budget;
+
+		R_UploadPiece *piece = &outPieces[pieces++];
+		piece->target        = request->target;
+		piece->dstOffset     = request->dstOffset + request->sent;
+		piece->data          = queue->ring + ( request->ringOffset + request->sent ) % queue->capacity;
+		piece->size          = size;
+
+		request->sent += size;
+		budget -= size;
+		queue->stats.bytesCopied += size;
+	}
+
+	if ( pieces )
+		queue->stats.flushes++;
+	queue->stats.pieces += pieces;
+	return pieces;
+}
+
+void r_upload_queue_complete( R_UploadQueue *queue )
+{
+	// Requests finish in order, a split one holds back everything behind it until its last piece went out.
+	while ( queue->count > 0 )
+	{
+		R_UploadRequest *request = r_upload_request_at( queue, 0 );
+		if ( request->sent != request->size )
+			break;
+
+		queue->tail  = request->ringOffset + request->size;
+		queue->first = ( queue->first + 1 ) % R_UPLOAD_MAX_REQUESTS;
+		queue->count--;
+		queue->retired++;
+
+		// Cancelled requests keep their ring space until here, but have no target left to report.
+		if ( request->target )
+		{
+			queue->stats.completions++;
+			if ( request->callback )
+				request->callback( request->user, request->target );
+		}
+	}
+
+	// Nothing in flight, so the next request can start at the front without wasting the tail.
+	if ( queue->count == 0 )
+		queue->head = queue->tail = 0;
+}
+
+void r_upload_queue_cancel( R_UploadQueue *queue, uint32_t target )
+{
+	for ( uint32_t i = 0; i < queue->count; ++i )
+	{
+		R_UploadRequest *request = r_upload_request_at( queue, i );
+		if ( request->target != target )
+			continue;
+
+		request->target   = 0;
+		request->callback = NULL;
+		request->sent     = request->size;
+	}
+}
+
+size_t r_upload_queue_pending_bytes( const R_UploadQueue *queue )
+{
+	return (size_t)( queue->head - queue->tail );
+}
@@ -0,0 +1,92 @@
+#ifndef R_UPLOAD_H
+#define R_UPLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Upload scheduling. Queued data is copied into a CPU staging ring right away,
+// so callers can free their memory, and handed out in submission order as
+// pieces under a per-flush byte budget. A request bigger than what's left of
+// the budget is split, the rest goes out with the next flush. The backend
+// copies the pieces to the GPU and then calls r_upload_queue_complete, which
+// frees the ring space and fires the callbacks of every finished request.
+//
+// Targets are opaque ids (resource handles) the queue never looks at.
+//
+
+#define R_UPLOAD_MAX_REQUESTS 4096
+
+typedef void ( *R_UploadCallback )( void *user, uint32_t target );
+
+typedef struct R_UploadRequest
+{
+	uint64_t         ringOffset; // position of the data in ring bytes ever written, wraps with the ring
+	uint32_t         size;
+	uint32_t         sent; // bytes already handed out
+	uint32_t         target;
+	uint32_t         dstOffset;
+	R_UploadCallback callback;
+	void            *user;
+} R_UploadRequest;
+
+// One contiguous copy: size bytes at data go to target at dstOffset.
+typedef struct R_UploadPiece
+{
+	uint32_t    target;
+	uint32_t    dstOffset;
+	const void *data;
+	uint32_t    size;
+} R_UploadPiece;
+
+typedef struct R_UploadStats
+{
+	uint64_t requests;    // accepted by r_upload_queue_push
+	uint64_t rejected;    // didn't fit into the ring or the request table
+	uint64_t bytesQueued;
+	uint64_t bytesCopied;
+	uint64_t pieces;      // copy commands handed out
+	uint64_t flushes;     // r_upload_queue_gather calls that had work
+	uint64_t completions; // callbacks fired (or requests finished without one)
+} R_UploadStats;
+
+typedef struct R_UploadQueue
+{
+	uint8_t        *ring;
+	size_t          capacity;
+	uint64_t        head; // next write position
+	uint64_t        tail; // oldest byte still owned by a request
+	R_UploadRequest requests[R_UPLOAD_MAX_REQUESTS];
+	uint32_t        first;
+	uint32_t        count;
+	uint64_t        pushed;  // requests ever accepted
+	uint64_t        retired; // requests ever finished, cancelled ones included; never passes pushed
+	R_UploadStats   stats;
+} R_UploadQueue;
+
+bool r_upload_queue_init( R_UploadQueue *queue, size_t ringCapacity );
+void r_upload_queue_free( R_UploadQueue *queue );
+
+// Copies the data into the ring. False when it doesn't fit right now, the caller uploads it directly instead.
+bool r_upload_queue_push( R_UploadQueue   *queue,
+                          uint32_t         target,
+                          uint32_t         dstOffset,
+                          const void      *data,
+                          size_t           size,
+                          R_UploadCallback callback,
+                          void            *user );
+
+// Everything queued up to here has gone out once retired reaches the pushed count read now.
+
+// Hands out up to budget bytes (and at most maxPieces pieces). The data stays valid until
+// r_upload_queue_complete, which must be called before the next gather.
+uint32_t r_upload_queue_gather( R_UploadQueue *queue, size_t budget, R_UploadPiece *outPieces, uint32_t maxPieces );
+void     r_upload_queue_complete( R_UploadQueue *queue );
+
+// Drops every queued byte for target, without calling back. For targets destroyed before their upload.
+void r_upload_queue_cancel( R_UploadQueue *queue, uint32_t target );
+
+size_t r_upload_queue_pending_bytes( const R_UploadQueue *queue );
+
+#endif // R_UPLOAD_H
@@ -0,0 +1,32 @@
+/**
+ * @file
+ * @brief Auto-generated file from code\render\vtx\ui_batch_pass.vtx.
+ * Do not edit manually.
+ */
+
+#ifndef UI_BATCH_PASS_VTX_H_
+#define UI_BATCH_PASS_VTX_H_
+
+#include <stdint.h>
+#include <d3d11.h>
+#include <stddef.h>
+
+typedef struct UiBatch_Vertex {
+    float pos[2];
+    float uv[2];
+    uint8_t col[4];
+} UiBatch_Vertex;
+
+static const D3D11_INPUT_ELEMENT_DESC UiBatch_Vertex_desc[] = {
+    { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(UiBatch_Vertex, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(UiBatch_Vertex, uv), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(UiBatch_Vertex, col), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+static const unsigned int UiBatch_Vertex_desc_count = sizeof(UiBatch_Vertex_desc) / sizeof(UiBatch_Vertex_desc[0]);
+
+typedef struct UiBatch_Transform {
+    float invViewport[2];
+    float padding[2];
+} UiBatch_Transform;
+
+#endif // UI_BATCH_PASS_VTX_H_
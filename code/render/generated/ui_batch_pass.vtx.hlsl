@@ -0,0 +1,25 @@
+/**
+ * @file
+ * @brief Auto-generated file from code\render\vtx\ui_batch_pass.vtx.
+ * Do not edit manually.
+ */
+
+struct VS_INPUT {
+    float2 pos : POSITION;
+    float2 uv : TEXCOORD;
+    float4 col : COLOR;
+};
+
+struct PS_INPUT {
+    float4 pos : SV_POSITION;
+    float2 uv : TEXCOORD;
+    float4 col : COLOR;
+};
+
+cbuffer UiBatch_Transform : register(b0) {
+    float2 invViewport;
+    float2 padding;
+};
+
+Texture2D uiTexture : register(t0);
+SamplerState uiSampler : register(s0);
@@ -0,0 +1,284 @@
+//
+// replay: re-issues a frame capture (r_capture_frame) and reports where its CPU
+// time goes. Replays against the headless backend by default, which builds and
+// runs anywhere; Windows builds can replay against D3D11 with --d3d11.
+//
+// With --precache the file is a pipeline manifest (r_precache.h) instead, built
+// on a background thread the way r_load_pipeline_manifest does at startup.
+//
+//   replay <capture> [--repeat N] [--top N] [--d3d11] [--precache]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include "../render/backend/3d311/r_d3d11.c"
+#include "../render/backend/3d311/r_d3d11_replay.c"
+#include "../platform/window.c"
+
+#pragma comment( lib, "user32.lib" )
+#else
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_capture.c"
+#include "../render/common/r_precache.c"
+#include "../base/c_file.c"
+#include "../base/c_thread.c"
+#endif
+
+#include "../render/common/r_replay.c"
+#include "../render/backend/headless/r_headless.c"
+
+typedef struct SlowCall
+{
+	uint32_t index;
+	uint64_t nanoseconds;
+} SlowCall;
+
+static double to_us( uint64_t nanoseconds )
+{
+	return (double)nanoseconds / 1000.0;
+}
+
+static int compare_slow_calls( const void *a, const void *b )
+{
+	uint64_t x = ( (const SlowCall *)a )->nanoseconds;
+	uint64_t y = ( (const SlowCall *)b )->nanoseconds;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void print_report( const R_Replay *replay, uint32_t top )
+{
+	const R_ReplayStats *stats  = &replay->stats;
+	uint32_t             frames = stats->frames ? stats->frames : 1;
+
+	printf( "target %s: %u setup calls, %u calls per frame\n",
+	        replay->target.name,
+	        stats->setupCalls,
+	        stats->frameCalls );
+	printf( "setup  %10.1f us\n", to_us( stats->setupNanoseconds ) );
+	printf( "frame  %10.1f us avg, %.1f min, %.1f max over %u frames\n",
+	        to_us( stats->frameNanoseconds / frames ),
+	        to_us( stats->fastestFrame ),
+	        to_us( stats->slowestFrame ),
+	        stats->frames );
+	if ( stats->failedCreates || stats->missingObjects )
+		printf( "warning: %u creates failed, %u calls named missing objects\n",
+		        stats->failedCreates,
+		        stats->missingObjects );
+
+	printf( "\n%-24s %8s %12s %10s %10s\n", "op", "calls", "total us", "avg ns", "max ns" );
+	for ( int op = 0; op < R_CAPTURE_OP_COUNT; ++op )
+	{
+		const R_ReplayOpStats *s = &stats->ops[op];
+		if ( !s->calls )
+			continue;
+		printf( "%-24s %8llu %12.1f %10llu %10llu\n",
+		        r_capture_op_name( (R_CaptureOp)op ),
+		        (unsigned long long)( s->calls / frames ),
+		        to_us( s->nanoseconds / frames ),
+		        (unsigned long long)( s->nanoseconds / s->calls ),
+		        (unsigned long long)s->maxNanoseconds );
+	}
+
+	if ( top == 0 )
+		return;
+
+	SlowCall *calls = (SlowCall *)malloc( stats->frameCalls * sizeof( SlowCall ) );
+	if ( !calls )
+		return;
+	for ( uint32_t i = 0; i < stats->frameCalls; ++i )
+		calls[i] = ( SlowCall ){ i, replay->callNanoseconds[i] / frames };
+	qsort( calls, stats->frameCalls, sizeof( SlowCall ), compare_slow_calls );
+
+	printf( "\nslowest calls (index in frame, avg ns)\n" );
+	for ( uint32_t i = 0; i < top && i < stats->frameCalls; ++i )
+		printf( "%8u %-24s %10llu\n",
+		        calls[i].index,
+		        r_capture_op_name( (R_CaptureOp)replay->callOps[calls[i].index] ),
+		        (unsigned long long)calls[i].nanoseconds );
+	free( calls );
+}
+
+static void print_headless_stats( const R_Headless *dev, uint32_t frames )
+{
+	R_HeadlessStats stats;
+	r_headless_get_stats( dev, &stats );
+	frames = frames ? frames : 1;
+
+	uint64_t issued = 0, filtered = 0;
+	for ( int i = 0; i < R_STATE_CALL_COUNT; ++i )
+	{
+		issued += stats.state.issued[i];
+		filtered += stats.state.filtered[i];
+	}
+
+	printf( "\nper frame: %llu draws (%llu invalid), %llu vertices, %llu indices, %llu instances\n",
+	        (unsigned long long)( stats.draws / frames ),
+	        (unsigned long long)( stats.invalidDraws / frames ),
+	        (unsigned long long)( stats.vertices / frames ),
+	        (unsigned long long)( stats.indices / frames ),
+	        (unsigned long long)( stats.instances / frames ) );
+	printf( "           %llu bytes uploaded, %llu streamed, %llu state calls issued, %llu filtered\n",
+	        (unsigned long long)( stats.bytesUploaded / frames ),
+	        (unsigned long long)( stats.bytesStreamed / frames ),
+	        (unsigned long long)( issued / frames ),
+	        (unsigned long long)( filtered / frames ) );
+	printf( "live: %u buffers, %u vertex shaders, %u pixel shaders, %u input layouts, %u pipelines, %u samplers\n",
+	        stats.buffers,
+	        stats.vertexShaders,
+	        stats.pixelShaders,
+	        stats.inputLayouts,
+	        stats.pipelines,
+	        stats.samplers );
+}
+
+static int run_precache( const char *path, const IO_Mapping *mapping, const R_ReplayTarget *target, R_Headless *dev )
+{
+	R_Precache precache;
+	uint64_t   start = r_replay_now();
+	if ( !r_precache_start( &precache, mapping->data, mapping->size, target ) )
+	{
+		fprintf( stderr, "%s is not a pipeline manifest\n", path );
+		return 1;
+	}
+	r_precache_wait( &precache );
+	uint64_t elapsed = r_replay_now() - start;
+
+	printf( "target %s: %u entries, %u created, %u failed in %.1f us\n",
+	        target->name,
+	        precache.stats.entries,
+	        precache.stats.created,
+	        precache.stats.failed,
+	        to_us( elapsed ) );
+	if ( dev )
+		print_headless_stats( dev, 1 );
+	int status = precache.stats.failed ? 1 : 0;
+	r_precache_free( &precache );
+	return status;
+}
+
+#ifdef _WIN32
+static R_Context *create_d3d11_context( void )
+{
+	PWindowDescriptor wndDesc = {
+	    .hInst         = GetModuleHandle( NULL ),
+	    .lpfnWndProc   = DefWindowProc,
+	    .lpszClassName = "SKSTR_GAMES_D3D11REPLAY",
+	    .Title         = "Replay",
+	    .Width         = 800,
+	    .Height        = 600,
+	};
+
+	PlatformResult pRes = P_CreateWindow( &wndDesc );
+	if ( !PlatformResult_Is_Ok( &pRes ) )
+	{
+		fprintf( stderr, "Window creation failed: %s\n", pRes.err.message );
+		return NULL;
+	}
+
+	R_Result   result;
+	R_Context *ctx = r_create_context( pRes.ok.value, wndDesc.Width, wndDesc.Height, false, &result );
+	if ( !ctx )
+		fprintf( stderr, "Context creation failed: %s\n", r_result_to_string( result ) );
+	return ctx;
+}
+#endif
+
+int main( int argc, char **argv )
+{
+	const char *path     = NULL;
+	uint32_t    repeat   = 100;
+	uint32_t    top      = 10;
+	bool        d3d11    = false;
+	bool        manifest = false;
+	bool        usage    = argc < 2;
+
+	for ( int i = 1; i < argc && !usage; ++i )
+	{
+		if ( strcmp( argv[i], "--repeat" ) == 0 && i + 1 < argc )
+			repeat = (uint32_t)strtoul( argv[++i], NULL, 10 );
+		else if ( strcmp( argv[i], "--top" ) == 0 && i + 1 < argc )
+			top = (uint32_t)strtoul( argv[++i], NULL, 10 );
+		else if ( strcmp( argv[i], "--d3d11" ) == 0 )
+			d3d11 = true;
+		else if ( strcmp( argv[i], "--precache" ) == 0 )
+			manifest = true;
+		else if ( !path && argv[i][0] != '-' )
+			path = argv[i];
+		else
+			usage = true;
+	}
+	if ( usage || !path || repeat == 0 )
+	{
+		fprintf( stderr, "usage: replay <capture> [--repeat N] [--top N] [--d3d11] [--precache]\n" );
+		return 1;
+	}
+
+	IO_File    file;
+	IO_Mapping mapping = { 0 };
+	if ( !io_file_open( &file, path, false ) || !io_file_map( &file, (size_t)io_file_size( &file ), &mapping ) )
+	{
+		fprintf( stderr, "Can't read %s\n", path );
+		return 1;
+	}
+
+	R_Headless    *dev    = NULL;
+	R_ReplayTarget target = { 0 };
+#ifdef _WIN32
+	R_Context *ctx = NULL;
+	if ( d3d11 )
+	{
+		ctx = create_d3d11_context();
+		if ( ctx )
+			target = r_d3d11_replay_target( ctx );
+	}
+#else
+	if ( d3d11 )
+		fprintf( stderr, "D3D11 replays need a Windows build, using the headless backend\n" );
+	d3d11 = false;
+#endif
+	if ( !d3d11 )
+	{
+		dev = r_headless_create();
+		if ( dev )
+			target = r_headless_replay_target( dev );
+	}
+
+	int      status = 1;
+	R_Replay replay = { 0 };
+	if ( !target.execute )
+		fprintf( stderr, "No replay target\n" );
+	else if ( manifest )
+		status = run_precache( path, &mapping, &target, dev );
+	else if ( !r_replay_init( &replay, mapping.data, mapping.size, &target ) )
+		fprintf( stderr, "%s is not a capture, or has no complete frame\n", path );
+	else
+	{
+		// Per-frame numbers shouldn't include the objects the setup created.
+		status = r_replay_setup( &replay ) ? 0 : 1;
+		if ( dev )
+			r_headless_reset_stats( dev );
+		for ( uint32_t i = 0; i < repeat && status == 0; ++i )
+			status = r_replay_frame( &replay ) ? 0 : 1;
+		if ( status )
+			fprintf( stderr, "Capture is corrupt after %u calls\n", replay.reader.callsRead );
+
+		print_report( &replay, top );
+		if ( dev )
+			print_headless_stats( dev, replay.stats.frames );
+	}
+
+	r_replay_free( &replay );
+	r_headless_destroy( dev );
+#ifdef _WIN32
+	r_destroy_context( ctx );
+#endif
+	io_file_unmap( &mapping );
+	io_file_close( &file );
+	return status;
+}
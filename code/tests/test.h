@@ -0,0 +1,37 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+//
+// The few lines every test executable shares. A test is a main() of CHECKs
+// over one portable module; a failed CHECK is reported and the test goes on,
+// test_report prints the verdict and gives main its exit code.
+//
+// run-tests.bat runs every test build-tools.bat built. They build just as well
+// with cc, e.g. cc -std=c99 -O2 code/tests/test_pool.c -lpthread -lm.
+//
+
+static int g_test_checks;
+static int g_test_failures;
+
+#define CHECK( cond ) test_check( ( cond ) != 0, __FILE__, __LINE__, #cond )
+
+static inline int test_check( int ok, const char *file, int line, const char *what )
+{
+	g_test_checks++;
+	if ( !ok )
+	{
+		g_test_failures++;
+		fprintf( stderr, "%s(%d): CHECK failed: %s\n", file, line, what );
+	}
+	return ok;
+}
+
+static inline int test_report( const char *name )
+{
+	printf( "%s: %d checks, %d failed\n", name, g_test_checks, g_test_failures );
+	return g_test_failures ? 1 : 0;
+}
+
+#endif // TEST_H
@@ -0,0 +1,168 @@
+//
+// test_batch2d: when the 2D batcher (r_batch2d.h) starts a new command, and
+// why. Setting state without changing it, untextured quads between textured
+// ones and a texture set before anything uses it keep one command; a change
+// of pipeline, scissor or texture, or a full command, starts the next one and
+// is counted under its reason. Commands always cover the quads in order.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_batch2d.c"
+
+static const float k_uv[4] = { 0.0f, 0.0f, 0.5f, 0.5f };
+
+static int g_atlas, g_icons;
+
+// Commands tile the quads: each starts where the one before it ended.
+static bool commands_cover_quads( const R_Batch2D *batch )
+{
+	uint32_t next = 0;
+	for ( uint32_t i = 0; i < batch->commandCount; ++i )
+	{
+		if ( batch->commands[i].firstQuad != next || batch->commands[i].quadCount == 0 )
+			return false;
+		next += batch->commands[i].quadCount;
+	}
+	return next == batch->quadCount;
+}
+
+static void glyphs( R_Batch2D *batch, int count )
+{
+	for ( int i = 0; i < count; ++i )
+		r_batch2d_textured_quad( batch, (float)i * 8.0f, 0.0f, 7.0f, 12.0f, k_uv, 0xffffffffu );
+}
+
+static void test_no_split( void )
+{
+	R_Batch2D batch;
+	CHECK( r_batch2d_init( &batch, 4 ) );
+	R_Pipeline    ui   = { 1 };
+	R_Batch2DRect clip = { 0, 0, 100, 100 };
+
+	// Panels, outlines and lines around text from one atlas, with every state set again in between.
+	r_batch2d_begin( &batch );
+	r_batch2d_set_pipeline( &batch, ui );
+	r_batch2d_rect( &batch, 0, 0, 100, 100, r_batch2d_rgba( 30, 30, 30, 255 ) );
+	r_batch2d_set_texture( &batch, &g_atlas );
+	glyphs( &batch, 10 );
+	r_batch2d_set_pipeline( &batch, ui );
+	r_batch2d_set_texture( &batch, &g_atlas );
+	r_batch2d_rect_outline( &batch, 0, 0, 100, 100, 1, 0xff000000u );
+	r_batch2d_line( &batch, 0, 20, 100, 20, 1, 0xff000000u );
+	glyphs( &batch, 10 );
+
+	// Another texture set but only used by untextured quads changes nothing.
+	r_batch2d_set_texture( &batch, &g_icons );
+	r_batch2d_rect( &batch, 0, 0, 10, 10, 0 );
+	r_batch2d_set_texture( &batch, &g_atlas );
+	glyphs( &batch, 1 );
+
+	CHECK( batch.commandCount == 1 && batch.quadCount == 1 + 10 + 4 + 1 + 10 + 1 + 1 );
+	CHECK( batch.commands[0].texture == &g_atlas );
+	CHECK( batch.stats.pipelineSplits + batch.stats.scissorSplits + batch.stats.textureSplits == 0 );
+
+	// The same scissor set twice is the same command too.
+	r_batch2d_set_scissor( &batch, &clip );
+	glyphs( &batch, 2 );
+	R_Batch2DRect same = clip;
+	r_batch2d_set_scissor( &batch, &same );
+	glyphs( &batch, 2 );
+	CHECK( batch.commandCount == 2 && batch.stats.scissorSplits == 1 );
+	CHECK( commands_cover_quads( &batch ) );
+
+	// Untextured quads keep the vertices' uvs marked, textured ones carry theirs.
+	const R_Batch2DVertex *first = &batch.vertices[0];
+	const R_Batch2DVertex *glyph = &batch.vertices[4];
+	CHECK( first->uv[0] == R_BATCH2D_NO_UV && glyph->uv[0] == k_uv[0] && glyph[2].uv[0] == k_uv[2] );
+	r_batch2d_free( &batch );
+}
+
+static void test_split_reasons( void )
+{
+	R_Batch2D batch;
+	CHECK( r_batch2d_init( &batch, 0 ) );
+	R_Pipeline    ui   = { 1 };
+	R_Pipeline    mask = { 2 };
+	R_Batch2DRect a    = { 0, 0, 100, 100 };
+	R_Batch2DRect b    = { 0, 0, 100, 101 };
+
+	r_batch2d_begin( &batch );
+	r_batch2d_set_pipeline( &batch, ui );
+	r_batch2d_set_texture( &batch, &g_atlas );
+	glyphs( &batch, 3 );
+
+	r_batch2d_set_texture( &batch, &g_icons );
+	glyphs( &batch, 1 );
+	CHECK( batch.commandCount == 2 && batch.stats.textureSplits == 1 );
+
+	r_batch2d_set_scissor( &batch, &a );
+	glyphs( &batch, 1 );
+	r_batch2d_set_scissor( &batch, &b );
+	glyphs( &batch, 1 );
+	r_batch2d_set_scissor( &batch, NULL );
+	glyphs( &batch, 1 );
+	CHECK( batch.commandCount == 5 && batch.stats.scissorSplits == 3 );
+	CHECK( batch.commands[2].scissorEnabled && batch.commands[3].scissor.height == 101 );
+	CHECK( !batch.commands[4].scissorEnabled );
+
+	// A pipeline change splits even for untextured quads, which otherwise join anything.
+	r_batch2d_set_pipeline( &batch, mask );
+	r_batch2d_rect( &batch, 0, 0, 1280, 720, 0x3c000000u );
+	CHECK( batch.commandCount == 6 && batch.stats.pipelineSplits == 1 );
+	CHECK( batch.commands[5].pipeline.id == mask.id && batch.commands[5].texture == NULL );
+
+	// Changing two things at once counts once, under the first reason checked.
+	r_batch2d_set_pipeline( &batch, ui );
+	r_batch2d_set_scissor( &batch, &a );
+	glyphs( &batch, 1 );
+	CHECK( batch.commandCount == 7 && batch.stats.pipelineSplits == 2 && batch.stats.scissorSplits == 3 );
+	CHECK( batch.stats.commands == 7 && batch.stats.sizeSplits == 0 );
+	CHECK( commands_cover_quads( &batch ) );
+
+	// A full command: the next quad starts another with the same state.
+	r_batch2d_begin( &batch );
+	r_batch2d_set_texture( &batch, &g_atlas );
+	for ( int i = 0; i < R_BATCH2D_MAX_QUADS_PER_DRAW + 5; ++i )
+		r_batch2d_rect( &batch, 0, 0, 1, 1, 0 );
+	CHECK( batch.commandCount == 2 && batch.commands[0].quadCount == R_BATCH2D_MAX_QUADS_PER_DRAW );
+	CHECK( batch.commands[1].quadCount == 5 && batch.stats.sizeSplits == 1 );
+	CHECK( commands_cover_quads( &batch ) );
+
+	// begin clears the state along with the geometry, the stats stay.
+	r_batch2d_begin( &batch );
+	CHECK( batch.quadCount == 0 && batch.commandCount == 0 && batch.texture == NULL && !batch.scissorEnabled );
+	CHECK( batch.stats.commands == 9 );
+	r_batch2d_free( &batch );
+}
+
+static void test_line( void )
+{
+	R_Batch2D batch;
+	CHECK( r_batch2d_init( &batch, 1 ) );
+	r_batch2d_begin( &batch );
+
+	// Half the thickness to either side; a zero length line draws nothing.
+	CHECK( r_batch2d_line( &batch, 0, 0, 10, 0, 2, 1 ) );
+	CHECK( r_batch2d_line( &batch, 5, 5, 5, 5, 2, 1 ) );
+	CHECK( batch.quadCount == 1 );
+	const R_Batch2DVertex *v = batch.vertices;
+	CHECK( v[0].pos[1] == 1.0f && v[3].pos[1] == -1.0f && v[1].pos[0] == 10.0f && v[2].pos[0] == 10.0f );
+
+	// An outline thicker than half the rect is the rect.
+	CHECK( r_batch2d_rect_outline( &batch, 0, 0, 4, 4, 2, 1 ) );
+	CHECK( batch.quadCount == 2 );
+	CHECK( r_batch2d_rect_outline( &batch, 0, 0, 40, 40, 2, 1 ) );
+	CHECK( batch.quadCount == 6 );
+	r_batch2d_free( &batch );
+}
+
+int main( void )
+{
+	test_no_split();
+	test_split_reasons();
+	test_line();
+	return test_report( "test_batch2d" );
+}
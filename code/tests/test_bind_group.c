@@ -0,0 +1,287 @@
+//
+// test_bind_group: bind group bookkeeping (r_bind_group.h), with a backend in
+// miniature around it the way r_d3d11.c uses it: a group takes one reference
+// on every object in its desc when it is made and hands them to the release
+// queue when its last reference goes. Creating a group twice gives the same id
+// and takes no second object reference; a desc with a colliding hash gets a
+// group of its own; the objects come back only once the frame that destroyed
+// the group completes; a removal moves the last group and its desc into the
+// hole. Bound groups are forgotten once anything else binds one of their
+// slots, and the slots a group binds count as unknown to the state cache.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_release_queue.c"
+#include "../render/common/r_bind_group.c"
+
+#define SLOTS 4
+#define CAPACITY 8
+
+typedef struct Object
+{
+	int refs;
+} Object;
+
+typedef struct Desc
+{
+	Object *objects[R_BIND_KIND_COUNT][R_STAGE_COUNT][SLOTS];
+} Desc;
+
+typedef struct Device
+{
+	R_BindGroupSet set;
+	uint32_t       tags[CAPACITY]; // the backend's own field per group, indexed like the set
+	R_ReleaseQueue releases;
+} Device;
+
+static void release_object( void *user, void *object )
+{
+	(void)user;
+	( (Object *)object )->refs--;
+}
+
+static R_BindGroupSlots desc_slots( const Desc *desc )
+{
+	R_BindGroupSlots slots;
+	memset( &slots, 0, sizeof( slots ) );
+	for ( int kind = 0; kind < R_BIND_KIND_COUNT; ++kind )
+	{
+		for ( int stage = 0; stage < R_STAGE_COUNT; ++stage )
+		{
+			for ( int slot = 0; slot < SLOTS; ++slot )
+				slots.masks[kind][stage] |= desc->objects[kind][stage][slot] ? 1u << slot : 0;
+		}
+	}
+	return slots;
+}
+
+// Every object of the group at dense, NULL where the desc is empty.
+static Object **desc_objects( Device *dev, uint32_t dense )
+{
+	return &( (Desc *)r_bind_group_set_desc( &dev->set, dense ) )->objects[0][0][0];
+}
+
+static uint32_t create_group( Device *dev, const Desc *desc, uint32_t tag )
+{
+	uint64_t hash = r_hash_bytes( desc, sizeof( *desc ), 0 );
+	uint32_t id   = r_bind_group_set_acquire( &dev->set, desc, hash );
+	if ( id )
+		return id;
+
+	R_BindGroupSlots slots = desc_slots( desc );
+	uint32_t         dense = 0;
+	if ( !( id = r_bind_group_set_add( &dev->set, desc, hash, &slots, &dense ) ) )
+		return 0;
+	dev->tags[dense] = tag;
+
+	Object **objects = desc_objects( dev, dense );
+	for ( size_t i = 0; i < sizeof( Desc ) / sizeof( Object * ); ++i )
+	{
+		if ( objects[i] )
+			objects[i]->refs++;
+	}
+	return id;
+}
+
+static void destroy_group( Device *dev, uint32_t id )
+{
+	if ( !r_bind_group_set_release( &dev->set, id ) )
+		return;
+
+	Object **objects = desc_objects( dev, r_pool_lookup( &dev->set.pool, id ) );
+	for ( size_t i = 0; i < sizeof( Desc ) / sizeof( Object * ); ++i )
+	{
+		if ( objects[i] && !r_release_queue_push( &dev->releases, objects[i] ) )
+			objects[i]->refs--;
+	}
+
+	uint32_t dense, moved;
+	r_bind_group_set_remove( &dev->set, id, &dense, &moved );
+	dev->tags[dense] = dev->tags[moved];
+}
+
+static uint32_t ref_count( Device *dev, uint32_t id )
+{
+	return r_pool_is_valid( &dev->set.pool, id ) ? dev->set.refCounts[r_pool_lookup( &dev->set.pool, id )] : 0;
+}
+
+static void test_refcounts( Device *dev )
+{
+	// A constant buffer for both stages, another one, a texture and a sampler for the pixel shader.
+	Object a = { 1 }, b = { 1 }, texture = { 1 }, sampler = { 1 }, other = { 1 };
+	Desc   desc;
+	memset( &desc, 0, sizeof( desc ) );
+	desc.objects[R_BIND_CONSTANTS][R_STAGE_VERTEX][0] = &a;
+	desc.objects[R_BIND_CONSTANTS][R_STAGE_PIXEL][0]  = &a;
+	desc.objects[R_BIND_CONSTANTS][R_STAGE_PIXEL][1]  = &b;
+	desc.objects[R_BIND_TEXTURES][R_STAGE_PIXEL][0]   = &texture;
+	desc.objects[R_BIND_SAMPLERS][R_STAGE_PIXEL][0]   = &sampler;
+
+	// The same desc twice: one group with two references, which holds one reference per slot on the objects.
+	r_release_queue_set_frame( &dev->releases, 1 );
+	uint32_t group = create_group( dev, &desc, 1 );
+	CHECK( group && create_group( dev, &desc, 2 ) == group && ref_count( dev, group ) == 2 );
+	CHECK( a.refs == 3 && b.refs == 2 && texture.refs == 2 && sampler.refs == 2 && dev->set.pool.count == 1 );
+	uint32_t i = r_pool_lookup( &dev->set.pool, group );
+	CHECK( dev->tags[i] == 1 && memcmp( r_bind_group_set_desc( &dev->set, i ), &desc, sizeof( desc ) ) == 0 );
+	CHECK( dev->set.slots[i].masks[R_BIND_CONSTANTS][R_STAGE_PIXEL] == 3u );
+	CHECK( dev->set.slots[i].masks[R_BIND_TEXTURES][R_STAGE_PIXEL] == 1u );
+	CHECK( dev->set.slots[i].masks[R_BIND_TEXTURES][R_STAGE_VERTEX] == 0 );
+
+	// Another sampler is another group, sharing the rest.
+	Desc changed                                       = desc;
+	changed.objects[R_BIND_SAMPLERS][R_STAGE_PIXEL][0] = &other;
+	uint32_t second                                    = create_group( dev, &changed, 3 );
+	CHECK( second && second != group && a.refs == 5 && texture.refs == 3 && other.refs == 2 );
+
+	// A desc whose hash collides isn't taken for the group it collides with.
+	uint64_t hash = r_hash_bytes( &desc, sizeof( desc ), 0 );
+	CHECK( r_bind_group_set_acquire( &dev->set, &changed, hash ) == 0 );
+	R_BindGroupSlots slots    = desc_slots( &changed );
+	uint32_t         collided = r_bind_group_set_add( &dev->set, &changed, hash, &slots, NULL );
+	CHECK( collided && collided != group && collided != second );
+	CHECK( r_bind_group_set_acquire( &dev->set, &desc, hash ) == group && ref_count( dev, group ) == 3 );
+	CHECK( r_bind_group_set_release( &dev->set, collided ) && !r_bind_group_set_release( &dev->set, group ) );
+	r_bind_group_set_remove( &dev->set, collided, NULL, NULL );
+	CHECK( create_group( dev, &desc, 4 ) == group && ref_count( dev, group ) == 3 );
+
+	// Only the last destroy gives the objects up, and only once the frame it happened in completes.
+	destroy_group( dev, group );
+	destroy_group( dev, group );
+	CHECK( ref_count( dev, group ) == 1 && a.refs == 5 );
+	destroy_group( dev, group );
+	CHECK( ref_count( dev, group ) == 0 && a.refs == 5 && sampler.refs == 2 );
+	CHECK( r_release_queue_collect( &dev->releases, 1 ) == 0 && a.refs == 5 );
+	r_release_queue_set_frame( &dev->releases, 2 );
+	CHECK( r_release_queue_collect( &dev->releases, 2 ) == 5 );
+	CHECK( a.refs == 3 && b.refs == 2 && texture.refs == 2 && sampler.refs == 1 && other.refs == 2 );
+
+	// No group at all changes nothing.
+	destroy_group( dev, 0 );
+	CHECK( ref_count( dev, second ) == 1 && a.refs == 3 );
+	destroy_group( dev, second );
+	r_release_queue_set_frame( &dev->releases, 3 );
+	CHECK( r_release_queue_collect( &dev->releases, 3 ) == 5 );
+	CHECK( a.refs == 1 && b.refs == 1 && texture.refs == 1 && sampler.refs == 1 && other.refs == 1 );
+	CHECK( dev->set.pool.count == 0 );
+}
+
+// Removing a group moves the last one, desc, slots, reference count and the backend's fields, into the hole.
+static void test_remove( Device *dev )
+{
+	Object   objects[CAPACITY];
+	Desc     descs[CAPACITY];
+	uint32_t groups[CAPACITY];
+	memset( descs, 0, sizeof( descs ) );
+	for ( uint32_t n = 0; n < CAPACITY; ++n )
+	{
+		objects[n].refs                                         = 1;
+		descs[n].objects[R_BIND_TEXTURES][R_STAGE_PIXEL][n % 4] = &objects[n];
+		groups[n]                                               = create_group( dev, &descs[n], 100 + n );
+	}
+	Desc spare;
+	memset( &spare, 0, sizeof( spare ) );
+	spare.objects[R_BIND_SAMPLERS][R_STAGE_VERTEX][0] = &objects[0];
+	CHECK( groups[CAPACITY - 1] && create_group( dev, &spare, 0 ) == 0 );
+
+	create_group( dev, &descs[CAPACITY - 1], 0 );
+	destroy_group( dev, groups[0] );
+	uint32_t last = r_pool_lookup( &dev->set.pool, groups[CAPACITY - 1] );
+	CHECK( last == 0 && dev->tags[last] == 100 + CAPACITY - 1 && ref_count( dev, groups[CAPACITY - 1] ) == 2 );
+	CHECK( memcmp( r_bind_group_set_desc( &dev->set, last ), &descs[CAPACITY - 1], sizeof( Desc ) ) == 0 );
+	CHECK( dev->set.slots[last].masks[R_BIND_TEXTURES][R_STAGE_PIXEL] == 1u << ( ( CAPACITY - 1 ) % 4 ) );
+	CHECK( create_group( dev, &descs[CAPACITY - 1], 0 ) == groups[CAPACITY - 1] );
+
+	// There's room again, and the destroyed desc makes a new group.
+	r_release_queue_drain( &dev->releases );
+	uint32_t again = create_group( dev, &descs[0], 200 );
+	CHECK( again && again != groups[0] && objects[0].refs == 2 );
+
+	destroy_group( dev, again );
+	for ( uint32_t n = 1; n < CAPACITY; ++n )
+	{
+		while ( r_pool_is_valid( &dev->set.pool, groups[n] ) )
+			destroy_group( dev, groups[n] );
+	}
+	r_release_queue_drain( &dev->releases );
+	bool released = dev->set.pool.count == 0;
+	for ( uint32_t n = 0; n < CAPACITY; ++n )
+		released = released && objects[n].refs == 1;
+	CHECK( released );
+}
+
+static void test_bound_groups( void )
+{
+	R_BindGroupSlots first, second, third;
+	memset( &first, 0, sizeof( first ) );
+	memset( &second, 0, sizeof( second ) );
+	memset( &third, 0, sizeof( third ) );
+	first.masks[R_BIND_CONSTANTS][R_STAGE_VERTEX] = 0x3;
+	first.masks[R_BIND_TEXTURES][R_STAGE_PIXEL]   = 0x1;
+	second.masks[R_BIND_TEXTURES][R_STAGE_PIXEL]  = 0x6;
+	third.masks[R_BIND_TEXTURES][R_STAGE_PIXEL]   = 0x1;
+	third.masks[R_BIND_SAMPLERS][R_STAGE_PIXEL]   = 0x1;
+
+	R_BoundGroups bound;
+	r_bound_groups_reset( &bound );
+	CHECK( r_bound_groups_bind( &bound, 0, 11, &first ) && !r_bound_groups_bind( &bound, 0, 11, &first ) );
+	CHECK( !r_bound_groups_bind( &bound, R_BIND_GROUP_INDICES, 12, &second ) );
+
+	// Groups on slots of their own stay bound side by side.
+	CHECK( r_bound_groups_bind( &bound, 1, 12, &second ) && bound.ids[0] == 11 && bound.ids[1] == 12 );
+
+	// Binds to other stages, kinds or slots leave them alone.
+	r_bound_groups_forget( &bound, R_BIND_TEXTURES, R_STAGE_VERTEX, 0x1 );
+	r_bound_groups_forget( &bound, R_BIND_CONSTANTS, R_STAGE_PIXEL, 0x3 );
+	r_bound_groups_forget( &bound, R_BIND_TEXTURES, R_STAGE_PIXEL, 0x8 );
+	CHECK( bound.ids[0] == 11 && bound.ids[1] == 12 );
+
+	// A bind of one of its slots forgets a group, so binding it again goes through.
+	r_bound_groups_forget( &bound, R_BIND_CONSTANTS, R_STAGE_VERTEX, 0x2 );
+	CHECK( bound.ids[0] == 0 && bound.slots[0].masks[R_BIND_TEXTURES][R_STAGE_PIXEL] == 0 && bound.ids[1] == 12 );
+	CHECK( r_bound_groups_bind( &bound, 0, 11, &first ) );
+
+	// So does a group at another index taking one of its slots.
+	CHECK( r_bound_groups_bind( &bound, 2, 13, &third ) && bound.ids[0] == 0 && bound.ids[1] == 12 );
+	CHECK( bound.ids[2] == 13 && bound.slots[2].masks[R_BIND_SAMPLERS][R_STAGE_PIXEL] == 0x1 );
+
+	// Rebinding at the same index replaces it; a reset forgets everything.
+	CHECK( r_bound_groups_bind( &bound, 2, 11, &first ) && bound.ids[2] == 11 && bound.ids[1] == 12 );
+	r_bound_groups_reset( &bound );
+	CHECK( bound.ids[1] == 0 && bound.ids[2] == 0 && r_bound_groups_bind( &bound, 1, 12, &second ) );
+
+	// Binding a group goes around the state cache: its slots count as unknown, the others don't.
+	R_StateCache cache;
+	int          view = 0;
+	r_state_cache_init( &cache );
+	CHECK( r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 1, &view ) );
+	CHECK( r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 3, &view ) );
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_PIXEL, 1, &view ) );
+	r_state_cache_forget_textures( &cache, R_STAGE_PIXEL, second.masks[R_BIND_TEXTURES][R_STAGE_PIXEL] );
+	r_state_cache_forget_constant_buffers( &cache, R_STAGE_PIXEL, second.masks[R_BIND_CONSTANTS][R_STAGE_PIXEL] );
+	CHECK( r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 1, &view ) );
+	CHECK( !r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 3, &view ) );
+	CHECK( !r_state_cache_set_constant_buffer( &cache, R_STAGE_PIXEL, 1, &view ) );
+}
+
+int main( void )
+{
+	static Device dev;
+	CHECK( r_bind_group_set_init( &dev.set, CAPACITY, sizeof( Desc ) ) );
+	CHECK( r_release_queue_init( &dev.releases, 64, release_object, NULL ) );
+
+	test_refcounts( &dev );
+	test_remove( &dev );
+	test_bound_groups();
+
+	r_release_queue_free( &dev.releases );
+	r_bind_group_set_free( &dev.set );
+	return test_report( "test_bind_group" );
+}
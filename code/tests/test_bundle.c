@@ -0,0 +1,221 @@
+//
+// test_bundle: draw bundles (r_bundle.h) executed on the headless backend,
+// which resolves their handles the way r_execute_bundle does on D3D11. The
+// first execute resolves every command and later ones reuse it until the
+// device's epoch moves: destroying an unrelated buffer re-resolves the
+// constant buffer that moved in its place, destroying a pipeline's vertex
+// shader re-resolves the pipeline to its fallback, and destroying a buffer the
+// bundle draws from leaves it invalid. After each execute the state cache
+// holds what the bundle bound last, so the same binds made by hand afterwards
+// are dropped.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_draw_queue.c"
+#include "../render/common/r_bundle.c"
+#include "../render/backend/headless/r_headless.c"
+
+typedef struct Scene
+{
+	uint32_t vsA, vsB, ps;
+	uint32_t fallback; // vsB, ps
+	uint32_t first;    // vsA, ps, falling back to the one above
+	uint32_t second;   // vsB, ps
+	uint32_t spare, vertices, indices, constantsA, constantsB;
+} Scene;
+
+static uint32_t execute( R_ReplayTarget *target, R_CaptureCall *call )
+{
+	return target->execute( target->self, call );
+}
+
+static uint32_t create_shader( R_ReplayTarget *target, R_CaptureOp op, char tag )
+{
+	uint8_t       bytecode[16] = { (uint8_t)tag };
+	R_CaptureCall call         = { .op = op, .data = bytecode, .size = sizeof( bytecode ) };
+	return execute( target, &call );
+}
+
+// A different rasterizer block each, so the backend doesn't share them.
+static uint32_t create_pipeline( R_ReplayTarget *target, uint32_t vs, uint32_t ps, uint32_t fallback, uint32_t tag )
+{
+	uint32_t blocks[10 + 24 + 13] = { 0 };
+	blocks[0]                     = tag;
+
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_PIPELINE, .refs = { vs, ps, 0, fallback } };
+	call.args[0]       = 10 * sizeof( uint32_t );
+	call.args[1]       = 24 * sizeof( uint32_t );
+	call.args[2]       = 13 * sizeof( uint32_t );
+	call.args[3]       = 0xffffffffu;
+	call.data          = blocks;
+	call.size          = sizeof( blocks );
+	return execute( target, &call );
+}
+
+static uint32_t create_buffer( R_ReplayTarget *target, const void *data, uint32_t bytes )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_BUFFER, .data = data, .size = bytes };
+	call.args[2]       = bytes;
+	return execute( target, &call );
+}
+
+static void destroy( R_ReplayTarget *target, R_CaptureOp op, uint32_t id )
+{
+	R_CaptureCall call = { .op = op, .id = id };
+	execute( target, &call );
+}
+
+static void push( R_Bundle *bundle, uint32_t pipeline, uint32_t constants, const Scene *s, uint64_t key )
+{
+	R_DrawPacket p    = { 0 };
+	p.pipeline.id     = pipeline;
+	p.vertexBuffer.id = s->vertices;
+	p.vertexStride    = 32;
+	p.indexBuffer.id  = s->indices;
+	p.indexFormat     = R_HEADLESS_INDEX_R16;
+	p.constants.id    = constants;
+	p.constantSlot    = 1;
+	p.indexCount      = 6;
+	r_bundle_push( bundle, key, &p );
+}
+
+static const R_BundleCommand *find_command( const R_Bundle *bundle, uint32_t type, uint32_t handle )
+{
+	for ( uint32_t i = 0; i < bundle->commandCount; ++i )
+	{
+		if ( bundle->commands[i].type == type && bundle->commands[i].handle == handle )
+			return &bundle->commands[i];
+	}
+	return NULL;
+}
+
+// The state cache holds the bundle's last binds: what the scene's second pipeline draws with.
+static bool check_state( R_Headless *dev, const Scene *s )
+{
+	const R_StateCache *cache     = &dev->state;
+	const void         *constants = r_headless_get( &dev->buffers, s->constantsA );
+	return cache->pipeline == (const void *)(uintptr_t)s->second &&
+	       cache->objects[R_STATE_OBJECT_VERTEX_SHADER] == (const void *)(uintptr_t)s->vsB &&
+	       cache->objects[R_STATE_OBJECT_PIXEL_SHADER] == (const void *)(uintptr_t)s->ps &&
+	       cache->vertexBuffers[0] == (const void *)(uintptr_t)s->vertices && cache->vertexStrides[0] == 32 &&
+	       cache->indexBuffer == (const void *)(uintptr_t)s->indices &&
+	       cache->indexFormat == R_HEADLESS_INDEX_R16 &&
+	       cache->constantBuffers[R_STAGE_VERTEX][1] == constants &&
+	       cache->constantBuffers[R_STAGE_PIXEL][1] == constants;
+}
+
+// The same binds made by hand after the bundle: each one is dropped.
+static bool binds_filtered( R_Headless *dev, R_ReplayTarget *target, const Scene *s )
+{
+	R_CaptureCall pipeline = { .op = R_CAPTURE_BIND_PIPELINE, .id = s->second };
+	R_CaptureCall vertices = { .op = R_CAPTURE_SET_VERTEX_BUFFER, .id = s->vertices };
+	R_CaptureCall indices  = { .op = R_CAPTURE_SET_INDEX_BUFFER, .id = s->indices };
+	R_CaptureCall constant = { .op = R_CAPTURE_BIND_CONSTANT_BUFFER, .id = s->constantsA };
+	vertices.args[0]       = 32;
+	indices.args[0]        = R_HEADLESS_INDEX_R16;
+	constant.args[0]       = 1;
+
+	R_StateStats before = dev->state.stats;
+	execute( target, &pipeline );
+	execute( target, &vertices );
+	execute( target, &indices );
+	execute( target, &constant );
+	const R_StateStats *after = &dev->state.stats;
+	return after->filtered[R_STATE_CALL_PIPELINE] == before.filtered[R_STATE_CALL_PIPELINE] + 1 &&
+	       after->filtered[R_STATE_CALL_VERTEX_BUFFER] == before.filtered[R_STATE_CALL_VERTEX_BUFFER] + 1 &&
+	       after->filtered[R_STATE_CALL_INDEX_BUFFER] == before.filtered[R_STATE_CALL_INDEX_BUFFER] + 1 &&
+	       after->filtered[R_STATE_CALL_CONSTANT_BUFFER] == before.filtered[R_STATE_CALL_CONSTANT_BUFFER] + 2;
+}
+
+int main( void )
+{
+	R_Headless    *dev    = r_headless_create();
+	R_ReplayTarget target = r_headless_replay_target( dev );
+	R_Bundle       bundle;
+	CHECK( dev && r_bundle_init( &bundle, 8 ) );
+	if ( !dev )
+		return test_report( "test_bundle" );
+
+	// The spare buffer comes first, so destroying it moves the last one created into its place.
+	static const uint16_t k_indices[6] = { 0, 1, 2, 0, 2, 3 };
+	static float          vertices[4 * 8];
+	Scene                 s;
+	s.vsA        = create_shader( &target, R_CAPTURE_CREATE_VERTEX_SHADER, 'a' );
+	s.vsB        = create_shader( &target, R_CAPTURE_CREATE_VERTEX_SHADER, 'b' );
+	s.ps         = create_shader( &target, R_CAPTURE_CREATE_PIXEL_SHADER, 'p' );
+	s.fallback   = create_pipeline( &target, s.vsB, s.ps, 0, 0 );
+	s.first      = create_pipeline( &target, s.vsA, s.ps, s.fallback, 1 );
+	s.second     = create_pipeline( &target, s.vsB, s.ps, 0, 2 );
+	s.spare      = create_buffer( &target, vertices, 64 );
+	s.vertices   = create_buffer( &target, vertices, sizeof( vertices ) );
+	s.indices    = create_buffer( &target, k_indices, sizeof( k_indices ) );
+	s.constantsA = create_buffer( &target, vertices, 64 );
+	s.constantsB = create_buffer( &target, vertices, 64 );
+	CHECK( s.first && s.second && s.fallback && s.constantsB );
+
+	push( &bundle, s.second, s.constantsA, &s, r_draw_key_make( 0, 1, 0, 0.5f ) );
+	push( &bundle, s.first, s.constantsB, &s, r_draw_key_make( 0, 0, 1, 0.5f ) );
+	push( &bundle, s.first, s.constantsA, &s, r_draw_key_make( 0, 0, 0, 0.5f ) );
+	push( &bundle, s.second, s.constantsA, &s, r_draw_key_make( 0, 1, 0, 0.5f ) );
+
+	// Not built yet: nothing to execute.
+	CHECK( !r_headless_execute_bundle( dev, &bundle ) );
+	CHECK( r_bundle_build( &bundle ) && bundle.draws == 4 );
+
+	// The first execute resolves; the second pipeline only differs from the first in its vertex shader.
+	R_HeadlessStats stats;
+	CHECK( r_headless_execute_bundle( dev, &bundle ) && bundle.valid && bundle.epoch == dev->resourceEpoch );
+	const R_BundleCommand *first    = find_command( &bundle, R_BUNDLE_CMD_PIPELINE, s.first );
+	const R_BundleCommand *second   = find_command( &bundle, R_BUNDLE_CMD_PIPELINE, s.second );
+	const R_BundleCommand *constant = find_command( &bundle, R_BUNDLE_CMD_CONSTANT_BUFFER, s.constantsB );
+	CHECK( first && second && constant && first < second );
+	if ( !first || !second || !constant )
+		return test_report( "test_bundle" );
+	CHECK( first->resolved == s.first && first->flags == ( 1u << R_STATE_OBJECT_COUNT ) - 1 );
+	CHECK( second->resolved == s.second && second->flags == 1u << R_STATE_OBJECT_VERTEX_SHADER );
+	CHECK( constant->object == r_headless_get( &dev->buffers, s.constantsB ) );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.bundleResolves == 1 && stats.draws == 4 && stats.invalidDraws == 0 && stats.indices == 24 );
+	CHECK( check_state( dev, &s ) && binds_filtered( dev, &target, &s ) );
+
+	// Nothing changed: no lookups the second time.
+	CHECK( r_headless_execute_bundle( dev, &bundle ) );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.bundleResolves == 1 && stats.draws == 8 && check_state( dev, &s ) );
+
+	// An unrelated buffer goes: the epoch moves and the constant buffer moved in its place is found again.
+	const void *moved = constant->object;
+	destroy( &target, R_CAPTURE_DESTROY_BUFFER, s.spare );
+	CHECK( bundle.epoch != dev->resourceEpoch );
+	CHECK( r_headless_execute_bundle( dev, &bundle ) && bundle.valid && bundle.epoch == dev->resourceEpoch );
+	CHECK( constant->object == r_headless_get( &dev->buffers, s.constantsB ) && constant->object != moved );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.bundleResolves == 2 && stats.invalidDraws == 0 && check_state( dev, &s ) );
+
+	// The first pipeline's vertex shader goes: it resolves to its fallback, which has the second's shaders.
+	destroy( &target, R_CAPTURE_DESTROY_VERTEX_SHADER, s.vsA );
+	CHECK( r_headless_execute_bundle( dev, &bundle ) && bundle.valid );
+	CHECK( first->resolved == s.fallback && first->object == (const void *)(uintptr_t)s.first );
+	CHECK( second->resolved == s.second && second->flags == 0 );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.bundleResolves == 3 && stats.invalidDraws == 0 && check_state( dev, &s ) );
+
+	// A buffer the bundle draws from goes: it can't execute, now or later, and draws nothing.
+	destroy( &target, R_CAPTURE_DESTROY_BUFFER, s.indices );
+	CHECK( !r_headless_execute_bundle( dev, &bundle ) && !bundle.valid );
+	CHECK( !r_headless_execute_bundle( dev, &bundle ) && !bundle.valid );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.bundleResolves == 3 && stats.draws == 16 );
+
+	r_bundle_free( &bundle );
+	r_headless_destroy( dev );
+	return test_report( "test_bundle" );
+}
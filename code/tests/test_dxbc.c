@@ -0,0 +1,193 @@
+//
+// test_dxbc: the input signature reader (r_dxbc.h) behind the input layout
+// cache. Builds small shader containers by hand: the ISGN chunk parses into
+// its elements, shaders declaring the same inputs hash the same whatever else
+// is in the container, different inputs hash differently, and truncated or
+// corrupted blobs are refused without reading outside them.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_dxbc.c"
+
+typedef struct Blob
+{
+	uint8_t bytes[512];
+	size_t  size;
+} Blob;
+
+typedef struct Input
+{
+	const char *name;
+	uint32_t    index;
+	uint32_t    reg;
+	uint8_t     mask;
+} Input;
+
+static void put_u32( Blob *blob, size_t at, uint32_t value )
+{
+	blob->bytes[at + 0] = (uint8_t)value;
+	blob->bytes[at + 1] = (uint8_t)( value >> 8 );
+	blob->bytes[at + 2] = (uint8_t)( value >> 16 );
+	blob->bytes[at + 3] = (uint8_t)( value >> 24 );
+}
+
+// A container with a filler chunk of fillerBytes in front of the ISGN chunk, the way RDEF comes
+// first in what the compiler writes. gap puts unused bytes between the element table and the names.
+static void build( Blob *blob, const Input *inputs, uint32_t count, uint32_t fillerBytes, uint32_t gap )
+{
+	memset( blob, 0, sizeof( *blob ) );
+	memcpy( blob->bytes, "DXBC", 4 );
+	put_u32( blob, 20, 1 );
+	put_u32( blob, 28, 2 );
+
+	size_t filler = 40;
+	memcpy( blob->bytes + filler, "RDEF", 4 );
+	put_u32( blob, filler + 4, fillerBytes );
+
+	size_t isgn  = filler + 8 + fillerBytes;
+	size_t chunk = isgn + 8;
+	size_t name  = 8 + count * 24 + gap;
+	memcpy( blob->bytes + isgn, "ISGN", 4 );
+	put_u32( blob, chunk, count );
+	put_u32( blob, chunk + 4, 8 );
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		size_t e = chunk + 8 + i * 24;
+		put_u32( blob, e, (uint32_t)name );
+		put_u32( blob, e + 4, inputs[i].index );
+		put_u32( blob, e + 12, 3 ); // float
+		put_u32( blob, e + 16, inputs[i].reg );
+		blob->bytes[e + 20] = inputs[i].mask;
+		blob->bytes[e + 21] = inputs[i].mask;
+		strcpy( (char *)blob->bytes + chunk + name, inputs[i].name );
+		name += strlen( inputs[i].name ) + 1;
+	}
+
+	uint32_t chunkSize = (uint32_t)( ( name + 3 ) & ~(size_t)3 );
+	put_u32( blob, isgn + 4, chunkSize );
+	put_u32( blob, 32, (uint32_t)filler );
+	put_u32( blob, 36, (uint32_t)isgn );
+	blob->size = chunk + chunkSize;
+	put_u32( blob, 24, (uint32_t)blob->size );
+}
+
+static const Input k_geometry3d[] = {
+    { "POSITION", 0, 0, 7 },
+    { "NORMAL", 0, 1, 7 },
+    { "TEXCOORD", 0, 2, 3 },
+};
+
+static uint64_t signature_hash( const Blob *blob )
+{
+	uint64_t hash = 0;
+	CHECK( r_dxbc_input_signature_hash( blob->bytes, blob->size, &hash ) );
+	return hash;
+}
+
+static void test_parse( void )
+{
+	Blob blob;
+	build( &blob, k_geometry3d, 3, 8, 0 );
+
+	const uint8_t *chunk     = NULL;
+	uint32_t       chunkSize = 0;
+	CHECK( r_dxbc_find_chunk( blob.bytes, blob.size, R_DXBC_CHUNK_ISGN, &chunk, &chunkSize ) );
+	CHECK( !r_dxbc_find_chunk( blob.bytes, blob.size, R_DXBC_FOURCC( 'O', 'S', 'G', 'N' ), &chunk, &chunkSize ) );
+	CHECK( r_dxbc_find_chunk( blob.bytes, blob.size, R_DXBC_CHUNK_ISGN, &chunk, &chunkSize ) );
+
+	R_DxbcSignatureElement elements[4];
+	CHECK( r_dxbc_parse_signature( chunk, chunkSize, elements, 4 ) == 3 );
+	CHECK( strcmp( elements[0].semanticName, "POSITION" ) == 0 && elements[0].mask == 7 );
+	CHECK( strcmp( elements[1].semanticName, "NORMAL" ) == 0 && elements[1].registerIndex == 1 );
+	CHECK( strcmp( elements[2].semanticName, "TEXCOORD" ) == 0 && elements[2].mask == 3 );
+	CHECK( elements[2].componentType == 3 );
+
+	// Fewer slots than elements: the count is still reported, only the slots given are written.
+	elements[1].semanticName = NULL;
+	CHECK( r_dxbc_parse_signature( chunk, chunkSize, elements, 1 ) == 3 );
+	CHECK( elements[1].semanticName == NULL );
+}
+
+static void test_hash( void )
+{
+	Blob a, b;
+	build( &a, k_geometry3d, 3, 8, 0 );
+
+	// Another shader with the same inputs: different code in front, names laid out differently.
+	build( &b, k_geometry3d, 3, 64, 12 );
+	CHECK( signature_hash( &a ) == signature_hash( &b ) );
+
+	Input changed[3];
+	memcpy( changed, k_geometry3d, sizeof( changed ) );
+	changed[2].name = "COLOR";
+	build( &b, changed, 3, 8, 0 );
+	CHECK( signature_hash( &a ) != signature_hash( &b ) );
+
+	memcpy( changed, k_geometry3d, sizeof( changed ) );
+	changed[2].index = 1;
+	build( &b, changed, 3, 8, 0 );
+	CHECK( signature_hash( &a ) != signature_hash( &b ) );
+
+	memcpy( changed, k_geometry3d, sizeof( changed ) );
+	changed[1].mask = 3;
+	build( &b, changed, 3, 8, 0 );
+	CHECK( signature_hash( &a ) != signature_hash( &b ) );
+
+	build( &b, k_geometry3d, 2, 8, 0 );
+	CHECK( signature_hash( &a ) != signature_hash( &b ) );
+}
+
+static void test_malformed( void )
+{
+	Blob     blob;
+	uint64_t hash = 0;
+	build( &blob, k_geometry3d, 3, 8, 0 );
+
+	// Every truncation is refused, the header's size no longer fits the blob.
+	bool ok = true;
+	for ( size_t size = 0; size < blob.size; ++size )
+		ok = ok && !r_dxbc_input_signature_hash( blob.bytes, size, &hash );
+	CHECK( ok );
+	CHECK( !r_dxbc_input_signature_hash( NULL, 0, &hash ) );
+
+	Blob bad = blob;
+	memcpy( bad.bytes, "DXBD", 4 );
+	CHECK( !r_dxbc_input_signature_hash( bad.bytes, bad.size, &hash ) );
+
+	// A chunk offset past the end, and an element count larger than the chunk.
+	bad = blob;
+	put_u32( &bad, 36, 4000 );
+	CHECK( !r_dxbc_input_signature_hash( bad.bytes, bad.size, &hash ) );
+	bad = blob;
+	put_u32( &bad, 40 + 8 + 8 + 8, 1000 );
+	CHECK( !r_dxbc_input_signature_hash( bad.bytes, bad.size, &hash ) );
+
+	// Names without their terminator.
+	bad = blob;
+	memset( bad.bytes + bad.size - 8, 'A', 8 );
+	CHECK( !r_dxbc_input_signature_hash( bad.bytes, bad.size, &hash ) );
+
+	// Random corruption may or may not parse, it must not read outside the blob (run it under a
+	// sanitizer to be sure of that).
+	srand( 3 );
+	for ( int i = 0; i < 100000; ++i )
+	{
+		bad = blob;
+		for ( int k = 1 + rand() % 4; k > 0; --k )
+			bad.bytes[(size_t)rand() % bad.size] = (uint8_t)rand();
+		r_dxbc_input_signature_hash( bad.bytes, bad.size, &hash );
+	}
+}
+
+int main( void )
+{
+	test_parse();
+	test_hash();
+	test_malformed();
+	return test_report( "test_dxbc" );
+}
@@ -0,0 +1,218 @@
+//
+// test_frame_graph: r_fg_compile on a deferred frame declared out of order.
+// Passes run after everything they read, the pass nobody consumes is culled,
+// transients whose lifetimes overlap never share memory in either plan, and
+// cycles and double writes are refused. Also checks that a pass reading an
+// old version of a texture runs before the pass writing the next one.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_frame_graph.c"
+
+static R_FrameGraph g_graph;
+static uint32_t     g_ran[R_FG_MAX_PASSES];
+static uint32_t     g_ranCount;
+
+static R_FgTextureDesc texture( uint32_t width, uint32_t height, uint32_t format, uint32_t bytesPerPixel, bool depth )
+{
+	R_FgTextureDesc desc = { 0 };
+	desc.width           = width;
+	desc.height          = height;
+	desc.format          = format;
+	desc.bytesPerPixel   = bytesPerPixel;
+	desc.depth           = depth;
+	return desc;
+}
+
+static void run_pass( void *user, void *context )
+{
+	(void)context;
+	g_ran[g_ranCount++] = (uint32_t)(uintptr_t)user;
+}
+
+static uint32_t add_pass( R_FrameGraph *graph, const char *name )
+{
+	uint32_t pass = r_fg_add_pass( graph, name, run_pass, NULL );
+	if ( pass )
+		graph->passes[pass - 1].user = (void *)(uintptr_t)pass;
+	return pass;
+}
+
+static uint32_t position( const R_FrameGraph *graph, uint32_t pass )
+{
+	for ( uint32_t i = 0; i < graph->orderCount; ++i )
+		if ( graph->order[i] == pass - 1 )
+			return i;
+	return R_FG_EXTERNAL;
+}
+
+static void test_deferred( void )
+{
+	R_FrameGraph *g = &g_graph;
+	r_fg_reset( g );
+
+	R_FgTextureDesc color  = texture( 1920, 1080, 28, 4, false );
+	R_FgTextureDesc hdr    = texture( 1920, 1080, 10, 8, false );
+	R_FgTextureDesc depth  = texture( 1920, 1080, 40, 4, true );
+	R_FgTextureDesc half   = texture( 960, 540, 10, 8, false );
+	R_FgResource    back   = r_fg_import_texture( g, "back", &color, NULL );
+	R_FgResource    albedo = r_fg_create_texture( g, "albedo", &color );
+	R_FgResource    normal = r_fg_create_texture( g, "normal", &color );
+	R_FgResource    z      = r_fg_create_texture( g, "depth", &depth );
+	R_FgResource    ao     = r_fg_create_texture( g, "ssao", &color );
+	R_FgResource    lit    = r_fg_create_texture( g, "hdr", &hdr );
+	R_FgResource    bloom0 = r_fg_create_texture( g, "bloom0", &half );
+	R_FgResource    bloom1 = r_fg_create_texture( g, "bloom1", &half );
+	R_FgResource    ldr    = r_fg_create_texture( g, "ldr", &color );
+	R_FgResource    debug  = r_fg_create_texture( g, "debug", &hdr );
+
+	// The last pass goes in first, the order comes from the edges alone.
+	uint32_t     tonemap = add_pass( g, "tonemap" );
+	uint32_t     gbuffer = add_pass( g, "gbuffer" );
+	R_FgResource albedo1 = r_fg_write( g, gbuffer, albedo );
+	R_FgResource normal1 = r_fg_write( g, gbuffer, normal );
+	R_FgResource z1      = r_fg_write( g, gbuffer, z );
+
+	uint32_t ssao = add_pass( g, "ssao" );
+	r_fg_read( g, ssao, z1 );
+	r_fg_read( g, ssao, normal1 );
+	R_FgResource ao1 = r_fg_write( g, ssao, ao );
+
+	uint32_t light = add_pass( g, "light" );
+	r_fg_read( g, light, albedo1 );
+	r_fg_read( g, light, normal1 );
+	r_fg_read( g, light, z1 );
+	r_fg_read( g, light, ao1 );
+	R_FgResource lit1 = r_fg_write( g, light, lit );
+
+	uint32_t view = add_pass( g, "debug" );
+	r_fg_read( g, view, normal1 );
+	r_fg_write( g, view, debug );
+
+	uint32_t down = add_pass( g, "bloomDown" );
+	r_fg_read( g, down, lit1 );
+	R_FgResource bloom01 = r_fg_write( g, down, bloom0 );
+	uint32_t     up      = add_pass( g, "bloomUp" );
+	r_fg_read( g, up, bloom01 );
+	R_FgResource bloom11 = r_fg_write( g, up, bloom1 );
+
+	uint32_t composite = add_pass( g, "composite" );
+	r_fg_read( g, composite, lit1 );
+	r_fg_read( g, composite, bloom11 );
+	R_FgResource ldr1 = r_fg_write( g, composite, ldr );
+	r_fg_read( g, tonemap, ldr1 );
+	r_fg_write( g, tonemap, back );
+
+	CHECK( r_fg_compile( g ) );
+	CHECK( g->stats.passes == 8 && g->stats.culledPasses == 1 && !g->passes[view - 1].live );
+	CHECK( g->orderCount == 7 && position( g, view ) == R_FG_EXTERNAL );
+
+	// Every live reader runs after the producer of each version it reads.
+	bool ok = true;
+	for ( uint32_t i = 0; i < g->orderCount; ++i )
+	{
+		const R_FgPass *pass = &g->passes[g->order[i]];
+		for ( uint32_t r = 0; r < pass->readCount; ++r )
+		{
+			uint32_t producer = g->nodes[pass->reads[r]].producer;
+			ok = ok && ( producer == R_FG_EXTERNAL || position( g, producer + 1 ) < i );
+		}
+	}
+	CHECK( ok );
+	CHECK( position( g, gbuffer ) == 0 && position( g, tonemap ) == 6 );
+
+	// The unused debug texture gets no memory; overlapping lifetimes share neither a texture nor heap bytes.
+	CHECK( g->resources[r_fg_resource_index( g, debug )].physical == R_FG_EXTERNAL );
+	CHECK( g->stats.transients == 8 );
+	for ( uint32_t i = 0; i < g->resourceCount; ++i )
+	{
+		for ( uint32_t j = i + 1; j < g->resourceCount; ++j )
+		{
+			const R_FgResourceInfo *a = &g->resources[i];
+			const R_FgResourceInfo *b = &g->resources[j];
+			if ( a->physical == R_FG_EXTERNAL || b->physical == R_FG_EXTERNAL || !r_fg_lifetimes_overlap( a, b ) )
+				continue;
+			ok = ok && a->physical != b->physical;
+			ok = ok && ( a->offset + a->size <= b->offset || b->offset + b->size <= a->offset );
+		}
+	}
+	CHECK( ok );
+	CHECK( g->stats.physicalCount < g->stats.transients );
+	CHECK( g->stats.heapBytes <= g->stats.physicalBytes && g->stats.physicalBytes < g->stats.totalBytes );
+
+	g_ranCount = 0;
+	r_fg_execute( g, NULL, NULL );
+	CHECK( g_ranCount == g->orderCount );
+	for ( uint32_t i = 0; i < g_ranCount; ++i )
+		ok = ok && g_ran[i] == g->order[i] + 1;
+	CHECK( ok );
+}
+
+static void test_invalid( void )
+{
+	R_FrameGraph   *g     = &g_graph;
+	R_FgTextureDesc color = texture( 64, 64, 28, 4, false );
+
+	// a reads what b writes and the other way around.
+	r_fg_reset( g );
+	R_FgResource x  = r_fg_create_texture( g, "x", &color );
+	R_FgResource y  = r_fg_create_texture( g, "y", &color );
+	uint32_t     a  = add_pass( g, "a" );
+	uint32_t     b  = add_pass( g, "b" );
+	R_FgResource x1 = r_fg_write( g, a, x );
+	R_FgResource y1 = r_fg_write( g, b, y );
+	r_fg_read( g, a, y1 );
+	r_fg_read( g, b, x1 );
+	r_fg_side_effect( g, a );
+	CHECK( !r_fg_compile( g ) );
+
+	// A version written twice.
+	r_fg_reset( g );
+	x = r_fg_create_texture( g, "x", &color );
+	a = add_pass( g, "a" );
+	r_fg_write( g, a, x );
+	r_fg_write( g, a, x );
+	CHECK( g->invalid && !r_fg_compile( g ) );
+
+	// Handles that were never handed out.
+	r_fg_reset( g );
+	a = add_pass( g, "a" );
+	R_FgResource bogus = { 200 };
+	r_fg_read( g, a, bogus );
+	CHECK( g->invalid && !r_fg_compile( g ) );
+	CHECK( r_fg_resource_index( g, bogus ) == R_FG_EXTERNAL );
+}
+
+// rd reads the first version of x, w2 writes the second: rd has to run in between, whatever the
+// declaration order says.
+static void test_write_after_read( void )
+{
+	R_FrameGraph   *g     = &g_graph;
+	R_FgTextureDesc color = texture( 64, 64, 28, 4, false );
+	r_fg_reset( g );
+	R_FgResource x    = r_fg_create_texture( g, "x", &color );
+	R_FgResource back = r_fg_import_texture( g, "back", &color, NULL );
+	uint32_t     w2   = add_pass( g, "w2" );
+	uint32_t     w1   = add_pass( g, "w1" );
+	uint32_t     rd   = add_pass( g, "rd" );
+	R_FgResource x1   = r_fg_write( g, w1, x );
+	r_fg_read( g, rd, x1 );
+	r_fg_write( g, rd, back );
+	r_fg_write( g, w2, x1 );
+	r_fg_side_effect( g, w2 );
+
+	CHECK( r_fg_compile( g ) );
+	CHECK( g->orderCount == 3 );
+	CHECK( position( g, w1 ) == 0 && position( g, rd ) == 1 && position( g, w2 ) == 2 );
+}
+
+int main( void )
+{
+	test_deferred();
+	test_invalid();
+	test_write_after_read();
+	return test_report( "test_frame_graph" );
+}
@@ -0,0 +1,224 @@
+//
+// test_frame_pipe: the game to render thread hand-off (r_frame_pipe.h). Every
+// submitted frame is acquired exactly once, in order, with the views, draws
+// and constants its producer wrote, and nothing writes a packet while the
+// render thread holds it. The threaded case runs the two sides at different
+// rates, first a slow producer, then a slow consumer, then both jittering, so
+// each of them has to wait for the other. Closing still hands over what was submitted.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_draw_queue.c"
+#include "../render/common/r_frame_pipe.c"
+
+#define FRAMES 20000
+#define SLOW_SPINS 20000
+
+typedef struct FrameData
+{
+	uint64_t frame;
+	uint64_t check; // frame * a constant, so a torn or stale packet shows
+} FrameData;
+
+static R_FramePipe       g_pipe;
+static uint8_t           g_seen[FRAMES];
+static volatile uint64_t g_sink[2]; // one per thread, keeps the busy work from being optimized out
+static bool              g_ok = true;
+
+static void spin( int thread, uint32_t n )
+{
+	uint64_t x = g_sink[thread];
+	for ( uint32_t i = 0; i < n; ++i )
+		x = x * 6364136223846793005ull + 1;
+	g_sink[thread] = x;
+}
+
+static uint32_t draws_for( uint64_t frame )
+{
+	return (uint32_t)( frame % 5 ) + 1;
+}
+
+// Slow producer for the first third, slow consumer for the second, a pseudo-random mix after that.
+static uint32_t producer_spins( uint64_t frame )
+{
+	if ( frame < FRAMES / 3 )
+		return SLOW_SPINS;
+	if ( frame < 2 * FRAMES / 3 )
+		return 0;
+	return (uint32_t)( ( frame * 2654435761u ) >> 7 ) % SLOW_SPINS;
+}
+
+static uint32_t consumer_spins( uint64_t frame )
+{
+	if ( frame < FRAMES / 3 )
+		return 0;
+	if ( frame < 2 * FRAMES / 3 )
+		return SLOW_SPINS;
+	return (uint32_t)( ( frame * 40503u ) >> 3 ) % SLOW_SPINS;
+}
+
+static void write_frame( R_FramePacket *packet, uint64_t frame )
+{
+	FrameData   data = { frame, frame * 0x9E3779B97F4A7C15ull };
+	R_FrameView view = { .pass = (uint32_t)frame };
+	packet->time     = (float)frame;
+	r_frame_packet_add_view( packet, &view );
+	r_frame_packet_push_constants( packet, &data, sizeof( data ) );
+
+	// Pushed back to front so the render side's sort has something to do.
+	uint32_t count = draws_for( frame );
+	for ( uint32_t i = count; i-- > 0; )
+	{
+		R_DrawPacket draw = { .indexCount = (uint32_t)frame, .startIndex = i };
+		r_draw_queue_push( &packet->draws, i, &draw );
+	}
+}
+
+static bool frame_intact( R_FramePacket *packet, uint64_t frame )
+{
+	const FrameData *data = (const FrameData *)r_frame_packet_constants( packet, 0 );
+	bool ok = data && data->frame == frame && data->check == frame * 0x9E3779B97F4A7C15ull;
+	ok      = ok && packet->frame == frame && packet->time == (float)frame;
+	ok      = ok && packet->viewCount == 1 && packet->views[0].pass == (uint32_t)frame;
+	ok      = ok && packet->draws.count == draws_for( frame );
+	for ( uint32_t i = 0; ok && i < packet->draws.count; ++i )
+	{
+		const R_DrawPacket *draw = r_draw_queue_get( &packet->draws, i );
+		ok                       = draw->indexCount == (uint32_t)frame && draw->startIndex == i;
+	}
+	return ok;
+}
+
+static void test_packets( void )
+{
+	CHECK( r_frame_pipe_init( &g_pipe, 4, 64 ) );
+
+	// One packet at a time on each side.
+	R_FramePacket *packet = r_frame_pipe_begin( &g_pipe );
+	CHECK( packet && packet->frame == 0 && r_frame_pipe_begin( &g_pipe ) == NULL );
+	write_frame( packet, 0 );
+
+	// Constants land on 16 byte boundaries and stop at the capacity; views stop at the limit.
+	uint8_t bytes[64] = { 0 };
+	CHECK( r_frame_packet_push_constants( packet, bytes, 3 ) == 16 );
+	CHECK( r_frame_packet_push_constants( packet, bytes, 32 ) == 32 );
+	CHECK( r_frame_packet_push_constants( packet, bytes, 1 ) == UINT32_MAX && packet->constantBytes == 64 );
+	R_FrameView view  = { .pass = 0 };
+	int         added = 0;
+	while ( r_frame_packet_add_view( packet, &view ) )
+		added++;
+	CHECK( added == R_FRAME_MAX_VIEWS - 1 );
+	r_frame_pipe_submit( &g_pipe );
+
+	// The second packet is free while the first waits; a third has to wait for a release.
+	packet = r_frame_pipe_begin( &g_pipe );
+	CHECK( packet == &g_pipe.packets[1] && packet->frame == 1 && packet->constantBytes == 0 );
+	write_frame( packet, 1 );
+	r_frame_pipe_submit( &g_pipe );
+
+	R_FramePacket *first = r_frame_pipe_acquire( &g_pipe );
+	CHECK( first && first->frame == 0 && r_frame_pipe_acquire( &g_pipe ) == NULL );
+	r_frame_pipe_release( &g_pipe );
+
+	// Frame 2 reuses frame 0's packet, reset.
+	packet = r_frame_pipe_begin( &g_pipe );
+	CHECK( packet == first && packet->frame == 2 && packet->viewCount == 0 && packet->draws.count == 0 );
+	write_frame( packet, 2 );
+	r_frame_pipe_submit( &g_pipe );
+
+	// Closing keeps what was submitted; after that there are no more frames either way.
+	r_frame_pipe_close( &g_pipe );
+	CHECK( r_frame_pipe_begin( &g_pipe ) == NULL );
+	for ( uint64_t frame = 1; frame <= 2; ++frame )
+	{
+		packet = r_frame_pipe_acquire( &g_pipe );
+		if ( !packet )
+		{
+			CHECK( packet );
+			break;
+		}
+		r_draw_queue_sort( &packet->draws );
+		CHECK( frame_intact( packet, frame ) );
+		r_frame_pipe_release( &g_pipe );
+	}
+	CHECK( r_frame_pipe_acquire( &g_pipe ) == NULL );
+
+	R_FramePipeStats stats;
+	r_frame_pipe_get_stats( &g_pipe, &stats );
+	CHECK( stats.frames == 3 && stats.producerStalls == 0 && stats.parks == 0 );
+	r_frame_pipe_free( &g_pipe );
+}
+
+static void render_thread( void *arg )
+{
+	(void)arg;
+	uint64_t       expected = 0;
+	R_FramePacket *packet;
+	while ( ( packet = r_frame_pipe_acquire( &g_pipe ) ) )
+	{
+		uint64_t frame = packet->frame;
+		g_ok           = g_ok && frame == expected && frame < FRAMES;
+		if ( frame < FRAMES )
+			g_seen[frame]++;
+
+		// Checked before and after the work: the game thread must not be writing this packet meanwhile.
+		r_draw_queue_sort( &packet->draws );
+		g_ok = g_ok && frame_intact( packet, frame );
+		spin( 1, consumer_spins( frame ) );
+		g_ok = g_ok && frame_intact( packet, frame );
+
+		r_frame_pipe_release( &g_pipe );
+		expected++;
+	}
+}
+
+static void test_rates( void )
+{
+	CHECK( r_frame_pipe_init( &g_pipe, 2, 64 ) );
+	memset( g_seen, 0, sizeof( g_seen ) );
+
+	SYS_Thread thread;
+	CHECK( sys_thread_start( &thread, render_thread, NULL ) );
+
+	bool ahead = false;
+	for ( uint64_t frame = 0; frame < FRAMES; ++frame )
+	{
+		R_FramePacket *packet = r_frame_pipe_begin( &g_pipe );
+		if ( !packet )
+		{
+			CHECK( packet );
+			break;
+		}
+
+		// Never more than one frame ahead of the one on screen.
+		ahead = ahead || packet->frame != frame;
+		ahead = ahead || frame - (uint64_t)sys_atomic_load( &g_pipe.released ) >= R_FRAME_PIPE_DEPTH;
+		spin( 0, producer_spins( frame ) );
+		write_frame( packet, frame );
+		r_frame_pipe_submit( &g_pipe );
+	}
+	r_frame_pipe_close( &g_pipe );
+	sys_thread_join( &thread );
+
+	bool once = true;
+	for ( uint32_t i = 0; i < FRAMES; ++i )
+		once = once && g_seen[i] == 1;
+	CHECK( once && !ahead && g_ok );
+
+	// Each side ran ahead for a third of the run, so each found the other behind.
+	R_FramePipeStats stats;
+	r_frame_pipe_get_stats( &g_pipe, &stats );
+	CHECK( stats.frames == FRAMES && stats.producerStalls > 0 && stats.consumerStalls > 0 );
+	r_frame_pipe_free( &g_pipe );
+}
+
+int main( void )
+{
+	test_packets();
+	test_rates();
+	return test_report( "test_frame_pipe" );
+}
@@ -0,0 +1,230 @@
+//
+// test_mesh_build: index width and submesh splitting (r_mesh_build in
+// r_mesh.h). Whatever the mode, the submeshes are consecutive ranges that
+// cover every index exactly once and their vertex runs follow each other the
+// same way; split submeshes stay within 16-bit indices; and drawing each one
+// at its baseVertex names the vertices of the original triangles, corner by
+// corner. Meshes below the limit and those falling back to 32 bits are one
+// draw on the vertices as they came in. The meshes are a grid in scan order
+// and shuffled with degenerate triangles mixed in, and strips right at the
+// 16-bit limit and one vertex past it.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_mesh.c"
+
+typedef struct Vertex
+{
+	float    position[3];
+	uint32_t id; // the vertex's index when the mesh was made
+} Vertex;
+
+typedef struct Mesh
+{
+	Vertex   *vertices;
+	size_t    vertexCount;
+	uint32_t *indices;
+	size_t    indexCount;
+} Mesh;
+
+static uint32_t g_random = 11;
+
+static uint32_t next_random( void )
+{
+	g_random = g_random * 1664525u + 1013904223u;
+	return g_random >> 8;
+}
+
+static bool mesh_alloc( Mesh *mesh, size_t vertexCount, size_t indexCount )
+{
+	mesh->vertices    = (Vertex *)calloc( vertexCount, sizeof( Vertex ) );
+	mesh->indices     = (uint32_t *)malloc( indexCount * sizeof( uint32_t ) );
+	mesh->vertexCount = vertexCount;
+	mesh->indexCount  = indexCount;
+	for ( size_t i = 0; mesh->vertices && i < vertexCount; ++i )
+	{
+		mesh->vertices[i].position[0] = (float)i;
+		mesh->vertices[i].id          = (uint32_t)i;
+	}
+	return mesh->vertices && mesh->indices;
+}
+
+static void mesh_free( Mesh *mesh )
+{
+	free( mesh->vertices );
+	free( mesh->indices );
+}
+
+// n x n vertices. Shuffled, every 16th triangle also loses a corner to one of the others.
+static bool make_grid( Mesh *mesh, uint32_t n, bool shuffled )
+{
+	if ( !mesh_alloc( mesh, (size_t)n * n, (size_t)( n - 1 ) * ( n - 1 ) * 6 ) )
+		return false;
+
+	uint32_t *out = mesh->indices;
+	for ( uint32_t y = 0; y + 1 < n; ++y )
+	{
+		for ( uint32_t x = 0; x + 1 < n; ++x )
+		{
+			uint32_t a = y * n + x, b = a + 1, c = a + n, d = c + 1;
+			*out++     = a;
+			*out++     = c;
+			*out++     = b;
+			*out++     = b;
+			*out++     = c;
+			*out++     = d;
+		}
+	}
+	if ( !shuffled )
+		return true;
+
+	uint32_t *t = mesh->indices;
+	for ( size_t i = mesh->indexCount / 3 - 1; i > 0; --i )
+	{
+		size_t j = next_random() % ( i + 1 );
+		for ( int c = 0; c < 3; ++c )
+		{
+			uint32_t swap = t[i * 3 + c];
+			t[i * 3 + c]  = t[j * 3 + c];
+			t[j * 3 + c]  = swap;
+		}
+		if ( i % 16 == 0 )
+			t[i * 3 + 2] = t[i * 3 + next_random() % 2];
+	}
+	return true;
+}
+
+// count vertices, each triangle the next three.
+static bool make_strip( Mesh *mesh, size_t count )
+{
+	if ( !mesh_alloc( mesh, count, ( count - 2 ) * 3 ) )
+		return false;
+	for ( size_t i = 0; i + 2 < count; ++i )
+	{
+		mesh->indices[i * 3 + 0] = (uint32_t)i;
+		mesh->indices[i * 3 + 1] = (uint32_t)( i + 1 + i % 2 );
+		mesh->indices[i * 3 + 2] = (uint32_t)( i + 2 - i % 2 );
+	}
+	return true;
+}
+
+static bool build_mesh( const Mesh *mesh, R_MeshIndexMode mode, R_MeshBuild *outBuild )
+{
+	return r_mesh_build(
+	    mesh->vertices, mesh->vertexCount, sizeof( Vertex ), mesh->indices, mesh->indexCount, mode, outBuild );
+}
+
+// The build against the mesh it came from. Returns the submesh count, 0 when anything is off.
+static uint32_t check_build( const Mesh *mesh, const R_MeshBuild *build )
+{
+	const Vertex *vertices = build->vertices ? (const Vertex *)build->vertices : mesh->vertices;
+	bool          sizes    = build->indexSize == 2 || build->indexSize == 4;
+	bool          ok       = sizes && build->indexCount == mesh->indexCount && build->submeshCount > 0;
+
+	// Ranges and vertex runs each start where the one before ended, so together they cover
+	// every index and every vertex exactly once.
+	uint32_t nextIndex  = 0;
+	size_t   nextVertex = 0;
+	for ( uint32_t s = 0; ok && s < build->submeshCount; ++s )
+	{
+		const R_Submesh *sub = &build->submeshes[s];
+		ok = sub->startIndex == nextIndex && sub->baseVertex >= 0 && (size_t)sub->baseVertex == nextVertex &&
+		     sub->indexCount > 0 && sub->indexCount % 3 == 0;
+		ok = ok && ( build->indexSize == 4 || sub->vertexCount <= R_MESH_MAX_16BIT_VERTICES );
+		nextIndex += sub->indexCount;
+		nextVertex += sub->vertexCount;
+
+		// Drawn at baseVertex, the submesh names the original vertices in the original order.
+		for ( uint32_t i = sub->startIndex; ok && i < sub->startIndex + sub->indexCount; ++i )
+		{
+			uint32_t index = build->indexSize == 2 ? ( (const uint16_t *)build->indices )[i]
+			                                       : ( (const uint32_t *)build->indices )[i];
+			ok             = index < sub->vertexCount && vertices[sub->baseVertex + index].id == mesh->indices[i];
+		}
+	}
+	ok = ok && nextIndex == build->indexCount && nextVertex == build->vertexCount;
+	ok = ok && ( build->vertices || build->vertexCount == mesh->vertexCount );
+	return ok ? build->submeshCount : 0;
+}
+
+static void test_below_limit( void )
+{
+	Mesh        mesh;
+	R_MeshBuild build;
+	CHECK( make_grid( &mesh, 100, true ) );
+	CHECK( build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	CHECK( build.indexSize == 2 && build.vertices == NULL && check_build( &mesh, &build ) == 1 );
+	r_mesh_build_free( &build );
+	mesh_free( &mesh );
+
+	// 65535 vertices still fit, one more doesn't.
+	CHECK( make_strip( &mesh, R_MESH_MAX_16BIT_VERTICES ) );
+	CHECK( build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	CHECK( build.indexSize == 2 && build.vertices == NULL && check_build( &mesh, &build ) == 1 );
+	r_mesh_build_free( &build );
+	mesh_free( &mesh );
+
+	CHECK( make_strip( &mesh, R_MESH_MAX_16BIT_VERTICES + 1 ) );
+	CHECK( build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	CHECK( build.indexSize == 2 && build.vertices != NULL && check_build( &mesh, &build ) == 2 );
+	CHECK( build.submeshes[0].vertexCount == R_MESH_MAX_16BIT_VERTICES && build.submeshes[1].indexCount == 3 );
+	r_mesh_build_free( &build );
+	mesh_free( &mesh );
+}
+
+static void test_split( bool shuffled )
+{
+	Mesh mesh;
+	CHECK( make_grid( &mesh, 300, shuffled ) );
+
+	R_MeshBuild build;
+	CHECK( build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	uint32_t submeshes = check_build( &mesh, &build );
+	CHECK( build.indexSize == 2 && build.vertices != NULL && submeshes >= 2 );
+
+	// In scan order only the rows on the cuts are stored twice.
+	if ( !shuffled )
+		CHECK( build.vertexCount <= mesh.vertexCount + ( submeshes - 1 ) * 2 * 300 );
+	r_mesh_build_free( &build );
+
+	// The same mesh falling back to 32 bits: one draw on the vertices as they are.
+	CHECK( build_mesh( &mesh, R_MESH_FALLBACK_32, &build ) );
+	CHECK( build.indexSize == 4 && build.vertices == NULL && check_build( &mesh, &build ) == 1 );
+	CHECK( memcmp( build.indices, mesh.indices, mesh.indexCount * sizeof( uint32_t ) ) == 0 );
+	r_mesh_build_free( &build );
+	mesh_free( &mesh );
+}
+
+static void test_bad_input( void )
+{
+	Mesh        mesh;
+	R_MeshBuild build;
+	CHECK( make_strip( &mesh, 8 ) );
+	mesh.indices[5] = 8;
+	CHECK( !build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	CHECK( build.indices == NULL && build.submeshes == NULL );
+	mesh.indices[5] = 7;
+	mesh.indexCount = 17;
+	CHECK( !build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	mesh.indexCount  = 18;
+	mesh.vertexCount = 0;
+	CHECK( !build_mesh( &mesh, R_MESH_SPLIT_16, &build ) );
+	mesh.vertexCount = 8;
+	CHECK( build_mesh( &mesh, R_MESH_SPLIT_16, &build ) && check_build( &mesh, &build ) == 1 );
+	r_mesh_build_free( &build );
+	mesh_free( &mesh );
+}
+
+int main( void )
+{
+	test_below_limit();
+	test_split( false );
+	test_split( true );
+	test_bad_input();
+	return test_report( "test_mesh_build" );
+}
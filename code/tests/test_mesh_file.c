@@ -0,0 +1,218 @@
+//
+// test_mesh_file: binary mesh files (r_mesh_file.h). A small grid built with
+// r_mesh_build is encoded, viewed in memory and opened from disk; the view
+// points at the same vertices, indices and submeshes and the bounds cover the
+// grid. Then every check of r_mesh_file_view gets a file that should fail it:
+// cut short, written for another layout, mapped at an unaligned address, with
+// a submesh reaching past the indices or vertices, and with section offsets
+// that are unaligned, past the end or too close to it for their section.
+//
+// Works in the current directory, on test_mesh_file.tmp.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_file.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_mesh.c"
+#include "../render/common/r_mesh_file.c"
+
+#define TEST_MESH_PATH "test_mesh_file.tmp"
+#define GRID 8 // quads per side
+
+typedef struct Grid
+{
+	R_MeshFileVertex vertices[( GRID + 1 ) * ( GRID + 1 )];
+	uint32_t         indices[GRID * GRID * 6];
+} Grid;
+
+static void make_grid( Grid *grid )
+{
+	for ( uint32_t i = 0; i < ( GRID + 1 ) * ( GRID + 1 ); ++i )
+	{
+		R_MeshFileVertex *v = &grid->vertices[i];
+		memset( v, 0, sizeof( *v ) );
+		v->position[0] = (float)( i % ( GRID + 1 ) );
+		v->position[1] = 1.0f;
+		v->position[2] = -(float)( i / ( GRID + 1 ) );
+		v->normal[1]   = 1.0f;
+		v->uv[0]       = v->position[0] / GRID;
+		v->uv[1]       = -v->position[2] / GRID;
+	}
+	uint32_t *out = grid->indices;
+	for ( uint32_t y = 0; y < GRID; ++y )
+	{
+		for ( uint32_t x = 0; x < GRID; ++x )
+		{
+			uint32_t a = y * ( GRID + 1 ) + x, b = a + 1, c = a + GRID + 1, d = c + 1;
+			*out++     = a;
+			*out++     = c;
+			*out++     = b;
+			*out++     = b;
+			*out++     = c;
+			*out++     = d;
+		}
+	}
+}
+
+// A copy of the image to break, in memory aligned the way a mapping is.
+static uint8_t *copy_image( const void *image, size_t size )
+{
+	uint8_t *copy = (uint8_t *)malloc( size );
+	if ( copy )
+		memcpy( copy, image, size );
+	return copy;
+}
+
+static bool view_copy( const uint8_t *copy, size_t size, uint64_t layoutHash )
+{
+	R_MeshFileView view;
+	return r_mesh_file_view( copy, size, layoutHash, &view );
+}
+
+static void test_roundtrip( const R_MeshBuild *mesh, const Grid *grid, const void *image, size_t size, uint64_t hash )
+{
+	R_MeshFileView view;
+	CHECK( r_mesh_file_view( image, size, hash, &view ) );
+	if ( !view.header )
+		return;
+
+	const R_MeshFileHeader *h = view.header;
+	CHECK( h->stride == sizeof( R_MeshFileVertex ) && h->indexSize == 2 );
+	CHECK( h->vertexCount == ( GRID + 1 ) * ( GRID + 1 ) && h->indexCount == GRID * GRID * 6 );
+	CHECK( h->boundsMin[0] == 0.0f && h->boundsMax[0] == GRID && h->boundsMin[2] == -GRID );
+	CHECK( h->boundsMin[1] == 1.0f && h->boundsMax[1] == 1.0f );
+	CHECK( h->submeshCount == 1 && view.submeshes[0].range.indexCount == h->indexCount );
+	CHECK( view.submeshes[0].boundsMax[0] == GRID && view.submeshes[0].boundsMin[2] == -GRID );
+
+	// Straight into the file's bytes, aligned for buffer creation.
+	const uint8_t *base = (const uint8_t *)image;
+	CHECK( (const uint8_t *)view.vertices == base + h->vertexOffset && h->vertexOffset % R_MESH_FILE_ALIGNMENT == 0 );
+	CHECK( (const uint8_t *)view.indices == base + h->indexOffset && h->indexOffset % R_MESH_FILE_ALIGNMENT == 0 );
+	CHECK( memcmp( view.vertices, grid->vertices, sizeof( grid->vertices ) ) == 0 );
+	CHECK( memcmp( view.indices, mesh->indices, mesh->indexCount * 2 ) == 0 );
+
+	// The same from disk, through a mapping.
+	R_MeshFile file;
+	CHECK( r_mesh_file_save( TEST_MESH_PATH, image, size ) );
+	CHECK( r_mesh_file_open( &file, TEST_MESH_PATH, hash ) );
+	CHECK( file.view.header && file.view.header->fileSize == size );
+	CHECK( file.view.header && memcmp( file.view.vertices, grid->vertices, sizeof( grid->vertices ) ) == 0 );
+	r_mesh_file_close( &file );
+	CHECK( !r_mesh_file_open( &file, TEST_MESH_PATH, hash + 1 ) );
+	remove( TEST_MESH_PATH );
+}
+
+static void test_rejects( const void *image, size_t size, uint64_t hash )
+{
+	uint8_t *copy = copy_image( image, size );
+	CHECK( copy && view_copy( copy, size, hash ) );
+	if ( !copy )
+		return;
+	R_MeshFileHeader  *h       = (R_MeshFileHeader *)copy;
+	R_MeshFileSubmesh *submesh = (R_MeshFileSubmesh *)( copy + h->submeshOffset );
+	R_MeshFileHeader   good    = *h;
+	R_MeshFileSubmesh  range   = *submesh;
+
+	// Cut short: by a section, by a byte, down to less than a header.
+	CHECK( !view_copy( copy, size - R_MESH_FILE_ALIGNMENT, hash ) );
+	CHECK( !view_copy( copy, size - 1, hash ) );
+	CHECK( !view_copy( copy, sizeof( R_MeshFileHeader ) - 1, hash ) );
+	CHECK( !r_mesh_file_view( NULL, size, hash, &( R_MeshFileView ){ 0 } ) );
+
+	// Another layout, or the same one with another stride.
+	CHECK( !view_copy( copy, size, hash ^ 1 ) );
+	CHECK( !view_copy( copy, size, r_mesh_file_layout_hash( R_MESH_FILE_LAYOUT_PNT, 36 ) ) );
+
+	// Unaligned for the header's 64-bit fields.
+	uint8_t *shifted = (uint8_t *)malloc( size + 4 );
+	CHECK( shifted != NULL );
+	if ( shifted )
+	{
+		memcpy( shifted + 4, image, size );
+		CHECK( !view_copy( shifted + 4, size, hash ) );
+		free( shifted );
+	}
+
+	// Submesh ranges past the indices or the vertices, or before the first vertex.
+	submesh->range.startIndex = 3;
+	CHECK( !view_copy( copy, size, hash ) );
+	*submesh                  = range;
+	submesh->range.indexCount = (uint32_t)h->indexCount + 3;
+	CHECK( !view_copy( copy, size, hash ) );
+	*submesh                  = range;
+	submesh->range.startIndex = UINT32_MAX - 2; // wraps to 0 in 32 bits
+	submesh->range.indexCount = 3;
+	CHECK( !view_copy( copy, size, hash ) );
+	*submesh                  = range;
+	submesh->range.baseVertex = 1;
+	CHECK( !view_copy( copy, size, hash ) );
+	*submesh                  = range;
+	submesh->range.baseVertex = -1;
+	CHECK( !view_copy( copy, size, hash ) );
+	*submesh = range;
+	CHECK( view_copy( copy, size, hash ) );
+
+	// Section offsets: unaligned, past the end, or leaving too little room for the section.
+	h->vertexOffset += 4;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h             = good;
+	h->indexOffset = h->fileSize + R_MESH_FILE_ALIGNMENT;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h             = good;
+	h->indexOffset = h->fileSize - R_MESH_FILE_ALIGNMENT;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h               = good;
+	h->submeshOffset = h->fileSize;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h             = good;
+	h->vertexCount = UINT64_MAX / h->stride + 1; // wraps when multiplied out
+	CHECK( !view_copy( copy, size, hash ) );
+	*h = good;
+	CHECK( view_copy( copy, size, hash ) );
+
+	// And the rest of the header.
+	h->magic ^= 1;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h = good;
+	h->version++;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h           = good;
+	h->indexSize = 3;
+	CHECK( !view_copy( copy, size, hash ) );
+	*h = good;
+	h->indexCount--;
+	CHECK( !view_copy( copy, size, hash ) );
+	free( copy );
+}
+
+int main( void )
+{
+	static Grid grid;
+	make_grid( &grid );
+
+	uint64_t    hash = r_mesh_file_layout_hash( R_MESH_FILE_LAYOUT_PNT, sizeof( R_MeshFileVertex ) );
+	R_MeshBuild mesh;
+	CHECK( r_mesh_build( grid.vertices,
+	                     ( GRID + 1 ) * ( GRID + 1 ),
+	                     sizeof( R_MeshFileVertex ),
+	                     grid.indices,
+	                     GRID * GRID * 6,
+	                     R_MESH_SPLIT_16,
+	                     &mesh ) );
+
+	size_t size  = 0;
+	void  *image = r_mesh_file_encode( &mesh, grid.vertices, hash, &size );
+	CHECK( image && size % R_MESH_FILE_ALIGNMENT == 0 );
+	if ( image )
+	{
+		test_roundtrip( &mesh, &grid, image, size, hash );
+		test_rejects( image, size, hash );
+	}
+	free( image );
+	r_mesh_build_free( &mesh );
+	return test_report( "test_mesh_file" );
+}
@@ -0,0 +1,283 @@
+//
+// test_mesh_optimize: the index and vertex reordering of r_mesh.h. Whatever
+// order they pick, the cache and overdraw passes hand back the same triangles,
+// each with its winding, as often as they came in; the fetch pass renumbers
+// vertices in order of first use and moves them along, so every triangle still
+// names the same vertex contents in the same order, and drops what nothing
+// references. The meshes are a grid with its triangles shuffled, a sphere in
+// scan order (degenerate triangles at the poles) and a small one with repeated
+// triangles and a vertex nothing uses.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_mesh.c"
+
+typedef struct Vertex
+{
+	float    position[3];
+	uint32_t id; // the vertex's index when the mesh was made
+} Vertex;
+
+typedef struct Mesh
+{
+	Vertex   *vertices;
+	size_t    vertexCount;
+	uint32_t *indices;
+	size_t    indexCount;
+} Mesh;
+
+typedef struct Triangle
+{
+	uint32_t v[3];
+} Triangle;
+
+static uint32_t g_random = 7;
+
+static uint32_t next_random( void )
+{
+	g_random = g_random * 1664525u + 1013904223u;
+	return g_random >> 8;
+}
+
+static bool mesh_alloc( Mesh *mesh, size_t vertexCount, size_t indexCount )
+{
+	mesh->vertices    = (Vertex *)calloc( vertexCount, sizeof( Vertex ) );
+	mesh->indices     = (uint32_t *)malloc( indexCount * sizeof( uint32_t ) );
+	mesh->vertexCount = vertexCount;
+	mesh->indexCount  = indexCount;
+	for ( size_t i = 0; mesh->vertices && i < vertexCount; ++i )
+		mesh->vertices[i].id = (uint32_t)i;
+	return mesh->vertices && mesh->indices;
+}
+
+static void mesh_free( Mesh *mesh )
+{
+	free( mesh->vertices );
+	free( mesh->indices );
+}
+
+static bool make_grid( Mesh *mesh, uint32_t n )
+{
+	if ( !mesh_alloc( mesh, (size_t)n * n, (size_t)( n - 1 ) * ( n - 1 ) * 6 ) )
+		return false;
+	for ( uint32_t i = 0; i < n * n; ++i )
+	{
+		mesh->vertices[i].position[0] = (float)( i % n );
+		mesh->vertices[i].position[1] = (float)( i / n );
+	}
+
+	uint32_t *out = mesh->indices;
+	for ( uint32_t y = 0; y + 1 < n; ++y )
+	{
+		for ( uint32_t x = 0; x + 1 < n; ++x )
+		{
+			uint32_t a = y * n + x, b = a + 1, c = a + n, d = c + 1;
+			*out++     = a;
+			*out++     = c;
+			*out++     = b;
+			*out++     = b;
+			*out++     = c;
+			*out++     = d;
+		}
+	}
+
+	Triangle *triangles = (Triangle *)mesh->indices;
+	for ( size_t t = mesh->indexCount / 3 - 1; t > 0; --t )
+	{
+		size_t   j    = next_random() % ( t + 1 );
+		Triangle swap = triangles[t];
+		triangles[t]  = triangles[j];
+		triangles[j]  = swap;
+	}
+	return true;
+}
+
+static bool make_sphere( Mesh *mesh, uint32_t segments )
+{
+	uint32_t row = segments + 1;
+	if ( !mesh_alloc( mesh, (size_t)row * row, (size_t)segments * segments * 6 ) )
+		return false;
+	for ( uint32_t i = 0; i < row * row; ++i )
+	{
+		float theta                   = 3.14159265f * (float)( i / row ) / (float)segments;
+		float phi                     = 6.28318531f * (float)( i % row ) / (float)segments;
+		mesh->vertices[i].position[0] = sinf( theta ) * cosf( phi );
+		mesh->vertices[i].position[1] = cosf( theta );
+		mesh->vertices[i].position[2] = sinf( theta ) * sinf( phi );
+	}
+
+	uint32_t *out = mesh->indices;
+	for ( uint32_t i = 0; i < segments; ++i )
+	{
+		for ( uint32_t j = 0; j < segments; ++j )
+		{
+			uint32_t a = i * row + j, b = a + 1, c = a + row, d = c + 1;
+			*out++     = a;
+			*out++     = c;
+			*out++     = b;
+			*out++     = b;
+			*out++     = c;
+			*out++     = d;
+		}
+	}
+	return true;
+}
+
+// Two quads sharing an edge, one triangle twice and a vertex (5) nothing uses.
+static bool make_small( Mesh *mesh )
+{
+	static const uint32_t k_indices[] = { 0, 1, 2, 2, 1, 3, 2, 3, 4, 4, 3, 6, 2, 3, 4, 0, 1, 2 };
+	if ( !mesh_alloc( mesh, 7, sizeof( k_indices ) / sizeof( k_indices[0] ) ) )
+		return false;
+	for ( uint32_t i = 0; i < 7; ++i )
+	{
+		mesh->vertices[i].position[0] = (float)( i / 2 );
+		mesh->vertices[i].position[1] = (float)( i % 2 );
+	}
+	memcpy( mesh->indices, k_indices, sizeof( k_indices ) );
+	return true;
+}
+
+static int compare_triangles( const void *a, const void *b )
+{
+	return memcmp( a, b, sizeof( Triangle ) );
+}
+
+// Each triangle by vertex ids, rotated to start at the lowest one, which keeps the winding; then all
+// of them sorted.
+static Triangle *canonical_triangles( const Mesh *mesh )
+{
+	size_t    count     = mesh->indexCount / 3;
+	Triangle *triangles = (Triangle *)malloc( count * sizeof( Triangle ) );
+	if ( !triangles )
+		return NULL;
+	for ( size_t t = 0; t < count; ++t )
+	{
+		uint32_t v[3];
+		for ( uint32_t c = 0; c < 3; ++c )
+			v[c] = mesh->vertices[mesh->indices[t * 3 + c]].id;
+		uint32_t first = v[1] < v[0] ? ( v[2] < v[1] ? 2 : 1 ) : ( v[2] < v[0] ? 2 : 0 );
+		for ( uint32_t c = 0; c < 3; ++c )
+			triangles[t].v[c] = v[( first + c ) % 3];
+	}
+	qsort( triangles, count, sizeof( Triangle ), compare_triangles );
+	return triangles;
+}
+
+static bool same_triangles( const Triangle *before, const Mesh *mesh )
+{
+	Triangle *after = canonical_triangles( mesh );
+	bool      same  = before && after && memcmp( before, after, mesh->indexCount / 3 * sizeof( Triangle ) ) == 0;
+	free( after );
+	return same;
+}
+
+static float acmr( const Mesh *mesh )
+{
+	const uint32_t  *indices  = mesh->indices;
+	size_t           count    = mesh->indexCount;
+	size_t           vertices = mesh->vertexCount;
+	R_MeshCacheStats stats    = r_mesh_analyze_vertex_cache( indices, count, vertices, R_MESH_ANALYZE_CACHE_SIZE );
+	return stats.acmr;
+}
+
+static void test_optimizers( Mesh *mesh, bool reordered )
+{
+	Triangle *original = canonical_triangles( mesh );
+	float     start    = acmr( mesh );
+
+	CHECK( r_mesh_optimize_vertex_cache( mesh->indices, mesh->indexCount, mesh->vertexCount ) );
+	CHECK( same_triangles( original, mesh ) );
+	float cached = acmr( mesh );
+	CHECK( reordered ? cached < start * 0.5f : cached <= start );
+
+	// Allowed to give back at most 5% of the cache order.
+	CHECK( r_mesh_optimize_overdraw( mesh->indices,
+	                                 mesh->indexCount,
+	                                 mesh->vertices,
+	                                 mesh->vertexCount,
+	                                 sizeof( Vertex ),
+	                                 1.05f ) );
+	CHECK( same_triangles( original, mesh ) );
+	CHECK( acmr( mesh ) <= cached * 1.05f + 1e-4f );
+
+	// The fetch pass keeps the triangle order too: compare the vertex ids corner by corner.
+	uint32_t *corners = (uint32_t *)malloc( mesh->indexCount * sizeof( uint32_t ) );
+	for ( size_t i = 0; corners && i < mesh->indexCount; ++i )
+		corners[i] = mesh->vertices[mesh->indices[i]].id;
+
+	size_t used = r_mesh_optimize_vertex_fetch( mesh->vertices,
+	                                            mesh->vertexCount,
+	                                            sizeof( Vertex ),
+	                                            mesh->indices,
+	                                            mesh->indexCount );
+	CHECK( used > 0 && used <= mesh->vertexCount );
+	mesh->vertexCount = used ? used : mesh->vertexCount;
+
+	bool     ordered = corners != NULL;
+	uint32_t next    = 0;
+	for ( size_t i = 0; ordered && i < mesh->indexCount; ++i )
+	{
+		uint32_t index = mesh->indices[i];
+		ordered        = index <= next && mesh->vertices[index].id == corners[i];
+		next += index == next;
+	}
+	CHECK( ordered && next == used );
+	CHECK( same_triangles( original, mesh ) );
+
+	free( corners );
+	free( original );
+}
+
+static void test_meshes( void )
+{
+	Mesh mesh;
+	CHECK( make_grid( &mesh, 40 ) );
+	test_optimizers( &mesh, true );
+	mesh_free( &mesh );
+
+	CHECK( make_sphere( &mesh, 24 ) );
+	test_optimizers( &mesh, false );
+	mesh_free( &mesh );
+
+	CHECK( make_small( &mesh ) );
+	test_optimizers( &mesh, false );
+	CHECK( mesh.vertexCount == 6 );
+	mesh_free( &mesh );
+}
+
+static void test_bad_input( void )
+{
+	Mesh mesh;
+	CHECK( make_small( &mesh ) );
+
+	// An index out of range or a partial triangle is refused and the indices stay as they were.
+	uint32_t before[18];
+	mesh.indices[4] = 7;
+	memcpy( before, mesh.indices, sizeof( before ) );
+	CHECK( !r_mesh_optimize_vertex_cache( mesh.indices, mesh.indexCount, mesh.vertexCount ) );
+	CHECK( !r_mesh_optimize_overdraw( mesh.indices, mesh.indexCount, mesh.vertices, 7, sizeof( Vertex ), 1.05f ) );
+	CHECK( r_mesh_optimize_vertex_fetch( mesh.vertices, 7, sizeof( Vertex ), mesh.indices, mesh.indexCount ) == 0 );
+	CHECK( memcmp( before, mesh.indices, sizeof( before ) ) == 0 );
+	mesh.indices[4] = 1;
+	CHECK( !r_mesh_optimize_vertex_cache( mesh.indices, 17, mesh.vertexCount ) );
+	CHECK( !r_mesh_optimize_overdraw( mesh.indices, 17, mesh.vertices, 7, sizeof( Vertex ), 1.05f ) );
+
+	// Nothing to reorder is fine.
+	CHECK( r_mesh_optimize_vertex_cache( mesh.indices, 0, mesh.vertexCount ) );
+	CHECK( r_mesh_optimize_overdraw( mesh.indices, 3, mesh.vertices, 7, sizeof( Vertex ), 1.05f ) );
+	mesh_free( &mesh );
+}
+
+int main( void )
+{
+	test_meshes();
+	test_bad_input();
+	return test_report( "test_mesh_optimize" );
+}
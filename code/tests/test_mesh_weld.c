@@ -0,0 +1,173 @@
+//
+// test_mesh_weld: vertex welding (r_mesh_weld in r_mesh.h). A grid handed out
+// as a triangle soup, one vertex per corner the way the OBJ path does, welds
+// down to one vertex per grid point; every corner's index then points at a
+// vertex with exactly its contents, so each triangle keeps its positions. The
+// same soup with a normal, a texcoord or a position changed by one bit at some
+// corners keeps those corners apart, and so does -0.0 against 0.0. Welding in
+// place gives the same result, and strides that aren't whole words work too.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_mesh.c"
+
+#define GRID 32 // quads per side
+#define CORNERS ( GRID * GRID * 6 )
+#define POINTS ( ( GRID + 1 ) * ( GRID + 1 ) )
+
+typedef struct Vertex
+{
+	float position[3];
+	float normal[3];
+	float uv[2];
+} Vertex;
+
+static Vertex grid_point( uint32_t p )
+{
+	Vertex v;
+	memset( &v, 0, sizeof( v ) );
+	v.position[0] = (float)( p % ( GRID + 1 ) );
+	v.position[2] = (float)( p / ( GRID + 1 ) );
+	v.normal[1]   = 1.0f;
+	v.uv[0]       = v.position[0] / GRID;
+	v.uv[1]       = v.position[2] / GRID;
+	return v;
+}
+
+// The soup, and for every corner the grid point it came from.
+static void make_soup( Vertex *soup, uint32_t *points )
+{
+	uint32_t n = 0;
+	for ( uint32_t y = 0; y < GRID; ++y )
+	{
+		for ( uint32_t x = 0; x < GRID; ++x )
+		{
+			uint32_t a = y * ( GRID + 1 ) + x, b = a + 1, c = a + GRID + 1, d = c + 1;
+			uint32_t quad[6] = { a, c, b, b, c, d };
+			for ( int i = 0; i < 6; ++i )
+			{
+				points[n] = quad[i];
+				soup[n++] = grid_point( quad[i] );
+			}
+		}
+	}
+}
+
+// Every corner's index names a vertex with its contents, and distinct vertices really are distinct.
+static bool check_weld( const Vertex *soup, const Vertex *welded, const uint32_t *indices, size_t count, size_t unique )
+{
+	for ( size_t i = 0; i < count; ++i )
+	{
+		if ( indices[i] >= unique || memcmp( &welded[indices[i]], &soup[i], sizeof( Vertex ) ) != 0 )
+			return false;
+	}
+	for ( size_t i = 0; i < unique; ++i )
+	{
+		for ( size_t j = i + 1; j < unique; ++j )
+		{
+			if ( memcmp( &welded[i], &welded[j], sizeof( Vertex ) ) == 0 )
+				return false;
+		}
+	}
+	return true;
+}
+
+static void test_grid( void )
+{
+	static Vertex   soup[CORNERS], welded[CORNERS];
+	static uint32_t points[CORNERS], indices[CORNERS];
+	make_soup( soup, points );
+
+	R_MeshWeldStats stats;
+	size_t          unique = r_mesh_weld( soup, CORNERS, sizeof( Vertex ), welded, indices, &stats );
+	CHECK( unique == POINTS );
+	CHECK( check_weld( soup, welded, indices, CORNERS, unique ) );
+
+	// Corners from the same grid point share an index, in order of first use.
+	bool     shared = true;
+	uint32_t first[POINTS];
+	memset( first, 0xFF, sizeof( first ) );
+	for ( size_t i = 0; i < CORNERS; ++i )
+	{
+		if ( first[points[i]] == UINT32_MAX )
+			first[points[i]] = indices[i];
+		shared = shared && first[points[i]] == indices[i];
+	}
+	CHECK( shared && indices[0] == 0 && indices[1] == 1 && indices[2] == 2 && indices[3] == 2 );
+
+	CHECK( stats.inputVertices == CORNERS && stats.outputVertices == POINTS );
+	CHECK( stats.inputBytes == CORNERS * sizeof( Vertex ) );
+	CHECK( stats.outputBytes == POINTS * sizeof( Vertex ) + CORNERS * sizeof( uint32_t ) );
+	CHECK( r_mesh_weld_ratio( &stats ) > 3.0 );
+
+	// In place: the same vertices and indices.
+	static Vertex   inPlace[CORNERS];
+	static uint32_t inPlaceIndices[CORNERS];
+	memcpy( inPlace, soup, sizeof( soup ) );
+	CHECK( r_mesh_weld( inPlace, CORNERS, sizeof( Vertex ), inPlace, inPlaceIndices, NULL ) == POINTS );
+	CHECK( memcmp( inPlace, welded, POINTS * sizeof( Vertex ) ) == 0 );
+	CHECK( memcmp( inPlaceIndices, indices, sizeof( indices ) ) == 0 );
+}
+
+static void test_attributes( void )
+{
+	static Vertex   soup[CORNERS], welded[CORNERS];
+	static uint32_t points[CORNERS], indices[CORNERS];
+	make_soup( soup, points );
+
+	// One corner each: a tilted normal, a texcoord seam, a position one bit off, a negative zero.
+	// Each was a grid point shared with other corners, so each adds one vertex.
+	size_t changed[4] = { 7, 100, 2000, CORNERS - 2 };
+	soup[changed[0]].normal[0] = 0.5f;
+	soup[changed[1]].uv[0] += 1.0f;
+	uint32_t bits;
+	memcpy( &bits, &soup[changed[2]].position[1], sizeof( bits ) );
+	bits ^= 1;
+	memcpy( &soup[changed[2]].position[1], &bits, sizeof( bits ) );
+	soup[changed[3]].normal[2] = -0.0f;
+
+	size_t unique = r_mesh_weld( soup, CORNERS, sizeof( Vertex ), welded, indices, NULL );
+	CHECK( unique == POINTS + 4 );
+	CHECK( check_weld( soup, welded, indices, CORNERS, unique ) );
+
+	// The changed corners have vertices of their own.
+	for ( int c = 0; c < 4; ++c )
+	{
+		bool alone = true;
+		for ( size_t i = 0; i < CORNERS; ++i )
+			alone = alone && ( i == changed[c] || indices[i] != indices[changed[c]] );
+		CHECK( alone );
+	}
+}
+
+// Strides that aren't whole words are hashed byte by byte.
+static void test_odd_stride( void )
+{
+	static const uint8_t k_soup[6][7] = {
+	    { 1, 2, 3, 4, 5, 6, 7 }, { 1, 2, 3, 4, 5, 6, 8 }, { 1, 2, 3, 4, 5, 6, 7 },
+	    { 0, 2, 3, 4, 5, 6, 7 }, { 1, 2, 3, 4, 5, 6, 8 }, { 1, 2, 3, 4, 5, 6, 7 },
+	};
+	uint8_t  welded[6][7];
+	uint32_t indices[6];
+	CHECK( r_mesh_weld( k_soup, 6, 7, welded, indices, NULL ) == 3 );
+	CHECK( indices[0] == 0 && indices[1] == 1 && indices[2] == 0 && indices[3] == 2 && indices[4] == 1 );
+	CHECK( indices[5] == 0 && memcmp( welded[2], k_soup[3], 7 ) == 0 );
+
+	// Nothing to weld, or nowhere to write it.
+	CHECK( r_mesh_weld( k_soup, 0, 7, welded, indices, NULL ) == 0 );
+	CHECK( r_mesh_weld( k_soup, 6, 0, welded, indices, NULL ) == 0 );
+	CHECK( r_mesh_weld( k_soup, 6, 7, NULL, indices, NULL ) == 0 );
+}
+
+int main( void )
+{
+	test_grid();
+	test_attributes();
+	test_odd_stride();
+	return test_report( "test_mesh_weld" );
+}
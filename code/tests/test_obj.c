@@ -0,0 +1,258 @@
+//
+// test_obj: the parallel OBJ reader (r_obj.h) against a generated file whose
+// every element and triangle is known. Quads come with their own positions,
+// texcoords and normal, their faces in absolute, relative and v//vn form, and
+// every fifth one adds a triangle reaching back into the quad before; the file
+// has no newline after its last face. A comment in front of it moves the cut
+// between two chunks onto chosen line breaks: right before faces whose
+// relative indices point into the chunk before, and with CRLF line breaks onto
+// the \r. Every number of threads has to give the same mesh. Indices outside
+// the file are refused.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_obj.c"
+
+typedef struct Text
+{
+	char  *data;
+	size_t size;
+	size_t capacity;
+} Text;
+
+typedef struct Expected
+{
+	R_ObjCorner *corners;
+	size_t       cornerCount;
+	size_t       quads;
+} Expected;
+
+static void text_printf( Text *text, const char *format, ... )
+{
+	if ( text->capacity - text->size < 256 )
+	{
+		size_t capacity = text->capacity ? text->capacity * 2 : 1 << 16;
+		char  *data     = (char *)realloc( text->data, capacity );
+		if ( !data )
+			abort();
+		text->data     = data;
+		text->capacity = capacity;
+	}
+	va_list args;
+	va_start( args, format );
+	text->size += (size_t)vsnprintf( text->data + text->size, text->capacity - text->size, format, args );
+	va_end( args );
+}
+
+static void expect( Expected *e, int32_t position, int32_t texcoord, int32_t normal )
+{
+	e->corners[e->cornerCount++] = ( R_ObjCorner ){ position, texcoord, normal };
+}
+
+static void expect_quad( Expected *e, int32_t p, int32_t t, int32_t n )
+{
+	static const int k_fan[6] = { 0, 1, 2, 0, 2, 3 };
+	for ( int i = 0; i < 6; ++i )
+		expect( e, p + k_fan[i], t < 0 ? -1 : t + k_fan[i], n );
+}
+
+// Quad q has positions (q, k + 0.5, -(q % 7)), texcoords (k / 4, q % 2) and normal (0, 0, q).
+static void make_file( Text *text, Expected *e, size_t quads, const char *eol )
+{
+	e->corners     = (R_ObjCorner *)malloc( quads * 9 * sizeof( R_ObjCorner ) );
+	e->cornerCount = 0;
+	e->quads       = quads;
+	if ( !e->corners )
+		abort();
+
+	for ( size_t q = 0; q < quads; ++q )
+	{
+		unsigned u = (unsigned)q;
+		for ( unsigned k = 0; k < 4; ++k )
+			text_printf( text, "v %u %u.5 -%u%s", u, k, u % 7, eol );
+		for ( unsigned k = 0; k < 4; ++k )
+			text_printf( text, "vt %g %u%s", k / 4.0, u % 2, eol );
+		text_printf( text, "vn 0 0 %u%s", u, eol );
+
+		unsigned p = 4 * u + 1, n = u + 1;
+		if ( q % 3 == 0 )
+			text_printf( text, "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1" );
+		else if ( q % 3 == 1 )
+		{
+			text_printf( text, "f %u/%u/%u %u/%u/%u", p, p, n, p + 1, p + 1, n );
+			text_printf( text, " %u/%u/%u %u/%u/%u", p + 2, p + 2, n, p + 3, p + 3, n );
+		}
+		else
+			text_printf( text, "f -4//-1  -3//-1\t-2//-1 -1//-1" );
+		expect_quad( e, (int32_t)( 4 * q ), q % 3 == 2 ? -1 : (int32_t)( 4 * q ), (int32_t)q );
+
+		if ( q % 5 == 4 )
+		{
+			text_printf( text, "%sf -8 -4 -1", eol );
+			expect( e, (int32_t)( 4 * q - 4 ), -1, -1 );
+			expect( e, (int32_t)( 4 * q ), -1, -1 );
+			expect( e, (int32_t)( 4 * q + 3 ), -1, -1 );
+		}
+		if ( q + 1 < quads )
+			text_printf( text, "%s", eol );
+	}
+}
+
+static bool mesh_matches( const R_ObjMesh *mesh, const Expected *e )
+{
+	if ( mesh->positionCount != 4 * e->quads || mesh->texcoordCount != 4 * e->quads || mesh->normalCount != e->quads )
+		return false;
+	if ( mesh->cornerCount != e->cornerCount ||
+	     memcmp( mesh->corners, e->corners, e->cornerCount * sizeof( R_ObjCorner ) ) != 0 )
+		return false;
+
+	bool ok = true;
+	for ( size_t q = 0; q < e->quads && ok; ++q )
+	{
+		for ( size_t k = 0; k < 4 && ok; ++k )
+		{
+			const float *p = &mesh->positions[3 * ( 4 * q + k )];
+			const float *t = &mesh->texcoords[2 * ( 4 * q + k )];
+			ok             = p[0] == (float)q && p[1] == (float)k + 0.5f && p[2] == -(float)( q % 7 );
+			ok             = ok && t[0] == (float)k / 4.0f && t[1] == (float)( q % 2 );
+		}
+		const float *n = &mesh->normals[3 * q];
+		ok             = ok && n[0] == 0.0f && n[1] == 0.0f && n[2] == (float)q;
+	}
+	return ok;
+}
+
+// A comment line in front of the body, as long as it takes for the middle of the file, where two
+// chunks are cut, to fall on the body's byte at cut.
+static size_t pad_to_cut( char *data, const Text *body, size_t cut )
+{
+	size_t pad = body->size - 2 * cut;
+	data[0]    = '#';
+	memset( data + 1, 'x', pad - 2 );
+	data[pad - 1] = '\n';
+	memcpy( data + pad, body->data, body->size );
+	return pad + body->size;
+}
+
+// Two chunks, cut on line breaks near the middle: before faces whose relative indices point into the
+// first chunk, and with CRLF, on the \r. Then the file as it is, on one thread and on two.
+static void test_cuts( const char *eol )
+{
+	Text     body = { 0 };
+	Expected e;
+	make_file( &body, &e, 3200, eol );
+	char *data = (char *)malloc( 2 * body.size );
+	if ( !data )
+		abort();
+
+	bool ok           = true;
+	int  relativeCuts = 0, crCuts = 0;
+	for ( size_t cut = body.size / 2 - 8000; cut < body.size / 2 - 100 && relativeCuts < 40; ++cut )
+	{
+		const char *next      = (const char *)memchr( body.data + cut, '\n', body.size - cut ) + 1;
+		bool        lineBreak = body.data[cut] == '\n' || body.data[cut] == '\r';
+		if ( !lineBreak || strncmp( next, "f -", 3 ) != 0 )
+			continue;
+
+		size_t    size = pad_to_cut( data, &body, cut );
+		R_ObjMesh mesh;
+		ok = ok && data[size / 2] == body.data[cut];
+		ok = ok && r_obj_parse( data, size, 2, &mesh ) && mesh.threads == 2 && mesh_matches( &mesh, &e );
+		r_obj_free( &mesh );
+		relativeCuts++;
+		crCuts += body.data[cut] == '\r';
+	}
+	CHECK( ok && relativeCuts == 40 && ( crCuts > 0 ) == ( eol[0] == '\r' ) );
+
+	static const uint32_t k_threads[] = { 1, 2 };
+	for ( size_t i = 0; i < sizeof( k_threads ) / sizeof( k_threads[0] ); ++i )
+	{
+		R_ObjMesh mesh;
+		CHECK( r_obj_parse( body.data, body.size, k_threads[i], &mesh ) && mesh.threads == k_threads[i] );
+		CHECK( mesh_matches( &mesh, &e ) );
+		r_obj_free( &mesh );
+	}
+
+	free( data );
+	free( body.data );
+	free( e.corners );
+}
+
+static void test_many_threads( void )
+{
+	// Enough for 16 chunks of R_OBJ_MIN_CHUNK_BYTES.
+	Text     body = { 0 };
+	Expected e;
+	make_file( &body, &e, 30000, "\r\n" );
+	CHECK( body.size > 16 * R_OBJ_MIN_CHUNK_BYTES );
+
+	static const uint32_t k_threads[] = { 4, 7, 16 };
+	for ( size_t i = 0; i < sizeof( k_threads ) / sizeof( k_threads[0] ); ++i )
+	{
+		R_ObjMesh mesh;
+		CHECK( r_obj_parse( body.data, body.size, k_threads[i], &mesh ) && mesh.threads == k_threads[i] );
+		CHECK( mesh_matches( &mesh, &e ) );
+		r_obj_free( &mesh );
+	}
+	free( body.data );
+	free( e.corners );
+}
+
+static bool parses( const char *text, uint32_t threads, size_t *outCorners )
+{
+	R_ObjMesh mesh;
+	bool      ok = r_obj_parse( text, strlen( text ), threads, &mesh );
+	*outCorners  = mesh.cornerCount;
+	r_obj_free( &mesh );
+	return ok;
+}
+
+static void test_small( void )
+{
+	size_t corners = 0;
+
+	// No newline at the end, and a last line ending on a bare \r.
+	CHECK( parses( "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3", 1, &corners ) && corners == 3 );
+	CHECK( parses( "v 0 0 0\r\nv 1 0 0\r\nv 0 1 0\r\nf -3 -2 -1\r", 1, &corners ) && corners == 3 );
+	CHECK( parses( "", 1, &corners ) && corners == 0 );
+
+	// Cuts inside a last line without a newline: the chunk they fall in takes the line whole, the ones
+	// after it are empty. A file this small would get one thread, whatever was asked for.
+	const char *lines = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1";
+	size_t      size  = 2 * R_OBJ_MIN_CHUNK_BYTES + 64;
+	char       *text  = (char *)malloc( size );
+	R_ObjMesh   mesh;
+	if ( text )
+	{
+		memset( text, ' ', size );
+		memcpy( text, lines, strlen( lines ) );
+		CHECK( r_obj_parse( text, size, 3, &mesh ) && mesh.threads == 3 && mesh.cornerCount == 3 );
+		CHECK( mesh.corners[0].position == 0 && mesh.corners[2].position == 2 );
+		r_obj_free( &mesh );
+		CHECK( r_obj_parse( text, strlen( lines ), 16, &mesh ) && mesh.threads == 1 && mesh.cornerCount == 3 );
+		r_obj_free( &mesh );
+		free( text );
+	}
+
+	// Indices outside what the file declares, absolute or relative, and index 0.
+	CHECK( !parses( "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n", 1, &corners ) && corners == 0 );
+	CHECK( !parses( "v 0 0 0\nv 1 0 0\nf -3 -2 -1\nv 0 1 0\n", 1, &corners ) );
+	CHECK( !parses( "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n", 1, &corners ) );
+	CHECK( !parses( "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1 2/1 3/1\n", 1, &corners ) );
+}
+
+int main( void )
+{
+	test_cuts( "\n" );
+	test_cuts( "\r\n" );
+	test_many_threads();
+	test_small();
+	return test_report( "test_obj" );
+}
@@ -0,0 +1,253 @@
+//
+// test_offset_alloc: the TLSF offset allocator (r_offset_alloc.h) against a
+// reference map of which allocation owns each unit. Random allocations and
+// frees never hand out a unit twice, the regions always tile the range with
+// no two free ones next to each other, a failed allocation really had no
+// region big enough, and freeing everything gives back one region. Also the
+// defragmentation move r_move_mesh_range makes: allocate again, keep the new
+// range only if it is lower.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_offset_alloc.c"
+
+#define UNITS ( 1u << 16 )
+#define MAX_ALLOCS 512
+
+static uint16_t g_owner[UNITS]; // allocation slot + 1, 0 for free units
+
+typedef struct Live
+{
+	R_OffsetAllocation allocation;
+	uint32_t           size;
+} Live;
+
+static bool range_is( uint32_t offset, uint32_t size, uint16_t owner )
+{
+	for ( uint32_t i = offset; i < offset + size; ++i )
+		if ( g_owner[i] != owner )
+			return false;
+	return true;
+}
+
+static uint32_t largest_free_run( void )
+{
+	uint32_t largest = 0, run = 0;
+	for ( uint32_t i = 0; i < UNITS; ++i )
+	{
+		run     = g_owner[i] ? 0 : run + 1;
+		largest = run > largest ? run : largest;
+	}
+	return largest;
+}
+
+// Walks the regions in address order from the first and checks them against the reference.
+static bool regions_valid( const R_OffsetAllocator *a )
+{
+	bool *unused = (bool *)calloc( a->nodeCount, sizeof( bool ) );
+	if ( !unused )
+		return false;
+	for ( uint32_t i = 0; i < a->freeNodeCount; ++i )
+		unused[a->freeNodes[i]] = true;
+
+	uint32_t first = R_OFFSET_ALLOC_NONE;
+	for ( uint32_t i = 0; i < a->nodeCount && first == R_OFFSET_ALLOC_NONE; ++i )
+		if ( !unused[i] && a->nodes[i].offset == 0 && a->nodes[i].neighborPrev == R_OFFSET_ALLOC_NONE )
+			first = i;
+
+	bool     ok        = first != R_OFFSET_ALLOC_NONE;
+	uint32_t offset    = 0;
+	uint32_t freeUnits = 0;
+	bool     lastFree  = false;
+	for ( uint32_t i = first; ok && i != R_OFFSET_ALLOC_NONE; i = a->nodes[i].neighborNext )
+	{
+		const R_OffsetNode *node = &a->nodes[i];
+		ok = !unused[i] && node->offset == offset && node->size > 0;
+		ok = ok && !( lastFree && !node->used ); // coalesced
+		ok = ok && ( node->used ? g_owner[offset] != 0 : range_is( offset, node->size, 0 ) );
+		if ( !node->used )
+			freeUnits += node->size;
+		lastFree = !node->used;
+		offset += node->size;
+	}
+	free( unused );
+	return ok && offset == a->size && freeUnits == a->freeStorage;
+}
+
+static void test_fuzz( void )
+{
+	R_OffsetAllocator a;
+	CHECK( r_offset_alloc_init( &a, UNITS, MAX_ALLOCS ) );
+	memset( g_owner, 0, sizeof( g_owner ) );
+
+	static Live live[MAX_ALLOCS];
+	uint32_t    liveCount = 0;
+	uint32_t    used      = 0;
+	uint32_t    failures  = 0;
+	bool        ok        = true;
+	srand( 11 );
+	for ( int op = 0; op < 300000 && ok; ++op )
+	{
+		bool grow = liveCount == 0 || ( liveCount < MAX_ALLOCS && rand() % 100 < 52 );
+		if ( grow )
+		{
+			// Mostly small, sometimes big, so the heap fills up and fragments.
+			uint32_t size = rand() % 8 ? 1 + (uint32_t)rand() % 300 : 1 + (uint32_t)rand() % 6000;
+
+			R_OffsetAllocation allocation = r_offset_alloc( &a, size );
+			if ( allocation.offset == R_OFFSET_ALLOC_NONE )
+			{
+				// No region in a bin that guarantees the size: every free run is shorter than that bin.
+				uint32_t guaranteed = r_offset_bin_size( r_offset_bin_round_up( size ) );
+				ok                  = largest_free_run() < guaranteed;
+				failures++;
+				continue;
+			}
+
+			ok = allocation.offset + size <= UNITS && range_is( allocation.offset, size, 0 );
+			ok = ok && r_offset_alloc_size( &a, allocation ) == size;
+			for ( uint32_t i = allocation.offset; i < allocation.offset + size; ++i )
+				g_owner[i] = (uint16_t)( liveCount + 1 );
+			live[liveCount++] = ( Live ){ allocation, size };
+			used += size;
+		}
+		else
+		{
+			// Swap-remove; the owner ids of the moved slot are rewritten.
+			uint32_t i    = (uint32_t)rand() % liveCount;
+			Live     gone = live[i];
+			ok            = range_is( gone.allocation.offset, gone.size, (uint16_t)( i + 1 ) );
+			r_offset_free( &a, gone.allocation );
+			memset( g_owner + gone.allocation.offset, 0, gone.size * sizeof( uint16_t ) );
+			used -= gone.size;
+
+			live[i] = live[--liveCount];
+			if ( i != liveCount )
+				for ( uint32_t u = live[i].allocation.offset; u < live[i].allocation.offset + live[i].size; ++u )
+					g_owner[u] = (uint16_t)( i + 1 );
+		}
+
+		ok = ok && a.allocCount == liveCount && a.freeStorage == UNITS - used;
+		if ( op % 997 == 0 )
+			ok = ok && regions_valid( &a );
+	}
+	CHECK( ok );
+	CHECK( failures > 100 ); // the heap did run full
+
+	// A stale free is ignored.
+	Live gone = live[0];
+	r_offset_free( &a, gone.allocation );
+	memset( g_owner + gone.allocation.offset, 0, gone.size * sizeof( uint16_t ) );
+	r_offset_free( &a, gone.allocation );
+	CHECK( a.allocCount == liveCount - 1 && regions_valid( &a ) );
+
+	for ( uint32_t i = 1; i < liveCount; ++i )
+	{
+		r_offset_free( &a, live[i].allocation );
+		memset( g_owner + live[i].allocation.offset, 0, live[i].size * sizeof( uint16_t ) );
+	}
+	R_OffsetAllocStats stats;
+	r_offset_alloc_get_stats( &a, &stats );
+	CHECK( stats.allocCount == 0 && stats.freeStorage == UNITS && stats.freeRegions == 1 );
+	CHECK( stats.largestFree == UNITS && regions_valid( &a ) );
+	r_offset_alloc_free( &a );
+}
+
+static void test_limits( void )
+{
+	R_OffsetAllocator a;
+	CHECK( !r_offset_alloc_init( &a, 0, 4 ) && !r_offset_alloc_init( &a, 100, 0 ) );
+	CHECK( r_offset_alloc_init( &a, 128, 3 ) );
+
+	CHECK( r_offset_alloc( &a, 0 ).offset == R_OFFSET_ALLOC_NONE );
+	CHECK( r_offset_alloc( &a, 129 ).offset == R_OFFSET_ALLOC_NONE );
+	R_OffsetAllocation all = r_offset_alloc( &a, 128 );
+	CHECK( all.offset == 0 && a.freeStorage == 0 );
+	CHECK( r_offset_alloc( &a, 1 ).offset == R_OFFSET_ALLOC_NONE );
+	r_offset_free( &a, all );
+
+	// Requests are served from bins whose every region fits: 100 units round up to the 104 bin, which
+	// a free region of exactly 100 isn't in.
+	all = r_offset_alloc( &a, 28 );
+	CHECK( all.offset == 0 && r_offset_alloc( &a, 100 ).offset == R_OFFSET_ALLOC_NONE );
+	CHECK( r_offset_alloc( &a, 96 ).offset == 28 );
+	r_offset_alloc_reset( &a );
+
+	// maxAllocs is a hard limit, however much room is left.
+	R_OffsetAllocation first = r_offset_alloc( &a, 1 );
+	r_offset_alloc( &a, 1 );
+	r_offset_alloc( &a, 1 );
+	CHECK( first.offset == 0 && r_offset_alloc( &a, 1 ).offset == R_OFFSET_ALLOC_NONE );
+
+	r_offset_alloc_reset( &a );
+	CHECK( a.allocCount == 0 && a.freeStorage == 128 );
+	CHECK( r_offset_alloc( &a, 128 ).offset == 0 );
+	r_offset_alloc_free( &a );
+}
+
+// r_move_mesh_range without the copy: a range moves only to a lower offset.
+static bool move_down( R_OffsetAllocator *a, R_OffsetAllocation *range, uint32_t size )
+{
+	R_OffsetAllocation moved = r_offset_alloc( a, size );
+	if ( moved.offset == R_OFFSET_ALLOC_NONE )
+		return false;
+	if ( moved.offset >= range->offset )
+	{
+		r_offset_free( a, moved );
+		return false;
+	}
+	r_offset_free( a, *range );
+	*range = moved;
+	return true;
+}
+
+static void test_compaction( void )
+{
+	R_OffsetAllocator a;
+	CHECK( r_offset_alloc_init( &a, UNITS, MAX_ALLOCS ) );
+
+	// A full heap with the lower half freed again.
+	static R_OffsetAllocation blocks[MAX_ALLOCS];
+	for ( uint32_t i = 0; i < MAX_ALLOCS; ++i )
+		blocks[i] = r_offset_alloc( &a, 128 );
+	for ( uint32_t i = 0; i < MAX_ALLOCS / 2; ++i )
+		r_offset_free( &a, blocks[i] );
+
+	R_OffsetAllocStats before;
+	r_offset_alloc_get_stats( &a, &before );
+	CHECK( before.freeRegions == 1 && before.freeStorage == UNITS / 2 );
+
+	// Each block takes the front of the hole, its old range joins the hole behind it.
+	uint32_t moves = 0;
+	for ( uint32_t i = MAX_ALLOCS / 2; i < MAX_ALLOCS; ++i )
+		moves += move_down( &a, &blocks[i], 128 );
+	bool packed = true;
+	for ( uint32_t i = MAX_ALLOCS / 2; i < MAX_ALLOCS; ++i )
+		packed = packed && blocks[i].offset == ( i - MAX_ALLOCS / 2 ) * 128;
+	CHECK( moves == MAX_ALLOCS / 2 && packed );
+
+	R_OffsetAllocStats after;
+	r_offset_alloc_get_stats( &a, &after );
+	CHECK( after.freeRegions == 1 && after.freeStorage == before.freeStorage && after.allocCount == MAX_ALLOCS / 2 );
+
+	// A hole above is handed back and the block stays; one below is taken.
+	r_offset_free( &a, blocks[MAX_ALLOCS - 2] );
+	R_OffsetAllocation stays = blocks[MAX_ALLOCS / 2];
+	CHECK( !move_down( &a, &blocks[MAX_ALLOCS / 2], 128 ) && blocks[MAX_ALLOCS / 2].offset == stays.offset );
+	r_offset_free( &a, blocks[MAX_ALLOCS / 2] );
+	CHECK( move_down( &a, &blocks[MAX_ALLOCS / 2 + 1], 128 ) && blocks[MAX_ALLOCS / 2 + 1].offset == 0 );
+	CHECK( a.allocCount == MAX_ALLOCS / 2 - 2 );
+	r_offset_alloc_free( &a );
+}
+
+int main( void )
+{
+	test_fuzz();
+	test_limits();
+	test_compaction();
+	return test_report( "test_offset_alloc" );
+}
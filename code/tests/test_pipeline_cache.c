@@ -0,0 +1,178 @@
+//
+// test_pipeline_cache: pipeline descriptors are deduplicated by hash. Checks
+// the hash map behind every cache (r_hash.h) against a plain array, then that
+// the headless backend, which shares pipelines the way the D3D11 one does,
+// returns one reference counted pipeline per distinct descriptor and only
+// re-issues the components that differ when switching between two of them.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/backend/headless/r_headless.c"
+
+static void test_hash( void )
+{
+	const char text[] = "float3 POSITION";
+	CHECK( r_hash_bytes( text, 6, R_HASH_SEED ) == r_hash_bytes( text, 6, R_HASH_SEED ) );
+	CHECK( r_hash_bytes( text, 6, R_HASH_SEED ) != r_hash_bytes( text, 7, R_HASH_SEED ) );
+	CHECK( r_hash_string( text, R_HASH_SEED ) == r_hash_bytes( text, strlen( text ), R_HASH_SEED ) );
+
+	// Chaining is the same as hashing the concatenation.
+	uint64_t chained = r_hash_bytes( text + 6, sizeof( text ) - 7, r_hash_bytes( text, 6, R_HASH_SEED ) );
+	CHECK( chained == r_hash_bytes( text, sizeof( text ) - 1, R_HASH_SEED ) );
+}
+
+// Random puts, overwrites and removes, mirrored in an array indexed by key.
+static void test_hash_map( void )
+{
+	enum
+	{
+		KEYS = 5000,
+		OPS  = 200000,
+	};
+	static uint32_t expected[KEYS];
+	static bool     present[KEYS];
+	R_HashMap       map;
+	CHECK( r_hash_map_init( &map, 4 ) );
+
+	uint64_t seed = 7;
+	bool     ok   = true;
+	for ( int op = 0; op < OPS && ok; ++op )
+	{
+		seed           = seed * 6364136223846793005ull + 1442695040888963407ull;
+		uint32_t k     = (uint32_t)( seed >> 33 ) % KEYS;
+		uint64_t key   = (uint64_t)k * 0x9E3779B97F4A7C15ull; // keys share low bits, probes collide
+		uint32_t value = (uint32_t)op;
+		uint32_t got   = 0;
+		switch ( ( seed >> 60 ) % 3 )
+		{
+		case 0:
+			ok          = r_hash_map_put( &map, key, value );
+			expected[k] = value;
+			present[k]  = true;
+			break;
+		case 1:
+			ok         = r_hash_map_remove( &map, key ) == present[k];
+			present[k] = false;
+			break;
+		default:
+			ok = r_hash_map_get( &map, key, &got ) == present[k] && ( !present[k] || got == expected[k] );
+			break;
+		}
+	}
+	CHECK( ok );
+
+	size_t count = 0;
+	for ( uint32_t k = 0; k < KEYS; ++k )
+	{
+		uint32_t got = 0;
+		count += present[k];
+		ok = ok && r_hash_map_get( &map, (uint64_t)k * 0x9E3779B97F4A7C15ull, &got ) == present[k];
+		ok = ok && ( !present[k] || got == expected[k] );
+	}
+	CHECK( ok && map.count == count );
+	CHECK( map.used < map.capacity );
+	r_hash_map_free( &map );
+}
+
+typedef struct Blocks
+{
+	uint32_t rasterizer[10];
+	uint32_t blend[24];
+	uint32_t depthStencil[13];
+} Blocks;
+
+static uint32_t create_shader( R_ReplayTarget *target, R_CaptureOp op, const uint8_t bytecode[16] )
+{
+	R_CaptureCall call = { .op = op, .data = bytecode, .size = 16 };
+	return target->execute( target->self, &call );
+}
+
+static uint32_t create_pipeline( R_ReplayTarget *target, uint32_t vs, uint32_t ps, const Blocks *blocks )
+{
+	R_CaptureCall call = { .op = R_CAPTURE_CREATE_PIPELINE, .refs = { vs, ps, 0, 0 } };
+	call.args[0]       = sizeof( blocks->rasterizer );
+	call.args[1]       = sizeof( blocks->blend );
+	call.args[2]       = sizeof( blocks->depthStencil );
+	call.args[3]       = 0xffffffffu;
+	call.data          = blocks;
+	call.size          = sizeof( *blocks );
+	return target->execute( target->self, &call );
+}
+
+static void call( R_ReplayTarget *target, R_CaptureOp op, uint32_t id )
+{
+	R_CaptureCall c = { .op = op, .id = id };
+	target->execute( target->self, &c );
+}
+
+static void test_pipeline_dedupe( void )
+{
+	R_Headless    *dev    = r_headless_create();
+	R_ReplayTarget target = r_headless_replay_target( dev );
+	CHECK( dev != NULL );
+	if ( !dev )
+		return;
+
+	static const uint8_t vsBytecode[16] = { 'v', 's' };
+	static const uint8_t psBytecode[16] = { 'p', 's' };
+	uint32_t             vs             = create_shader( &target, R_CAPTURE_CREATE_VERTEX_SHADER, vsBytecode );
+	uint32_t             ps             = create_shader( &target, R_CAPTURE_CREATE_PIXEL_SHADER, psBytecode );
+	CHECK( vs && ps );
+
+	Blocks opaque = { 0 };
+	Blocks culled = opaque;
+	culled.rasterizer[1] ^= 1;
+
+	uint32_t a = create_pipeline( &target, vs, ps, &opaque );
+	uint32_t b = create_pipeline( &target, vs, ps, &opaque );
+	uint32_t c = create_pipeline( &target, vs, ps, &culled );
+	uint32_t d = create_pipeline( &target, vs, 0, &opaque );
+	CHECK( a && a == b );
+	CHECK( c && c != a );
+	CHECK( d && d != a && d != c );
+
+	R_HeadlessStats stats;
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.pipelines == 3 );
+
+	// Switching from a to c keeps the shaders, from c to d changes the pixel shader.
+	r_headless_reset_stats( dev );
+	call( &target, R_CAPTURE_BIND_PIPELINE, a );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.state.issued[R_STATE_CALL_SHADER] == 2 );
+	call( &target, R_CAPTURE_BIND_PIPELINE, a );
+	call( &target, R_CAPTURE_BIND_PIPELINE, c );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.state.issued[R_STATE_CALL_PIPELINE] == 2 && stats.state.filtered[R_STATE_CALL_PIPELINE] == 1 );
+	CHECK( stats.state.issued[R_STATE_CALL_SHADER] == 2 );
+	call( &target, R_CAPTURE_BIND_PIPELINE, d );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.state.issued[R_STATE_CALL_SHADER] == 3 );
+
+	// The shared pipeline lives until its last reference goes, then a new create makes a new one.
+	call( &target, R_CAPTURE_DESTROY_PIPELINE, a );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.pipelines == 3 );
+	call( &target, R_CAPTURE_DESTROY_PIPELINE, b );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.pipelines == 2 );
+	uint32_t e = create_pipeline( &target, vs, ps, &opaque );
+	CHECK( e && e != a );
+
+	r_headless_destroy( dev );
+}
+
+int main( void )
+{
+	test_hash();
+	test_hash_map();
+	test_pipeline_dedupe();
+	return test_report( "test_pipeline_cache" );
+}
@@ -0,0 +1,243 @@
+//
+// test_precache: pipeline manifests (r_precache.h) from recording to replay.
+// A session's repeated creates go in once and different contents go in as
+// new entries; the saved manifest replays on the precache thread with every
+// reference translated to the target's ids. A stub device stands in for the
+// warm objects of the D3D11 backend: after the replay the session's creates
+// find what was precached by content (hits) and anything new misses. An entry
+// the target refuses takes the entries built on it down, and a file that isn't
+// a manifest doesn't start.
+//
+// Works in the current directory, on test_precache.tmp.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_capture.c"
+#include "../render/common/r_precache.c"
+
+#define TEST_MANIFEST_PATH "test_precache.tmp"
+#define MAX_OBJECTS 64
+
+// Objects the precache thread created, the way R_WarmObjects keeps them.
+typedef struct Device
+{
+	R_CaptureOp ops[MAX_OBJECTS];
+	uint64_t    hashes[MAX_OBJECTS];
+	uint32_t    refs[MAX_OBJECTS][4];
+	uint32_t    count;
+	R_CaptureOp refuse; // creates of this op fail
+	R_HashMap   lookup; // content hash -> id, built once the replay is done
+	uint32_t    hits;
+} Device;
+
+#define DEVICE_ID_BASE 100 // so a reference the precache forgot to translate shows
+
+static const uint8_t          k_vsBytecode[48]  = { 'v', 's', 1 };
+static const uint8_t          k_psBytecode[40]  = { 'p', 's', 1 };
+static const uint8_t          k_otherPs[40]     = { 'p', 's', 2 };
+static const uint8_t          k_blocks[47 * 4]  = { 1, 2, 3 };
+static const uint8_t          k_samplerDesc[52] = { 21 };
+static const R_CaptureElement k_elements[2]     = {
+    { "POSITION", 0, 6, 0, 0, 0, 0 },
+    { "TEXCOORD", 0, 16, 0, 12, 0, 0 },
+};
+
+// What the backend keys its warm objects on: the bytecode, elements or descriptor, never the ids. A
+// layout read back from a manifest still has its encoded elements in data, so only they count.
+static uint64_t content_hash( const R_CaptureCall *call )
+{
+	uint32_t op   = (uint32_t)call->op;
+	uint64_t hash = r_hash_bytes( &op, sizeof( op ), R_HASH_SEED );
+	if ( !call->elementCount && call->size )
+		hash = r_hash_bytes( call->data, call->size, hash );
+	for ( uint32_t i = 0; i < call->elementCount; ++i )
+	{
+		const R_CaptureElement *e = &call->elements[i];
+		uint32_t u[6] = { e->semanticIndex, e->format, e->slot, e->offset, e->perInstance, e->stepRate };
+		hash          = r_hash_string( e->semantic, hash );
+		hash          = r_hash_bytes( u, sizeof( u ), hash );
+	}
+	return hash;
+}
+
+static uint32_t device_execute( void *self, const R_CaptureCall *call )
+{
+	Device *dev = (Device *)self;
+	if ( call->op == dev->refuse || dev->count == MAX_OBJECTS )
+		return 0;
+
+	uint32_t i     = dev->count++;
+	dev->ops[i]    = call->op;
+	dev->hashes[i] = content_hash( call );
+	memcpy( dev->refs[i], call->refs, sizeof( call->refs ) );
+	return DEVICE_ID_BASE + i;
+}
+
+// r_take_warm_object: a create on the main thread that finds the same contents precached.
+static bool device_create( Device *dev, const R_CaptureCall *call )
+{
+	uint32_t id  = 0;
+	bool     hit = r_hash_map_get( &dev->lookup, content_hash( call ), &id );
+	dev->hits += hit;
+	return hit;
+}
+
+// The session: two shaders, a layout on the vertex shader, a pipeline on all three and a sampler.
+static R_CaptureCall g_vs, g_ps, g_layout, g_pipeline, g_sampler;
+
+static void make_calls( void )
+{
+	g_vs       = ( R_CaptureCall ){ .op = R_CAPTURE_CREATE_VERTEX_SHADER, .data = k_vsBytecode, .size = 48 };
+	g_ps       = ( R_CaptureCall ){ .op = R_CAPTURE_CREATE_PIXEL_SHADER, .data = k_psBytecode, .size = 40 };
+	g_layout   = ( R_CaptureCall ){ .op = R_CAPTURE_CREATE_INPUT_LAYOUT, .elements = k_elements, .elementCount = 2 };
+	g_pipeline = ( R_CaptureCall ){ .op = R_CAPTURE_CREATE_PIPELINE, .data = k_blocks, .size = sizeof( k_blocks ) };
+	g_sampler  = ( R_CaptureCall ){ .op = R_CAPTURE_CREATE_SAMPLER, .data = k_samplerDesc, .size = 52 };
+	g_pipeline.args[0] = 10 * 4;
+	g_pipeline.args[1] = 24 * 4;
+	g_pipeline.args[2] = 13 * 4;
+	g_pipeline.args[3] = 0xffffffffu;
+}
+
+static void test_record( void )
+{
+	make_calls();
+	R_PrecacheRecorder recorder;
+	CHECK( r_precache_recorder_init( &recorder ) );
+
+	// Refs name the recorder's ids; the same contents created again get the first entry back.
+	uint32_t vs        = r_precache_record( &recorder, &g_vs );
+	uint32_t ps        = r_precache_record( &recorder, &g_ps );
+	g_layout.refs[0]   = vs;
+	uint32_t layout    = r_precache_record( &recorder, &g_layout );
+	g_pipeline.refs[0] = vs;
+	g_pipeline.refs[1] = ps;
+	g_pipeline.refs[2] = layout;
+	uint32_t pipeline  = r_precache_record( &recorder, &g_pipeline );
+	uint32_t sampler   = r_precache_record( &recorder, &g_sampler );
+	CHECK( vs == 1 && ps == 2 && layout == 3 && pipeline == 4 && sampler == 5 );
+
+	R_CaptureCall again = g_vs;
+	again.id            = 77; // the call's own id doesn't matter
+	CHECK( r_precache_record( &recorder, &again ) == vs && r_precache_record( &recorder, &g_pipeline ) == pipeline );
+	CHECK( r_precache_record( &recorder, &g_sampler ) == sampler && recorder.count == 5 );
+
+	// Different bytecode, another stencil ref: new entries.
+	R_CaptureCall other   = g_ps;
+	R_CaptureCall stencil = g_pipeline;
+	other.data            = k_otherPs;
+	stencil.args[4]       = 1;
+	CHECK( r_precache_record( &recorder, &other ) == 6 && r_precache_record( &recorder, &stencil ) == 7 );
+
+	// Only creates go in.
+	R_CaptureCall draw   = { .op = R_CAPTURE_DRAW_INDEXED };
+	R_CaptureCall buffer = { .op = R_CAPTURE_CREATE_BUFFER, .data = k_blocks, .size = 16 };
+	CHECK( r_precache_record( &recorder, &draw ) == 0 && r_precache_record( &recorder, &buffer ) == 0 );
+	CHECK( recorder.count == 7 && recorder.writer.calls == 7 );
+
+	CHECK( r_precache_save( &recorder, TEST_MANIFEST_PATH ) );
+	r_precache_recorder_free( &recorder );
+}
+
+static uint8_t *read_manifest( size_t *outSize )
+{
+	FILE *f = fopen( TEST_MANIFEST_PATH, "rb" );
+	if ( !f )
+		return NULL;
+	static uint8_t data[4096];
+	*outSize = fread( data, 1, sizeof( data ), f );
+	fclose( f );
+	return data;
+}
+
+static void replay( Device *dev, const uint8_t *data, size_t size, R_PrecacheStats *outStats )
+{
+	R_ReplayTarget target = { "stub", dev, device_execute };
+	R_Precache     precache;
+	CHECK( r_precache_start( &precache, data, size, &target ) );
+	while ( !r_precache_finished( &precache ) )
+		;
+	*outStats = precache.stats;
+	r_precache_free( &precache );
+
+	// The backend fills its lookup once the thread is done with it.
+	CHECK( r_hash_map_init( &dev->lookup, MAX_OBJECTS ) );
+	for ( uint32_t i = 0; i < dev->count; ++i )
+		r_hash_map_put( &dev->lookup, dev->hashes[i], DEVICE_ID_BASE + i );
+}
+
+static void test_replay( void )
+{
+	size_t         size = 0;
+	const uint8_t *data = read_manifest( &size );
+	CHECK( data && size > 16 );
+	if ( !data )
+		return;
+
+	Device          dev = { .refuse = R_CAPTURE_OP_COUNT };
+	R_PrecacheStats stats;
+	replay( &dev, data, size, &stats );
+	CHECK( stats.entries == 7 && stats.created == 7 && stats.failed == 0 && dev.count == 7 );
+
+	// References point at what the target made for the entries they named.
+	CHECK( dev.ops[2] == R_CAPTURE_CREATE_INPUT_LAYOUT && dev.refs[2][0] == DEVICE_ID_BASE );
+	CHECK( dev.ops[3] == R_CAPTURE_CREATE_PIPELINE && dev.refs[3][0] == DEVICE_ID_BASE );
+	CHECK( dev.refs[3][1] == DEVICE_ID_BASE + 1 && dev.refs[3][2] == DEVICE_ID_BASE + 2 );
+	CHECK( dev.ops[6] == R_CAPTURE_CREATE_PIPELINE && dev.refs[6][2] == DEVICE_ID_BASE + 2 );
+
+	// The next session: the recorded contents hit, down to the layout's semantic names; new ones miss.
+	CHECK( device_create( &dev, &g_vs ) && device_create( &dev, &g_ps ) && device_create( &dev, &g_layout ) );
+	CHECK( device_create( &dev, &g_pipeline ) && device_create( &dev, &g_sampler ) );
+	R_CaptureElement renamed[2] = { k_elements[0], k_elements[1] };
+	renamed[1].semantic         = "NORMAL";
+	R_CaptureCall layout        = g_layout;
+	layout.elements             = renamed;
+	R_CaptureCall shader        = g_vs;
+	shader.size                 = 47;
+	CHECK( !device_create( &dev, &layout ) && !device_create( &dev, &shader ) );
+	CHECK( dev.hits == 5 );
+	r_hash_map_free( &dev.lookup );
+}
+
+static void test_failures( void )
+{
+	size_t         size = 0;
+	const uint8_t *data = read_manifest( &size );
+	if ( !data )
+		return;
+
+	// Without the vertex shader the layout and both pipelines go too; the rest is still built.
+	Device          dev = { .refuse = R_CAPTURE_CREATE_VERTEX_SHADER };
+	R_PrecacheStats stats;
+	replay( &dev, data, size, &stats );
+	CHECK( stats.entries == 7 && stats.created == 3 && stats.failed == 4 );
+	CHECK( !device_create( &dev, &g_pipeline ) && device_create( &dev, &g_sampler ) );
+	r_hash_map_free( &dev.lookup );
+
+	// A manifest cut short builds the entries before the cut.
+	Device cut = { .refuse = R_CAPTURE_OP_COUNT };
+	replay( &cut, data, size - 20, &stats );
+	CHECK( stats.created == 6 && stats.created == stats.entries && cut.count == 6 );
+	r_hash_map_free( &cut.lookup );
+
+	R_ReplayTarget target  = { "stub", &dev, device_execute };
+	R_Precache     precache;
+	uint8_t        junk[64] = { 'R', 'C', 'A', 'X' };
+	CHECK( !r_precache_start( &precache, junk, sizeof( junk ), &target ) );
+	CHECK( !r_precache_start( &precache, data, size, NULL ) );
+	remove( TEST_MANIFEST_PATH );
+}
+
+int main( void )
+{
+	test_record();
+	test_replay();
+	test_failures();
+	return test_report( "test_precache" );
+}
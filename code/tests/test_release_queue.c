@@ -0,0 +1,175 @@
+//
+// test_release_queue: the deferred release queue (r_release_queue.h). Objects
+// come back only once the frame they were pushed in has completed, in push
+// order, each exactly once; a full queue refuses pushes instead of dropping
+// anything. The last case pushes from several threads while the consumer
+// keeps advancing frames and collecting, the way destroys from worker threads
+// meet r_end_frame.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_release_queue.c"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 100000
+#define FRAME_LAG 3
+
+typedef struct Object
+{
+	uint64_t frame; // the producer's idea of the frame, never later than the queue's
+	uint32_t producer;
+	uint32_t index;
+	int      released;
+} Object;
+
+static R_ReleaseQueue g_queue;
+static SYS_Atomic64   g_completed; // frames before this one have passed their fence
+static SYS_Atomic64   g_frame;
+static SYS_Atomic64   g_released;
+static uint32_t       g_next[PRODUCERS]; // index each producer's next release should have
+static bool           g_ok = true;
+
+// Runs on the consumer thread only.
+static void release( void *user, void *object )
+{
+	(void)user;
+	Object *o = (Object *)object;
+	g_ok      = g_ok && !o->released && o->frame < (uint64_t)sys_atomic_load( &g_completed );
+	g_ok      = g_ok && o->index == g_next[o->producer];
+	g_next[o->producer]++;
+	o->released++;
+	sys_atomic_add( &g_released, 1 );
+}
+
+static void reset( void )
+{
+	memset( g_next, 0, sizeof( g_next ) );
+	sys_atomic_store( &g_released, 0 );
+	sys_atomic_store( &g_completed, 0 );
+	g_ok = true;
+}
+
+static void test_frames( void )
+{
+	reset();
+	CHECK( r_release_queue_init( &g_queue, 1000, release, NULL ) );
+	CHECK( g_queue.capacity == 1024 );
+
+	static Object objects[6];
+	for ( uint32_t i = 0; i < 6; ++i )
+	{
+		objects[i] = ( Object ){ i / 2, 0, i, 0 };
+		r_release_queue_set_frame( &g_queue, i / 2 );
+		CHECK( r_release_queue_push( &g_queue, &objects[i] ) );
+	}
+	CHECK( !r_release_queue_push( &g_queue, NULL ) );
+
+	// Nothing before frame 0 has completed; then one frame at a time.
+	CHECK( r_release_queue_collect( &g_queue, 0 ) == 0 );
+	sys_atomic_store( &g_completed, 1 );
+	CHECK( r_release_queue_collect( &g_queue, 1 ) == 2 );
+	CHECK( objects[1].released && !objects[2].released );
+	sys_atomic_store( &g_completed, 3 );
+	CHECK( r_release_queue_collect( &g_queue, 3 ) == 4 );
+	CHECK( r_release_queue_collect( &g_queue, 3 ) == 0 );
+
+	R_ReleaseStats stats;
+	r_release_queue_get_stats( &g_queue, &stats );
+	CHECK( stats.queued == 6 && stats.released == 6 && stats.pending == 0 && stats.rejected == 0 );
+	CHECK( g_ok );
+	r_release_queue_free( &g_queue );
+}
+
+static void test_full( void )
+{
+	reset();
+	CHECK( r_release_queue_init( &g_queue, 64, release, NULL ) );
+
+	static Object objects[100];
+	int           accepted = 0;
+	for ( uint32_t i = 0; i < 100; ++i )
+	{
+		objects[i] = ( Object ){ 0, 0, i, 0 };
+		accepted += r_release_queue_push( &g_queue, &objects[i] );
+	}
+	CHECK( accepted == 64 );
+
+	R_ReleaseStats stats;
+	r_release_queue_get_stats( &g_queue, &stats );
+	CHECK( stats.rejected == 36 && stats.pending == 64 );
+
+	// Collecting frees the slots again; the queue keeps going around the ring.
+	sys_atomic_store( &g_completed, 1 );
+	CHECK( r_release_queue_collect( &g_queue, 1 ) == 64 );
+	for ( uint32_t i = 64; i < 100; ++i )
+		CHECK( r_release_queue_push( &g_queue, &objects[i] ) );
+
+	// Freeing the queue releases what's left, the caller has already waited for the GPU.
+	sys_atomic_store( &g_completed, INT64_MAX );
+	r_release_queue_free( &g_queue );
+	bool all = true;
+	for ( uint32_t i = 0; i < 100; ++i )
+		all = all && objects[i].released == 1;
+	CHECK( all && g_ok );
+}
+
+static Object g_objects[PRODUCERS][PER_PRODUCER];
+
+static void producer( void *arg )
+{
+	uint32_t t = (uint32_t)(intptr_t)arg;
+	for ( uint32_t i = 0; i < PER_PRODUCER; ++i )
+	{
+		Object *o = &g_objects[t][i];
+		*o        = ( Object ){ (uint64_t)sys_atomic_load( &g_frame ), t, i, 0 };
+
+		// A full queue means the frames have to move on first.
+		while ( !r_release_queue_push( &g_queue, o ) )
+			;
+	}
+}
+
+static void test_producers( void )
+{
+	reset();
+	CHECK( r_release_queue_init( &g_queue, 4096, release, NULL ) );
+
+	SYS_Thread threads[PRODUCERS];
+	for ( int t = 0; t < PRODUCERS; ++t )
+		CHECK( sys_thread_start( &threads[t], producer, (void *)(intptr_t)t ) );
+
+	// The queue's frame moves first, so every object is tagged no earlier than the producer saw.
+	uint64_t frame = 0;
+	while ( sys_atomic_load( &g_released ) < PRODUCERS * PER_PRODUCER )
+	{
+		frame++;
+		r_release_queue_set_frame( &g_queue, frame );
+		sys_atomic_store( &g_frame, (int64_t)frame );
+		uint64_t completed = frame > FRAME_LAG ? frame - FRAME_LAG : 0;
+		sys_atomic_store( &g_completed, (int64_t)completed );
+		r_release_queue_collect( &g_queue, completed );
+	}
+	for ( int t = 0; t < PRODUCERS; ++t )
+		sys_thread_join( &threads[t] );
+
+	R_ReleaseStats stats;
+	r_release_queue_get_stats( &g_queue, &stats );
+	CHECK( stats.queued == PRODUCERS * PER_PRODUCER && stats.released == stats.queued && stats.pending == 0 );
+	bool all = true;
+	for ( int t = 0; t < PRODUCERS; ++t )
+		all = all && g_next[t] == PER_PRODUCER;
+	CHECK( all && g_ok );
+	r_release_queue_free( &g_queue );
+}
+
+int main( void )
+{
+	test_frames();
+	test_full();
+	test_producers();
+	return test_report( "test_release_queue" );
+}
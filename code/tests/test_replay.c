@@ -0,0 +1,262 @@
+//
+// test_replay: a capture (r_capture.h) written, saved and replayed (r_replay.h)
+// on the headless backend. A recording target in front of the device checks
+// what the replay hands it: every captured id and reference is translated to
+// what the device created for it, and the frame's calls arrive in order with
+// their args. The device's stats check the draws themselves: valid ones pass,
+// one naming a buffer that was never created and one after its index buffer
+// was destroyed don't. Frames replay again with the destroyed buffer missing,
+// and a file that isn't a capture or has no frame doesn't start.
+//
+// Works in the current directory, on test_replay.tmp.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_ring_alloc.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_capture.c"
+#include "../render/common/r_replay.c"
+#include "../render/backend/headless/r_headless.c"
+
+#define TEST_CAPTURE_PATH "test_replay.tmp"
+#define MAX_CALLS 64
+
+// Captured ids, made up the way the D3D11 backend hands them out.
+enum
+{
+	VS       = 11,
+	PS       = 12,
+	LAYOUT   = 13,
+	PIPELINE = 14,
+	VERTICES = 15,
+	INDICES  = 16,
+	MISSING  = 99,
+};
+
+// Sits in front of the headless device and keeps every call it forwards.
+typedef struct Recorder
+{
+	R_ReplayTarget device;
+	R_CaptureCall  calls[MAX_CALLS];
+	uint32_t       created[MAX_CALLS];
+	uint32_t       count;
+} Recorder;
+
+static uint32_t recorder_execute( void *self, const R_CaptureCall *call )
+{
+	Recorder *rec     = (Recorder *)self;
+	uint32_t  created = rec->device.execute( rec->device.self, call );
+	if ( rec->count < MAX_CALLS )
+	{
+		rec->calls[rec->count]          = *call;
+		rec->calls[rec->count].data     = NULL; // the reader's, gone after the next call
+		rec->calls[rec->count].elements = NULL;
+		rec->created[rec->count++]      = created;
+	}
+	return created;
+}
+
+static const uint8_t          k_vsBytecode[16] = { 'v', 's' };
+static const uint8_t          k_psBytecode[16] = { 'p', 's' };
+static const uint16_t         k_indices[6]     = { 0, 1, 2, 0, 2, 3 };
+static const R_CaptureElement k_elements[2]    = {
+    { "POSITION", 0, 6, 0, 0, 0, 0 },
+    { "TEXCOORD", 0, 16, 0, 12, 0, 0 },
+};
+static float    g_vertices[5 * 8]; // five 32-byte vertices
+static uint32_t g_blocks[10 + 24 + 13];
+
+static void write_call( R_CaptureWriter *writer, R_CaptureOp op, uint32_t id, const uint32_t *args, uint32_t argCount )
+{
+	R_CaptureCall call = { .op = op, .id = id };
+	for ( uint32_t i = 0; i < argCount; ++i )
+		call.args[i] = args[i];
+	r_capture_write( writer, &call );
+}
+
+static void write_setup( R_CaptureWriter *writer )
+{
+	R_CaptureCall vs       = { .op = R_CAPTURE_CREATE_VERTEX_SHADER, .id = VS, .data = k_vsBytecode, .size = 16 };
+	R_CaptureCall ps       = { .op = R_CAPTURE_CREATE_PIXEL_SHADER, .id = PS, .data = k_psBytecode, .size = 16 };
+	R_CaptureCall layout   = { .op = R_CAPTURE_CREATE_INPUT_LAYOUT, .id = LAYOUT, .refs = { VS } };
+	R_CaptureCall pipeline = { .op = R_CAPTURE_CREATE_PIPELINE, .id = PIPELINE, .refs = { VS, PS, LAYOUT, 0 } };
+	R_CaptureCall vb       = { .op = R_CAPTURE_CREATE_BUFFER, .id = VERTICES, .data = g_vertices };
+	R_CaptureCall ib       = { .op = R_CAPTURE_CREATE_BUFFER, .id = INDICES, .data = k_indices };
+	layout.elements        = k_elements;
+	layout.elementCount    = 2;
+	pipeline.args[0]       = 10 * sizeof( uint32_t );
+	pipeline.args[1]       = 24 * sizeof( uint32_t );
+	pipeline.args[2]       = 13 * sizeof( uint32_t );
+	pipeline.args[3]       = 0xffffffffu;
+	pipeline.data          = g_blocks;
+	pipeline.size          = sizeof( g_blocks );
+	vb.size                = sizeof( g_vertices );
+	vb.args[2]             = sizeof( g_vertices );
+	ib.size                = sizeof( k_indices );
+	ib.args[2]             = sizeof( k_indices );
+
+	r_capture_write( writer, &vs );
+	r_capture_write( writer, &ps );
+	r_capture_write( writer, &layout );
+	r_capture_write( writer, &pipeline );
+	r_capture_write( writer, &vb );
+	r_capture_write( writer, &ib );
+}
+
+// Two good draws, one from a buffer that was never created, one after the index buffer is destroyed.
+static void write_frame( R_CaptureWriter *writer )
+{
+	const uint32_t vertexArgs[2] = { 32, 0 };
+	const uint32_t indexArgs[2]  = { R_HEADLESS_INDEX_R16, 0 };
+	const uint32_t whole[3]      = { 6, 0, 0 };
+	const uint32_t shifted[3]    = { 3, 3, 1 }; // indices 0, 2, 3 on vertex 1: reads the fifth vertex
+
+	write_call( writer, R_CAPTURE_FRAME, 0, NULL, 0 );
+	write_call( writer, R_CAPTURE_BIND_PIPELINE, PIPELINE, NULL, 0 );
+	write_call( writer, R_CAPTURE_SET_VERTEX_BUFFER, VERTICES, vertexArgs, 2 );
+	write_call( writer, R_CAPTURE_SET_INDEX_BUFFER, INDICES, indexArgs, 2 );
+	write_call( writer, R_CAPTURE_DRAW_INDEXED, 0, whole, 3 );
+	write_call( writer, R_CAPTURE_DRAW_INDEXED, 0, shifted, 3 );
+	write_call( writer, R_CAPTURE_SET_VERTEX_BUFFER, MISSING, vertexArgs, 2 );
+	write_call( writer, R_CAPTURE_DRAW_INDEXED, 0, whole, 3 );
+	write_call( writer, R_CAPTURE_SET_VERTEX_BUFFER, VERTICES, vertexArgs, 2 );
+	write_call( writer, R_CAPTURE_DESTROY_BUFFER, INDICES, NULL, 0 );
+	write_call( writer, R_CAPTURE_DRAW_INDEXED, 0, whole, 3 );
+	write_call( writer, R_CAPTURE_PRESENT, 0, NULL, 0 );
+}
+
+static uint8_t *read_capture( size_t *outSize )
+{
+	FILE *f = fopen( TEST_CAPTURE_PATH, "rb" );
+	if ( !f )
+		return NULL;
+	static uint8_t data[8192];
+	*outSize = fread( data, 1, sizeof( data ), f );
+	fclose( f );
+	return data;
+}
+
+static void test_replay( void )
+{
+	for ( uint32_t i = 0; i < sizeof( g_blocks ) / sizeof( g_blocks[0] ); ++i )
+		g_blocks[i] = i;
+
+	R_CaptureWriter writer;
+	r_capture_writer_init( &writer );
+	write_setup( &writer );
+	write_frame( &writer );
+	CHECK( writer.calls == 6 + 12 );
+	CHECK( r_capture_writer_save( &writer, TEST_CAPTURE_PATH ) );
+	r_capture_writer_free( &writer );
+
+	size_t         size = 0;
+	const uint8_t *data = read_capture( &size );
+	R_Headless    *dev  = r_headless_create();
+	CHECK( data && size > 16 && dev );
+	if ( !data || !dev )
+		return;
+
+	Recorder       rec    = { .device = r_headless_replay_target( dev ) };
+	R_ReplayTarget target = { "recorder", &rec, recorder_execute };
+	R_Replay       replay;
+	CHECK( r_replay_init( &replay, data, size, &target ) );
+	CHECK( replay.stats.setupCalls == 7 && replay.stats.frameCalls == 11 );
+
+	// Setup: the creates get their captured references translated to the device's objects.
+	CHECK( r_replay_setup( &replay ) && rec.count == 7 );
+	const R_CaptureCall *c = rec.calls;
+	const uint32_t      *h = rec.created;
+	CHECK( c[0].op == R_CAPTURE_CREATE_VERTEX_SHADER && c[1].op == R_CAPTURE_CREATE_PIXEL_SHADER );
+	CHECK( c[2].op == R_CAPTURE_CREATE_INPUT_LAYOUT && c[3].op == R_CAPTURE_CREATE_PIPELINE );
+	CHECK( c[4].op == R_CAPTURE_CREATE_BUFFER && c[5].op == R_CAPTURE_CREATE_BUFFER && c[6].op == R_CAPTURE_FRAME );
+	for ( int i = 0; i < 6; ++i )
+		CHECK( h[i] != 0 && c[i].id == 0 );
+	CHECK( c[2].refs[0] == h[0] && c[2].elementCount == 2 );
+	CHECK( c[3].refs[0] == h[0] && c[3].refs[1] == h[1] && c[3].refs[2] == h[2] && c[3].refs[3] == 0 );
+	CHECK( c[3].args[0] == 40 && c[3].args[1] == 96 && c[3].args[2] == 52 && c[3].size == sizeof( g_blocks ) );
+	CHECK( c[4].args[2] == sizeof( g_vertices ) && c[5].args[2] == sizeof( k_indices ) );
+
+	R_HeadlessStats stats;
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.buffers == 2 && stats.vertexShaders == 1 && stats.pixelShaders == 1 );
+	CHECK( stats.inputLayouts == 1 && stats.pipelines == 1 );
+	CHECK( stats.bytesUploaded == sizeof( g_vertices ) + sizeof( k_indices ) );
+	r_headless_reset_stats( dev );
+
+	// The frame: in capture order, ids on the device's objects, args as written.
+	CHECK( r_replay_frame( &replay ) && rec.count == 7 + 11 );
+	c = rec.calls + 7;
+	CHECK( c[0].op == R_CAPTURE_BIND_PIPELINE && c[0].id == h[3] );
+	CHECK( c[1].op == R_CAPTURE_SET_VERTEX_BUFFER && c[1].id == h[4] && c[1].args[0] == 32 );
+	CHECK( c[2].op == R_CAPTURE_SET_INDEX_BUFFER && c[2].id == h[5] && c[2].args[0] == R_HEADLESS_INDEX_R16 );
+	CHECK( c[3].op == R_CAPTURE_DRAW_INDEXED && c[3].args[0] == 6 && c[3].args[1] == 0 && c[3].args[2] == 0 );
+	CHECK( c[4].op == R_CAPTURE_DRAW_INDEXED && c[4].args[0] == 3 && c[4].args[1] == 3 && c[4].args[2] == 1 );
+	CHECK( c[5].op == R_CAPTURE_SET_VERTEX_BUFFER && c[5].id == 0 );
+	CHECK( c[7].op == R_CAPTURE_SET_VERTEX_BUFFER && c[7].id == h[4] );
+	CHECK( c[8].op == R_CAPTURE_DESTROY_BUFFER && c[8].id == h[5] );
+	CHECK( c[9].op == R_CAPTURE_DRAW_INDEXED && c[10].op == R_CAPTURE_PRESENT );
+	CHECK( replay.stats.missingObjects == 1 && replay.stats.failedCreates == 0 );
+	CHECK( replay.stats.ops[R_CAPTURE_DRAW_INDEXED].calls == 4 && replay.stats.frames == 1 );
+
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.draws == 4 && stats.invalidDraws == 2 && stats.indices == 6 + 3 + 6 + 6 );
+	CHECK( stats.buffers == 1 );
+	r_headless_reset_stats( dev );
+
+	// Again: the destroyed index buffer is gone for good, so no draw is valid.
+	CHECK( r_replay_frame( &replay ) && rec.count == 7 + 22 );
+	c = rec.calls + 7 + 11;
+	CHECK( c[2].op == R_CAPTURE_SET_INDEX_BUFFER && c[2].id == 0 );
+	CHECK( c[8].op == R_CAPTURE_DESTROY_BUFFER && c[8].id == 0 );
+	CHECK( replay.stats.missingObjects == 1 + 3 && replay.stats.frames == 2 );
+	r_headless_get_stats( dev, &stats );
+	CHECK( stats.draws == 4 && stats.invalidDraws == 4 && stats.buffers == 1 );
+
+	r_replay_free( &replay );
+	r_headless_destroy( dev );
+}
+
+static void test_not_a_capture( void )
+{
+	R_Headless *dev = r_headless_create();
+	CHECK( dev != NULL );
+	if ( !dev )
+		return;
+	R_ReplayTarget target = r_headless_replay_target( dev );
+	R_Replay       replay;
+
+	uint8_t junk[64] = { 'R', 'C', 'A', 'X' };
+	CHECK( !r_replay_init( &replay, junk, sizeof( junk ), &target ) );
+	r_replay_free( &replay );
+
+	// Setup calls only: nothing to replay.
+	R_CaptureWriter writer;
+	r_capture_writer_init( &writer );
+	write_setup( &writer );
+	CHECK( r_capture_writer_save( &writer, TEST_CAPTURE_PATH ) );
+	r_capture_writer_free( &writer );
+
+	size_t         size = 0;
+	const uint8_t *data = read_capture( &size );
+	CHECK( data && !r_replay_init( &replay, data, size, &target ) );
+	r_replay_free( &replay );
+	CHECK( data && !r_replay_init( &replay, data, size, NULL ) );
+	r_replay_free( &replay );
+
+	r_headless_destroy( dev );
+	remove( TEST_CAPTURE_PATH );
+}
+
+int main( void )
+{
+	test_replay();
+	test_not_a_capture();
+	return test_report( "test_replay" );
+}
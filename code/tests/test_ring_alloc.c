@@ -0,0 +1,172 @@
+//
+// test_ring_alloc: the constant ring (r_ring_alloc.h) aligns, wraps at the end
+// of the buffer, and never hands out bytes of a frame whose fence hasn't
+// passed; retiring a frame makes its bytes reusable.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_ring_alloc.c"
+
+static void test_alignment( void )
+{
+	R_RingAllocator ring;
+	size_t          offset = 0;
+	CHECK( !r_ring_init( &ring, 4096, 0 ) );
+	CHECK( !r_ring_init( &ring, 4096, 96 ) );
+	CHECK( r_ring_init( &ring, 4096, 256 ) );
+
+	CHECK( r_ring_alloc( &ring, 1, &offset ) && offset == 0 );
+	CHECK( r_ring_alloc( &ring, 256, &offset ) && offset == 256 );
+	CHECK( r_ring_alloc( &ring, 257, &offset ) && offset == 512 );
+	CHECK( r_ring_alloc( &ring, 64, &offset ) && offset == 1024 );
+	CHECK( ring.used == 1280 );
+	CHECK( !r_ring_alloc( &ring, 0, &offset ) );
+	CHECK( !r_ring_alloc( &ring, 4097, &offset ) );
+}
+
+static void test_wrap_and_fences( void )
+{
+	R_RingAllocator ring;
+	size_t          offset = 0;
+	r_ring_init( &ring, 1024, 256 );
+
+	// Frame 1 fills the front half, frame 2 the back half.
+	CHECK( r_ring_alloc( &ring, 512, &offset ) && offset == 0 );
+	CHECK( r_ring_end_frame( &ring, 1 ) );
+	CHECK( r_ring_alloc( &ring, 256, &offset ) && offset == 512 );
+	CHECK( r_ring_alloc( &ring, 256, &offset ) && offset == 768 );
+	CHECK( r_ring_end_frame( &ring, 2 ) );
+
+	// Full until the GPU is done with frame 1.
+	CHECK( !r_ring_alloc( &ring, 256, &offset ) );
+	r_ring_retire( &ring, 0 );
+	CHECK( !r_ring_alloc( &ring, 256, &offset ) );
+
+	uint64_t oldest = 0;
+	CHECK( r_ring_oldest_frame( &ring, &oldest ) && oldest == 1 );
+	r_ring_retire( &ring, 1 );
+	CHECK( r_ring_oldest_frame( &ring, &oldest ) && oldest == 2 );
+
+	// Frame 1's bytes come back at the front, the ring wrapped.
+	CHECK( r_ring_alloc( &ring, 256, &offset ) && offset == 0 );
+	CHECK( r_ring_alloc( &ring, 256, &offset ) && offset == 256 );
+	CHECK( !r_ring_alloc( &ring, 256, &offset ) );
+	CHECK( r_ring_end_frame( &ring, 3 ) );
+
+	// Retiring frame 2 leaves [512, 1024) free; a 768 byte request doesn't fit in it.
+	r_ring_retire( &ring, 2 );
+	CHECK( !r_ring_alloc( &ring, 768, &offset ) );
+	CHECK( r_ring_alloc( &ring, 512, &offset ) && offset == 512 );
+	CHECK( r_ring_end_frame( &ring, 4 ) );
+
+	// Once everything retired the ring starts over at 0 and holds a full-size allocation.
+	r_ring_retire( &ring, 4 );
+	CHECK( ring.used == 0 && !r_ring_oldest_frame( &ring, &oldest ) );
+	CHECK( r_ring_alloc( &ring, 1024, &offset ) && offset == 0 );
+}
+
+static void test_wasted_tail( void )
+{
+	R_RingAllocator ring;
+	size_t          offset = 0;
+	r_ring_init( &ring, 1024, 256 );
+
+	CHECK( r_ring_alloc( &ring, 512, &offset ) );
+	CHECK( r_ring_end_frame( &ring, 1 ) );
+	CHECK( r_ring_alloc( &ring, 256, &offset ) && offset == 512 );
+	CHECK( r_ring_end_frame( &ring, 2 ) );
+	r_ring_retire( &ring, 1 );
+
+	// Frame 3 doesn't fit behind frame 2, so it skips the end of the ring and the skipped
+	// bytes are frame 3's until it retires.
+	CHECK( r_ring_alloc( &ring, 512, &offset ) && offset == 0 );
+	CHECK( r_ring_end_frame( &ring, 3 ) );
+	CHECK( ring.used == 1024 );
+	r_ring_retire( &ring, 2 );
+	CHECK( ring.used == 768 );
+	r_ring_retire( &ring, 3 );
+	CHECK( ring.used == 0 );
+}
+
+static void test_frame_limit( void )
+{
+	R_RingAllocator ring;
+	size_t          offset = 0;
+	r_ring_init( &ring, 1 << 20, 256 );
+
+	for ( uint64_t frame = 1; frame <= R_RING_MAX_FRAMES; ++frame )
+	{
+		CHECK( r_ring_alloc( &ring, 256, &offset ) );
+		CHECK( r_ring_end_frame( &ring, frame ) );
+	}
+	CHECK( !r_ring_end_frame( &ring, R_RING_MAX_FRAMES + 1 ) );
+	r_ring_retire( &ring, 1 );
+	CHECK( r_ring_end_frame( &ring, R_RING_MAX_FRAMES + 1 ) );
+}
+
+// Frames of random allocations with the GPU a random number of frames behind. Every byte handed
+// out is stamped with its frame; no allocation may cover a byte of a frame that hasn't retired.
+static void test_random_frames( void )
+{
+	enum
+	{
+		SIZE   = 64 * 1024,
+		FRAMES = 20000,
+	};
+	static uint64_t owner[SIZE / 256];
+	R_RingAllocator ring;
+	r_ring_init( &ring, SIZE, 256 );
+	memset( owner, 0, sizeof( owner ) );
+
+	uint64_t completed = 0;
+	uint64_t seed      = 12345;
+	bool     ok        = true;
+	for ( uint64_t frame = 1; frame <= FRAMES && ok; ++frame )
+	{
+		seed         = seed * 6364136223846793005ull + 1442695040888963407ull;
+		uint32_t n   = (uint32_t)( seed >> 59 );
+		uint32_t lag = (uint32_t)( seed >> 40 ) % R_RING_MAX_FRAMES;
+
+		// The fence: frames up to frame - 1 - lag are done.
+		if ( frame > 1 + lag && frame - 1 - lag > completed )
+			completed = frame - 1 - lag;
+		r_ring_retire( &ring, completed );
+
+		for ( uint32_t i = 0; i < n; ++i )
+		{
+			seed         = seed * 6364136223846793005ull + 1442695040888963407ull;
+			size_t bytes = 1 + (size_t)( seed >> 33 ) % 4096;
+			size_t offset;
+			if ( !r_ring_alloc( &ring, bytes, &offset ) )
+				break;
+			for ( size_t block = offset / 256; block < ( offset + bytes + 255 ) / 256; ++block )
+			{
+				ok           = ok && offset % 256 == 0 && offset + bytes <= SIZE && owner[block] <= completed;
+				owner[block] = frame;
+			}
+		}
+		if ( !r_ring_end_frame( &ring, frame ) )
+		{
+			// Every slot is in flight, wait for the GPU.
+			completed = frame - 1;
+			r_ring_retire( &ring, completed );
+			ok = ok && r_ring_end_frame( &ring, frame );
+		}
+	}
+	CHECK( ok );
+	r_ring_retire( &ring, FRAMES );
+	CHECK( ring.used == 0 );
+}
+
+int main( void )
+{
+	test_alignment();
+	test_wrap_and_fences();
+	test_wasted_tail();
+	test_frame_limit();
+	test_random_frames();
+	return test_report( "test_ring_alloc" );
+}
@@ -0,0 +1,209 @@
+//
+// test_shader_cache: the on-disk bytecode cache (r_shader_cache.h) with a stub
+// compiler. Blobs round-trip through the file and come back on the next open
+// without compiling, every input of the key matters, two handles on one file
+// see each other's inserts, and damaged files are rejected rather than served:
+// a record whose payload doesn't hash is dropped with everything behind it,
+// and a file of another version serves nothing.
+//
+// Works in the current directory, on test_shader_cache.tmp.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_file.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_shader_cache.c"
+
+#define TEST_CACHE_PATH "test_shader_cache.tmp"
+
+static int g_compiles;
+
+// Deterministic bytecode of a size that depends on the source.
+static size_t stub_compile( const R_ShaderSource *source, uint8_t *out )
+{
+	size_t size = source->sourceSize * 3 + 7;
+	for ( size_t i = 0; i < size; ++i )
+		out[i] = (uint8_t)( source->source[i % source->sourceSize] ^ i );
+	g_compiles++;
+	return size;
+}
+
+static R_ShaderSource shader( const char *src, const char *entry )
+{
+	R_ShaderSource source = { src, strlen( src ), entry, "vs_5_0", NULL, 1, 47 };
+	return source;
+}
+
+// What r_create_*_shader_from_source does: look up, compile and insert on a miss. Checks that the
+// bytes handed out are the compiler's. Returns the payload's offset in the file.
+static size_t get( R_ShaderCache *cache, const char *src, const char *entry )
+{
+	R_ShaderSource source = shader( src, entry );
+	uint64_t       key    = r_shader_cache_key( &source );
+	uint8_t        compiled[1024];
+	const void    *data = NULL;
+	size_t         size = 0;
+	if ( !r_shader_cache_find( cache, key, &data, &size ) )
+	{
+		size_t bytes = stub_compile( &source, compiled );
+		CHECK( r_shader_cache_insert( cache, key, compiled, bytes ) );
+		CHECK( r_shader_cache_find( cache, key, &data, &size ) );
+	}
+	if ( !data )
+		return 0;
+
+	int     compiles = g_compiles;
+	uint8_t expected[1024];
+	CHECK( size == stub_compile( &source, expected ) && memcmp( data, expected, size ) == 0 );
+	CHECK( (uintptr_t)data % R_SHADER_CACHE_ALIGNMENT == 0 );
+	g_compiles = compiles;
+	return (size_t)( (const uint8_t *)data - cache->mapping.data );
+}
+
+static bool cached( R_ShaderCache *cache, const char *src, const char *entry )
+{
+	R_ShaderSource source = shader( src, entry );
+	const void    *data   = NULL;
+	size_t         size   = 0;
+	return r_shader_cache_find( cache, r_shader_cache_key( &source ), &data, &size );
+}
+
+static void damage( size_t offset, const void *bytes, size_t size )
+{
+	IO_File file;
+	CHECK( io_file_open( &file, TEST_CACHE_PATH, true ) );
+	CHECK( io_file_write_at( &file, offset, bytes, size ) );
+	io_file_close( &file );
+}
+
+static void test_key( void )
+{
+	R_ShaderDefine one[] = { { "SKINNED", "1" }, { NULL, NULL } };
+	R_ShaderDefine two[] = { { "SKINNED", "2" }, { NULL, NULL } };
+	R_ShaderSource base  = shader( "float4 main() : SV_Position { return 0; }", "main" );
+	uint64_t       key   = r_shader_cache_key( &base );
+
+	R_ShaderSource other = base;
+	CHECK( r_shader_cache_key( &other ) == key );
+	other.entry = "main2";
+	CHECK( r_shader_cache_key( &other ) != key );
+	other         = base;
+	other.profile = "ps_5_0";
+	CHECK( r_shader_cache_key( &other ) != key );
+	other       = base;
+	other.flags = 2;
+	CHECK( r_shader_cache_key( &other ) != key );
+	other                 = base;
+	other.compilerVersion = 43;
+	CHECK( r_shader_cache_key( &other ) != key );
+	other            = base;
+	other.sourceSize = base.sourceSize - 1;
+	CHECK( r_shader_cache_key( &other ) != key );
+
+	R_ShaderSource a = base, b = base;
+	a.defines        = one;
+	b.defines        = two;
+	CHECK( r_shader_cache_key( &a ) != key && r_shader_cache_key( &a ) != r_shader_cache_key( &b ) );
+}
+
+static void test_round_trip( void )
+{
+	R_ShaderCache cache;
+	remove( TEST_CACHE_PATH );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+
+	g_compiles = 0;
+	get( &cache, "float4 main() : SV_Position { return 0; }", "main" );
+	get( &cache, "float4 main() : SV_Position { return 0; }", "main2" );
+	get( &cache, "float4 main() : SV_Position { return 0; }", "main" );
+	CHECK( g_compiles == 2 );
+	r_shader_cache_close( &cache );
+
+	// The next launch compiles nothing.
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	g_compiles = 0;
+	get( &cache, "float4 main() : SV_Position { return 0; }", "main" );
+	get( &cache, "float4 main() : SV_Position { return 0; }", "main2" );
+	CHECK( g_compiles == 0 );
+
+	// A second handle on the same file, as another process would have it.
+	R_ShaderCache other;
+	CHECK( r_shader_cache_open( &other, TEST_CACHE_PATH ) );
+	get( &other, "float4 other() : SV_Position { return 1; }", "other" );
+	CHECK( g_compiles == 1 );
+	get( &cache, "float4 other() : SV_Position { return 1; }", "other" );
+	CHECK( g_compiles == 1 );
+	r_shader_cache_close( &other );
+	r_shader_cache_close( &cache );
+}
+
+static void test_corrupt( void )
+{
+	R_ShaderCache cache;
+	remove( TEST_CACHE_PATH );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	get( &cache, "first", "main" );
+	size_t second = get( &cache, "second", "main" );
+	get( &cache, "third", "main" );
+	r_shader_cache_close( &cache );
+
+	// A flipped payload byte in the second record: it and the third are gone, the first is fine.
+	uint8_t flipped = 0xAB;
+	damage( second + 3, &flipped, 1 );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	CHECK( cached( &cache, "first", "main" ) );
+	CHECK( !cached( &cache, "second", "main" ) );
+	CHECK( !cached( &cache, "third", "main" ) );
+
+	// Compiling the second again writes over the damage, which brings back the intact third record.
+	g_compiles = 0;
+	get( &cache, "second", "main" );
+	get( &cache, "third", "main" );
+	CHECK( g_compiles == 1 );
+	r_shader_cache_close( &cache );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	CHECK( cached( &cache, "first", "main" ) && cached( &cache, "second", "main" ) );
+	CHECK( cached( &cache, "third", "main" ) );
+	r_shader_cache_close( &cache );
+
+	// A torn append: a record header with no valid payload behind it at the end of the file.
+	IO_File file;
+	CHECK( io_file_open( &file, TEST_CACHE_PATH, true ) );
+	uint64_t size = io_file_size( &file );
+	io_file_close( &file );
+	uint8_t torn[40];
+	memset( torn, 0xAB, sizeof( torn ) );
+	memcpy( torn, "SHDR", 4 );
+	damage( (size_t)size, torn, sizeof( torn ) );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	CHECK( cached( &cache, "third", "main" ) );
+	get( &cache, "fourth", "main" );
+	r_shader_cache_close( &cache );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	CHECK( cached( &cache, "fourth", "main" ) );
+	r_shader_cache_close( &cache );
+
+	// Another version's file serves nothing until the first insert writes a new header.
+	uint32_t version = R_SHADER_CACHE_VERSION + 1;
+	damage( 4, &version, sizeof( version ) );
+	CHECK( r_shader_cache_open( &cache, TEST_CACHE_PATH ) );
+	CHECK( !cached( &cache, "first", "main" ) && !cached( &cache, "fourth", "main" ) );
+	g_compiles = 0;
+	get( &cache, "first", "main" );
+	CHECK( g_compiles == 1 );
+	r_shader_cache_close( &cache );
+
+	remove( TEST_CACHE_PATH );
+}
+
+int main( void )
+{
+	test_key();
+	test_round_trip();
+	test_corrupt();
+	return test_report( "test_shader_cache" );
+}
@@ -0,0 +1,165 @@
+//
+// test_shader_jobs: the background compile queue (r_shader_jobs.h) with a stub
+// compiler, inline and on worker pools. Every job comes back once with the
+// bytecode of its own source (copied at submit, so the caller's strings can go
+// right away) and its tag, failures are reported as such, discarded jobs never
+// surface, and a full queue refuses new jobs until slots are taken.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../base/c_thread.c"
+#include "../render/common/r_hash.c"
+#include "../render/common/r_shader_jobs.c"
+
+#define JOBS 200
+
+// While set, the stub compiler waits, which keeps every job it picks up running.
+static SYS_Atomic64 g_hold;
+
+static void expected_bytecode( char *out, size_t size, int i )
+{
+	snprintf( out, size, "src %d|main|vs_5_0|%s", i, i % 2 ? "7" : "-" );
+}
+
+static bool stub_compile( void *user, const R_ShaderSource *source, void **outBytecode, size_t *outSize )
+{
+	(void)user;
+	while ( sys_atomic_load( &g_hold ) )
+		;
+	if ( strstr( source->source, "error" ) )
+		return false;
+
+	char *bytecode = (char *)malloc( 64 );
+	if ( !bytecode )
+		return false;
+	int size = snprintf( bytecode,
+	                     64,
+	                     "%s|%s|%s|%s",
+	                     source->source,
+	                     source->entry,
+	                     source->profile,
+	                     source->defines ? source->defines[0].value : "-" );
+	*outBytecode = bytecode;
+	*outSize     = (size_t)size + 1;
+	return true;
+}
+
+// Polls until the job finishes, the way r_poll_shader_jobs does once a frame.
+static R_ShaderJobState wait_and_take( R_ShaderJobQueue *queue, uint32_t handle, void **bytecode, uint64_t *tag )
+{
+	for ( ;; )
+	{
+		size_t           size  = 0;
+		R_ShaderJobState state = r_shader_jobs_take( queue, handle, bytecode, &size, tag );
+		if ( state != R_SHADER_JOB_QUEUED && state != R_SHADER_JOB_RUNNING )
+			return state;
+	}
+}
+
+static void test_jobs( int workers )
+{
+	R_ShaderJobQueue queue;
+	CHECK( r_shader_jobs_init( &queue, workers, stub_compile, NULL ) );
+
+	R_ShaderDefine defines[] = { { "X", "7" }, { NULL, NULL } };
+	uint32_t       handles[JOBS];
+	for ( int i = 0; i < JOBS; ++i )
+	{
+		char src[32];
+		snprintf( src, sizeof( src ), i % 10 == 3 ? "error %d" : "src %d", i );
+		R_ShaderSource source = { src, strlen( src ), "main", "vs_5_0", i % 2 ? defines : NULL, 0, 0 };
+		handles[i]            = r_shader_jobs_submit( &queue, &source, (uint64_t)i );
+		CHECK( handles[i] != 0 );
+		memset( src, 'Z', sizeof( src ) - 1 );
+	}
+	for ( int i = 0; i < JOBS; i += 7 )
+		r_shader_jobs_discard( &queue, handles[i] );
+
+	bool ok       = true;
+	int  done     = 0;
+	int  failed   = 0;
+	int  expected = 0;
+	for ( int i = 0; i < JOBS; ++i )
+	{
+		if ( i % 7 == 0 )
+			continue;
+
+		void            *bytecode = NULL;
+		uint64_t         tag      = 0;
+		R_ShaderJobState state    = wait_and_take( &queue, handles[i], &bytecode, &tag );
+		char             want[64];
+		expected_bytecode( want, sizeof( want ), i );
+		if ( state == R_SHADER_JOB_DONE )
+		{
+			ok = ok && i % 10 != 3 && tag == (uint64_t)i && strcmp( (const char *)bytecode, want ) == 0;
+			done++;
+		}
+		else
+		{
+			ok = ok && state == R_SHADER_JOB_FAILED && i % 10 == 3 && !bytecode;
+			failed++;
+		}
+		free( bytecode );
+		expected += i % 10 == 3;
+
+		// Taken once: the handle is stale afterwards.
+		ok = ok && r_shader_jobs_state( &queue, handles[i] ) == R_SHADER_JOB_FREE;
+	}
+	CHECK( ok );
+
+	// A discarded job still running on a worker finishes there, then frees its slot by itself.
+	for ( int i = 0; i < JOBS; i += 7 )
+		while ( r_shader_jobs_state( &queue, handles[i] ) != R_SHADER_JOB_FREE )
+			;
+	CHECK( failed == expected && done + failed == JOBS - ( JOBS + 6 ) / 7 );
+	r_shader_jobs_shutdown( &queue );
+}
+
+static void test_full_queue( void )
+{
+	R_ShaderJobQueue queue;
+	CHECK( r_shader_jobs_init( &queue, 2, stub_compile, NULL ) );
+
+	static uint32_t handles[R_SHADER_JOB_CAPACITY];
+	R_ShaderSource  source = { "src 1", 5, "main", "vs_5_0", NULL, 0, 0 };
+	sys_atomic_store( &g_hold, 1 );
+	bool ok = true;
+	for ( int i = 0; i < R_SHADER_JOB_CAPACITY; ++i )
+	{
+		handles[i] = r_shader_jobs_submit( &queue, &source, (uint64_t)i );
+		ok         = ok && handles[i] != 0;
+	}
+	CHECK( ok );
+	CHECK( r_shader_jobs_submit( &queue, &source, 0 ) == 0 );
+
+	// Nothing is finished while the compiler holds, so nothing can be taken yet.
+	void    *bytecode = NULL;
+	size_t   size     = 0;
+	uint64_t tag      = 0;
+	R_ShaderJobState state = r_shader_jobs_take( &queue, handles[0], &bytecode, &size, &tag );
+	CHECK( ( state == R_SHADER_JOB_QUEUED || state == R_SHADER_JOB_RUNNING ) && !bytecode );
+	sys_atomic_store( &g_hold, 0 );
+
+	CHECK( wait_and_take( &queue, handles[0], &bytecode, &tag ) == R_SHADER_JOB_DONE );
+	free( bytecode );
+	uint32_t reused = r_shader_jobs_submit( &queue, &source, 0 );
+	CHECK( reused != 0 && reused != handles[0] );
+	CHECK( r_shader_jobs_state( &queue, handles[0] ) == R_SHADER_JOB_FREE );
+
+	// Shutting down with jobs still in the queue frees them.
+	r_shader_jobs_shutdown( &queue );
+}
+
+int main( void )
+{
+	test_jobs( 0 );
+	test_jobs( 1 );
+	test_jobs( R_SHADER_MAX_WORKERS );
+	test_full_queue();
+	return test_report( "test_shader_jobs" );
+}
@@ -0,0 +1,143 @@
+//
+// test_state_cache: the shadow-state cache (r_state_cache.h) lets the first
+// bind of every slot through, filters repeats, and counts both.
+//
+
+#include "test.h"
+
+#include "../render/common/r_state_cache.c"
+
+static int a, b; // stand-ins for D3D objects, only their addresses matter
+
+static uint64_t issued( const R_StateCache *cache, R_StateCall call )
+{
+	return cache->stats.issued[call];
+}
+
+static uint64_t filtered( const R_StateCache *cache, R_StateCall call )
+{
+	return cache->stats.filtered[call];
+}
+
+static void test_pipeline_and_objects( void )
+{
+	R_StateCache cache;
+	r_state_cache_init( &cache );
+
+	// Nothing is known yet, so even a NULL pipeline goes through once.
+	CHECK( r_state_cache_set_pipeline( &cache, NULL ) );
+	CHECK( !r_state_cache_set_pipeline( &cache, NULL ) );
+	CHECK( r_state_cache_set_pipeline( &cache, &a ) );
+	CHECK( !r_state_cache_set_pipeline( &cache, &a ) );
+	CHECK( r_state_cache_set_pipeline( &cache, &b ) );
+	CHECK( issued( &cache, R_STATE_CALL_PIPELINE ) == 3 && filtered( &cache, R_STATE_CALL_PIPELINE ) == 2 );
+
+	// Vertex and pixel shader are separate objects counted as the same call.
+	CHECK( r_state_cache_set_object( &cache, R_STATE_OBJECT_VERTEX_SHADER, &a ) );
+	CHECK( r_state_cache_set_object( &cache, R_STATE_OBJECT_PIXEL_SHADER, &a ) );
+	CHECK( !r_state_cache_set_object( &cache, R_STATE_OBJECT_VERTEX_SHADER, &a ) );
+	CHECK( issued( &cache, R_STATE_CALL_SHADER ) == 2 && filtered( &cache, R_STATE_CALL_SHADER ) == 1 );
+
+	float factor[4] = { 1, 1, 1, 1 };
+	CHECK( r_state_cache_set_blend( &cache, &a, factor, ~0u ) );
+	CHECK( !r_state_cache_set_blend( &cache, &a, factor, ~0u ) );
+	factor[3] = 0.5f;
+	CHECK( r_state_cache_set_blend( &cache, &a, factor, ~0u ) );
+	CHECK( r_state_cache_set_blend( &cache, &a, factor, 1u ) );
+
+	CHECK( r_state_cache_set_depth_stencil( &cache, &a, 0 ) );
+	CHECK( !r_state_cache_set_depth_stencil( &cache, &a, 0 ) );
+	CHECK( r_state_cache_set_depth_stencil( &cache, &a, 1 ) );
+}
+
+static void test_slots( void )
+{
+	R_StateCache cache;
+	r_state_cache_init( &cache );
+
+	// Slots and stages are tracked apart.
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, 0, &a ) );
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, 1, &a ) );
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_PIXEL, 0, &a ) );
+	CHECK( !r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, 0, &a ) );
+	CHECK( !r_state_cache_set_constant_buffer( &cache, R_STAGE_PIXEL, 0, &a ) );
+
+	// A sub-range bind of the same buffer is a different binding.
+	CHECK( r_state_cache_set_constant_buffer_range( &cache, R_STAGE_VERTEX, 0, &a, 16, 16 ) );
+	CHECK( !r_state_cache_set_constant_buffer_range( &cache, R_STAGE_VERTEX, 0, &a, 16, 16 ) );
+	CHECK( r_state_cache_set_constant_buffer_range( &cache, R_STAGE_VERTEX, 0, &a, 32, 16 ) );
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, 0, &a ) );
+
+	// Forgotten slots go through again, the others stay filtered.
+	r_state_cache_forget_constant_buffers( &cache, R_STAGE_VERTEX, 1u << 1 );
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, 1, &a ) );
+	CHECK( !r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, 0, &a ) );
+
+	// Out of range slots are never filtered.
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, R_MAX_CONSTANT_BUFFER_SLOTS, &a ) );
+	CHECK( r_state_cache_set_constant_buffer( &cache, R_STAGE_VERTEX, R_MAX_CONSTANT_BUFFER_SLOTS, &a ) );
+	CHECK( r_state_cache_set_vertex_buffer( &cache, -1, &a, 16, 0 ) );
+	CHECK( r_state_cache_set_vertex_buffer( &cache, -1, &a, 16, 0 ) );
+
+	CHECK( r_state_cache_set_vertex_buffer( &cache, 0, &a, 32, 0 ) );
+	CHECK( !r_state_cache_set_vertex_buffer( &cache, 0, &a, 32, 0 ) );
+	CHECK( r_state_cache_set_vertex_buffer( &cache, 0, &a, 32, 64 ) );
+	CHECK( r_state_cache_set_vertex_buffer( &cache, 0, &a, 16, 64 ) );
+	CHECK( r_state_cache_set_vertex_buffer( &cache, 1, &a, 16, 64 ) );
+
+	CHECK( r_state_cache_set_index_buffer( &cache, &a, 42, 0 ) );
+	CHECK( !r_state_cache_set_index_buffer( &cache, &a, 42, 0 ) );
+	CHECK( r_state_cache_set_index_buffer( &cache, &a, 57, 0 ) );
+	CHECK( r_state_cache_set_index_buffer( &cache, &b, 57, 0 ) );
+
+	CHECK( r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 0, &a ) );
+	CHECK( !r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 0, &a ) );
+	CHECK( r_state_cache_set_texture( &cache, R_STAGE_VERTEX, 0, &a ) );
+	r_state_cache_forget_textures( &cache, R_STAGE_PIXEL, ~0u );
+	CHECK( r_state_cache_set_texture( &cache, R_STAGE_PIXEL, 0, &a ) );
+
+	CHECK( r_state_cache_set_sampler( &cache, R_STAGE_PIXEL, 3, &b ) );
+	CHECK( !r_state_cache_set_sampler( &cache, R_STAGE_PIXEL, 3, &b ) );
+	r_state_cache_forget_samplers( &cache, R_STAGE_PIXEL, 1u << 3 );
+	CHECK( r_state_cache_set_sampler( &cache, R_STAGE_PIXEL, 3, &b ) );
+}
+
+static void test_invalidate( void )
+{
+	R_StateCache cache;
+	r_state_cache_init( &cache );
+
+	// main.c's frame: the same topology, viewport and vertex buffer every frame.
+	R_Viewport viewport = { 0, 0, 800, 600, 0, 1 };
+	for ( int frame = 0; frame < 10; ++frame )
+	{
+		r_state_cache_set_topology( &cache, 4 );
+		r_state_cache_set_viewport( &cache, &viewport );
+		r_state_cache_set_vertex_buffer( &cache, 0, &a, 32, 0 );
+	}
+	CHECK( issued( &cache, R_STATE_CALL_TOPOLOGY ) == 1 && filtered( &cache, R_STATE_CALL_TOPOLOGY ) == 9 );
+	CHECK( issued( &cache, R_STATE_CALL_VIEWPORT ) == 1 && filtered( &cache, R_STATE_CALL_VIEWPORT ) == 9 );
+	CHECK( issued( &cache, R_STATE_CALL_VERTEX_BUFFER ) == 1 );
+
+	viewport.w = 1024;
+	CHECK( r_state_cache_set_viewport( &cache, &viewport ) );
+
+	// Invalidation forgets the state but keeps the counts.
+	r_state_cache_invalidate( &cache );
+	CHECK( issued( &cache, R_STATE_CALL_TOPOLOGY ) == 1 );
+	CHECK( r_state_cache_set_topology( &cache, 4 ) );
+	CHECK( r_state_cache_set_viewport( &cache, &viewport ) );
+	CHECK( r_state_cache_set_vertex_buffer( &cache, 0, &a, 32, 0 ) );
+
+	r_state_cache_reset_stats( &cache );
+	CHECK( issued( &cache, R_STATE_CALL_TOPOLOGY ) == 0 && filtered( &cache, R_STATE_CALL_TOPOLOGY ) == 0 );
+	CHECK( !r_state_cache_set_topology( &cache, 4 ) );
+}
+
+int main( void )
+{
+	test_pipeline_and_objects();
+	test_slots();
+	test_invalidate();
+	return test_report( "test_state_cache" );
+}
@@ -0,0 +1,221 @@
+//
+// test_state_objects: the state object cache (r_state_objects.h), driven the
+// way r_create_sampler and r_bind_sampler use it. Creating a sampler from a
+// desc that is already there hands out the same id and creates nothing; any
+// field changed, even by one bit, makes a new one; a colliding hash gets an
+// object of its own that lookups never return; a full cache refuses more. On
+// the bind path two samplers made from one desc are the same object, so
+// binding one after the other never reaches the driver, while a different
+// sampler, a stale id (binding NULL) or a texture bind goes through, and
+// either one forgets the bind group that filled the slot.
+//
+
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_hash.c"
+#include "../render/common/r_pool.c"
+#include "../render/common/r_state_cache.c"
+#include "../render/common/r_bind_group.c"
+#include "../render/common/r_state_objects.c"
+
+#define CAPACITY 8
+
+// Laid out like D3D11_SAMPLER_DESC: no padding, so descs compare byte for byte.
+typedef struct SamplerDesc
+{
+	uint32_t filter;
+	uint32_t addressU, addressV, addressW;
+	float    mipLodBias;
+	uint32_t maxAnisotropy;
+	uint32_t comparison;
+	float    borderColor[4];
+	float    minLod, maxLod;
+} SamplerDesc;
+
+typedef struct Device
+{
+	R_StateObjectCache samplers;
+	R_StateCache       state;
+	R_BoundGroups      boundGroups;
+	int                objects[CAPACITY]; // what CreateSamplerState hands out
+	uint32_t           created;
+	uint32_t           driverBinds;
+} Device;
+
+static SamplerDesc linear_wrap( void )
+{
+	SamplerDesc desc;
+	memset( &desc, 0, sizeof( desc ) );
+	desc.filter        = 0x15;
+	desc.addressU      = 1;
+	desc.addressV      = 1;
+	desc.addressW      = 1;
+	desc.maxAnisotropy = 1;
+	desc.maxLod        = 3.402823466e+38f;
+	return desc;
+}
+
+// r_create_sampler: the id of the shared object, a new one only for a desc not seen before.
+static uint32_t create_sampler( Device *dev, const SamplerDesc *desc, uint64_t hash )
+{
+	uint32_t id = r_state_object_find_id( &dev->samplers, desc, hash );
+	if ( id || dev->created == CAPACITY )
+		return id;
+	return r_state_object_insert( &dev->samplers, desc, hash, &dev->objects[dev->created++] );
+}
+
+static uint32_t create( Device *dev, const SamplerDesc *desc )
+{
+	return create_sampler( dev, desc, r_hash_bytes( desc, sizeof( *desc ), R_HASH_SEED ) );
+}
+
+// r_bind_sampler and r_bind_texture: forget the groups, then filter through the state cache.
+static void bind_sampler( Device *dev, uint32_t id, R_ShaderStage stage, int slot )
+{
+	r_bound_groups_forget( &dev->boundGroups, R_BIND_SAMPLERS, stage, 1u << slot );
+	if ( r_state_cache_set_sampler( &dev->state, stage, slot, r_state_object_get( &dev->samplers, id ) ) )
+		dev->driverBinds++;
+}
+
+static void bind_texture( Device *dev, const void *view, R_ShaderStage stage, int slot )
+{
+	r_bound_groups_forget( &dev->boundGroups, R_BIND_TEXTURES, stage, 1u << slot );
+	if ( r_state_cache_set_texture( &dev->state, stage, slot, view ) )
+		dev->driverBinds++;
+}
+
+static void test_dedupe( Device *dev )
+{
+	SamplerDesc desc = linear_wrap();
+	uint32_t    a    = create( dev, &desc );
+	CHECK( a == 1 && dev->created == 1 && r_state_object_get( &dev->samplers, a ) == &dev->objects[0] );
+	CHECK( create( dev, &desc ) == a && dev->created == 1 );
+
+	// A copy from elsewhere is the same desc.
+	SamplerDesc copy = desc;
+	CHECK( create( dev, &copy ) == a && dev->created == 1 );
+
+	// Any field changed makes another, even the sign of a zero bias.
+	SamplerDesc clamp = desc;
+	clamp.addressV    = 3;
+	SamplerDesc bias  = desc;
+	bias.mipLodBias   = -0.0f;
+	uint32_t b        = create( dev, &clamp );
+	uint32_t c        = create( dev, &bias );
+	CHECK( b == 2 && c == 3 && dev->created == 3 );
+	CHECK( create( dev, &clamp ) == b && create( dev, &bias ) == c && dev->created == 3 );
+
+	// The cache keeps its own copy of each desc.
+	clamp.addressV = 2;
+	CHECK( memcmp( r_state_object_desc( &dev->samplers, a ), &desc, sizeof( desc ) ) == 0 );
+	CHECK( ( (const SamplerDesc *)r_state_object_desc( &dev->samplers, b ) )->addressV == 3 );
+	CHECK( r_state_object_find( &dev->samplers, &desc, r_hash_bytes( &desc, sizeof( desc ), R_HASH_SEED ) ) ==
+	       &dev->objects[0] );
+
+	// Nothing behind 0 or an id never handed out.
+	CHECK( !r_state_object_get( &dev->samplers, 0 ) && !r_state_object_get( &dev->samplers, 4 ) );
+	CHECK( !r_state_object_desc( &dev->samplers, 0 ) && !r_state_object_desc( &dev->samplers, 4 ) );
+}
+
+static void test_collision( Device *dev )
+{
+	// Another desc under the first one's hash: an object of its own, the first keeps the lookup.
+	SamplerDesc first   = linear_wrap();
+	SamplerDesc other   = linear_wrap();
+	other.maxAnisotropy = 16;
+	uint64_t hash       = r_hash_bytes( &first, sizeof( first ), R_HASH_SEED );
+	uint32_t created    = dev->created;
+	uint32_t id         = create_sampler( dev, &other, hash );
+	CHECK( id == 4 && dev->created == created + 1 );
+	CHECK( r_state_object_find_id( &dev->samplers, &first, hash ) == 1 );
+	CHECK( r_state_object_find_id( &dev->samplers, &other, hash ) == 0 );
+	CHECK( r_state_object_get( &dev->samplers, id ) == &dev->objects[created] );
+
+	// Never found again, so each create makes another.
+	CHECK( create_sampler( dev, &other, hash ) == 5 && dev->created == created + 2 );
+}
+
+static void test_full( void )
+{
+	R_StateObjectCache cache;
+	int                objects[2];
+	CHECK( r_state_object_cache_init( &cache, 2, sizeof( uint32_t ) ) );
+	uint32_t descs[3] = { 1, 2, 3 };
+	CHECK( r_state_object_insert( &cache, &descs[0], 10, &objects[0] ) == 1 );
+	CHECK( r_state_object_insert( &cache, &descs[1], 20, &objects[1] ) == 2 );
+	CHECK( r_state_object_insert( &cache, &descs[2], 30, &objects[0] ) == 0 );
+	CHECK( cache.count == 2 && !r_state_object_find( &cache, &descs[2], 30 ) );
+	CHECK( r_state_object_find( &cache, &descs[1], 20 ) == &objects[1] );
+	r_state_object_cache_free( &cache );
+	CHECK( cache.count == 0 && !cache.objects );
+}
+
+static void test_bind( Device *dev )
+{
+	r_state_cache_invalidate( &dev->state );
+	r_bound_groups_reset( &dev->boundGroups );
+	dev->driverBinds = 0;
+
+	// Two samplers made from one desc are one object: the second bind is filtered.
+	SamplerDesc desc   = linear_wrap();
+	uint32_t    first  = create( dev, &desc );
+	uint32_t    second = create( dev, &desc );
+	bind_sampler( dev, first, R_STAGE_PIXEL, 0 );
+	bind_sampler( dev, second, R_STAGE_PIXEL, 0 );
+	CHECK( dev->driverBinds == 1 );
+	CHECK( dev->state.stats.issued[R_STATE_CALL_SAMPLER] == 1 );
+	CHECK( dev->state.stats.filtered[R_STATE_CALL_SAMPLER] == 1 );
+
+	// A different sampler, the same one on another stage or slot, and an id never handed out all go through.
+	SamplerDesc clamp = linear_wrap();
+	clamp.addressV    = 3;
+	bind_sampler( dev, create( dev, &clamp ), R_STAGE_PIXEL, 0 );
+	bind_sampler( dev, first, R_STAGE_VERTEX, 0 );
+	bind_sampler( dev, first, R_STAGE_PIXEL, 1 );
+	bind_sampler( dev, 99, R_STAGE_PIXEL, 1 );
+	CHECK( dev->driverBinds == 5 && dev->state.samplers[R_STAGE_PIXEL][1] == NULL );
+	bind_sampler( dev, 0, R_STAGE_PIXEL, 1 );
+	CHECK( dev->driverBinds == 5 );
+
+	// Textures the same way, NULL included.
+	int view;
+	bind_texture( dev, &view, R_STAGE_PIXEL, 0 );
+	bind_texture( dev, &view, R_STAGE_PIXEL, 0 );
+	bind_texture( dev, NULL, R_STAGE_PIXEL, 0 );
+	bind_texture( dev, NULL, R_STAGE_PIXEL, 0 );
+	CHECK( dev->driverBinds == 7 && dev->state.stats.filtered[R_STATE_CALL_TEXTURE] == 2 );
+
+	// A group that filled pixel texture 2 and sampler 2: a sampler bind to slot 2 takes it out, one to
+	// slot 3 doesn't; a texture bind the same.
+	R_BindGroupSlots slots;
+	memset( &slots, 0, sizeof( slots ) );
+	slots.masks[R_BIND_TEXTURES][R_STAGE_PIXEL] = 1u << 2;
+	slots.masks[R_BIND_SAMPLERS][R_STAGE_PIXEL] = 1u << 2;
+	CHECK( r_bound_groups_bind( &dev->boundGroups, 0, 7, &slots ) );
+	bind_sampler( dev, first, R_STAGE_PIXEL, 3 );
+	bind_sampler( dev, first, R_STAGE_VERTEX, 2 );
+	CHECK( dev->boundGroups.ids[0] == 7 );
+	bind_sampler( dev, first, R_STAGE_PIXEL, 2 );
+	CHECK( dev->boundGroups.ids[0] == 0 );
+	CHECK( r_bound_groups_bind( &dev->boundGroups, 0, 7, &slots ) );
+	bind_texture( dev, &view, R_STAGE_PIXEL, 2 );
+	CHECK( dev->boundGroups.ids[0] == 0 );
+}
+
+int main( void )
+{
+	Device dev;
+	memset( &dev, 0, sizeof( dev ) );
+	r_state_cache_init( &dev.state );
+	CHECK( r_state_object_cache_init( &dev.samplers, CAPACITY, sizeof( SamplerDesc ) ) );
+
+	test_dedupe( &dev );
+	test_collision( &dev );
+	test_full();
+	test_bind( &dev );
+
+	r_state_object_cache_free( &dev.samplers );
+	return test_report( "test_state_objects" );
+}
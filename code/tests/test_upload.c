@@ -0,0 +1,224 @@
+//
+// test_upload: the upload queue (r_upload.h) driven the way r_flush_uploads
+// drives it, with plain arrays standing in for the GPU buffers. Every request
+// lands intact however it was split, no flush goes over its budget, requests
+// that would straddle the end of the ring wrap to the front, callbacks fire
+// once and in order, cancelled requests stop landing, and a full ring refuses
+// new requests instead of overwriting queued ones.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+
+#include "../render/common/r_upload.c"
+
+#define TARGETS 64
+#define TARGET_BYTES 4096
+
+static uint8_t  g_gpu[TARGETS][TARGET_BYTES];
+static int      g_completed[TARGETS];
+static uint32_t g_order[TARGETS * 4];
+static uint32_t g_orderCount;
+
+static void on_complete( void *user, uint32_t target )
+{
+	(void)user;
+	g_completed[target]++;
+	if ( g_orderCount < TARGETS * 4 )
+		g_order[g_orderCount++] = target;
+}
+
+static void reset( void )
+{
+	memset( g_gpu, 0, sizeof( g_gpu ) );
+	memset( g_completed, 0, sizeof( g_completed ) );
+	g_orderCount = 0;
+}
+
+// One flush: copies the pieces and checks they stay under the budget. Returns the bytes copied.
+static size_t flush( R_UploadQueue *queue, size_t budget )
+{
+	R_UploadPiece pieces[16];
+	uint32_t      count = r_upload_queue_gather( queue, budget, pieces, 16 );
+	size_t        bytes = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		memcpy( g_gpu[pieces[i].target] + pieces[i].dstOffset, pieces[i].data, pieces[i].size );
+		bytes += pieces[i].size;
+	}
+	CHECK( bytes <= budget );
+	r_upload_queue_complete( queue );
+	return bytes;
+}
+
+static void fill( uint8_t *data, size_t size, uint32_t seed )
+{
+	for ( size_t i = 0; i < size; ++i )
+		data[i] = (uint8_t)( seed * 31 + i * 7 + ( i >> 8 ) );
+}
+
+static void test_split( void )
+{
+	R_UploadQueue *queue = (R_UploadQueue *)malloc( sizeof( R_UploadQueue ) );
+	CHECK( queue && r_upload_queue_init( queue, 64 * 1024 ) );
+	reset();
+
+	static uint8_t data[TARGETS][TARGET_BYTES];
+	for ( uint32_t t = 1; t <= 8; ++t )
+	{
+		fill( data[t], TARGET_BYTES, t );
+		CHECK( r_upload_queue_push( queue, t, 0, data[t], 1000 * t % TARGET_BYTES + 1, on_complete, NULL ) );
+	}
+	memset( data, 0, sizeof( data ) ); // the queue copied everything
+
+	// A budget smaller than most requests: they go out in pieces over several flushes.
+	int flushes = 0;
+	while ( queue->count && flushes < 1000 )
+	{
+		flush( queue, 700 );
+		flushes++;
+	}
+	CHECK( queue->count == 0 && r_upload_queue_pending_bytes( queue ) == 0 );
+
+	bool ok = true;
+	for ( uint32_t t = 1; t <= 8; ++t )
+	{
+		uint8_t expected[TARGET_BYTES];
+		fill( expected, TARGET_BYTES, t );
+		ok = ok && memcmp( g_gpu[t], expected, 1000 * t % TARGET_BYTES + 1 ) == 0;
+		ok = ok && g_completed[t] == 1 && g_order[t - 1] == t;
+	}
+	CHECK( ok );
+	CHECK( queue->stats.completions == 8 && queue->stats.bytesCopied == queue->stats.bytesQueued );
+
+	r_upload_queue_free( queue );
+	free( queue );
+}
+
+static void test_wrap( void )
+{
+	R_UploadQueue *queue = (R_UploadQueue *)malloc( sizeof( R_UploadQueue ) );
+	CHECK( queue && r_upload_queue_init( queue, 10000 ) );
+	reset();
+
+	uint8_t data[TARGET_BYTES];
+	fill( data, 4000, 1 );
+	CHECK( r_upload_queue_push( queue, 1, 0, data, 4000, on_complete, NULL ) );
+	fill( data, 4000, 2 );
+	CHECK( r_upload_queue_push( queue, 2, 0, data, 4000, on_complete, NULL ) );
+
+	// The third would run past the end of the ring, at the front it overlaps the first: refused.
+	fill( data, 3000, 3 );
+	CHECK( !r_upload_queue_push( queue, 3, 0, data, 3000, on_complete, NULL ) );
+	CHECK( queue->stats.rejected == 1 );
+
+	// Once the first is done the front is free, the third starts there and the unused 2000 bytes
+	// at the end count as pending until the request behind them completes.
+	flush( queue, 4000 );
+	CHECK( g_completed[1] == 1 && g_completed[2] == 0 );
+	CHECK( r_upload_queue_push( queue, 3, 0, data, 3000, on_complete, NULL ) );
+	CHECK( queue->requests[( queue->first + 1 ) % R_UPLOAD_MAX_REQUESTS].ringOffset % 10000 == 0 );
+	CHECK( r_upload_queue_pending_bytes( queue ) == 4000 + 2000 + 3000 );
+
+	// A request larger than the ring never fits.
+	static uint8_t huge[10001];
+	CHECK( !r_upload_queue_push( queue, 4, 0, huge, sizeof( huge ), on_complete, NULL ) );
+
+	flush( queue, 3500 );
+	flush( queue, 3500 );
+	flush( queue, 3500 );
+	CHECK( queue->count == 0 && r_upload_queue_pending_bytes( queue ) == 0 );
+
+	uint8_t expected[TARGET_BYTES];
+	fill( expected, 4000, 2 );
+	CHECK( memcmp( g_gpu[2], expected, 4000 ) == 0 );
+	fill( expected, 3000, 3 );
+	CHECK( memcmp( g_gpu[3], expected, 3000 ) == 0 );
+	CHECK( g_orderCount == 3 && g_order[1] == 2 && g_order[2] == 3 );
+
+	r_upload_queue_free( queue );
+	free( queue );
+}
+
+// Random sizes, offsets, budgets and cancels through a small ring, checked against what each target
+// should hold.
+static void test_random( void )
+{
+	R_UploadQueue *queue = (R_UploadQueue *)malloc( sizeof( R_UploadQueue ) );
+	CHECK( queue && r_upload_queue_init( queue, 3 * TARGET_BYTES ) );
+	reset();
+
+	static uint8_t expected[TARGETS][TARGET_BYTES];
+	memset( expected, 0, sizeof( expected ) );
+	srand( 5 );
+	bool     ok        = true;
+	int      pushed    = 0;
+	int      cancelled = 0;
+	uint32_t live[TARGETS];
+	memset( live, 0, sizeof( live ) );
+	for ( int frame = 0; frame < 20000; ++frame )
+	{
+		// Each target has at most one request in flight, so a cancel drops exactly what it queued.
+		for ( int n = rand() % 4; n > 0; --n )
+		{
+			uint32_t t = 1 + (uint32_t)rand() % ( TARGETS - 1 );
+			if ( live[t] )
+				continue;
+			uint32_t offset = (uint32_t)rand() % TARGET_BYTES;
+			uint32_t size   = 1 + (uint32_t)rand() % ( TARGET_BYTES - offset );
+			uint8_t  data[TARGET_BYTES];
+			fill( data, size, (uint32_t)frame );
+			if ( !r_upload_queue_push( queue, t, offset, data, size, on_complete, NULL ) )
+				continue;
+			memcpy( expected[t] + offset, data, size );
+			live[t] = (uint32_t)g_completed[t] + 1;
+			pushed++;
+		}
+
+		if ( rand() % 50 == 0 )
+		{
+			uint32_t t = 1 + (uint32_t)rand() % ( TARGETS - 1 );
+			if ( live[t] )
+			{
+				// Whatever already went out stays; the simplest model is that the target is dead now.
+				r_upload_queue_cancel( queue, t );
+				live[t] = 0;
+				memcpy( expected[t], g_gpu[t], TARGET_BYTES );
+				cancelled++;
+			}
+		}
+
+		flush( queue, 1 + (size_t)rand() % 6000 );
+		for ( uint32_t t = 1; t < TARGETS; ++t )
+		{
+			if ( live[t] && (uint32_t)g_completed[t] == live[t] )
+			{
+				ok      = ok && memcmp( g_gpu[t], expected[t], TARGET_BYTES ) == 0;
+				live[t] = 0;
+			}
+		}
+		ok = ok && r_upload_queue_pending_bytes( queue ) <= queue->capacity;
+		ok = ok && queue->pushed - queue->retired == queue->count;
+	}
+	while ( queue->count )
+		flush( queue, TARGET_BYTES );
+	for ( uint32_t t = 1; t < TARGETS; ++t )
+		ok = ok && memcmp( g_gpu[t], expected[t], TARGET_BYTES ) == 0;
+	CHECK( ok );
+	CHECK( pushed > 1000 && cancelled > 10 );
+	CHECK( queue->stats.completions == (uint64_t)( pushed - cancelled ) );
+	CHECK( queue->pushed == (uint64_t)pushed && queue->retired == queue->pushed );
+
+	r_upload_queue_free( queue );
+	free( queue );
+}
+
+int main( void )
+{
+	test_split();
+	test_wrap();
+	test_random();
+	return test_report( "test_upload" );
+}
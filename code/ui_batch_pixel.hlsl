@@ -0,0 +1,8 @@
+#include "render/generated/ui_batch_pass.vtx.hlsl"
+
+float4 main(PS_INPUT input) : SV_TARGET {
+  // Untextured primitives carry a negative u (R_BATCH2D_NO_UV) and skip the texture.
+  if (input.uv.x < 0.0)
+    return input.col;
+  return input.col * uiTexture.Sample(uiSampler, input.uv);
+};
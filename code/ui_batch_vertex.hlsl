@@ -0,0 +1,14 @@
+#include "render/generated/ui_batch_pass.vtx.hlsl"
+
+PS_INPUT main(VS_INPUT input) {
+  PS_INPUT output;
+
+  // Pixel coordinates with the origin at the top left.
+  float2 ndc = input.pos * invViewport * float2(2.0, -2.0) + float2(-1.0, 1.0);
+
+  output.pos = float4(ndc, 0.0, 1.0);
+  output.uv = input.uv;
+  output.col = input.col;
+
+  return output;
+};
@@ -0,0 +1,9 @@
+@echo off
+setlocal
+
+rem Runs every test executable build-tools.bat built; fails when any of them does.
+set FAILED=0
+for %%t in (out\test_*.exe) do (
+  %%t || set FAILED=1
+)
+exit /b %FAILED%